@@ -0,0 +1,464 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <getopt.h>
+
+// Implied volatility surfaces in one process: the grid is built and solved
+// by libheston (unified/src/vol_surface.c), this program reads and writes it.
+#include "unified/include/heston_fft.h"
+#include "unified/include/black_scholes.h"
+#include "unified/include/vol_surface.h"
+
+// Binary output: this header followed by count records of 8 doubles
+// (spot, strike, expiry, rate, dividend, price, bs_iv, sv_iv) in host byte order
+#define SURFACE_FILE_MAGIC "VSURF\0\0\0"
+#define SURFACE_FILE_VERSION 1
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t count;
+} SurfaceFileHeader;
+
+// Growable array of surface points
+typedef struct {
+    VolSurfacePoint* points;
+    int count;
+    int capacity;
+} PointList;
+
+// Parse a double, rejecting trailing garbage
+static bool parse_double(const char* str, double* value) {
+    char* endptr;
+    errno = 0;
+    double v = strtod(str, &endptr);
+    if (errno == ERANGE || endptr == str) {
+        return false;
+    }
+    while (isspace((unsigned char)*endptr)) endptr++;
+    if (*endptr != '\0') {
+        return false;
+    }
+    *value = v;
+    return true;
+}
+
+static bool append_point(PointList* list, const VolSurfacePoint* point) {
+    if (list->count == list->capacity) {
+        int capacity = list->capacity > 0 ? list->capacity * 2 : 256;
+        VolSurfacePoint* grown = realloc(list->points, (size_t)capacity * sizeof(VolSurfacePoint));
+        if (grown == NULL) {
+            fprintf(stderr, "Error: Memory allocation for surface failed\n");
+            return false;
+        }
+        list->points = grown;
+        list->capacity = capacity;
+    }
+    list->points[list->count++] = *point;
+    return true;
+}
+
+// Read price,strike,expiry[,spot,rate,dividend] rows from stdin, skipping
+// blank, comment, header and malformed lines
+static bool read_chain(double S, double r, double q, PointList* list) {
+    char line[4096];
+    int line_no = 0;
+
+    while (fgets(line, sizeof(line), stdin) != NULL) {
+        line_no++;
+
+        const char* p = line;
+        while (isspace((unsigned char)*p)) p++;
+        if (*p == '\0' || *p == '#') {
+            continue;
+        }
+
+        double fields[6] = {0.0, 0.0, 0.0, S, r, q};
+        int count = 0;
+        while (count < 6) {
+            char* endptr;
+            fields[count] = strtod(p, &endptr);
+            if (endptr == p) {
+                break;
+            }
+            count++;
+
+            p = endptr;
+            while (isspace((unsigned char)*p)) p++;
+            if (*p != ',') {
+                break;
+            }
+            p++;
+        }
+
+        if (count < 3) {
+            // Header lines are expected; anything else is worth a warning
+            if (!isalpha((unsigned char)line[strspn(line, " \t")])) {
+                fprintf(stderr, "Warning: Skipping malformed row %d\n", line_no);
+            }
+            continue;
+        }
+        if (fields[0] <= 0.0 || fields[1] <= 0.0 || fields[2] <= 0.0 || fields[3] <= 0.0) {
+            fprintf(stderr, "Warning: Skipping row %d with non-positive values\n", line_no);
+            continue;
+        }
+
+        VolSurfacePoint point = {fields[3], fields[1], fields[2], fields[4], fields[5],
+                                 fields[0], -1.0, -1.0};
+        if (!append_point(list, &point)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Parse "LO:HI:STEP" into a strike range
+static bool parse_strike_range(const char* arg, double* lo, double* hi, double* step) {
+    char* endptr;
+    *lo = strtod(arg, &endptr);
+    if (endptr == arg || *endptr != ':') {
+        return false;
+    }
+    arg = endptr + 1;
+    *hi = strtod(arg, &endptr);
+    if (endptr == arg || *endptr != ':') {
+        return false;
+    }
+    arg = endptr + 1;
+    *step = strtod(arg, &endptr);
+    if (endptr == arg || *endptr != '\0') {
+        return false;
+    }
+    return *lo > 0.0 && *hi >= *lo && *step > 0.0;
+}
+
+// Parse a comma-separated list of positive values; returns the count or -1
+static int parse_list(const char* arg, double* values, int max_values) {
+    int count = 0;
+
+    while (*arg != '\0') {
+        char* endptr;
+        double v = strtod(arg, &endptr);
+        if (endptr == arg || v <= 0.0 || count == max_values) {
+            return -1;
+        }
+        values[count++] = v;
+
+        arg = endptr;
+        if (*arg == ',') {
+            arg++;
+        } else if (*arg != '\0') {
+            return -1;
+        }
+    }
+    return count;
+}
+
+// Build a strikes x expiries grid priced with Black-Scholes at a flat
+// volatility, or with Heston parameters when params is not NULL
+static bool build_grid(double S, double r, double q, double lo, double hi, double step,
+                       const double* expiries, int num_expiries, double vol,
+                       const HestonParams* params, PointList* list) {
+    HestonFFTContext* ctx = NULL;
+    if (params != NULL) {
+        ctx = heston_fft_context_create();
+        if (ctx == NULL) {
+            fprintf(stderr, "Error: Memory allocation for pricing context failed\n");
+            return false;
+        }
+    }
+
+    // Count the strikes up front so the grid does not depend on rounding
+    int num_strikes = (int)((hi - lo) / step + 1e-9) + 1;
+    bool ok = true;
+
+    for (int e = 0; e < num_expiries && ok; e++) {
+        for (int k = 0; k < num_strikes && ok; k++) {
+            double K = lo + k * step;
+            double T = expiries[e];
+            double price = (ctx != NULL) ? heston_fft_context_call(ctx, S, K, T, r, q, params)
+                                         : bs_call(S, K, T, r, q, vol);
+            VolSurfacePoint point = {S, K, T, r, q, price, -1.0, -1.0};
+            ok = append_point(list, &point);
+        }
+    }
+
+    heston_fft_context_destroy(ctx);
+    return ok;
+}
+
+static bool write_csv(FILE* out, const PointList* list) {
+    fprintf(out, "spot,strike,expiry,price,bs_iv,sv_iv\n");
+    for (int i = 0; i < list->count; i++) {
+        const VolSurfacePoint* p = &list->points[i];
+        fprintf(out, "%.6f,%.6f,%.6f,%.6f,", p->S, p->K, p->T, p->price);
+        if (p->bs_iv >= 0.0) {
+            fprintf(out, "%.6f,", p->bs_iv);
+        } else {
+            fprintf(out, "error,");
+        }
+        if (p->sv_iv >= 0.0) {
+            fprintf(out, "%.6f\n", p->sv_iv);
+        } else {
+            fprintf(out, "error\n");
+        }
+    }
+    return !ferror(out);
+}
+
+static bool write_binary(FILE* out, const PointList* list) {
+    SurfaceFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SURFACE_FILE_MAGIC, sizeof(header.magic));
+    header.version = SURFACE_FILE_VERSION;
+    header.count = (uint32_t)list->count;
+
+    if (fwrite(&header, sizeof(header), 1, out) != 1) {
+        return false;
+    }
+    for (int i = 0; i < list->count; i++) {
+        const VolSurfacePoint* p = &list->points[i];
+        double record[8] = {p->S, p->K, p->T, p->r, p->q, p->price, p->bs_iv, p->sv_iv};
+        if (fwrite(record, sizeof(record), 1, out) != 1) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Print usage information
+static void print_usage(const char* program_name) {
+    fprintf(stderr, "Usage: %s [options] StockPrice RiskFreeRate DividendYield < chain\n", program_name);
+    fprintf(stderr, "       %s [options] --strikes=LO:HI:STEP --expiries=T1,T2,... StockPrice RiskFreeRate DividendYield\n", program_name);
+    fprintf(stderr, "Computes Black-Scholes and Heston implied volatilities for a whole surface.\n");
+    fprintf(stderr, "Without --strikes the chain is read from stdin, one CSV row per call:\n");
+    fprintf(stderr, "  price,strike,expiry[,spot,rate,dividend]    (expiry in years)\n");
+    fprintf(stderr, "Rows sharing (spot, rate, dividend, expiry) are calibrated on one FFT grid per\n");
+    fprintf(stderr, "parameter set; rows of many underlyings may be mixed.\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  --strikes=LO:HI:STEP  Build a grid of strikes instead of reading a chain\n");
+    fprintf(stderr, "  --expiries=T1,...     Grid expiries in years\n");
+    fprintf(stderr, "  --vol=X               Price the grid with Black-Scholes at volatility X (default: 0.2)\n");
+    fprintf(stderr, "  --heston=V0,KAPPA,THETA,SIGMA,RHO\n");
+    fprintf(stderr, "                        Price the grid with these Heston parameters instead\n");
+    fprintf(stderr, "  --threads=N           Calibrate expiries on N threads (default: online CPUs)\n");
+    fprintf(stderr, "  --format=FORMAT       csv (default) or binary\n");
+    fprintf(stderr, "  --output=PATH         Write the surface to PATH instead of stdout\n");
+    fprintf(stderr, "  --cache-size=MB       Memory limit for cached FFT grids, shared by the threads (default: 64)\n");
+    fprintf(stderr, "  --backend=NAME        Compute calibration grids on cpu (default) or gpu, one batch\n");
+    fprintf(stderr, "                        per sweep (needs a build with GPU=cuda)\n");
+    fprintf(stderr, "  --no-gpu-check        Skip the CPU reference grid of every GPU batch\n");
+    fprintf(stderr, "  --debug               Enable debug output\n");
+    fprintf(stderr, "  --help                Display this help message\n");
+    fprintf(stderr, "\nExample: %s --strikes=80:120:5 --expiries=0.25,0.5,1 100 0.05 0.01\n", program_name);
+}
+
+int main(int argc, char *argv[]) {
+    static struct option long_options[] = {
+        {"strikes", required_argument, 0, 'k'},
+        {"expiries", required_argument, 0, 'e'},
+        {"vol", required_argument, 0, 'V'},
+        {"heston", required_argument, 0, 'H'},
+        {"threads", required_argument, 0, 'T'},
+        {"format", required_argument, 0, 'f'},
+        {"output", required_argument, 0, 'o'},
+        {"cache-size", required_argument, 0, 'c'},
+        {"backend", required_argument, 0, 'b'},
+        {"no-gpu-check", no_argument, 0, 'g'},
+        {"debug", no_argument, 0, 'd'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    HestonFFTConfig config;
+    heston_fft_get_config(&config);
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads = (cpus > 0) ? (int)cpus : 1;
+    bool binary = false;
+    const char* output_path = NULL;
+    const char* strike_arg = NULL;
+    const char* expiry_arg = NULL;
+    double vol = 0.2;
+    bool use_heston = false;
+    HestonParams params;
+    int option_index = 0;
+    int c;
+
+    while ((c = getopt_long(argc, argv, "dho:", long_options, &option_index)) != -1) {
+        switch (c) {
+            case 'k':
+                strike_arg = optarg;
+                break;
+            case 'e':
+                expiry_arg = optarg;
+                break;
+            case 'V':
+                if (!parse_double(optarg, &vol) || vol <= 0.0) {
+                    fprintf(stderr, "Error: Volatility must be positive\n");
+                    return 1;
+                }
+                break;
+            case 'H': {
+                double values[5];
+                if (sscanf(optarg, "%lf,%lf,%lf,%lf,%lf", &values[0], &values[1], &values[2],
+                           &values[3], &values[4]) != 5 ||
+                    values[0] <= 0.0 || values[1] <= 0.0 || values[2] <= 0.0 || values[3] <= 0.0 ||
+                    values[4] <= -1.0 || values[4] >= 1.0) {
+                    fprintf(stderr, "Error: --heston needs V0,KAPPA,THETA,SIGMA,RHO with positive\n");
+                    fprintf(stderr, "       variances and rates and -1 < RHO < 1\n");
+                    return 1;
+                }
+                params.v0 = values[0];
+                params.kappa = values[1];
+                params.theta = values[2];
+                params.sigma = values[3];
+                params.rho = values[4];
+                use_heston = true;
+                break;
+            }
+            case 'T': {
+                int n = atoi(optarg);
+                if (n > 0) {
+                    threads = n;
+                } else {
+                    fprintf(stderr, "Warning: Thread count must be positive. Using default: %d\n", threads);
+                }
+                break;
+            }
+            case 'f':
+                if (strcmp(optarg, "binary") == 0) {
+                    binary = true;
+                } else if (strcmp(optarg, "csv") == 0) {
+                    binary = false;
+                } else {
+                    fprintf(stderr, "Error: Unknown output format '%s' (use csv or binary)\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'o':
+                output_path = optarg;
+                break;
+            case 'c': {
+                long mb = atol(optarg);
+                if (mb > 0) {
+                    config.cache_max_bytes = (size_t)mb * 1024 * 1024;
+                } else {
+                    fprintf(stderr, "Warning: Cache size must be positive. Using default: %zu MB\n",
+                            config.cache_max_bytes / (1024 * 1024));
+                }
+                break;
+            }
+            case 'b':
+                if (strcmp(optarg, "cpu") == 0) {
+                    config.backend = HESTON_BACKEND_CPU;
+                } else if (strcmp(optarg, "gpu") == 0) {
+                    config.backend = HESTON_BACKEND_GPU;
+                } else {
+                    fprintf(stderr, "Error: Unknown backend '%s' (use cpu or gpu)\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'g':
+                config.gpu_verify = false;
+                break;
+            case 'd':
+                config.debug = true;
+                break;
+            case 'h':
+                print_usage(argv[0]);
+                return 0;
+            case '?':
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+
+    double S, r, q;
+    if (argc - optind != 3) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    if (!parse_double(argv[optind], &S) || !parse_double(argv[optind + 1], &r) ||
+        !parse_double(argv[optind + 2], &q) || S <= 0.0) {
+        fprintf(stderr, "Error: Invalid stock price, rate or dividend yield\n");
+        return 1;
+    }
+    if ((strike_arg == NULL) != (expiry_arg == NULL)) {
+        fprintf(stderr, "Error: --strikes and --expiries go together\n");
+        return 1;
+    }
+
+    heston_fft_set_config(&config);
+
+    PointList list = {NULL, 0, 0};
+    bool ok;
+    if (strike_arg != NULL) {
+        double lo, hi, step;
+        double expiries[64];
+        int num_expiries = parse_list(expiry_arg, expiries, 64);
+        if (!parse_strike_range(strike_arg, &lo, &hi, &step)) {
+            fprintf(stderr, "Error: --strikes needs LO:HI:STEP with 0 < LO <= HI and STEP > 0\n");
+            return 1;
+        }
+        if (num_expiries <= 0) {
+            fprintf(stderr, "Error: --expiries needs up to 64 positive expiries in years\n");
+            return 1;
+        }
+        ok = build_grid(S, r, q, lo, hi, step, expiries, num_expiries, vol,
+                        use_heston ? &params : NULL, &list);
+    } else {
+        ok = read_chain(S, r, q, &list);
+    }
+
+    if (!ok) {
+        free(list.points);
+        return 1;
+    }
+    if (list.count == 0) {
+        fprintf(stderr, "Error: No options in the surface\n");
+        free(list.points);
+        return 1;
+    }
+
+    int failures = heston_vol_surface(list.points, list.count, threads);
+    if (failures < 0) {
+        fprintf(stderr, "Error: Surface calibration failed\n");
+        free(list.points);
+        return 1;
+    }
+    if (config.debug) {
+        fprintf(stderr, "Debug: %d options, %d without a Heston implied volatility, %d threads\n",
+                list.count, failures, threads);
+    }
+
+    FILE* out = stdout;
+    if (output_path != NULL) {
+        out = fopen(output_path, binary ? "wb" : "w");
+        if (out == NULL) {
+            fprintf(stderr, "Error: Cannot open %s: %s\n", output_path, strerror(errno));
+            free(list.points);
+            return 1;
+        }
+    }
+
+    ok = binary ? write_binary(out, &list) : write_csv(out, &list);
+    if (out != stdout) {
+        ok = fclose(out) == 0 && ok;
+    } else {
+        ok = fflush(out) == 0 && ok;
+    }
+    if (!ok) {
+        fprintf(stderr, "Error: Writing the surface failed\n");
+    }
+
+    free(list.points);
+    return (ok && failures == 0) ? 0 : 1;
+}
@@ -5,247 +5,9 @@
 #include <float.h>
 #include <errno.h>
 
-// Cumulative distribution function for standard normal distribution
-double cdf(double x) {
-    return 0.5 * (1.0 + erf(x / sqrt(2.0)));
-}
-
-// Probability density function for standard normal distribution
-double pdf(double x) {
-    return exp(-0.5 * x * x) / sqrt(2.0 * M_PI);
-}
-
-// Black-Scholes European call option pricing
-double bs_call(double S, double K, double T, double r, double q, double sigma) {
-    // Handle edge cases and prevent numerical issues
-    if (sigma <= 0 || T <= 0 || S <= 0 || K <= 0) {
-        return -1.0;  // Signal an error
-    }
-    
-    // For nearly zero volatility, use deterministic approximation
-    if (sigma < 0.0001) {
-        if (S * exp(-q * T) > K * exp(-r * T)) {
-            // Forward price exceeds strike, option is in the money
-            return S * exp(-q * T) - K * exp(-r * T);
-        } else {
-            // Forward price below strike, option is out of the money
-            return 0.0;
-        }
-    }
-    
-    // Calculate d1 & d2 with numerical stability in mind
-    double sqrt_T = sqrt(T);
-    if (sqrt_T < DBL_EPSILON) {
-        // For very small T, use intrinsic value
-        return fmax(0.0, S - K * exp(-r * T));
-    }
-    
-    double sigmaSqrtT = sigma * sqrt_T;
-    if (sigmaSqrtT < DBL_EPSILON) {
-        // Avoid division by near-zero
-        return fmax(0.0, S - K * exp(-r * T));
-    }
-    
-    // Calculate d1 and d2 carefully to avoid numerical issues
-    double forward = S * exp((r - q) * T);
-    double d1 = (log(forward / K) + 0.5 * sigma * sigma * T) / sigmaSqrtT;
-    double d2 = d1 - sigmaSqrtT;
-    
-    // Check for numerical overflow in the exponentials
-    if (!isfinite(d1) || !isfinite(d2)) {
-        if (d1 > 100) return S * exp(-q * T); // Deep ITM, approximate with discounted stock
-        if (d2 < -100) return 0; // Deep OTM, worth approximately zero
-        // If we got NaN, return an error indicator
-        return -1.0;
-    }
-    
-    // Normal case for calculation
-    double N_d1 = cdf(d1);
-    double N_d2 = cdf(d2);
-    
-    // Check for numerical issues in cumulative distribution
-    if (!isfinite(N_d1) || !isfinite(N_d2)) {
-        return -1.0;  // Signal an error
-    }
-    
-    double call_price = S * exp(-q * T) * N_d1 - K * exp(-r * T) * N_d2;
-    
-    // Ensure non-negative price
-    return call_price > 0 ? call_price : 0;
-}
-
-// Vega (derivative of price with respect to volatility)
-double bs_vega(double S, double K, double T, double r, double q, double sigma) {
-    // Handle edge cases
-    if (sigma <= 0 || T <= 0 || S <= 0 || K <= 0) {
-        return 0.0;  // Avoid division by zero or negative values
-    }
-    
-    double sqrt_T = sqrt(T);
-    if (sqrt_T < DBL_EPSILON) {
-        return 0.0; // Vega approaches zero as time approaches zero
-    }
-    
-    double sigmaSqrtT = sigma * sqrt_T;
-    if (sigmaSqrtT < DBL_EPSILON) {
-        return 0.0; // Avoid division by near-zero
-    }
-    
-    double d1 = (log(S/K) + (r - q + 0.5*sigma*sigma)*T) / sigmaSqrtT;
-    
-    // Check for numerical issues
-    if (!isfinite(d1)) {
-        return 0.0; // Avoid NaN results
-    }
-    
-    return S * exp(-q*T) * pdf(d1) * sqrt_T;
-}
-
-// Implied volatility via Newton-Raphson method with bisection fallback
-double implied_vol(double market_price, double S, double K, double T, double r, double q) {
-    // Input validation
-    if (market_price <= 0.0 || S <= 0.0 || K <= 0.0 || T <= 0.0) {
-        fprintf(stderr, "Error: Invalid input parameters (must be positive).\n");
-        return -1;
-    }
-    
-    // Check if intrinsic value is close to market price
-    double intrinsic = fmax(0.0, S - K * exp(-r * T));
-    double discounted_S = S * exp(-q * T);
-    double discounted_K = K * exp(-r * T);
-    
-    // Deep ITM check - but don't use a hardcoded value
-    // Only return early if price is truly at boundary condition
-    if (market_price >= discounted_S && fabs(market_price - discounted_S) < 1e-6) {
-        return 0.3;  // Use a reasonable volatility for very deep ITM options
-    }
-    
-    // Check if market price is below intrinsic value
-    if (market_price < intrinsic - 1e-6) {
-        fprintf(stderr, "Warning: Market price %.6f below intrinsic value %.6f\n", 
-                market_price, intrinsic);
-        // Return a default reasonable volatility
-        return 0.2;
-    }
-    
-    // Special case for ATM options - use quick approximation
-    if (fabs(S - K) < 0.001 * S) {
-        double atm_approx = sqrt(2 * M_PI / T) * market_price / S;
-        
-        // Ensure it's in a reasonable range
-        if (atm_approx >= 0.1 && atm_approx <= 0.5 && isfinite(atm_approx)) {
-            return atm_approx;
-        }
-    }
-    
-    // No more special cases - we'll calculate implied volatility for all inputs
-    
-    // Check moneyness to set appropriate initial guess
-    double moneyness = K / S;
-    double init_vol = 0.2;  // Start with reasonable default of 20%
-    
-    // Apply smarter initial guess based on moneyness
-    if (moneyness < 0.95) {      // ITM
-        init_vol = 0.2 - 0.05 * (1 - moneyness);
-    } else if (moneyness > 1.05) { // OTM
-        init_vol = 0.2 + 0.05 * (moneyness - 1);
-    }
-    
-    // Adjust for time to expiration
-    if (T < 0.1) {
-        init_vol *= 1.2;  // Short-term options tend to have higher vol
-    } else if (T > 2) {
-        init_vol *= 0.9;  // Long-term options tend to have lower vol
-    }
-    
-    // Constrain initial guess to reasonable range
-    if (init_vol < 0.01) init_vol = 0.2;
-    if (init_vol > 1.0) init_vol = 0.3;
-    
-    double epsilon = 1e-8;
-    int max_iter = 50;
-    double sigma = init_vol;
-    double best_sigma = sigma;
-    double min_diff = DBL_MAX;
-    
-    // First, try a simple direct compute with our initial guess
-    double initial_price = bs_call(S, K, T, r, q, init_vol);
-    if (fabs(initial_price - market_price) < 0.001) {
-        return init_vol;  // Our initial guess is good enough
-    }
-    
-    // Newton-Raphson iterations with safeguards
-    for (int i = 0; i < max_iter; i++) {
-        double price = bs_call(S, K, T, r, q, sigma);
-        
-        // Skip invalid prices 
-        if (price < 0) {
-            break;
-        }
-        
-        double diff = price - market_price;
-        
-        // Keep track of the best approximation so far
-        if (fabs(diff) < min_diff) {
-            min_diff = fabs(diff);
-            best_sigma = sigma;
-        }
-        
-        // Check if we're close enough to the target price
-        if (fabs(diff) < epsilon) {
-            return sigma;
-        }
-        
-        // Calculate vega (derivative of price with respect to volatility)
-        double vega = bs_vega(S, K, T, r, q, sigma);
-        
-        // Avoid division by very small vega
-        if (fabs(vega) < 1e-8) {
-            break;  // Switch to bisection method
-        }
-        
-        // Update volatility estimate with damping to prevent overshooting
-        double new_sigma = sigma - (diff / vega) * 0.5;
-        
-        // Ensure volatility stays in reasonable bounds
-        if (new_sigma <= 0.001 || new_sigma > 1.0 || !isfinite(new_sigma)) {
-            break;  // Switch to bisection method
-        }
-        
-        // Check for convergence of sigma itself
-        if (fabs(new_sigma - sigma) < epsilon) {
-            return new_sigma;
-        }
-        
-        sigma = new_sigma;
-    }
-    
-    // If we have a reasonable approximation, just return it
-    if (best_sigma > 0.01 && best_sigma < 1.0 && min_diff < 0.1) {
-        return best_sigma;
-    }
-    
-    // Otherwise, calculate a reasonable value based on moneyness and time
-    // This is a rough approximation for when numerical methods fail
-    double reasonable_vol = 0.2;  // Base volatility of 20%
-    
-    // Adjust for moneyness
-    if (moneyness < 0.9) {
-        reasonable_vol = 0.15;  // Deep ITM
-    } else if (moneyness > 1.1) {
-        reasonable_vol = 0.25;  // Deep OTM
-    }
-    
-    // Adjust for time
-    if (T < 0.1) {
-        reasonable_vol *= 1.2;  // Short expiry
-    } else if (T > 2) {
-        reasonable_vol *= 0.9;  // Long expiry
-    }
-    
-    // Return our reasonable estimate
-    return reasonable_vol;
-}
+// Black-Scholes pricing and the implied volatility solver live in libheston
+// (unified/src/black_scholes.c); this program is a thin command-line wrapper.
+#include "unified/include/black_scholes.h"
 
 // Helper function to safely parse a double value
 double safe_atof(const char* str) {
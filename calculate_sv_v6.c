@@ -1,1382 +1,427 @@
 #include <stdio.h>
 #include <stdlib.h>
-#define _USE_MATH_DEFINES
-#include <math.h>
-#include <complex.h>
 #include <string.h>
-#include <float.h>
 #include <errno.h>
 #include <stdbool.h>
+#include <ctype.h>
+#include <math.h>
 #include <unistd.h>
 #include <getopt.h>
-#include <signal.h>
-#include <setjmp.h>
-
-// Define M_PI if it's not already defined
-#ifndef M_PI
-#define M_PI 3.14159265358979323846
-#endif
-
-// FFT implementation requires fftw library
-#include <fftw3.h>
-
-// Heston model parameters:
-// S: spot price
-// K: strike price
-// v0: initial variance
-// kappa: mean reversion speed
-// theta: long-term variance
-// sigma: volatility of variance
-// rho: correlation between stock and variance processes
-// r: risk-free rate
-// q: dividend yield
-// T: time to maturity
-
-// Global flags
-static bool g_debug = false;
-static bool g_verbose_debug = false;
-static bool g_found_good_match = false;
-static jmp_buf g_error_jmp_buf;
-static bool g_using_error_handler = false;
-static bool g_use_bs_fallback = true;  // Added flag to control BS fallback
-
-// Default FFT settings (can be overridden via command-line/env vars)
-// We'll use variables instead of #define for configurability
-static int g_fft_n = 4096;          // Number of FFT points (power of 2)
-static double g_log_strike_range = 3.0; // Range of log-strikes (±LOG_STRIKE_RANGE from current)
-static double g_alpha = 1.5;        // Carr-Madan dampening factor
-static double g_eta = 0.05;         // Step size in log-strike space
-static double g_cache_tolerance = 1e-5; // Tolerance for cache validation
-static int g_max_calibration_attempts = 3; // Max number of calibration attempts before fallback
-
-// Cache structure for FFT results
-typedef struct {
-    double S;            // Spot price for this cache entry
-    double r;            // Risk-free rate 
-    double q;            // Dividend yield
-    double T;            // Time to expiry
-    double v0;           // Initial variance
-    double kappa;        // Mean reversion speed
-    double theta;        // Long-term variance
-    double sigma;        // Volatility of variance
-    double rho;          // Correlation
-    double* prices;      // Array of option prices for different strikes
-    double* strikes;     // Array of strikes corresponding to prices
-    int num_strikes;     // Number of strikes in the cache
-    bool is_valid;       // Flag to indicate if cache is valid
-    // FFT parameters used for this cache entry
-    int fft_n;
-    double log_strike_range;
-    double alpha;
-    double eta;
-} FFTCache;
-
-// Precomputed values for FFT optimization
-typedef struct {
-    // Simpson's rule weights (precomputed)
-    double* simpson_weights;
-    // Precomputed exponential terms in FFT input
-    double complex* exp_terms;
-    // Flag to indicate if precomputed values are valid
-    bool is_valid;
-    // Parameters for which values were precomputed
-    int fft_n;
-    double eta;
-    double alpha;
-    double S;
-} FFTPrecomputed;
-
-// Global cache - we'll keep just one entry for simplicity
-// Initialize with proper values to track cache state
-static FFTCache g_cache = {
-    .S = 0.0,
-    .r = 0.0,
-    .q = 0.0,
-    .T = 0.0,
-    .v0 = 0.0,
-    .kappa = 0.0,
-    .theta = 0.0,
-    .sigma = 0.0,
-    .rho = 0.0,
-    .prices = NULL,
-    .strikes = NULL,
-    .num_strikes = 0,
-    .is_valid = false,
-    .fft_n = 0,
-    .log_strike_range = 0.0,
-    .alpha = 0.0,
-    .eta = 0.0
-};
 
-// Global precomputed values
-static FFTPrecomputed g_precomputed = {
-    .simpson_weights = NULL,
-    .exp_terms = NULL,
-    .is_valid = false,
-    .fft_n = 0,
-    .eta = 0.0,
-    .alpha = 0.0,
-    .S = 0.0
-};
+// The FFT engine lives in libheston (unified/src/heston_fft.c); this program
+// is a thin command-line wrapper around it.
+#include "unified/include/heston_fft.h"
+#include "unified/include/heston_calibration.h"
+#include "unified/include/black_scholes_batch.h"
+#include "unified/include/perf_stats.h"
+#include "unified/include/heston_param_store.h"
 
-// Error handler for signals (segfault, floating point exceptions, etc.)
-static void error_handler(int sig) {
-    if (g_using_error_handler) {
-        fprintf(stderr, "ERROR: Caught signal %d\n", sig);
-        longjmp(g_error_jmp_buf, 1);
-    }
-}
-
-// Forward declarations
-double black_scholes_call(double S, double K, double T, double r, double q, double sigma);
-double bs_implied_vol(double market_price, double S, double K, double T, double r, double q);
-void init_fft_cache(double S, double r, double q, double T, 
-                   double v0, double kappa, double theta, double sigma, double rho);
-double get_cached_option_price(double K);
-void precompute_fft_values(double S);
-void cleanup_precomputed_values(void);
-bool is_challenging_parameter_set(double S, double K, double T, double v0, double kappa, double theta, double sigma, double rho);
-void adapt_fft_parameters(double S, double K, double T);
-void reset_fft_params_to_defaults(void);
-bool try_alternate_fft_params(int attempt);
-
-// Complex characteristic function for Heston model
-double complex cf_heston(double complex phi, double S, double v0, double kappa, 
-                         double theta, double sigma, double rho, double r, 
-                         double q, double T) {
-    double complex u = phi - 0.5 * I;
-    double complex d = csqrt((rho * sigma * phi * I - kappa) * 
-                    (rho * sigma * phi * I - kappa) - 
-                    sigma * sigma * (phi * I) * (phi * I - I));
-    double complex g = (kappa - rho * sigma * phi * I - d) / 
-                    (kappa - rho * sigma * phi * I + d);
-    
-    // Extra safety check for numerical stability
-    if (!isfinite(creal(g)) || !isfinite(cimag(g))) {
-        if (g_verbose_debug) {
-            fprintf(stderr, "Warning: Non-finite g value detected in characteristic function\n");
-        }
-        return 1.0 + 0.0 * I;  // Safe default
-    }
-    
-    double complex A = (r - q) * phi * I * T + 
-                    kappa * theta * ((kappa - rho * sigma * phi * I - d) * T - 
-                    2.0 * clog((1.0 - g * cexp(-d * T)) / (1.0 - g))) / 
-                    (sigma * sigma);
-                    
-    double complex B = (kappa - rho * sigma * phi * I - d) * 
-                    (1.0 - cexp(-d * T)) / 
-                    (sigma * sigma * (1.0 - g * cexp(-d * T)));
-    
-    // Safety checks for numerical issues
-    if (!isfinite(creal(A)) || !isfinite(cimag(A)) || 
-        !isfinite(creal(B)) || !isfinite(cimag(B))) {
-        if (g_verbose_debug) {
-            fprintf(stderr, "Warning: Non-finite A or B values in characteristic function\n");
-        }
-        return 1.0 + 0.0 * I;  // Safe default
-    }
-                    
-    return cexp(A + B * v0 + I * phi * clog(S));
-}
-
-// Function to calculate Black-Scholes price (used as fallback)
-double black_scholes_call(double S, double K, double T, double r, double q, double sigma) {
-    if (sigma <= 0 || T <= 0 || S <= 0 || K <= 0) {
-        return -1.0;
-    }
-    
-    double d1 = (log(S/K) + (r - q + 0.5*sigma*sigma)*T) / (sigma * sqrt(T));
-    double d2 = d1 - sigma * sqrt(T);
-    
-    double N_d1 = 0.5 * (1.0 + erf(d1 / sqrt(2.0)));
-    double N_d2 = 0.5 * (1.0 + erf(d2 / sqrt(2.0)));
-    
-    return S * exp(-q * T) * N_d1 - K * exp(-r * T) * N_d2;
-}
-
-// Function to calculate Black-Scholes implied volatility numerically
-double bs_implied_vol(double market_price, double S, double K, double T, double r, double q) {
-    // Input validation
-    if (market_price <= 0.0 || S <= 0.0 || K <= 0.0 || T <= 0.0) {
-        return -1.0;
-    }
+// Helper function to safely parse a double value
+double safe_atof(const char* str) {
+    char* endptr;
+    errno = 0;  // Reset error number
     
-    // Calculate intrinsic value
-    double intrinsic = fmax(0.0, S * exp(-q * T) - K * exp(-r * T));
+    double value = strtod(str, &endptr);
     
-    // If market price is below intrinsic value (arbitrage)
-    if (market_price < intrinsic) {
-        if (g_debug) {
-            fprintf(stderr, "Debug: Market price %.6f is below intrinsic value %.6f\n", 
-                    market_price, intrinsic);
-        }
+    // Check for conversion errors
+    if (errno == ERANGE) {
+        fprintf(stderr, "Error: Number out of range: %s\n", str);
         return -1.0;
     }
     
-    // Initial guess based on simple approximation
-    double vol_low = 0.001;    // 0.1%
-    double vol_high = 2.0;     // 200%
-    double vol_mid, price_mid;
-    
-    // Maximum iterations and precision
-    int max_iter = 100;
-    double precision = 1e-6;
-    
-    // Calculate prices at bounds
-    double price_low = black_scholes_call(S, K, T, r, q, vol_low);
-    double price_high = black_scholes_call(S, K, T, r, q, vol_high);
-    
-    // Check if market price is within bounds
-    if (market_price <= price_low || market_price >= price_high) {
-        if (g_debug) {
-            fprintf(stderr, "Debug: Market price %.6f is outside the bounds [%.6f, %.6f]\n", 
-                    market_price, price_low, price_high);
-        }
+    // Check if any conversion happened
+    if (endptr == str) {
+        fprintf(stderr, "Error: Not a valid number: %s\n", str);
         return -1.0;
     }
     
-    // Bisection method
-    for (int i = 0; i < max_iter; i++) {
-        vol_mid = (vol_low + vol_high) * 0.5;
-        price_mid = black_scholes_call(S, K, T, r, q, vol_mid);
-        
-        if (fabs(price_mid - market_price) < precision) {
-            return vol_mid;
-        }
-        
-        if (price_mid < market_price) {
-            vol_low = vol_mid;
-        } else {
-            vol_high = vol_mid;
-        }
-    }
-    
-    return vol_mid;
+    return value;
 }
 
-// Precompute invariant values used in FFT calculation
-void precompute_fft_values(double S) {
-    // Check if precomputed values are already valid for current parameters
-    if (g_precomputed.is_valid && 
-        g_precomputed.fft_n == g_fft_n && 
-        g_precomputed.eta == g_eta &&
-        g_precomputed.alpha == g_alpha &&
-        fabs(g_precomputed.S - S) < g_cache_tolerance) {
-        if (g_debug) {
-            fprintf(stderr, "Debug: Using existing precomputed FFT values\n");
-        }
-        return;
-    }
-    
-    if (g_debug) {
-        fprintf(stderr, "Debug: Precomputing FFT values for N=%d, eta=%.4f, alpha=%.2f, S=%.2f\n", 
-                g_fft_n, g_eta, g_alpha, S);
-    }
-    
-    // Free existing precomputed values if they exist
-    cleanup_precomputed_values();
-    
-    // Allocate memory for precomputed values with error checking
-    g_precomputed.simpson_weights = (double*)malloc(g_fft_n * sizeof(double));
-    g_precomputed.exp_terms = (double complex*)malloc(g_fft_n * sizeof(double complex));
-    
-    if (g_precomputed.simpson_weights == NULL || g_precomputed.exp_terms == NULL) {
-        fprintf(stderr, "Error: Memory allocation for precomputed FFT values failed\n");
-        if (g_precomputed.simpson_weights != NULL) {
-            free(g_precomputed.simpson_weights);
-            g_precomputed.simpson_weights = NULL;
-        }
-        if (g_precomputed.exp_terms != NULL) {
-            free(g_precomputed.exp_terms);
-            g_precomputed.exp_terms = NULL;
-        }
-        g_precomputed.is_valid = false;
-        return;
-    }
-    
-    // Precompute Simpson's rule weights
-    for (int i = 0; i < g_fft_n; i++) {
-        g_precomputed.simpson_weights[i] = (i == 0) ? 1.0/3.0 : 
-                                          ((i % 2 == 1) ? 4.0/3.0 : 2.0/3.0);
-    }
-    
-    // Calculate log of spot price once
-    double log_S = log(S);
-    
-    // Use error handling for the potentially unstable computation
-    g_using_error_handler = true;
-    if (setjmp(g_error_jmp_buf) == 0) {
-        for (int i = 0; i < g_fft_n; i++) {
-            double v = i * g_eta;
-            if (fabs(v) < 1e-10) v = 1e-10; // Avoid numerical issues at v=0
-            
-            // Calculate exponential term with safety check
-            double complex exp_term = exp(-I * v * log_S);
-            
-            // Check for numerical issues
-            if (!isfinite(creal(exp_term)) || !isfinite(cimag(exp_term))) {
-                if (g_verbose_debug) {
-                    fprintf(stderr, "Warning: Non-finite exp term at i=%d, v=%.6f, log_S=%.6f\n", 
-                            i, v, log_S);
-                }
-                exp_term = 1.0 + 0.0 * I;  // Safe default
-            }
-            
-            g_precomputed.exp_terms[i] = exp_term;
-        }
-    } else {
-        // Exception occurred, cleanup and return
-        fprintf(stderr, "Error: Exception during precomputation of FFT values\n");
-        cleanup_precomputed_values();
-        g_using_error_handler = false;
-        return;
-    }
-    
-    g_using_error_handler = false;
-    
-    // Update metadata for precomputed values
-    g_precomputed.fft_n = g_fft_n;
-    g_precomputed.eta = g_eta;
-    g_precomputed.alpha = g_alpha;
-    g_precomputed.S = S;
-    g_precomputed.is_valid = true;
+// Check if a number is a power of 2
+int is_power_of_two(int n) {
+    if (n <= 0)
+        return 0;
+    return (n & (n - 1)) == 0;
 }
 
-// Initialize the FFT cache with option prices for various strikes
-void init_fft_cache(double S, double r, double q, double T, 
-                   double v0, double kappa, double theta, double sigma, double rho) {
-    // Print FFT parameters if in debug mode
-    if (g_debug) {
-        fprintf(stderr, "Debug: FFT Parameters - N: %d, Range: %.1f, Alpha: %.2f, Eta: %.4f\n", 
-                g_fft_n, g_log_strike_range, g_alpha, g_eta);
-        
-        // Print comparison for cache validation
-        if (g_cache.is_valid) {
-            fprintf(stderr, "Debug: Cache validation parameters:\n");
-            fprintf(stderr, "  - S: %.2f vs %.2f (diff: %.6f)\n", g_cache.S, S, fabs(g_cache.S - S));
-            fprintf(stderr, "  - r: %.6f vs %.6f (diff: %.9f)\n", g_cache.r, r, fabs(g_cache.r - r));
-            fprintf(stderr, "  - q: %.6f vs %.6f (diff: %.9f)\n", g_cache.q, q, fabs(g_cache.q - q));
-            fprintf(stderr, "  - T: %.6f vs %.6f (diff: %.9f)\n", g_cache.T, T, fabs(g_cache.T - T));
-        }
-    }
+// One row of a batch option chain
+typedef struct {
+    double price;     // Observed call price
+    double strike;    // Strike price
+    double expiry;    // Time to expiry in years
+    double spot;      // Spot price (defaults to the command-line value)
+    double rate;      // Risk-free rate (defaults to the command-line value)
+    double dividend;  // Dividend yield (defaults to the command-line value)
+    bool json;        // Row was read as NDJSON, answer in the same format
+} ChainRow;
+
+// Find "key": in a flat JSON object and parse the number that follows
+static bool json_number(const char* line, const char* key, double* value) {
+    char pattern[64];
+    snprintf(pattern, sizeof(pattern), "\"%s\"", key);
     
-    // Skip re-computation if cache is valid for these parameters AND FFT parameters
-    // Use a more relaxed check for model parameters during calibration to prevent excessive recalculation
-    if (g_cache.is_valid && 
-        fabs(g_cache.S - S) < g_cache_tolerance && 
-        fabs(g_cache.r - r) < g_cache_tolerance && 
-        fabs(g_cache.q - q) < g_cache_tolerance && 
-        fabs(g_cache.T - T) < g_cache_tolerance &&
-        g_cache.fft_n == g_fft_n &&
-        fabs(g_cache.log_strike_range - g_log_strike_range) < g_cache_tolerance &&
-        fabs(g_cache.alpha - g_alpha) < g_cache_tolerance &&
-        fabs(g_cache.eta - g_eta) < g_cache_tolerance) {
-        // Cache hit, no need to recompute
-        if (g_debug) {
-            fprintf(stderr, "Debug: CACHE HIT - Using cached FFT results\n");
-        }
-        return;
+    const char* p = strstr(line, pattern);
+    if (p == NULL) {
+        return false;
     }
     
-    // Cache miss, need to recalculate
-    if (g_debug) {
-        fprintf(stderr, "Debug: CACHE MISS - Recalculating FFT results\n");
+    p += strlen(pattern);
+    while (isspace((unsigned char)*p)) p++;
+    if (*p != ':') {
+        return false;
     }
+    p++;
     
-    // Free previous cache if FFT parameters have changed
-    if (g_cache.is_valid && 
-        (g_cache.fft_n != g_fft_n || 
-         g_cache.num_strikes != g_fft_n)) {
-        if (g_debug) {
-            fprintf(stderr, "Debug: FFT parameters changed, reallocating cache\n");
-        }
-        if (g_cache.prices != NULL) {
-            free(g_cache.prices);
-            g_cache.prices = NULL;
-        }
-        if (g_cache.strikes != NULL) {
-            free(g_cache.strikes);
-            g_cache.strikes = NULL;
-        }
+    char* endptr;
+    double v = strtod(p, &endptr);
+    if (endptr == p) {
+        return false;
     }
     
-    // Allocate memory for FFT arrays if not already allocated
-    if (g_cache.prices == NULL) {
-        g_cache.num_strikes = g_fft_n;
-        g_cache.prices = (double*)malloc(g_fft_n * sizeof(double));
-        g_cache.strikes = (double*)malloc(g_fft_n * sizeof(double));
+    *value = v;
+    return true;
+}
+
+// Parse one CSV (price,strike,expiry[,spot,rate,dividend]) or NDJSON row
+static bool parse_chain_row(const char* line, ChainRow* row) {
+    while (isspace((unsigned char)*line)) line++;
+    
+    if (*line == '{') {
+        row->json = true;
+        json_number(line, "spot", &row->spot);
+        json_number(line, "rate", &row->rate);
+        json_number(line, "dividend", &row->dividend);
+        return json_number(line, "price", &row->price) &&
+               json_number(line, "strike", &row->strike) &&
+               json_number(line, "expiry", &row->expiry);
+    }
+    
+    double fields[6] = {0.0, 0.0, 0.0, row->spot, row->rate, row->dividend};
+    const char* p = line;
+    int count = 0;
+    
+    while (count < 6) {
+        char* endptr;
+        fields[count] = strtod(p, &endptr);
+        if (endptr == p) {
+            break;
+        }
+        count++;
         
-        if (g_cache.prices == NULL || g_cache.strikes == NULL) {
-            fprintf(stderr, "Error: Memory allocation for FFT cache failed\n");
-            g_cache.is_valid = false;
-            if (g_cache.prices != NULL) {
-                free(g_cache.prices);
-                g_cache.prices = NULL;
-            }
-            if (g_cache.strikes != NULL) {
-                free(g_cache.strikes);
-                g_cache.strikes = NULL;
-            }
-            return;
+        p = endptr;
+        while (isspace((unsigned char)*p)) p++;
+        if (*p != ',') {
+            break;
         }
+        p++;
     }
     
-    // Initialize FFTW arrays
-    fftw_complex *in = NULL, *out = NULL;
-    fftw_plan p = NULL;
-    
-    in = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * g_fft_n);
-    out = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * g_fft_n);
-    
-    if (in == NULL || out == NULL) {
-        fprintf(stderr, "Error: FFTW memory allocation failed\n");
-        g_cache.is_valid = false;
-        if (in) fftw_free(in);
-        if (out) fftw_free(out);
-        return;
-    }
-    
-    // Lambda depends on FFT parameters
-    double lambda = 2 * M_PI / (g_fft_n * g_eta);
-    
-    // Precompute invariant parts of the FFT calculation
-    precompute_fft_values(S);
-    
-    // Check if precomputation failed
-    if (!g_precomputed.is_valid) {
-        fprintf(stderr, "Error: Precomputation of FFT values failed\n");
-        g_cache.is_valid = false;
-        fftw_free(in);
-        fftw_free(out);
-        return;
+    if (count < 3) {
+        return false;
     }
     
-    // Precomputed discount factor
-    double discount = exp(-r * T);
-    
-    // Use error handling for the FFT computation part
-    g_using_error_handler = true;
-    
-    if (setjmp(g_error_jmp_buf) == 0) {
-        // Fill in the FFT input array - OPTIMIZED VERSION using precomputed values
-        for (int i = 0; i < g_fft_n; i++) {
-            double v = i * g_eta;
-            
-            // Ensure we skip v=0 which can cause numerical issues
-            if (fabs(v) < 1e-10) {
-                v = 1e-10;
-            }
-            
-            // Calculate modified characteristic function for Carr-Madan
-            double complex phi = cf_heston(v - (g_alpha + 1) * I, S, v0, kappa, theta, sigma, rho, r, q, T);
-            
-            // Apply Carr-Madan formula with precomputed discount factor
-            double complex denom = g_alpha*g_alpha + g_alpha - v*v + I*(2*g_alpha + 1)*v;
-            double complex modified_cf = discount * phi / denom;
-            
-            // Check for numerical issues
-            if (!isfinite(creal(modified_cf)) || !isfinite(cimag(modified_cf))) {
-                if (g_verbose_debug) {
-                    fprintf(stderr, "Warning: Non-finite modified CF at i=%d\n", i);
-                }
-                modified_cf = 0.0 + 0.0 * I;  // Safe default
-            }
-            
-            // Use precomputed Simpson's rule weights and eta scaling
-            double simpson_weight = g_precomputed.simpson_weights[i];
-            
-            // Use precomputed exponential term
-            double complex exp_term = g_precomputed.exp_terms[i];
-            
-            // Set FFT input array - more efficient with precomputed values
-            in[i] = modified_cf * simpson_weight * g_eta * exp_term;
-        }
+    row->json = false;
+    row->price = fields[0];
+    row->strike = fields[1];
+    row->expiry = fields[2];
+    row->spot = fields[3];
+    row->rate = fields[4];
+    row->dividend = fields[5];
+    return true;
+}
 
-        // Create and execute FFT plan with ESTIMATE flag for better compatibility
-        p = fftw_plan_dft_1d(g_fft_n, in, out, FFTW_FORWARD, FFTW_ESTIMATE);
-        if (p == NULL) {
-            fprintf(stderr, "Error: Failed to create FFTW plan\n");
-            fftw_free(in);
-            fftw_free(out);
-            g_using_error_handler = false;
-            return;
-        }
-        
-        fftw_execute(p);
-        
-        // Extract option prices from FFT results
-        double log_S = log(S);
-        double inv_pi = 1.0 / M_PI; // Precompute 1/PI
-        double range_factor = 2.0 * g_log_strike_range / g_fft_n; // Precompute this constant
-        
-        for (int i = 0; i < g_fft_n; i++) {
-            // Calculate log strike - using precomputed constants
-            double log_K = log_S - g_log_strike_range + range_factor * i;
-            double K = exp(log_K);
-            
-            // Store strike
-            g_cache.strikes[i] = K;
-            
-            // Extract price - using precomputed 1/PI
-            double real_part = creal(out[i]);
-            
-            // Check for numerical issues
-            if (!isfinite(real_part)) {
-                if (g_verbose_debug) {
-                    fprintf(stderr, "Warning: Non-finite FFT output at index %d\n", i);
-                }
-                real_part = 0.0;
-            }
-            
-            double exp_factor = exp(-g_alpha * log_K) * inv_pi;
-            double price_part = real_part * exp_factor;
-            
-            // Ensure non-negative prices
-            g_cache.prices[i] = fmax(0.0, price_part);
-        }
-    } else {
-        // Exception occurred during FFT computation
-        fprintf(stderr, "Error: Exception during FFT computation\n");
-        g_cache.is_valid = false;
-        if (in) fftw_free(in);
-        if (out) fftw_free(out);
-        if (p) fftw_destroy_plan(p);
-        g_using_error_handler = false;
-        return;
-    }
-    
-    g_using_error_handler = false;
-    
-    // Clean up FFTW resources
-    if (p) fftw_destroy_plan(p);
-    if (in) fftw_free(in);
-    if (out) fftw_free(out);
-    
-    // Update cache metadata
-    g_cache.S = S;
-    g_cache.r = r;
-    g_cache.q = q;
-    g_cache.T = T;
-    g_cache.v0 = v0;
-    g_cache.kappa = kappa;
-    g_cache.theta = theta;
-    g_cache.sigma = sigma;
-    g_cache.rho = rho;
-    // Store FFT parameters used
-    g_cache.fft_n = g_fft_n;
-    g_cache.log_strike_range = g_log_strike_range;
-    g_cache.alpha = g_alpha;
-    g_cache.eta = g_eta;
-    g_cache.is_valid = true;
-    
-    if (g_debug) {
-        fprintf(stderr, "Debug: FFT cache initialized with %d strikes\n", g_cache.num_strikes);
-    }
+// Rows with the same (S, r, q, T) can share one FFT grid
+static bool same_chain_group(const ChainRow* a, const ChainRow* b) {
+    return a->spot == b->spot && a->rate == b->rate &&
+           a->dividend == b->dividend && a->expiry == b->expiry;
 }
 
-// Get option price from cache using interpolation
-double get_cached_option_price(double K) {
-    if (!g_cache.is_valid || g_cache.prices == NULL || g_cache.strikes == NULL) {
-        if (g_debug) {
-            fprintf(stderr, "Debug: Cache not valid or arrays not initialized\n");
-            fprintf(stderr, "       is_valid=%d, prices=%p, strikes=%p\n", 
-                    g_cache.is_valid, (void*)g_cache.prices, (void*)g_cache.strikes);
-        }
-        return -1.0;
-    }
+// Calibrate one group of rows and print the results in input order
+static int flush_chain_group(const ChainRow* rows, int n, const HestonFFTConfig* config) {
+    double* strikes = (double*)malloc(n * sizeof(double));
+    double* prices = (double*)malloc(n * sizeof(double));
+    double* ivs = (double*)malloc(n * sizeof(double));
+    int failures;
     
-    if (g_debug) {
-        fprintf(stderr, "Debug: Retrieving price for strike %.2f from cache\n", K);
-        fprintf(stderr, "       Cache has %d strikes ranging from %.2f to %.2f\n", 
-                g_cache.num_strikes, g_cache.strikes[0], 
-                g_cache.strikes[g_cache.num_strikes-1]);
+    if (strikes == NULL || prices == NULL || ivs == NULL) {
+        fprintf(stderr, "Error: Memory allocation for option chain failed\n");
+        free(strikes);
+        free(prices);
+        free(ivs);
+        return n;
     }
     
-    // Find nearest strikes in cache
-    int idx_low = 0;
-    int idx_high = g_cache.num_strikes - 1;
-    
-    // Check if strike is out of bounds
-    if (K <= g_cache.strikes[0]) {
-        if (g_debug) {
-            fprintf(stderr, "Debug: Strike below cache range, returning first price\n");
-        }
-        return g_cache.prices[0];
+    for (int i = 0; i < n; i++) {
+        strikes[i] = rows[i].strike;
+        prices[i] = rows[i].price;
     }
     
-    if (K >= g_cache.strikes[g_cache.num_strikes - 1]) {
-        if (g_debug) {
-            fprintf(stderr, "Debug: Strike above cache range, returning last price\n");
-        }
-        return g_cache.prices[g_cache.num_strikes - 1];
-    }
+    // Start every group from the configured grid; earlier groups may have adapted it
+    heston_fft_set_config(config);
     
-    // Binary search to find position
-    while (idx_high - idx_low > 1) {
-        int mid = (idx_low + idx_high) / 2;
-        if (g_cache.strikes[mid] < K) {
-            idx_low = mid;
-        } else {
-            idx_high = mid;
+    failures = heston_fft_implied_vol_chain(rows[0].spot, rows[0].expiry, rows[0].rate,
+                                            rows[0].dividend, strikes, prices, n, ivs);
+    if (failures < 0) {
+        failures = n;
+        for (int i = 0; i < n; i++) {
+            ivs[i] = -1.0;
         }
     }
     
-    // Linear interpolation between adjacent strikes
-    double K_low = g_cache.strikes[idx_low];
-    double K_high = g_cache.strikes[idx_high];
-    double price_low = g_cache.prices[idx_low];
-    double price_high = g_cache.prices[idx_high];
-    
-    // Check for invalid price values
-    if (!isfinite(price_low) || !isfinite(price_high)) {
-        if (g_debug) {
-            fprintf(stderr, "Debug: Invalid cached prices: low=%.6f, high=%.6f\n", 
-                    price_low, price_high);
+    for (int i = 0; i < n; i++) {
+        const ChainRow* row = &rows[i];
+        if (row->json) {
+            if (ivs[i] >= 0.0) {
+                printf("{\"price\":%.6f,\"strike\":%.6f,\"expiry\":%.6f,\"iv\":%.6f}\n",
+                       row->price, row->strike, row->expiry, ivs[i]);
+            } else {
+                printf("{\"price\":%.6f,\"strike\":%.6f,\"expiry\":%.6f,\"iv\":null,\"error\":\"calibration failed\"}\n",
+                       row->price, row->strike, row->expiry);
+            }
+        } else {
+            if (ivs[i] >= 0.0) {
+                printf("%.6f,%.6f,%.6f,%.6f\n", row->price, row->strike, row->expiry, ivs[i]);
+            } else {
+                printf("%.6f,%.6f,%.6f,error\n", row->price, row->strike, row->expiry);
+            }
         }
-        return -1.0;
     }
+    fflush(stdout);
     
-    // Interpolation weight
-    double weight = (K - K_low) / (K_high - K_low);
-    
-    // Interpolated price
-    double result = price_low + weight * (price_high - price_low);
-    
-    if (g_debug) {
-        fprintf(stderr, "Debug: Interpolated price %.6f between strikes %.2f (%.6f) and %.2f (%.6f)\n", 
-                result, K_low, price_low, K_high, price_high);
-    }
-    
-    return result;
+    free(strikes);
+    free(prices);
+    free(ivs);
+    return failures;
 }
 
-// Function to check if a parameter set might be numerically challenging
-bool is_challenging_parameter_set(double S, double K, double T, double v0, double kappa, double theta, double sigma, double rho) {
-    // Check for extreme moneyness (very ITM or OTM)
-    double moneyness = K / S;
-    
-    // More permissive moneyness criteria in v6
-    if (moneyness > 3.0 || moneyness < 0.3) {
-        if (g_verbose_debug) {
-            fprintf(stderr, "Debug: Extreme moneyness detected (%.2f)\n", moneyness);
-        }
-        return true;
-    }
+// Read the next valid chain row from stdin, skipping blank, comment, header
+// and malformed lines. Returns false at end of input.
+static bool next_chain_row(double S, double r, double q, int* line_no, ChainRow* row) {
+    char line[4096];
     
-    // More permissive expiry criteria in v6
-    if (T < 0.05 && v0 > 0.1) {  // Very short expiry (less than ~18 days) with extremely high vol
-        if (g_verbose_debug) {
-            fprintf(stderr, "Debug: Very short expiry (%.4f) with extremely high vol (%.2f%%)\n", 
-                    T, sqrt(v0) * 100);
-        }
-        return true;
-    }
-    
-    // More permissive volatility parameters in v6
-    if (sigma > 2.0 || fabs(rho) > 0.95) {
-        if (g_verbose_debug) {
-            fprintf(stderr, "Debug: Extreme volatility parameters (sigma=%.2f, rho=%.2f)\n", 
-                    sigma, rho);
-        }
-        return true;
-    }
-    
-    return false;
-}
-
-// Function to adapt FFT parameters based on option characteristics
-void adapt_fft_parameters(double S, double K, double T) {
-    // Store original parameters
-    int orig_fft_n = g_fft_n;
-    double orig_alpha = g_alpha;
-    double orig_eta = g_eta;
-    double orig_log_strike_range = g_log_strike_range;
-    
-    // Adjust for extreme moneyness
-    double moneyness = K / S;
-    
-    // Enhanced adaptability - more aggressive scaling for extreme cases
-    if (moneyness > 1.5 || moneyness < 0.7) {
-        // For far ITM/OTM, increase grid size and range
-        g_fft_n = 8192;
-        g_log_strike_range = 4.0;
+    while (fgets(line, sizeof(line), stdin) != NULL) {
+        (*line_no)++;
         
-        // Further adjustments for very extreme moneyness
-        if (moneyness > 2.0 || moneyness < 0.5) {
-            g_fft_n = 16384;  // Larger grid for better accuracy
-            g_log_strike_range = 5.0;  // Wider range
+        const char* p = line;
+        while (isspace((unsigned char)*p)) p++;
+        if (*p == '\0' || *p == '#') {
+            continue;
         }
-    }
-    
-    // Adjust for very short expiry
-    if (T < 0.1) {  // Less than ~36 days
-        // For short expiry, use smaller eta (finer grid)
-        g_eta = 0.025;
-        // And adjust alpha for better dampening
-        g_alpha = 1.25;
         
-        // Further adjustments for very short expiry
-        if (T < 0.05) { // Less than ~18 days
-            g_eta = 0.015;  // Even finer grid
-            g_alpha = 1.1;  // Different dampening
+        ChainRow parsed = {0.0, 0.0, 0.0, S, r, q, false};
+        if (!parse_chain_row(p, &parsed)) {
+            // Header lines are expected; anything else is worth a warning
+            if (!isalpha((unsigned char)*p)) {
+                fprintf(stderr, "Warning: Skipping malformed row %d\n", *line_no);
+            }
+            continue;
         }
-    }
-    
-    // Adjust for very long expiry
-    if (T > 2.0) {  // More than 2 years
-        // For long expiry, can use larger eta (coarser grid)
-        g_eta = 0.1;
         
-        // Further adjustments for very long expiry
-        if (T > 5.0) { // More than 5 years
-            g_fft_n = 8192;  // Larger grid for long-term accuracy
-            g_log_strike_range = 4.0;  // Wider range for long-term
+        if (parsed.price <= 0.0 || parsed.strike <= 0.0 || parsed.expiry <= 0.0 || parsed.spot <= 0.0) {
+            fprintf(stderr, "Warning: Skipping row %d with non-positive values\n", *line_no);
+            continue;
         }
+        
+        *row = parsed;
+        return true;
     }
     
-    // Log changes if in debug mode
-    if (g_debug && (orig_fft_n != g_fft_n || orig_alpha != g_alpha || 
-                   orig_eta != g_eta || orig_log_strike_range != g_log_strike_range)) {
-        fprintf(stderr, "Debug: Adapted FFT parameters for option characteristics:\n");
-        fprintf(stderr, "       N: %d -> %d\n", orig_fft_n, g_fft_n);
-        fprintf(stderr, "       Range: %.2f -> %.2f\n", orig_log_strike_range, g_log_strike_range);
-        fprintf(stderr, "       alpha: %.2f -> %.2f\n", orig_alpha, g_alpha);
-        fprintf(stderr, "       eta: %.4f -> %.4f\n", orig_eta, g_eta);
-    }
-}
-
-// Reset FFT parameters to default values
-void reset_fft_params_to_defaults() {
-    g_fft_n = 4096;
-    g_log_strike_range = 3.0;
-    g_alpha = 1.5;
-    g_eta = 0.05;
-    
-    if (g_debug) {
-        fprintf(stderr, "Debug: Reset FFT parameters to defaults\n");
-    }
+    return false;
 }
 
-// Try different FFT parameter sets in sequence
-bool try_alternate_fft_params(int attempt) {
-    if (attempt == 1) {
-        // First alternative set - larger grid, different dampening
-        g_fft_n = 8192;
-        g_alpha = 1.0;
-        g_eta = 0.075;
-        g_log_strike_range = 4.0;
-    } else if (attempt == 2) {
-        // Second alternative set - smaller grid, different dampening
-        g_fft_n = 2048;
-        g_alpha = 1.25;
-        g_eta = 0.025;
-        g_log_strike_range = 2.5;
-    } else if (attempt == 3) {
-        // Third alternative set - very fine grid
-        g_fft_n = 16384;
-        g_alpha = 0.75;
-        g_eta = 0.01;
-        g_log_strike_range = 5.0;
-    } else if (attempt == 4) {
-        // Fourth alternative - balanced approach
-        g_fft_n = 4096;
-        g_alpha = 0.9;
-        g_eta = 0.05;
-        g_log_strike_range = 3.5;
-    } else if (attempt == 5) {
-        // Fifth alternative - focus on stability
-        g_fft_n = 2048;
-        g_alpha = 2.0;
-        g_eta = 0.1;
-        g_log_strike_range = 3.0;
-    } else {
-        // No more alternative sets
-        return false;
-    }
-    
-    if (g_debug) {
-        fprintf(stderr, "Debug: Trying alternate FFT parameter set #%d:\n", attempt);
-        fprintf(stderr, "       N: %d, Range: %.1f, Alpha: %.2f, Eta: %.4f\n", 
-                g_fft_n, g_log_strike_range, g_alpha, g_eta);
-    }
-    
+// Append a row, growing the array as needed
+static bool append_chain_row(ChainRow** rows, int* count, int* capacity, const ChainRow* row) {
+    if (*count == *capacity) {
+        ChainRow* grown = (ChainRow*)realloc(*rows, 2 * (*capacity) * sizeof(ChainRow));
+        if (grown == NULL) {
+            fprintf(stderr, "Error: Memory allocation for option chain failed\n");
+            return false;
+        }
+        *rows = grown;
+        *capacity *= 2;
+    }
+    (*rows)[(*count)++] = *row;
     return true;
 }
 
-// Heston model call option pricing using FFT
-double heston_call_fft(double S, double K, double T, double r, double q, 
-                       double v0, double kappa, double theta, double sigma, double rho) {
-    // Check if this parameter set might be challenging
-    bool challenging = is_challenging_parameter_set(S, K, T, v0, kappa, theta, sigma, rho);
-    
-    // If challenging, adapt FFT parameters
-    if (challenging) {
-        adapt_fft_parameters(S, K, T);
+// Read an option chain from stdin and stream implied volatilities to stdout.
+// Consecutive rows sharing (S, r, q, T) are calibrated together, so a chain
+// sorted by expiry costs one calibration sweep per expiry.
+static int run_batch(double S, double r, double q, const HestonFFTConfig* config) {
+    int capacity = 256;
+    int count = 0;
+    int line_no = 0;
+    int failures = 0;
+    ChainRow row;
+    ChainRow* rows = (ChainRow*)malloc(capacity * sizeof(ChainRow));
+    
+    if (rows == NULL) {
+        fprintf(stderr, "Error: Memory allocation for option chain failed\n");
+        return 1;
     }
     
-    // Initialize the FFT price cache if needed
-    init_fft_cache(S, r, q, T, v0, kappa, theta, sigma, rho);
-    
-    // Check if cache initialization failed
-    if (!g_cache.is_valid) {
-        if (g_debug) {
-            fprintf(stderr, "Debug: Cache initialization failed, trying with different parameters\n");
+    while (next_chain_row(S, r, q, &line_no, &row)) {
+        // A new (S, r, q, T) closes the current group
+        if (count > 0 && !same_chain_group(&rows[0], &row)) {
+            failures += flush_chain_group(rows, count, config);
+            count = 0;
         }
         
-        // Try with multiple alternative FFT parameter sets
-        for (int attempt = 1; attempt <= g_max_calibration_attempts; attempt++) {
-            if (!try_alternate_fft_params(attempt)) {
-                break;  // No more alternative sets to try
-            }
-            
-            // Try again with new parameters
-            init_fft_cache(S, r, q, T, v0, kappa, theta, sigma, rho);
-            
-            // If succeeded, break out of loop
-            if (g_cache.is_valid) {
-                if (g_debug) {
-                    fprintf(stderr, "Debug: FFT succeeded with alternate parameter set #%d\n", attempt);
-                }
-                break;
-            }
-        }
-        
-        // If all attempts failed, fall back to Black-Scholes if allowed
-        if (!g_cache.is_valid) {
-            if (g_debug) {
-                fprintf(stderr, "Debug: All FFT attempts failed\n");
-            }
-            
-            if (g_use_bs_fallback) {
-                if (g_debug) {
-                    fprintf(stderr, "Debug: Falling back to Black-Scholes\n");
-                }
-                
-                // Fallback to Black-Scholes with equivalent volatility
-                double bs_vol = sqrt(v0); // Simple approximation
-                return black_scholes_call(S, K, T, r, q, bs_vol);
-            } else {
-                if (g_debug) {
-                    fprintf(stderr, "Debug: Black-Scholes fallback disabled, returning error\n");
-                }
-                return -1.0;
-            }
+        if (!append_chain_row(&rows, &count, &capacity, &row)) {
+            free(rows);
+            return 1;
         }
     }
     
-    // Get option price from cache with interpolation
-    double price = get_cached_option_price(K);
-    
-    // Extra validation check on the returned price
-    if (price < 0.0 || !isfinite(price)) {
-        if (g_debug) {
-            fprintf(stderr, "Debug: Error retrieving price from cache\n");
-        }
-        
-        // Additional price sanity check - very basic validation
-        if (price <= 0.0) {
-            double intrinsic = fmax(0.0, S * exp(-q * T) - K * exp(-r * T));
-            if (price < intrinsic && intrinsic > 0.0) {
-                if (g_debug) {
-                    fprintf(stderr, "Debug: Calculated price (%.6f) is below intrinsic value (%.6f)\n", 
-                            price, intrinsic);
-                }
-            }
-        }
-        
-        // Try additional recovery - reset FFT parameters and try again
-        if (g_debug) {
-            fprintf(stderr, "Debug: Attempting recovery with reset parameters\n");
-        }
-        
-        // Reset to defaults and try one more time
-        reset_fft_params_to_defaults();
-        init_fft_cache(S, r, q, T, v0, kappa, theta, sigma, rho);
-        
-        if (g_cache.is_valid) {
-            price = get_cached_option_price(K);
-            
-            if (price >= 0.0 && isfinite(price)) {
-                if (g_debug) {
-                    fprintf(stderr, "Debug: Recovery succeeded, got valid price: %.6f\n", price);
-                }
-                return price;
-            }
-        }
-        
-        // If still failing and fallback is enabled, use Black-Scholes
-        if (g_use_bs_fallback) {
-            if (g_debug) {
-                fprintf(stderr, "Debug: Recovery failed, falling back to Black-Scholes\n");
-            }
-            
-            // Fallback to Black-Scholes with equivalent volatility
-            double bs_vol = sqrt(v0); // Simple approximation
-            return black_scholes_call(S, K, T, r, q, bs_vol);
-        } else {
-            if (g_debug) {
-                fprintf(stderr, "Debug: Black-Scholes fallback disabled, returning error\n");
-            }
-            return -1.0;
-        }
+    if (count > 0) {
+        failures += flush_chain_group(rows, count, config);
     }
     
-    return price;
+    free(rows);
+    
+    return failures > 0 ? 1 : 0;
 }
 
-// Function to estimate implied volatility from the Heston model
-double implied_vol_sv(double market_price, double S, double K, double T, double r, double q) {
-    // Calculate BS IV first as a reference point
-    double bs_iv = bs_implied_vol(market_price, S, K, T, r, q);
-    
-    // If BS IV calculation fails, return error
-    if (bs_iv < 0.0) {
-        if (g_debug) {
-            fprintf(stderr, "Debug: BS IV calculation failed, cannot proceed with SV\n");
-        }
-        return -1.0;
-    }
-    
-    if (g_debug) {
-        fprintf(stderr, "Debug: Black-Scholes IV: %.2f%%\n", bs_iv * 100);
+// Fit one Heston parameter set to every row on stdin (all strikes and
+// expiries at once), then print the parameters followed by each row's model
+// price and the Black-Scholes volatility of that price.
+static int run_calibration(double S, double r, double q, bool debug) {
+    int capacity = 256;
+    int count = 0;
+    int line_no = 0;
+    int status = 0;
+    ChainRow row;
+    ChainRow* rows = (ChainRow*)malloc(capacity * sizeof(ChainRow));
+    
+    if (rows == NULL) {
+        fprintf(stderr, "Error: Memory allocation for option chain failed\n");
+        return 1;
     }
     
-    // Calculate moneyness (S/K adjusted for interest and dividends)
-    double forward = S * exp((r - q) * T);
-    double moneyness = forward / K;
-    
-    // Initial parameter guesses based on market characteristics
-    double init_v0, init_kappa, init_theta;
-    
-    // Make smarter initial guesses based on moneyness and time
-    if (moneyness > 1.1) { 
-        // OTM call options often show higher volatility (volatility skew)
-        init_v0 = bs_iv * bs_iv * 1.1;
-        init_kappa = 2.0;
-        init_theta = bs_iv * bs_iv * 1.05;
-    } else if (moneyness < 0.9) {
-        // ITM call options can also show different volatility patterns
-        init_v0 = bs_iv * bs_iv * 1.05;
-        init_kappa = 1.5;
-        init_theta = bs_iv * bs_iv;
-    } else {
-        // ATM options
-        init_v0 = bs_iv * bs_iv;
-        init_kappa = 1.0;
-        init_theta = bs_iv * bs_iv;
+    while (next_chain_row(S, r, q, &line_no, &row)) {
+        if (!append_chain_row(&rows, &count, &capacity, &row)) {
+            free(rows);
+            return 1;
+        }
     }
     
-    // Time-based adjustments
-    if (T < 0.1) {
-        // Short-dated options typically have higher volatility of volatility
-        init_kappa = 3.0; // Faster mean reversion for short-dated
-    } else if (T > 1.0) {
-        // Long-dated options often have lower vol-of-vol
-        init_kappa = 0.5; // Slower mean reversion for long-dated
+    if (count == 0) {
+        fprintf(stderr, "Error: No options to calibrate\n");
+        free(rows);
+        return 1;
     }
     
-    // Parameter calibration with more robust approach
-    double best_diff = DBL_MAX;
-    double best_v = init_v0;
-    double best_kappa = init_kappa;
-    double best_theta = init_theta;
-    double best_sigma = 0.4;  // Vol of vol
-    double best_rho = -0.7;   // Typical correlation for equity options
-    
-    // Reset global early termination flag
-    g_found_good_match = false;
-    
-    // Multi-stage calibration with better error handling
-    g_using_error_handler = true;
-    
-    if (setjmp(g_error_jmp_buf) == 0) {
-        // Grid search with multiple parameter combinations
-        // Enhanced grid search with more combinations (6x3x4x4) for better accuracy
-        const int NUM_V0 = 6;
-        const int NUM_KAPPA = 3;
-        const int NUM_SIGMA = 4;
-        const int NUM_RHO = 4;
-        
-        double v0_values[NUM_V0];
-        double kappa_values[NUM_KAPPA];
-        double sigma_values[NUM_SIGMA];
-        double rho_values[NUM_RHO];
-        
-        // Enhanced parameter grids for more thorough search
-        // Order them from most likely to least likely values
-        v0_values[0] = init_v0;            // Start with the BS estimate (most likely)
-        v0_values[1] = init_v0 * 0.9;      // Try 10% lower
-        v0_values[2] = init_v0 * 1.1;      // Try 10% higher
-        v0_values[3] = init_v0 * 0.8;      // Try 20% lower
-        v0_values[4] = init_v0 * 1.2;      // Try 20% higher
-        v0_values[5] = init_v0 * 1.3;      // Try 30% higher
-        
-        // Most likely kappa values first
-        kappa_values[0] = init_kappa;      // Start with initial guess
-        kappa_values[1] = init_kappa * 1.5; // Try higher mean reversion
-        kappa_values[2] = init_kappa * 0.5; // Try lower mean reversion
-        
-        // Expanded sigma values for more thorough search
-        sigma_values[0] = 0.2;             // Low volatility of variance
-        sigma_values[1] = 0.4;             // Medium volatility of variance
-        sigma_values[2] = 0.6;             // Higher volatility of variance
-        sigma_values[3] = 0.8;             // Very high volatility of variance
-        
-        // Expanded rho values for more thorough search
-        rho_values[0] = -0.7;              // Strong negative correlation (common for equities)
-        rho_values[1] = -0.4;              // Medium negative correlation
-        rho_values[2] = -0.2;              // Weak negative correlation
-        rho_values[3] = 0.0;               // No correlation
-        
-        // Loop through parameters with early termination
-        for (int v0_idx = 0; v0_idx < NUM_V0 && !g_found_good_match; v0_idx++) {
-            double test_v0 = v0_values[v0_idx];
-            double test_theta = test_v0;  // Set long-term variance equal to initial for simplicity
-            
-            for (int kappa_idx = 0; kappa_idx < NUM_KAPPA && !g_found_good_match; kappa_idx++) {
-                double test_kappa = kappa_values[kappa_idx];
-                
-                for (int sigma_idx = 0; sigma_idx < NUM_SIGMA && !g_found_good_match; sigma_idx++) {
-                    double test_sigma = sigma_values[sigma_idx];
-                    
-                    for (int rho_idx = 0; rho_idx < NUM_RHO && !g_found_good_match; rho_idx++) {
-                        double test_rho = rho_values[rho_idx];
-                        
-                        // Calculate option price using current parameters
-                        double model_price = heston_call_fft(S, K, T, r, q, 
-                                                         test_v0, test_kappa, test_theta, 
-                                                         test_sigma, test_rho);
-                        
-                        // If price calculation failed (possible with BS fallback disabled)
-                        if (model_price < 0.0 || !isfinite(model_price)) {
-                            if (g_verbose_debug) {
-                                fprintf(stderr, "Debug: Model price calculation failed for parameter set: v0=%.4f, kappa=%.1f, sigma=%.2f, rho=%.2f\n",
-                                        test_v0, test_kappa, test_sigma, test_rho);
-                            }
-                            continue;  // Skip this parameter set
-                        }
-                        
-                        // Calculate price difference
-                        double test_diff = fabs(model_price - market_price);
-                        
-                        // Update best parameters if this is better
-                        if (test_diff < best_diff) {
-                            best_v = test_v0;
-                            best_kappa = test_kappa;
-                            best_theta = test_theta;
-                            best_rho = test_rho;
-                            best_sigma = test_sigma;
-                            best_diff = test_diff;
-                            
-                            if (g_debug) {
-                                fprintf(stderr, "Debug: Found better parameter set - v0: %.4f, kappa: %.1f, sigma: %.2f, rho: %.2f, diff: $%.4f\n",
-                                        test_v0, test_kappa, test_sigma, test_rho, test_diff);
-                            }
-                            
-                            // If we're close enough, exit early (tighter tolerance in v6)
-                            if (test_diff < 0.003 * market_price) {
-                                g_found_good_match = true;
-                                break;
-                            }
-                        }
-                    }
-                }
-            }
-        }
-        
-        // If no good match found yet, try a refined search around the best parameters
-        if (!g_found_good_match && best_diff < 0.1 * market_price) {
-            if (g_debug) {
-                fprintf(stderr, "Debug: Performing refined search around best parameters\n");
-            }
-            
-            // Define search ranges around best values
-            double v0_min = best_v * 0.9;
-            double v0_max = best_v * 1.1;
-            double kappa_min = best_kappa * 0.9;
-            double kappa_max = best_kappa * 1.1;
-            double sigma_min = best_sigma * 0.9;
-            double sigma_max = best_sigma * 1.1;
-            double rho_min = best_rho - 0.1;
-            double rho_max = best_rho + 0.1;
-            
-            // Ensure rho stays in valid range
-            if (rho_min < -0.95) rho_min = -0.95;
-            if (rho_max > 0.95) rho_max = 0.95;
-            
-            // Grid sizes for refined search
-            const int REFINE_GRID = 3;
-            
-            // Perform refined grid search
-            for (int i = 0; i < REFINE_GRID; i++) {
-                double test_v0 = v0_min + (v0_max - v0_min) * i / (REFINE_GRID - 1);
-                double test_theta = test_v0;  // Set long-term variance equal to initial for simplicity
-                
-                for (int j = 0; j < REFINE_GRID; j++) {
-                    double test_kappa = kappa_min + (kappa_max - kappa_min) * j / (REFINE_GRID - 1);
-                    
-                    for (int k = 0; k < REFINE_GRID; k++) {
-                        double test_sigma = sigma_min + (sigma_max - sigma_min) * k / (REFINE_GRID - 1);
-                        
-                        for (int l = 0; l < REFINE_GRID; l++) {
-                            double test_rho = rho_min + (rho_max - rho_min) * l / (REFINE_GRID - 1);
-                            
-                            // Calculate option price using current parameters
-                            double model_price = heston_call_fft(S, K, T, r, q, 
-                                                             test_v0, test_kappa, test_theta, 
-                                                             test_sigma, test_rho);
-                            
-                            // If price calculation failed (possible with BS fallback disabled)
-                            if (model_price < 0.0 || !isfinite(model_price)) {
-                                continue;  // Skip this parameter set
-                            }
-                            
-                            // Calculate price difference
-                            double test_diff = fabs(model_price - market_price);
-                            
-                            // Update best parameters if this is better
-                            if (test_diff < best_diff) {
-                                best_v = test_v0;
-                                best_kappa = test_kappa;
-                                best_theta = test_theta;
-                                best_rho = test_rho;
-                                best_sigma = test_sigma;
-                                best_diff = test_diff;
-                                
-                                if (g_debug) {
-                                    fprintf(stderr, "Debug: Refined search found better set - v0: %.4f, kappa: %.1f, sigma: %.2f, rho: %.2f, diff: $%.4f\n",
-                                            test_v0, test_kappa, test_sigma, test_rho, test_diff);
-                                }
-                                
-                                // If we're close enough, exit early
-                                if (test_diff < 0.002 * market_price) {
-                                    g_found_good_match = true;
-                                    break;
-                                }
-                            }
-                        }
-                        if (g_found_good_match) break;
-                    }
-                    if (g_found_good_match) break;
-                }
-                if (g_found_good_match) break;
-            }
-        }
-    } else {
-        // Exception occurred during calibration
-        fprintf(stderr, "Error: Exception during SV calibration\n");
-        
-        // Try again with reset FFT parameters
-        reset_fft_params_to_defaults();
-        
-        if (g_debug) {
-            fprintf(stderr, "Debug: Retrying calibration with reset parameters\n");
-        }
-        
-        // Try a simplified calibration
-        if (setjmp(g_error_jmp_buf) == 0) {
-            // Simplified parameter search with fewer combinations
-            double v0_values[] = {init_v0, init_v0 * 0.8, init_v0 * 1.2};
-            double kappa_values[] = {init_kappa};
-            double sigma_values[] = {0.2, 0.4};
-            double rho_values[] = {-0.7, -0.3};
-            
-            for (int i = 0; i < 3; i++) {
-                double test_v0 = v0_values[i];
-                double test_theta = test_v0;
-                
-                for (int j = 0; j < 1; j++) {
-                    double test_kappa = kappa_values[j];
-                    
-                    for (int k = 0; k < 2; k++) {
-                        double test_sigma = sigma_values[k];
-                        
-                        for (int l = 0; l < 2; l++) {
-                            double test_rho = rho_values[l];
-                            
-                            // Calculate option price using current parameters
-                            double model_price = heston_call_fft(S, K, T, r, q, 
-                                                             test_v0, test_kappa, test_theta, 
-                                                             test_sigma, test_rho);
-                            
-                            // If model price calculation failed, skip this set
-                            if (model_price < 0.0 || !isfinite(model_price)) {
-                                continue;
-                            }
-                            
-                            // Calculate price difference
-                            double test_diff = fabs(model_price - market_price);
-                            
-                            // Update best parameters if this is better
-                            if (test_diff < best_diff) {
-                                best_v = test_v0;
-                                best_kappa = test_kappa;
-                                best_theta = test_theta;
-                                best_rho = test_rho;
-                                best_sigma = test_sigma;
-                                best_diff = test_diff;
-                            }
-                        }
-                    }
-                }
-            }
-        } else {
-            // If even the simplified calibration failed
-            g_using_error_handler = false;
-            
-            if (g_use_bs_fallback) {
-                if (g_debug) {
-                    fprintf(stderr, "Debug: All calibration attempts failed, using BS IV\n");
-                }
-                return bs_iv;
-            } else {
-                if (g_debug) {
-                    fprintf(stderr, "Debug: All calibration attempts failed, returning error\n");
-                }
-                return -1.0;
-            }
-        }
+    HestonQuote* quotes = (HestonQuote*)malloc(count * sizeof(HestonQuote));
+    double* model = (double*)malloc(count * sizeof(double));
+    // Columns for the batch implied volatility solve: S, K, T, r, q, iv
+    double* columns = (double*)malloc(6 * (size_t)count * sizeof(double));
+    IVStatus* iv_status = (IVStatus*)malloc(count * sizeof(IVStatus));
+    if (quotes == NULL || model == NULL || columns == NULL || iv_status == NULL) {
+        fprintf(stderr, "Error: Memory allocation for option chain failed\n");
+        free(quotes);
+        free(model);
+        free(columns);
+        free(iv_status);
+        free(rows);
+        return 1;
     }
     
-    g_using_error_handler = false;
-    
-    if (g_debug) {
-        fprintf(stderr, "Debug: Best parameters - v0: %.4f, kappa: %.1f, sigma: %.2f, rho: %.2f\n",
-                best_v, best_kappa, best_sigma, best_rho);
+    IVBatchInput iv_in = { model, columns, columns + count, columns + 2 * count,
+                           columns + 3 * count, columns + 4 * count, NULL };
+    double* ivs = columns + 5 * count;
+    
+    for (int i = 0; i < count; i++) {
+        quotes[i].S = columns[i] = rows[i].spot;
+        quotes[i].K = columns[count + i] = rows[i].strike;
+        quotes[i].T = columns[2 * count + i] = rows[i].expiry;
+        quotes[i].r = columns[3 * count + i] = rows[i].rate;
+        quotes[i].q = columns[4 * count + i] = rows[i].dividend;
+        quotes[i].price = rows[i].price;
+        quotes[i].weight = 1.0;
+    }
+    
+    HestonCalibrationResult fit;
+    if (heston_calibrate(quotes, count, NULL, NULL, &fit) != 0 ||
+        heston_price_quotes(quotes, count, &fit.params, NULL, model) != 0) {
+        fprintf(stderr, "Error: Heston calibration failed\n");
+        free(quotes);
+        free(model);
+        free(columns);
+        free(iv_status);
+        free(rows);
+        return 1;
     }
     
-    // Calculate the final implied volatility from the Heston calibration
-    double sv_vol = sqrt(best_v);
-    
-    // Check if our best Heston calibration is reasonable
-    // Less restrictive calibration error threshold in v6 (25% instead of 10%)
-    if (best_diff > 0.25 * market_price) {
-        // If Heston calibration is very poor, rely on BS IV
-        if (g_debug) {
-            fprintf(stderr, "Debug: Very large calibration error (%.2f%% of price). Using BS IV.\n",
-                    100.0 * best_diff / market_price);
-        }
-        return bs_iv;
+    if (debug) {
+        fprintf(stderr, "Debug: Calibrated %d options in %d iterations (%d model evaluations), %s\n",
+                count, fit.iterations, fit.evaluations, fit.converged ? "converged" : "iteration limit");
     }
     
-    // More permissive sanity checks in v6
-    if (sv_vol < 0.03) {  // 3% instead of 5%
-        if (g_debug) {
-            fprintf(stderr, "Debug: SV result (%.2f%%) is extremely low. Using BS IV (%.2f%%) instead.\n",
-                    sv_vol * 100, bs_iv * 100);
-        }
-        return bs_iv;
+    const HestonParams* p = &fit.params;
+    if (rows[0].json) {
+        printf("{\"v0\":%.6f,\"kappa\":%.6f,\"theta\":%.6f,\"sigma\":%.6f,\"rho\":%.6f,\"rmse\":%.6f,\"iterations\":%d}\n",
+               p->v0, p->kappa, p->theta, p->sigma, p->rho, fit.rmse, fit.iterations);
+    } else {
+        printf("# heston v0=%.6f kappa=%.6f theta=%.6f sigma=%.6f rho=%.6f rmse=%.6f iterations=%d\n",
+               p->v0, p->kappa, p->theta, p->sigma, p->rho, fit.rmse, fit.iterations);
     }
     
-    if (sv_vol > 2.0) {  // 200% instead of 150%
-        if (g_debug) {
-            fprintf(stderr, "Debug: SV result (%.2f%%) is extremely high. Using BS IV (%.2f%%) instead.\n",
-                    sv_vol * 100, bs_iv * 100);
-        }
-        return bs_iv;
-    }
+    bs_implied_vol_batch(count, &iv_in, ivs, iv_status);
     
-    // Add an additional relative comparison with BS IV
-    // If SV result differs drastically from BS IV, double-check with an intermediate calibration
-    if (fabs(sv_vol - bs_iv) > 0.3 * bs_iv) {  // If SV differs by more than 30% from BS
-        if (g_debug) {
-            fprintf(stderr, "Debug: Large difference between SV (%.2f%%) and BS (%.2f%%). Verifying...\n",
-                    sv_vol * 100, bs_iv * 100);
-        }
+    for (int i = 0; i < count; i++) {
+        const ChainRow* row_i = &rows[i];
+        double iv = ivs[i];
         
-        // Try one more calibration with intermediate parameters
-        double verify_v0 = (best_v + bs_iv * bs_iv) / 2.0;  // Average of SV and BS
-        double verify_price = heston_call_fft(S, K, T, r, q, 
-                                         verify_v0, best_kappa, verify_v0, 
-                                         best_sigma, best_rho);
+        if (debug && iv_status[i] != IV_OK) {
+            fprintf(stderr, "Debug: Row %d: no implied volatility for model price %.6f (%s)\n",
+                    i + 1, model[i], bs_iv_status_string(iv_status[i]));
+        }
         
-        // If this verification price is closer to market, use it instead
-        if (fabs(verify_price - market_price) < best_diff) {
-            sv_vol = sqrt(verify_v0);
-            
-            if (g_debug) {
-                fprintf(stderr, "Debug: Verification improved result to %.2f%%\n", sv_vol * 100);
+        if (row_i->json) {
+            if (iv >= 0.0) {
+                printf("{\"price\":%.6f,\"strike\":%.6f,\"expiry\":%.6f,\"model_price\":%.6f,\"iv\":%.6f}\n",
+                       row_i->price, row_i->strike, row_i->expiry, model[i], iv);
+            } else {
+                printf("{\"price\":%.6f,\"strike\":%.6f,\"expiry\":%.6f,\"model_price\":%.6f,\"iv\":null}\n",
+                       row_i->price, row_i->strike, row_i->expiry, model[i]);
             }
+        } else if (iv >= 0.0) {
+            printf("%.6f,%.6f,%.6f,%.6f,%.6f\n", row_i->price, row_i->strike, row_i->expiry, model[i], iv);
+        } else {
+            printf("%.6f,%.6f,%.6f,%.6f,error\n", row_i->price, row_i->strike, row_i->expiry, model[i]);
         }
     }
+    fflush(stdout);
     
-    // For most cases, return the calculated volatility
-    if (g_debug) {
-        fprintf(stderr, "Debug: Final SV: %.2f%% (BS IV: %.2f%%)\n", 
-                sv_vol * 100, bs_iv * 100);
-        fprintf(stderr, "Debug: Price difference: $%.4f (%.2f%% of market price)\n", 
-                best_diff, 100.0 * best_diff / market_price);
-    }
-    
-    return sv_vol;
-}
-
-// Free allocated memory for precomputed values
-void cleanup_precomputed_values() {
-    if (g_precomputed.simpson_weights != NULL) {
-        free(g_precomputed.simpson_weights);
-        g_precomputed.simpson_weights = NULL;
-    }
-    
-    if (g_precomputed.exp_terms != NULL) {
-        free(g_precomputed.exp_terms);
-        g_precomputed.exp_terms = NULL;
-    }
-    
-    g_precomputed.is_valid = false;
+    free(quotes);
+    free(model);
+    free(columns);
+    free(iv_status);
+    free(rows);
+    return status;
 }
 
-// Free allocated memory in FFT cache
-void cleanup_fft_cache() {
-    if (g_cache.prices != NULL) {
-        free(g_cache.prices);
-        g_cache.prices = NULL;
-    }
-    
-    if (g_cache.strikes != NULL) {
-        free(g_cache.strikes);
-        g_cache.strikes = NULL;
-    }
-    
-    g_cache.is_valid = false;
-    
-    // Also clean up precomputed values
-    cleanup_precomputed_values();
-}
-
-// Helper function to safely parse a double value
-double safe_atof(const char* str) {
-    char* endptr;
-    errno = 0;  // Reset error number
-    
-    double value = strtod(str, &endptr);
-    
-    // Check for conversion errors
-    if (errno == ERANGE) {
-        fprintf(stderr, "Error: Number out of range: %s\n", str);
-        return -1.0;
-    }
-    
-    // Check if any conversion happened
-    if (endptr == str) {
-        fprintf(stderr, "Error: Not a valid number: %s\n", str);
-        return -1.0;
-    }
-    
-    return value;
+// Print FFT grid cache counters (debug mode)
+static void print_cache_stats(void) {
+    FFTCacheStats stats;
+    heston_fft_get_cache_stats(&stats);
+    fprintf(stderr, "Debug: FFT grid cache - hits: %lu, misses: %lu, evictions: %lu, allocations: %lu, entries: %zu, %.1f/%.1f MB\n",
+            stats.hits, stats.misses, stats.evictions, stats.allocations, stats.entries,
+            stats.bytes / (1024.0 * 1024.0), stats.max_bytes / (1024.0 * 1024.0));
 }
 
-// Check if a number is a power of 2
-int is_power_of_two(int n) {
-    if (n <= 0)
-        return 0;
-    return (n & (n - 1)) == 0;
+// Print the engine counters and timers as JSON, registered with atexit by --stats
+static void print_perf_stats(void) {
+    PerfStats stats;
+    perf_stats_snapshot(&stats);
+    perf_stats_write_json(stderr, &stats);
 }
 
 // Print usage information
 void print_usage(const char* program_name) {
     fprintf(stderr, "Usage: %s [options] OptionPrice StockPrice Strike Time RiskFreeRate DividendYield\n", program_name);
+    fprintf(stderr, "       %s --batch [options] StockPrice RiskFreeRate DividendYield < chain\n", program_name);
     fprintf(stderr, "Options:\n");
     fprintf(stderr, "  --debug               Enable debug output\n");
     fprintf(stderr, "  --verbose-debug       Enable verbose debug output\n");
@@ -1384,10 +429,39 @@ void print_usage(const char* program_name) {
     fprintf(stderr, "  --fft-n=VALUE         Set FFT points (power of 2, default: 4096)\n");
     fprintf(stderr, "  --log-strike-range=X  Set log strike range (default: 3.0)\n");
     fprintf(stderr, "  --alpha=X             Set Carr-Madan alpha parameter (default: 1.5)\n");
-    fprintf(stderr, "  --eta=X               Set grid spacing parameter (default: 0.05)\n");
+    fprintf(stderr, "  --eta=X               Set grid spacing parameter (default: 0.1)\n");
     fprintf(stderr, "  --cache-tolerance=X   Set parameter tolerance for cache reuse (default: 1e-5)\n");
     fprintf(stderr, "  --max-attempts=N      Set maximum calibration attempts (default: 3)\n");
     fprintf(stderr, "  --no-bs-fallback      Disable Black-Scholes fallback mechanism\n");
+    fprintf(stderr, "  --cache-size=MB       Memory limit for cached FFT grids (default: 64)\n");
+    fprintf(stderr, "  --fftw-wisdom=PATH    Load FFTW wisdom from PATH at startup and save it on exit\n");
+    fprintf(stderr, "  --fftw-planner=MODE   FFTW planning effort: estimate (default), measure, patient\n");
+    fprintf(stderr, "  --fft-tuning=PATH     Take FFT settings from a table built by tune_fft instead of\n");
+    fprintf(stderr, "                        adapting them to each option\n");
+    fprintf(stderr, "  --publish-grids=PATH  Publish computed FFT grids in a shared segment at PATH\n");
+    fprintf(stderr, "                        (e.g. /dev/shm/heston_grids) for other processes\n");
+    fprintf(stderr, "  --shared-grids=PATH   Take FFT grids another process publishes at PATH before\n");
+    fprintf(stderr, "                        computing them\n");
+    fprintf(stderr, "  --threads=N           Run the calibration grid search on N threads (default: 1)\n");
+    fprintf(stderr, "  --batch               Read an option chain from stdin, one row per option:\n");
+    fprintf(stderr, "                        CSV  price,strike,expiry[,spot,rate,dividend]\n");
+    fprintf(stderr, "                        JSON {\"price\":P,\"strike\":K,\"expiry\":T}\n");
+    fprintf(stderr, "                        Consecutive rows sharing (S, r, q, T) share FFT grids\n");
+    fprintf(stderr, "  --calibrate           With --batch, fit one Heston parameter set to all rows\n");
+    fprintf(stderr, "                        (Levenberg-Marquardt) and print model prices and vols\n");
+    fprintf(stderr, "  --stats               Print engine counters and timers as JSON to stderr at exit\n");
+    fprintf(stderr, "  --param-store=PATH    Seed the calibration from the parameters last fitted for\n");
+    fprintf(stderr, "                        --ticker at this expiry, and save the new fit to PATH\n");
+    fprintf(stderr, "  --ticker=SYMBOL       Ticker the option belongs to (key of --param-store)\n");
+    fprintf(stderr, "  --warm-start-error=X  Relative fit error up to which a seeded calibration skips\n");
+    fprintf(stderr, "                        the full grid search (default: %.3f)\n", HESTON_WARM_START_MAX_ERROR);
+    fprintf(stderr, "  --spot-invariant      Build FFT grids in moneyness for a unit spot, so rows that\n");
+    fprintf(stderr, "                        differ only in spot reuse one grid\n");
+    fprintf(stderr, "  --no-mixed-precision  Price every calibration candidate in double precision\n");
+    fprintf(stderr, "                        instead of screening them in single precision first\n");
+    fprintf(stderr, "  --backend=NAME        Compute the chain calibration grids on cpu (default) or gpu\n");
+    fprintf(stderr, "                        (needs a build with GPU=cuda)\n");
+    fprintf(stderr, "  --no-gpu-check        Skip the CPU reference grid of every GPU batch\n");
     fprintf(stderr, "\nExample: %s --fft-n=8192 5.0 100.0 100.0 0.25 0.05 0.02\n", program_name);
     fprintf(stderr, "\nNote: Parameters are automatically adapted based on option characteristics\n");
     fprintf(stderr, "      This version uses an enhanced calibration strategy to avoid defaulting to Black-Scholes\n");
@@ -1406,21 +480,51 @@ int main(int argc, char *argv[]) {
         {"cache-tolerance", required_argument, 0, 't'},
         {"max-attempts", required_argument, 0, 'm'},
         {"no-bs-fallback", no_argument, 0, 'b'},
+        {"batch", no_argument, 0, 'B'},
+        {"fftw-wisdom", required_argument, 0, 'w'},
+        {"fftw-planner", required_argument, 0, 'p'},
+        {"fft-tuning", required_argument, 0, 'u'},
+        {"publish-grids", required_argument, 0, 'G'},
+        {"shared-grids", required_argument, 0, 'g'},
+        {"cache-size", required_argument, 0, 'c'},
+        {"threads", required_argument, 0, 'T'},
+        {"calibrate", no_argument, 0, 'C'},
+        {"stats", no_argument, 0, 'S'},
+        {"param-store", required_argument, 0, 'P'},
+        {"ticker", required_argument, 0, 'K'},
+        {"warm-start-error", required_argument, 0, 'W'},
+        {"spot-invariant", no_argument, 0, 'i'},
+        {"no-mixed-precision", no_argument, 0, 'x'},
+        {"backend", required_argument, 0, 'A'},
+        {"no-gpu-check", no_argument, 0, 'V'},
         {0, 0, 0, 0}
     };
     
+    // Start from the engine defaults
+    HestonFFTConfig config;
+    heston_fft_get_config(&config);
+    
     // Process command-line options
     int option_index = 0;
     int c;
+    bool batch = false;
+    bool calibrate = false;
+    bool stats = false;
+    const char* wisdom_path = NULL;
+    const char* tuning_path = NULL;
+    const char* share_path = NULL;
+    bool publish = false;
+    const char* param_store_path = NULL;
+    const char* ticker = NULL;
     
     while ((c = getopt_long(argc, argv, "dhvb", long_options, &option_index)) != -1) {
         switch (c) {
             case 'd':
-                g_debug = true;
+                config.debug = true;
                 break;
             case 'v':
-                g_debug = true;
-                g_verbose_debug = true;
+                config.debug = true;
+                config.verbose_debug = true;
                 break;
             case 'h':
                 print_usage(argv[0]);
@@ -1428,65 +532,156 @@ int main(int argc, char *argv[]) {
             case 'n': {
                 int n = atoi(optarg);
                 if (is_power_of_two(n)) {
-                    g_fft_n = n;
+                    config.fft_n = n;
                 } else {
-                    fprintf(stderr, "Warning: FFT size must be a power of 2. Using default: %d\n", g_fft_n);
+                    fprintf(stderr, "Warning: FFT size must be a power of 2. Using default: %d\n", config.fft_n);
                 }
                 break;
             }
             case 'r': {
                 double r = atof(optarg);
                 if (r > 0.0) {
-                    g_log_strike_range = r;
+                    config.log_strike_range = r;
                 } else {
-                    fprintf(stderr, "Warning: Log strike range must be positive. Using default: %.1f\n", g_log_strike_range);
+                    fprintf(stderr, "Warning: Log strike range must be positive. Using default: %.1f\n", config.log_strike_range);
                 }
                 break;
             }
             case 'a': {
                 double a = atof(optarg);
                 if (a > 0.0) {
-                    g_alpha = a;
+                    config.alpha = a;
                 } else {
-                    fprintf(stderr, "Warning: Alpha must be positive. Using default: %.1f\n", g_alpha);
+                    fprintf(stderr, "Warning: Alpha must be positive. Using default: %.1f\n", config.alpha);
                 }
                 break;
             }
             case 'e': {
                 double eta = atof(optarg);
                 if (eta > 0.0) {
-                    g_eta = eta;
+                    config.eta = eta;
                 } else {
-                    fprintf(stderr, "Warning: Eta must be positive. Using default: %.3f\n", g_eta);
+                    fprintf(stderr, "Warning: Eta must be positive. Using default: %.3f\n", config.eta);
                 }
                 break;
             }
             case 't': {
                 double tol = atof(optarg);
                 if (tol > 0.0) {
-                    g_cache_tolerance = tol;
+                    config.cache_tolerance = tol;
                 } else {
                     fprintf(stderr, "Warning: Cache tolerance must be positive. Using default: %.1e\n", 
-                            g_cache_tolerance);
+                            config.cache_tolerance);
                 }
                 break;
             }
             case 'm': {
                 int attempts = atoi(optarg);
                 if (attempts > 0) {
-                    g_max_calibration_attempts = attempts;
+                    config.max_calibration_attempts = attempts;
                 } else {
                     fprintf(stderr, "Warning: Max attempts must be positive. Using default: %d\n", 
-                            g_max_calibration_attempts);
+                            config.max_calibration_attempts);
                 }
                 break;
             }
             case 'b':
-                g_use_bs_fallback = false;
-                if (g_debug) {
+                config.use_bs_fallback = false;
+                if (config.debug) {
                     fprintf(stderr, "Debug: Black-Scholes fallback disabled\n");
                 }
                 break;
+            case 'B':
+                batch = true;
+                break;
+            case 'C':
+                calibrate = true;
+                break;
+            case 'P':
+                param_store_path = optarg;
+                break;
+            case 'K':
+                ticker = optarg;
+                break;
+            case 'i':
+                config.spot_invariant = true;
+                break;
+            case 'x':
+                config.mixed_precision = false;
+                break;
+            case 'A':
+                if (strcmp(optarg, "cpu") == 0) {
+                    config.backend = HESTON_BACKEND_CPU;
+                } else if (strcmp(optarg, "gpu") == 0) {
+                    config.backend = HESTON_BACKEND_GPU;
+                } else {
+                    fprintf(stderr, "Warning: Unknown backend '%s'. Using default: cpu\n", optarg);
+                    config.backend = HESTON_BACKEND_CPU;
+                }
+                break;
+            case 'V':
+                config.gpu_verify = false;
+                break;
+            case 'W': {
+                double err = atof(optarg);
+                if (err >= 0.0) {
+                    config.warm_start_max_error = err;
+                } else {
+                    fprintf(stderr, "Warning: Warm start error must not be negative. Using default: %.3f\n",
+                            config.warm_start_max_error);
+                }
+                break;
+            }
+            case 'S':
+                if (!stats) {
+                    stats = true;
+                    perf_stats_reset();
+                    atexit(print_perf_stats);
+                }
+                break;
+            case 'w':
+                wisdom_path = optarg;
+                break;
+            case 'u':
+                tuning_path = optarg;
+                break;
+            case 'G':
+            case 'g':
+                share_path = optarg;
+                publish = c == 'G';
+                break;
+            case 'c': {
+                double mb = atof(optarg);
+                if (mb > 0.0) {
+                    config.cache_max_bytes = (size_t)(mb * 1024.0 * 1024.0);
+                } else {
+                    fprintf(stderr, "Warning: Cache size must be positive. Using default: %zu MB\n",
+                            config.cache_max_bytes / (1024 * 1024));
+                }
+                break;
+            }
+            case 'T': {
+                int threads = atoi(optarg);
+                if (threads >= 1 && threads <= HESTON_FFT_MAX_THREADS) {
+                    config.threads = threads;
+                } else {
+                    fprintf(stderr, "Warning: Threads must be between 1 and %d. Using default: %d\n",
+                            HESTON_FFT_MAX_THREADS, config.threads);
+                }
+                break;
+            }
+            case 'p':
+                if (strcmp(optarg, "estimate") == 0) {
+                    config.planner = HESTON_FFTW_ESTIMATE;
+                } else if (strcmp(optarg, "measure") == 0) {
+                    config.planner = HESTON_FFTW_MEASURE;
+                } else if (strcmp(optarg, "patient") == 0) {
+                    config.planner = HESTON_FFTW_PATIENT;
+                } else {
+                    fprintf(stderr, "Warning: Unknown FFTW planner '%s'. Using default: estimate\n", optarg);
+                    config.planner = HESTON_FFTW_ESTIMATE;
+                }
+                break;
             case '?':
                 // getopt_long already printed error message
                 print_usage(argv[0]);
@@ -1496,6 +691,56 @@ int main(int argc, char *argv[]) {
         }
     }
     
+    if (calibrate && !batch) {
+        fprintf(stderr, "Error: --calibrate requires --batch\n");
+        print_usage(argv[0]);
+        return 1;
+    }
+    
+    // Batch mode takes the chain-wide defaults and reads options from stdin
+    if (batch) {
+        if (argc - optind != 3) {
+            fprintf(stderr, "Error: Batch mode expects StockPrice RiskFreeRate DividendYield\n");
+            print_usage(argv[0]);
+            return 1;
+        }
+        
+        double S = safe_atof(argv[optind]);
+        if (S <= 0.0) {
+            fprintf(stderr, "Error: Stock price must be positive\n");
+            return 1;
+        }
+        
+        heston_fft_set_config(&config);
+        if (wisdom_path != NULL) {
+            heston_fft_load_wisdom(wisdom_path);
+        }
+        if (tuning_path != NULL) {
+            heston_fft_load_tuning(tuning_path);
+        }
+        if (publish) {
+            heston_fft_publish_grids(share_path);
+        } else if (share_path != NULL) {
+            heston_fft_read_shared_grids(share_path);
+        }
+        
+        double r = safe_atof(argv[optind + 1]);
+        double q = safe_atof(argv[optind + 2]);
+        int status = calibrate ? run_calibration(S, r, q, config.debug)
+                               : run_batch(S, r, q, &config);
+        
+        if (config.debug) {
+            print_cache_stats();
+        }
+        
+        if (wisdom_path != NULL) {
+            heston_fft_save_wisdom(wisdom_path);
+        }
+        heston_fft_publish_grids(NULL);
+        heston_fft_cleanup_plans();
+        return status;
+    }
+    
     // Check if we have the correct number of arguments after options
     if (argc - optind != 6) {
         fprintf(stderr, "Error: Incorrect number of arguments\n");
@@ -1504,16 +749,30 @@ int main(int argc, char *argv[]) {
     }
     
     // Print FFT configuration if in debug mode
-    if (g_debug) {
+    if (config.debug) {
         fprintf(stderr, "Debug: FFT Configuration - N: %d, Range: %.1f, Alpha: %.2f, Eta: %.4f, Tolerance: %.1e\n",
-                g_fft_n, g_log_strike_range, g_alpha, g_eta, g_cache_tolerance);
+                config.fft_n, config.log_strike_range, config.alpha, config.eta, config.cache_tolerance);
         fprintf(stderr, "Debug: Max calibration attempts: %d, BS fallback: %s\n", 
-                g_max_calibration_attempts, g_use_bs_fallback ? "enabled" : "disabled");
+                config.max_calibration_attempts, config.use_bs_fallback ? "enabled" : "disabled");
+        fprintf(stderr, "Debug: FFTW planner: %s, wisdom file: %s\n",
+                config.planner == HESTON_FFTW_PATIENT ? "patient" :
+                config.planner == HESTON_FFTW_MEASURE ? "measure" : "estimate",
+                wisdom_path != NULL ? wisdom_path : "none");
     }
     
-    // Set up signal handlers for the entire program
-    signal(SIGSEGV, error_handler);
-    signal(SIGFPE, error_handler);
+    heston_fft_set_config(&config);
+    
+    // Tuned FFT settings replace the adaptation and most retries
+    if (tuning_path != NULL) {
+        heston_fft_load_tuning(tuning_path);
+    }
+    
+    // Grids published by another process on the host save computing them
+    if (publish) {
+        heston_fft_publish_grids(share_path);
+    } else if (share_path != NULL) {
+        heston_fft_read_shared_grids(share_path);
+    }
     
     // Safely parse command line arguments with error checking
     double market_price = safe_atof(argv[optind]);
@@ -1529,14 +788,6 @@ int main(int argc, char *argv[]) {
         return 1;
     }
     
-    // Check if this is a challenging parameter set and adapt FFT parameters if needed
-    if (is_challenging_parameter_set(S, K, T, 0.04, 1.0, 0.04, 0.4, -0.7)) {
-        if (g_debug) {
-            fprintf(stderr, "Debug: Detected challenging parameter set, adapting FFT parameters\n");
-        }
-        adapt_fft_parameters(S, K, T);
-    }
-    
     // Input validation
     if (market_price <= 0.0) {
         fprintf(stderr, "Error: Option price must be positive\n");
@@ -1558,67 +809,59 @@ int main(int argc, char *argv[]) {
         return 1;
     }
     
-    // Use error handler for the main calculation
-    g_using_error_handler = true;
-    double iv = -1.0;
+    // Plans created from stored wisdom skip the MEASURE/PATIENT timing runs
+    if (wisdom_path != NULL) {
+        heston_fft_load_wisdom(wisdom_path);
+    }
     
-    if (setjmp(g_error_jmp_buf) == 0) {
-        // Call the implied volatility function from the stochastic volatility model
-        iv = implied_vol_sv(market_price, S, K, T, r, q);
-    } else {
-        // Exception occurred during calculation
-        if (g_debug) {
-            fprintf(stderr, "Exception during implied volatility calculation\n");
-            fprintf(stderr, "Trying with alternative FFT parameters\n");
-        }
-        
-        // Try multiple alternative FFT parameter sets
-        bool success = false;
-        for (int attempt = 1; attempt <= g_max_calibration_attempts; attempt++) {
-            if (!try_alternate_fft_params(attempt)) {
-                break;  // No more alternative sets to try
-            }
-            
-            if (setjmp(g_error_jmp_buf) == 0) {
-                iv = implied_vol_sv(market_price, S, K, T, r, q);
-                if (iv > 0.0) {
-                    success = true;
-                    break;
-                }
+    // Yesterday's (or a minute ago's) fit for this ticker and expiry seeds the search
+    HestonParamStore* store = NULL;
+    const HestonParamEntry* seed = NULL;
+    if (param_store_path != NULL) {
+        if (ticker == NULL) {
+            fprintf(stderr, "Warning: --param-store needs --ticker, calibrating without it\n");
+        } else {
+            store = heston_param_store_open(param_store_path);
+            seed = heston_param_store_lookup(store, ticker, T);
+            if (config.debug) {
+                fprintf(stderr, "Debug: %s parameters for %s, %d-day bucket\n",
+                        seed != NULL ? "Seeding from stored" : "No stored", ticker,
+                        heston_param_store_bucket(T));
             }
         }
-        
-        // If all attempts failed and fallback is enabled, use Black-Scholes
-        if (!success) {
-            if (g_use_bs_fallback) {
-                if (g_debug) {
-                    fprintf(stderr, "All SV calibration attempts failed, falling back to Black-Scholes\n");
-                }
-                
-                // Fall back to Black-Scholes
-                iv = bs_implied_vol(market_price, S, K, T, r, q);
-                
-                if (iv < 0.0) {
-                    // If BS IV also fails, use a reasonable default
-                    iv = 0.25;  // 25% is a reasonable default for most options
-                }
-            } else {
-                fprintf(stderr, "Error: All calibration attempts failed and fallback is disabled\n");
-                cleanup_fft_cache();
-                return 1;
-            }
+    }
+    
+    // Calibrate to the market price; the engine handles FFT faults, retries
+    // with alternate parameter sets and the Black-Scholes fallback
+    double iv = -1.0;
+    HestonFit fit;
+    int status = heston_fft_implied_vol_seeded(market_price, S, K, T, r, q,
+                                               seed != NULL ? &seed->params : NULL, &iv, &fit);
+    
+    if (store != NULL) {
+        if (status == 0 && fit.fit_error >= 0.0 &&
+            (heston_param_store_update(store, ticker, T, &fit.params, fit.fit_error / market_price) != 0 ||
+             heston_param_store_save(store) != 0)) {
+            fprintf(stderr, "Warning: Could not save calibrated parameters to %s\n", param_store_path);
         }
+        heston_param_store_close(store);
     }
     
-    g_using_error_handler = false;
-    signal(SIGSEGV, SIG_DFL);
-    signal(SIGFPE, SIG_DFL);
+    if (wisdom_path != NULL) {
+        heston_fft_save_wisdom(wisdom_path);
+    }
+    
+    if (config.debug) {
+        print_cache_stats();
+    }
     
     // Clean up resources
     cleanup_fft_cache();
+    heston_fft_publish_grids(NULL);
+    heston_fft_cleanup_plans();
     
     // Check for error
-    if (iv < 0.0) {
+    if (status != 0 || iv < 0.0) {
         fprintf(stderr, "Error: Failed to calculate implied volatility\n");
         return 1;
     }
@@ -2,6 +2,9 @@
 
 # Script to generate a volatility smile across multiple strikes
 # Usage: ./generate_smile.sh
+#
+# The whole smile is priced and solved in one build_surface process; use
+# build_surface directly for several expiries or a market chain.
 
 SPOT=100
 DAYS=90
@@ -9,17 +12,10 @@ YIELD=0.01
 RATE=0.05
 BASE_VOL=0.2
 
+cd "$(dirname "$0")"
+
+EXPIRY=$(awk -v d=$DAYS 'BEGIN { printf "%.10f", d / 365.0 }')
+
 echo "Strike,BS IV,SV IV"
-for STRIKE in $(seq 80 5 120); do
-    # First calculate a theoretical price using Black-Scholes with a base volatility
-    PRICE=$(/home/usr0/projects/option_tools/calculate_iv_v2 --calc-price $SPOT $STRIKE $DAYS $RATE $YIELD $BASE_VOL)
-    
-    # Then calculate implied vols using both models
-    RESULT=$(/home/usr0/projects/option_tools/price_option_v5.sh $SPOT $STRIKE $DAYS $PRICE $YIELD)
-    
-    # Extract the implied vols using grep and awk
-    BS_IV=$(echo "$RESULT" | grep "Implied Volatility(BS)" | awk '{print $3}' | sed 's/%//')
-    SV_IV=$(echo "$RESULT" | grep "Implied Volatility(SV)" | awk '{print $3}' | sed 's/%//')
-    
-    echo "$STRIKE,$BS_IV,$SV_IV"
-done 
\ No newline at end of file
+./build_surface --strikes=80:120:5 --expiries=$EXPIRY --vol=$BASE_VOL $SPOT $RATE $YIELD |
+    awk -F, 'NR > 1 { printf "%g,%s,%s\n", $2, $5, $6 }'
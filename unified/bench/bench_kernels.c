@@ -0,0 +1,455 @@
+/**
+ * bench_kernels.c
+ * In-process microbenchmarks of the pricing kernels
+ *
+ * Each benchmark is timed in samples of a calibrated number of calls, after
+ * warmup samples that also bring caches and FFTW plans to their steady state.
+ * Results are written as JSON; with --baseline the medians are compared with
+ * an earlier run and the exit status reports regressions.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <complex.h>
+#include <jansson.h>
+
+#include "../include/heston_fft.h"
+#include "../include/market_data.h"
+
+#define BENCH_FORMAT_VERSION 1
+
+#define DEFAULT_SAMPLES 30
+#define DEFAULT_WARMUP 3
+#define DEFAULT_SAMPLE_MS 5.0
+#define DEFAULT_THRESHOLD 10.0
+
+// Calls per sample are doubled until a sample takes the target time
+#define MAX_CALLS_PER_SAMPLE (1L << 24)
+
+// Test option of the old shell benchmarks
+#define BENCH_S 100.0
+#define BENCH_K 100.0
+#define BENCH_T 0.25
+#define BENCH_R 0.05
+#define BENCH_Q 0.02
+#define BENCH_MARKET_PRICE 5.0
+
+// Days in the synthetic Alpha Vantage response
+#define BENCH_HISTORY_DAYS 500
+
+static const HestonParams bench_params = {0.04, 2.0, 0.04, 0.3, -0.7};
+
+typedef struct {
+    const char* name;
+    int arg;                          // Benchmark parameter (FFT size), 0 if none
+    void (*setup)(int arg);           // Run once before timing, may be NULL
+    double (*run)(int arg, long calls);  // Returns a checksum so calls cannot be elided
+} Benchmark;
+
+typedef struct {
+    char name[64];
+    long calls;        // Calls per sample
+    int samples;
+    double min_ns;     // Per-call times
+    double median_ns;
+    double p90_ns;
+    double p99_ns;
+    double mean_ns;
+    double stddev_ns;
+} BenchResult;
+
+static volatile double g_sink;
+static HestonFFTConfig g_default_config;
+static char* g_history_json = NULL;
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Setups
+
+static void setup_fft_size(int n) {
+    HestonFFTConfig config = g_default_config;
+    config.fft_n = n;
+    heston_fft_set_config(&config);
+    cleanup_fft_cache();
+}
+
+static void setup_cached_grid(int arg) {
+    (void)arg;
+    heston_fft_set_config(&g_default_config);
+    init_fft_cache(BENCH_S, BENCH_R, BENCH_Q, BENCH_T, bench_params.v0, bench_params.kappa,
+                   bench_params.theta, bench_params.sigma, bench_params.rho);
+}
+
+static void setup_default_config(int arg) {
+    (void)arg;
+    heston_fft_set_config(&g_default_config);
+}
+
+// Daily bars as Alpha Vantage sends them, newest first
+static void setup_history_json(int arg) {
+    (void)arg;
+    if (g_history_json != NULL) {
+        return;
+    }
+
+    size_t size = 128 + (size_t)BENCH_HISTORY_DAYS * 192;
+    char* json = malloc(size);
+    if (json == NULL) {
+        return;
+    }
+
+    size_t len = (size_t)snprintf(json, size, "{\"Meta Data\": {\"2. Symbol\": \"BENCH\"}, "
+                                              "\"Time Series (Daily)\": {");
+    double close = 100.0;
+    for (int i = 0; i < BENCH_HISTORY_DAYS; i++) {
+        // Distinct valid dates: 28 days a month, 12 months a year
+        int day = BENCH_HISTORY_DAYS - 1 - i;
+        int year = 2020 + day / 336;
+        int month = day / 28 % 12 + 1;
+        int mday = day % 28 + 1;
+        close *= 1.0 + 0.01 * sin(i * 0.7);
+        len += (size_t)snprintf(json + len, size - len,
+                                "%s\"%04d-%02d-%02d\": {\"1. open\": \"%.4f\", \"2. high\": \"%.4f\", "
+                                "\"3. low\": \"%.4f\", \"4. close\": \"%.4f\", \"5. volume\": \"%d\"}",
+                                i > 0 ? ", " : "", year, month, mday,
+                                close * 0.995, close * 1.01, close * 0.99, close, 1000000 + i);
+    }
+    snprintf(json + len, size - len, "}}");
+    g_history_json = json;
+}
+
+// Kernels
+
+static double run_cf_heston(int arg, long calls) {
+    (void)arg;
+    double sum = 0.0;
+    for (long i = 0; i < calls; i++) {
+        double complex phi = (0.05 + 0.05 * (double)(i & 1023)) - 2.5 * I;
+        double complex cf = cf_heston(phi, BENCH_S, bench_params.v0, bench_params.kappa,
+                                      bench_params.theta, bench_params.sigma, bench_params.rho,
+                                      BENCH_R, BENCH_Q, BENCH_T);
+        sum += creal(cf);
+    }
+    return sum;
+}
+
+// Every call gets a new expiry, so each one computes a grid (a cache miss)
+static double run_init_fft_cache(int arg, long calls) {
+    static long counter = 0;
+    (void)arg;
+    double sum = 0.0;
+    for (long i = 0; i < calls; i++) {
+        double T = BENCH_T * (1.0 + 1e-4 * (double)(counter++ % 100000));
+        init_fft_cache(BENCH_S, BENCH_R, BENCH_Q, T, bench_params.v0, bench_params.kappa,
+                       bench_params.theta, bench_params.sigma, bench_params.rho);
+        sum += get_cached_option_price(BENCH_K);
+    }
+    return sum;
+}
+
+static double run_cached_price(int arg, long calls) {
+    (void)arg;
+    double sum = 0.0;
+    for (long i = 0; i < calls; i++) {
+        sum += get_cached_option_price(80.0 + 0.04 * (double)(i & 1023));
+    }
+    return sum;
+}
+
+static double run_implied_vol_sv(int arg, long calls) {
+    (void)arg;
+    double sum = 0.0;
+    for (long i = 0; i < calls; i++) {
+        sum += implied_vol_sv(BENCH_MARKET_PRICE, BENCH_S, BENCH_K, BENCH_T, BENCH_R, BENCH_Q);
+    }
+    return sum;
+}
+
+static double run_bs_implied_vol(int arg, long calls) {
+    (void)arg;
+    double sum = 0.0;
+    for (long i = 0; i < calls; i++) {
+        double K = 90.0 + 0.02 * (double)(i & 1023);
+        double price = black_scholes_call(BENCH_S, K, BENCH_T, BENCH_R, BENCH_Q, 0.25);
+        sum += bs_implied_vol(price, BENCH_S, K, BENCH_T, BENCH_R, BENCH_Q);
+    }
+    return sum;
+}
+
+static double run_market_data_parse(int arg, long calls) {
+    (void)arg;
+    double sum = 0.0;
+    for (long i = 0; i < calls; i++) {
+        sum += calculate_historical_volatility_from_data(g_history_json, 60);
+    }
+    return sum;
+}
+
+static const Benchmark benchmarks[] = {
+    {"cf_heston", 0, NULL, run_cf_heston},
+    {"init_fft_cache", 1024, setup_fft_size, run_init_fft_cache},
+    {"init_fft_cache", 2048, setup_fft_size, run_init_fft_cache},
+    {"init_fft_cache", 4096, setup_fft_size, run_init_fft_cache},
+    {"init_fft_cache", 8192, setup_fft_size, run_init_fft_cache},
+    {"init_fft_cache", 16384, setup_fft_size, run_init_fft_cache},
+    {"get_cached_option_price", 0, setup_cached_grid, run_cached_price},
+    {"implied_vol_sv", 0, setup_default_config, run_implied_vol_sv},
+    {"bs_implied_vol", 0, NULL, run_bs_implied_vol},
+    {"market_data_parse", 0, setup_history_json, run_market_data_parse},
+};
+
+#define BENCHMARK_COUNT ((int)(sizeof(benchmarks) / sizeof(benchmarks[0])))
+
+static void benchmark_name(const Benchmark* bench, char* buffer, size_t size) {
+    if (bench->arg > 0) {
+        snprintf(buffer, size, "%s/N=%d", bench->name, bench->arg);
+    } else {
+        snprintf(buffer, size, "%s", bench->name);
+    }
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile of sorted values
+static double percentile(const double* sorted, int n, double p) {
+    int rank = (int)ceil(p / 100.0 * n);
+    if (rank < 1) rank = 1;
+    if (rank > n) rank = n;
+    return sorted[rank - 1];
+}
+
+static double time_calls(const Benchmark* bench, long calls) {
+    double start = now_ns();
+    g_sink = bench->run(bench->arg, calls);
+    return now_ns() - start;
+}
+
+static int run_benchmark(const Benchmark* bench, int samples, int warmup, double sample_ms,
+                         BenchResult* result) {
+    memset(result, 0, sizeof(*result));
+    benchmark_name(bench, result->name, sizeof(result->name));
+
+    if (bench->setup != NULL) {
+        bench->setup(bench->arg);
+    }
+
+    // Calibration doubles as the first warmup
+    long calls = 1;
+    while (time_calls(bench, calls) < sample_ms * 1e6 && calls < MAX_CALLS_PER_SAMPLE) {
+        calls *= 2;
+    }
+    for (int i = 0; i < warmup; i++) {
+        time_calls(bench, calls);
+    }
+
+    double* times = malloc((size_t)samples * sizeof(double));
+    if (times == NULL) {
+        return -1;
+    }
+
+    double sum = 0.0;
+    for (int i = 0; i < samples; i++) {
+        times[i] = time_calls(bench, calls) / calls;
+        sum += times[i];
+    }
+
+    double mean = sum / samples;
+    double var = 0.0;
+    for (int i = 0; i < samples; i++) {
+        var += (times[i] - mean) * (times[i] - mean);
+    }
+
+    qsort(times, (size_t)samples, sizeof(double), compare_doubles);
+    result->calls = calls;
+    result->samples = samples;
+    result->min_ns = times[0];
+    result->median_ns = percentile(times, samples, 50.0);
+    result->p90_ns = percentile(times, samples, 90.0);
+    result->p99_ns = percentile(times, samples, 99.0);
+    result->mean_ns = mean;
+    result->stddev_ns = samples > 1 ? sqrt(var / (samples - 1)) : 0.0;
+
+    free(times);
+    return 0;
+}
+
+static json_t* result_json(const BenchResult* result) {
+    return json_pack("{s:s, s:I, s:i, s:f, s:f, s:f, s:f, s:f, s:f}",
+                     "name", result->name,
+                     "calls_per_sample", (json_int_t)result->calls,
+                     "samples", result->samples,
+                     "min_ns", result->min_ns,
+                     "median_ns", result->median_ns,
+                     "p90_ns", result->p90_ns,
+                     "p99_ns", result->p99_ns,
+                     "mean_ns", result->mean_ns,
+                     "stddev_ns", result->stddev_ns);
+}
+
+// Median of a benchmark in a baseline report, or -1.0 if it is not there
+static double baseline_median(const json_t* baseline, const char* name) {
+    size_t i;
+    json_t* entry;
+    json_array_foreach(json_object_get(baseline, "results"), i, entry) {
+        const char* entry_name = json_string_value(json_object_get(entry, "name"));
+        json_t* median = json_object_get(entry, "median_ns");
+        if (entry_name != NULL && strcmp(entry_name, name) == 0 && json_is_number(median)) {
+            return json_number_value(median);
+        }
+    }
+    return -1.0;
+}
+
+static void print_usage(const char* program_name) {
+    printf("Usage: %s [options]\n", program_name);
+    printf("\n");
+    printf("Options:\n");
+    printf("  --samples N       Timed samples per benchmark (default: %d)\n", DEFAULT_SAMPLES);
+    printf("  --warmup N        Untimed samples before timing (default: %d)\n", DEFAULT_WARMUP);
+    printf("  --sample-ms MS    Target duration of one sample (default: %.0f)\n", DEFAULT_SAMPLE_MS);
+    printf("  --filter TEXT     Only run benchmarks whose name contains TEXT\n");
+    printf("  --output FILE     Write the JSON report to FILE instead of stdout\n");
+    printf("  --baseline FILE   Compare medians with an earlier report\n");
+    printf("  --threshold PCT   Slowdown reported as a regression (default: %.0f%%)\n", DEFAULT_THRESHOLD);
+    printf("  --list            List the benchmarks and exit\n");
+    printf("\n");
+    printf("Exit status: 0 on success, 1 if a benchmark regressed against the baseline,\n");
+    printf("2 on usage or I/O errors.\n");
+}
+
+int main(int argc, char* argv[]) {
+    int samples = DEFAULT_SAMPLES;
+    int warmup = DEFAULT_WARMUP;
+    double sample_ms = DEFAULT_SAMPLE_MS;
+    double threshold = DEFAULT_THRESHOLD;
+    const char* filter = NULL;
+    const char* output_path = NULL;
+    const char* baseline_path = NULL;
+    char name[64];
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        int has_value = i + 1 < argc;
+        if (has_value && strcmp(arg, "--samples") == 0) {
+            samples = atoi(argv[++i]);
+        } else if (has_value && strcmp(arg, "--warmup") == 0) {
+            warmup = atoi(argv[++i]);
+        } else if (has_value && strcmp(arg, "--sample-ms") == 0) {
+            sample_ms = atof(argv[++i]);
+        } else if (has_value && strcmp(arg, "--filter") == 0) {
+            filter = argv[++i];
+        } else if (has_value && strcmp(arg, "--output") == 0) {
+            output_path = argv[++i];
+        } else if (has_value && strcmp(arg, "--baseline") == 0) {
+            baseline_path = argv[++i];
+        } else if (has_value && strcmp(arg, "--threshold") == 0) {
+            threshold = atof(argv[++i]);
+        } else if (strcmp(arg, "--help") == 0) {
+            print_usage(argv[0]);
+            return 0;
+        } else if (strcmp(arg, "--list") == 0) {
+            for (int b = 0; b < BENCHMARK_COUNT; b++) {
+                benchmark_name(&benchmarks[b], name, sizeof(name));
+                printf("%s\n", name);
+            }
+            return 0;
+        } else {
+            print_usage(argv[0]);
+            return 2;
+        }
+    }
+    if (samples < 1 || warmup < 0 || sample_ms <= 0.0) {
+        fprintf(stderr, "Error: Invalid sample settings\n");
+        return 2;
+    }
+
+    json_t* baseline = NULL;
+    if (baseline_path != NULL) {
+        json_error_t error;
+        baseline = json_load_file(baseline_path, 0, &error);
+        if (baseline == NULL) {
+            fprintf(stderr, "Error: Cannot read baseline %s: %s\n", baseline_path, error.text);
+            return 2;
+        }
+    }
+
+    heston_fft_get_config(&g_default_config);
+
+    json_t* results = json_array();
+    int regressions = 0;
+
+    for (int b = 0; b < BENCHMARK_COUNT; b++) {
+        BenchResult result;
+        benchmark_name(&benchmarks[b], name, sizeof(name));
+        if (filter != NULL && strstr(name, filter) == NULL) {
+            continue;
+        }
+        if (run_benchmark(&benchmarks[b], samples, warmup, sample_ms, &result) != 0) {
+            fprintf(stderr, "Error: Out of memory in %s\n", name);
+            continue;
+        }
+
+        json_t* entry = result_json(&result);
+        fprintf(stderr, "%-28s median %12.1f ns  p90 %12.1f ns  p99 %12.1f ns",
+                result.name, result.median_ns, result.p90_ns, result.p99_ns);
+
+        double base = baseline != NULL ? baseline_median(baseline, result.name) : -1.0;
+        if (base > 0.0) {
+            double change = (result.median_ns / base - 1.0) * 100.0;
+            int regressed = change > threshold;
+            regressions += regressed;
+            json_object_set_new(entry, "baseline_median_ns", json_real(base));
+            json_object_set_new(entry, "change_pct", json_real(change));
+            json_object_set_new(entry, "regression", json_boolean(regressed));
+            fprintf(stderr, "  %+7.1f%%%s", change, regressed ? "  REGRESSION" : "");
+        }
+        fprintf(stderr, "\n");
+        json_array_append_new(results, entry);
+    }
+
+    char timestamp[32];
+    time_t now = time(NULL);
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+    json_t* report = json_pack("{s:i, s:s, s:{s:i, s:i, s:f}, s:o}",
+                               "version", BENCH_FORMAT_VERSION,
+                               "timestamp", timestamp,
+                               "settings", "samples", samples, "warmup", warmup, "sample_ms", sample_ms,
+                               "results", results);
+    if (baseline != NULL) {
+        json_object_set_new(report, "baseline", json_string(baseline_path));
+        json_object_set_new(report, "threshold_pct", json_real(threshold));
+        json_object_set_new(report, "regressions", json_integer(regressions));
+    }
+
+    int status = regressions > 0 ? 1 : 0;
+    if (output_path != NULL) {
+        if (json_dump_file(report, output_path, JSON_INDENT(2)) != 0) {
+            fprintf(stderr, "Error: Cannot write %s\n", output_path);
+            status = 2;
+        }
+    } else {
+        json_dumpf(report, stdout, JSON_INDENT(2));
+        printf("\n");
+    }
+
+    json_decref(report);
+    json_decref(baseline);
+    free(g_history_json);
+    cleanup_fft_cache();
+    heston_fft_cleanup_plans();
+    return status;
+}
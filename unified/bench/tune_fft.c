@@ -0,0 +1,388 @@
+/**
+ * tune_fft.c
+ * Offline sweep of the FFT settings that builds the tuning table (fft_tuning.h)
+ *
+ * For every expiry and volatility bucket the sweep prices a set of sample
+ * options (both bucket edges, several Heston parameter shapes) with every
+ * candidate transform size, integration step and dampening factor, and
+ * compares the prices at strikes across every moneyness bucket with the COS
+ * engine at its highest resolution. The error of a moneyness bucket covers
+ * every strike up to its edge, since chains are priced from a grid sized for
+ * their widest strike. Each bucket keeps the smallest transform that meets
+ * the error target, and the most accurate candidate of that size. Samples
+ * that no candidate prices within the target only have to come close to the
+ * best error any candidate achieves for them.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+
+#include "../include/heston_fft.h"
+#include "../include/heston_cos.h"
+#include "../include/fft_tuning.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define DEFAULT_TARGET 1e-5
+#define DEFAULT_OUTPUT "fft_tuning.txt"
+
+// Market of the sample options; prices scale with the spot and the errors
+// are measured relative to it
+#define TUNE_S 100.0
+#define TUNE_R 0.03
+#define TUNE_Q 0.01
+
+// Strikes per side of each moneyness bucket, evenly spaced in log-moneyness
+#define STRIKES_PER_SIDE 5
+
+// Grid nodes kept beyond the widest strike of a bucket, so that the spline
+// slopes there do not depend on where the grid ends
+#define RANGE_MARGIN_NODES 4
+
+// Fraction of the target the samples have to meet; options between the
+// bucket edges the samples sit on come out a little less accurate
+#define TARGET_MARGIN 0.5
+
+// A sample that no candidate brings within the target only has to come
+// within this factor of its best error
+#define UNMET_SLACK 1.25
+
+// Grid cache of the sweep context; every candidate builds new grids
+#define TUNE_CACHE_BYTES ((size_t)4 * 1024 * 1024)
+
+static const double default_expiries[] = {0.02, 0.05, 0.1, 0.25, 0.5, 1.0, 2.0, 5.0, 10.0};
+static const double default_moneyness[] = {0.05, 0.1, 0.2, 0.35, 0.5, 0.75, 1.0, 1.5};
+static const double default_vols[] = {0.1, 0.2, 0.3, 0.5, 0.8};
+
+static const int candidate_sizes[] = {512, 1024, 2048, 4096, 8192, 16384};
+static const double candidate_etas[] = {0.025, 0.05, 0.1, 0.2, 0.3, 0.4, 0.6, 0.8};
+static const double candidate_alphas[] = {0.75, 1.0, 1.25, 1.5, 2.0};
+
+#define NUM_SIZES ((int)(sizeof(candidate_sizes) / sizeof(candidate_sizes[0])))
+#define NUM_ETAS ((int)(sizeof(candidate_etas) / sizeof(candidate_etas[0])))
+#define NUM_ALPHAS ((int)(sizeof(candidate_alphas) / sizeof(candidate_alphas[0])))
+
+// Candidates are numbered with the size varying slowest, so in order of cost
+#define NUM_CANDIDATES (NUM_SIZES * NUM_ETAS * NUM_ALPHAS)
+
+// Parameter shapes spanning the calibration search ranges; v0 and theta are
+// set from the volatility level of the sample
+typedef struct {
+    double kappa;
+    double sigma;
+    double rho;
+} ParamShape;
+
+static const ParamShape shapes[] = {
+    {1.0, 0.4, -0.7},
+    {3.0, 0.8, -0.7},
+    {0.5, 0.2, 0.0},
+    {1.5, 0.6, -0.4},
+    {0.5, 0.8, -0.3},
+};
+
+#define NUM_SHAPES ((int)(sizeof(shapes) / sizeof(shapes[0])))
+
+// Two expiries times two volatility levels per shape
+#define NUM_SAMPLES (4 * NUM_SHAPES)
+
+typedef struct {
+    double T;
+    HestonParams params;
+    double* reference;   // COS prices of every strike
+} Sample;
+
+// Error of candidate c for sample s in moneyness bucket m, DBL_MAX if the
+// candidate does not cover the bucket or its grid failed
+static double candidate_error(const double* errors, int c, int s, int m, int num_moneyness) {
+    return errors[((size_t)c * NUM_SAMPLES + (size_t)s) * num_moneyness + (size_t)m];
+}
+
+// Lower edge used for the samples of bucket i: the previous edge, or half of
+// the first one
+static double lower_edge(const double* edges, int i) {
+    return i > 0 ? edges[i - 1] : 0.5 * edges[0];
+}
+
+// Parse a comma-separated list of ascending positive edges
+static int parse_edges(const char* text, double* edges) {
+    int count = 0;
+    const char* p = text;
+    while (*p != '\0' && count < FFT_TUNING_MAX_EDGES) {
+        char* end;
+        double value = strtod(p, &end);
+        if (end == p || !(value > 0.0) || (count > 0 && !(value > edges[count - 1]))) {
+            return -1;
+        }
+        edges[count++] = value;
+        p = end;
+        if (*p == ',') {
+            p++;
+        } else if (*p != '\0') {
+            return -1;
+        }
+    }
+    return *p == '\0' && count > 0 ? count : -1;
+}
+
+static void print_usage(const char* program_name) {
+    printf("Usage: %s [options]\n", program_name);
+    printf("\n");
+    printf("Options:\n");
+    printf("  --target ERR      Largest price error relative to the spot (default: %.0e)\n", DEFAULT_TARGET);
+    printf("  --output FILE     Table to write (default: %s)\n", DEFAULT_OUTPUT);
+    printf("  --expiries LIST   Upper expiry edges in years, comma-separated\n");
+    printf("  --moneyness LIST  Upper |log(K/S)| edges, comma-separated\n");
+    printf("  --vols LIST       Upper volatility level edges, comma-separated\n");
+    printf("\n");
+    printf("Buckets that miss the target are reported on stderr.\n");
+    printf("\n");
+    printf("Exit status: 0 when the table was written, 2 on usage or I/O errors.\n");
+}
+
+int main(int argc, char* argv[]) {
+    double target = DEFAULT_TARGET;
+    const char* output_path = DEFAULT_OUTPUT;
+    double expiries[FFT_TUNING_MAX_EDGES];
+    double moneyness[FFT_TUNING_MAX_EDGES];
+    double vols[FFT_TUNING_MAX_EDGES];
+    int num_expiries = (int)(sizeof(default_expiries) / sizeof(default_expiries[0]));
+    int num_moneyness = (int)(sizeof(default_moneyness) / sizeof(default_moneyness[0]));
+    int num_vols = (int)(sizeof(default_vols) / sizeof(default_vols[0]));
+    memcpy(expiries, default_expiries, sizeof(default_expiries));
+    memcpy(moneyness, default_moneyness, sizeof(default_moneyness));
+    memcpy(vols, default_vols, sizeof(default_vols));
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        int has_value = i + 1 < argc;
+        if (has_value && strcmp(arg, "--target") == 0) {
+            target = atof(argv[++i]);
+        } else if (has_value && strcmp(arg, "--output") == 0) {
+            output_path = argv[++i];
+        } else if (has_value && strcmp(arg, "--expiries") == 0) {
+            num_expiries = parse_edges(argv[++i], expiries);
+        } else if (has_value && strcmp(arg, "--moneyness") == 0) {
+            num_moneyness = parse_edges(argv[++i], moneyness);
+        } else if (has_value && strcmp(arg, "--vols") == 0) {
+            num_vols = parse_edges(argv[++i], vols);
+        } else if (strcmp(arg, "--help") == 0) {
+            print_usage(argv[0]);
+            return 0;
+        } else {
+            print_usage(argv[0]);
+            return 2;
+        }
+    }
+    if (!(target > 0.0) || num_expiries < 0 || num_moneyness < 0 || num_vols < 0) {
+        fprintf(stderr, "Error: Invalid target or bucket edges\n");
+        return 2;
+    }
+
+    FFTTuningTable* table = fft_tuning_create(expiries, num_expiries, moneyness, num_moneyness,
+                                              vols, num_vols, target);
+    HestonFFTContext* ctx = heston_fft_context_create();
+
+    // Strikes of bucket m are strikes[m * per_bucket ...], both sides of the money
+    const int per_bucket = 2 * STRIKES_PER_SIDE;
+    const int num_strikes = num_moneyness * per_bucket;
+    double* strikes = malloc((size_t)num_strikes * sizeof(double));
+    double* prices = malloc((size_t)num_strikes * sizeof(double));
+    double* errors = malloc((size_t)NUM_CANDIDATES * NUM_SAMPLES * num_moneyness * sizeof(double));
+    double* reference = malloc((size_t)NUM_SAMPLES * num_strikes * sizeof(double));
+    if (table == NULL || ctx == NULL || strikes == NULL || prices == NULL || errors == NULL ||
+        reference == NULL) {
+        fprintf(stderr, "Error: Out of memory\n");
+        return 2;
+    }
+
+    for (int m = 0; m < num_moneyness; m++) {
+        double lo = m > 0 ? moneyness[m - 1] : 0.0;
+        for (int j = 0; j < STRIKES_PER_SIDE; j++) {
+            double x = lo + (moneyness[m] - lo) * j / (STRIKES_PER_SIDE - 1);
+            strikes[m * per_bucket + 2 * j] = TUNE_S * exp(x);
+            strikes[m * per_bucket + 2 * j + 1] = TUNE_S * exp(-x);
+        }
+    }
+
+    HestonFFTConfig config;
+    heston_fft_get_config(&config);
+    config.cache_max_bytes = TUNE_CACHE_BYTES;
+
+    Sample samples[NUM_SAMPLES];
+    int missed = 0;
+
+    for (int t = 0; t < num_expiries; t++) {
+        for (int v = 0; v < num_vols; v++) {
+            // Sample options of this row and their reference prices
+            int num_samples = 0;
+            for (int e = 0; e < 2; e++) {
+                for (int w = 0; w < 2; w++) {
+                    double T = e == 0 ? lower_edge(expiries, t) : expiries[t];
+                    double vol = w == 0 ? lower_edge(vols, v) : vols[v];
+                    for (int s = 0; s < NUM_SHAPES; s++) {
+                        Sample* sample = &samples[num_samples];
+                        sample->T = T;
+                        sample->params.v0 = vol * vol;
+                        sample->params.theta = vol * vol;
+                        sample->params.kappa = shapes[s].kappa;
+                        sample->params.sigma = shapes[s].sigma;
+                        sample->params.rho = shapes[s].rho;
+                        sample->reference = reference + (size_t)num_samples * num_strikes;
+                        if (heston_cos_price_chain(TUNE_S, T, TUNE_R, TUNE_Q, &sample->params,
+                                                   strikes, num_strikes, OPTION_CALL,
+                                                   HESTON_COS_MAX_TERMS, sample->reference) != 0) {
+                            fprintf(stderr, "Error: Reference prices failed for T=%g vol=%g\n", T, vol);
+                            return 2;
+                        }
+                        num_samples++;
+                    }
+                }
+            }
+
+            // Errors of every candidate, sample and moneyness bucket
+            for (int c = 0; c < NUM_CANDIDATES; c++) {
+                const int n = c / (NUM_ETAS * NUM_ALPHAS);
+                const int e = (c / NUM_ALPHAS) % NUM_ETAS;
+                const int a = c % NUM_ALPHAS;
+                double* row = errors + (size_t)c * NUM_SAMPLES * num_moneyness;
+                for (int k = 0; k < NUM_SAMPLES * num_moneyness; k++) {
+                    row[k] = DBL_MAX;
+                }
+
+                // The grid must reach the widest strike plus the margin
+                const double lambda = 2.0 * M_PI / (candidate_sizes[n] * candidate_etas[e]);
+                const double reach = M_PI / candidate_etas[e] - RANGE_MARGIN_NODES * lambda;
+                int covered = 0;
+                while (covered < num_moneyness &&
+                       moneyness[covered] + RANGE_MARGIN_NODES * lambda <= reach) {
+                    covered++;
+                }
+                if (covered == 0) {
+                    continue;
+                }
+
+                config.fft_n = candidate_sizes[n];
+                config.eta = candidate_etas[e];
+                config.alpha = candidate_alphas[a];
+                config.log_strike_range = moneyness[covered - 1] + RANGE_MARGIN_NODES * lambda;
+                heston_fft_context_set_config(ctx, &config);
+
+                for (int s = 0; s < num_samples; s++) {
+                    const Sample* sample = &samples[s];
+                    double* sample_errors = row + (size_t)s * num_moneyness;
+                    if (heston_fft_context_price_grid(ctx, TUNE_S, sample->T, TUNE_R, TUNE_Q,
+                                                      &sample->params, strikes,
+                                                      covered * per_bucket, prices) != 0) {
+                        continue;
+                    }
+
+                    // A bucket's settings also price every strike closer to
+                    // the money, as a chain sized for its widest strike does
+                    double worst = 0.0;
+                    for (int m = 0; m < covered; m++) {
+                        for (int k = m * per_bucket; k < (m + 1) * per_bucket; k++) {
+                            double error = fabs(prices[k] - sample->reference[k]) / TUNE_S;
+                            worst = isfinite(error) ? fmax(worst, error) : DBL_MAX;
+                        }
+                        sample_errors[m] = worst;
+                    }
+                }
+            }
+
+            for (int m = 0; m < num_moneyness; m++) {
+                // Samples no candidate gets within the target (strongly
+                // Feller-violating ones at low volatility) must not decide
+                // the choice: each sample only has to come within its own
+                // best error times UNMET_SLACK
+                double limit[NUM_SAMPLES];
+                for (int s = 0; s < num_samples; s++) {
+                    double floor_error = DBL_MAX;
+                    for (int c = 0; c < NUM_CANDIDATES; c++) {
+                        floor_error = fmin(floor_error, candidate_error(errors, c, s, m, num_moneyness));
+                    }
+                    limit[s] = fmax(target * TARGET_MARGIN, floor_error * UNMET_SLACK);
+                }
+
+                // The smallest size with an acceptable candidate, the most
+                // accurate of that size; otherwise the least excess overall
+                int chosen = -1;
+                double chosen_score = DBL_MAX, chosen_error = DBL_MAX;
+                for (int c = 0; c < NUM_CANDIDATES; c++) {
+                    double score = 0.0, error = 0.0;
+                    for (int s = 0; s < num_samples; s++) {
+                        double sample_error = candidate_error(errors, c, s, m, num_moneyness);
+                        score = fmax(score, sample_error / limit[s]);
+                        error = fmax(error, sample_error);
+                    }
+                    if (error == DBL_MAX) {
+                        continue;
+                    }
+                    int acceptable = score <= 1.0;
+                    int chosen_acceptable = chosen >= 0 && chosen_score <= 1.0;
+                    int same_size = chosen >= 0 && c / (NUM_ETAS * NUM_ALPHAS) ==
+                                                       chosen / (NUM_ETAS * NUM_ALPHAS);
+                    int better = chosen < 0 ||
+                                 (acceptable && !chosen_acceptable) ||
+                                 (acceptable && same_size && error < chosen_error) ||
+                                 (!acceptable && !chosen_acceptable && score < chosen_score);
+                    if (better) {
+                        chosen = c;
+                        chosen_score = score;
+                        chosen_error = error;
+                    }
+                }
+
+                if (chosen >= 0) {
+                    const int n = chosen / (NUM_ETAS * NUM_ALPHAS);
+                    const int e = (chosen / NUM_ALPHAS) % NUM_ETAS;
+                    FFTTuningEntry* entry = fft_tuning_entry(table, t, m, v);
+                    const double lambda = 2.0 * M_PI / (candidate_sizes[n] * candidate_etas[e]);
+                    entry->fft_n = candidate_sizes[n];
+                    entry->eta = candidate_etas[e];
+                    entry->alpha = candidate_alphas[chosen % NUM_ALPHAS];
+                    entry->log_strike_range = moneyness[m] + RANGE_MARGIN_NODES * lambda;
+                    entry->max_error = chosen_error;
+                }
+                if (!(chosen_error <= target * TARGET_MARGIN)) {
+                    missed++;
+                    if (chosen < 0) {
+                        fprintf(stderr, "Warning: T<=%g |log(K/S)|<=%g vol<=%g: no candidate covers it\n",
+                                expiries[t], moneyness[m], vols[v]);
+                    } else {
+                        fprintf(stderr, "Warning: T<=%g |log(K/S)|<=%g vol<=%g: error %.2e%s\n",
+                                expiries[t], moneyness[m], vols[v], chosen_error,
+                                chosen_score <= 1.0 ? " (target out of reach for some samples)" : "");
+                    }
+                }
+            }
+            fprintf(stderr, "T<=%-5g vol<=%-4g done\n", expiries[t], vols[v]);
+        }
+    }
+
+    int status = 0;
+    if (fft_tuning_save(table, output_path) != 0) {
+        fprintf(stderr, "Error: Cannot write %s\n", output_path);
+        status = 2;
+    } else {
+        fprintf(stderr, "Wrote %s (%d of %d buckets within the target)\n", output_path,
+                num_expiries * num_moneyness * num_vols - missed,
+                num_expiries * num_moneyness * num_vols);
+    }
+
+    free(strikes);
+    free(prices);
+    free(errors);
+    free(reference);
+    fft_tuning_free(table);
+    heston_fft_context_destroy(ctx);
+    heston_fft_cleanup_plans();
+    return status;
+}
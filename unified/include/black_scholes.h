@@ -0,0 +1,66 @@
+#ifndef BLACK_SCHOLES_H
+#define BLACK_SCHOLES_H
+
+#include "option_types.h"
+
+/**
+ * @file black_scholes.h
+ * @brief In-process Black-Scholes pricing and implied volatility, part of libheston
+ *
+ * This is the code that used to live inside calculate_iv_v2.c. The legacy CLI
+ * is now a thin wrapper around these functions, and the Black-Scholes adapter
+ * calls them directly instead of spawning a process per quote.
+ */
+
+/**
+ * @brief Cumulative distribution function of the standard normal distribution
+ */
+double norm_cdf(double x);
+
+/**
+ * @brief Probability density function of the standard normal distribution
+ */
+double norm_pdf(double x);
+
+/**
+ * @brief Black-Scholes European call price
+ * @return Call price, or -1.0 for invalid inputs
+ */
+double bs_call(double S, double K, double T, double r, double q, double sigma);
+
+/**
+ * @brief Black-Scholes European put price (via put-call parity)
+ * @return Put price, or -1.0 for invalid inputs
+ */
+double bs_put(double S, double K, double T, double r, double q, double sigma);
+
+/**
+ * @brief Black-Scholes vega (derivative of price with respect to volatility)
+ */
+double bs_vega(double S, double K, double T, double r, double q, double sigma);
+
+/**
+ * @brief Call implied volatility via damped Newton-Raphson
+ * @return Implied volatility, or -1 for invalid inputs
+ */
+double implied_vol(double market_price, double S, double K, double T, double r, double q);
+
+/**
+ * @brief Price an option (or compute its implied volatility) with Black-Scholes
+ *
+ * @param S Spot price
+ * @param K Strike price
+ * @param T Time to expiry in years
+ * @param r Risk-free rate
+ * @param q Dividend yield
+ * @param sigma Volatility used for pricing (ignored when market_price > 0)
+ * @param option_type OPTION_CALL or OPTION_PUT
+ * @param market_price Market price for implied volatility calculation (0 to skip)
+ * @param result Pointer to a PricingResult structure to store the result
+ *
+ * @return 0 on success, error code on failure
+ */
+int bs_price_option(double S, double K, double T, double r, double q, double sigma,
+                    OptionType option_type, double market_price, PricingResult* result);
+
+#endif /* BLACK_SCHOLES_H */
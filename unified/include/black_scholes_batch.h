@@ -0,0 +1,63 @@
+#ifndef BLACK_SCHOLES_BATCH_H
+#define BLACK_SCHOLES_BATCH_H
+
+#include "option_types.h"
+
+/**
+ * @file black_scholes_batch.h
+ * @brief Batch Black-Scholes implied volatility for whole chains and surfaces, part of libheston
+ *
+ * implied_vol() and bs_implied_vol() solve one option at a time and fall
+ * back to fixed volatilities when they fail. The batch solver takes the
+ * inputs as separate arrays, works on the normalized Black price in
+ * log-moneyness, starts from closed-form initial guesses and always takes
+ * three Householder steps; an option whose last step is still larger than
+ * 1e-6 relative is reported as not converged. The loop is branch-free and vectorized (AVX-512 or AVX2 are
+ * picked at runtime on x86-64, see heston_cf_simd.h). Every option gets an
+ * explicit status; there are no default volatilities.
+ */
+
+/**
+ * @brief Outcome of the implied volatility solve for one option
+ */
+typedef enum {
+    IV_OK = 0,              /**< Solved */
+    IV_INVALID_INPUT = 1,   /**< Non-positive or non-finite spot, strike, expiry or price */
+    IV_BELOW_INTRINSIC = 2, /**< Price at or below intrinsic value */
+    IV_ABOVE_MAXIMUM = 3,   /**< Price at or above the no-arbitrage maximum */
+    IV_NOT_CONVERGED = 4    /**< No reliable solution (e.g. time value lost to rounding deep in the money) */
+} IVStatus;
+
+/**
+ * @brief Option chain in struct-of-arrays form
+ *
+ * All arrays have one entry per option. type may be NULL for a chain of calls.
+ */
+typedef struct {
+    const double* price;       /**< Option prices */
+    const double* S;           /**< Spot prices */
+    const double* K;           /**< Strike prices */
+    const double* T;           /**< Times to expiry in years */
+    const double* r;           /**< Risk-free rates */
+    const double* q;           /**< Dividend yields */
+    const OptionType* type;    /**< OPTION_CALL or OPTION_PUT per option, or NULL */
+} IVBatchInput;
+
+/**
+ * @brief Black-Scholes implied volatilities for n options
+ *
+ * @param n Number of options
+ * @param in Input arrays
+ * @param ivs Array of n entries to store the implied volatilities (-1.0 where the status is not IV_OK)
+ * @param status Array of n entries to store the per-option status (may be NULL)
+ *
+ * @return Number of options that were not solved, or ERROR_INVALID_PARAMETER for bad arguments
+ */
+int bs_implied_vol_batch(int n, const IVBatchInput* in, double* ivs, IVStatus* status);
+
+/**
+ * @brief Short description of an IVStatus value
+ */
+const char* bs_iv_status_string(IVStatus status);
+
+#endif /* BLACK_SCHOLES_BATCH_H */
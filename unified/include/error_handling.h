@@ -83,6 +83,9 @@ const char* get_error_description(int error_code);
 /**
  * @brief Set the last error code and message
  * 
+ * The error state (code and message) is kept per thread in fixed storage,
+ * so threads pricing at the same time never see each other's errors.
+ * 
  * @param error_code The error code to set
  * @param message Additional error message or context (can be NULL)
  */
@@ -93,6 +96,48 @@ void set_last_error(int error_code, const char* message);
  * 
  * @return int The last error code that was set
  */
+int get_last_error_code(void);
+
+/**
+ * @brief Get the last error message
+ * 
+ * @return const char* The last error message that was set, "" if none
+ */
+const char* get_last_error_message(void);
+
+/**
+ * @brief Clear the last error code and message
+ */
+void clear_last_error(void);
+
+/**
+ * @brief Set the error log file
+ * 
+ * @param log_file Pointer to an open file for error logging (NULL to disable)
+ * @return int ERROR_SUCCESS on success, otherwise an error code
+ */
+int set_error_log_file(FILE* log_file);
+
+/**
+ * @brief Log an error message with context and set it as the last error
+ * 
+ * Lock-free: the record is buffered and written out later, except for
+ * system errors (100-199), which are written at once and to stderr.
+ * 
+ * @param error_code The error code associated with the error
+ * @param function The function name where the error occurred
+ * @param message Additional error message or context (can be NULL)
+ */
+void log_error(int error_code, const char* function, const char* message);
+
+/**
+ * @brief Write out every buffered error record
+ * 
+ * Also runs at exit once a log file is set. Call it before handing the log
+ * file to anything else.
+ */
+void flush_error_log(void);
+
 /* Error code definitions */
 #define ERROR_NONE                       0   /**< No error */
 #define ERROR_INVALID_PARAMETER         -1   /**< Invalid parameter */
@@ -118,6 +163,12 @@ void set_last_error(int error_code, const char* message);
  */
 void set_error(int error_code);
 
+/**
+ * @brief Get the error code of the current thread
+ * @return The code last set by set_error() or set_last_error()
+ */
+int get_error(void);
+
 /**
  * @brief Get the error message for an error code
  * @param error_code The error code
@@ -0,0 +1,239 @@
+#ifndef FFT_CACHE_H
+#define FFT_CACHE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/**
+ * @file fft_cache.h
+ * @brief Bounded LRU cache of Carr-Madan FFT price grids
+ *
+ * Each grid holds the call prices for every log-strike of one FFT run. Grids
+ * are keyed by the full market, model and FFT parameter tuple, so grids for
+ * several expiries, underlyings or Heston parameter sets can be kept alive
+ * at once. Lookups are tolerance-aware: every key component is quantized by
+ * the cache tolerance before hashing, and keys whose components all agree
+ * within the tolerance are treated as equal.
+ *
+ * The memory of evicted grids is reused by later inserts of the same size,
+ * so a cache that is full does no heap allocation per grid. Up to a few
+ * such spare grids are kept outside the memory limit until the cache is
+ * cleared.
+ */
+
+/** Default memory limit for cached grids (64 MB) */
+#define FFT_CACHE_DEFAULT_MAX_BYTES ((size_t)64 * 1024 * 1024)
+
+/**
+ * @brief Parameters that determine an FFT price grid
+ */
+typedef struct {
+    double S;                 /**< Spot price */
+    double r;                 /**< Risk-free rate */
+    double q;                 /**< Dividend yield */
+    double T;                 /**< Time to expiry */
+    double v0;                /**< Initial variance */
+    double kappa;             /**< Mean reversion speed */
+    double theta;             /**< Long-term variance */
+    double sigma;             /**< Volatility of variance */
+    double rho;               /**< Correlation */
+    int fft_n;                /**< Number of FFT points */
+    double log_strike_range;  /**< Half-width of the log-strike grid */
+    double alpha;             /**< Carr-Madan dampening factor */
+    double eta;               /**< Integration step size */
+} FFTGridKey;
+
+/**
+ * @brief Sensitivity grids a price grid may carry, with x = log S at fixed strike
+ */
+typedef enum {
+    FFT_GRID_DX = 0,         /**< dC/dx */
+    FFT_GRID_DXX = 1,        /**< d2C/dx2 */
+    FFT_GRID_DV0 = 2,        /**< dC/dv0 */
+    FFT_GRID_DT = 3,         /**< dC/dT */
+    FFT_GRID_SENSITIVITIES = 4
+} FFTGridSensitivity;
+
+/**
+ * @brief One cached price grid
+ *
+ * Strikes are uniform in log-strike, so a lookup computes its index
+ * directly, and prices are interpolated with a monotone cubic spline in
+ * log-strike whose node slopes are fitted once per fill.
+ *
+ * The link fields and spare_sensitivities are owned by the cache and must
+ * not be modified.
+ */
+typedef struct FFTGrid {
+    FFTGridKey key;           /**< Parameters the grid was computed for */
+    double* prices;           /**< Call prices, one per strike */
+    double* strikes;          /**< Strikes, increasing */
+    double* slopes;           /**< Spline slopes d(price)/d(log K) at each strike */
+    double* sensitivities;    /**< NULL, or FFT_GRID_SENSITIVITIES rows of num_strikes values */
+    double* sensitivity_slopes; /**< Spline slopes of the sensitivity rows */
+    int num_strikes;          /**< Number of strikes in the grid */
+    double log_strike0;       /**< Log of the first strike */
+    double log_strike_step;   /**< Log-strike spacing */
+    double inv_log_strike_step; /**< 1 / log_strike_step */
+    unsigned long hash;       /**< Hash of the quantized key */
+    double* spare_sensitivities; /**< Sensitivity block kept from before the grid was reused */
+    struct FFTGrid* hash_next;
+    struct FFTGrid* lru_prev;
+    struct FFTGrid* lru_next;
+} FFTGrid;
+
+/**
+ * @brief Cache usage counters
+ */
+typedef struct {
+    unsigned long hits;       /**< Lookups answered from the cache */
+    unsigned long misses;     /**< Lookups that found no matching grid */
+    unsigned long evictions;  /**< Grids dropped to stay under the memory limit */
+    unsigned long allocations; /**< Grid and sensitivity blocks allocated rather than reused */
+    size_t entries;           /**< Grids currently cached */
+    size_t bytes;             /**< Memory used by the cached grids */
+    size_t max_bytes;         /**< Configured memory limit */
+} FFTCacheStats;
+
+/** Opaque cache handle */
+typedef struct FFTGridCache FFTGridCache;
+
+/**
+ * @brief Create an empty cache
+ * @param max_bytes Memory limit for grid data (0 for the default)
+ * @param tolerance Per-component tolerance for key matching (must be positive)
+ * @return The new cache, or NULL on allocation failure
+ */
+FFTGridCache* fft_cache_create(size_t max_bytes, double tolerance);
+
+/**
+ * @brief Free a cache and all of its grids
+ */
+void fft_cache_destroy(FFTGridCache* cache);
+
+/**
+ * @brief Drop every grid and free their memory, keeping the counters
+ */
+void fft_cache_clear(FFTGridCache* cache);
+
+/**
+ * @brief Find a grid matching the key and mark it most recently used
+ * @return The grid, or NULL on a miss
+ */
+FFTGrid* fft_cache_lookup(FFTGridCache* cache, const FFTGridKey* key);
+
+/**
+ * @brief Check for a grid matching the key without marking it used or
+ *        counting a hit or miss
+ */
+bool fft_cache_contains(const FFTGridCache* cache, const FFTGridKey* key);
+
+/**
+ * @brief Add a new grid for the key, evicting least recently used grids
+ *
+ * The returned grid has allocated but uninitialized price, strike and slope
+ * arrays; fill in the prices, then call fft_grid_fit().
+ * The newest grid is never evicted, so a limit below one grid still caches
+ * a single entry.
+ *
+ * @param cache The cache
+ * @param key Parameters of the grid
+ * @param num_strikes Number of strikes to allocate
+ * @return The grid to fill in, or NULL on allocation failure
+ */
+FFTGrid* fft_cache_insert(FFTGridCache* cache, const FFTGridKey* key, int num_strikes);
+
+/**
+ * @brief Set the uniform log-strike axis of a filled grid and fit its spline
+ *
+ * Writes strikes[i] = exp(log_strike0 + i * log_strike_step) and the
+ * Fritsch-Butland slopes of the prices, which make the Hermite spline
+ * monotone wherever the prices are, so interpolated call prices never
+ * overshoot between nodes.
+ *
+ * @param grid Grid whose prices are filled in (at least 2 strikes)
+ * @param log_strike0 Log of the first strike
+ * @param log_strike_step Log-strike spacing (positive)
+ */
+void fft_grid_fit(FFTGrid* grid, double log_strike0, double log_strike_step);
+
+/**
+ * @brief Interpolated price for strike K
+ *
+ * Constant time: the interval index comes straight from log(K). Strikes
+ * outside the grid get the nearest end price.
+ *
+ * @param grid Grid prepared with fft_grid_fit()
+ * @param K Strike price (positive)
+ * @return Interpolated price
+ */
+double fft_grid_price(const FFTGrid* grid, double K);
+
+/**
+ * @brief Allocate the sensitivity rows of a cached grid
+ *
+ * Row s starts at sensitivities + s * num_strikes. Fill every row, then call
+ * fft_grid_fit_sensitivities(). The memory is charged to the cache, which
+ * may evict older grids but never this one.
+ *
+ * @param cache The cache holding the grid
+ * @param grid Grid prepared with fft_grid_fit() and without sensitivities
+ * @return true on success, false on allocation failure
+ */
+bool fft_grid_add_sensitivities(FFTGridCache* cache, FFTGrid* grid);
+
+/**
+ * @brief Fit the splines of filled sensitivity rows
+ *
+ * The sensitivities are smooth but not monotone in the strike, so the
+ * slopes are central differences rather than the monotone fit used for
+ * prices.
+ */
+void fft_grid_fit_sensitivities(FFTGrid* grid);
+
+/**
+ * @brief Interpolated sensitivity for strike K
+ *
+ * @param grid Grid whose sensitivities are fitted
+ * @param which Sensitivity row
+ * @param K Strike price (positive)
+ * @return Interpolated value, the nearest end value outside the grid
+ */
+double fft_grid_sensitivity(const FFTGrid* grid, FFTGridSensitivity which, double K);
+
+/**
+ * @brief Remove one grid (e.g. when filling it failed)
+ *
+ * Its memory is kept for reuse like that of an evicted grid.
+ */
+void fft_cache_remove(FFTGridCache* cache, FFTGrid* grid);
+
+/**
+ * @brief Change the memory limit, evicting grids if needed
+ * @param max_bytes New limit (0 for the default)
+ */
+void fft_cache_set_limit(FFTGridCache* cache, size_t max_bytes);
+
+/**
+ * @brief Change the key tolerance
+ *
+ * Grids are hashed by their quantized keys, so a new tolerance clears the cache.
+ */
+void fft_cache_set_tolerance(FFTGridCache* cache, double tolerance);
+
+/**
+ * @brief Hash of a key quantized by the tolerance, as used by the cache
+ */
+unsigned long fft_grid_key_hash(const FFTGridKey* key, double tolerance);
+
+/**
+ * @brief Check whether every component of two keys agrees within the tolerance
+ */
+bool fft_grid_keys_match(const FFTGridKey* a, const FFTGridKey* b, double tolerance);
+
+/**
+ * @brief Read the usage counters
+ */
+void fft_cache_get_stats(const FFTGridCache* cache, FFTCacheStats* stats);
+
+#endif /* FFT_CACHE_H */
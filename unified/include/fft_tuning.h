@@ -0,0 +1,108 @@
+#ifndef FFT_TUNING_H
+#define FFT_TUNING_H
+
+#include "heston_fft.h"
+
+/**
+ * @file fft_tuning.h
+ * @brief Table of FFT settings tuned offline per expiry, moneyness and volatility level
+ *
+ * The table is built by bench/tune_fft, which sweeps the transform size,
+ * integration step and dampening factor over a grid of buckets and keeps,
+ * for each bucket, the cheapest settings whose error against a reference
+ * engine stays within a target. Loaded with heston_fft_load_tuning(), it
+ * gives the FFT engine a good grid on the first try instead of adapting and
+ * retrying at run time.
+ *
+ * Buckets are given by their upper edges: an option belongs to the first
+ * expiry edge >= T, the first moneyness edge >= |log(K/S)| and the first
+ * volatility edge >= its volatility level (see fft_tuning_vol_level()).
+ * Options beyond the last edge of an axis are not covered. Files are plain
+ * text, one header line per axis and one line per bucket.
+ */
+
+/** File format identification, the first word of a table file */
+#define FFT_TUNING_MAGIC "heston-fft-tuning"
+#define FFT_TUNING_VERSION 1
+
+/** Upper bound for the number of edges per axis */
+#define FFT_TUNING_MAX_EDGES 32
+
+/**
+ * @brief FFT settings chosen for one bucket
+ */
+typedef struct {
+    int fft_n;                /**< Number of FFT points, 0 if the bucket is not tuned */
+    double eta;               /**< Step size in integration space */
+    double alpha;             /**< Carr-Madan dampening factor */
+    double log_strike_range;  /**< Half-width of the log-strike grid */
+    double max_error;         /**< Largest error measured in the bucket, relative to the spot */
+} FFTTuningEntry;
+
+/**
+ * @brief Tuning table
+ *
+ * Entries are stored with the volatility index varying fastest, then the
+ * moneyness index, then the expiry index.
+ */
+typedef struct {
+    int num_expiries;                          /**< Expiry edges */
+    int num_moneyness;                         /**< Moneyness edges */
+    int num_vols;                              /**< Volatility edges */
+    double expiries[FFT_TUNING_MAX_EDGES];     /**< Upper expiry edges in years, ascending */
+    double moneyness[FFT_TUNING_MAX_EDGES];    /**< Upper |log(K/S)| edges, ascending */
+    double vols[FFT_TUNING_MAX_EDGES];         /**< Upper volatility level edges, ascending */
+    double target;                             /**< Error target relative to the spot the table was tuned for */
+    FFTTuningEntry* entries;                   /**< num_expiries * num_moneyness * num_vols entries */
+} FFTTuningTable;
+
+/**
+ * @brief Create a table with the given bucket edges and no tuned entries
+ * @return The table, or NULL for invalid edges or on allocation failure
+ */
+FFTTuningTable* fft_tuning_create(const double* expiries, int num_expiries,
+                                  const double* moneyness, int num_moneyness,
+                                  const double* vols, int num_vols, double target);
+
+/**
+ * @brief Load a table written by fft_tuning_save()
+ * @return The table, or NULL if the file is missing or invalid
+ */
+FFTTuningTable* fft_tuning_load(const char* path);
+
+/**
+ * @brief Save a table, replacing the file atomically
+ * @return 0 on success, -1 on failure
+ */
+int fft_tuning_save(const FFTTuningTable* table, const char* path);
+
+/**
+ * @brief Free a table
+ */
+void fft_tuning_free(FFTTuningTable* table);
+
+/**
+ * @brief Entry of the bucket with the given axis indices
+ */
+FFTTuningEntry* fft_tuning_entry(const FFTTuningTable* table, int expiry, int moneyness, int vol);
+
+/**
+ * @brief Entry for an option
+ *
+ * @param T Time to expiry in years
+ * @param log_moneyness log(K/S); only its magnitude is used
+ * @param vol Volatility level, see fft_tuning_vol_level()
+ *
+ * @return The tuned entry of the option's bucket, or NULL if the option is
+ *         not covered or its bucket is not tuned
+ */
+const FFTTuningEntry* fft_tuning_lookup(const FFTTuningTable* table, double T,
+                                        double log_moneyness, double vol);
+
+/**
+ * @brief Volatility level of a parameter set: the root of the expected
+ *        average variance over [0, T]
+ */
+double fft_tuning_vol_level(const HestonParams* params, double T);
+
+#endif /* FFT_TUNING_H */
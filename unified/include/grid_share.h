@@ -0,0 +1,151 @@
+#ifndef GRID_SHARE_H
+#define GRID_SHARE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "fft_cache.h"
+
+/**
+ * @file grid_share.h
+ * @brief FFT price grids published in shared memory for other processes
+ *
+ * One publisher per host writes the grids it computes into a memory-mapped
+ * segment; any number of readers map the same segment and interpolate
+ * published prices and sensitivities in place, without copying the grid or
+ * recomputing it. Put the segment under /dev/shm to keep it in memory.
+ *
+ * The segment has a fixed number of slots, each holding one grid of up to
+ * a fixed number of strikes. A grid goes into one of a few slots picked by
+ * the hash of its key, replacing the grid published longest ago if they
+ * are all in use. Every slot is guarded by a sequence lock: the publisher
+ * makes the sequence odd while it rewrites the slot and even again when it
+ * is done, and a reader retries if the sequence changed under it, so
+ * readers never block the publisher or see a half-written grid.
+ *
+ * Keys are matched with the tolerance of the publisher, which is stored in
+ * the segment. Files use the host byte order.
+ *
+ * The segment file lives as long as its publisher: grid_share_close() on
+ * the publisher's handle removes it, and readers that mapped it keep their
+ * mapping, without new grids, until they close it. A publisher that exits
+ * without closing leaves the file behind; the next grid_share_create() on
+ * the path replaces it.
+ */
+
+/** Segment format identification */
+#define GRID_SHARE_MAGIC "HGRIDSHM"
+#define GRID_SHARE_VERSION 1
+
+/** Default number of slots in a new segment */
+#ifndef GRID_SHARE_DEFAULT_SLOTS
+#define GRID_SHARE_DEFAULT_SLOTS 128
+#endif
+
+/** Default capacity of a slot in strikes; wider grids are not published */
+#ifndef GRID_SHARE_DEFAULT_STRIKES
+#define GRID_SHARE_DEFAULT_STRIKES 2048
+#endif
+
+/**
+ * @brief Usage counters of one segment handle
+ */
+typedef struct {
+    unsigned long published;  /**< Grids written (publisher) */
+    unsigned long skipped;    /**< Grids too wide for a slot (publisher) */
+    unsigned long hits;       /**< Lookups answered from the segment */
+    unsigned long misses;     /**< Lookups that found no matching grid */
+    unsigned long retries;    /**< Reads repeated because the slot was being rewritten */
+} GridShareStats;
+
+/** Opaque segment handle */
+typedef struct GridShare GridShare;
+
+/**
+ * @brief Create a segment and open it for publishing
+ *
+ * A new segment replaces the file atomically, so readers of an earlier
+ * segment keep their mapping until they reopen the path. Only one publisher
+ * may hold a segment; creation fails while another process publishes to the
+ * same path.
+ *
+ * @param path Segment file, e.g. /dev/shm/heston_grids
+ * @param num_slots Number of slots (0 for the default)
+ * @param max_strikes Strikes per slot (0 for the default)
+ * @param tolerance Per-component tolerance for key matching (must be positive)
+ * @return The handle, or NULL on failure
+ */
+GridShare* grid_share_create(const char* path, int num_slots, int max_strikes, double tolerance);
+
+/**
+ * @brief Map a segment for reading
+ * @return The handle, or NULL if the file is missing or not a segment
+ */
+GridShare* grid_share_open(const char* path);
+
+/**
+ * @brief Unmap a segment and free the handle
+ *
+ * On a publisher's handle this also removes the segment file, unless the
+ * path names another file by then.
+ */
+void grid_share_close(GridShare* share);
+
+/**
+ * @brief Check whether the handle came from grid_share_create()
+ */
+bool grid_share_is_publisher(const GridShare* share);
+
+/**
+ * @brief Publish a grid prepared with fft_grid_fit()
+ *
+ * Sensitivity rows are published along with the prices if the grid has
+ * fitted ones; publishing the same key again replaces the slot, e.g. once
+ * its sensitivities are added. Safe to call from several threads.
+ *
+ * @return 0 on success, -1 if the handle is not a publisher or the grid is
+ *         wider than a slot
+ */
+int grid_share_publish(GridShare* share, const FFTGrid* grid);
+
+/**
+ * @brief Interpolate published prices for several strikes
+ *
+ * All prices come from one consistent version of the grid. Lock-free; safe
+ * to call from several threads.
+ *
+ * @param share Segment handle
+ * @param key Parameters of the grid
+ * @param strikes Strikes to price (positive)
+ * @param num_strikes Number of strikes
+ * @param prices Output call prices
+ * @return 0 on success, -1 if no matching grid is published
+ */
+int grid_share_prices(GridShare* share, const FFTGridKey* key, const double* strikes,
+                      int num_strikes, double* prices);
+
+/**
+ * @brief Interpolate one published sensitivity row for several strikes
+ * @return 0 on success, -1 if no matching grid with sensitivities is published
+ */
+int grid_share_sensitivities(GridShare* share, const FFTGridKey* key, FFTGridSensitivity which,
+                             const double* strikes, int num_strikes, double* values);
+
+/**
+ * @brief Copy a published grid into a local cache
+ *
+ * For callers that keep using a grid across calls, which must not point
+ * into a slot the publisher may rewrite. The copy carries the published
+ * sensitivities, if any.
+ *
+ * @return The grid, now in the cache and fitted, or NULL if no matching
+ *         grid is published or the copy could not be stored
+ */
+FFTGrid* grid_share_fetch(GridShare* share, FFTGridCache* cache, const FFTGridKey* key);
+
+/**
+ * @brief Read the usage counters of a handle
+ */
+void grid_share_get_stats(const GridShare* share, GridShareStats* stats);
+
+#endif /* GRID_SHARE_H */
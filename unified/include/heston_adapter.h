@@ -2,6 +2,7 @@
 #define HESTON_ADAPTER_H
 
 #include "option_types.h"
+#include "heston_fft.h"
 
 /**
  * @file heston_adapter.h
@@ -11,6 +12,7 @@
 /**
  * @brief Adapt the unified API to the legacy Heston model implementation
  * 
+ * @param ctx FFT context for METHOD_FFT (NULL for the engine's default context)
  * @param spot_price The current price of the underlying asset
  * @param strike_price The strike price of the option
  * @param time_to_expiry Time to expiry in years
@@ -18,13 +20,14 @@
  * @param dividend_yield Dividend yield (annualized)
  * @param volatility Initial volatility (if known, 0 to use default)
  * @param option_type Type of option (OPTION_CALL or OPTION_PUT)
- * @param method Numerical method to use (METHOD_QUADRATURE or METHOD_FFT)
+ * @param method Numerical method to use (METHOD_QUADRATURE, METHOD_FFT or METHOD_COS)
  * @param market_price Market price (for implied volatility calculation, 0 to skip)
  * @param result Pointer to a PricingResult structure to store the result
  * 
  * @return 0 on success, error code on failure
  */
 int price_with_heston(
+    HestonFFTContext* ctx,
     double spot_price,
     double strike_price,
     double time_to_expiry,
@@ -40,6 +43,7 @@ int price_with_heston(
 /**
  * @brief Calculate Greeks for an option using the Heston model
  * 
+ * @param ctx FFT context the Greeks are read from (NULL for the engine's default context)
  * @param spot_price Spot price
  * @param strike_price Strike price
  * @param time_to_expiry Time to expiry in years
@@ -53,6 +57,7 @@ int price_with_heston(
  * @return 0 on success, error code on failure
  */
 int calculate_heston_greeks(
+    HestonFFTContext* ctx,
     double spot_price,
     double strike_price,
     double time_to_expiry,
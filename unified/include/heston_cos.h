@@ -0,0 +1,93 @@
+#ifndef HESTON_COS_H
+#define HESTON_COS_H
+
+#include "option_types.h"
+#include "heston_fft.h"
+
+/**
+ * @file heston_cos.h
+ * @brief Fang-Oosterlee COS pricing engine for the Heston model, part of libheston
+ *
+ * The COS method expands the density of the log-return ln(S_T / S) in a
+ * cosine series on a truncation interval [a, b] chosen from its cumulants,
+ * so a price is a sum of a few hundred characteristic function values times
+ * closed-form payoff coefficients. The characteristic function does not
+ * depend on the strike: one set of evaluations prices a whole chain, and
+ * there is no strike grid to adapt and no interpolation.
+ *
+ * Puts are priced directly (their payoff is bounded, which keeps the series
+ * stable for any moneyness) and calls through put-call parity.
+ */
+
+/** Default number of cosine terms */
+#ifndef HESTON_COS_DEFAULT_TERMS
+#define HESTON_COS_DEFAULT_TERMS 256
+#endif
+
+/** Upper bound for the number of cosine terms */
+#define HESTON_COS_MAX_TERMS 8192
+
+/**
+ * Half-width of the truncation interval in standard deviations of the
+ * log-return. The usual 12 leaves errors of about 1e-5 for strongly skewed
+ * parameter sets (sigma 0.8, rho -0.9); 16 removes them, but the wider
+ * interval needs more terms for such sets: with the default 256 their
+ * series error is about 1e-5 at T = 0.25 and 2e-4 at T = 1, with 1024 it
+ * is below 1e-8. Calm parameter sets stay below 1e-9 with 256 terms.
+ */
+#ifndef HESTON_COS_TRUNCATION
+#define HESTON_COS_TRUNCATION 16.0
+#endif
+
+/**
+ * @brief COS prices for a chain of options sharing (S, T, r, q)
+ *
+ * @param S Spot price
+ * @param T Time to expiry in years
+ * @param r Risk-free rate
+ * @param q Dividend yield
+ * @param params Heston parameters
+ * @param strikes Array of n strike prices
+ * @param n Number of options in the chain
+ * @param option_type OPTION_CALL or OPTION_PUT for every strike
+ * @param terms Number of cosine terms (0 for HESTON_COS_DEFAULT_TERMS)
+ * @param prices Array of n entries to store the prices
+ *
+ * @return ERROR_NONE on success, ERROR_INVALID_PARAMETER for bad input,
+ *         ERROR_MEMORY_ALLOCATION or ERROR_CALCULATION_FAILED otherwise
+ */
+int heston_cos_price_chain(double S, double T, double r, double q, const HestonParams* params,
+                           const double* strikes, int n, OptionType option_type, int terms,
+                           double* prices);
+
+/**
+ * @brief Heston call price with the COS method and the default number of terms
+ * @return Call price, or -1.0 on failure
+ */
+double heston_call_cos(double S, double K, double T, double r, double q, const HestonParams* params);
+
+/**
+ * @brief Price an option (or compute its implied volatility) with the COS engine
+ *
+ * With a market price, solves for the initial variance v0 (with theta = v0
+ * and the default kappa, sigma and rho, as the Heston adapter prices) that
+ * reproduces it and reports sqrt(v0), the same quantity the FFT engine's
+ * implied volatility uses.
+ *
+ * @param S Spot price
+ * @param K Strike price
+ * @param T Time to expiry in years
+ * @param r Risk-free rate
+ * @param q Dividend yield
+ * @param params Heston parameters used for pricing (ignored when market_price > 0)
+ * @param option_type OPTION_CALL or OPTION_PUT
+ * @param market_price Market price for implied volatility calculation (0 to skip)
+ * @param result Pointer to a PricingResult structure to store the result
+ *
+ * @return 0 on success, error code on failure
+ */
+int heston_cos_price_option(double S, double K, double T, double r, double q,
+                            const HestonParams* params, OptionType option_type,
+                            double market_price, PricingResult* result);
+
+#endif /* HESTON_COS_H */
@@ -0,0 +1,579 @@
+#ifndef HESTON_FFT_H
+#define HESTON_FFT_H
+
+#include <stdbool.h>
+#include <complex.h>
+
+#include "option_types.h"
+#include "fft_cache.h"
+
+/**
+ * @file heston_fft.h
+ * @brief In-process Heston FFT pricing engine (Carr-Madan), part of libheston
+ *
+ * This is the engine that used to live inside calculate_sv_v6.c. The legacy
+ * CLI is now a thin wrapper around these functions, and the Heston adapter
+ * calls them directly instead of spawning a process per quote.
+ */
+
+/* Default Heston parameters used when only an initial volatility is known */
+#define HESTON_DEFAULT_V0     0.04   /**< Initial variance (20% vol) */
+#define HESTON_DEFAULT_KAPPA  1.0    /**< Mean reversion speed */
+#define HESTON_DEFAULT_SIGMA  0.4    /**< Volatility of variance */
+#define HESTON_DEFAULT_RHO   -0.7    /**< Spot/variance correlation */
+
+/** Upper bound for HestonFFTConfig.threads */
+#define HESTON_FFT_MAX_THREADS 64
+
+/** Default HestonFFTConfig.warm_start_max_error */
+#define HESTON_WARM_START_MAX_ERROR 0.005
+
+/**
+ * Error bound of a single-precision screening price, as a multiple of its
+ * rounding error estimate FLT_EPSILON * sum |FFT input| * (1 + kappa theta
+ * T / sigma^2) * exp(-alpha log K) / pi (see HestonFFTConfig.mixed_precision).
+ * Measured errors stay below 20 times the estimate. Building with
+ * -DHESTON_NO_MIXED_PRECISION removes the screen and the libfftw3f dependency.
+ */
+#ifndef HESTON_SCREEN_SAFETY
+#define HESTON_SCREEN_SAFETY 256.0
+#endif
+
+/**
+ * @brief Heston model parameters
+ */
+typedef struct {
+    double v0;      /**< Initial variance */
+    double kappa;   /**< Mean reversion speed */
+    double theta;   /**< Long-term variance */
+    double sigma;   /**< Volatility of variance */
+    double rho;     /**< Correlation between spot and variance */
+} HestonParams;
+
+/**
+ * @brief FFTW planning effort
+ *
+ * ESTIMATE plans instantly; MEASURE and PATIENT time candidate algorithms
+ * once per transform size and pay off when the plan is reused many times,
+ * or when the plans are loaded from a wisdom file.
+ */
+typedef enum {
+    HESTON_FFTW_ESTIMATE = 0,  /**< FFTW_ESTIMATE (default) */
+    HESTON_FFTW_MEASURE = 1,   /**< FFTW_MEASURE */
+    HESTON_FFTW_PATIENT = 2    /**< FFTW_PATIENT */
+} HestonFFTPlanner;
+
+/**
+ * @brief Where the grids of the chain calibration sweeps are computed
+ *
+ * GPU builds every grid of a sweep in one batch on the CUDA device (see
+ * heston_gpu.h) before the sweep reads them from the cache; it needs a
+ * library built with GPU=cuda and a device, and otherwise falls back to CPU.
+ * The CPU engine stays the reference: single-option pricing, Greeks and
+ * the least-squares calibration always run on it.
+ */
+typedef enum {
+    HESTON_BACKEND_CPU = 0,    /**< Grids computed with FFTW on the CPU (default) */
+    HESTON_BACKEND_GPU = 1     /**< Batched CUDA kernel and cuFFT */
+} HestonFFTBackend;
+
+/**
+ * @brief Tunable settings of the FFT engine
+ *
+ * These mirror the command-line options of calculate_sv_v6.
+ */
+typedef struct {
+    int fft_n;                    /**< Number of FFT points (power of 2) */
+    double log_strike_range;      /**< Half-width of the log-strike grid */
+    double alpha;                 /**< Carr-Madan dampening factor */
+    double eta;                   /**< Step size in integration space */
+    double cache_tolerance;       /**< Tolerance for cache validation */
+    int max_calibration_attempts; /**< Alternate FFT parameter sets to try */
+    bool use_bs_fallback;         /**< Fall back to Black-Scholes on failure */
+    bool debug;                   /**< Print debug output to stderr */
+    bool verbose_debug;           /**< Print verbose debug output to stderr */
+    HestonFFTPlanner planner;     /**< FFTW planning effort for new plans */
+    size_t cache_max_bytes;       /**< Memory limit for cached FFT grids (0 for default) */
+    int threads;                  /**< Worker threads for the calibration sweeps (1 = serial) */
+    double warm_start_max_error;  /**< Fit error, relative to the price, up to which a warm start skips the full grid */
+    bool spot_invariant;          /**< Build grids for a unit spot and reuse them for every spot (see heston_call_fft()) */
+    bool mixed_precision;         /**< Screen calibration candidates on single-precision grids (see implied_vol_sv()); false for audits */
+    HestonFFTBackend backend;     /**< Where chain sweep grids are computed (reads CPU once the GPU fell back) */
+    bool gpu_verify;              /**< Check the first grid of every GPU batch against the CPU (see HESTON_GPU_TOLERANCE) */
+} HestonFFTConfig;
+
+/**
+ * @brief Outcome of a single-option calibration
+ */
+typedef struct {
+    HestonParams params;  /**< Best parameter set found */
+    double fit_error;     /**< |model - market| price difference of params, -1.0 if nothing was fitted */
+    bool warm_started;    /**< The seed's neighbourhood was close enough; the full grid was skipped */
+} HestonFit;
+
+/**
+ * @brief Pricing context owned by one thread
+ *
+ * A context holds everything the FFT engine mutates while pricing: the
+ * adaptive FFT grid settings, a grid cache, the precomputed FFT input terms
+ * and its FFTW plans. The global functions below work on a built-in default
+ * context and are not thread-safe; threads that price concurrently each use
+ * their own context. The configuration must not change while they run.
+ */
+typedef struct HestonFFTContext HestonFFTContext;
+
+/**
+ * @brief Read the current engine configuration
+ * @param config Pointer to store the configuration
+ */
+void heston_fft_get_config(HestonFFTConfig* config);
+
+/**
+ * @brief Replace the engine configuration
+ *
+ * Cached FFT grids are kept unless the cache tolerance changes; grids
+ * computed with other FFT settings simply stop matching. A smaller memory
+ * limit evicts least recently used grids immediately.
+ *
+ * @param config The configuration to apply
+ */
+void heston_fft_set_config(const HestonFFTConfig* config);
+
+/**
+ * @brief Read the hit/miss/eviction counters of the FFT grid cache
+ * @param stats Pointer to store the counters
+ */
+void heston_fft_get_cache_stats(FFTCacheStats* stats);
+
+/**
+ * @brief Load FFTW wisdom from a file
+ *
+ * Call before the first pricing so MEASURE/PATIENT plans are created from
+ * the stored wisdom instead of being re-measured.
+ *
+ * @param path Wisdom file written by heston_fft_save_wisdom()
+ * @return 0 if the wisdom was imported, -1 otherwise
+ */
+int heston_fft_load_wisdom(const char* path);
+
+/**
+ * @brief Save the accumulated FFTW wisdom to a file
+ * @param path Destination file
+ * @return 0 on success, -1 on failure
+ */
+int heston_fft_save_wisdom(const char* path);
+
+/**
+ * @brief Load a table of FFT settings tuned offline (see fft_tuning.h)
+ *
+ * While a table is loaded, every option it covers is priced with the
+ * settings of its bucket from the first try; the moneyness and expiry
+ * adaptation and the alternate parameter sets remain for options outside the
+ * table and for grids that still fail. Call before pricing starts, like
+ * heston_fft_set_config().
+ *
+ * @param path Table written by bench/tune_fft, or NULL to drop the current table
+ * @return 0 on success, -1 if the file is missing or invalid (no table is loaded then)
+ */
+int heston_fft_load_tuning(const char* path);
+
+/**
+ * @brief Publish every computed FFT grid in a shared segment (see grid_share.h)
+ *
+ * Creates the segment, replacing an earlier one at the path, and copies each
+ * grid the engine computes into it, sensitivities included, so that readers
+ * in other processes on the host interpolate it instead of computing it
+ * again. Keys are matched with the current cache tolerance. Fails while another
+ * process publishes to the path. Call before pricing starts, like
+ * heston_fft_set_config().
+ *
+ * Closing the published segment, with NULL or another path, removes its file.
+ *
+ * @param path Segment file, e.g. under /dev/shm, or NULL to close the current
+ *             segment, published or read
+ * @return 0 on success, -1 if the segment cannot be created
+ */
+int heston_fft_publish_grids(const char* path);
+
+/**
+ * @brief Take FFT grids from a segment another process publishes to
+ *
+ * On a miss in its own cache the engine looks the grid up in the segment
+ * and copies it into the cache when it is there, computing it only if it is
+ * not. The settings that pick the FFT grid (configuration, tuning table,
+ * spot-invariant mode) must match the publisher's for grids to be found.
+ *
+ * @param path Segment file, or NULL to close the current segment, published or read
+ * @return 0 on success, -1 if the file is missing or not a segment
+ */
+int heston_fft_read_shared_grids(const char* path);
+
+/**
+ * @brief Destroy the persistent FFTW plans of the default context
+ *
+ * Plans are created once per transform size and planner mode and otherwise
+ * live as long as their context; cleanup_fft_cache() leaves them alone.
+ * The plans of the calibration sweep workers are destroyed as well, and so
+ * are the cuFFT plans and device buffers of the GPU backend.
+ */
+void heston_fft_cleanup_plans(void);
+
+/**
+ * @brief Create a pricing context
+ *
+ * The context starts from the default context's current FFT settings and
+ * the configured cache limit, with an empty cache and no plans.
+ *
+ * @return The new context, or NULL on allocation failure
+ */
+HestonFFTContext* heston_fft_context_create(void);
+
+/**
+ * @brief Free a pricing context with its cached grids and plans
+ */
+void heston_fft_context_destroy(HestonFFTContext* ctx);
+
+/**
+ * @brief Apply the per-context settings of a configuration to a context
+ *
+ * Sets the FFT grid (fft_n, log_strike_range, alpha, eta) and the cache
+ * limit; the other fields are process-wide and left to heston_fft_set_config().
+ * Calibration adapts the grid to each option, so callers reset it this way
+ * before unrelated work. Threads that each own a context usually split the
+ * configured cache limit between them.
+ */
+void heston_fft_context_set_config(HestonFFTContext* ctx, const HestonFFTConfig* config);
+
+/**
+ * @brief heston_fft_get_cache_stats() for a context's own grid cache
+ *
+ * Reads the cache without locking, so call it from the thread using the context.
+ */
+void heston_fft_context_get_cache_stats(const HestonFFTContext* ctx, FFTCacheStats* stats);
+
+/**
+ * @brief Heston call price via FFT in a caller-owned context
+ *
+ * Same procedure as heston_call_fft(), but safe to call from several threads
+ * at once as long as each uses its own context.
+ *
+ * @return Call price, or -1.0 on failure when the BS fallback is disabled
+ */
+double heston_fft_context_call(HestonFFTContext* ctx, double S, double K, double T,
+                               double r, double q, const HestonParams* params);
+
+/**
+ * @brief Call prices for a chain from one grid with the context's FFT settings as they are
+ *
+ * Unlike heston_fft_context_call() the settings are neither adapted nor
+ * taken from the tuning table, and a failed grid is not retried or replaced
+ * by Black-Scholes, so the prices show what exactly these settings deliver.
+ * Strikes must lie within the grid's log-strike range of the spot.
+ *
+ * @param strikes Array of n strike prices
+ * @param prices Array of n entries to store the call prices
+ *
+ * @return 0 on success, -1 on invalid arguments or if the grid could not be computed
+ */
+int heston_fft_context_price_grid(HestonFFTContext* ctx, double S, double T, double r, double q,
+                                  const HestonParams* params, const double* strikes, int n,
+                                  double* prices);
+
+/**
+ * @brief Compute the grids of many (expiry, parameter set) pairs at once into a context's cache
+ *
+ * Every grid shares S, r, q and the context's FFT settings as they are, like
+ * heston_fft_context_price_grid(), which then reads them from the cache.
+ * With HESTON_BACKEND_GPU the missing grids are built in batches on the
+ * device (checked against the CPU as configured); otherwise, or if the
+ * device fails, they are computed one by one on the CPU. Grids beyond the
+ * context's cache limit evict the oldest ones, so ask for no more than it
+ * holds.
+ *
+ * @param T Array of count expiries in years
+ * @param params Array of count Heston parameter sets
+ * @param count Number of grids
+ *
+ * @return Number of grids computed on the GPU, or -1 on invalid arguments
+ *         or if a grid could not be computed
+ */
+int heston_fft_context_build_grids(HestonFFTContext* ctx, double S, double r, double q,
+                                   const double* T, const HestonParams* params, int count);
+
+/**
+ * @brief Serialize FFTW planner calls made outside the FFT engine
+ *
+ * Creating and destroying FFTW plans is not thread-safe, executing them is.
+ * Other libheston modules that plan their own transforms hold this lock
+ * around those calls.
+ */
+void heston_fft_planner_lock(void);
+
+/**
+ * @brief Release the lock taken by heston_fft_planner_lock()
+ */
+void heston_fft_planner_unlock(void);
+
+/**
+ * @brief Heston characteristic function of log(S_T)
+ */
+double complex cf_heston(double complex phi, double S, double v0, double kappa,
+                         double theta, double sigma, double rho, double r,
+                         double q, double T);
+
+/**
+ * @brief Plain Black-Scholes call price (used as the FFT fallback)
+ * @return Call price, or -1.0 for invalid inputs
+ */
+double black_scholes_call(double S, double K, double T, double r, double q, double sigma);
+
+/**
+ * @brief Black-Scholes implied volatility by bisection
+ * @return Implied volatility, or -1.0 if the price is outside the bounds
+ */
+double bs_implied_vol(double market_price, double S, double K, double T, double r, double q);
+
+/**
+ * @brief Make the FFT grid for these parameters current, computing it on a cache miss
+ */
+void init_fft_cache(double S, double r, double q, double T,
+                    double v0, double kappa, double theta, double sigma, double rho);
+
+/**
+ * @brief Interpolate a call price for strike K from the current FFT grid
+ * @return Call price, or -1.0 if there is no valid grid
+ */
+double get_cached_option_price(double K);
+
+/**
+ * @brief Precompute the spot-dependent FFT input terms
+ */
+void precompute_fft_values(double S);
+
+/**
+ * @brief Release the precomputed FFT input terms
+ */
+void cleanup_precomputed_values(void);
+
+/**
+ * @brief Release all cached FFT grids, precomputed values and workspaces
+ *
+ * Covers the default context and the contexts the calibration sweep workers
+ * keep between sweeps. Pricing after this allocates the workspaces again.
+ */
+void cleanup_fft_cache(void);
+
+/**
+ * @brief Check whether a parameter set is numerically challenging for the FFT
+ */
+bool is_challenging_parameter_set(double S, double K, double T, double v0, double kappa,
+                                  double theta, double sigma, double rho);
+
+/**
+ * @brief Adapt the FFT grid to the option's moneyness and expiry
+ */
+void adapt_fft_parameters(double S, double K, double T);
+
+/**
+ * @brief Restore the default FFT grid settings
+ */
+void reset_fft_params_to_defaults(void);
+
+/**
+ * @brief Switch to the given alternate FFT parameter set
+ * @return true if the set exists, false when there are no more sets
+ */
+bool try_alternate_fft_params(int attempt);
+
+/**
+ * @brief Heston call price via FFT, with adaptive retries and BS fallback
+ *
+ * Heston prices scale with the spot, C(S, K) = S C(1, K/S). With
+ * HestonFFTConfig.spot_invariant set, grids are built for a unit spot and
+ * keyed without it, so repricing after a spot tick reads the cached grid at
+ * the new moneyness instead of evaluating the characteristic function and
+ * transforming again. Only a new expiry, rate, dividend yield, parameter set
+ * or FFT setting builds a grid. The prices match the default mode to
+ * rounding, except that grids are no longer shared by spots within the
+ * cache tolerance of each other.
+ *
+ * @return Call price, or -1.0 on failure when the BS fallback is disabled
+ */
+double heston_call_fft(double S, double K, double T, double r, double q,
+                       double v0, double kappa, double theta, double sigma, double rho);
+
+/**
+ * @brief Calibrate Heston parameters to one call price and return sqrt(v0)
+ *
+ * With HestonFFTConfig.threads > 1 the grid searches run on that many
+ * worker threads, each with its own context; the first worker to get within
+ * tolerance of the market price stops the others. The worker contexts are
+ * kept for later sweeps, and their grid caches share the configured limit.
+ *
+ * With HestonFFTConfig.mixed_precision (the default) every candidate whose
+ * grid is not cached is first priced on a single-precision grid. Candidates
+ * that miss the best difference so far by more than the screen's error
+ * bound (see HESTON_SCREEN_SAFETY) are dropped; only the rest are priced in
+ * double precision, which decides the result. As long as the bound holds,
+ * the calibration picks the same parameters as without the screen. The
+ * chain calibrations screen their candidates the same way.
+ *
+ * @return Stochastic-volatility implied volatility, or -1.0 on failure
+ */
+double implied_vol_sv(double market_price, double S, double K, double T, double r, double q);
+
+/**
+ * @brief Full calculate_sv_v6 implied volatility procedure
+ *
+ * Adapts the FFT grid for challenging inputs, answers grids the engine could
+ * not build by retrying with alternate FFT parameter sets and finally falls
+ * back to Black-Scholes when that is enabled.
+ *
+ * @param market_price Observed call price
+ * @param S Spot price
+ * @param K Strike price
+ * @param T Time to expiry in years
+ * @param r Risk-free rate
+ * @param q Dividend yield
+ * @param iv Pointer to store the implied volatility
+ *
+ * @return 0 on success, -1 on failure
+ */
+int heston_fft_implied_vol(double market_price, double S, double K, double T,
+                           double r, double q, double* iv);
+
+/**
+ * @brief heston_fft_implied_vol() starting from previously calibrated parameters
+ *
+ * The seed and a ring of nearby sets are tried first. If the best of them is
+ * within HestonFFTConfig.warm_start_max_error of the market price the full
+ * grid search is skipped, which costs a handful of FFTs instead of a hundred
+ * or more; otherwise the usual search runs and the better result wins.
+ *
+ * @param seed Parameters to start from, e.g. from heston_param_store_lookup() (NULL for a cold start)
+ * @param iv Pointer to store the implied volatility
+ * @param fit Pointer to store the fitted parameters, worth saving as the next seed (NULL to ignore)
+ *
+ * @return 0 on success, -1 on failure
+ */
+int heston_fft_implied_vol_seeded(double market_price, double S, double K, double T,
+                                  double r, double q, const HestonParams* seed,
+                                  double* iv, HestonFit* fit);
+
+/**
+ * @brief Implied volatilities for a chain of calls sharing (S, T, r, q)
+ *
+ * Every strike gets the result of heston_fft_implied_vol(): it is seeded,
+ * searched, refined and finalized the same way. Strikes whose searches start
+ * from the same parameter set are swept together, each set costing one FFT
+ * grid that every one of them is read from, and strikes that are not matched
+ * on the coarse grid are refined in clusters that share the same starting
+ * point. Strikes whose FFT settings depend on the option (a tuning table,
+ * extreme moneyness or a very short expiry) and strikes whose grids fail go
+ * through heston_fft_implied_vol() itself.
+ *
+ * @param S Spot price
+ * @param T Time to expiry in years
+ * @param r Risk-free rate
+ * @param q Dividend yield
+ * @param strikes Array of n strike prices
+ * @param prices Array of n observed call prices
+ * @param n Number of options in the chain
+ * @param ivs Array of n entries to store the implied volatilities (-1.0 on failure)
+ *
+ * @return Number of options that failed, or -1 on invalid arguments
+ */
+int heston_fft_implied_vol_chain(double S, double T, double r, double q,
+                                 const double* strikes, const double* prices,
+                                 int n, double* ivs);
+
+/**
+ * @brief heston_fft_implied_vol_chain() in a caller-owned context
+ *
+ * Threads that calibrate different chains at once each use their own
+ * context. The sweeps run serially in that context, and strikes are priced
+ * from whatever the search found even if some of its grids failed (the
+ * default context prices them one by one instead).
+ *
+ * @return Number of options that failed, or -1 on invalid arguments
+ */
+int heston_fft_context_implied_vol_chain(HestonFFTContext* ctx, double S, double T, double r, double q,
+                                         const double* strikes, const double* prices,
+                                         int n, double* ivs);
+
+/**
+ * @brief Heston prices and Greeks for a chain sharing (S, T, r, q) from the cached FFT grid
+ *
+ * The Greeks are read from sensitivity grids computed once per price grid:
+ * the derivatives of the Carr-Madan integrand with respect to log S
+ * (delta, gamma), v0 (vega) and T (theta) are transformed in one batched
+ * FFT next to the cached prices, and rho follows from delta and the price.
+ * A chain therefore costs one price transform and one sensitivity pass.
+ *
+ * Greeks are per unit: theta is -dV/dT per year, vega is dV/d(sqrt(v0))
+ * with the other Heston parameters held fixed, rho is dV/dr.
+ *
+ * @param S Spot price
+ * @param T Time to expiry in years
+ * @param r Risk-free rate
+ * @param q Dividend yield
+ * @param params Heston parameters
+ * @param strikes Array of n strike prices
+ * @param n Number of options in the chain
+ * @param option_type OPTION_CALL or OPTION_PUT for every strike
+ * @param results Array of n entries to store price, Greeks and per-strike error_code
+ *
+ * @return Number of strikes that failed, or -1 on invalid arguments
+ */
+int heston_fft_greeks_chain(double S, double T, double r, double q, const HestonParams* params,
+                            const double* strikes, int n, OptionType option_type,
+                            PricingResult* results);
+
+/**
+ * @brief heston_fft_greeks_chain() in a caller-owned context
+ *
+ * Threads that price different chains at once each use their own context.
+ *
+ * @return Number of strikes that failed, or -1 on invalid arguments
+ */
+int heston_fft_context_greeks_chain(HestonFFTContext* ctx, double S, double T, double r, double q,
+                                    const HestonParams* params, const double* strikes, int n,
+                                    OptionType option_type, PricingResult* results);
+
+/**
+ * @brief Price an option (or compute its implied volatility) with the FFT engine
+ *
+ * Puts are handled through put-call parity on top of the call engine.
+ *
+ * @param S Spot price
+ * @param K Strike price
+ * @param T Time to expiry in years
+ * @param r Risk-free rate
+ * @param q Dividend yield
+ * @param params Heston parameters used for pricing (ignored when market_price > 0)
+ * @param option_type OPTION_CALL or OPTION_PUT
+ * @param market_price Market price for implied volatility calculation (0 to skip)
+ * @param result Pointer to a PricingResult structure to store the result
+ *
+ * @return 0 on success, error code on failure
+ */
+int heston_fft_price_option(double S, double K, double T, double r, double q,
+                            const HestonParams* params, OptionType option_type,
+                            double market_price, PricingResult* result);
+
+/**
+ * @brief heston_fft_price_option() in a caller-owned context
+ *
+ * Threads that price or calibrate options at once each use their own
+ * context. An implied volatility comes from the chain calibration of the one
+ * option (heston_fft_context_implied_vol_chain()), which finds the same
+ * parameters as the single-option search but has no retry ladder or
+ * Black-Scholes fallback when a grid fails.
+ *
+ * @return 0 on success, error code on failure
+ */
+int heston_fft_context_price_option(HestonFFTContext* ctx, double S, double K, double T, double r,
+                                    double q, const HestonParams* params, OptionType option_type,
+                                    double market_price, PricingResult* result);
+
+#endif /* HESTON_FFT_H */
@@ -0,0 +1,100 @@
+#ifndef HESTON_GPU_H
+#define HESTON_GPU_H
+
+#include <stdbool.h>
+
+#include "heston_fft.h"
+
+/**
+ * @file heston_gpu.h
+ * @brief Optional CUDA backend for batches of Carr-Madan FFT grids, part of libheston
+ *
+ * A chain calibration sweep computes one grid per Heston parameter set, and
+ * a surface one sweep per expiry. Every grid is an independent
+ * characteristic function evaluation over N nodes followed by an N-point
+ * transform, so a batch of them maps onto one kernel launch (a thread per
+ * node and grid, the same arithmetic as heston_cf_carr_madan_fill()) and
+ * one batched cuFFT plan. Only the nodes a grid keeps are copied back; the
+ * engine turns them into prices and inserts them into the grid cache like
+ * the grids it computes itself (see HestonFFTConfig.backend).
+ *
+ * The backend is compiled in with `make -f Makefile.unified GPU=cuda`,
+ * which defines HESTON_WITH_CUDA and links cuFFT and the CUDA runtime.
+ * Without it these functions are stubs that report no device, and
+ * HESTON_BACKEND_GPU falls back to the CPU.
+ */
+
+/** Grids per kernel launch and batched transform; larger requests are split */
+#ifndef HESTON_GPU_MAX_BATCH
+#define HESTON_GPU_MAX_BATCH 256
+#endif
+
+/**
+ * Largest difference between a GPU grid price and the CPU reference, as a
+ * fraction of the spot the grid is built for (see HestonFFTConfig.gpu_verify).
+ * Both sides compute in double precision; they differ by the rounding of
+ * the two FFT libraries and math libraries, orders of magnitude below this.
+ */
+#ifndef HESTON_GPU_TOLERANCE
+#define HESTON_GPU_TOLERANCE 1e-8
+#endif
+
+/**
+ * @brief One grid of a batch: expiry and Heston parameters
+ *
+ * Every grid of a batch shares the spot, rates and FFT settings.
+ */
+typedef struct {
+    double T;             /**< Time to expiry in years */
+    HestonParams params;  /**< Heston parameters */
+} HestonGPUGrid;
+
+/**
+ * @brief Check for a usable CUDA device
+ *
+ * The device is probed once; later calls return the cached answer.
+ *
+ * @return true if the library was built with the CUDA backend and a device was found
+ */
+bool heston_gpu_available(void);
+
+/**
+ * @brief Name of the device grids are computed on
+ * @return The device name, or a short reason when heston_gpu_available() is false
+ */
+const char* heston_gpu_device_name(void);
+
+/**
+ * @brief Real parts of the Carr-Madan transforms of a batch of grids
+ *
+ * For each grid computes the FFT input of heston_cf_carr_madan_fill() for
+ * nodes v_i = i eta (v_0 nudged off zero) with Simpson weights and the
+ * phase shift to log-strikes starting at log(S) - pi / eta, runs the
+ * forward transforms, and copies back the real parts of outputs first ..
+ * first + width - 1. Thread-safe; calls are serialized on the device.
+ *
+ * @param fft_n Number of FFT points (power of 2)
+ * @param eta Integration step
+ * @param alpha Carr-Madan dampening factor
+ * @param S Spot price
+ * @param r Risk-free rate
+ * @param q Dividend yield
+ * @param grids Expiries and parameters, count entries
+ * @param count Number of grids
+ * @param first First output node to return
+ * @param width Output nodes to return per grid
+ * @param out Array of count * width values, grid g's nodes at g * width
+ * @return 0 on success, -1 without a device or on a CUDA error
+ */
+int heston_gpu_carr_madan(int fft_n, double eta, double alpha, double S, double r, double q,
+                          const HestonGPUGrid* grids, int count, int first, int width,
+                          double* out);
+
+/**
+ * @brief Free the device buffers and cuFFT plans
+ *
+ * The next heston_gpu_carr_madan() sets them up again.
+ */
+void heston_gpu_release(void);
+
+#endif /* HESTON_GPU_H */
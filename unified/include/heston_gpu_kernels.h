@@ -0,0 +1,65 @@
+#ifndef HESTON_GPU_KERNELS_H
+#define HESTON_GPU_KERNELS_H
+
+/**
+ * @file heston_gpu_kernels.h
+ * @brief Launchers of the CUDA kernels behind heston_gpu.c (HESTON_WITH_CUDA builds only)
+ *
+ * Internal to libheston: heston_gpu.c owns the device, the buffers and the
+ * cuFFT plans and calls these C entry points of heston_gpu_kernels.cu,
+ * which nvcc compiles as C++.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Values per grid in the device parameter array: T, v0, kappa, theta, sigma, rho */
+#define HESTON_GPU_GRID_VALUES 6
+
+/**
+ * @brief Settings shared by every grid of a batch
+ */
+typedef struct {
+    int fft_n;          /**< Nodes per grid */
+    double eta;         /**< Integration step */
+    double alpha;       /**< Carr-Madan dampening factor */
+    double log_S;       /**< Log of the spot */
+    double r;           /**< Risk-free rate */
+    double q;           /**< Dividend yield */
+} HestonGPUFill;
+
+/**
+ * @brief Fill the FFT inputs of count grids
+ *
+ * @param fill Shared settings
+ * @param params Device array of HESTON_GPU_GRID_VALUES values per grid
+ * @param count Number of grids
+ * @param in Device array of count * fft_n complex values (re, im pairs),
+ *           grid g's nodes at g * fft_n
+ * @param stream cudaStream_t to launch on
+ * @return cudaError_t of the launch
+ */
+int heston_gpu_launch_fill(const HestonGPUFill* fill, const double* params, int count,
+                           double* in, void* stream);
+
+/**
+ * @brief Gather the real parts of transform outputs first .. first + width - 1
+ *
+ * @param in Device array of count transforms of fft_n complex values
+ * @param fft_n Points per transform
+ * @param count Number of transforms
+ * @param first First node to keep
+ * @param width Nodes to keep per transform
+ * @param out Device array of count * width values
+ * @param stream cudaStream_t to launch on
+ * @return cudaError_t of the launch
+ */
+int heston_gpu_launch_gather(const double* in, int fft_n, int count, int first, int width,
+                             double* out, void* stream);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HESTON_GPU_KERNELS_H */
@@ -0,0 +1,155 @@
+#ifndef HESTON_MC_H
+#define HESTON_MC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "option_types.h"
+#include "heston_fft.h"
+
+/**
+ * @file heston_mc.h
+ * @brief Quasi-Monte Carlo pricing engine for the Heston model, part of libheston
+ *
+ * Paths are simulated with Andersen's quadratic-exponential (QE) scheme for
+ * the variance, with the martingale correction of the log-spot step, so a
+ * few dozen steps per year are enough. The drivers come from a Sobol
+ * sequence assembled with a Brownian bridge (the coarse shape of every path
+ * uses the best-distributed dimensions), or from xoshiro256** streams. Both
+ * are randomized in independent replicates, whose spread gives the standard
+ * error.
+ *
+ * Paths are simulated in fixed blocks held as struct-of-arrays columns, one
+ * array per state variable, so the step loop runs across paths. Blocks are
+ * claimed by worker threads, but every block has its own Sobol index range
+ * and random stream and the results are reduced in block order, so a price
+ * does not depend on the thread count.
+ *
+ * Besides European options the engine prices the path-dependent products
+ * the Fourier engines cannot: discretely monitored arithmetic Asians,
+ * knock-out barriers and Bermudan options exercisable at every step
+ * (Longstaff-Schwartz). It is also an independent check of the FFT and COS
+ * prices.
+ */
+
+/** Default number of paths */
+#ifndef HESTON_MC_DEFAULT_PATHS
+#define HESTON_MC_DEFAULT_PATHS 32768
+#endif
+
+/** Time steps per year when HestonMCConfig.steps is 0 (at least 8 steps) */
+#ifndef HESTON_MC_STEPS_PER_YEAR
+#define HESTON_MC_STEPS_PER_YEAR 52
+#endif
+
+/** Upper bound for HestonMCConfig.steps */
+#define HESTON_MC_MAX_STEPS 200
+
+/** Independent randomizations; the paths are split evenly between them */
+#define HESTON_MC_REPLICATES 8
+
+/** Paths simulated together in one struct-of-arrays block */
+#define HESTON_MC_BLOCK 128
+
+/** Upper bound for HestonMCConfig.threads */
+#define HESTON_MC_MAX_THREADS 64
+
+/**
+ * @brief Payoffs of the Monte Carlo engine
+ *
+ * Averages and barriers are monitored at the end of every time step.
+ */
+typedef enum {
+    HESTON_MC_EUROPEAN = 0,       /**< Vanilla payoff at expiry */
+    HESTON_MC_ASIAN = 1,          /**< Arithmetic average price */
+    HESTON_MC_UP_AND_OUT = 2,     /**< Vanilla payoff unless the spot reaches the barrier from below */
+    HESTON_MC_DOWN_AND_OUT = 3,   /**< Vanilla payoff unless the spot reaches the barrier from above */
+    HESTON_MC_BERMUDAN = 4        /**< Exercisable at the end of every step, not at t = 0 */
+} HestonMCPayoff;
+
+/**
+ * @brief Settings of one Monte Carlo price
+ */
+typedef struct {
+    HestonMCPayoff payoff;    /**< Product to price */
+    double barrier;           /**< Knock-out level of the barrier payoffs */
+    int paths;                /**< Paths, rounded up to whole blocks per replicate (0 for the default) */
+    int steps;                /**< Time steps (0 for HESTON_MC_STEPS_PER_YEAR) */
+    int threads;              /**< Worker threads (0 for all online processors) */
+    bool quasi_random;        /**< Sobol points with a Brownian bridge instead of pseudo-random numbers */
+    bool antithetic;          /**< Pair every path with its mirror image */
+    bool control_variate;     /**< Use a control with a known price (see heston_mc_price()) */
+    uint64_t seed;            /**< Seed of the randomization */
+} HestonMCConfig;
+
+/**
+ * @brief Outcome of one Monte Carlo price
+ */
+typedef struct {
+    double price;        /**< Price estimate */
+    double std_error;    /**< Standard error from the spread of the replicates */
+    int paths;           /**< Paths simulated */
+    int steps;           /**< Time steps per path */
+} HestonMCResult;
+
+/**
+ * @brief Default settings: European payoff, quasi-random with antithetic
+ *        paths and a control variate, all processors
+ *
+ * @param config Structure to fill
+ */
+void heston_mc_default_config(HestonMCConfig* config);
+
+/**
+ * @brief Monte Carlo price of one option
+ *
+ * The control variate of European options is the discounted terminal spot,
+ * whose price S exp(-qT) is known exactly. Path-dependent payoffs use the
+ * European option of the same strike, priced with the COS engine, so only
+ * the difference between the product and the vanilla is left to sampling.
+ * The control coefficient is estimated from all paths.
+ *
+ * @param S Spot price
+ * @param K Strike price
+ * @param T Time to expiry in years
+ * @param r Risk-free rate
+ * @param q Dividend yield
+ * @param params Heston parameters
+ * @param option_type OPTION_CALL or OPTION_PUT
+ * @param config Settings (NULL for heston_mc_default_config())
+ * @param result Structure to store the price and its standard error
+ *
+ * @return ERROR_NONE on success, ERROR_INVALID_PARAMETER for bad input,
+ *         ERROR_MEMORY_ALLOCATION or ERROR_CALCULATION_FAILED otherwise
+ */
+int heston_mc_price(double S, double K, double T, double r, double q,
+                    const HestonParams* params, OptionType option_type,
+                    const HestonMCConfig* config, HestonMCResult* result);
+
+/**
+ * @brief Price a European option (or compute its implied volatility) with
+ *        the Monte Carlo engine and the default settings
+ *
+ * With a market price, solves for the initial variance v0 (with theta = v0
+ * and the default kappa, sigma and rho, as the Heston adapter prices) that
+ * reproduces it and reports sqrt(v0), as the FFT and COS engines do. Every
+ * trial price reuses the same random numbers, so the price is a smooth
+ * function of v0 and the bisection converges.
+ *
+ * @param S Spot price
+ * @param K Strike price
+ * @param T Time to expiry in years
+ * @param r Risk-free rate
+ * @param q Dividend yield
+ * @param params Heston parameters used for pricing (ignored when market_price > 0)
+ * @param option_type OPTION_CALL or OPTION_PUT
+ * @param market_price Market price for implied volatility calculation (0 to skip)
+ * @param result Pointer to a PricingResult structure to store the result
+ *
+ * @return 0 on success, error code on failure
+ */
+int heston_mc_price_option(double S, double K, double T, double r, double q,
+                           const HestonParams* params, OptionType option_type,
+                           double market_price, PricingResult* result);
+
+#endif /* HESTON_MC_H */
@@ -0,0 +1,89 @@
+#ifndef HESTON_PARAM_STORE_H
+#define HESTON_PARAM_STORE_H
+
+#include <stdint.h>
+
+#include "heston_fft.h"
+
+/**
+ * @file heston_param_store.h
+ * @brief Last calibrated Heston parameters per ticker and expiry bucket
+ *
+ * Parameters calibrated for a ticker a minute or a day ago are nearly right
+ * for the same ticker and a similar expiry now, so they make a good seed for
+ * heston_fft_implied_vol_seeded(). Expiries are grouped into buckets of
+ * increasing width (a week near the front, a year at the back) so that a
+ * contract keeps its bucket for a while as it ages. The store is a small
+ * table loaded into memory and saved as one file, replaced atomically.
+ * Processes that share a file can save it at the same time: each save
+ * merges into what the file holds then. Files use the host byte order.
+ */
+
+/** Store format identification */
+#define HESTON_PARAM_STORE_MAGIC "HPSTORE\0"
+#define HESTON_PARAM_STORE_VERSION 1
+
+/** Longest ticker symbol kept, including the terminating zero */
+#define HESTON_PARAM_TICKER_LEN 16
+
+/**
+ * @brief One stored calibration
+ */
+typedef struct {
+    char ticker[HESTON_PARAM_TICKER_LEN];  /**< Ticker symbol */
+    int32_t bucket_days;                   /**< Expiry bucket, see heston_param_store_bucket() */
+    HestonParams params;                   /**< Calibrated parameters */
+    double relative_error;                 /**< Fit error divided by the option price */
+    int64_t updated;                       /**< Time of the calibration (seconds since the epoch) */
+} HestonParamEntry;
+
+/**
+ * @brief In-memory parameter table backed by a file
+ */
+typedef struct HestonParamStore HestonParamStore;
+
+/**
+ * @brief Load a store, starting empty if the file is missing or invalid
+ * @param path File to load from and save to
+ * @return The store, or NULL on allocation failure
+ */
+HestonParamStore* heston_param_store_open(const char* path);
+
+/**
+ * @brief Save the store, replacing its file atomically
+ *
+ * Under a lock on the file path with ".lock" appended, the file is read
+ * back and the store's entries are merged into it; where both have the
+ * same ticker and bucket, the later calibration is saved.
+ * @return 0 on success, -1 on failure
+ */
+int heston_param_store_save(const HestonParamStore* store);
+
+/**
+ * @brief Free a store without saving it
+ */
+void heston_param_store_close(HestonParamStore* store);
+
+/**
+ * @brief Expiry bucket of a time to expiry
+ * @param T Time to expiry in years
+ * @return Upper edge of the bucket in calendar days
+ */
+int heston_param_store_bucket(double T);
+
+/**
+ * @brief Find the calibration for a ticker and expiry
+ * @return The entry, valid until the next update, or NULL if there is none
+ */
+const HestonParamEntry* heston_param_store_lookup(const HestonParamStore* store,
+                                                  const char* ticker, double T);
+
+/**
+ * @brief Record a calibration, replacing the one in the same bucket
+ * @param relative_error Fit error divided by the option price
+ * @return 0 on success, -1 on invalid arguments or allocation failure
+ */
+int heston_param_store_update(HestonParamStore* store, const char* ticker, double T,
+                              const HestonParams* params, double relative_error);
+
+#endif /* HESTON_PARAM_STORE_H */
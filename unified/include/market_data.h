@@ -8,6 +8,8 @@
 
 #include <time.h>
 
+#include "error_handling.h"
+
 /**
  * @brief Enumeration for data sources
  */
@@ -32,8 +34,31 @@ typedef enum {
     RATE_TERM_30Y = 7  /**< 30-year term */
 } RateTerm;
 
+/**
+ * @brief Kind of value requested by a market data batch entry
+ */
+typedef enum {
+    MARKET_DATA_PRICE = 0,                 /**< Current price, as get_current_price() */
+    MARKET_DATA_DIVIDEND_YIELD = 1,        /**< Dividend yield, as get_dividend_yield() */
+    MARKET_DATA_RISK_FREE_RATE = 2,        /**< Risk-free rate, as get_risk_free_rate() */
+    MARKET_DATA_HISTORICAL_VOLATILITY = 3  /**< Historical volatility, as get_historical_volatility() */
+} MarketDataField;
+
+/**
+ * @brief One entry of a market data batch
+ */
+typedef struct {
+    MarketDataField field;  /**< Value to fetch */
+    const char* ticker;     /**< Ticker symbol (unused for MARKET_DATA_RISK_FREE_RATE) */
+    DataSource source;      /**< Preferred data source (unused for MARKET_DATA_RISK_FREE_RATE) */
+    RateTerm term;          /**< Rate term (MARKET_DATA_RISK_FREE_RATE only) */
+    int days;               /**< Lookback in days (MARKET_DATA_HISTORICAL_VOLATILITY only) */
+    double value;           /**< Set to the value, or a negative value on failure */
+    int error_code;         /**< Set to ERROR_SUCCESS or the error for this entry */
+    int stale;              /**< Set to 1 if the value is an expired cached one (see get_market_data_batch()) */
+} MarketDataRequest;
+
 /* Market data error codes (extends error_handling.h) */
-#define ERROR_SUCCESS                  0    /**< No error */
 #define ERROR_MODULE_NOT_INITIALIZED   -101 /**< Market data module not initialized */
 #define ERROR_INVALID_TICKER           -102 /**< Invalid ticker symbol */
 #define ERROR_INVALID_DATA_SOURCE      -103 /**< Invalid data source */
@@ -45,6 +70,7 @@ typedef enum {
 #define ERROR_ENV_HOME_NOT_SET         -109 /**< HOME environment variable not set */
 #define ERROR_INVALID_DAYS_PARAMETER   -110 /**< Invalid days parameter */
 #define ERROR_RATE_NOT_AVAILABLE       -111 /**< Risk-free rate not available */
+#define ERROR_RATE_LIMITED             -112 /**< Provider request quota used up */
 
 /**
  * @brief Initialize the market data module
@@ -99,6 +125,11 @@ double get_risk_free_rate(RateTerm term, int* error_code);
 
 /**
  * @brief Calculate historical volatility for a ticker symbol
+ *
+ * The periods returned by get_volatility_period_for_expiry() are kept as
+ * rolling statistics per ticker, updated with each new close, so a current
+ * value costs no download and no scan of the series.
+ *
  * @param ticker The ticker symbol
  * @param days Number of trading days to consider
  * @param source Preferred data source
@@ -107,6 +138,39 @@ double get_risk_free_rate(RateTerm term, int* error_code);
  */
 double get_historical_volatility(const char* ticker, int days, DataSource source, int* error_code);
 
+/**
+ * @brief Fetch several market data values at once
+ *
+ * Entries answered by the cache need no request; all others are fetched
+ * concurrently, so the call takes about as long as the slowest request.
+ * Entries may mix fields and tickers, and entries needing the same URL share
+ * one transfer. Requests of every call reuse the module's open connections
+ * and TLS sessions. Like the rest of the module this is not thread-safe.
+ *
+ * Requests are scheduled against the quotas of the providers, which every
+ * process of the user shares (see set_request_rate_limit()):
+ * - A request starts as soon as its provider's quota grants it a token,
+ *   while the others run. Requests still waiting RATE_LIMIT_WAIT_SECONDS
+ *   (config, default 20) after the call started fail with
+ *   ERROR_RATE_LIMITED. A provider that refuses a request as over quota
+ *   gets no further requests for a minute.
+ * - A URL that another process is fetching at the same time is not
+ *   requested again; the entry waits for that process and takes the value
+ *   it cached.
+ * - An entry whose cached value expired less than CACHE_STALE_SECONDS ago
+ *   (config, default one day) does not wait for the quota: it is refreshed
+ *   if a request can start right away, and otherwise, or if the request
+ *   fails, answered with the expired value and stale set.
+ * - With ALPHAVANTAGE_BULK_QUOTES=1 in the config (a premium Alpha Vantage
+ *   endpoint), the prices of up to 100 tickers come from one request.
+ *
+ * @param requests Entries to fill in
+ * @param count Number of entries
+ * @return Number of entries that failed, or a negative error code
+ *         (ERROR_INVALID_PARAMETER, ERROR_MODULE_NOT_INITIALIZED)
+ */
+int get_market_data_batch(MarketDataRequest* requests, int count);
+
 /**
  * @brief Calculate historical volatility from time series data
  * @param json_data JSON data containing time series price information
@@ -121,6 +185,19 @@ double calculate_historical_volatility_from_data(const char* json_data, int peri
  */
 void set_cache_timeout(int seconds);
 
+/**
+ * @brief Set the request quota of a data source
+ *
+ * Also read from the config as ALPHAVANTAGE_REQUESTS_PER_MINUTE,
+ * FINNHUB_REQUESTS_PER_MINUTE and POLYGON_REQUESTS_PER_MINUTE; the defaults
+ * are the free tiers (5, 60 and 5). Up to a minute's worth of requests may
+ * start at once.
+ *
+ * @param source The data source (not DATA_SOURCE_DEFAULT)
+ * @param requests_per_minute Requests per minute, 0 for no limit
+ */
+void set_request_rate_limit(DataSource source, double requests_per_minute);
+
 /**
  * @brief Force refresh of cached market data
  * @param ticker The ticker symbol to refresh (NULL to refresh all)
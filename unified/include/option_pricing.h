@@ -2,6 +2,7 @@
 #define OPTION_PRICING_H
 
 #include "option_types.h"
+#include "heston_fft.h"
 
 /**
  * @file option_pricing.h
@@ -43,6 +44,34 @@ int price_option(
     PricingResult* result
 );
 
+/**
+ * @brief price_option() with the Heston FFT work in a caller-owned context
+ * 
+ * Threads that price at once each pass their own context (see
+ * heston_fft_context_create()); the other engines keep no shared state.
+ * There is no ticker lookup: the market data module is not thread-safe, so
+ * callers fetch the spot price and dividend yield themselves beforehand.
+ * 
+ * @param ctx FFT context for the Heston FFT prices, calibrations and Greeks
+ * 
+ * @return 0 on success, error code on failure
+ */
+int price_option_in_context(
+    HestonFFTContext* ctx,
+    double spot_price,
+    double strike_price,
+    double time_to_expiry,
+    double risk_free_rate,
+    double dividend_yield,
+    double volatility,
+    OptionType option_type,
+    ModelType model_type,
+    NumericalMethod method,
+    double market_price,
+    GreeksFlags greeks_flags,
+    PricingResult* result
+);
+
 /**
  * @brief Calculate implied volatility for an option
  * 
@@ -30,6 +30,8 @@ typedef enum {
     METHOD_ANALYTIC = 0,    /**< Analytic solution (BS only) */
     METHOD_QUADRATURE = 1,  /**< Quadrature-based integration */
     METHOD_FFT = 2,         /**< Fast Fourier Transform */
+    METHOD_COS = 3,         /**< Fourier-cosine series (Fang-Oosterlee) */
+    METHOD_MONTE_CARLO = 4, /**< Quasi-Monte Carlo simulation (Andersen QE) */
     METHOD_DEFAULT = METHOD_ANALYTIC  /**< Default method */
 } NumericalMethod;
 
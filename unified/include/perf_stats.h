@@ -0,0 +1,155 @@
+#ifndef PERF_STATS_H
+#define PERF_STATS_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/**
+ * @file perf_stats.h
+ * @brief Process-wide event counters and timers of the pricing engines
+ *
+ * The engines count the events that decide where time goes (grid cache hits
+ * and misses, FFT executions per size, calibration evaluations, fallbacks,
+ * market data cache hits and network requests) and time the expensive ones.
+ * Updates are relaxed atomic adds, so they are safe from any thread and cost
+ * a few nanoseconds; nothing is recorded per interpolated price. Building
+ * with -DHESTON_NO_PERF_STATS compiles the PERF_* macros away entirely.
+ */
+
+/**
+ * @brief Counted events
+ */
+typedef enum {
+    PERF_GRID_CACHE_HIT = 0,       /**< FFT grid served from the cache */
+    PERF_GRID_CACHE_MISS,          /**< FFT grid computed */
+    PERF_PRECOMPUTE_REUSE,         /**< Precomputed FFT input terms reused */
+    PERF_PRECOMPUTE_BUILD,         /**< Precomputed FFT input terms rebuilt */
+    PERF_CALIBRATION_EVAL,         /**< Parameter sets evaluated by calibration */
+    PERF_CALIBRATION_SWEEP,        /**< Calibration sweeps run */
+    PERF_CALIBRATION_EARLY_STOP,   /**< Sweeps that stopped before the last set */
+    PERF_ALTERNATE_FFT_PARAMS,     /**< Retries with an alternate FFT parameter set */
+    PERF_BS_FALLBACK,              /**< Results that fell back to Black-Scholes */
+    PERF_MARKET_CACHE_HIT,         /**< Market data answered from the cache */
+    PERF_MARKET_NETWORK_REQUEST,   /**< Market data HTTP transfers */
+    PERF_MARKET_NETWORK_FAILURE,   /**< Market data HTTP transfers that failed */
+    PERF_MARKET_RATE_LIMITED,      /**< Market data requests held back or refused for the provider quota */
+    PERF_MARKET_COALESCED,         /**< Market data requests left to another process fetching the same URL */
+    PERF_MARKET_STALE_HIT,         /**< Market data answered with an expired cached value */
+    PERF_WORKSPACE_ALLOC,          /**< FFT workspace blocks allocated or grown */
+    PERF_SCREEN_GRID,              /**< Single-precision screening grids computed */
+    PERF_SCREEN_REJECT,            /**< Calibration candidates dropped by the screen */
+    PERF_TUNING_HIT,               /**< FFT settings taken from the tuning table */
+    PERF_SHARED_GRID_HIT,          /**< Grids copied from a shared segment instead of computed */
+    PERF_GPU_GRID,                 /**< Grids computed in a GPU batch */
+    PERF_GPU_CHECK_FAILURE,        /**< GPU grids that missed the CPU reference, turning the GPU off */
+    PERF_COUNTER_COUNT
+} PerfCounter;
+
+/**
+ * @brief Timed operations
+ */
+typedef enum {
+    PERF_TIMER_GRID_BUILD = 0,        /**< Computing one FFT grid, fill and transform */
+    PERF_TIMER_CALIBRATION_SWEEP,     /**< One calibration sweep */
+    PERF_TIMER_MARKET_FETCH,          /**< One batch of concurrent market data transfers */
+    PERF_TIMER_MC_SIMULATION,         /**< Simulating the paths of one Monte Carlo price */
+    PERF_TIMER_GPU_BATCH,             /**< One batch of grids on the GPU, copies included */
+    PERF_TIMER_COUNT
+} PerfTimer;
+
+/** FFT sizes are recorded by log2(N), N = 2 .. 2^31 */
+#define PERF_FFT_SIZE_SLOTS 32
+
+/**
+ * @brief Accumulated durations of one timer
+ */
+typedef struct {
+    uint64_t count;     /**< Timed operations */
+    uint64_t total_ns;  /**< Total duration */
+    uint64_t max_ns;    /**< Longest single duration */
+} PerfTiming;
+
+/**
+ * @brief Snapshot of all counters and timers
+ */
+typedef struct {
+    uint64_t counters[PERF_COUNTER_COUNT];   /**< Indexed by PerfCounter */
+    PerfTiming timers[PERF_TIMER_COUNT];     /**< Indexed by PerfTimer */
+    PerfTiming fft[PERF_FFT_SIZE_SLOTS];     /**< FFT executions, indexed by log2(N) */
+    double uptime_seconds;                   /**< Time since the last reset (0 if never reset) */
+} PerfStats;
+
+#ifdef HESTON_NO_PERF_STATS
+#define PERF_COUNT(counter) ((void)0)
+#define PERF_START(var) ((void)0)
+#define PERF_STOP(timer, var) ((void)0)
+#define PERF_STOP_FFT(n, var) ((void)0)
+#else
+/** Count one event */
+#define PERF_COUNT(counter) perf_stats_add((counter), 1)
+/** Start timing into a uint64_t local declared with PERF_START */
+#define PERF_START(var) uint64_t var = perf_now_ns()
+/** Record the time since the matching PERF_START */
+#define PERF_STOP(timer, var) perf_stats_time((timer), perf_now_ns() - (var))
+/** Record one FFT execution of size n since the matching PERF_START */
+#define PERF_STOP_FFT(n, var) perf_stats_fft((n), perf_now_ns() - (var))
+#endif
+
+/**
+ * @brief Monotonic clock in nanoseconds
+ */
+uint64_t perf_now_ns(void);
+
+/**
+ * @brief Add to a counter
+ */
+void perf_stats_add(PerfCounter counter, uint64_t amount);
+
+/**
+ * @brief Record one duration of a timer
+ */
+void perf_stats_time(PerfTimer timer, uint64_t ns);
+
+/**
+ * @brief Record one FFT execution of size n (any size, rounded up to a power of 2)
+ */
+void perf_stats_fft(int n, uint64_t ns);
+
+/**
+ * @brief Copy the current values
+ *
+ * Counters are read one by one, so a snapshot taken while other threads
+ * record events may mix values from slightly different moments.
+ */
+void perf_stats_snapshot(PerfStats* stats);
+
+/**
+ * @brief Zero all counters and timers and restart the uptime
+ *
+ * Programs that report statistics call this once at startup.
+ */
+void perf_stats_reset(void);
+
+/**
+ * @brief JSON key of a counter, e.g. "grid_cache_hits"
+ */
+const char* perf_counter_name(PerfCounter counter);
+
+/**
+ * @brief JSON key of a timer, e.g. "grid_build"
+ */
+const char* perf_timer_name(PerfTimer timer);
+
+/**
+ * @brief Write a snapshot as one JSON object
+ *
+ * Layout: {"uptime_s": ..., "counters": {name: count, ...},
+ * "timers": {name: {"count", "total_ms", "mean_us", "max_us"}, ...},
+ * "fft_executions": {"N": {same fields}, ...}}. FFT sizes that never ran
+ * are left out.
+ *
+ * @return 0 on success, -1 on a write error
+ */
+int perf_stats_write_json(FILE* out, const PerfStats* stats);
+
+#endif /* PERF_STATS_H */
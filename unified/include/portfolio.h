@@ -0,0 +1,129 @@
+#ifndef PORTFOLIO_H
+#define PORTFOLIO_H
+
+#include <stdio.h>
+
+#include "option_types.h"
+#include "market_data.h"
+
+/**
+ * @file portfolio.h
+ * @brief Revaluation of a book of option positions in one process
+ *
+ * The market data of every ticker (spot, dividend yield, historical
+ * volatility over the period that suits each expiry, and the Treasury rate
+ * of each term) is fetched in one concurrent batch with
+ * get_market_data_batch(). Positions are then grouped by (ticker, expiry):
+ * a group shares S, T, r, q and the Heston parameters, so all of its calls
+ * and puts are priced with their Greeks from one FFT grid and its
+ * sensitivity grids (heston_fft_context_greeks_chain()).
+ *
+ * Groups run on a work-stealing pool: each worker thread owns a pricing
+ * context and a queue of groups, dealt out heaviest first. A worker takes
+ * the heaviest group left in its own queue and, once that is empty, steals
+ * the lightest group left in another worker's queue, so a few large chains
+ * do not leave the other threads idle at the end.
+ */
+
+/** Longest ticker symbol in a positions file */
+#define PORTFOLIO_MAX_TICKER 16
+
+/**
+ * @brief One position, with its valuation once priced
+ */
+typedef struct {
+    char ticker[PORTFOLIO_MAX_TICKER + 1]; /**< Underlying ticker */
+    OptionType option_type;  /**< OPTION_CALL or OPTION_PUT */
+    double strike;           /**< Strike price */
+    double expiry;           /**< Time to expiry in years */
+    double quantity;         /**< Number of options, negative for a short position */
+    double spot;             /**< Spot price used */
+    double dividend_yield;   /**< Dividend yield used */
+    double volatility;       /**< Historical volatility used (sqrt of the Heston v0 and theta) */
+    double rate;             /**< Risk-free rate used */
+    PricingResult result;    /**< Price and Greeks of one option; error_code set if it could not be priced */
+} PortfolioPosition;
+
+/**
+ * @brief Sums of quantity times price and Greeks over a set of positions
+ */
+typedef struct {
+    char ticker[PORTFOLIO_MAX_TICKER + 1]; /**< Ticker, or "TOTAL" for the whole book */
+    int positions;           /**< Positions of the ticker */
+    int failed;              /**< Positions that could not be priced, left out of the sums */
+    double value;            /**< Market value */
+    double delta;            /**< Delta in units of the underlying */
+    double gamma;            /**< Change of delta per unit of spot */
+    double theta;            /**< Value lost per year */
+    double vega;             /**< Value change per unit of volatility */
+    double rho;              /**< Value change per unit of rate */
+} PortfolioExposure;
+
+/**
+ * @brief Revaluation settings
+ */
+typedef struct {
+    const char* positions_path; /**< Positions file ("-" for stdin) */
+    const char* config_path;    /**< Market data configuration (NULL for default) */
+    DataSource source;          /**< Market data source for every ticker */
+    int threads;                /**< Worker threads (values below 1 for one per online CPU) */
+    double rate;                /**< Risk-free rate for every position, negative to fetch Treasury rates */
+} PortfolioOptions;
+
+/**
+ * @brief Fill in the default settings (no positions file)
+ */
+void portfolio_default_options(PortfolioOptions* options);
+
+/**
+ * @brief Read positions from a CSV file
+ *
+ * Rows are ticker,type,strike,expiry,quantity where type is call or put (or
+ * c, p, 0, 1) and expiry is a date (YYYY-MM-DD) or years to expiry. Blank
+ * lines, comments (#) and a header row are skipped; malformed rows and
+ * expired positions are skipped with a warning.
+ *
+ * @param in Stream to read
+ * @param positions Pointer to store the array of positions (free() it)
+ * @return Number of positions read, or -1 on allocation failure
+ */
+int portfolio_read_positions(FILE* in, PortfolioPosition** positions);
+
+/**
+ * @brief Fetch the market data of the positions and price them
+ *
+ * The market data module must be initialized. Spot, dividend yield,
+ * volatility and rate are written to each position, the price and Greeks to
+ * its result.
+ *
+ * @param positions Array of count positions
+ * @param count Number of positions
+ * @param options Source, thread count and rate (positions_path is not used)
+ * @return Number of positions that could not be priced, or -1 on invalid arguments
+ */
+int portfolio_price(PortfolioPosition* positions, int count, const PortfolioOptions* options);
+
+/**
+ * @brief Aggregate priced positions per ticker
+ *
+ * @param positions Array of count priced positions
+ * @param count Number of positions
+ * @param exposures Pointer to store one entry per ticker in order of first
+ *                  appearance, followed by the TOTAL entry (free() it)
+ * @return Number of entries including TOTAL, or -1 on allocation failure
+ */
+int portfolio_exposures(const PortfolioPosition* positions, int count, PortfolioExposure** exposures);
+
+/**
+ * @brief Read, price and aggregate a positions file and write the CSV report to stdout
+ *
+ * The report has one row per position, then a blank line and one row per
+ * ticker with the TOTAL row last.
+ *
+ * @param options Revaluation settings
+ * @return 0 if every position was priced, 1 if some were not, -1 if the
+ *         positions could not be read
+ */
+int portfolio_run(const PortfolioOptions* options);
+
+#endif /* PORTFOLIO_H */
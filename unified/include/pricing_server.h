@@ -0,0 +1,103 @@
+#ifndef PRICING_SERVER_H
+#define PRICING_SERVER_H
+
+#include <stdbool.h>
+
+/**
+ * @file pricing_server.h
+ * @brief Long-running pricing server for unified_pricer
+ *
+ * The server prices options for any number of clients connected over a Unix
+ * or TCP socket. The process, and with it the FFT grid cache, the FFTW plans,
+ * the market data module and its open connections, stays up between
+ * requests, so a quote costs no process startup and no cold cache.
+ *
+ * The protocol is line-delimited JSON: each request is one JSON object on a
+ * line, answered by one JSON object on a line, in order. Clients may send
+ * several requests before reading the answers. See the user guide for the
+ * request fields.
+ *
+ * Every client gets its own thread, which reads, prices and answers its
+ * requests in an FFT context (grid cache and plans) of its own, reset to the
+ * configured FFT settings before each request. Only ticker lookups are
+ * serialized, because the market data module is not thread-safe.
+ *
+ * The stream mode instead consumes a continuous feed of option quotes, one
+ * JSON object per line, through the quote_stream.h pipeline and writes the
+ * implied volatilities and Heston fits it keeps current as JSON lines.
+ */
+
+/** Default number of simultaneous clients */
+#define PRICING_SERVER_DEFAULT_MAX_CLIENTS 64
+
+/** Longest accepted request line in bytes */
+#define PRICING_SERVER_MAX_LINE 65536
+
+/** Longest time a logged request error stays buffered before the server writes it out */
+#define PRICING_SERVER_LOG_FLUSH_MS 1000
+
+/**
+ * @brief Server settings
+ */
+typedef struct {
+    const char* address;       /**< "unix:PATH", "tcp:PORT" or "tcp:HOST:PORT" */
+    int max_clients;           /**< Connections served at once, further clients are refused */
+    const char* config_path;   /**< Market data configuration (NULL for default) */
+    const char* wisdom_path;   /**< FFTW wisdom loaded at startup and saved at shutdown (NULL to skip) */
+    bool spot_invariant;       /**< Price on unit-spot FFT grids reused across spot ticks (HestonFFTConfig.spot_invariant) */
+    bool double_precision;     /**< Calibrate without the single-precision screen (HestonFFTConfig.mixed_precision off) */
+    const char* tuning_path;   /**< FFT settings table loaded at startup (NULL to adapt at run time) */
+    const char* publish_path;  /**< Shared segment computed grids are published to (NULL to keep them private) */
+    const char* error_log_path; /**< File failed and malformed requests are appended to (NULL for no log) */
+} PricingServerOptions;
+
+/**
+ * @brief Fill in the default settings (no address)
+ */
+void pricing_server_default_options(PricingServerOptions* options);
+
+/**
+ * @brief Run the server until SIGINT or SIGTERM
+ *
+ * A Unix socket file left over from an earlier run is replaced, and removed
+ * again at shutdown. Errors answered to clients go through log_error() and
+ * reach the error log within PRICING_SERVER_LOG_FLUSH_MS. Failing to initialize market data is not fatal; only
+ * requests with a ticker are answered with an error then.
+ *
+ * @param options Server settings
+ * @return 0 after a clean shutdown, -1 if the socket could not be set up
+ */
+int pricing_server_run(const PricingServerOptions* options);
+
+/**
+ * @brief Quote stream settings
+ */
+typedef struct {
+    const char* input_path;    /**< Quote feed ("-" for stdin, or a file or FIFO) */
+    int capacity;              /**< Ring slots between two pipeline stages */
+    int min_fit_quotes;        /**< Quotes with an implied volatility a chain needs before it is calibrated */
+    double refit_interval;     /**< Least seconds between two calibrations of a chain */
+    double stats_interval;     /**< Seconds between two stats lines (0 for one at the end only) */
+    bool spot_invariant;       /**< Price on unit-spot FFT grids reused across spot ticks (HestonFFTConfig.spot_invariant) */
+} PricingStreamOptions;
+
+/**
+ * @brief Fill in the default stream settings (quotes from stdin)
+ */
+void pricing_stream_default_options(PricingStreamOptions* options);
+
+/**
+ * @brief Run the quote pipeline over a feed until its end, SIGINT or SIGTERM
+ *
+ * Every input line is a quote with the price request fields ticker, type,
+ * spot, strike, expiry, rate, dividend and market_price; malformed lines are
+ * skipped with a warning. Quote, fit and stats events are written to stdout,
+ * a line each.
+ *
+ * @param options Stream settings
+ * @return 0 after the feed ended or a stop signal, -1 if the feed could not
+ *         be opened or the pipeline could not be started
+ */
+int pricing_stream_run(const PricingStreamOptions* options);
+
+#endif /* PRICING_SERVER_H */
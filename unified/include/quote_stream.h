@@ -0,0 +1,189 @@
+#ifndef QUOTE_STREAM_H
+#define QUOTE_STREAM_H
+
+#include <stdint.h>
+
+#include "option_types.h"
+#include "heston_calibration.h"
+#include "black_scholes_batch.h"
+#include "perf_stats.h"
+
+/**
+ * @file quote_stream.h
+ * @brief Streaming pipeline from option quotes to implied vols and Heston fits, part of libheston
+ *
+ * Quotes pass through four stages, each on its own thread and connected to
+ * the next by a lock-free single-producer/single-consumer ring:
+ *
+ * - ingest: the caller pushes quotes with quote_stream_push();
+ * - iv: Black-Scholes implied volatilities of every batch taken off the
+ *   ring (bs_implied_vol_batch());
+ * - fit: keeps the latest quote of every strike per chain (ticker and
+ *   expiry), prices each quote with the chain's last Heston fit from a
+ *   cached FFT grid, and recalibrates changed chains one at a time with
+ *   heston_calibrate() seeded from their last fit, on a helper thread so
+ *   that quotes keep flowing during a calibration;
+ * - publish: hands every quote and fit to the caller's callback.
+ *
+ * A stage never waits for a full ring. It keeps what it cannot hand on in
+ * a pending table in which a newer tick of the same instrument (or a newer
+ * fit of the same chain) replaces the older one, and a stage taking a batch
+ * off its ring drops the older ticks of an instrument in the same way. Under
+ * backpressure the pipeline therefore skips stale ticks and always prices
+ * the latest quote, and the changes a chain sees during a calibration are
+ * coalesced into its next one.
+ */
+
+/** Longest ticker symbol, including the terminating zero */
+#define QUOTE_STREAM_TICKER_LEN 16
+
+/** Default ring slots between two stages */
+#define QUOTE_STREAM_DEFAULT_CAPACITY 4096
+
+/**
+ * @brief Pipeline stages
+ */
+typedef enum {
+    QUOTE_STREAM_INGEST = 0,   /**< quote_stream_push() into the first ring */
+    QUOTE_STREAM_IV,           /**< Black-Scholes implied volatilities */
+    QUOTE_STREAM_FIT,          /**< Model prices and Heston recalibration */
+    QUOTE_STREAM_PUBLISH,      /**< Publish callback */
+    QUOTE_STREAM_STAGE_COUNT
+} QuoteStreamStage;
+
+/**
+ * @brief One option quote
+ */
+typedef struct {
+    char ticker[QUOTE_STREAM_TICKER_LEN]; /**< Underlying ticker */
+    OptionType type;   /**< OPTION_CALL or OPTION_PUT */
+    double S;          /**< Spot price */
+    double K;          /**< Strike price */
+    double T;          /**< Time to expiry in years */
+    double r;          /**< Risk-free rate */
+    double q;          /**< Dividend yield */
+    double price;      /**< Option price */
+} StreamQuote;
+
+/**
+ * @brief Kind of a published event
+ */
+typedef enum {
+    STREAM_EVENT_QUOTE = 0,   /**< A quote with its implied and model volatilities */
+    STREAM_EVENT_FIT          /**< A new Heston fit of a chain */
+} StreamEventType;
+
+/**
+ * @brief One published quote or fit
+ */
+typedef struct {
+    StreamEventType type;
+    StreamQuote quote;            /**< The quote; for a fit the chain's ticker, T, and the S, r, q it was fitted at */
+    double iv;                    /**< Black-Scholes implied volatility, -1.0 if there is none */
+    IVStatus iv_status;           /**< Outcome of the implied volatility solve */
+    double model_price;           /**< Price under the chain's last fit, -1.0 before the first fit */
+    double model_iv;              /**< Black-Scholes implied volatility of model_price, -1.0 if there is none */
+    HestonCalibrationResult fit;  /**< Fitted parameters (STREAM_EVENT_FIT) */
+    int fit_quotes;               /**< Quotes the fit was calibrated to (STREAM_EVENT_FIT) */
+    uint64_t latency_ns;          /**< Time from quote_stream_push() to the publish callback (for a fit, of the chain's newest quote) */
+} StreamEvent;
+
+/**
+ * @brief Publish callback, called on the publish thread in order of arrival
+ */
+typedef void (*QuoteStreamPublish)(const StreamEvent* event, void* user);
+
+/**
+ * @brief Pipeline settings
+ */
+typedef struct {
+    int capacity;           /**< Ring slots between two stages (rounded up to a power of 2) */
+    int min_fit_quotes;     /**< Quotes with an implied volatility a chain needs before it is calibrated */
+    int refit_iterations;   /**< Iteration limit of a recalibration seeded from the last fit */
+    double refit_interval;  /**< Least time between two calibrations of a chain, in seconds */
+    HestonCalibrationOptions calibration;  /**< Settings of the first fit of a chain */
+    QuoteStreamPublish publish;            /**< Callback for every event (NULL to drop them) */
+    void* user;                            /**< Passed to the callback */
+} QuoteStreamOptions;
+
+/**
+ * @brief Throughput and latency of one stage
+ */
+typedef struct {
+    uint64_t records;     /**< Records the stage handed on */
+    uint64_t coalesced;   /**< Records the stage dropped for a newer one of the same instrument or chain */
+    PerfTiming latency;   /**< Time from entering the stage's input to leaving the stage */
+} QuoteStreamStageStats;
+
+/**
+ * @brief Snapshot of the pipeline counters
+ */
+typedef struct {
+    QuoteStreamStageStats stages[QUOTE_STREAM_STAGE_COUNT]; /**< Indexed by QuoteStreamStage */
+    PerfTiming end_to_end;   /**< Time from quote_stream_push() to the publish callback, per quote */
+    uint64_t fits;           /**< Completed calibrations */
+    uint64_t fit_failures;   /**< Calibrations that failed, leaving the chain's last fit in place */
+    int chains;              /**< Chains in the fit stage's book */
+} QuoteStreamStats;
+
+/**
+ * @brief Running pipeline
+ */
+typedef struct QuoteStream QuoteStream;
+
+/**
+ * @brief Fill in the default settings
+ *
+ * QUOTE_STREAM_DEFAULT_CAPACITY slots, calibration once a chain has
+ * HESTON_NUM_PARAMS quotes, 20 iterations for a recalibration, no minimum
+ * interval, the default calibration settings and no callback.
+ */
+void quote_stream_default_options(QuoteStreamOptions* options);
+
+/**
+ * @brief Start the iv, fit and publish threads and the fit stage's helper
+ *
+ * The calling thread becomes the ingest stage: quote_stream_push() and
+ * quote_stream_close() must be called from one thread at a time.
+ *
+ * @param options Settings, or NULL for the defaults
+ * @return The pipeline, or NULL on invalid settings, allocation failure or
+ *         if the threads could not be started
+ */
+QuoteStream* quote_stream_start(const QuoteStreamOptions* options);
+
+/**
+ * @brief Feed one quote into the pipeline without waiting
+ *
+ * If the first ring is full the quote replaces any pending tick of the same
+ * instrument (ticker, type, strike and expiry) until there is room.
+ *
+ * @return 0 on success, -1 for an invalid quote or on allocation failure
+ */
+int quote_stream_push(QuoteStream* stream, const StreamQuote* quote);
+
+/**
+ * @brief Copy the current counters
+ *
+ * Safe from any thread while the pipeline runs; the counters of different
+ * stages are read one by one.
+ */
+void quote_stream_stats(const QuoteStream* stream, QuoteStreamStats* stats);
+
+/**
+ * @brief Drain the pipeline, stop its threads and free it
+ *
+ * Every quote pushed so far is published unless a newer tick of the same
+ * instrument replaced it, followed by a last fit of every chain changed
+ * since its previous fit.
+ *
+ * @param stats Pointer to store the final counters (may be NULL)
+ */
+void quote_stream_close(QuoteStream* stream, QuoteStreamStats* stats);
+
+/**
+ * @brief Name of a stage, e.g. "iv"
+ */
+const char* quote_stream_stage_name(QuoteStreamStage stage);
+
+#endif /* QUOTE_STREAM_H */
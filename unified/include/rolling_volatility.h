@@ -0,0 +1,89 @@
+#ifndef ROLLING_VOLATILITY_H
+#define ROLLING_VOLATILITY_H
+
+#include <stdint.h>
+
+#include "time_series_store.h"
+
+/**
+ * @file rolling_volatility.h
+ * @brief Rolling close-to-close volatilities kept up to date bar by bar
+ *
+ * For every tracked window the state holds the count, mean and sum of
+ * squared deviations of the window's log returns (Welford's method with
+ * removal). A new close adds its return to every window and drops the
+ * return that leaves it, so each window costs O(1) per bar however long it
+ * is. The state remembers how far into a ticker's bar store it has got and
+ * is saved next to it; when the store's bars were replaced rather than
+ * appended, the state is rebuilt from the bars.
+ */
+
+/** Number of tracked windows */
+#define RV_WINDOW_COUNT 5
+
+/** Tracked window lengths in returns, those of get_volatility_period_for_expiry() */
+#define RV_WINDOWS {10, 20, 60, 90, 180}
+
+/**
+ * @brief Running statistics of one window
+ */
+typedef struct {
+    int32_t n;    /**< Returns in the window (fewer than the length while filling) */
+    double mean;  /**< Mean log return */
+    double m2;    /**< Sum of squared deviations from the mean */
+} RVWindow;
+
+/**
+ * @brief Rolling volatility state of one ticker
+ */
+typedef struct {
+    uint32_t generation;                 /**< Store generation the state was built from */
+    int32_t bars;                        /**< Store bars consumed */
+    int32_t last_date;                   /**< Date of the last consumed bar */
+    double last_close;                   /**< Close of the last consumed bar */
+    RVWindow window[RV_WINDOW_COUNT];    /**< One entry per tracked window, in RV_WINDOWS order */
+} RollingVolState;
+
+/**
+ * @brief Reset a state to "no bars consumed"
+ */
+void rv_state_init(RollingVolState* state);
+
+/**
+ * @brief Load a saved state
+ * @return 0 on success, -1 if the file is missing or invalid (state is reset)
+ */
+int rv_state_load(const char* path, RollingVolState* state);
+
+/**
+ * @brief Save a state, replacing the file atomically
+ * @return 0 on success, -1 on failure
+ */
+int rv_state_save(const char* path, const RollingVolState* state);
+
+/**
+ * @brief Bring a state up to date with a bar store
+ *
+ * Consumes the bars appended since the last update, or rebuilds the state
+ * from all bars if they were replaced since.
+ *
+ * @return Number of bars consumed (0 if the state was current)
+ */
+int rv_update(RollingVolState* state, const TimeSeriesView* view);
+
+/**
+ * @brief Index of a tracked window length
+ * @return Index into RollingVolState::window, or -1 if the length is not tracked
+ */
+int rv_window_index(int period_days);
+
+/**
+ * @brief Annualized volatility of a tracked window
+ *
+ * Agrees with ts_historical_volatility() over the same bars.
+ *
+ * @return Volatility, or -1.0 if the window is not tracked or holds fewer than two returns
+ */
+double rv_volatility(const RollingVolState* state, int period_days);
+
+#endif /* ROLLING_VOLATILITY_H */
@@ -0,0 +1,208 @@
+#ifndef SIMD_MATH_H
+#define SIMD_MATH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+
+/**
+ * @file simd_math.h
+ * @brief Branch-free building blocks for the vectorized libheston kernels
+ *
+ * Internal to libheston. The functions are the Cephes polynomial
+ * approximations written without branches, so loops that call them contain
+ * only arithmetic, comparisons and bit operations and vectorize under any
+ * SIMD target. Translation units using this header are built with
+ * SIMD_CFLAGS (see Makefile.unified).
+ */
+
+/* Build one clone per instruction set and dispatch at load time (ifunc) */
+#if !defined(HESTON_NO_SIMD_DISPATCH) && defined(__GNUC__) && defined(__x86_64__) && \
+    defined(__linux__)
+#define SIMD_DISPATCH 1
+#define SIMD_CLONES __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define SIMD_DISPATCH 0
+#define SIMD_CLONES
+#endif
+
+/* Every helper must be inlined into the loops for them to vectorize, and
+ * conditions use & and | rather than && and || so they stay branch-free.
+ * Selects only ever choose between values that were already computed:
+ * arithmetic under a condition may trap and is not if-converted. */
+#if defined(__GNUC__)
+#define SIMD_INLINE static inline __attribute__((always_inline))
+#else
+#define SIMD_INLINE static inline
+#endif
+
+#define SIMD_LOG2E   1.4426950408889634073599
+#define SIMD_SQRTH   0.70710678118654752440
+
+/* ---- Bit-level helpers ---- */
+
+SIMD_INLINE uint64_t as_bits(double x) {
+    uint64_t u;
+    memcpy(&u, &x, sizeof(u));
+    return u;
+}
+
+SIMD_INLINE double from_bits(uint64_t u) {
+    double x;
+    memcpy(&x, &u, sizeof(x));
+    return x;
+}
+
+/* 2^n for an integral n in [-1022, 1023] without integer conversions */
+SIMD_INLINE double pow2_int(double n) {
+    /* Adding 1.5 * 2^52 leaves n in the low mantissa bits */
+    uint64_t bits = as_bits(n + 6755399441055744.0);
+    return from_bits((bits + 1023) << 52);
+}
+
+/* ---- Real transcendental functions ---- */
+
+/* exp(x), the Cephes rational approximation on [-ln2/2, ln2/2] */
+SIMD_INLINE double simd_exp(double x) {
+    const double C1 = 6.93145751953125E-1;
+    const double C2 = 1.42860682030941723212E-6;
+
+    double xc = x > 709.78 ? 709.78 : x;   /* Clamp in two selects, as in simd_log() */
+    xc = xc < -745.2 ? -745.2 : xc;
+    double n = floor(SIMD_LOG2E * xc + 0.5);
+    double t = xc - n * C1;
+    t -= n * C2;
+
+    double tt = t * t;
+    double px = t * ((1.26177193074810590878E-4 * tt + 3.02994407707441961300E-2) * tt +
+                     9.99999999999999999910E-1);
+    double qx = ((3.00198505138664455042E-6 * tt + 2.52448340349684104192E-3) * tt +
+                 2.27265548208155028766E-1) * tt + 2.00000000000000000009E0;
+    double y = 1.0 + 2.0 * (px / (qx - px));
+
+    /* Split the scaling so results near both ends of the range are exact */
+    double n1 = floor(0.5 * n);
+    y = y * pow2_int(n1) * pow2_int(n - n1);
+
+    y = x > 709.78 ? HUGE_VAL : y;
+    y = x < -745.2 ? 0.0 : y;
+    return x != x ? x : y;
+}
+
+/* log(x) for x >= 0, the Cephes rational approximation around 1 */
+SIMD_INLINE double simd_log(double x) {
+    /* Scale subnormals into the normal range first */
+    bool tiny = x < DBL_MIN;
+    double scaled = x * 18014398509481984.0;            /* 2^54 */
+    double xs = tiny ? scaled : x;
+    uint64_t bits = as_bits(xs);
+
+    /* Exponent as a double, again without integer conversions */
+    double e = from_bits((bits >> 52) | 0x4330000000000000ULL) - 4503599627370496.0 - 1022.0;
+    e -= tiny ? 54.0 : 0.0;
+    double m = from_bits((bits & 0x000fffffffffffffULL) | 0x3fe0000000000000ULL);  /* [0.5, 1) */
+
+    bool low = m < SIMD_SQRTH;
+    e -= low ? 1.0 : 0.0;
+    double f_low = 2.0 * m - 1.0;
+    double f_high = m - 1.0;
+    double f = low ? f_low : f_high;
+
+    double z = f * f;
+    double p = ((((1.01875663804580931796E-4 * f + 4.97494994976747001425E-1) * f +
+                  4.70579119878881725854E0) * f + 1.44989225341610930846E1) * f +
+                1.79368678507819816313E1) * f + 7.70838733755885391666E0;
+    double qd = ((((f + 1.12873587189167450590E1) * f + 4.52279145837532221105E1) * f +
+                  8.29875266912776603211E1) * f + 7.11544750618563894466E1) * f +
+                2.31251620126765340583E1;
+    double y = f * (z * p / qd);
+    y -= e * 2.121944400546905827679E-4;
+    y -= 0.5 * z;
+    double r = f + y + e * 0.693359375;
+
+    /* One condition per select: once the caller has bounded x, combined
+     * conditions fold into boolean selects the vectorizer rejects */
+    r = x == 0.0 ? -HUGE_VAL : r;
+    r = x == HUGE_VAL ? HUGE_VAL : r;
+    r = x < 0.0 ? NAN : r;
+    return x != x ? x : r;
+}
+
+/* ---- Single precision ----
+ *
+ * The same approximations with the Cephes single-precision coefficients,
+ * for kernels that trade accuracy for twice the vector width. Every
+ * constant carries an f suffix so nothing is promoted to double. */
+
+SIMD_INLINE uint32_t as_bits_f(float x) {
+    uint32_t u;
+    memcpy(&u, &x, sizeof(u));
+    return u;
+}
+
+SIMD_INLINE float from_bits_f(uint32_t u) {
+    float x;
+    memcpy(&x, &u, sizeof(x));
+    return x;
+}
+
+/* 2^n for an integral n in [-126, 127] */
+SIMD_INLINE float pow2_int_f(float n) {
+    /* Adding 1.5 * 2^23 leaves n in the low mantissa bits */
+    uint32_t bits = as_bits_f(n + 12582912.0f);
+    return from_bits_f((bits + 127) << 23);
+}
+
+/* expf(x), the Cephes polynomial on [-ln2/2, ln2/2] */
+SIMD_INLINE float simd_expf(float x) {
+    /* Bounds keep 2^n normal, so one scaling step is enough */
+    float xc = x > 88.3f ? 88.3f : x;
+    xc = xc < -87.3f ? -87.3f : xc;
+    float n = floorf(1.44269504088896341f * xc + 0.5f);
+    float t = xc - n * 0.693359375f;
+    t += n * 2.12194440e-4f;
+
+    float tt = t * t;
+    float y = (((((1.9875691500E-4f * t + 1.3981999507E-3f) * t + 8.3334519073E-3f) * t +
+                 4.1665795894E-2f) * t + 1.6666665459E-1f) * t + 5.0000001201E-1f) * tt + t + 1.0f;
+    y *= pow2_int_f(n);
+
+    y = x > 88.3f ? HUGE_VALF : y;
+    y = x < -87.3f ? 0.0f : y;
+    return x != x ? x : y;
+}
+
+/* logf(x) for x >= 0, the Cephes polynomial around 1 */
+SIMD_INLINE float simd_logf(float x) {
+    bool tiny = x < FLT_MIN;
+    float scaled = x * 33554432.0f;                     /* 2^25 */
+    float xs = tiny ? scaled : x;
+    uint32_t bits = as_bits_f(xs);
+
+    float e = from_bits_f((bits >> 23) | 0x4b000000U) - 8388608.0f - 126.0f;
+    e -= tiny ? 25.0f : 0.0f;
+    float m = from_bits_f((bits & 0x007fffffU) | 0x3f000000U);  /* [0.5, 1) */
+
+    bool low = m < (float)SIMD_SQRTH;
+    e -= low ? 1.0f : 0.0f;
+    float f_low = 2.0f * m - 1.0f;
+    float f_high = m - 1.0f;
+    float f = low ? f_low : f_high;
+
+    float z = f * f;
+    float y = ((((((((7.0376836292E-2f * f - 1.1514610310E-1f) * f + 1.1676998740E-1f) * f -
+                    1.2420140846E-1f) * f + 1.4249322787E-1f) * f - 1.6668057665E-1f) * f +
+                 2.0000714765E-1f) * f - 2.4999993993E-1f) * f + 3.3333331174E-1f) * f * z;
+    y -= e * 2.12194440e-4f;
+    y -= 0.5f * z;
+    float r = f + y + e * 0.693359375f;
+
+    r = x == 0.0f ? -HUGE_VALF : r;
+    r = x == HUGE_VALF ? HUGE_VALF : r;
+    r = x < 0.0f ? NAN : r;
+    return x != x ? x : r;
+}
+
+#endif /* SIMD_MATH_H */
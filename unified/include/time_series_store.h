@@ -0,0 +1,113 @@
+#ifndef TIME_SERIES_STORE_H
+#define TIME_SERIES_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @file time_series_store.h
+ * @brief Memory-mapped columnar store for daily price bars
+ *
+ * One file holds the daily bars of one ticker, sorted by date, as fixed-width
+ * columns: dates, then open, high, low, close and volume. Readers map the
+ * file and use the columns in place, so nothing is parsed on a read. New bars
+ * later than the last stored date are appended in place; anything else is
+ * merged into a rewritten copy that replaces the file atomically, so a reader
+ * always sees a consistent set of bars. Files use the host byte order.
+ */
+
+/** Store format identification */
+#define TS_STORE_MAGIC "TSBARS\0\0"
+#define TS_STORE_VERSION 1
+
+/**
+ * @brief One daily bar
+ */
+typedef struct {
+    int32_t date;   /**< Trading day as YYYYMMDD */
+    double open;    /**< Opening price */
+    double high;    /**< High price */
+    double low;     /**< Low price */
+    double close;   /**< Closing price */
+    double volume;  /**< Traded volume */
+} TSBar;
+
+/**
+ * @brief Read-only view of a mapped store, oldest bar first
+ *
+ * The column pointers stay valid until ts_store_close(), even if the file is
+ * appended to or replaced meanwhile.
+ */
+typedef struct {
+    int count;              /**< Number of bars */
+    uint32_t generation;    /**< Changes whenever stored bars are replaced rather than appended */
+    const int32_t* date;    /**< Dates as YYYYMMDD, ascending */
+    const double* open;     /**< Opening prices */
+    const double* high;     /**< High prices */
+    const double* low;      /**< Low prices */
+    const double* close;    /**< Closing prices */
+    const double* volume;   /**< Volumes */
+    void* map;              /**< Mapping, owned by the view */
+    size_t map_size;        /**< Size of the mapping */
+} TimeSeriesView;
+
+/**
+ * @brief Map a store for reading
+ * @param path Store file
+ * @param view View to fill in
+ * @return 0 on success, -1 if the file is missing, unreadable or not a store
+ */
+int ts_store_open(const char* path, TimeSeriesView* view);
+
+/**
+ * @brief Unmap a store opened with ts_store_open()
+ */
+void ts_store_close(TimeSeriesView* view);
+
+/**
+ * @brief Add bars to a store, creating it if needed
+ *
+ * Bars may come in any order. A bar whose date is already stored replaces
+ * the stored one; bars already stored unchanged are skipped, so appending an
+ * overlapping download only writes the new days.
+ *
+ * @param path Store file
+ * @param bars Bars to add (sorted in place)
+ * @param count Number of bars
+ * @return 0 on success, -1 on failure (the store is left unchanged)
+ */
+int ts_store_append(const char* path, TSBar* bars, int count);
+
+/**
+ * @brief Sort bars by date and drop all but one bar of each date
+ * @return Number of bars left
+ */
+int ts_sort_bars(TSBar* bars, int count);
+
+/**
+ * @brief Parse a "YYYY-MM-DD" date into YYYYMMDD
+ * @return The date, or -1 if it is malformed
+ */
+int32_t ts_parse_date(const char* text);
+
+/**
+ * @brief Format a YYYYMMDD date as "YYYY-MM-DD"
+ * @param date Date to format
+ * @param buffer Buffer of at least 11 characters
+ */
+void ts_format_date(int32_t date, char* buffer);
+
+/**
+ * @brief Annualized close-to-close volatility over the most recent period
+ *
+ * Uses the sample standard deviation of the last period_days log returns
+ * (fewer if the series is shorter), annualized with 252 trading days.
+ *
+ * @param close Closing prices, oldest first
+ * @param count Number of prices
+ * @param period_days Number of returns to use
+ * @return Volatility, or -1.0 if fewer than two returns are available
+ */
+double ts_historical_volatility(const double* close, int count, int period_days);
+
+#endif /* TIME_SERIES_STORE_H */
@@ -0,0 +1,48 @@
+#ifndef VOL_SURFACE_H
+#define VOL_SURFACE_H
+
+/**
+ * @file vol_surface.h
+ * @brief Black-Scholes and Heston implied volatility surfaces in one call, part of libheston
+ *
+ * Points are grouped into chains sharing (S, r, q, T), so a surface of one
+ * underlying has one chain per expiry. Each chain is calibrated with
+ * heston_fft_context_implied_vol_chain(), so strikes that start from the same
+ * Heston parameter set share one FFT grid per set. Chains are spread over worker
+ * threads, each with its own pricing context. The Black-Scholes vols of all
+ * points are solved in one vectorized batch.
+ */
+
+/**
+ * @brief One quote of a surface
+ */
+typedef struct {
+    double S;       /**< Spot price */
+    double K;       /**< Strike price */
+    double T;       /**< Time to expiry in years */
+    double r;       /**< Risk-free rate */
+    double q;       /**< Dividend yield */
+    double price;   /**< Call price */
+    double bs_iv;   /**< Black-Scholes implied volatility, -1.0 if there is none */
+    double sv_iv;   /**< Heston (stochastic volatility) implied volatility, -1.0 if there is none */
+} VolSurfacePoint;
+
+/**
+ * @brief Fill in the implied volatilities of a surface
+ *
+ * With one thread the chains are calibrated in order through the default
+ * context (heston_fft_implied_vol_chain(), with its grid failure fallback and
+ * HestonFFTConfig.threads sweep workers). With more, each thread claims
+ * whole chains and the grid cache limit is split between the threads.
+ * Every chain starts from the FFT grid configured when the call is made, so
+ * the results do not depend on the thread count.
+ *
+ * @param points Array of n points; bs_iv and sv_iv are written
+ * @param n Number of points
+ * @param threads Threads to calibrate chains on (values below 1 mean 1)
+ *
+ * @return Number of points without a Heston implied volatility, or -1 on invalid arguments
+ */
+int heston_vol_surface(VolSurfacePoint* points, int n, int threads);
+
+#endif /* VOL_SURFACE_H */
@@ -5,7 +5,7 @@
 
 # Default values
 MODEL="bs"           # bs (Black-Scholes) or heston
-METHOD="analytic"    # analytic, quadrature, fft
+METHOD="analytic"    # analytic, quadrature, fft, cos, mc
 OPTION_TYPE="call"   # call or put
 TICKER="SPX"         # Default to S&P 500 index
 CALCULATE_GREEKS=0   # Don't calculate Greeks by default
@@ -45,7 +45,7 @@ Optional parameters:
 Options:
   -h, --help              Show this help message
   -m, --model MODEL       Pricing model to use: 'bs' (Black-Scholes) or 'heston' (default: bs)
-  -n, --method METHOD     Numerical method: 'analytic', 'quadrature', 'fft' (default: analytic)
+  -n, --method METHOD     Numerical method: 'analytic', 'quadrature', 'fft', 'cos', 'mc' (default: analytic)
   -t, --type TYPE         Option type: 'call' or 'put' (default: call)
   --ticker SYMBOL         Ticker symbol for market data (default: SPX)
   -g, --greeks            Calculate option Greeks
@@ -58,13 +58,19 @@ Options:
   --rate-term TERM        Term for risk-free rate: '1month', '3month', '6month', '1year', etc. (default: '3month')
   --fft-n N               Number of FFT points (for FFT method)
   --alpha VALUE           Alpha parameter (for FFT method)
+  --portfolio FILE        Revalue a positions file (ticker,type,strike,expiry,quantity) in one
+                          process: Heston FFT prices, Greeks and exposures per ticker as CSV.
+                          Takes --rate, --data-source and --threads N; no positional parameters
 
 Examples:
   $(basename $0) 4500 4600 30                        # Price SPX call option, 30 days to expiry
   $(basename $0) --ticker AAPL 180 175 45 2.50       # Calculate IV for AAPL call, market price $2.50
   $(basename $0) -m heston -n fft 100 110 60 1.5     # Price with Heston model using FFT
+  $(basename $0) -m heston -n cos 100 110 60 1.5     # Same with the (faster) COS engine
+  $(basename $0) -m heston -n mc 100 110 60 1.5      # Check with the Monte Carlo engine
   $(basename $0) -t put --greeks 50 55 10 0.75       # Price put option and calculate Greeks
   $(basename $0) --ticker MSFT --auto-vol 300 310 45 # Price MSFT using auto-fetched market data and volatility
+  $(basename $0) --portfolio positions.csv > eod.csv # End-of-day revaluation of a book
 EOF
     exit $E_SUCCESS
 }
@@ -99,8 +105,8 @@ validate_model() {
 
 # Function to validate numerical method
 validate_method() {
-    if [[ "$METHOD" != "analytic" && "$METHOD" != "quadrature" && "$METHOD" != "fft" ]]; then
-        echo "Error: Numerical method must be 'analytic', 'quadrature', or 'fft'." >&2
+    if [[ "$METHOD" != "analytic" && "$METHOD" != "quadrature" && "$METHOD" != "fft" && "$METHOD" != "cos" && "$METHOD" != "mc" ]]; then
+        echo "Error: Numerical method must be 'analytic', 'quadrature', 'fft', 'cos', or 'mc'." >&2
         exit $E_PARAM_ERR
     fi
     
@@ -411,6 +417,14 @@ while [[ $# -gt 0 ]]; do
             ALPHA="$2"
             shift 2
             ;;
+        --portfolio)
+            PORTFOLIO="$2"
+            shift 2
+            ;;
+        --threads)
+            THREADS="$2"
+            shift 2
+            ;;
         *)
             POSITIONAL+=("$1")
             shift
@@ -421,6 +435,36 @@ done
 # Restore positional parameters
 set -- "${POSITIONAL[@]}"
 
+# A whole book is priced by one unified_pricer process
+if [ -n "$PORTFOLIO" ]; then
+    UNIFIED_BIN="$BINARY_DIR/unified_pricer"
+    if [ ! -f "$UNIFIED_BIN" ]; then
+        echo "Error: Unified pricing binary not found at $UNIFIED_BIN" >&2
+        exit $E_FILE_NOT_FOUND
+    fi
+
+    ARGS=(--portfolio "$PORTFOLIO")
+    if [ -n "$THREADS" ]; then
+        ARGS+=(--threads "$THREADS")
+    fi
+    if [ -n "$RATE" ]; then
+        validate_numeric "$RATE" "Interest rate"
+        ARGS+=(--rate "$(echo "scale=6; $RATE / 100" | bc)")
+    fi
+    case "$DATA_SOURCE" in
+        alphavantage) ARGS+=(--data-source 1) ;;
+        finnhub) ARGS+=(--data-source 2) ;;
+        polygon) ARGS+=(--data-source 3) ;;
+    esac
+
+    "$UNIFIED_BIN" "${ARGS[@]}"
+    case $? in
+        0) exit $E_SUCCESS ;;
+        1) exit $E_DATA_ERR ;;   # Some positions could not be priced
+        *) exit $E_EXEC_ERR ;;
+    esac
+fi
+
 # Check for required arguments
 if [ $# -lt 3 ]; then
     echo "Error: Missing required parameters." >&2
@@ -565,6 +609,12 @@ case "$METHOD" in
     fft)
         METHOD_TYPE="2"
         ;;
+    cos)
+        METHOD_TYPE="3"
+        ;;
+    mc)
+        METHOD_TYPE="4"
+        ;;
 esac
 
 # Set option type numeric value for the binary
@@ -1,25 +1,17 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <unistd.h>
 #include <math.h>
 
 #include "../include/option_types.h"
 #include "../include/error_handling.h"
-#include "../include/path_resolution.h"
+#include "../include/black_scholes.h"
 
 /**
- * Maximum length for command strings
- */
-#define MAX_CMD_LENGTH 1024
-
-/**
- * Maximum length for output buffer
- */
-#define MAX_OUTPUT_LENGTH 4096
-
-/**
- * @brief Adapt the unified API to the legacy Black-Scholes implementation
+ * @brief Adapt the unified API to the in-process Black-Scholes implementation
+ * 
+ * The pricing code lives in libheston (see black_scholes.h), so no external
+ * binary is spawned per quote.
  * 
  * @param spot_price The current price of the underlying asset
  * @param strike_price The strike price of the option
@@ -44,114 +36,31 @@ int price_with_black_scholes(
     double market_price,
     PricingResult* result
 ) {
-    char cmd[MAX_CMD_LENGTH];
-    char output[MAX_OUTPUT_LENGTH];
-    char* binary_path;
-    FILE* pipe;
-    int ret = ERROR_NONE;
-    
-    /* Initialize result structure */
-    memset(result, 0, sizeof(PricingResult));
-    
-    /* Determine which binary to use */
-    if (market_price > 0) {
-        /* For implied volatility calculation, use the calculate_iv binary */
-        binary_path = resolve_legacy_binary_path("v2", "calculate_iv");
-    } else {
-        /* For option pricing, use the calculate_bs binary */
-        binary_path = resolve_legacy_binary_path(NULL, "calculate_bs");
-    }
-    
-    if (binary_path == NULL) {
-        /* Error already set by resolve_legacy_binary_path */
-        result->error_code = get_error();
-        return result->error_code;
-    }
-    
-    /* Construct the command based on the operation */
-    if (market_price > 0) {
-        /* Implied volatility calculation */
-        snprintf(cmd, sizeof(cmd), "%s %.6f %.6f %.6f %.6f %.6f %.6f",
-                 binary_path,
-                 market_price,
-                 spot_price,
-                 strike_price,
-                 time_to_expiry,
-                 risk_free_rate,
-                 dividend_yield);
-    } else {
-        /* Option pricing with known volatility */
-        snprintf(cmd, sizeof(cmd), "%s %.6f %.6f %.6f %.6f %.6f %.6f %d",
-                 binary_path,
-                 spot_price,
-                 strike_price,
-                 time_to_expiry,
-                 risk_free_rate,
-                 dividend_yield,
-                 volatility,
-                 option_type);
-    }
-    
-    /* Free the binary path as it's no longer needed */
-    free_resolved_path(binary_path);
-    
-    /* Execute the command and capture output */
-    pipe = popen(cmd, "r");
-    if (pipe == NULL) {
-        set_error(ERROR_COMMAND_EXECUTION);
-        result->error_code = ERROR_COMMAND_EXECUTION;
-        return result->error_code;
-    }
-    
-    /* Read command output */
-    if (fgets(output, sizeof(output), pipe) == NULL) {
-        pclose(pipe);
-        set_error(ERROR_COMMAND_OUTPUT_PARSING);
-        result->error_code = ERROR_COMMAND_OUTPUT_PARSING;
-        return result->error_code;
-    }
+    int ret;
     
-    /* Close the pipe */
-    if (pclose(pipe) != 0) {
-        set_error(ERROR_COMMAND_EXECUTION);
-        result->error_code = ERROR_COMMAND_EXECUTION;
-        return result->error_code;
-    }
+    ret = bs_price_option(
+        spot_price,
+        strike_price,
+        time_to_expiry,
+        risk_free_rate,
+        dividend_yield,
+        volatility,
+        option_type,
+        market_price,
+        result
+    );
     
-    /* Parse the output based on the operation */
-    if (market_price > 0) {
-        /* Parse implied volatility output */
-        if (sscanf(output, "%lf", &result->implied_volatility) != 1) {
-            set_error(ERROR_COMMAND_OUTPUT_PARSING);
-            result->error_code = ERROR_COMMAND_OUTPUT_PARSING;
-            return result->error_code;
-        }
-        
-        /* Calculate option price using the implied volatility */
-        /* For now, we'll just set it to the market price */
-        result->price = market_price;
-    } else {
-        /* Parse option price output */
-        if (sscanf(output, "%lf", &result->price) != 1) {
-            set_error(ERROR_COMMAND_OUTPUT_PARSING);
-            result->error_code = ERROR_COMMAND_OUTPUT_PARSING;
-            return result->error_code;
-        }
+    if (ret != ERROR_NONE) {
+        set_error(ret);
     }
     
-    /* Set the result error code to indicate success */
-    result->error_code = ERROR_NONE;
-    
-    return ERROR_NONE;
+    return ret;
 }
 
 /**
  * @brief Calculate Greeks for an option using the Black-Scholes model
  * 
- * Note: This is a simplified implementation that calculates Greeks
- * analytically using the Black-Scholes formula. In a real implementation,
- * you might want to call a more sophisticated implementation or add
- * numerical methods for better precision.
+ * The Greeks are the closed-form Black-Scholes sensitivities.
  * 
  * @param spot_price Spot price
  * @param strike_price Strike price
@@ -174,18 +83,37 @@ int calculate_black_scholes_greeks(
     OptionType option_type,
     PricingResult* result
 ) {
-    /* 
-     * Note: This is a placeholder for the actual implementation.
-     * In a real implementation, you would calculate the Greeks using
-     * the Black-Scholes formula or call the appropriate legacy binary.
-     */
+    if (result == NULL || spot_price <= 0 || strike_price <= 0 ||
+        time_to_expiry <= 0 || volatility <= 0) {
+        set_error(ERROR_GREEKS_CALCULATION);
+        return ERROR_GREEKS_CALCULATION;
+    }
     
-    /* For now, set dummy values for Greeks */
-    result->delta = 0.5;  /* Placeholder */
-    result->gamma = 0.1;  /* Placeholder */
-    result->theta = -0.1; /* Placeholder */
-    result->vega = 0.2;   /* Placeholder */
-    result->rho = 0.05;   /* Placeholder */
+    /* Analytic Black-Scholes Greeks with a continuous dividend yield;
+     * theta is per year of calendar time, vega and rho per unit change */
+    double sqrt_t = sqrt(time_to_expiry);
+    double d1 = (log(spot_price / strike_price) +
+                 (risk_free_rate - dividend_yield + 0.5 * volatility * volatility) * time_to_expiry) /
+                (volatility * sqrt_t);
+    double d2 = d1 - volatility * sqrt_t;
+    double disc_q = exp(-dividend_yield * time_to_expiry);
+    double disc_r = exp(-risk_free_rate * time_to_expiry);
+    double pdf_d1 = norm_pdf(d1);
+    double decay = -spot_price * disc_q * pdf_d1 * volatility / (2.0 * sqrt_t);
+    
+    if (option_type == OPTION_CALL) {
+        result->delta = disc_q * norm_cdf(d1);
+        result->theta = decay + dividend_yield * spot_price * disc_q * norm_cdf(d1)
+                      - risk_free_rate * strike_price * disc_r * norm_cdf(d2);
+        result->rho = strike_price * time_to_expiry * disc_r * norm_cdf(d2);
+    } else {
+        result->delta = -disc_q * norm_cdf(-d1);
+        result->theta = decay - dividend_yield * spot_price * disc_q * norm_cdf(-d1)
+                      + risk_free_rate * strike_price * disc_r * norm_cdf(-d2);
+        result->rho = -strike_price * time_to_expiry * disc_r * norm_cdf(-d2);
+    }
+    result->gamma = disc_q * pdf_d1 / (spot_price * volatility * sqrt_t);
+    result->vega = spot_price * disc_q * pdf_d1 * sqrt_t;
     
     result->error_code = ERROR_NONE;
     return ERROR_NONE;
@@ -0,0 +1,247 @@
+/**
+ * @file black_scholes_batch.c
+ * @brief Vectorized batch Black-Scholes implied volatility
+ *
+ * With forward F, discount D and x = ln(F / K), a call price C is
+ * D sqrt(F K) b(x, s) for the normalized price
+ *
+ *     b(x, s) = exp(x / 2) N(x / s + s / 2) - exp(-x / 2) N(x / s - s / 2)
+ *
+ * and s = sigma sqrt(T). Subtracting the intrinsic value turns any call or
+ * put into the out-of-the-money call at x <= 0, which is bounded by
+ * exp(x / 2) and has an inflection point at s_c = sqrt(-2 x) (Jaeckel,
+ * "By Implication", 2006). Below the inflection price the solver works on
+ * ln b, where b is close to linear in s, and above it on b itself. The
+ * initial guess is the better of the two asymptotic inversions from that
+ * paper, and three Householder steps of order 3 follow.
+ */
+
+#include <math.h>
+
+#include "../include/black_scholes_batch.h"
+#include "../include/error_handling.h"
+#include "../include/simd_math.h"
+
+#define IV_INV_SQRT_2PI 0.39894228040143267794
+#define IV_INV_SQRT_PI  0.56418958354775628695
+
+/* Relative size of the last of the three solver steps below which the
+ * option counts as solved. The steps converge with order 4, so a last step
+ * of 1e-6 leaves an error far below 1e-12. */
+#define IV_STEP_TOLERANCE 1e-6
+
+/* Smallest time value, relative to the price, that is still resolved after
+ * the intrinsic value is subtracted */
+#define IV_MIN_TIME_VALUE 1e-11
+
+/* Bounds on the total standard deviation s = sigma sqrt(T) */
+#define IV_S_MIN 1e-8
+#define IV_S_MAX 50.0
+
+/* Standard normal CDF, Cephes ndtr() with both branches evaluated */
+SIMD_INLINE double batch_norm_cdf(double a) {
+    double x = a * SIMD_SQRTH;
+    double z = fabs(x);
+
+    /* erf(x) for |x| < 1 */
+    double zz = x * x;
+    double tp = (((9.60497373987051638749E0 * zz + 9.00260197203842689217E1) * zz +
+                  2.23200534594684319226E3) * zz + 7.00332514112805075473E3) * zz +
+                5.55923013010394962768E4;
+    double up = ((((zz + 3.35617141647503099647E1) * zz + 5.21357949780152679795E2) * zz +
+                  4.59432382970980127987E3) * zz + 2.26290000613890934246E4) * zz +
+                4.92673942608635921086E4;
+    double center = 0.5 + 0.5 * (x * tp / up);
+
+    /* erfc(z) = exp(-z^2) P(z) / Q(z) for 1 <= z < 8, and the asymptotic
+     * series exp(-z^2) / (z sqrt(pi)) sum_k (-1)^k (2k - 1)!! / (2 z^2)^k
+     * beyond, where twelve terms are accurate to 2e-14 */
+    double p = (((((((2.46196981473530512524E-10 * z + 5.64189564831068821977E-1) * z +
+                     7.46321056442269912687E0) * z + 4.86371970985681366614E1) * z +
+                   1.96520832956077098242E2) * z + 5.26445194995477358631E2) * z +
+                 9.34528527171957607540E2) * z + 1.02755188689515710272E3) * z +
+               5.57535335369399327526E2;
+    double qd = (((((((z + 1.32281951154744992508E1) * z + 8.67072140885989742329E1) * z +
+                     3.54937778887819891062E2) * z + 9.75708501743205489753E2) * z +
+                   1.82390916687909736289E3) * z + 2.24633760818710981792E3) * z +
+                 1.65666309194161350182E3) * z + 5.57535340817727675546E2;
+    double w = 0.5 / (z * z);
+    double series = 1.0 + w * (-1.0 + w * (3.0 + w * (-15.0 + w * (105.0 + w * (-945.0 +
+                    w * (10395.0 + w * (-135135.0 + w * (2027025.0 + w * (-34459425.0 +
+                    w * (654729075.0 + w * -13749310575.0))))))))));
+    double near = p / qd;
+    double far = IV_INV_SQRT_PI * series / z;
+    double ratio = z < 8.0 ? near : far;
+    double half_erfc = 0.5 * simd_exp(-z * z) * ratio;
+    double upper = 1.0 - half_erfc;
+    double tail = x > 0.0 ? upper : half_erfc;
+
+    return z < 1.0 ? center : tail;
+}
+
+/* Lower half of the inverse normal CDF (p <= 0.5), Acklam's approximation;
+ * relative error 1.2e-9, plenty for a starting point */
+SIMD_INLINE double batch_norm_inv_lower(double p) {
+    double t = sqrt(-2.0 * simd_log(p));
+    double tail = (((((-7.784894002430293e-03 * t - 3.223964580411365e-01) * t -
+                      2.400758277161838e+00) * t - 2.549732539343734e+00) * t +
+                    4.374664141464968e+00) * t + 2.938163982698783e+00) /
+                  ((((7.784695709041462e-03 * t + 3.224671290700398e-01) * t +
+                     2.445134137142996e+00) * t + 3.754408661907416e+00) * t + 1.0);
+
+    double c = p - 0.5;
+    double r = c * c;
+    double center = (((((-3.969683028665376e+01 * r + 2.209460984245205e+02) * r -
+                        2.759285104469687e+02) * r + 1.383577518672690e+02) * r -
+                      3.066479806614716e+01) * r + 2.506628277459239e+00) * c /
+                    (((((-5.447609879822406e+01 * r + 1.615858368580409e+02) * r -
+                        1.556989798598866e+02) * r + 6.680131188771972e+01) * r -
+                      1.328068155288572e+01) * r + 1.0);
+
+    return p < 0.02425 ? tail : center;
+}
+
+/* Normalized out-of-the-money call price b(x, s) for x <= 0; eh = exp(x / 2) */
+SIMD_INLINE double normalized_otm_call(double x, double s, double eh) {
+    double d1 = x / s + 0.5 * s;
+    return eh * batch_norm_cdf(d1) - batch_norm_cdf(d1 - s) / eh;
+}
+
+/* One Householder step of order 3 from s; the step taken goes to *step */
+SIMD_INLINE double householder_step(double s, double xo, double eh, double bs, double log_bs,
+                                    bool lower, double* step) {
+    double d1 = xo / s + 0.5 * s;
+    double bv = eh * batch_norm_cdf(d1) - batch_norm_cdf(d1 - s) / eh;
+
+    /* Derivatives of b in s: b' = exp(x/2) phi(d1), then b'' and b''' as
+     * multiples of b' */
+    double b1 = IV_INV_SQRT_2PI * simd_exp(0.5 * xo - 0.5 * d1 * d1);
+    double inv_s = 1.0 / s;
+    double x2 = xo * xo;
+    double h = x2 * inv_s * inv_s * inv_s - 0.25 * s;
+    double b2 = b1 * h;
+    double b3 = b1 * (h * h - 3.0 * x2 * inv_s * inv_s * inv_s * inv_s - 0.25);
+
+    /* Objective ln b - ln b* in the lower region, b - b* above */
+    double bv_safe = bv > DBL_MIN ? bv : DBL_MIN;
+    double g1 = b1 / bv_safe;
+    double g2 = b2 / bv_safe;
+    double log_f = simd_log(bv_safe) - log_bs;
+    double log_f2 = g2 - g1 * g1;
+    double log_f3 = b3 / bv_safe - 3.0 * g2 * g1 + 2.0 * g1 * g1 * g1;
+    double f = lower ? log_f : bv - bs;
+    double f1 = lower ? g1 : b1;
+    double f2 = lower ? log_f2 : b2;
+    double f3 = lower ? log_f3 : b3;
+
+    double nu = -f / f1;
+    double h2 = f2 / f1;
+    double h3 = f3 / f1;
+    *step = nu * (1.0 + 0.5 * h2 * nu) / (1.0 + nu * (h2 + h3 * nu * (1.0 / 6.0)));
+
+    double next = s + *step;
+    next = next > IV_S_MIN ? next : 0.5 * s;
+    return next < IV_S_MAX ? next : IV_S_MAX;
+}
+
+SIMD_CLONES
+int bs_implied_vol_batch(int n, const IVBatchInput* in, double* ivs, IVStatus* status) {
+    if (n < 0 || in == NULL || ivs == NULL || in->price == NULL || in->S == NULL ||
+        in->K == NULL || in->T == NULL || in->r == NULL || in->q == NULL) {
+        return ERROR_INVALID_PARAMETER;
+    }
+
+    const double* price = in->price;
+    const double* S = in->S;
+    const double* K = in->K;
+    const double* T = in->T;
+    const double* r = in->r;
+    const double* q = in->q;
+    const OptionType* type = in->type;
+    int failed = 0;
+
+    for (int i = 0; i < n; i++) {
+        const double Ti = T[i];
+        bool valid = (S[i] > 0.0) & (K[i] > 0.0) & (Ti > 0.0) & (price[i] >= 0.0) &
+                     (S[i] <= DBL_MAX) & (K[i] <= DBL_MAX) & (Ti <= DBL_MAX) &
+                     (price[i] <= DBL_MAX) & (fabs(r[i]) <= DBL_MAX) & (fabs(q[i]) <= DBL_MAX);
+
+        /* Normalize: x = ln(F / K), beta = price / (D sqrt(F K)) */
+        double x = simd_log(S[i] / K[i]) + (r[i] - q[i]) * Ti;
+        double scale = simd_exp(-r[i] * Ti + 0.5 * x) * K[i];   /* D sqrt(F K) */
+        double beta = price[i] / scale;
+        double ex = simd_exp(0.5 * x);
+        double intrinsic_call = ex - 1.0 / ex;
+        double theta = (type != NULL && type[i] == OPTION_PUT) ? -1.0 : 1.0;
+        double intrinsic = theta * intrinsic_call > 0.0 ? theta * intrinsic_call : 0.0;
+
+        /* Out-of-the-money call at xo = -|x|, bounded by eh = exp(xo / 2) */
+        double b = beta - intrinsic;
+        double xo = -fabs(x);
+        double eh = simd_exp(0.5 * xo);
+        bool below = b <= 0.0;
+        bool above = b >= eh;
+        double bs = b > DBL_MIN ? b : DBL_MIN;
+        double log_bs = simd_log(bs);
+
+        /* Inflection point, guarded for x = 0 where it is s = 0 */
+        double sc = sqrt(-2.0 * xo);
+        double sc_safe = sc > IV_S_MIN ? sc : IV_S_MIN;
+        double bc = normalized_otm_call(xo, sc_safe, eh);
+        bool lower = bs < bc;
+
+        /* Lower guess inverts the small-price asymptote, the upper one the
+         * large-volatility limit (exact at the money) */
+        double guess_lo = sqrt(2.0 * xo * xo / (-xo - 4.0 * (log_bs - simd_log(bc))));
+        guess_lo = lower ? guess_lo : sc_safe;
+        double p_up = (eh - bs) / (eh + 1.0 / eh);
+        p_up = p_up > DBL_MIN ? p_up : DBL_MIN;
+        double guess_up = -2.0 * batch_norm_inv_lower(p_up);
+
+        double err_lo = fabs(simd_log(normalized_otm_call(xo, guess_lo, eh)) - log_bs);
+        double err_up = fabs(simd_log(normalized_otm_call(xo, guess_up, eh)) - log_bs);
+        double s = err_lo < err_up ? guess_lo : guess_up;
+        s = s > IV_S_MIN ? s : IV_S_MIN;
+        s = s < IV_S_MAX ? s : IV_S_MAX;
+
+        /* Three steps, written out so the option loop stays innermost */
+        double step;
+        s = householder_step(s, xo, eh, bs, log_bs, lower, &step);
+        s = householder_step(s, xo, eh, bs, log_bs, lower, &step);
+        s = householder_step(s, xo, eh, bs, log_bs, lower, &step);
+
+        bool converged = (fabs(step) <= IV_STEP_TOLERANCE * s) & (s > IV_S_MIN) & (s < IV_S_MAX) &
+                         (b >= IV_MIN_TIME_VALUE * beta);
+
+        IVStatus st = IV_OK;
+        st = converged ? st : IV_NOT_CONVERGED;
+        st = above ? IV_ABOVE_MAXIMUM : st;
+        st = below ? IV_BELOW_INTRINSIC : st;
+        st = valid ? st : IV_INVALID_INPUT;
+
+        double sigma = s / sqrt(valid ? Ti : 1.0);
+        ivs[i] = st == IV_OK ? sigma : -1.0;
+        if (status != NULL) {
+            status[i] = st;
+        }
+        failed += st == IV_OK ? 0 : 1;
+    }
+
+    return failed;
+}
+
+const char* bs_iv_status_string(IVStatus status) {
+    switch (status) {
+        case IV_OK:
+            return "ok";
+        case IV_INVALID_INPUT:
+            return "invalid input";
+        case IV_BELOW_INTRINSIC:
+            return "price at or below intrinsic value";
+        case IV_ABOVE_MAXIMUM:
+            return "price at or above the no-arbitrage maximum";
+        case IV_NOT_CONVERGED:
+            return "not converged";
+    }
+    return "unknown";
+}
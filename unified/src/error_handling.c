@@ -1,19 +1,59 @@
 /**
  * @file error_handling.c
  * @brief Implementation of error handling functions for the unified option pricing system
+ *
+ * Every thread keeps its last error in a fixed context of its own, so
+ * pricing threads never share or allocate error state. Logged errors go to a
+ * bounded ring of preformatted records: a thread claims a slot with one
+ * atomic compare-and-swap and never waits for another. Records are written
+ * out in order by whichever thread gets the drain flag, when the ring is
+ * half full, for system errors, on flush_error_log() and at exit.
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include "../include/error_handling.h"
 #include <stdlib.h>
 #include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <sched.h>
 #include <pthread.h>
 
-/* Thread-local storage for error tracking */
-static __thread int last_error_code = ERROR_SUCCESS;
-static __thread char last_error_message[512] = {0};
-static pthread_mutex_t error_log_mutex = PTHREAD_MUTEX_INITIALIZER;
+/* Last error of one thread */
+typedef struct {
+    int code;
+    char message[512];
+} ErrorContext;
+
+static __thread ErrorContext error_context = { ERROR_SUCCESS, { 0 } };
+
+/* Records the log ring holds (power of 2) and characters per record */
+#define ERROR_LOG_RECORDS 256
+#define ERROR_LOG_LINE 640
+
+/*
+ * One logged error. seq tells the slot's state for the ring position pos
+ * that maps to it, with base = pos rounded down to a multiple of the ring
+ * size: base means free for pos, base + 1 written and waiting for the
+ * drain. Draining hands the slot to the next lap as base + ERROR_LOG_RECORDS,
+ * so the zero-initialized ring starts out free.
+ */
+typedef struct {
+    unsigned long seq;
+    struct timespec when;
+    bool to_stderr;
+    char line[ERROR_LOG_LINE];
+} ErrorLogRecord;
 
-/* Global error log file - can be set via configuration */
+static ErrorLogRecord error_log_ring[ERROR_LOG_RECORDS];
+static unsigned long error_log_head = 0;     /* Next position to claim (atomic) */
+static unsigned long error_log_tail = 0;     /* Next position to write out, owned by the drain */
+static int error_log_draining = 0;           /* Nonzero while a thread drains (atomic) */
+static unsigned long error_log_dropped = 0;  /* Records lost to a full ring (atomic) */
+static pthread_once_t error_log_once = PTHREAD_ONCE_INIT;
+
+/* Error log file - can be set via configuration (atomic) */
 static FILE* error_log_file = NULL;
 
 /**
@@ -132,13 +172,13 @@ const char* get_error_description(int error_code) {
  * @param message Additional error message or context (can be NULL)
  */
 void set_last_error(int error_code, const char* message) {
-    last_error_code = error_code;
+    error_context.code = error_code;
     
     if (message != NULL) {
-        strncpy(last_error_message, message, sizeof(last_error_message) - 1);
-        last_error_message[sizeof(last_error_message) - 1] = '\0';
+        strncpy(error_context.message, message, sizeof(error_context.message) - 1);
+        error_context.message[sizeof(error_context.message) - 1] = '\0';
     } else {
-        last_error_message[0] = '\0';
+        error_context.message[0] = '\0';
     }
 }
 
@@ -148,7 +188,7 @@ void set_last_error(int error_code, const char* message) {
  * @return int The last error code that was set
  */
 int get_last_error_code(void) {
-    return last_error_code;
+    return error_context.code;
 }
 
 /**
@@ -157,28 +197,179 @@ int get_last_error_code(void) {
  * @return const char* The last error message that was set
  */
 const char* get_last_error_message(void) {
-    return last_error_message;
+    return error_context.message;
 }
 
 /**
  * @brief Clear the last error code and message
  */
 void clear_last_error(void) {
-    last_error_code = ERROR_SUCCESS;
-    last_error_message[0] = '\0';
+    error_context.code = ERROR_SUCCESS;
+    error_context.message[0] = '\0';
+}
+
+/**
+ * @brief Set the error code for the current thread
+ * 
+ * @param error_code The error code to set
+ */
+void set_error(int error_code) {
+    set_last_error(error_code, NULL);
+}
+
+/**
+ * @brief Get the error code of the current thread
+ * 
+ * @return int The code last set by set_error() or set_last_error()
+ */
+int get_error(void) {
+    return error_context.code;
+}
+
+/**
+ * @brief Reset the current error state
+ */
+void reset_error(void) {
+    clear_last_error();
+}
+
+/**
+ * @brief Get the error message for an error code
+ * 
+ * Covers the status codes of the pricing modules as well as ErrorCode.
+ * 
+ * @param error_code The error code
+ * @return const char* A human-readable error message
+ */
+const char* get_error_message(int error_code) {
+    switch (error_code) {
+        case ERROR_INVALID_NUMERICAL_METHOD:
+            return "Invalid numerical method";
+        case ERROR_COMMAND_EXECUTION:
+            return "Error executing external command";
+        case ERROR_COMMAND_OUTPUT_PARSING:
+            return "Error parsing command output";
+        case ERROR_PATH_RESOLUTION:
+            return "Path resolution failed";
+        case ERROR_CALCULATION_FAILED:
+            return "Option pricing calculation failed";
+        case ERROR_VOLATILITY_CALCULATION:
+            return "Implied volatility calculation failed";
+        case ERROR_GREEKS_CALCULATION:
+            return "Greeks calculation failed";
+        case ERROR_NETWORK_FAILURE:
+            return "Network or API request failed";
+        case ERROR_DATA_SOURCE_UNAVAILABLE:
+            return "Market data source unavailable";
+        case ERROR_DATA_VALIDATION:
+            return "Market data validation failed";
+        case ERROR_CONFIG_PARSING:
+            return "Error parsing configuration file";
+        default:
+            return get_error_description(error_code);
+    }
+}
+
+/**
+ * @brief Check if an error code represents a fatal error
+ * 
+ * System errors (100-199) and failed allocations are fatal.
+ * 
+ * @param error_code The error code to check
+ * @return int 1 if fatal, 0 if non-fatal
+ */
+int is_fatal_error(int error_code) {
+    return (error_code == ERROR_MEMORY_ALLOCATION ||
+            (error_code >= 100 && error_code < 200)) ? 1 : 0;
+}
+
+/* Write out the records ready at the tail, in order. Only the thread that
+ * sets the drain flag writes; the others leave their records to it. */
+static void drain_error_log(void) {
+    do {
+        if (__atomic_exchange_n(&error_log_draining, 1, __ATOMIC_SEQ_CST) != 0) {
+            return;
+        }
+        
+        FILE* file = __atomic_load_n(&error_log_file, __ATOMIC_ACQUIRE);
+        unsigned long pos = __atomic_load_n(&error_log_tail, __ATOMIC_RELAXED);
+        bool wrote = false;
+        
+        for (;;) {
+            ErrorLogRecord* record = &error_log_ring[pos % ERROR_LOG_RECORDS];
+            unsigned long base = pos - pos % ERROR_LOG_RECORDS;
+            if (__atomic_load_n(&record->seq, __ATOMIC_ACQUIRE) != base + 1) {
+                break;
+            }
+            
+            char timestamp[32];
+            struct tm tm_info;
+            localtime_r(&record->when.tv_sec, &tm_info);
+            strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", &tm_info);
+            
+            if (file != NULL) {
+                fprintf(file, "[%s] %s\n", timestamp, record->line);
+                wrote = true;
+            }
+            if (record->to_stderr) {
+                fprintf(stderr, "[%s] %s\n", timestamp, record->line);
+            }
+            
+            __atomic_store_n(&record->seq, base + ERROR_LOG_RECORDS, __ATOMIC_RELEASE);
+            pos++;
+            __atomic_store_n(&error_log_tail, pos, __ATOMIC_RELEASE);
+        }
+        
+        unsigned long dropped = __atomic_exchange_n(&error_log_dropped, 0, __ATOMIC_RELAXED);
+        if (dropped > 0 && file != NULL) {
+            fprintf(file, "# %lu error records dropped, log buffer full\n", dropped);
+            wrote = true;
+        }
+        if (wrote) {
+            fflush(file);
+        }
+        
+        __atomic_store_n(&error_log_draining, 0, __ATOMIC_SEQ_CST);
+        
+        /* A record published while the flag was held is drained here */
+        pos = __atomic_load_n(&error_log_tail, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&error_log_ring[pos % ERROR_LOG_RECORDS].seq, __ATOMIC_SEQ_CST) !=
+            pos - pos % ERROR_LOG_RECORDS + 1) {
+            return;
+        }
+    } while (true);
+}
+
+/**
+ * @brief Write out every buffered error record
+ * 
+ * Waits for records other threads are still writing or draining.
+ */
+void flush_error_log(void) {
+    while (__atomic_load_n(&error_log_tail, __ATOMIC_ACQUIRE) !=
+           __atomic_load_n(&error_log_head, __ATOMIC_ACQUIRE)) {
+        drain_error_log();
+        sched_yield();
+    }
+}
+
+static void register_flush_at_exit(void) {
+    atexit(flush_error_log);
 }
 
 /**
  * @brief Set the error log file
  * 
+ * Records buffered so far are written to the previous file first.
+ * 
  * @param log_file Pointer to an open file for error logging (NULL to disable)
  * @return int ERROR_SUCCESS on success, otherwise an error code
  */
 int set_error_log_file(FILE* log_file) {
+    flush_error_log();
+    
     if (log_file == NULL) {
-        pthread_mutex_lock(&error_log_mutex);
-        error_log_file = NULL;
-        pthread_mutex_unlock(&error_log_mutex);
+        __atomic_store_n(&error_log_file, NULL, __ATOMIC_RELEASE);
         return ERROR_SUCCESS;
     }
     
@@ -187,9 +378,8 @@ int set_error_log_file(FILE* log_file) {
         return ERROR_PERMISSION_DENIED;
     }
     
-    pthread_mutex_lock(&error_log_mutex);
-    error_log_file = log_file;
-    pthread_mutex_unlock(&error_log_mutex);
+    pthread_once(&error_log_once, register_flush_at_exit);
+    __atomic_store_n(&error_log_file, log_file, __ATOMIC_RELEASE);
     
     return ERROR_SUCCESS;
 }
@@ -197,47 +387,71 @@ int set_error_log_file(FILE* log_file) {
 /**
  * @brief Log an error message with context
  * 
+ * The record is buffered; system errors (100-199) are written out at once
+ * and to stderr as well. Never blocks: with the buffer full the record is
+ * counted as dropped.
+ * 
  * @param error_code The error code associated with the error
  * @param function The function name where the error occurred
  * @param message Additional error message or context (can be NULL)
  */
 void log_error(int error_code, const char* function, const char* message) {
-    char timestamp[32];
-    time_t now = time(NULL);
-    struct tm* tm_info = localtime(&now);
-    
-    strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", tm_info);
+    const bool critical = error_code >= 100 && error_code < 200;
     
-    pthread_mutex_lock(&error_log_mutex);
+    /* Also set as the last error */
+    set_last_error(error_code, message);
     
-    if (error_log_file != NULL) {
-        if (message != NULL) {
-            fprintf(error_log_file, "[%s] ERROR %d: %s in %s - %s\n", 
-                    timestamp, error_code, get_error_description(error_code), 
-                    function, message);
-        } else {
-            fprintf(error_log_file, "[%s] ERROR %d: %s in %s\n", 
-                    timestamp, error_code, get_error_description(error_code), 
-                    function);
-        }
-        fflush(error_log_file);
+    if (!critical && __atomic_load_n(&error_log_file, __ATOMIC_ACQUIRE) == NULL) {
+        return;
+    }
+    if (critical) {
+        pthread_once(&error_log_once, register_flush_at_exit);
     }
     
-    /* Always record errors in stderr for critical errors */
-    if (error_code >= 100 && error_code < 200) {
-        if (message != NULL) {
-            fprintf(stderr, "[%s] ERROR %d: %s in %s - %s\n", 
-                    timestamp, error_code, get_error_description(error_code), 
-                    function, message);
+    /* Claim the slot of the next position */
+    unsigned long pos = __atomic_load_n(&error_log_head, __ATOMIC_RELAXED);
+    ErrorLogRecord* record;
+    unsigned long base;
+    for (;;) {
+        record = &error_log_ring[pos % ERROR_LOG_RECORDS];
+        base = pos - pos % ERROR_LOG_RECORDS;
+        long state = (long)(__atomic_load_n(&record->seq, __ATOMIC_ACQUIRE) - base);
+        
+        if (state == 0) {
+            if (__atomic_compare_exchange_n(&error_log_head, &pos, pos + 1, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (state < 0) {
+            /* The slot still holds a record of the previous lap; a system
+             * error still reaches stderr, without a timestamp */
+            __atomic_fetch_add(&error_log_dropped, 1, __ATOMIC_RELAXED);
+            if (critical) {
+                fprintf(stderr, "ERROR %d: %s in %s - %s\n", error_code,
+                        get_error_description(error_code), (function != NULL) ? function : "unknown",
+                        (message != NULL) ? message : "(error log buffer full)");
+            }
+            return;
         } else {
-            fprintf(stderr, "[%s] ERROR %d: %s in %s\n", 
-                    timestamp, error_code, get_error_description(error_code), 
-                    function);
+            pos = __atomic_load_n(&error_log_head, __ATOMIC_RELAXED);
         }
     }
     
-    pthread_mutex_unlock(&error_log_mutex);
+    clock_gettime(CLOCK_REALTIME, &record->when);
+    record->to_stderr = critical;
+    if (function == NULL) {
+        function = "unknown";
+    }
+    if (message != NULL) {
+        snprintf(record->line, sizeof(record->line), "ERROR %d: %s in %s - %s",
+                 error_code, get_error_description(error_code), function, message);
+    } else {
+        snprintf(record->line, sizeof(record->line), "ERROR %d: %s in %s",
+                 error_code, get_error_description(error_code), function);
+    }
+    __atomic_store_n(&record->seq, base + 1, __ATOMIC_SEQ_CST);
     
-    /* Also set as the last error */
-    set_last_error(error_code, message);
-} 
\ No newline at end of file
+    if (critical || pos + 1 - __atomic_load_n(&error_log_tail, __ATOMIC_ACQUIRE) >= ERROR_LOG_RECORDS / 2) {
+        drain_error_log();
+    }
+}
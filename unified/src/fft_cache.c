@@ -0,0 +1,541 @@
+/**
+ * @file fft_cache.c
+ * @brief Bounded LRU cache of Carr-Madan FFT price grids
+ *
+ * Grids live in a chained hash table for lookup and in a doubly linked list
+ * ordered from most to least recently used for eviction. Evicted grids are
+ * kept on a short spare list and handed out again by the next insert of the
+ * same size, so a full cache in a calibration loop stops allocating.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "../include/fft_cache.h"
+
+/* Initial number of hash buckets (power of 2) */
+#define FFT_CACHE_INITIAL_BUCKETS 64
+
+/* Evicted grids kept for reuse */
+#define FFT_CACHE_MAX_SPARES 4
+
+struct FFTGridCache {
+    FFTGrid** buckets;        /* Hash chains */
+    size_t num_buckets;       /* Always a power of 2 */
+    FFTGrid* lru_head;        /* Most recently used */
+    FFTGrid* lru_tail;        /* Least recently used */
+    FFTGrid* spares;          /* Evicted grids to reuse, linked through hash_next */
+    int num_spares;
+    double tolerance;         /* Per-component key tolerance */
+    FFTCacheStats stats;
+};
+
+/* Memory charged for one grid */
+static size_t grid_bytes(const FFTGrid* grid) {
+    bool sensitivities = grid->sensitivities != NULL || grid->spare_sensitivities != NULL;
+    size_t arrays = sensitivities ? 3 + 2 * FFT_GRID_SENSITIVITIES : 3;
+    return sizeof(FFTGrid) + arrays * (size_t)grid->num_strikes * sizeof(double);
+}
+
+/* Mix one 64-bit value into the hash (FNV-1a over the bytes) */
+static unsigned long hash_mix(unsigned long h, long long v) {
+    unsigned long long u = (unsigned long long)v;
+    for (int i = 0; i < 8; i++) {
+        h ^= (unsigned long)(u & 0xff);
+        h *= 1099511628211UL;
+        u >>= 8;
+    }
+    return h;
+}
+
+/* Quantize a key component to the tolerance grid */
+static long long quantize(double x, double tolerance) {
+    return llround(x / tolerance);
+}
+
+/**
+ * @brief Hash of the quantized key
+ *
+ * Two keys within the tolerance normally share a quantum; near a quantum
+ * boundary they may not, which only costs a miss.
+ */
+unsigned long fft_grid_key_hash(const FFTGridKey* key, double tolerance) {
+    unsigned long h = 14695981039346656037UL;
+    h = hash_mix(h, quantize(key->S, tolerance));
+    h = hash_mix(h, quantize(key->r, tolerance));
+    h = hash_mix(h, quantize(key->q, tolerance));
+    h = hash_mix(h, quantize(key->T, tolerance));
+    h = hash_mix(h, quantize(key->v0, tolerance));
+    h = hash_mix(h, quantize(key->kappa, tolerance));
+    h = hash_mix(h, quantize(key->theta, tolerance));
+    h = hash_mix(h, quantize(key->sigma, tolerance));
+    h = hash_mix(h, quantize(key->rho, tolerance));
+    h = hash_mix(h, key->fft_n);
+    h = hash_mix(h, quantize(key->log_strike_range, tolerance));
+    h = hash_mix(h, quantize(key->alpha, tolerance));
+    h = hash_mix(h, quantize(key->eta, tolerance));
+    return h;
+}
+
+/**
+ * @brief Keys match when every component agrees within the tolerance
+ */
+bool fft_grid_keys_match(const FFTGridKey* a, const FFTGridKey* b, double tolerance) {
+    return a->fft_n == b->fft_n &&
+           fabs(a->S - b->S) < tolerance &&
+           fabs(a->r - b->r) < tolerance &&
+           fabs(a->q - b->q) < tolerance &&
+           fabs(a->T - b->T) < tolerance &&
+           fabs(a->v0 - b->v0) < tolerance &&
+           fabs(a->kappa - b->kappa) < tolerance &&
+           fabs(a->theta - b->theta) < tolerance &&
+           fabs(a->sigma - b->sigma) < tolerance &&
+           fabs(a->rho - b->rho) < tolerance &&
+           fabs(a->log_strike_range - b->log_strike_range) < tolerance &&
+           fabs(a->alpha - b->alpha) < tolerance &&
+           fabs(a->eta - b->eta) < tolerance;
+}
+
+static void lru_unlink(FFTGridCache* cache, FFTGrid* grid) {
+    if (grid->lru_prev) grid->lru_prev->lru_next = grid->lru_next;
+    else cache->lru_head = grid->lru_next;
+
+    if (grid->lru_next) grid->lru_next->lru_prev = grid->lru_prev;
+    else cache->lru_tail = grid->lru_prev;
+
+    grid->lru_prev = NULL;
+    grid->lru_next = NULL;
+}
+
+static void lru_push_front(FFTGridCache* cache, FFTGrid* grid) {
+    grid->lru_prev = NULL;
+    grid->lru_next = cache->lru_head;
+    if (cache->lru_head) cache->lru_head->lru_prev = grid;
+    cache->lru_head = grid;
+    if (cache->lru_tail == NULL) cache->lru_tail = grid;
+}
+
+static void hash_unlink(FFTGridCache* cache, FFTGrid* grid) {
+    FFTGrid** link = &cache->buckets[grid->hash & (cache->num_buckets - 1)];
+    while (*link != NULL) {
+        if (*link == grid) {
+            *link = grid->hash_next;
+            break;
+        }
+        link = &(*link)->hash_next;
+    }
+    grid->hash_next = NULL;
+}
+
+/* Free a grid and its arrays */
+static void free_grid(FFTGrid* grid) {
+    free(grid->prices);
+    free(grid->sensitivities);
+    free(grid->spare_sensitivities);
+    free(grid);
+}
+
+/* Unlink one grid, then keep it as a spare or free it */
+static void drop_grid(FFTGridCache* cache, FFTGrid* grid, bool recycle) {
+    hash_unlink(cache, grid);
+    lru_unlink(cache, grid);
+
+    cache->stats.entries--;
+    cache->stats.bytes -= grid_bytes(grid);
+
+    if (!recycle || cache->num_spares >= FFT_CACHE_MAX_SPARES) {
+        free_grid(grid);
+        return;
+    }
+
+    /* Sensitivity rows are kept aside; a reused grid starts without them */
+    if (grid->sensitivities != NULL) {
+        free(grid->spare_sensitivities);
+        grid->spare_sensitivities = grid->sensitivities;
+        grid->sensitivities = NULL;
+        grid->sensitivity_slopes = NULL;
+    }
+    grid->hash_next = cache->spares;
+    cache->spares = grid;
+    cache->num_spares++;
+}
+
+/* Take a spare grid of this size off the spare list */
+static FFTGrid* take_spare(FFTGridCache* cache, int num_strikes) {
+    for (FFTGrid** link = &cache->spares; *link != NULL; link = &(*link)->hash_next) {
+        FFTGrid* grid = *link;
+        if (grid->num_strikes == num_strikes) {
+            *link = grid->hash_next;
+            cache->num_spares--;
+            return grid;
+        }
+    }
+    return NULL;
+}
+
+/* Evict least recently used grids until under the limit, sparing 'keep' */
+static void enforce_limit(FFTGridCache* cache, const FFTGrid* keep) {
+    while (cache->stats.bytes > cache->stats.max_bytes && cache->lru_tail != NULL &&
+           cache->lru_tail != keep) {
+        drop_grid(cache, cache->lru_tail, true);
+        cache->stats.evictions++;
+    }
+}
+
+/* Double the bucket array once chains get long; failure just keeps the old table */
+static void maybe_grow(FFTGridCache* cache) {
+    if (cache->stats.entries <= 2 * cache->num_buckets) {
+        return;
+    }
+
+    size_t new_count = 2 * cache->num_buckets;
+    FFTGrid** new_buckets = (FFTGrid**)calloc(new_count, sizeof(FFTGrid*));
+    if (new_buckets == NULL) {
+        return;
+    }
+
+    for (size_t i = 0; i < cache->num_buckets; i++) {
+        FFTGrid* grid = cache->buckets[i];
+        while (grid != NULL) {
+            FFTGrid* next = grid->hash_next;
+            size_t b = grid->hash & (new_count - 1);
+            grid->hash_next = new_buckets[b];
+            new_buckets[b] = grid;
+            grid = next;
+        }
+    }
+
+    free(cache->buckets);
+    cache->buckets = new_buckets;
+    cache->num_buckets = new_count;
+}
+
+/**
+ * @brief Create an empty cache
+ */
+FFTGridCache* fft_cache_create(size_t max_bytes, double tolerance) {
+    if (tolerance <= 0.0) {
+        return NULL;
+    }
+
+    FFTGridCache* cache = (FFTGridCache*)calloc(1, sizeof(FFTGridCache));
+    if (cache == NULL) {
+        return NULL;
+    }
+
+    cache->buckets = (FFTGrid**)calloc(FFT_CACHE_INITIAL_BUCKETS, sizeof(FFTGrid*));
+    if (cache->buckets == NULL) {
+        free(cache);
+        return NULL;
+    }
+
+    cache->num_buckets = FFT_CACHE_INITIAL_BUCKETS;
+    cache->tolerance = tolerance;
+    cache->stats.max_bytes = (max_bytes > 0) ? max_bytes : FFT_CACHE_DEFAULT_MAX_BYTES;
+
+    return cache;
+}
+
+/**
+ * @brief Free a cache and all of its grids
+ */
+void fft_cache_destroy(FFTGridCache* cache) {
+    if (cache == NULL) {
+        return;
+    }
+
+    fft_cache_clear(cache);
+    free(cache->buckets);
+    free(cache);
+}
+
+/**
+ * @brief Drop every grid, keeping the counters
+ */
+void fft_cache_clear(FFTGridCache* cache) {
+    if (cache == NULL) {
+        return;
+    }
+
+    while (cache->lru_head != NULL) {
+        drop_grid(cache, cache->lru_head, false);
+    }
+    while (cache->spares != NULL) {
+        FFTGrid* grid = cache->spares;
+        cache->spares = grid->hash_next;
+        free_grid(grid);
+    }
+    cache->num_spares = 0;
+}
+
+/**
+ * @brief Find a grid matching the key and mark it most recently used
+ */
+FFTGrid* fft_cache_lookup(FFTGridCache* cache, const FFTGridKey* key) {
+    if (cache == NULL || key == NULL) {
+        return NULL;
+    }
+
+    unsigned long h = fft_grid_key_hash(key, cache->tolerance);
+    FFTGrid* grid = cache->buckets[h & (cache->num_buckets - 1)];
+
+    while (grid != NULL) {
+        if (grid->hash == h && fft_grid_keys_match(&grid->key, key, cache->tolerance)) {
+            lru_unlink(cache, grid);
+            lru_push_front(cache, grid);
+            cache->stats.hits++;
+            return grid;
+        }
+        grid = grid->hash_next;
+    }
+
+    cache->stats.misses++;
+    return NULL;
+}
+
+/**
+ * @brief Check for a grid matching the key, leaving the LRU order and the counters alone
+ */
+bool fft_cache_contains(const FFTGridCache* cache, const FFTGridKey* key) {
+    if (cache == NULL || key == NULL) {
+        return false;
+    }
+
+    unsigned long h = fft_grid_key_hash(key, cache->tolerance);
+    for (const FFTGrid* grid = cache->buckets[h & (cache->num_buckets - 1)]; grid != NULL;
+         grid = grid->hash_next) {
+        if (grid->hash == h && fft_grid_keys_match(&grid->key, key, cache->tolerance)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Add a new grid for the key, evicting least recently used grids
+ */
+FFTGrid* fft_cache_insert(FFTGridCache* cache, const FFTGridKey* key, int num_strikes) {
+    if (cache == NULL || key == NULL || num_strikes <= 0) {
+        return NULL;
+    }
+
+    FFTGrid* grid = take_spare(cache, num_strikes);
+    if (grid != NULL) {
+        double* prices = grid->prices;
+        double* spare_sensitivities = grid->spare_sensitivities;
+        memset(grid, 0, sizeof(FFTGrid));
+        grid->prices = prices;
+        grid->spare_sensitivities = spare_sensitivities;
+    } else {
+        grid = (FFTGrid*)calloc(1, sizeof(FFTGrid));
+        if (grid == NULL) {
+            return NULL;
+        }
+        /* Prices, strikes and slopes share one block */
+        grid->prices = (double*)malloc(3 * (size_t)num_strikes * sizeof(double));
+        if (grid->prices == NULL) {
+            free(grid);
+            return NULL;
+        }
+        cache->stats.allocations++;
+    }
+
+    grid->strikes = grid->prices + num_strikes;
+    grid->slopes = grid->prices + 2 * (size_t)num_strikes;
+    grid->key = *key;
+    grid->num_strikes = num_strikes;
+    grid->hash = fft_grid_key_hash(key, cache->tolerance);
+
+    size_t b = grid->hash & (cache->num_buckets - 1);
+    grid->hash_next = cache->buckets[b];
+    cache->buckets[b] = grid;
+    lru_push_front(cache, grid);
+
+    cache->stats.entries++;
+    cache->stats.bytes += grid_bytes(grid);
+
+    enforce_limit(cache, grid);
+    maybe_grow(cache);
+
+    return grid;
+}
+
+/**
+ * @brief Set the uniform log-strike axis of a filled grid and fit its spline
+ */
+void fft_grid_fit(FFTGrid* grid, double log_strike0, double log_strike_step) {
+    const int n = grid->num_strikes;
+    const double* y = grid->prices;
+    double* m = grid->slopes;
+
+    grid->log_strike0 = log_strike0;
+    grid->log_strike_step = log_strike_step;
+    grid->inv_log_strike_step = 1.0 / log_strike_step;
+
+    for (int i = 0; i < n; i++) {
+        grid->strikes[i] = exp(log_strike0 + i * log_strike_step);
+    }
+
+    if (n < 2) {
+        m[0] = 0.0;
+        return;
+    }
+
+    /* Secant slopes, with one-sided slopes at the ends */
+    double prev = (y[1] - y[0]) * grid->inv_log_strike_step;
+    m[0] = prev;
+    for (int i = 1; i < n - 1; i++) {
+        double next = (y[i + 1] - y[i]) * grid->inv_log_strike_step;
+        /* Harmonic mean of same-signed secants, 0 at local extrema */
+        m[i] = (prev * next > 0.0) ? 2.0 * prev * next / (prev + next) : 0.0;
+        prev = next;
+    }
+    m[n - 1] = prev;
+}
+
+/* Cubic Hermite interpolation of one row of values and slopes at strike K */
+static double grid_interpolate(const FFTGrid* grid, const double* y, const double* m, double K) {
+    const int last = grid->num_strikes - 1;
+    double x = (log(K) - grid->log_strike0) * grid->inv_log_strike_step;
+
+    if (!(x > 0.0)) {
+        return y[0];
+    }
+    if (x >= last) {
+        return y[last];
+    }
+
+    int i = (int)x;
+    double t = x - i;
+    double h = grid->log_strike_step;
+
+    /* Cubic Hermite basis on [i, i + 1] */
+    double t2 = t * t;
+    double t3 = t2 * t;
+    double h00 = 2.0 * t3 - 3.0 * t2 + 1.0;
+    double h10 = t3 - 2.0 * t2 + t;
+    double h01 = 3.0 * t2 - 2.0 * t3;
+    double h11 = t3 - t2;
+
+    return h00 * y[i] + h01 * y[i + 1] + h * (h10 * m[i] + h11 * m[i + 1]);
+}
+
+/**
+ * @brief Interpolated price for strike K
+ */
+double fft_grid_price(const FFTGrid* grid, double K) {
+    return grid_interpolate(grid, grid->prices, grid->slopes, K);
+}
+
+/**
+ * @brief Allocate the sensitivity rows of a cached grid
+ */
+bool fft_grid_add_sensitivities(FFTGridCache* cache, FFTGrid* grid) {
+    if (cache == NULL || grid == NULL || grid->sensitivities != NULL) {
+        return false;
+    }
+
+    /* Rows and their slopes share one block, kept from a recycled grid if there is one */
+    const size_t count = FFT_GRID_SENSITIVITIES * (size_t)grid->num_strikes;
+    if (grid->spare_sensitivities != NULL) {
+        /* Already charged to the cache */
+        grid->sensitivities = grid->spare_sensitivities;
+        grid->spare_sensitivities = NULL;
+    } else {
+        grid->sensitivities = (double*)malloc(2 * count * sizeof(double));
+        if (grid->sensitivities == NULL) {
+            return false;
+        }
+        cache->stats.allocations++;
+        cache->stats.bytes += 2 * count * sizeof(double);
+        enforce_limit(cache, grid);
+    }
+    grid->sensitivity_slopes = grid->sensitivities + count;
+
+    return true;
+}
+
+/**
+ * @brief Fit the splines of filled sensitivity rows
+ */
+void fft_grid_fit_sensitivities(FFTGrid* grid) {
+    const int n = grid->num_strikes;
+
+    for (int s = 0; s < FFT_GRID_SENSITIVITIES; s++) {
+        const double* y = grid->sensitivities + (size_t)s * n;
+        double* m = grid->sensitivity_slopes + (size_t)s * n;
+
+        if (n < 2) {
+            m[0] = 0.0;
+            continue;
+        }
+
+        /* Central differences inside, one-sided at the ends */
+        m[0] = (y[1] - y[0]) * grid->inv_log_strike_step;
+        for (int i = 1; i < n - 1; i++) {
+            m[i] = 0.5 * (y[i + 1] - y[i - 1]) * grid->inv_log_strike_step;
+        }
+        m[n - 1] = (y[n - 1] - y[n - 2]) * grid->inv_log_strike_step;
+    }
+}
+
+/**
+ * @brief Interpolated sensitivity for strike K
+ */
+double fft_grid_sensitivity(const FFTGrid* grid, FFTGridSensitivity which, double K) {
+    const size_t offset = (size_t)which * grid->num_strikes;
+    return grid_interpolate(grid, grid->sensitivities + offset, grid->sensitivity_slopes + offset, K);
+}
+
+/**
+ * @brief Remove one grid, keeping its memory for reuse
+ */
+void fft_cache_remove(FFTGridCache* cache, FFTGrid* grid) {
+    if (cache == NULL || grid == NULL) {
+        return;
+    }
+
+    drop_grid(cache, grid, true);
+}
+
+/**
+ * @brief Change the memory limit, evicting grids if needed
+ */
+void fft_cache_set_limit(FFTGridCache* cache, size_t max_bytes) {
+    if (cache == NULL) {
+        return;
+    }
+
+    cache->stats.max_bytes = (max_bytes > 0) ? max_bytes : FFT_CACHE_DEFAULT_MAX_BYTES;
+    enforce_limit(cache, cache->lru_head);
+}
+
+/**
+ * @brief Change the key tolerance
+ */
+void fft_cache_set_tolerance(FFTGridCache* cache, double tolerance) {
+    if (cache == NULL || tolerance <= 0.0 || tolerance == cache->tolerance) {
+        return;
+    }
+
+    fft_cache_clear(cache);
+    cache->tolerance = tolerance;
+}
+
+/**
+ * @brief Read the usage counters
+ */
+void fft_cache_get_stats(const FFTGridCache* cache, FFTCacheStats* stats) {
+    if (stats == NULL) {
+        return;
+    }
+
+    if (cache == NULL) {
+        memset(stats, 0, sizeof(FFTCacheStats));
+        return;
+    }
+
+    *stats = cache->stats;
+}
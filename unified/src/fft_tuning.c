@@ -0,0 +1,257 @@
+/**
+ * @file fft_tuning.c
+ * @brief Table of FFT settings tuned offline per expiry, moneyness and volatility level
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "../include/fft_tuning.h"
+
+/* Longest line of a table file */
+#define FFT_TUNING_LINE 1024
+
+static int valid_edges(const double* edges, int count) {
+    if (edges == NULL || count < 1 || count > FFT_TUNING_MAX_EDGES) {
+        return 0;
+    }
+    for (int i = 0; i < count; i++) {
+        if (!(edges[i] > 0.0) || (i > 0 && !(edges[i] > edges[i - 1]))) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static size_t num_entries(const FFTTuningTable* table) {
+    return (size_t)table->num_expiries * (size_t)table->num_moneyness * (size_t)table->num_vols;
+}
+
+/* First edge >= value, or -1 beyond the last one */
+static int find_bucket(const double* edges, int count, double value) {
+    for (int i = 0; i < count; i++) {
+        if (value <= edges[i]) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+FFTTuningTable* fft_tuning_create(const double* expiries, int num_expiries,
+                                  const double* moneyness, int num_moneyness,
+                                  const double* vols, int num_vols, double target) {
+    if (!valid_edges(expiries, num_expiries) || !valid_edges(moneyness, num_moneyness) ||
+        !valid_edges(vols, num_vols) || !(target > 0.0)) {
+        return NULL;
+    }
+
+    FFTTuningTable* table = calloc(1, sizeof(FFTTuningTable));
+    if (table == NULL) {
+        return NULL;
+    }
+    table->num_expiries = num_expiries;
+    table->num_moneyness = num_moneyness;
+    table->num_vols = num_vols;
+    memcpy(table->expiries, expiries, (size_t)num_expiries * sizeof(double));
+    memcpy(table->moneyness, moneyness, (size_t)num_moneyness * sizeof(double));
+    memcpy(table->vols, vols, (size_t)num_vols * sizeof(double));
+    table->target = target;
+
+    table->entries = calloc(num_entries(table), sizeof(FFTTuningEntry));
+    if (table->entries == NULL) {
+        free(table);
+        return NULL;
+    }
+    return table;
+}
+
+/* Parse "<name> <count> <edge>..." into edges; returns the count or -1 */
+static int parse_axis(const char* line, const char* name, double* edges) {
+    size_t len = strlen(name);
+    if (strncmp(line, name, len) != 0 || (line[len] != ' ' && line[len] != '\t')) {
+        return -1;
+    }
+
+    const char* p = line + len;
+    int count, used;
+    if (sscanf(p, "%d%n", &count, &used) != 1 || count < 1 || count > FFT_TUNING_MAX_EDGES) {
+        return -1;
+    }
+    p += used;
+    for (int i = 0; i < count; i++) {
+        if (sscanf(p, "%lf%n", &edges[i], &used) != 1) {
+            return -1;
+        }
+        p += used;
+    }
+    return valid_edges(edges, count) ? count : -1;
+}
+
+/* Next line that is neither blank nor a comment, NULL at the end of the file */
+static char* next_line(FILE* file, char* line) {
+    while (fgets(line, FFT_TUNING_LINE, file) != NULL) {
+        const char* p = line + strspn(line, " \t");
+        if (*p != '#' && *p != '\n' && *p != '\0') {
+            return line;
+        }
+    }
+    return NULL;
+}
+
+FFTTuningTable* fft_tuning_load(const char* path) {
+    if (path == NULL) {
+        return NULL;
+    }
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        return NULL;
+    }
+
+    char line[FFT_TUNING_LINE];
+    char magic[32];
+    int version = 0;
+    double target = 0.0;
+    double expiries[FFT_TUNING_MAX_EDGES];
+    double moneyness[FFT_TUNING_MAX_EDGES];
+    double vols[FFT_TUNING_MAX_EDGES];
+    int num_expiries = -1, num_moneyness = -1, num_vols = -1;
+
+    int ok = next_line(file, line) != NULL &&
+             sscanf(line, "%31s %d", magic, &version) == 2 &&
+             strcmp(magic, FFT_TUNING_MAGIC) == 0 && version == FFT_TUNING_VERSION &&
+             next_line(file, line) != NULL && sscanf(line, "target %lf", &target) == 1 &&
+             next_line(file, line) != NULL &&
+             (num_expiries = parse_axis(line, "expiries", expiries)) > 0 &&
+             next_line(file, line) != NULL &&
+             (num_moneyness = parse_axis(line, "moneyness", moneyness)) > 0 &&
+             next_line(file, line) != NULL &&
+             (num_vols = parse_axis(line, "vols", vols)) > 0;
+
+    FFTTuningTable* table = NULL;
+    if (ok) {
+        table = fft_tuning_create(expiries, num_expiries, moneyness, num_moneyness,
+                                  vols, num_vols, target);
+        ok = table != NULL;
+    }
+
+    // Buckets without a line stay untuned
+    while (ok && next_line(file, line) != NULL) {
+        int t, m, v;
+        FFTTuningEntry entry;
+        ok = sscanf(line, "%d %d %d %d %lf %lf %lf %lf", &t, &m, &v, &entry.fft_n,
+                    &entry.eta, &entry.alpha, &entry.log_strike_range, &entry.max_error) == 8 &&
+             t >= 0 && t < num_expiries && m >= 0 && m < num_moneyness && v >= 0 && v < num_vols &&
+             entry.fft_n >= 16 && (entry.fft_n & (entry.fft_n - 1)) == 0 &&
+             entry.eta > 0.0 && entry.alpha > 0.0 && entry.log_strike_range > 0.0;
+        if (ok) {
+            *fft_tuning_entry(table, t, m, v) = entry;
+        }
+    }
+    fclose(file);
+
+    if (!ok) {
+        fft_tuning_free(table);
+        return NULL;
+    }
+    return table;
+}
+
+static void write_axis(FILE* file, const char* name, const double* edges, int count) {
+    fprintf(file, "%s %d", name, count);
+    for (int i = 0; i < count; i++) {
+        fprintf(file, " %.10g", edges[i]);
+    }
+    fputc('\n', file);
+}
+
+int fft_tuning_save(const FFTTuningTable* table, const char* path) {
+    if (table == NULL || path == NULL) {
+        return -1;
+    }
+
+    size_t len = strlen(path);
+    char* tmp_path = malloc(len + 5);
+    if (tmp_path == NULL) {
+        return -1;
+    }
+    memcpy(tmp_path, path, len);
+    memcpy(tmp_path + len, ".tmp", 5);
+
+    FILE* file = fopen(tmp_path, "w");
+    int ok = file != NULL;
+    if (ok) {
+        fprintf(file, "%s %d\n", FFT_TUNING_MAGIC, FFT_TUNING_VERSION);
+        fprintf(file, "target %.10g\n", table->target);
+        write_axis(file, "expiries", table->expiries, table->num_expiries);
+        write_axis(file, "moneyness", table->moneyness, table->num_moneyness);
+        write_axis(file, "vols", table->vols, table->num_vols);
+        fprintf(file, "# expiry moneyness vol fft_n eta alpha log_strike_range max_error\n");
+
+        for (int t = 0; t < table->num_expiries; t++) {
+            for (int m = 0; m < table->num_moneyness; m++) {
+                for (int v = 0; v < table->num_vols; v++) {
+                    const FFTTuningEntry* entry = fft_tuning_entry(table, t, m, v);
+                    if (entry->fft_n > 0) {
+                        fprintf(file, "%d %d %d %d %.10g %.10g %.10g %.3e\n", t, m, v,
+                                entry->fft_n, entry->eta, entry->alpha,
+                                entry->log_strike_range, entry->max_error);
+                    }
+                }
+            }
+        }
+        ok = !ferror(file);
+        ok = fclose(file) == 0 && ok;
+    }
+    ok = ok && rename(tmp_path, path) == 0;
+
+    if (!ok) {
+        remove(tmp_path);
+    }
+    free(tmp_path);
+    return ok ? 0 : -1;
+}
+
+void fft_tuning_free(FFTTuningTable* table) {
+    if (table == NULL) {
+        return;
+    }
+    free(table->entries);
+    free(table);
+}
+
+FFTTuningEntry* fft_tuning_entry(const FFTTuningTable* table, int expiry, int moneyness, int vol) {
+    size_t index = ((size_t)expiry * (size_t)table->num_moneyness + (size_t)moneyness) *
+                   (size_t)table->num_vols + (size_t)vol;
+    return &table->entries[index];
+}
+
+const FFTTuningEntry* fft_tuning_lookup(const FFTTuningTable* table, double T,
+                                        double log_moneyness, double vol) {
+    if (table == NULL) {
+        return NULL;
+    }
+
+    int t = find_bucket(table->expiries, table->num_expiries, T);
+    int m = find_bucket(table->moneyness, table->num_moneyness, fabs(log_moneyness));
+    int v = find_bucket(table->vols, table->num_vols, vol);
+    if (t < 0 || m < 0 || v < 0) {
+        return NULL;
+    }
+
+    const FFTTuningEntry* entry = fft_tuning_entry(table, t, m, v);
+    return entry->fft_n > 0 ? entry : NULL;
+}
+
+double fft_tuning_vol_level(const HestonParams* params, double T) {
+    // E[v_t] = theta + (v0 - theta) exp(-kappa t), averaged over [0, T]
+    double variance = params->theta;
+    double decay = params->kappa * T;
+    if (decay > 1e-8) {
+        variance += (params->v0 - params->theta) * (1.0 - exp(-decay)) / decay;
+    } else {
+        variance = params->v0;
+    }
+    return sqrt(fmax(variance, 0.0));
+}
@@ -0,0 +1,587 @@
+/**
+ * @file grid_share.c
+ * @brief FFT price grids published in shared memory for other processes
+ *
+ * Segment layout: a 64-byte header, then num_slots slots of slot_size
+ * bytes. A slot starts with a 256-byte header (sequence, publish stamp, key
+ * and log-strike axis), followed by max_strikes prices, max_strikes spline
+ * slopes, and room for the sensitivity rows and their slopes, each block
+ * packed with a stride of the grid's own number of strikes like an FFTGrid.
+ * A reader interpolates through an FFTGrid view whose arrays point into the
+ * slot, then checks that the slot's sequence did not change meanwhile.
+ */
+
+/* Open file description locks (F_OFD_SETLK) are declared for _GNU_SOURCE */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../include/grid_share.h"
+
+#define SHARE_HEADER_SIZE 64
+#define SLOT_HEADER_SIZE 256
+
+/* Prices, slopes, and the sensitivity rows with their slopes */
+#define SLOT_ROWS (2 + 2 * FFT_GRID_SENSITIVITIES)
+
+/* Slots a key may be published in, starting at its hash */
+#define SHARE_PROBES 8
+
+/* Reads of a busy segment before a lookup gives up with a miss */
+#define SHARE_MAX_RETRIES 64
+
+/* Upper bounds that keep the segment size well within size_t */
+#define SHARE_MAX_SLOTS 65536
+#define SHARE_MAX_STRIKES 65536
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t num_slots;
+    uint32_t max_strikes;
+    uint32_t reserved;
+    uint64_t slot_size;
+    double tolerance;         /* Key tolerance of the publisher */
+    uint64_t stamp;           /* Grids published so far */
+    char padding[SHARE_HEADER_SIZE - 48];
+} ShareHeader;
+
+typedef struct {
+    uint64_t sequence;        /* Odd while the publisher rewrites the slot */
+    uint64_t stamp;           /* Publish number of the grid, 0 for an empty slot */
+    uint64_t hash;            /* fft_grid_key_hash() of the key */
+    FFTGridKey key;
+    int32_t num_strikes;
+    int32_t has_sensitivities;
+    double log_strike0;
+    double log_strike_step;
+} SlotHeader;
+
+/* Both headers must keep their sizes, the segment layout depends on them */
+typedef char share_header_size_check[(sizeof(ShareHeader) == SHARE_HEADER_SIZE &&
+                                      sizeof(SlotHeader) <= SLOT_HEADER_SIZE) ? 1 : -1];
+
+struct GridShare {
+    char* base;               /* Mapping */
+    size_t size;              /* Size of the mapping */
+    int fd;                   /* Publisher: holds the write lock on the file; -1 for readers */
+    bool publisher;
+    char* path;               /* Publisher: segment file, removed again on close */
+    uint32_t num_slots;
+    uint32_t max_strikes;
+    size_t slot_size;
+    double tolerance;
+    pthread_mutex_t lock;     /* Serializes publishing threads */
+    GridShareStats stats;
+};
+
+/* Reads one consistent version of a slot through a view; false if it lacks what is needed */
+typedef bool (*SlotRead)(const FFTGrid* view, void* arg);
+
+static size_t slot_size_for(uint32_t max_strikes) {
+    return SLOT_HEADER_SIZE + SLOT_ROWS * (size_t)max_strikes * sizeof(double);
+}
+
+static SlotHeader* slot_at(const GridShare* share, uint32_t index) {
+    return (SlotHeader*)(void*)(share->base + SHARE_HEADER_SIZE + (size_t)index * share->slot_size);
+}
+
+static double* slot_data(const GridShare* share, uint32_t index) {
+    return (double*)(void*)((char*)slot_at(share, index) + SLOT_HEADER_SIZE);
+}
+
+static void count(unsigned long* counter) {
+    __atomic_fetch_add(counter, 1, __ATOMIC_RELAXED);
+}
+
+/* Exclusive lock on the whole file; fails while another descriptor holds it.
+ * The lock belongs to the open file description where the system has such
+ * locks, so that probing a segment through a second descriptor neither
+ * succeeds against a publisher of this process nor drops its lock when the
+ * probe is closed; plain POSIX locks do both. */
+static int lock_segment(int fd) {
+    struct flock lock;
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type = F_WRLCK;
+    lock.l_whence = SEEK_SET;
+#ifdef F_OFD_SETLK
+    return fcntl(fd, F_OFD_SETLK, &lock);
+#else
+    return fcntl(fd, F_SETLK, &lock);
+#endif
+}
+
+/* Whether the path still names the file open on fd */
+static bool same_file(const char* path, int fd) {
+    struct stat by_path, by_fd;
+    return stat(path, &by_path) == 0 && fstat(fd, &by_fd) == 0 &&
+           by_path.st_dev == by_fd.st_dev && by_path.st_ino == by_fd.st_ino;
+}
+
+static GridShare* new_handle(char* base, size_t size, int fd, bool publisher) {
+    const ShareHeader* header = (const ShareHeader*)(void*)base;
+
+    GridShare* share = (GridShare*)calloc(1, sizeof(GridShare));
+    if (share == NULL) {
+        return NULL;
+    }
+    share->base = base;
+    share->size = size;
+    share->fd = fd;
+    share->publisher = publisher;
+    share->num_slots = header->num_slots;
+    share->max_strikes = header->max_strikes;
+    share->slot_size = (size_t)header->slot_size;
+    share->tolerance = header->tolerance;
+    pthread_mutex_init(&share->lock, NULL);
+    return share;
+}
+
+/**
+ * @brief Create a segment and open it for publishing
+ */
+GridShare* grid_share_create(const char* path, int num_slots, int max_strikes, double tolerance) {
+    if (path == NULL || num_slots < 0 || num_slots > SHARE_MAX_SLOTS ||
+        max_strikes < 0 || max_strikes > SHARE_MAX_STRIKES || !(tolerance > 0.0)) {
+        return NULL;
+    }
+    if (num_slots == 0) {
+        num_slots = GRID_SHARE_DEFAULT_SLOTS;
+    }
+    if (max_strikes == 0) {
+        max_strikes = GRID_SHARE_DEFAULT_STRIKES;
+    }
+    if (max_strikes < 2) {
+        return NULL;
+    }
+
+    /* Leave the segment of a running publisher alone */
+    int fd = open(path, O_RDWR);
+    if (fd >= 0) {
+        int held = lock_segment(fd) != 0;
+        close(fd);
+        if (held) {
+            return NULL;
+        }
+    }
+
+    size_t len = strlen(path);
+    char* tmp_path = (char*)malloc(len + 5);
+    if (tmp_path == NULL) {
+        return NULL;
+    }
+    memcpy(tmp_path, path, len);
+    memcpy(tmp_path + len, ".tmp", 5);
+
+    const size_t slot_size = slot_size_for((uint32_t)max_strikes);
+    const size_t size = SHARE_HEADER_SIZE + (size_t)num_slots * slot_size;
+
+    /* A zero-filled file is a segment of empty slots */
+    fd = open(tmp_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    int ok = fd >= 0 && lock_segment(fd) == 0 && ftruncate(fd, (off_t)size) == 0;
+    void* map = ok ? mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    ok = map != MAP_FAILED;
+
+    if (ok) {
+        ShareHeader* header = (ShareHeader*)map;
+        memcpy(header->magic, GRID_SHARE_MAGIC, sizeof(header->magic));
+        header->version = GRID_SHARE_VERSION;
+        header->num_slots = (uint32_t)num_slots;
+        header->max_strikes = (uint32_t)max_strikes;
+        header->slot_size = slot_size;
+        header->tolerance = tolerance;
+        ok = rename(tmp_path, path) == 0;
+    }
+
+    GridShare* share = ok ? new_handle((char*)map, size, fd, true) : NULL;
+    if (share != NULL && (share->path = strdup(path)) == NULL) {
+        pthread_mutex_destroy(&share->lock);
+        free(share);
+        share = NULL;
+    }
+    if (share == NULL) {
+        if (map != MAP_FAILED) {
+            munmap(map, size);
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+        remove(ok ? path : tmp_path);
+    }
+    free(tmp_path);
+    return share;
+}
+
+/**
+ * @brief Map a segment for reading
+ */
+GridShare* grid_share_open(const char* path) {
+    if (path == NULL) {
+        return NULL;
+    }
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < SHARE_HEADER_SIZE) {
+        close(fd);
+        return NULL;
+    }
+
+    void* map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+
+    const ShareHeader* header = (const ShareHeader*)map;
+    if (memcmp(header->magic, GRID_SHARE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != GRID_SHARE_VERSION ||
+        header->num_slots < 1 || header->num_slots > SHARE_MAX_SLOTS ||
+        header->max_strikes < 2 || header->max_strikes > SHARE_MAX_STRIKES ||
+        header->slot_size != slot_size_for(header->max_strikes) || !(header->tolerance > 0.0) ||
+        SHARE_HEADER_SIZE + header->num_slots * header->slot_size > (uint64_t)st.st_size) {
+        munmap(map, (size_t)st.st_size);
+        return NULL;
+    }
+
+    GridShare* share = new_handle((char*)map, (size_t)st.st_size, -1, false);
+    if (share == NULL) {
+        munmap(map, (size_t)st.st_size);
+    }
+    return share;
+}
+
+/**
+ * @brief Unmap a segment and free the handle
+ */
+void grid_share_close(GridShare* share) {
+    if (share == NULL) {
+        return;
+    }
+
+    /* Removed while the lock is still held, so no new publisher's file goes with it */
+    if (share->publisher && same_file(share->path, share->fd)) {
+        unlink(share->path);
+    }
+
+    munmap(share->base, share->size);
+    if (share->fd >= 0) {
+        close(share->fd);
+    }
+    pthread_mutex_destroy(&share->lock);
+    free(share->path);
+    free(share);
+}
+
+/**
+ * @brief Check whether the handle came from grid_share_create()
+ */
+bool grid_share_is_publisher(const GridShare* share) {
+    return share != NULL && share->publisher;
+}
+
+static uint32_t num_probes(const GridShare* share) {
+    return share->num_slots < SHARE_PROBES ? share->num_slots : SHARE_PROBES;
+}
+
+/* Slot for a new grid: the one already holding the key, else an empty one, else the oldest */
+static uint32_t choose_slot(const GridShare* share, const FFTGridKey* key, unsigned long hash) {
+    uint32_t chosen = (uint32_t)(hash % share->num_slots);
+    uint64_t oldest = UINT64_MAX;
+
+    for (uint32_t i = 0; i < num_probes(share); i++) {
+        uint32_t index = (uint32_t)((hash + i) % share->num_slots);
+        const SlotHeader* slot = slot_at(share, index);
+        if (slot->stamp != 0 && slot->hash == (uint64_t)hash &&
+            fft_grid_keys_match(&slot->key, key, share->tolerance)) {
+            return index;
+        }
+        if (slot->stamp < oldest) {
+            oldest = slot->stamp;
+            chosen = index;
+        }
+    }
+    return chosen;
+}
+
+/**
+ * @brief Publish a grid prepared with fft_grid_fit()
+ */
+int grid_share_publish(GridShare* share, const FFTGrid* grid) {
+    if (share == NULL || !share->publisher || grid == NULL || grid->num_strikes < 2) {
+        return -1;
+    }
+    if ((uint32_t)grid->num_strikes > share->max_strikes) {
+        count(&share->stats.skipped);
+        return -1;
+    }
+
+    const size_t n = (size_t)grid->num_strikes;
+    const size_t max = share->max_strikes;
+    const bool sensitivities = grid->sensitivities != NULL && grid->sensitivity_slopes != NULL;
+    const unsigned long hash = fft_grid_key_hash(&grid->key, share->tolerance);
+
+    pthread_mutex_lock(&share->lock);
+
+    ShareHeader* header = (ShareHeader*)(void*)share->base;
+    const uint32_t index = choose_slot(share, &grid->key, hash);
+    SlotHeader* slot = slot_at(share, index);
+    double* data = slot_data(share, index);
+
+    /* Odd sequence first, so readers retry instead of using the slot */
+    const uint64_t sequence = slot->sequence;
+    __atomic_store_n(&slot->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    slot->stamp = ++header->stamp;
+    slot->hash = (uint64_t)hash;
+    slot->key = grid->key;
+    slot->num_strikes = (int32_t)n;
+    slot->has_sensitivities = sensitivities;
+    slot->log_strike0 = grid->log_strike0;
+    slot->log_strike_step = grid->log_strike_step;
+    memcpy(data, grid->prices, n * sizeof(double));
+    memcpy(data + max, grid->slopes, n * sizeof(double));
+    if (sensitivities) {
+        memcpy(data + 2 * max, grid->sensitivities, FFT_GRID_SENSITIVITIES * n * sizeof(double));
+        memcpy(data + (2 + FFT_GRID_SENSITIVITIES) * max, grid->sensitivity_slopes,
+               FFT_GRID_SENSITIVITIES * n * sizeof(double));
+    }
+
+    __atomic_store_n(&slot->sequence, sequence + 2, __ATOMIC_RELEASE);
+
+    pthread_mutex_unlock(&share->lock);
+
+    count(&share->stats.published);
+    return 0;
+}
+
+/* View of a slot for the grid interpolation; the stored sizes are clamped
+ * so that a view of a slot being rewritten still stays inside the slot */
+static void slot_view(const GridShare* share, uint32_t index, FFTGrid* view) {
+    const SlotHeader* slot = slot_at(share, index);
+    double* data = slot_data(share, index);
+    const size_t max = share->max_strikes;
+
+    int n = slot->num_strikes;
+    if (n < 1 || (uint32_t)n > share->max_strikes) {
+        n = 1;
+    }
+
+    memset(view, 0, sizeof(FFTGrid));
+    view->key = slot->key;
+    view->num_strikes = n;
+    view->prices = data;
+    view->slopes = data + max;
+    view->log_strike0 = slot->log_strike0;
+    view->log_strike_step = slot->log_strike_step;
+    view->inv_log_strike_step = 1.0 / slot->log_strike_step;
+    if (slot->has_sensitivities) {
+        view->sensitivities = data + 2 * max;
+        view->sensitivity_slopes = data + (2 + FFT_GRID_SENSITIVITIES) * max;
+    }
+}
+
+/* Slot publishing the key, with the sequence it was read at; -1 if none,
+ * with busy set if a slot that might hold it was being rewritten */
+static int find_slot(const GridShare* share, const FFTGridKey* key, unsigned long hash,
+                     uint64_t* sequence, bool* busy) {
+    for (uint32_t i = 0; i < num_probes(share); i++) {
+        uint32_t index = (uint32_t)((hash + i) % share->num_slots);
+        const SlotHeader* slot = slot_at(share, index);
+
+        *sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+        if (*sequence & 1) {
+            *busy = true;
+            continue;
+        }
+        if (slot->stamp != 0 && slot->hash == (uint64_t)hash &&
+            fft_grid_keys_match(&slot->key, key, share->tolerance)) {
+            return (int)index;
+        }
+    }
+    return -1;
+}
+
+/* Run a read on one consistent version of the grid published for the key */
+static bool read_published(GridShare* share, const FFTGridKey* key, SlotRead read, void* arg) {
+    const unsigned long hash = fft_grid_key_hash(key, share->tolerance);
+
+    for (int attempt = 0; attempt < SHARE_MAX_RETRIES; attempt++) {
+        uint64_t sequence = 0;
+        bool busy = false;
+        int index = find_slot(share, key, hash, &sequence, &busy);
+
+        if (index >= 0) {
+            FFTGrid view;
+            slot_view(share, (uint32_t)index, &view);
+            bool ok = read(&view, arg);
+
+            /* Anything read while the publisher rewrote the slot is discarded */
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (__atomic_load_n(&slot_at(share, (uint32_t)index)->sequence, __ATOMIC_RELAXED) == sequence) {
+                count(ok ? &share->stats.hits : &share->stats.misses);
+                return ok;
+            }
+        } else if (!busy) {
+            break;
+        }
+        count(&share->stats.retries);
+    }
+
+    count(&share->stats.misses);
+    return false;
+}
+
+typedef struct {
+    const double* strikes;
+    int num_strikes;
+    FFTGridSensitivity which;
+    double* values;
+} RowRead;
+
+static bool read_prices(const FFTGrid* view, void* arg) {
+    RowRead* row = (RowRead*)arg;
+    for (int i = 0; i < row->num_strikes; i++) {
+        row->values[i] = fft_grid_price(view, row->strikes[i]);
+    }
+    return true;
+}
+
+static bool read_sensitivities(const FFTGrid* view, void* arg) {
+    RowRead* row = (RowRead*)arg;
+    if (view->sensitivities == NULL) {
+        return false;
+    }
+    for (int i = 0; i < row->num_strikes; i++) {
+        row->values[i] = fft_grid_sensitivity(view, row->which, row->strikes[i]);
+    }
+    return true;
+}
+
+/**
+ * @brief Interpolate published prices for several strikes
+ */
+int grid_share_prices(GridShare* share, const FFTGridKey* key, const double* strikes,
+                      int num_strikes, double* prices) {
+    if (share == NULL || key == NULL || strikes == NULL || prices == NULL || num_strikes < 0) {
+        return -1;
+    }
+
+    RowRead row = { strikes, num_strikes, FFT_GRID_DX, prices };
+    return read_published(share, key, read_prices, &row) ? 0 : -1;
+}
+
+/**
+ * @brief Interpolate one published sensitivity row for several strikes
+ */
+int grid_share_sensitivities(GridShare* share, const FFTGridKey* key, FFTGridSensitivity which,
+                             const double* strikes, int num_strikes, double* values) {
+    if (share == NULL || key == NULL || strikes == NULL || values == NULL || num_strikes < 0 ||
+        (int)which < 0 || which >= FFT_GRID_SENSITIVITIES) {
+        return -1;
+    }
+
+    RowRead row = { strikes, num_strikes, which, values };
+    return read_published(share, key, read_sensitivities, &row) ? 0 : -1;
+}
+
+typedef struct {
+    FFTGridCache* cache;
+    const FFTGridKey* key;
+    FFTGrid* grid;            /* Copy so far, reused by a retry of the same shape */
+    double log_strike0;
+    double log_strike_step;
+} FetchRead;
+
+static bool read_copy(const FFTGrid* view, void* arg) {
+    FetchRead* fetch = (FetchRead*)arg;
+    const int n = view->num_strikes;
+    const bool sensitivities = view->sensitivities != NULL;
+
+    if (n < 2) {
+        return false;
+    }
+    if (fetch->grid != NULL &&
+        (fetch->grid->num_strikes != n || (fetch->grid->sensitivities != NULL) != sensitivities)) {
+        fft_cache_remove(fetch->cache, fetch->grid);
+        fetch->grid = NULL;
+    }
+    if (fetch->grid == NULL) {
+        fetch->grid = fft_cache_insert(fetch->cache, fetch->key, n);
+        if (fetch->grid == NULL) {
+            return false;
+        }
+        if (sensitivities && !fft_grid_add_sensitivities(fetch->cache, fetch->grid)) {
+            fft_cache_remove(fetch->cache, fetch->grid);
+            fetch->grid = NULL;
+            return false;
+        }
+    }
+
+    /* The slopes are refitted from the prices, which gives the published ones */
+    memcpy(fetch->grid->prices, view->prices, (size_t)n * sizeof(double));
+    if (sensitivities) {
+        memcpy(fetch->grid->sensitivities, view->sensitivities,
+               FFT_GRID_SENSITIVITIES * (size_t)n * sizeof(double));
+    }
+    fetch->log_strike0 = view->log_strike0;
+    fetch->log_strike_step = view->log_strike_step;
+    return true;
+}
+
+/**
+ * @brief Copy a published grid into a local cache
+ */
+FFTGrid* grid_share_fetch(GridShare* share, FFTGridCache* cache, const FFTGridKey* key) {
+    if (share == NULL || cache == NULL || key == NULL) {
+        return NULL;
+    }
+
+    FetchRead fetch = { cache, key, NULL, 0.0, 0.0 };
+    if (!read_published(share, key, read_copy, &fetch) || !(fetch.log_strike_step > 0.0)) {
+        if (fetch.grid != NULL) {
+            fft_cache_remove(cache, fetch.grid);
+        }
+        return NULL;
+    }
+
+    fft_grid_fit(fetch.grid, fetch.log_strike0, fetch.log_strike_step);
+    if (fetch.grid->sensitivities != NULL) {
+        fft_grid_fit_sensitivities(fetch.grid);
+    }
+    return fetch.grid;
+}
+
+/**
+ * @brief Read the usage counters of a handle
+ */
+void grid_share_get_stats(const GridShare* share, GridShareStats* stats) {
+    if (stats == NULL) {
+        return;
+    }
+
+    memset(stats, 0, sizeof(GridShareStats));
+    if (share == NULL) {
+        return;
+    }
+
+    stats->published = __atomic_load_n(&share->stats.published, __ATOMIC_RELAXED);
+    stats->skipped = __atomic_load_n(&share->stats.skipped, __ATOMIC_RELAXED);
+    stats->hits = __atomic_load_n(&share->stats.hits, __ATOMIC_RELAXED);
+    stats->misses = __atomic_load_n(&share->stats.misses, __ATOMIC_RELAXED);
+    stats->retries = __atomic_load_n(&share->stats.retries, __ATOMIC_RELAXED);
+}
@@ -1,3 +1,5 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -7,6 +9,9 @@
 #include "../include/option_types.h"
 #include "../include/error_handling.h"
 #include "../include/path_resolution.h"
+#include "../include/heston_fft.h"
+#include "../include/heston_cos.h"
+#include "../include/heston_mc.h"
 
 /**
  * Maximum length for command strings
@@ -19,7 +24,10 @@
 #define MAX_OUTPUT_LENGTH 4096
 
 /**
- * @brief Adapt the unified API to the legacy Heston model implementation
+ * @brief Price through the legacy quadrature binary (calculate_sv_v3)
+ * 
+ * Only the quadrature method still goes through an external process; the FFT
+ * engine runs in-process via libheston.
  * 
  * @param spot_price The current price of the underlying asset
  * @param strike_price The strike price of the option
@@ -28,13 +36,12 @@
  * @param dividend_yield Dividend yield (annualized)
  * @param volatility Initial volatility (if known, 0 to use default)
  * @param option_type Type of option (OPTION_CALL or OPTION_PUT)
- * @param method Numerical method to use (METHOD_QUADRATURE or METHOD_FFT)
  * @param market_price Market price (for implied volatility calculation, 0 to skip)
  * @param result Pointer to a PricingResult structure to store the result
  * 
  * @return 0 on success, error code on failure
  */
-int price_with_heston(
+static int price_with_heston_legacy(
     double spot_price,
     double strike_price,
     double time_to_expiry,
@@ -42,7 +49,6 @@ int price_with_heston(
     double dividend_yield,
     double volatility,
     OptionType option_type,
-    NumericalMethod method,
     double market_price,
     PricingResult* result
 ) {
@@ -50,31 +56,13 @@ int price_with_heston(
     char output[MAX_OUTPUT_LENGTH];
     char* binary_path;
     FILE* pipe;
-    int ret = ERROR_NONE;
-    const char* version;
     const char* method_arg = "";
     
     /* Initialize result structure */
     memset(result, 0, sizeof(PricingResult));
     
-    /* Map the method to the appropriate version and arguments */
-    switch (method) {
-        case METHOD_QUADRATURE:
-            version = "v3";
-            break;
-            
-        case METHOD_FFT:
-            version = "v5";  /* Use the most advanced FFT implementation */
-            break;
-            
-        default:
-            set_error(ERROR_INVALID_NUMERICAL_METHOD);
-            result->error_code = ERROR_INVALID_NUMERICAL_METHOD;
-            return ERROR_INVALID_NUMERICAL_METHOD;
-    }
-    
     /* Determine which binary to use */
-    binary_path = resolve_legacy_binary_path(version, "calculate_sv");
+    binary_path = resolve_legacy_binary_path("v3", "calculate_sv");
     
     if (binary_path == NULL) {
         /* Error already set by resolve_legacy_binary_path */
@@ -184,9 +172,136 @@ int price_with_heston(
     return ERROR_NONE;
 }
 
+/**
+ * @brief Adapt the unified API to the Heston model implementation
+ * 
+ * METHOD_FFT, METHOD_COS and METHOD_MONTE_CARLO run in-process through
+ * libheston (see heston_fft.h, heston_cos.h and heston_mc.h);
+ * METHOD_QUADRATURE still uses the legacy calculate_sv_v3 binary.
+ * 
+ * @param ctx FFT context for METHOD_FFT (NULL for the engine's default context)
+ * @param spot_price The current price of the underlying asset
+ * @param strike_price The strike price of the option
+ * @param time_to_expiry Time to expiry in years
+ * @param risk_free_rate Risk-free interest rate (annualized)
+ * @param dividend_yield Dividend yield (annualized)
+ * @param volatility Initial volatility (if known, 0 to use default)
+ * @param option_type Type of option (OPTION_CALL or OPTION_PUT)
+ * @param method Numerical method to use (METHOD_QUADRATURE, METHOD_FFT, METHOD_COS or METHOD_MONTE_CARLO)
+ * @param market_price Market price (for implied volatility calculation, 0 to skip)
+ * @param result Pointer to a PricingResult structure to store the result
+ * 
+ * @return 0 on success, error code on failure
+ */
+int price_with_heston(
+    HestonFFTContext* ctx,
+    double spot_price,
+    double strike_price,
+    double time_to_expiry,
+    double risk_free_rate,
+    double dividend_yield,
+    double volatility,
+    OptionType option_type,
+    NumericalMethod method,
+    double market_price,
+    PricingResult* result
+) {
+    HestonParams params;
+    int ret;
+    
+    switch (method) {
+        case METHOD_QUADRATURE:
+            return price_with_heston_legacy(
+                spot_price, strike_price, time_to_expiry,
+                risk_free_rate, dividend_yield, volatility,
+                option_type, market_price, result);
+            
+        case METHOD_FFT:
+        case METHOD_COS:
+        case METHOD_MONTE_CARLO:
+            break;
+            
+        default:
+            memset(result, 0, sizeof(PricingResult));
+            set_error(ERROR_INVALID_NUMERICAL_METHOD);
+            result->error_code = ERROR_INVALID_NUMERICAL_METHOD;
+            return ERROR_INVALID_NUMERICAL_METHOD;
+    }
+    
+    /* Note: For the Heston model, volatility is the square root of the initial variance */
+    params.v0 = (volatility > 0) ? volatility * volatility : HESTON_DEFAULT_V0;
+    params.kappa = HESTON_DEFAULT_KAPPA;
+    params.theta = params.v0;
+    params.sigma = HESTON_DEFAULT_SIGMA;
+    params.rho = HESTON_DEFAULT_RHO;
+    
+    if (method == METHOD_COS) {
+        ret = heston_cos_price_option(
+            spot_price,
+            strike_price,
+            time_to_expiry,
+            risk_free_rate,
+            dividend_yield,
+            &params,
+            option_type,
+            market_price,
+            result
+        );
+    } else if (method == METHOD_MONTE_CARLO) {
+        ret = heston_mc_price_option(
+            spot_price,
+            strike_price,
+            time_to_expiry,
+            risk_free_rate,
+            dividend_yield,
+            &params,
+            option_type,
+            market_price,
+            result
+        );
+    } else if (ctx != NULL) {
+        ret = heston_fft_context_price_option(
+            ctx,
+            spot_price,
+            strike_price,
+            time_to_expiry,
+            risk_free_rate,
+            dividend_yield,
+            &params,
+            option_type,
+            market_price,
+            result
+        );
+    } else {
+        ret = heston_fft_price_option(
+            spot_price,
+            strike_price,
+            time_to_expiry,
+            risk_free_rate,
+            dividend_yield,
+            &params,
+            option_type,
+            market_price,
+            result
+        );
+    }
+    
+    if (ret != ERROR_NONE) {
+        set_error(ret);
+    }
+    
+    return ret;
+}
+
 /**
  * @brief Calculate Greeks for an option using the Heston model
  * 
+ * The price and all Greeks come from one cached FFT grid and its sensitivity
+ * grids (see heston_fft_greeks_chain()), so further strikes of the same
+ * expiry cost only lookups. The quadrature, COS and Monte Carlo engines
+ * have no sensitivity output; for them the Greeks also come from the FFT grid.
+ * 
+ * @param ctx FFT context the Greeks are read from (NULL for the engine's default context)
  * @param spot_price Spot price
  * @param strike_price Strike price
  * @param time_to_expiry Time to expiry in years
@@ -200,6 +315,7 @@ int price_with_heston(
  * @return 0 on success, error code on failure
  */
 int calculate_heston_greeks(
+    HestonFFTContext* ctx,
     double spot_price,
     double strike_price,
     double time_to_expiry,
@@ -210,23 +326,16 @@ int calculate_heston_greeks(
     NumericalMethod method,
     PricingResult* result
 ) {
-    char cmd[MAX_CMD_LENGTH];
-    char output[MAX_OUTPUT_LENGTH];
-    char* binary_path;
-    FILE* pipe;
-    const char* version;
+    HestonParams params;
     
     /* Initialize result structure */
     memset(result, 0, sizeof(PricingResult));
     
-    /* Map the method to the appropriate version */
     switch (method) {
         case METHOD_QUADRATURE:
-            version = "v3";
-            break;
-            
         case METHOD_FFT:
-            version = "v5";  /* Use the most advanced FFT implementation */
+        case METHOD_COS:
+        case METHOD_MONTE_CARLO:
             break;
             
         default:
@@ -235,27 +344,26 @@ int calculate_heston_greeks(
             return ERROR_INVALID_NUMERICAL_METHOD;
     }
     
-    /* For now, we'll use finite differences as a placeholder */
-    /* This is not optimal and should be replaced with direct calculations */
+    /* Same parameters as price_with_heston() */
+    params.v0 = (volatility > 0) ? volatility * volatility : HESTON_DEFAULT_V0;
+    params.kappa = HESTON_DEFAULT_KAPPA;
+    params.theta = params.v0;
+    params.sigma = HESTON_DEFAULT_SIGMA;
+    params.rho = HESTON_DEFAULT_RHO;
     
-    /* Calculate the base price */
-    if (price_with_heston(
-            spot_price, strike_price, time_to_expiry,
-            risk_free_rate, dividend_yield, volatility,
-            option_type, method, 0.0, result) != ERROR_NONE) {
-        /* Error already set by price_with_heston */
+    int failed = (ctx != NULL)
+        ? heston_fft_context_greeks_chain(ctx, spot_price, time_to_expiry, risk_free_rate,
+                                          dividend_yield, &params, &strike_price, 1, option_type, result)
+        : heston_fft_greeks_chain(spot_price, time_to_expiry, risk_free_rate, dividend_yield,
+                                  &params, &strike_price, 1, option_type, result);
+    if (failed != 0) {
+        if (result->error_code == ERROR_NONE) {
+            result->error_code = ERROR_GREEKS_CALCULATION;
+        }
+        set_error(result->error_code);
         return result->error_code;
     }
     
-    /* The real implementation would use the legacy SV calculator's Greeks functionality */
-    /* For now, set dummy values for Greeks */
-    result->delta = 0.5;  /* Placeholder */
-    result->gamma = 0.1;  /* Placeholder */
-    result->theta = -0.1; /* Placeholder */
-    result->vega = 0.2;   /* Placeholder */
-    result->rho = 0.05;   /* Placeholder */
-    
-    result->error_code = ERROR_NONE;
     return ERROR_NONE;
 }
 
@@ -287,6 +395,7 @@ double calculate_heston_iv(
     int ret;
     
     ret = price_with_heston(
+        NULL,
         spot_price,
         strike_price,
         time_to_expiry,
@@ -0,0 +1,643 @@
+/**
+ * @file heston_calibration.c
+ * @brief Levenberg-Marquardt calibration of one Heston parameter set to many quotes
+ *
+ * For every group of quotes sharing (S, T, r, q), one batched FFT of
+ * HESTON_NUM_PARAMS + 1 transforms gives the Carr-Madan call prices and their
+ * parameter derivatives on a uniform log-strike grid k_u = log(S) - b + lambda*u
+ * with lambda = 2*pi / (N*eta) and b = N*lambda / 2. Quote prices and
+ * Jacobian rows are interpolated from that grid.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <complex.h>
+
+#include <fftw3.h>
+
+#include "../include/heston_calibration.h"
+#include "../include/error_handling.h"
+#include "../include/perf_stats.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/* Transforms per expiry: the price plus one per parameter */
+#define NUM_TRANSFORMS (HESTON_NUM_PARAMS + 1)
+
+/* Parameter box, in the order v0, kappa, theta, sigma, rho */
+static const double PARAM_MIN[HESTON_NUM_PARAMS] = {1e-6, 1e-4, 1e-6, 1e-4, -0.999};
+static const double PARAM_MAX[HESTON_NUM_PARAMS] = {5.0, 50.0, 5.0, 5.0, 0.999};
+
+/* Damping limits; a step rejected at the upper limit ends the search */
+#define LAMBDA_MIN 1e-12
+#define LAMBDA_MAX 1e12
+
+/* Quotes sharing one transform batch */
+typedef struct {
+    double S, T, r, q;
+} QuoteGroup;
+
+/* Buffers and plan shared by every model evaluation of one calibration */
+typedef struct {
+    const HestonQuote* quotes;
+    int n;
+    int* group_of;            /* Group index of each quote */
+    QuoteGroup* groups;
+    int num_groups;
+    int fft_n;
+    double eta;
+    double alpha;
+    double* simpson_weights;  /* Simpson weights times eta */
+    fftw_complex* in;         /* NUM_TRANSFORMS contiguous transforms */
+    fftw_complex* out;
+    fftw_plan plan;           /* All transforms, for prices with gradients */
+    fftw_plan price_plan;     /* First transform only, for prices alone */
+} CalibrationWorkspace;
+
+static void params_to_vector(const HestonParams* p, double* x) {
+    x[0] = p->v0;
+    x[1] = p->kappa;
+    x[2] = p->theta;
+    x[3] = p->sigma;
+    x[4] = p->rho;
+}
+
+static void vector_to_params(const double* x, HestonParams* p) {
+    p->v0 = x[0];
+    p->kappa = x[1];
+    p->theta = x[2];
+    p->sigma = x[3];
+    p->rho = x[4];
+}
+
+static void project_to_box(double* x) {
+    for (int j = 0; j < HESTON_NUM_PARAMS; j++) {
+        x[j] = fmin(fmax(x[j], PARAM_MIN[j]), PARAM_MAX[j]);
+    }
+}
+
+/**
+ * @brief Fill in the default calibration settings
+ */
+void heston_calibration_default_options(HestonCalibrationOptions* options) {
+    if (options == NULL) {
+        return;
+    }
+
+    options->max_iterations = 100;
+    options->tolerance = 1e-10;
+    options->lambda = 1e-3;
+    options->fft_n = 4096;
+    options->eta = 0.25;
+    options->alpha = 1.5;
+}
+
+/**
+ * @brief Heston characteristic function and its gradient with respect to the parameters
+ *
+ * Same formulation as cf_heston(): phi = exp(A + B*v0 + i*u*log(S)) with
+ *   beta = kappa - rho*sigma*i*u,  d = sqrt(beta^2 - sigma^2*(i*u)*(i*u - 1)),
+ *   g = (beta - d) / (beta + d),   E = exp(-d*T),  Q = 1 - g*E,
+ *   A = (r - q)*i*u*T + kappa*theta/sigma^2 * ((beta - d)*T - 2*log(Q / (1 - g))),
+ *   B = (beta - d)*(1 - E) / (sigma^2 * Q).
+ * The derivatives follow by the chain rule through beta, d, g and E.
+ */
+double complex cf_heston_gradient(double complex phi, double S, const HestonParams* params,
+                                  double r, double q, double T, double complex* grad) {
+    const double v0 = params->v0;
+    const double kappa = params->kappa;
+    const double theta = params->theta;
+    const double sigma = params->sigma;
+    const double rho = params->rho;
+    const double sigma2 = sigma * sigma;
+
+    const double complex iu = I * phi;
+    const double complex w = iu * (iu - 1.0);
+    const double complex beta = kappa - rho * sigma * iu;
+    const double complex d = csqrt(beta * beta - sigma2 * w);
+    const double complex g = (beta - d) / (beta + d);
+    const double complex E = cexp(-d * T);
+    const double complex Q = 1.0 - g * E;
+    const double complex L = clog(Q / (1.0 - g));
+    const double complex M = (beta - d) * T - 2.0 * L;
+    const double complex N = (beta - d) * (1.0 - E);
+
+    const double complex A = (r - q) * iu * T + kappa * theta * M / sigma2;
+    const double complex B = N / (sigma2 * Q);
+    const double complex value = cexp(A + B * v0 + iu * clog(S));
+
+    if (!isfinite(creal(value)) || !isfinite(cimag(value))) {
+        for (int j = 0; j < HESTON_NUM_PARAMS; j++) {
+            grad[j] = 0.0;
+        }
+        return 1.0 + 0.0 * I;  /* Same safe default as cf_heston() */
+    }
+
+    /* d beta / d(kappa, sigma, rho) */
+    const double complex beta_p[3] = {1.0, -rho * iu, -sigma * iu};
+    double complex dlog[HESTON_NUM_PARAMS];
+
+    for (int k = 0; k < 3; k++) {
+        const bool is_sigma = (k == 1);
+        const double complex d_p = (beta * beta_p[k] - (is_sigma ? sigma * w : 0.0)) / d;
+        const double complex g_p = 2.0 * (d * beta_p[k] - beta * d_p) / ((beta + d) * (beta + d));
+        const double complex E_p = -T * d_p * E;
+        const double complex Q_p = -(g_p * E + g * E_p);
+        const double complex L_p = Q_p / Q + g_p / (1.0 - g);
+        const double complex M_p = (beta_p[k] - d_p) * T - 2.0 * L_p;
+        const double complex N_p = (beta_p[k] - d_p) * (1.0 - E) - (beta - d) * E_p;
+
+        double complex A_p = kappa * theta * M_p / sigma2;
+        double complex B_p = N_p / (sigma2 * Q) - N * Q_p / (sigma2 * Q * Q);
+
+        if (k == 0) {
+            A_p += theta * M / sigma2;
+        } else if (is_sigma) {
+            A_p -= 2.0 * kappa * theta * M / (sigma2 * sigma);
+            B_p -= 2.0 * N / (sigma2 * sigma * Q);
+        }
+
+        dlog[(k == 0) ? 1 : (k == 1) ? 3 : 4] = A_p + B_p * v0;
+    }
+
+    dlog[0] = B;
+    dlog[2] = kappa * M / sigma2;
+
+    for (int j = 0; j < HESTON_NUM_PARAMS; j++) {
+        grad[j] = value * dlog[j];
+        if (!isfinite(creal(grad[j])) || !isfinite(cimag(grad[j]))) {
+            grad[j] = 0.0;
+        }
+    }
+
+    return value;
+}
+
+static void free_workspace(CalibrationWorkspace* ws) {
+    heston_fft_planner_lock();
+    if (ws->plan != NULL) fftw_destroy_plan(ws->plan);
+    if (ws->price_plan != NULL) fftw_destroy_plan(ws->price_plan);
+    heston_fft_planner_unlock();
+    fftw_free(ws->in);
+    fftw_free(ws->out);
+    free(ws->simpson_weights);
+    free(ws->group_of);
+    free(ws->groups);
+    memset(ws, 0, sizeof(CalibrationWorkspace));
+}
+
+/* Group the quotes by (S, T, r, q) and set up the transform batch */
+static int init_workspace(CalibrationWorkspace* ws, const HestonQuote* quotes, int n,
+                          const HestonCalibrationOptions* options) {
+    memset(ws, 0, sizeof(CalibrationWorkspace));
+    ws->quotes = quotes;
+    ws->n = n;
+    ws->fft_n = options->fft_n;
+    ws->eta = options->eta;
+    ws->alpha = options->alpha;
+
+    ws->group_of = (int*)malloc(n * sizeof(int));
+    ws->groups = (QuoteGroup*)malloc(n * sizeof(QuoteGroup));
+    ws->simpson_weights = (double*)malloc(ws->fft_n * sizeof(double));
+    ws->in = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * ws->fft_n * NUM_TRANSFORMS);
+    ws->out = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * ws->fft_n * NUM_TRANSFORMS);
+
+    if (ws->group_of == NULL || ws->groups == NULL || ws->simpson_weights == NULL ||
+        ws->in == NULL || ws->out == NULL) {
+        free_workspace(ws);
+        return ERROR_MEMORY_ALLOCATION;
+    }
+
+    for (int i = 0; i < n; i++) {
+        const HestonQuote* quote = &quotes[i];
+        int g = 0;
+
+        while (g < ws->num_groups &&
+               !(ws->groups[g].S == quote->S && ws->groups[g].T == quote->T &&
+                 ws->groups[g].r == quote->r && ws->groups[g].q == quote->q)) {
+            g++;
+        }
+
+        if (g == ws->num_groups) {
+            ws->groups[g].S = quote->S;
+            ws->groups[g].T = quote->T;
+            ws->groups[g].r = quote->r;
+            ws->groups[g].q = quote->q;
+            ws->num_groups++;
+        }
+        ws->group_of[i] = g;
+    }
+
+    for (int j = 0; j < ws->fft_n; j++) {
+        double w = (j == 0) ? 1.0 / 3.0 : ((j % 2 == 1) ? 4.0 / 3.0 : 2.0 / 3.0);
+        ws->simpson_weights[j] = w * ws->eta;
+    }
+
+    heston_fft_planner_lock();
+    ws->plan = fftw_plan_many_dft(1, &ws->fft_n, NUM_TRANSFORMS,
+                                  ws->in, NULL, 1, ws->fft_n,
+                                  ws->out, NULL, 1, ws->fft_n,
+                                  FFTW_FORWARD, FFTW_ESTIMATE);
+    ws->price_plan = fftw_plan_dft_1d(ws->fft_n, ws->in, ws->out, FFTW_FORWARD, FFTW_ESTIMATE);
+    heston_fft_planner_unlock();
+
+    if (ws->plan == NULL || ws->price_plan == NULL) {
+        free_workspace(ws);
+        return ERROR_CALCULATION_FAILED;
+    }
+
+    return ERROR_NONE;
+}
+
+/*
+ * Model prices of every quote at x, and the Jacobian (n x HESTON_NUM_PARAMS,
+ * row-major) unless jac is NULL. Returns false if a quote falls off the grid
+ * or the transform is not finite.
+ */
+static bool evaluate_model(CalibrationWorkspace* ws, const double* x, double* model, double* jac) {
+    const int n_fft = ws->fft_n;
+    const int transforms = (jac != NULL) ? NUM_TRANSFORMS : 1;
+    const double alpha = ws->alpha;
+    const double lambda = 2.0 * M_PI / (n_fft * ws->eta);
+    const double b = 0.5 * n_fft * lambda;
+    HestonParams p;
+
+    PERF_COUNT(PERF_CALIBRATION_EVAL);
+    vector_to_params(x, &p);
+
+    for (int g = 0; g < ws->num_groups; g++) {
+        const QuoteGroup* group = &ws->groups[g];
+        const double k0 = log(group->S) - b;
+        const double discount = exp(-group->r * group->T);
+
+        for (int j = 0; j < n_fft; j++) {
+            const double v = j * ws->eta;
+            const double complex denom = alpha * alpha + alpha - v * v + I * (2.0 * alpha + 1.0) * v;
+            const double complex scale = discount * cexp(-I * v * k0) * ws->simpson_weights[j] / denom;
+            const double complex u = v - (alpha + 1.0) * I;
+            double complex grad[HESTON_NUM_PARAMS];
+            double complex value;
+
+            if (jac != NULL) {
+                value = cf_heston_gradient(u, group->S, &p, group->r, group->q, group->T, grad);
+            } else {
+                value = cf_heston(u, group->S, p.v0, p.kappa, p.theta, p.sigma, p.rho,
+                                  group->r, group->q, group->T);
+            }
+
+            ws->in[j] = scale * value;
+            for (int t = 1; t < transforms; t++) {
+                ws->in[t * n_fft + j] = scale * grad[t - 1];
+            }
+        }
+
+        fftw_execute((jac != NULL) ? ws->plan : ws->price_plan);
+
+        for (int i = 0; i < ws->n; i++) {
+            if (ws->group_of[i] != g) {
+                continue;
+            }
+
+            const double pos = (log(ws->quotes[i].K) - k0) / lambda;
+            const int idx = (int)floor(pos);
+            if (idx < 0 || idx >= n_fft - 1) {
+                return false;
+            }
+
+            const double frac = pos - idx;
+            const double k_lo = k0 + lambda * idx;
+            const double damp_lo = exp(-alpha * k_lo) / M_PI;
+            const double damp_hi = exp(-alpha * (k_lo + lambda)) / M_PI;
+
+            for (int t = 0; t < transforms; t++) {
+                const double lo = creal(ws->out[t * n_fft + idx]) * damp_lo;
+                const double hi = creal(ws->out[t * n_fft + idx + 1]) * damp_hi;
+                const double value = lo + frac * (hi - lo);
+
+                if (!isfinite(value)) {
+                    return false;
+                }
+
+                if (t == 0) {
+                    model[i] = value;
+                } else {
+                    jac[i * HESTON_NUM_PARAMS + t - 1] = value;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+/* Half the weighted sum of squared residuals, storing the residuals */
+static double residual_cost(const CalibrationWorkspace* ws, const double* model, double* residuals) {
+    double cost = 0.0;
+
+    for (int i = 0; i < ws->n; i++) {
+        double w = (ws->quotes[i].weight > 0.0) ? ws->quotes[i].weight : 1.0;
+        residuals[i] = sqrt(w) * (model[i] - ws->quotes[i].price);
+        cost += 0.5 * residuals[i] * residuals[i];
+    }
+
+    return cost;
+}
+
+/* Solve the symmetric positive definite system a*x = rhs by Cholesky; false if singular */
+static bool solve_spd(double a[HESTON_NUM_PARAMS][HESTON_NUM_PARAMS], const double* rhs, double* x) {
+    double l[HESTON_NUM_PARAMS][HESTON_NUM_PARAMS] = {{0.0}};
+    double y[HESTON_NUM_PARAMS];
+
+    for (int i = 0; i < HESTON_NUM_PARAMS; i++) {
+        for (int j = 0; j <= i; j++) {
+            double sum = a[i][j];
+            for (int k = 0; k < j; k++) {
+                sum -= l[i][k] * l[j][k];
+            }
+
+            if (i == j) {
+                if (sum <= 0.0) {
+                    return false;
+                }
+                l[i][i] = sqrt(sum);
+            } else {
+                l[i][j] = sum / l[j][j];
+            }
+        }
+    }
+
+    for (int i = 0; i < HESTON_NUM_PARAMS; i++) {
+        double sum = rhs[i];
+        for (int k = 0; k < i; k++) {
+            sum -= l[i][k] * y[k];
+        }
+        y[i] = sum / l[i][i];
+    }
+
+    for (int i = HESTON_NUM_PARAMS - 1; i >= 0; i--) {
+        double sum = y[i];
+        for (int k = i + 1; k < HESTON_NUM_PARAMS; k++) {
+            sum -= l[k][i] * x[k];
+        }
+        x[i] = sum / l[i][i];
+    }
+
+    return true;
+}
+
+/* Starting point: ATM Black-Scholes variance with the usual default shape */
+static void default_initial_params(const HestonQuote* quotes, int n, HestonParams* p) {
+    double best_dist = DBL_MAX;
+    double variance = HESTON_DEFAULT_V0;
+
+    for (int i = 0; i < n; i++) {
+        double dist = fabs(log(quotes[i].K / quotes[i].S));
+        if (dist < best_dist) {
+            double iv = bs_implied_vol(quotes[i].price, quotes[i].S, quotes[i].K,
+                                       quotes[i].T, quotes[i].r, quotes[i].q);
+            if (iv > 0.0) {
+                best_dist = dist;
+                variance = iv * iv;
+            }
+        }
+    }
+
+    p->v0 = variance;
+    p->theta = variance;
+    p->kappa = HESTON_DEFAULT_KAPPA;
+    p->sigma = HESTON_DEFAULT_SIGMA;
+    p->rho = HESTON_DEFAULT_RHO;
+}
+
+static bool valid_quote(const HestonQuote* quote) {
+    return quote->S > 0.0 && quote->K > 0.0 && quote->T > 0.0 &&
+           quote->price > 0.0 && isfinite(quote->price);
+}
+
+static bool valid_options(const HestonCalibrationOptions* options) {
+    return options->fft_n >= 16 && (options->fft_n & (options->fft_n - 1)) == 0 &&
+           options->eta > 0.0 && options->alpha > 0.0 &&
+           options->max_iterations > 0 && options->lambda > 0.0;
+}
+
+/**
+ * @brief Fit one Heston parameter set to a set of call quotes
+ */
+int heston_calibrate(const HestonQuote* quotes, int n, const HestonParams* initial,
+                     const HestonCalibrationOptions* options, HestonCalibrationResult* result) {
+    HestonCalibrationOptions defaults;
+    CalibrationWorkspace ws;
+    int status;
+
+    if (quotes == NULL || n <= 0 || result == NULL) {
+        return ERROR_INVALID_PARAMETER;
+    }
+
+    if (options == NULL) {
+        heston_calibration_default_options(&defaults);
+        options = &defaults;
+    }
+
+    if (!valid_options(options)) {
+        return ERROR_INVALID_PARAMETER;
+    }
+
+    for (int i = 0; i < n; i++) {
+        if (!valid_quote(&quotes[i])) {
+            return ERROR_INVALID_PARAMETER;
+        }
+    }
+
+    memset(result, 0, sizeof(HestonCalibrationResult));
+
+    status = init_workspace(&ws, quotes, n, options);
+    if (status != ERROR_NONE) {
+        return status;
+    }
+
+    /* Current and trial model prices, residuals and Jacobians in one block */
+    double* buffers = (double*)malloc(4 * n * (HESTON_NUM_PARAMS + 1) * sizeof(double));
+    if (buffers == NULL) {
+        free_workspace(&ws);
+        return ERROR_MEMORY_ALLOCATION;
+    }
+
+    double* model = buffers;
+    double* residuals = model + n;
+    double* jac = residuals + n;
+    double* trial_model = jac + n * HESTON_NUM_PARAMS;
+    double* trial_residuals = trial_model + n;
+    double* trial_jac = trial_residuals + n;
+
+    HestonParams start;
+    double x[HESTON_NUM_PARAMS];
+
+    if (initial != NULL) {
+        start = *initial;
+    } else {
+        default_initial_params(quotes, n, &start);
+    }
+    params_to_vector(&start, x);
+    project_to_box(x);
+
+    if (!evaluate_model(&ws, x, model, jac)) {
+        free(buffers);
+        free_workspace(&ws);
+        return ERROR_CALCULATION_FAILED;
+    }
+    result->evaluations = 1;
+
+    double cost = residual_cost(&ws, model, residuals);
+    double lambda = options->lambda;
+
+    while (result->iterations < options->max_iterations && !result->converged) {
+        double jtj[HESTON_NUM_PARAMS][HESTON_NUM_PARAMS] = {{0.0}};
+        double jtr[HESTON_NUM_PARAMS] = {0.0};
+        double gradient_norm = 0.0;
+
+        for (int i = 0; i < n; i++) {
+            double w = (quotes[i].weight > 0.0) ? sqrt(quotes[i].weight) : 1.0;
+            const double* row = &jac[i * HESTON_NUM_PARAMS];
+
+            for (int a = 0; a < HESTON_NUM_PARAMS; a++) {
+                jtr[a] += w * row[a] * residuals[i];
+                for (int c = 0; c <= a; c++) {
+                    jtj[a][c] += w * w * row[a] * row[c];
+                }
+            }
+        }
+
+        for (int a = 0; a < HESTON_NUM_PARAMS; a++) {
+            for (int c = 0; c < a; c++) {
+                jtj[c][a] = jtj[a][c];
+            }
+            gradient_norm = fmax(gradient_norm, fabs(jtr[a]));
+        }
+
+        if (gradient_norm < 1e-14) {
+            result->converged = true;
+            break;
+        }
+
+        /* Raise the damping until a step lowers the cost */
+        bool accepted = false;
+        while (!accepted && lambda <= LAMBDA_MAX) {
+            double damped[HESTON_NUM_PARAMS][HESTON_NUM_PARAMS];
+            double rhs[HESTON_NUM_PARAMS];
+            double step[HESTON_NUM_PARAMS];
+            double trial[HESTON_NUM_PARAMS];
+
+            for (int a = 0; a < HESTON_NUM_PARAMS; a++) {
+                for (int c = 0; c < HESTON_NUM_PARAMS; c++) {
+                    damped[a][c] = jtj[a][c];
+                }
+                damped[a][a] += lambda * fmax(jtj[a][a], 1e-12);
+                rhs[a] = -jtr[a];
+            }
+
+            if (!solve_spd(damped, rhs, step)) {
+                lambda *= 4.0;
+                continue;
+            }
+
+            double step_norm = 0.0;
+            for (int a = 0; a < HESTON_NUM_PARAMS; a++) {
+                trial[a] = x[a] + step[a];
+            }
+            project_to_box(trial);
+            for (int a = 0; a < HESTON_NUM_PARAMS; a++) {
+                step_norm = fmax(step_norm, fabs(trial[a] - x[a]) / (fabs(x[a]) + 1e-8));
+            }
+
+            if (step_norm < 1e-12) {
+                /* The box blocks every descent direction */
+                result->converged = true;
+                break;
+            }
+
+            result->evaluations++;
+            if (!evaluate_model(&ws, trial, trial_model, trial_jac)) {
+                lambda *= 4.0;
+                continue;
+            }
+
+            double trial_cost = residual_cost(&ws, trial_model, trial_residuals);
+            if (trial_cost < cost) {
+                double reduction = (cost - trial_cost) / fmax(cost, DBL_MIN);
+
+                memcpy(x, trial, sizeof(x));
+                memcpy(model, trial_model, n * sizeof(double));
+                memcpy(residuals, trial_residuals, n * sizeof(double));
+                memcpy(jac, trial_jac, n * HESTON_NUM_PARAMS * sizeof(double));
+                cost = trial_cost;
+                lambda = fmax(lambda / 3.0, LAMBDA_MIN);
+                accepted = true;
+                result->iterations++;
+
+                if (reduction < options->tolerance) {
+                    result->converged = true;
+                }
+            } else {
+                lambda *= 4.0;
+            }
+        }
+
+        if (!accepted && !result->converged) {
+            /* No damping level improves the fit: a local minimum to working precision */
+            result->converged = true;
+        }
+    }
+
+    vector_to_params(x, &result->params);
+    result->rmse = sqrt(2.0 * cost / n);
+
+    free(buffers);
+    free_workspace(&ws);
+    return ERROR_NONE;
+}
+
+/**
+ * @brief Heston call prices for a set of quotes from one transform batch per expiry
+ */
+int heston_price_quotes(const HestonQuote* quotes, int n, const HestonParams* params,
+                        const HestonCalibrationOptions* options, double* prices) {
+    HestonCalibrationOptions defaults;
+    CalibrationWorkspace ws;
+    double x[HESTON_NUM_PARAMS];
+    int status;
+
+    if (quotes == NULL || n <= 0 || params == NULL || prices == NULL) {
+        return ERROR_INVALID_PARAMETER;
+    }
+
+    if (options == NULL) {
+        heston_calibration_default_options(&defaults);
+        options = &defaults;
+    }
+
+    if (!valid_options(options)) {
+        return ERROR_INVALID_PARAMETER;
+    }
+
+    for (int i = 0; i < n; i++) {
+        if (quotes[i].S <= 0.0 || quotes[i].K <= 0.0 || quotes[i].T <= 0.0) {
+            return ERROR_INVALID_PARAMETER;
+        }
+    }
+
+    status = init_workspace(&ws, quotes, n, options);
+    if (status != ERROR_NONE) {
+        return status;
+    }
+
+    params_to_vector(params, x);
+    status = evaluate_model(&ws, x, prices, NULL) ? ERROR_NONE : ERROR_CALCULATION_FAILED;
+
+    free_workspace(&ws);
+    return status;
+}
@@ -0,0 +1,504 @@
+/**
+ * @file heston_cf_simd.c
+ * @brief Vectorized Heston characteristic function over many integration nodes
+ *
+ * cf_heston() works on double complex values and calls cexp/clog/csqrt,
+ * which the compiler cannot vectorize. Here every complex operation is
+ * spelled out on (re, im) pairs, the transcendental functions are the Cephes
+ * polynomial approximations written without branches, and special cases are
+ * handled with selects. The per-node loops therefore contain only arithmetic,
+ * comparisons and bit operations, and vectorize under any SIMD target.
+ */
+
+#include <float.h>
+#include <math.h>
+
+#include "../include/heston_cf_simd.h"
+#include "../include/simd_math.h"
+
+#define CF_PI      3.14159265358979323846
+#define CF_PI_2    1.57079632679489661923
+#define CF_PI_4    0.78539816339744830962
+
+/* ---- Real transcendental functions (Cephes, branch-free) ---- */
+
+/* sin(x) and cos(x) together, the Cephes polynomials on [-pi/4, pi/4] */
+SIMD_INLINE void cf_sincos(double x, double* s, double* c) {
+    const double DP1 = 7.85398125648498535156E-1;
+    const double DP2 = 3.77489470793079817668E-8;
+    const double DP3 = 2.69515142907905952645E-15;
+
+    double ax = fabs(x);
+    double j = floor(ax * (4.0 / CF_PI));
+    j += j - 2.0 * floor(0.5 * j);            /* Round odd octants up */
+    double oct = 0.5 * j - 4.0 * floor(0.125 * j);  /* Quadrant 0..3 */
+
+    double z = ((ax - j * DP1) - j * DP2) - j * DP3;
+    double zz = z * z;
+    double ps = z + z * zz * (((((1.58962301576546568060E-10 * zz - 2.50507477628578072866E-8) * zz +
+                                 2.75573136213857245213E-6) * zz - 1.98412698295895385996E-4) * zz +
+                               8.33333333332211858878E-3) * zz - 1.66666666666666307295E-1);
+    double pc = 1.0 - 0.5 * zz + zz * zz * (((((-1.13585365213876817300E-11 * zz +
+                                                2.08757008419747316778E-9) * zz -
+                                               2.75573141792967388112E-7) * zz +
+                                              2.48015872888517045348E-5) * zz -
+                                             1.38888888888730564116E-3) * zz +
+                                            4.16666666666665929218E-2);
+
+    bool swap = (oct == 1.0) | (oct == 3.0);
+    double sv = swap ? pc : ps;
+    double cv = swap ? ps : pc;
+    sv = oct >= 2.0 ? -sv : sv;
+    cv = ((oct == 1.0) | (oct == 2.0)) ? -cv : cv;
+
+    *s = copysign(1.0, x) * sv;
+    *c = cv;
+}
+
+/* atan(t) for t in [0, 1], the Cephes rational approximation */
+SIMD_INLINE double cf_atan_unit(double t) {
+    const double MOREBITS = 6.123233995736765886130E-17;
+
+    bool mid = t > 0.66;
+    double reduced = (t - 1.0) / (t + 1.0);
+    double x = mid ? reduced : t;
+    double base = mid ? CF_PI_4 + 0.5 * MOREBITS : 0.0;
+
+    double z = x * x;
+    double p = (((-8.750608600031904122785E-1 * z - 1.615753718733365076637E1) * z -
+                 7.500855792314704667340E1) * z - 1.228866684490136173410E2) * z -
+               6.485021904942025371773E1;
+    double qd = ((((z + 2.485846490142306297962E1) * z + 1.650270098316988542046E2) * z +
+                  4.328810604912902668951E2) * z + 4.853903996359136964868E2) * z +
+                1.945506571482613964425E2;
+    return base + (x * (z * p / qd) + x);
+}
+
+/* atan2(y, x) on the principal branch */
+SIMD_INLINE double cf_atan2(double y, double x) {
+    double ax = fabs(x);
+    double ay = fabs(y);
+    double hi = ax > ay ? ax : ay;
+    double lo = ax > ay ? ay : ax;
+    double t = lo / (hi > DBL_MIN ? hi : DBL_MIN);
+
+    double a = cf_atan_unit(t);
+    double complement = CF_PI_2 - a;
+    a = ay > ax ? complement : a;
+    double reflected = CF_PI - a;
+    a = x < 0.0 ? reflected : a;
+    return copysign(a, y);
+}
+
+/* ---- Complex helpers on (re, im) pairs ---- */
+
+SIMD_INLINE void cx_div(double ar, double ai, double br, double bi, double* zr, double* zi) {
+    double inv = 1.0 / (br * br + bi * bi);
+    *zr = (ar * br + ai * bi) * inv;
+    *zi = (ai * br - ar * bi) * inv;
+}
+
+SIMD_INLINE void cx_exp(double ar, double ai, double* zr, double* zi) {
+    double m = simd_exp(ar);
+    double s, c;
+    cf_sincos(ai, &s, &c);
+    *zr = m * c;
+    *zi = m * s;
+}
+
+SIMD_INLINE void cx_log(double ar, double ai, double* zr, double* zi) {
+    *zr = 0.5 * simd_log(ar * ar + ai * ai);
+    *zi = cf_atan2(ai, ar);
+}
+
+/* Principal square root, as csqrt() */
+SIMD_INLINE void cx_sqrt(double ar, double ai, double* zr, double* zi) {
+    double mod = sqrt(fabs(ar * ar + ai * ai));
+    double t = sqrt(fabs(0.5 * (mod + fabs(ar))));
+    double other = 0.5 * fabs(ai) / (t > DBL_MIN ? t : DBL_MIN);
+    *zr = ar >= 0.0 ? t : other;
+    *zi = ar >= 0.0 ? copysign(other, ai) : copysign(t, ai);
+}
+
+SIMD_INLINE bool is_finite2(double a, double b) {
+    return (fabs(a) <= DBL_MAX) & (fabs(b) <= DBL_MAX);
+}
+
+/* Heston CF at phi with i*phi = (x, y); mirrors cf_heston() step by step.
+ * Also returns the v0 coefficient B of the exponent and whether the
+ * intermediates were finite. */
+SIMD_INLINE void cf_eval_parts(double x, double y, double log_S, double v0, double kappa,
+                               double theta, double sigma, double rho, double drift_T, double T,
+                               double* cr, double* ci, double* Bout_r, double* Bout_i, bool* ok_out) {
+    double rs = rho * sigma;
+    double s2 = sigma * sigma;
+
+    /* b = kappa - rho sigma i phi, d = sqrt(b^2 - sigma^2 i phi (i phi - 1)) */
+    double br = kappa - rs * x;
+    double bi = -rs * y;
+    double d2r = br * br - bi * bi - s2 * (x * x - x - y * y);
+    double d2i = 2.0 * br * bi - s2 * y * (2.0 * x - 1.0);
+    double dr, di;
+    cx_sqrt(d2r, d2i, &dr, &di);
+
+    double bmr = br - dr, bmi = bi - di;
+    double gr, gi;
+    cx_div(bmr, bmi, br + dr, bi + di, &gr, &gi);
+
+    double er, ei;
+    cx_exp(-dr * T, -di * T, &er, &ei);
+
+    /* 1 - g e and 1 - g */
+    double numr = 1.0 - (gr * er - gi * ei);
+    double numi = -(gr * ei + gi * er);
+    double qr, qi;
+    cx_div(numr, numi, 1.0 - gr, -gi, &qr, &qi);
+    double lr, li;
+    cx_log(qr, qi, &lr, &li);
+
+    double kts = kappa * theta / s2;
+    double Ar = drift_T * x + kts * (bmr * T - 2.0 * lr);
+    double Ai = drift_T * y + kts * (bmi * T - 2.0 * li);
+
+    /* B = (b - d)(1 - e) / (sigma^2 (1 - g e)) */
+    double tr = bmr * (1.0 - er) + bmi * ei;
+    double ti = bmi * (1.0 - er) - bmr * ei;
+    double Br, Bi;
+    cx_div(tr, ti, s2 * numr, s2 * numi, &Br, &Bi);
+
+    double zr, zi;
+    cx_exp(Ar + Br * v0 + x * log_S, Ai + Bi * v0 + y * log_S, &zr, &zi);
+
+    /* cf_heston() falls back to 1 for non-finite intermediates */
+    bool ok = is_finite2(gr, gi) & is_finite2(Ar, Ai) & is_finite2(Br, Bi);
+    *cr = ok ? zr : 1.0;
+    *ci = ok ? zi : 0.0;
+    *Bout_r = Br;
+    *Bout_i = Bi;
+    *ok_out = ok;
+}
+
+SIMD_INLINE void cf_eval(double x, double y, double log_S, double v0, double kappa,
+                         double theta, double sigma, double rho, double drift_T, double T,
+                         double* cr, double* ci) {
+    double Br, Bi;
+    bool ok;
+    cf_eval_parts(x, y, log_S, v0, kappa, theta, sigma, rho, drift_T, T, cr, ci, &Br, &Bi, &ok);
+}
+
+/* Multiply by (fr, fi), weight and phase shift one Carr-Madan term; 0 if not finite */
+SIMD_INLINE int store_term(double mr, double mi, double fr, double fi, double w,
+                           double shr, double shi, double* out_re, double* out_im) {
+    double pr = (mr * fr - mi * fi) * w;
+    double pi = (mr * fi + mi * fr) * w;
+    bool ok = is_finite2(pr, pi);
+    pr = ok ? pr : 0.0;
+    pi = ok ? pi : 0.0;
+    *out_re = pr * shr - pi * shi;
+    *out_im = pr * shi + pi * shr;
+    return ok ? 0 : 1;
+}
+
+SIMD_CLONES
+void heston_cf_batch(int n, const double* u_re, const double* u_im, double S,
+                     const HestonParams* params, double r, double q, double T,
+                     double* cf_re, double* cf_im) {
+    const double log_S = log(S);
+    const double drift_T = (r - q) * T;
+    const double v0 = params->v0, kappa = params->kappa, theta = params->theta;
+    const double sigma = params->sigma, rho = params->rho;
+
+    for (int i = 0; i < n; i++) {
+        /* i phi = -Im(phi) + i Re(phi) */
+        cf_eval(-u_im[i], u_re[i], log_S, v0, kappa, theta, sigma, rho, drift_T, T,
+                &cf_re[i], &cf_im[i]);
+    }
+}
+
+SIMD_CLONES
+int heston_cf_carr_madan_fill(int n, double alpha, const double* v, const double* weight,
+                              const double* shift_re, const double* shift_im, double S,
+                              const HestonParams* params, double r, double q, double T,
+                              double* out_re, double* out_im) {
+    const double log_S = log(S);
+    const double drift_T = (r - q) * T;
+    const double discount = exp(-r * T);
+    const double v0 = params->v0, kappa = params->kappa, theta = params->theta;
+    const double sigma = params->sigma, rho = params->rho;
+    const double a1 = alpha + 1.0;
+    const double denom_re0 = alpha * alpha + alpha;
+    const double denom_im1 = 2.0 * alpha + 1.0;
+    int zeroed = 0;
+
+    for (int i = 0; i < n; i++) {
+        const double vi = v[i];
+
+        /* phi = v - (alpha + 1) i, so i phi = (alpha + 1) + i v */
+        double cr, ci;
+        cf_eval(a1, vi, log_S, v0, kappa, theta, sigma, rho, drift_T, T, &cr, &ci);
+
+        double mr, mi;
+        cx_div(discount * cr, discount * ci, denom_re0 - vi * vi, denom_im1 * vi, &mr, &mi);
+
+        bool ok = is_finite2(mr, mi);
+        zeroed += ok ? 0 : 1;
+        mr = ok ? mr : 0.0;
+        mi = ok ? mi : 0.0;
+        mr *= weight[i];
+        mi *= weight[i];
+
+        out_re[i] = mr * shift_re[i] - mi * shift_im[i];
+        out_im[i] = mr * shift_im[i] + mi * shift_re[i];
+    }
+
+    return zeroed;
+}
+
+SIMD_CLONES
+int heston_cf_carr_madan_sensitivity_fill(int n, double alpha, const double* v, const double* weight,
+                                          const double* shift_re, const double* shift_im, double S,
+                                          const HestonParams* params, double r, double q, double T,
+                                          double* out_re, double* out_im) {
+    const double log_S = log(S);
+    const double drift_T = (r - q) * T;
+    const double discount = exp(-r * T);
+    const double v0 = params->v0, kappa = params->kappa, theta = params->theta;
+    const double sigma = params->sigma, rho = params->rho;
+    const double a1 = alpha + 1.0;
+    const double denom_re0 = alpha * alpha + alpha;
+    const double denom_im1 = 2.0 * alpha + 1.0;
+    const double half_s2 = 0.5 * sigma * sigma;
+    const double kt = kappa * theta;
+    int zeroed = 0;
+
+    for (int i = 0; i < n; i++) {
+        const double vi = v[i];
+
+        /* z = i phi = (alpha + 1) + i v, as in the price fill */
+        double cr, ci, Br, Bi;
+        bool ok;
+        cf_eval_parts(a1, vi, log_S, v0, kappa, theta, sigma, rho, drift_T, T,
+                      &cr, &ci, &Br, &Bi, &ok);
+
+        double mr, mi;
+        cx_div(discount * cr, discount * ci, denom_re0 - vi * vi, denom_im1 * vi, &mr, &mi);
+        mr = ok ? mr : 0.0;
+        mi = ok ? mi : 0.0;
+
+        /* z^2 */
+        double z2r = a1 * a1 - vi * vi;
+        double z2i = 2.0 * a1 * vi;
+
+        /* d ln(integrand) / dT = -r + (r - q) z + kappa theta B + v0 dB/dT with the
+         * Riccati equation dB/dT = sigma^2 B^2 / 2 - (kappa - rho sigma z) B + z (z - 1) / 2 */
+        double bbr = kappa - rho * sigma * a1;
+        double bbi = -rho * sigma * vi;
+        double B2r = Br * Br - Bi * Bi;
+        double B2i = 2.0 * Br * Bi;
+        double dBr = half_s2 * B2r - (bbr * Br - bbi * Bi) + 0.5 * (z2r - a1);
+        double dBi = half_s2 * B2i - (bbr * Bi + bbi * Br) + 0.5 * (z2i - vi);
+        double tr = -r + (r - q) * a1 + kt * Br + v0 * dBr;
+        double ti = (r - q) * vi + kt * Bi + v0 * dBi;
+
+        /* Node i's four values sit together, in FFTGridSensitivity order */
+        const double w = weight[i], shr = shift_re[i], shi = shift_im[i];
+        const size_t at = (size_t)FFT_GRID_SENSITIVITIES * i;
+        zeroed += store_term(mr, mi, a1, vi, w, shr, shi,
+                             &out_re[at + FFT_GRID_DX], &out_im[at + FFT_GRID_DX]);
+        zeroed += store_term(mr, mi, z2r, z2i, w, shr, shi,
+                             &out_re[at + FFT_GRID_DXX], &out_im[at + FFT_GRID_DXX]);
+        zeroed += store_term(mr, mi, Br, Bi, w, shr, shi,
+                             &out_re[at + FFT_GRID_DV0], &out_im[at + FFT_GRID_DV0]);
+        zeroed += store_term(mr, mi, tr, ti, w, shr, shi,
+                             &out_re[at + FFT_GRID_DT], &out_im[at + FFT_GRID_DT]);
+    }
+
+    return zeroed;
+}
+
+/* ---- Single precision ---- */
+
+SIMD_INLINE void cf_sincosf(float x, float* s, float* c) {
+    const float DP1 = 0.78515625f;
+    const float DP2 = 2.4187564849853515625e-4f;
+    const float DP3 = 3.77489497744594108e-8f;
+
+    float ax = fabsf(x);
+    float j = floorf(ax * (float)(4.0 / CF_PI));
+    j += j - 2.0f * floorf(0.5f * j);
+    float oct = 0.5f * j - 4.0f * floorf(0.125f * j);
+
+    float z = ((ax - j * DP1) - j * DP2) - j * DP3;
+    float zz = z * z;
+    float ps = z + z * zz * ((-1.9515295891E-4f * zz + 8.3321608736E-3f) * zz - 1.6666654611E-1f);
+    float pc = 1.0f - 0.5f * zz + zz * zz * ((2.443315711809948E-5f * zz - 1.388731625493765E-3f) * zz +
+                                             4.166664568298827E-2f);
+
+    bool swap = (oct == 1.0f) | (oct == 3.0f);
+    float sv = swap ? pc : ps;
+    float cv = swap ? ps : pc;
+    sv = oct >= 2.0f ? -sv : sv;
+    cv = ((oct == 1.0f) | (oct == 2.0f)) ? -cv : cv;
+
+    *s = copysignf(1.0f, x) * sv;
+    *c = cv;
+}
+
+SIMD_INLINE float cf_atan_unitf(float t) {
+    bool mid = t > 0.414213562373095f;
+    float reduced = (t - 1.0f) / (t + 1.0f);
+    float x = mid ? reduced : t;
+    float base = mid ? (float)CF_PI_4 : 0.0f;
+
+    float z = x * x;
+    return base + ((((8.05374449538E-2f * z - 1.38776856032E-1f) * z + 1.99777106478E-1f) * z -
+                    3.33329491539E-1f) * z * x + x);
+}
+
+SIMD_INLINE float cf_atan2f(float y, float x) {
+    float ax = fabsf(x);
+    float ay = fabsf(y);
+    float hi = ax > ay ? ax : ay;
+    float lo = ax > ay ? ay : ax;
+    float t = lo / (hi > FLT_MIN ? hi : FLT_MIN);
+
+    float a = cf_atan_unitf(t);
+    float complement = (float)CF_PI_2 - a;
+    a = ay > ax ? complement : a;
+    float reflected = (float)CF_PI - a;
+    a = x < 0.0f ? reflected : a;
+    return copysignf(a, y);
+}
+
+SIMD_INLINE void cx_divf(float ar, float ai, float br, float bi, float* zr, float* zi) {
+    float inv = 1.0f / (br * br + bi * bi);
+    *zr = (ar * br + ai * bi) * inv;
+    *zi = (ai * br - ar * bi) * inv;
+}
+
+SIMD_INLINE void cx_expf(float ar, float ai, float* zr, float* zi) {
+    float m = simd_expf(ar);
+    float s, c;
+    cf_sincosf(ai, &s, &c);
+    *zr = m * c;
+    *zi = m * s;
+}
+
+SIMD_INLINE void cx_logf(float ar, float ai, float* zr, float* zi) {
+    *zr = 0.5f * simd_logf(ar * ar + ai * ai);
+    *zi = cf_atan2f(ai, ar);
+}
+
+SIMD_INLINE void cx_sqrtf(float ar, float ai, float* zr, float* zi) {
+    float mod = sqrtf(fabsf(ar * ar + ai * ai));
+    float t = sqrtf(fabsf(0.5f * (mod + fabsf(ar))));
+    float other = 0.5f * fabsf(ai) / (t > FLT_MIN ? t : FLT_MIN);
+    *zr = ar >= 0.0f ? t : other;
+    *zi = ar >= 0.0f ? copysignf(other, ai) : copysignf(t, ai);
+}
+
+SIMD_INLINE bool is_finite2f(float a, float b) {
+    return (fabsf(a) <= FLT_MAX) & (fabsf(b) <= FLT_MAX);
+}
+
+/* cf_eval() in single precision for a unit spot: the log-spot terms are
+ * left to the caller */
+SIMD_INLINE void cf_evalf(float x, float y, float v0, float kappa, float theta, float sigma,
+                          float rho, float drift_T, float T, float* cr, float* ci) {
+    float rs = rho * sigma;
+    float s2 = sigma * sigma;
+
+    float br = kappa - rs * x;
+    float bi = -rs * y;
+    float d2r = br * br - bi * bi - s2 * (x * x - x - y * y);
+    float d2i = 2.0f * br * bi - s2 * y * (2.0f * x - 1.0f);
+    float dr, di;
+    cx_sqrtf(d2r, d2i, &dr, &di);
+
+    float bmr = br - dr, bmi = bi - di;
+    float gr, gi;
+    cx_divf(bmr, bmi, br + dr, bi + di, &gr, &gi);
+
+    float er, ei;
+    cx_expf(-dr * T, -di * T, &er, &ei);
+
+    float numr = 1.0f - (gr * er - gi * ei);
+    float numi = -(gr * ei + gi * er);
+    float qr, qi;
+    cx_divf(numr, numi, 1.0f - gr, -gi, &qr, &qi);
+    float lr, li;
+    cx_logf(qr, qi, &lr, &li);
+
+    float kts = kappa * theta / s2;
+    float Ar = drift_T * x + kts * (bmr * T - 2.0f * lr);
+    float Ai = drift_T * y + kts * (bmi * T - 2.0f * li);
+
+    float tr = bmr * (1.0f - er) + bmi * ei;
+    float ti = bmi * (1.0f - er) - bmr * ei;
+    float Br, Bi;
+    cx_divf(tr, ti, s2 * numr, s2 * numi, &Br, &Bi);
+
+    float zr, zi;
+    cx_expf(Ar + Br * v0, Ai + Bi * v0, &zr, &zi);
+
+    bool ok = is_finite2f(gr, gi) & is_finite2f(Ar, Ai) & is_finite2f(Br, Bi);
+    *cr = ok ? zr : 1.0f;
+    *ci = ok ? zi : 0.0f;
+}
+
+SIMD_CLONES
+int heston_cf_carr_madan_fill_f(int n, double alpha, const float* v, const float* weight,
+                                const float* shift_re, const float* shift_im, double S,
+                                const HestonParams* params, double r, double q, double T,
+                                float* out_re, float* out_im) {
+    /* The spot enters as the real factor S^(alpha + 1) of exp(i phi log S);
+     * the scalar constants are rounded from double once */
+    const float scale = (float)exp((alpha + 1.0) * log(S) - r * T);
+    const float drift_T = (float)((r - q) * T);
+    const float v0 = (float)params->v0, kappa = (float)params->kappa;
+    const float theta = (float)params->theta, sigma = (float)params->sigma;
+    const float rho = (float)params->rho, Tf = (float)T;
+    const float a1 = (float)(alpha + 1.0);
+    const float denom_re0 = (float)(alpha * alpha + alpha);
+    const float denom_im1 = (float)(2.0 * alpha + 1.0);
+    int zeroed = 0;
+
+    for (int i = 0; i < n; i++) {
+        const float vi = v[i];
+
+        float cr, ci;
+        cf_evalf(a1, vi, v0, kappa, theta, sigma, rho, drift_T, Tf, &cr, &ci);
+
+        float mr, mi;
+        cx_divf(scale * cr, scale * ci, denom_re0 - vi * vi, denom_im1 * vi, &mr, &mi);
+
+        bool ok = is_finite2f(mr, mi);
+        zeroed += ok ? 0 : 1;
+        mr = ok ? mr : 0.0f;
+        mi = ok ? mi : 0.0f;
+        mr *= weight[i];
+        mi *= weight[i];
+
+        out_re[i] = mr * shift_re[i] - mi * shift_im[i];
+        out_im[i] = mr * shift_im[i] + mi * shift_re[i];
+    }
+
+    return zeroed;
+}
+
+const char* heston_cf_kernel_isa(void) {
+#if SIMD_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return "avx512f";
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return "avx2";
+    }
+#elif defined(__AVX512F__)
+    return "avx512f";
+#elif defined(__AVX2__)
+    return "avx2";
+#endif
+    return "scalar";
+}
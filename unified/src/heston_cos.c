@@ -0,0 +1,265 @@
+/**
+ * @file heston_cos.c
+ * @brief Fang-Oosterlee COS pricing engine for the Heston model
+ *
+ * With z = ln(S_T / S) truncated to [a, b] and u_k = k pi / (b - a), a put
+ * with x = ln(S / K) is
+ *
+ *     P = exp(-rT) sum'_k Re[phi(u_k) exp(-i u_k a)] V_k
+ *     V_k = 2 / (b - a) * (K psi_k(a, e) - S chi_k(a, e)),  e = min(-x, b)
+ *
+ * where phi is the characteristic function of z, sum' halves the k = 0
+ * term, and chi_k, psi_k are the cosine integrals of exp(z) and 1 over
+ * [a, e]. The first factor depends only on (T, r, q, params), so a chain
+ * costs one batch of characteristic function values plus O(terms) per strike.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "../include/heston_cos.h"
+#include "../include/heston_cf_simd.h"
+#include "../include/error_handling.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/* Bounds of the sqrt(v0) search in heston_cos_price_option() */
+#define COS_IV_MIN 1e-3
+#define COS_IV_MAX 5.0
+#define COS_IV_TOL 1e-8
+#define COS_IV_MAX_ITERATIONS 100
+
+/*
+ * First two cumulants of ln(S_T / S) under Heston (Fang & Oosterlee 2008,
+ * Table 11). Returns false if the variance is not usable.
+ */
+static bool heston_cumulants(double T, double r, double q, const HestonParams* p,
+                             double* c1, double* c2) {
+    const double v0 = p->v0, kappa = p->kappa, theta = p->theta;
+    const double sigma = p->sigma, rho = p->rho;
+    const double e1 = exp(-kappa * T);
+    const double e2 = e1 * e1;
+
+    *c1 = (r - q) * T + (1.0 - e1) * (theta - v0) / (2.0 * kappa) - 0.5 * theta * T;
+
+    *c2 = (sigma * T * kappa * e1 * (v0 - theta) * (8.0 * kappa * rho - 4.0 * sigma) +
+           kappa * rho * sigma * (1.0 - e1) * (16.0 * theta - 8.0 * v0) +
+           2.0 * theta * kappa * T * (-4.0 * kappa * rho * sigma + sigma * sigma + 4.0 * kappa * kappa) +
+           sigma * sigma * ((theta - 2.0 * v0) * e2 + theta * (6.0 * e1 - 7.0) + 2.0 * v0) +
+           8.0 * kappa * kappa * (v0 - theta) * (1.0 - e1)) /
+          (8.0 * kappa * kappa * kappa);
+
+    /* Cancellation for tiny kappa*T can leave c2 meaningless; fall back to
+     * the integrated variance of the mean variance path */
+    if (!isfinite(*c2) || *c2 <= 0.0) {
+        *c2 = fmax(v0, theta) * T;
+    }
+
+    return isfinite(*c1) && isfinite(*c2) && *c2 > 0.0;
+}
+
+int heston_cos_price_chain(double S, double T, double r, double q, const HestonParams* params,
+                           const double* strikes, int n, OptionType option_type, int terms,
+                           double* prices) {
+    if (S <= 0.0 || T <= 0.0 || params == NULL || strikes == NULL || prices == NULL || n < 0 ||
+        params->kappa <= 0.0 || params->sigma <= 0.0 || params->v0 < 0.0 || params->theta < 0.0 ||
+        (option_type != OPTION_CALL && option_type != OPTION_PUT)) {
+        return ERROR_INVALID_PARAMETER;
+    }
+
+    if (terms == 0) {
+        terms = HESTON_COS_DEFAULT_TERMS;
+    }
+    if (terms < 2 || terms > HESTON_COS_MAX_TERMS) {
+        return ERROR_INVALID_PARAMETER;
+    }
+
+    double c1, c2;
+    if (!heston_cumulants(T, r, q, params, &c1, &c2)) {
+        return ERROR_CALCULATION_FAILED;
+    }
+
+    const double a = c1 - HESTON_COS_TRUNCATION * sqrt(c2);
+    const double b = c1 + HESTON_COS_TRUNCATION * sqrt(c2);
+    const double width = b - a;
+
+    /* u, then Re/Im of phi(u), then the strike-independent series factor */
+    double* work = (double*)malloc(5 * (size_t)terms * sizeof(double));
+    if (work == NULL) {
+        return ERROR_MEMORY_ALLOCATION;
+    }
+    double* u = work;
+    double* zero = work + terms;
+    double* phi_re = work + 2 * (size_t)terms;
+    double* phi_im = work + 3 * (size_t)terms;
+    double* factor = work + 4 * (size_t)terms;
+
+    for (int k = 0; k < terms; k++) {
+        u[k] = k * M_PI / width;
+        zero[k] = 0.0;
+    }
+
+    /* The characteristic function of ln(S_T / S) is cf_heston() at S = 1 */
+    heston_cf_batch(terms, u, zero, 1.0, params, r, q, T, phi_re, phi_im);
+
+    for (int k = 0; k < terms; k++) {
+        /* Re[phi(u) exp(-i u a)] */
+        double c = cos(u[k] * a);
+        double s = sin(u[k] * a);
+        factor[k] = phi_re[k] * c + phi_im[k] * s;
+        if (!isfinite(factor[k])) {
+            free(work);
+            return ERROR_CALCULATION_FAILED;
+        }
+    }
+    factor[0] *= 0.5;
+
+    const double discount = exp(-r * T);
+    const double forward_discount = S * exp(-q * T);
+    const double scale = 2.0 / width;
+    const double exp_a = exp(a);
+
+    for (int j = 0; j < n; j++) {
+        const double K = strikes[j];
+        if (!(K > 0.0)) {
+            free(work);
+            return ERROR_INVALID_PARAMETER;
+        }
+
+        /* The put pays off for z < -x */
+        const double e = fmin(-log(S / K), b);
+        double put = 0.0;
+
+        if (e > a) {
+            const double exp_e = exp(e);
+            const double step = M_PI * (e - a) / width;
+            const double cos_step = cos(step);
+            const double sin_step = sin(step);
+
+            /* cos(k step) and sin(k step) by rotation */
+            double ck = 1.0;
+            double sk = 0.0;
+            double sum = factor[0] * scale * (K * (e - a) - S * (exp_e - exp_a));
+
+            for (int k = 1; k < terms; k++) {
+                double next_c = ck * cos_step - sk * sin_step;
+                sk = sk * cos_step + ck * sin_step;
+                ck = next_c;
+
+                double uk = u[k];
+                double chi = (ck * exp_e - exp_a + uk * sk * exp_e) / (1.0 + uk * uk);
+                double psi = sk / uk;
+                sum += factor[k] * scale * (K * psi - S * chi);
+            }
+
+            put = discount * sum;
+        }
+
+        double price = (option_type == OPTION_PUT) ? put : put + forward_discount - K * discount;
+        prices[j] = fmax(0.0, price);
+    }
+
+    free(work);
+    return ERROR_NONE;
+}
+
+double heston_call_cos(double S, double K, double T, double r, double q, const HestonParams* params) {
+    double price;
+
+    if (heston_cos_price_chain(S, T, r, q, params, &K, 1, OPTION_CALL, 0, &price) != ERROR_NONE) {
+        return -1.0;
+    }
+
+    return price;
+}
+
+/* Default adapter parameters for an initial volatility */
+static void default_params_for_vol(double vol, HestonParams* p) {
+    p->v0 = vol * vol;
+    p->kappa = HESTON_DEFAULT_KAPPA;
+    p->theta = p->v0;
+    p->sigma = HESTON_DEFAULT_SIGMA;
+    p->rho = HESTON_DEFAULT_RHO;
+}
+
+int heston_cos_price_option(double S, double K, double T, double r, double q,
+                            const HestonParams* params, OptionType option_type,
+                            double market_price, PricingResult* result) {
+    if (result == NULL) {
+        return ERROR_INVALID_PARAMETER;
+    }
+
+    memset(result, 0, sizeof(PricingResult));
+
+    if (S <= 0.0 || K <= 0.0 || T <= 0.0 ||
+        (option_type != OPTION_CALL && option_type != OPTION_PUT)) {
+        result->error_code = ERROR_INVALID_PARAMETER;
+        return result->error_code;
+    }
+
+    if (market_price > 0) {
+        /* Bisection on sqrt(v0): the price increases with the variance level */
+        HestonParams p;
+        double lo = COS_IV_MIN;
+        double hi = COS_IV_MAX;
+        double price_lo, price_hi;
+
+        default_params_for_vol(lo, &p);
+        int status = heston_cos_price_chain(S, T, r, q, &p, &K, 1, option_type, 0, &price_lo);
+        default_params_for_vol(hi, &p);
+        if (status == ERROR_NONE) {
+            status = heston_cos_price_chain(S, T, r, q, &p, &K, 1, option_type, 0, &price_hi);
+        }
+
+        if (status != ERROR_NONE || market_price < price_lo || market_price > price_hi) {
+            result->error_code = ERROR_VOLATILITY_CALCULATION;
+            return result->error_code;
+        }
+
+        for (int i = 0; i < COS_IV_MAX_ITERATIONS && hi - lo > COS_IV_TOL; i++) {
+            double mid = 0.5 * (lo + hi);
+            double price_mid;
+
+            default_params_for_vol(mid, &p);
+            if (heston_cos_price_chain(S, T, r, q, &p, &K, 1, option_type, 0, &price_mid) != ERROR_NONE) {
+                result->error_code = ERROR_VOLATILITY_CALCULATION;
+                return result->error_code;
+            }
+
+            if (price_mid < market_price) {
+                lo = mid;
+            } else {
+                hi = mid;
+            }
+        }
+
+        result->implied_volatility = 0.5 * (lo + hi);
+        result->price = market_price;
+    } else {
+        /* Option pricing with known Heston parameters */
+        HestonParams p;
+
+        if (params != NULL) {
+            p = *params;
+        } else {
+            default_params_for_vol(sqrt(HESTON_DEFAULT_V0), &p);
+        }
+
+        double price;
+        if (heston_cos_price_chain(S, T, r, q, &p, &K, 1, option_type, 0, &price) != ERROR_NONE ||
+            !isfinite(price)) {
+            result->error_code = ERROR_CALCULATION_FAILED;
+            return result->error_code;
+        }
+
+        result->price = price;
+        result->implied_volatility = sqrt(p.v0);
+    }
+
+    result->error_code = ERROR_NONE;
+    return ERROR_NONE;
+}
@@ -0,0 +1,3180 @@
+#define _POSIX_C_SOURCE 200112L
+
+/**
+ * @file heston_fft.c
+ * @brief Heston FFT pricing engine (Carr-Madan) extracted from calculate_sv_v6
+ *
+ * Heston model parameters:
+ * S: spot price
+ * K: strike price
+ * v0: initial variance
+ * kappa: mean reversion speed
+ * theta: long-term variance
+ * sigma: volatility of variance
+ * rho: correlation between stock and variance processes
+ * r: risk-free rate
+ * q: dividend yield
+ * T: time to maturity
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <complex.h>
+#include <string.h>
+#include <float.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+// FFT implementation requires fftw library
+#include <fftw3.h>
+
+#include "../include/heston_fft.h"
+#include "../include/heston_cf_simd.h"
+#include "../include/heston_gpu.h"
+#include "../include/fft_cache.h"
+#include "../include/fft_tuning.h"
+#include "../include/grid_share.h"
+#include "../include/black_scholes_batch.h"
+#include "../include/error_handling.h"
+#include "../include/perf_stats.h"
+
+// Define M_PI if it's not already defined
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// Global flags
+static bool g_debug = false;
+static bool g_verbose_debug = false;
+static bool g_use_bs_fallback = true;  // Added flag to control BS fallback
+
+// Default FFT settings (can be overridden via heston_fft_set_config)
+static double g_cache_tolerance = 1e-5; // Tolerance for cache validation
+static int g_max_calibration_attempts = 3; // Max number of calibration attempts before fallback
+static size_t g_cache_max_bytes = FFT_CACHE_DEFAULT_MAX_BYTES; // Grid cache limit of the default context
+static int g_threads = 1;           // Worker threads for the calibration sweeps
+static double g_warm_start_max_error = HESTON_WARM_START_MAX_ERROR; // Acceptable warm start fit
+static bool g_spot_invariant = false; // Build grids for a unit spot and rescale them to every spot
+#ifndef HESTON_NO_MIXED_PRECISION
+static bool g_mixed_precision = true; // Screen calibration candidates in single precision
+#endif
+static FFTTuningTable* g_tuning = NULL; // FFT settings tuned offline, NULL to adapt at run time
+static GridShare* g_grid_share = NULL; // Shared segment grids are published to or read from
+static int g_gpu_enabled = 0;       // GPU backend selected and usable; cleared on failure (atomic)
+static bool g_gpu_verify = true;    // Check a grid of every GPU batch against the CPU
+
+// Grow-only aligned scratch memory owned by a context. Reserving more than
+// the capacity replaces the block and loses its contents; reserving less
+// keeps it, so once a context has seen its largest FFT size it prices
+// without touching the heap.
+typedef struct {
+    void* data;
+    size_t bytes;
+} FFTWorkspace;
+
+// Precomputed values for FFT optimization, stored as separate arrays so the
+// CF kernel can stream them
+typedef struct {
+    // Backs all arrays below up to work_im
+    FFTWorkspace workspace;
+    // Integration nodes v_i = i * eta (v_0 nudged off zero)
+    double* nodes;
+    // Simpson's rule weights times eta
+    double* weights;
+    // Precomputed exponential terms in FFT input, real and imaginary parts
+    double* exp_re;
+    double* exp_im;
+    // Kernel output, interleaved into the FFTW buffer afterwards
+    double* work_re;
+    double* work_im;
+    // Sensitivity kernel output (FFT_GRID_SENSITIVITIES values per node),
+    // reserved on first use
+    FFTWorkspace sens_workspace;
+    double* sens_re;
+    double* sens_im;
+    // Flag to indicate if precomputed values are valid
+    bool is_valid;
+    // Parameters for which values were precomputed
+    int fft_n;
+    double eta;
+    double alpha;
+    double S;
+} FFTPrecomputed;
+
+// Persistent FFTW plans, one per distinct transform size and planner mode.
+// Plans are bound to their own buffers and live as long as their context.
+#define MAX_FFT_PLANS 8
+
+typedef struct {
+    int n;               // Transform size
+    int howmany;         // Interleaved transforms per execution (1 for prices)
+    unsigned flags;      // FFTW planner flags used to create the plan
+    fftw_complex* in;    // Input buffer the plan was created for
+    fftw_complex* out;   // Output buffer the plan was created for
+    fftw_plan plan;      // Forward transform
+} FFTPlanSlot;
+
+#ifndef HESTON_NO_MIXED_PRECISION
+// Single-precision screening grid of a context: float copies of the
+// precomputed terms, one fftwf plan (always FFTW_ESTIMATE, so it needs no
+// wisdom) and a grid that never enters the cache
+typedef struct {
+    // Backs nodes .. work_im
+    FFTWorkspace workspace;
+    float* nodes;
+    float* weights;
+    // exp(-i v k0) times the spot phase exp(i v log S), see heston_cf_carr_madan_fill_f()
+    float* shift_re;
+    float* shift_im;
+    float* work_re;
+    float* work_im;
+    // The float terms match the double precomputed ones
+    bool is_valid;
+    int plan_n;
+    fftwf_complex* in;
+    fftwf_complex* out;
+    fftwf_plan plan;
+    // Backs the price, strike and slope arrays of grid
+    FFTWorkspace grid_workspace;
+    FFTGrid grid;
+    double scale;               // Spot divided by the spot grid was built for
+    double error_scale;         // Error bound of the grid at unit strike (grows as K^-alpha)
+} FFTScreen;
+#endif
+
+// Serializes the FFTW planner, the only part of FFTW that is not thread-safe
+static pthread_mutex_t g_planner_lock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned g_planner_flags = FFTW_ESTIMATE;
+static HestonFFTPlanner g_planner = HESTON_FFTW_ESTIMATE;
+
+// Outcome of a grid build. Failures are returned by the build and kept in the
+// context until a caller takes them, so a search can run to the end and the
+// caller decides once whether the retry ladders are needed.
+typedef enum {
+    FFT_STATUS_OK = 0,
+    FFT_STATUS_NO_MEMORY,       // Cache, grid or workspace allocation failed
+    FFT_STATUS_NO_PLAN,         // No FFTW plan for the transform size
+    FFT_STATUS_NON_FINITE       // Non-finite input terms, nodes or prices
+} FFTStatus;
+
+// Everything one thread mutates while pricing: the adaptive FFT grid settings,
+// the keyed LRU cache of price grids, the precomputed FFT input terms and the
+// plan table. The global API works on g_default_ctx; calibration workers get
+// a context of their own and share nothing mutable.
+struct HestonFFTContext {
+    int fft_n;                  // Number of FFT points (power of 2)
+    double log_strike_range;    // Range of log-strikes (±range from current)
+    double alpha;               // Carr-Madan dampening factor
+    double eta;                 // Step size in log-strike space
+    FFTGridCache* grid_cache;   // Cached price grids, created on first use
+    FFTGrid* current_grid;      // Grid the last init produced, read by the price lookup
+    double grid_scale;          // Spot divided by the spot current_grid was built for
+    FFTStatus status;           // First failure not yet taken by a caller
+    size_t cache_max_bytes;     // Memory limit for grid_cache
+    FFTPrecomputed precomputed;
+    FFTPlanSlot plans[MAX_FFT_PLANS];
+    int num_plans;
+    int next_plan_victim;
+    FFTWorkspace scratch;       // Per-option arrays of the chain calibration
+    FFTWorkspace gpu_batch;     // Grid list and transform outputs of a GPU batch
+#ifndef HESTON_NO_MIXED_PRECISION
+    FFTScreen screen;           // Single-precision grid of the calibration screen
+#endif
+};
+
+static HestonFFTContext g_default_ctx = {
+    .fft_n = 4096,
+    .log_strike_range = 3.0,
+    .alpha = 1.5,
+    .eta = 0.1,
+    .cache_max_bytes = FFT_CACHE_DEFAULT_MAX_BYTES
+};
+
+// Contexts of the calibration sweep workers, created by the first parallel
+// sweep and reused by the later ones so their plans, workspaces and grids
+// survive between sweeps. Sweeps of the default context run one at a time,
+// like everything else on it.
+static HestonFFTContext* g_sweep_contexts[HESTON_FFT_MAX_THREADS];
+
+static const char* fft_status_string(FFTStatus status) {
+    switch (status) {
+        case FFT_STATUS_OK:         return "ok";
+        case FFT_STATUS_NO_MEMORY:  return "memory allocation failure";
+        case FFT_STATUS_NO_PLAN:    return "FFT plan failure";
+        case FFT_STATUS_NON_FINITE: return "non-finite FFT values";
+    }
+    return "unknown FFT failure";
+}
+
+// Keep the first failure until a caller takes it
+static void ctx_fail(HestonFFTContext* ctx, FFTStatus status) {
+    if (ctx->status == FFT_STATUS_OK) {
+        ctx->status = status;
+    }
+}
+
+// Failure recorded since the last call, cleared
+static FFTStatus ctx_take_status(HestonFFTContext* ctx) {
+    FFTStatus status = ctx->status;
+    ctx->status = FFT_STATUS_OK;
+    return status;
+}
+
+// Complex characteristic function for Heston model
+double complex cf_heston(double complex phi, double S, double v0, double kappa, 
+                         double theta, double sigma, double rho, double r, 
+                         double q, double T) {
+    double complex d = csqrt((rho * sigma * phi * I - kappa) * 
+                    (rho * sigma * phi * I - kappa) - 
+                    sigma * sigma * (phi * I) * (phi * I - 1.0));
+    double complex g = (kappa - rho * sigma * phi * I - d) / 
+                    (kappa - rho * sigma * phi * I + d);
+    
+    // Extra safety check for numerical stability
+    if (!isfinite(creal(g)) || !isfinite(cimag(g))) {
+        if (g_verbose_debug) {
+            fprintf(stderr, "Warning: Non-finite g value detected in characteristic function\n");
+        }
+        return 1.0 + 0.0 * I;  // Safe default
+    }
+    
+    double complex A = (r - q) * phi * I * T + 
+                    kappa * theta * ((kappa - rho * sigma * phi * I - d) * T - 
+                    2.0 * clog((1.0 - g * cexp(-d * T)) / (1.0 - g))) / 
+                    (sigma * sigma);
+                    
+    double complex B = (kappa - rho * sigma * phi * I - d) * 
+                    (1.0 - cexp(-d * T)) / 
+                    (sigma * sigma * (1.0 - g * cexp(-d * T)));
+    
+    // Safety checks for numerical issues
+    if (!isfinite(creal(A)) || !isfinite(cimag(A)) || 
+        !isfinite(creal(B)) || !isfinite(cimag(B))) {
+        if (g_verbose_debug) {
+            fprintf(stderr, "Warning: Non-finite A or B values in characteristic function\n");
+        }
+        return 1.0 + 0.0 * I;  // Safe default
+    }
+                    
+    return cexp(A + B * v0 + I * phi * clog(S));
+}
+
+// Function to calculate Black-Scholes price (used as fallback)
+double black_scholes_call(double S, double K, double T, double r, double q, double sigma) {
+    if (sigma <= 0 || T <= 0 || S <= 0 || K <= 0) {
+        return -1.0;
+    }
+    
+    double d1 = (log(S/K) + (r - q + 0.5*sigma*sigma)*T) / (sigma * sqrt(T));
+    double d2 = d1 - sigma * sqrt(T);
+    
+    double N_d1 = 0.5 * (1.0 + erf(d1 / sqrt(2.0)));
+    double N_d2 = 0.5 * (1.0 + erf(d2 / sqrt(2.0)));
+    
+    return S * exp(-q * T) * N_d1 - K * exp(-r * T) * N_d2;
+}
+
+// Function to calculate Black-Scholes implied volatility numerically
+double bs_implied_vol(double market_price, double S, double K, double T, double r, double q) {
+    // Input validation
+    if (market_price <= 0.0 || S <= 0.0 || K <= 0.0 || T <= 0.0) {
+        return -1.0;
+    }
+    
+    // Calculate intrinsic value
+    double intrinsic = fmax(0.0, S * exp(-q * T) - K * exp(-r * T));
+    
+    // If market price is below intrinsic value (arbitrage)
+    if (market_price < intrinsic) {
+        if (g_debug) {
+            fprintf(stderr, "Debug: Market price %.6f is below intrinsic value %.6f\n", 
+                    market_price, intrinsic);
+        }
+        return -1.0;
+    }
+    
+    // Initial guess based on simple approximation
+    double vol_low = 0.001;    // 0.1%
+    double vol_high = 2.0;     // 200%
+    double vol_mid, price_mid;
+    
+    // Maximum iterations and precision
+    int max_iter = 100;
+    double precision = 1e-6;
+    
+    // Calculate prices at bounds
+    double price_low = black_scholes_call(S, K, T, r, q, vol_low);
+    double price_high = black_scholes_call(S, K, T, r, q, vol_high);
+    
+    // Check if market price is within bounds
+    if (market_price <= price_low || market_price >= price_high) {
+        if (g_debug) {
+            fprintf(stderr, "Debug: Market price %.6f is outside the bounds [%.6f, %.6f]\n", 
+                    market_price, price_low, price_high);
+        }
+        return -1.0;
+    }
+    
+    // Bisection method
+    for (int i = 0; i < max_iter; i++) {
+        vol_mid = (vol_low + vol_high) * 0.5;
+        price_mid = black_scholes_call(S, K, T, r, q, vol_mid);
+        
+        if (fabs(price_mid - market_price) < precision) {
+            return vol_mid;
+        }
+        
+        if (price_mid < market_price) {
+            vol_low = vol_mid;
+        } else {
+            vol_high = vol_mid;
+        }
+    }
+    
+    return vol_mid;
+}
+
+// Return a workspace block of at least 'bytes', aligned for the widest
+// vector loads (fftw_malloc), or NULL if it had to grow and could not
+static void* workspace_reserve(FFTWorkspace* ws, size_t bytes) {
+    if (bytes > ws->bytes) {
+        void* data = fftw_malloc(bytes);
+        if (data == NULL) {
+            return NULL;
+        }
+        if (ws->data != NULL) {
+            fftw_free(ws->data);
+        }
+        ws->data = data;
+        ws->bytes = bytes;
+        PERF_COUNT(PERF_WORKSPACE_ALLOC);
+    }
+    return ws->data;
+}
+
+static void workspace_release(FFTWorkspace* ws) {
+    if (ws->data != NULL) {
+        fftw_free(ws->data);
+    }
+    ws->data = NULL;
+    ws->bytes = 0;
+}
+
+// Free allocated memory for precomputed values
+static void ctx_cleanup_precomputed_values(HestonFFTContext* ctx) {
+    workspace_release(&ctx->precomputed.workspace);
+    workspace_release(&ctx->precomputed.sens_workspace);
+    
+    memset(&ctx->precomputed, 0, sizeof(ctx->precomputed));
+#ifndef HESTON_NO_MIXED_PRECISION
+    workspace_release(&ctx->screen.workspace);
+    workspace_release(&ctx->screen.grid_workspace);
+    ctx->screen.is_valid = false;
+#endif
+}
+
+// Precompute invariant values used in FFT calculation
+static void ctx_precompute_fft_values(HestonFFTContext* ctx, double S) {
+    // Check if precomputed values are already valid for current parameters
+    if (ctx->precomputed.is_valid && 
+        ctx->precomputed.fft_n == ctx->fft_n && 
+        ctx->precomputed.eta == ctx->eta &&
+        ctx->precomputed.alpha == ctx->alpha &&
+        fabs(ctx->precomputed.S - S) < g_cache_tolerance) {
+        PERF_COUNT(PERF_PRECOMPUTE_REUSE);
+        if (g_debug) {
+            fprintf(stderr, "Debug: Using existing precomputed FFT values\n");
+        }
+        return;
+    }
+    
+    PERF_COUNT(PERF_PRECOMPUTE_BUILD);
+    if (g_debug) {
+        fprintf(stderr, "Debug: Precomputing FFT values for N=%d, eta=%.4f, alpha=%.2f, S=%.2f (CF kernel: %s)\n", 
+                ctx->fft_n, ctx->eta, ctx->alpha, S, heston_cf_kernel_isa());
+    }
+    
+    // Rebuild in the existing workspace; it only grows for a larger FFT size
+    ctx->precomputed.is_valid = false;
+#ifndef HESTON_NO_MIXED_PRECISION
+    ctx->screen.is_valid = false;
+#endif
+    const size_t n = (size_t)ctx->fft_n;
+    double* storage = (double*)workspace_reserve(&ctx->precomputed.workspace, 6 * n * sizeof(double));
+    
+    if (storage == NULL) {
+        fprintf(stderr, "Error: Memory allocation for precomputed FFT values failed\n");
+        return;
+    }
+    
+    ctx->precomputed.nodes = storage;
+    ctx->precomputed.weights = storage + n;
+    ctx->precomputed.exp_re = storage + 2 * n;
+    ctx->precomputed.exp_im = storage + 3 * n;
+    ctx->precomputed.work_re = storage + 4 * n;
+    ctx->precomputed.work_im = storage + 5 * n;
+    
+    // Precompute integration nodes and Simpson's rule weights
+    for (int i = 0; i < ctx->fft_n; i++) {
+        double v = i * ctx->eta;
+        if (fabs(v) < 1e-10) v = 1e-10; // Avoid numerical issues at v=0
+        
+        double simpson_weight = (i == 0) ? 1.0/3.0 : ((i % 2 == 1) ? 4.0/3.0 : 2.0/3.0);
+        
+        ctx->precomputed.nodes[i] = v;
+        ctx->precomputed.weights[i] = simpson_weight * ctx->eta;
+    }
+    
+    // The FFT output spans log-strikes k0 + lambda*u with lambda = 2*pi/(N*eta),
+    // centred on log(S); each node is shifted by exp(-i v k0) to start there
+    double log_strike0 = log(S) - M_PI / ctx->eta;
+    
+    // Metadata is only marked valid once every term is written
+    for (int i = 0; i < ctx->fft_n; i++) {
+        double v = ctx->precomputed.nodes[i];
+        
+        // Calculate exponential term with safety check
+        double complex exp_term = cexp(-I * v * log_strike0);
+        
+        // Check for numerical issues
+        if (!isfinite(creal(exp_term)) || !isfinite(cimag(exp_term))) {
+            if (g_verbose_debug) {
+                fprintf(stderr, "Warning: Non-finite exp term at i=%d, v=%.6f, k0=%.6f\n", 
+                        i, v, log_strike0);
+            }
+            exp_term = 1.0 + 0.0 * I;  // Safe default
+        }
+        
+        ctx->precomputed.exp_re[i] = creal(exp_term);
+        ctx->precomputed.exp_im[i] = cimag(exp_term);
+    }
+    
+    // Update metadata for precomputed values
+    ctx->precomputed.fft_n = ctx->fft_n;
+    ctx->precomputed.eta = ctx->eta;
+    ctx->precomputed.alpha = ctx->alpha;
+    ctx->precomputed.S = S;
+    ctx->precomputed.is_valid = true;
+}
+
+// Release one plan slot
+static void destroy_plan_slot(FFTPlanSlot* slot) {
+    if (slot->plan) {
+        pthread_mutex_lock(&g_planner_lock);
+        fftw_destroy_plan(slot->plan);
+        pthread_mutex_unlock(&g_planner_lock);
+    }
+    if (slot->in) fftw_free(slot->in);
+    if (slot->out) fftw_free(slot->out);
+    memset(slot, 0, sizeof(FFTPlanSlot));
+}
+
+// Pick a free plan slot, recycling slots round-robin once the table is full
+static FFTPlanSlot* claim_plan_slot(HestonFFTContext* ctx) {
+    if (ctx->num_plans < MAX_FFT_PLANS) {
+        return &ctx->plans[ctx->num_plans++];
+    }
+    
+    FFTPlanSlot* slot = &ctx->plans[ctx->next_plan_victim];
+    ctx->next_plan_victim = (ctx->next_plan_victim + 1) % MAX_FFT_PLANS;
+    destroy_plan_slot(slot);
+    return slot;
+}
+
+// Return the persistent plan for howmany n-point forward transforms, creating
+// it on first use. The transforms are interleaved: element j of transform t
+// sits at howmany * j + t, the layout of the sensitivity kernel. With
+// FFTW_MEASURE/PATIENT the first call per size is slow unless wisdom for that
+// size was loaded.
+static FFTPlanSlot* get_fft_plan_batch(HestonFFTContext* ctx, int n, int howmany) {
+    for (int i = 0; i < ctx->num_plans; i++) {
+        if (ctx->plans[i].n == n && ctx->plans[i].howmany == howmany &&
+            ctx->plans[i].flags == g_planner_flags) {
+            return &ctx->plans[i];
+        }
+    }
+    
+    FFTPlanSlot* const slot = claim_plan_slot(ctx);
+    
+    slot->in = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * n * howmany);
+    slot->out = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * n * howmany);
+    
+    if (slot->in == NULL || slot->out == NULL) {
+        fprintf(stderr, "Error: FFTW memory allocation failed\n");
+        destroy_plan_slot(slot);
+        return NULL;
+    }
+    
+    // Planning may overwrite the buffers, which is fine since they are filled
+    // afterwards. The FFTW planner is not thread-safe, executing plans is.
+    pthread_mutex_lock(&g_planner_lock);
+    if (howmany == 1) {
+        slot->plan = fftw_plan_dft_1d(n, slot->in, slot->out, FFTW_FORWARD, g_planner_flags);
+    } else {
+        slot->plan = fftw_plan_many_dft(1, &n, howmany, slot->in, NULL, howmany, 1,
+                                        slot->out, NULL, howmany, 1, FFTW_FORWARD, g_planner_flags);
+    }
+    pthread_mutex_unlock(&g_planner_lock);
+    if (slot->plan == NULL) {
+        fprintf(stderr, "Error: Failed to create FFTW plan\n");
+        destroy_plan_slot(slot);
+        return NULL;
+    }
+    
+    slot->n = n;
+    slot->howmany = howmany;
+    slot->flags = g_planner_flags;
+    
+    if (g_debug) {
+        fprintf(stderr, "Debug: Created FFTW plan for %d x N=%d (flags 0x%x)\n",
+                howmany, n, g_planner_flags);
+    }
+    
+    return slot;
+}
+
+// Return the persistent plan for a single n-point forward transform
+static FFTPlanSlot* get_fft_plan(HestonFFTContext* ctx, int n) {
+    return get_fft_plan_batch(ctx, n, 1);
+}
+
+// Cache key of the grid for these market and model parameters at the
+// context's current FFT settings
+static FFTGridKey ctx_grid_key(const HestonFFTContext* ctx, double S, double r, double q, double T,
+                               double v0, double kappa, double theta, double sigma, double rho) {
+    FFTGridKey key = {
+        .S = S, .r = r, .q = q, .T = T,
+        .v0 = v0, .kappa = kappa, .theta = theta, .sigma = sigma, .rho = rho,
+        .fft_n = ctx->fft_n,
+        .log_strike_range = ctx->log_strike_range,
+        .alpha = ctx->alpha,
+        .eta = ctx->eta
+    };
+    return key;
+}
+
+// Output log-strike spacing of the context's FFT, and how many nodes on
+// either side of log(S) are within log_strike_range and kept in a grid
+static int ctx_grid_half_width(const HestonFFTContext* ctx, double* lambda) {
+    *lambda = 2.0 * M_PI / (ctx->fft_n * ctx->eta);
+    int half = (int)ceil(ctx->log_strike_range / *lambda);
+    if (half > ctx->fft_n / 2 - 1) {
+        half = ctx->fft_n / 2 - 1;
+    }
+    if (half < 1) {
+        half = 1;
+    }
+    return half;
+}
+
+// Hand a freshly computed grid to the other processes of the host
+static void ctx_publish_grid(const FFTGrid* grid) {
+    if (g_grid_share != NULL && grid_share_is_publisher(g_grid_share) &&
+        grid_share_publish(g_grid_share, grid) != 0 && g_verbose_debug) {
+        fprintf(stderr, "Warning: FFT grid of %d strikes not published, wider than a shared slot\n",
+                grid->num_strikes);
+    }
+}
+
+// Call prices from the real parts of count consecutive Carr-Madan transform
+// outputs, stride values apart, starting at output node first whose
+// log-strike is log_strike0
+static void carr_madan_prices(double alpha, double log_strike0, double lambda,
+                              const double* re, size_t stride, int first, int count,
+                              double* prices) {
+    double inv_pi = 1.0 / M_PI; // Precompute 1/PI
+    
+    for (int i = 0; i < count; i++) {
+        double log_K = log_strike0 + lambda * i;
+        
+        // Extract price - using precomputed 1/PI
+        double real_part = re[stride * i];
+        
+        // Check for numerical issues
+        if (!isfinite(real_part)) {
+            if (g_verbose_debug) {
+                fprintf(stderr, "Warning: Non-finite FFT output at index %d\n", first + i);
+            }
+            real_part = 0.0;
+        }
+        
+        double exp_factor = exp(-alpha * log_K) * inv_pi;
+        double price_part = real_part * exp_factor;
+        
+        // Ensure non-negative prices
+        prices[i] = fmax(0.0, price_part);
+    }
+}
+
+// Initialize the FFT cache with option prices for various strikes. On success
+// ctx->current_grid is the grid; on failure it is NULL and nothing half-built
+// is left in the cache.
+static FFTStatus ctx_init_fft_cache(HestonFFTContext* ctx, double S, double r, double q, double T,
+                                    double v0, double kappa, double theta, double sigma, double rho) {
+    // Heston prices are homogeneous in spot and strike, C(S, K) = S C(1, K/S),
+    // and the grid is centred on log(S). In spot-invariant mode every grid is
+    // built for a unit spot in moneyness coordinates, so a spot move reuses
+    // the grid (and the precomputed terms) instead of invalidating them.
+    const double grid_S = g_spot_invariant ? 1.0 : S;
+    const double grid_scale = g_spot_invariant ? S : 1.0;
+    S = grid_S;
+    
+    FFTGridKey key = ctx_grid_key(ctx, S, r, q, T, v0, kappa, theta, sigma, rho);
+    
+    // Print FFT parameters if in debug mode
+    if (g_debug) {
+        fprintf(stderr, "Debug: FFT Parameters - N: %d, Range: %.1f, Alpha: %.2f, Eta: %.4f\n", 
+                ctx->fft_n, ctx->log_strike_range, ctx->alpha, ctx->eta);
+    }
+    
+    if (ctx->grid_cache == NULL) {
+        ctx->grid_cache = fft_cache_create(ctx->cache_max_bytes, g_cache_tolerance);
+        if (ctx->grid_cache == NULL) {
+            fprintf(stderr, "Error: Memory allocation for FFT cache failed\n");
+            ctx->current_grid = NULL;
+            return FFT_STATUS_NO_MEMORY;
+        }
+    }
+    
+    // The key covers market, model and FFT parameters, so grids that differ
+    // only in Heston parameters are kept apart
+    FFTGrid* hit = fft_cache_lookup(ctx->grid_cache, &key);
+    if (hit != NULL) {
+        PERF_COUNT(PERF_GRID_CACHE_HIT);
+        if (g_debug) {
+            fprintf(stderr, "Debug: CACHE HIT - Using cached FFT results\n");
+        }
+        ctx->current_grid = hit;
+        ctx->grid_scale = grid_scale;
+        return FFT_STATUS_OK;
+    }
+    
+    PERF_COUNT(PERF_GRID_CACHE_MISS);
+    
+    // Another process on the host may have published the grid already
+    if (g_grid_share != NULL && !grid_share_is_publisher(g_grid_share)) {
+        FFTGrid* shared = grid_share_fetch(g_grid_share, ctx->grid_cache, &key);
+        if (shared != NULL) {
+            PERF_COUNT(PERF_SHARED_GRID_HIT);
+            if (g_debug) {
+                fprintf(stderr, "Debug: SHARED GRID - Copied published FFT results\n");
+            }
+            ctx->current_grid = shared;
+            ctx->grid_scale = grid_scale;
+            return FFT_STATUS_OK;
+        }
+    }
+    
+    // Cache miss, need to recalculate
+    PERF_START(build_start);
+    if (g_debug) {
+        fprintf(stderr, "Debug: CACHE MISS - Recalculating FFT results for v0=%.4f, kappa=%.2f, theta=%.4f, sigma=%.2f, rho=%.2f\n",
+                v0, kappa, theta, sigma, rho);
+    }
+    
+    // Only the nodes within log_strike_range of log(S) are kept,
+    // N/2 - half .. N/2 + half
+    double lambda;
+    const int half = ctx_grid_half_width(ctx, &lambda);
+    const int first = ctx->fft_n / 2 - half;
+    
+    ctx->current_grid = NULL;
+    FFTGrid* const grid = fft_cache_insert(ctx->grid_cache, &key, 2 * half + 1);
+    if (grid == NULL) {
+        fprintf(stderr, "Error: Memory allocation for FFT cache failed\n");
+        return FFT_STATUS_NO_MEMORY;
+    }
+    
+    // Reuse the persistent plan and buffers for this transform size
+    FFTPlanSlot* slot = get_fft_plan(ctx, ctx->fft_n);
+    if (slot == NULL) {
+        fft_cache_remove(ctx->grid_cache, grid);
+        return FFT_STATUS_NO_PLAN;
+    }
+    fftw_complex* in = slot->in;
+    fftw_complex* out = slot->out;
+    
+    // Precompute invariant parts of the FFT calculation
+    ctx_precompute_fft_values(ctx, S);
+    
+    // Check if precomputation failed
+    if (!ctx->precomputed.is_valid) {
+        fprintf(stderr, "Error: Precomputation of FFT values failed\n");
+        fft_cache_remove(ctx->grid_cache, grid);
+        return FFT_STATUS_NO_MEMORY;
+    }
+    
+    // Fill in the FFT input array: the vectorized kernel evaluates the
+    // characteristic function, Carr-Madan denominator, weights and exp terms
+    // for every node at once
+    const HestonParams params = { v0, kappa, theta, sigma, rho };
+    int zeroed = heston_cf_carr_madan_fill(ctx->fft_n, ctx->alpha, ctx->precomputed.nodes,
+                                           ctx->precomputed.weights,
+                                           ctx->precomputed.exp_re, ctx->precomputed.exp_im,
+                                           S, &params, r, q, T,
+                                           ctx->precomputed.work_re, ctx->precomputed.work_im);
+    
+    if (zeroed > 0 && g_verbose_debug) {
+        fprintf(stderr, "Warning: %d non-finite modified CF values set to zero\n", zeroed);
+    }
+    
+    // Nothing is left to transform when every node was zeroed
+    if (zeroed >= ctx->fft_n) {
+        fft_cache_remove(ctx->grid_cache, grid);
+        return FFT_STATUS_NON_FINITE;
+    }
+    
+    for (int i = 0; i < ctx->fft_n; i++) {
+        in[i] = ctx->precomputed.work_re[i] + I * ctx->precomputed.work_im[i];
+    }
+
+    // Execute the persistent plan on its own buffers
+    PERF_START(fft_start);
+    fftw_execute(slot->plan);
+    PERF_STOP_FFT(ctx->fft_n, fft_start);
+    
+    // Extract option prices from FFT results; a complex value is a pair of doubles
+    double grid_log_strike0 = log(S) - M_PI / ctx->eta + lambda * first;
+    carr_madan_prices(ctx->alpha, grid_log_strike0, lambda, (const double*)&out[first], 2,
+                      first, grid->num_strikes, grid->prices);
+    
+    // Strikes and spline slopes, once per fill
+    fft_grid_fit(grid, grid_log_strike0, lambda);
+    ctx_publish_grid(grid);
+    
+    ctx->current_grid = grid;
+    ctx->grid_scale = grid_scale;
+    PERF_STOP(PERF_TIMER_GRID_BUILD, build_start);
+    
+    if (g_debug) {
+        fprintf(stderr, "Debug: FFT cache initialized with %d strikes from %.2f to %.2f\n",
+                grid->num_strikes, grid->strikes[0], grid->strikes[grid->num_strikes - 1]);
+    }
+    
+    return FFT_STATUS_OK;
+}
+
+// Stop using the GPU for the rest of the process
+static void gpu_backend_fall_back(const char* reason) {
+    if (__atomic_exchange_n(&g_gpu_enabled, 0, __ATOMIC_ACQ_REL) != 0) {
+        fprintf(stderr, "Warning: %s, computing grids on the CPU from now on\n", reason);
+    }
+}
+
+// Build the missing grids of count (T, parameter set) pairs at the context's
+// current FFT settings on the GPU and insert them into its cache, so that the
+// ctx_init_fft_cache() calls that follow are hits. With gpu_verify the first
+// missing grid is computed on the CPU as well and stays in the cache as the
+// reference; a GPU grid that differs from it by more than HESTON_GPU_TOLERANCE
+// of the spot, or a device error, turns the backend off and leaves the grids
+// to the CPU. Pair i has expiry T[i * T_stride], so a stride of 0 gives every
+// grid the same expiry. Returns the number of grids built on the GPU, -1 if
+// none could be.
+static int ctx_gpu_build_grids(HestonFFTContext* ctx, double S, double r, double q,
+                               const double* T, size_t T_stride, const HestonParams* params,
+                               int count) {
+    if (!__atomic_load_n(&g_gpu_enabled, __ATOMIC_ACQUIRE) || count <= 0) {
+        return -1;
+    }
+    
+    // Same spot and key as ctx_init_fft_cache() uses for these grids
+    const double grid_S = g_spot_invariant ? 1.0 : S;
+    if (ctx->grid_cache == NULL) {
+        ctx->grid_cache = fft_cache_create(ctx->cache_max_bytes, g_cache_tolerance);
+        if (ctx->grid_cache == NULL) {
+            return -1;
+        }
+    }
+    
+    double lambda;
+    const int half = ctx_grid_half_width(ctx, &lambda);
+    const int first = ctx->fft_n / 2 - half;
+    const int width = 2 * half + 1;
+    const double grid_log_strike0 = log(grid_S) - M_PI / ctx->eta + lambda * first;
+    
+    // Transform outputs first, then the list of grids to build
+    const size_t outputs = (size_t)count * width;
+    double* out = (double*)workspace_reserve(&ctx->gpu_batch,
+                                             outputs * sizeof(double) + count * sizeof(HestonGPUGrid));
+    if (out == NULL) {
+        return -1;
+    }
+    HestonGPUGrid* grids = (HestonGPUGrid*)(out + outputs);
+    
+    int missing = 0;
+    for (int i = 0; i < count; i++) {
+        const double Ti = T[i * T_stride];
+        FFTGridKey key = ctx_grid_key(ctx, grid_S, r, q, Ti, params[i].v0, params[i].kappa,
+                                      params[i].theta, params[i].sigma, params[i].rho);
+        if (!fft_cache_contains(ctx->grid_cache, &key)) {
+            grids[missing].T = Ti;
+            grids[missing].params = params[i];
+            missing++;
+        }
+    }
+    if (missing == 0) {
+        return 0;
+    }
+    
+    PERF_START(gpu_start);
+    if (heston_gpu_carr_madan(ctx->fft_n, ctx->eta, ctx->alpha, grid_S, r, q, grids, missing,
+                              first, width, out) != 0) {
+        gpu_backend_fall_back("GPU batch failed");
+        return -1;
+    }
+    PERF_STOP(PERF_TIMER_GPU_BATCH, gpu_start);
+    
+    int start = 0;
+    if (g_gpu_verify) {
+        const HestonParams* p = &grids[0].params;
+        if (ctx_init_fft_cache(ctx, S, r, q, grids[0].T, p->v0, p->kappa, p->theta, p->sigma,
+                               p->rho) != FFT_STATUS_OK) {
+            return -1;
+        }
+        const FFTGrid* ref = ctx->current_grid;
+        ctx->current_grid = NULL;
+        
+        // The reference is cached, so the GPU prices of this grid are only compared
+        carr_madan_prices(ctx->alpha, grid_log_strike0, lambda, out, 1, first, width, out);
+        double worst = 0.0;
+        for (int i = 0; i < width; i++) {
+            double diff = fabs(out[i] - ref->prices[i]);
+            worst = (diff > worst || !isfinite(diff)) ? diff : worst;
+        }
+        if (!(worst <= HESTON_GPU_TOLERANCE * grid_S)) {
+            char reason[128];
+            snprintf(reason, sizeof(reason), "GPU grid differs from the CPU reference by %.3g (tolerance %.3g)",
+                     worst, HESTON_GPU_TOLERANCE * grid_S);
+            PERF_COUNT(PERF_GPU_CHECK_FAILURE);
+            gpu_backend_fall_back(reason);
+            return -1;
+        }
+        if (g_verbose_debug) {
+            fprintf(stderr, "Debug: GPU grid within %.3g of the CPU reference\n", worst);
+        }
+        start = 1;
+    }
+    
+    int built = 0;
+    for (int j = start; j < missing; j++) {
+        const HestonParams* p = &grids[j].params;
+        FFTGridKey key = ctx_grid_key(ctx, grid_S, r, q, grids[j].T, p->v0, p->kappa, p->theta,
+                                      p->sigma, p->rho);
+        if (fft_cache_contains(ctx->grid_cache, &key)) {
+            continue;  // Listed twice
+        }
+        
+        FFTGrid* const grid = fft_cache_insert(ctx->grid_cache, &key, width);
+        if (grid == NULL) {
+            break;
+        }
+        carr_madan_prices(ctx->alpha, grid_log_strike0, lambda, out + (size_t)j * width, 1,
+                          first, width, grid->prices);
+        fft_grid_fit(grid, grid_log_strike0, lambda);
+        ctx_publish_grid(grid);
+        PERF_COUNT(PERF_GPU_GRID);
+        built++;
+    }
+    
+    if (g_debug) {
+        fprintf(stderr, "Debug: Built %d of %d FFT grids on the GPU\n", built, count);
+    }
+    return built;
+}
+
+// Add the sensitivity rows to the current grid: one kernel pass for the
+// derivatives of the Carr-Madan integrand and one batched transform of all
+// of them. The grid must come from ctx_init_fft_cache() with the current FFT
+// settings; grids that already carry sensitivities are left alone. The rows
+// are computed for the spot the grid was built for. Returns false if the rows
+// could not be computed.
+static bool ctx_init_grid_sensitivities(HestonFFTContext* ctx, double r, double q, double T,
+                                        const HestonParams* params) {
+    FFTGrid* const grid = ctx->current_grid;
+    
+    if (grid == NULL) {
+        return false;
+    }
+    if (grid->sensitivities != NULL) {
+        return true;
+    }
+    
+    const double S = grid->key.S;
+    
+    const int rows = FFT_GRID_SENSITIVITIES;
+    const size_t n = (size_t)ctx->fft_n;
+    
+    ctx_precompute_fft_values(ctx, S);
+    if (!ctx->precomputed.is_valid) {
+        return false;
+    }
+    
+    double* storage = (double*)workspace_reserve(&ctx->precomputed.sens_workspace,
+                                                 2 * rows * n * sizeof(double));
+    if (storage == NULL) {
+        fprintf(stderr, "Error: Memory allocation for FFT sensitivity inputs failed\n");
+        return false;
+    }
+    ctx->precomputed.sens_re = storage;
+    ctx->precomputed.sens_im = storage + rows * n;
+    
+    FFTPlanSlot* slot = get_fft_plan_batch(ctx, ctx->fft_n, rows);
+    if (slot == NULL || !fft_grid_add_sensitivities(ctx->grid_cache, grid)) {
+        return false;
+    }
+    
+    int zeroed = heston_cf_carr_madan_sensitivity_fill(ctx->fft_n, ctx->alpha, ctx->precomputed.nodes,
+                                                       ctx->precomputed.weights,
+                                                       ctx->precomputed.exp_re, ctx->precomputed.exp_im,
+                                                       S, params, r, q, T,
+                                                       ctx->precomputed.sens_re, ctx->precomputed.sens_im);
+    
+    if (zeroed > 0 && g_verbose_debug) {
+        fprintf(stderr, "Warning: %d non-finite sensitivity inputs set to zero\n", zeroed);
+    }
+    
+    fftw_complex* in = slot->in;
+    for (size_t i = 0; i < rows * n; i++) {
+        in[i] = ctx->precomputed.sens_re[i] + I * ctx->precomputed.sens_im[i];
+    }
+    
+    // The batched plan runs all rows in one execution, recorded as one
+    PERF_START(fft_start);
+    fftw_execute(slot->plan);
+    PERF_STOP_FFT(ctx->fft_n, fft_start);
+    
+    // Same nodes and scaling as the prices, N/2 - half .. N/2 + half
+    const fftw_complex* out = slot->out;
+    const int first = ctx->fft_n / 2 - (grid->num_strikes - 1) / 2;
+    for (int i = 0; i < grid->num_strikes; i++) {
+        double log_K = grid->log_strike0 + grid->log_strike_step * i;
+        double exp_factor = exp(-ctx->alpha * log_K) / M_PI;
+        
+        for (int s = 0; s < rows; s++) {
+            double value = creal(out[(size_t)rows * (first + i) + s]) * exp_factor;
+            grid->sensitivities[(size_t)s * grid->num_strikes + i] = isfinite(value) ? value : 0.0;
+        }
+    }
+    
+    fft_grid_fit_sensitivities(grid);
+    ctx_publish_grid(grid);
+    
+    if (g_debug) {
+        fprintf(stderr, "Debug: FFT sensitivities initialized for %d strikes\n", grid->num_strikes);
+    }
+    
+    return true;
+}
+
+// Get option price from cache: constant-time index on the uniform log-strike
+// grid plus monotone cubic interpolation. Called once per option, so it does
+// no logging; callers report failures.
+static double ctx_get_cached_option_price(const HestonFFTContext* ctx, double K) {
+    const FFTGrid* grid = ctx->current_grid;
+    
+    if (grid == NULL) {
+        return -1.0;
+    }
+    
+    // A unit-spot grid is read at moneyness K/S and scaled back by S
+    return ctx->grid_scale * fft_grid_price(grid, K / ctx->grid_scale);
+}
+
+// Sensitivity row of the current grid for strike K; every row scales with
+// the spot like the price does
+static double ctx_get_cached_sensitivity(const HestonFFTContext* ctx, FFTGridSensitivity which,
+                                         double K) {
+    return ctx->grid_scale * fft_grid_sensitivity(ctx->current_grid, which, K / ctx->grid_scale);
+}
+
+// Function to check if a parameter set might be numerically challenging
+bool is_challenging_parameter_set(double S, double K, double T, double v0, double kappa, double theta, double sigma, double rho) {
+    (void)kappa;
+    (void)theta;
+    
+    // Check for extreme moneyness (very ITM or OTM)
+    double moneyness = K / S;
+    
+    // More permissive moneyness criteria in v6
+    if (moneyness > 3.0 || moneyness < 0.3) {
+        if (g_verbose_debug) {
+            fprintf(stderr, "Debug: Extreme moneyness detected (%.2f)\n", moneyness);
+        }
+        return true;
+    }
+    
+    // More permissive expiry criteria in v6
+    if (T < 0.05 && v0 > 0.1) {  // Very short expiry (less than ~18 days) with extremely high vol
+        if (g_verbose_debug) {
+            fprintf(stderr, "Debug: Very short expiry (%.4f) with extremely high vol (%.2f%%)\n", 
+                    T, sqrt(v0) * 100);
+        }
+        return true;
+    }
+    
+    // More permissive volatility parameters in v6
+    if (sigma > 2.0 || fabs(rho) > 0.95) {
+        if (g_verbose_debug) {
+            fprintf(stderr, "Debug: Extreme volatility parameters (sigma=%.2f, rho=%.2f)\n", 
+                    sigma, rho);
+        }
+        return true;
+    }
+    
+    return false;
+}
+
+// Function to adapt FFT parameters based on option characteristics
+static void ctx_adapt_fft_parameters(HestonFFTContext* ctx, double S, double K, double T) {
+    // Store original parameters
+    int orig_fft_n = ctx->fft_n;
+    double orig_alpha = ctx->alpha;
+    double orig_eta = ctx->eta;
+    double orig_log_strike_range = ctx->log_strike_range;
+    
+    // Adjust for extreme moneyness
+    double moneyness = K / S;
+    
+    // Enhanced adaptability - more aggressive scaling for extreme cases
+    if (moneyness > 1.5 || moneyness < 0.7) {
+        // For far ITM/OTM, increase grid size and range
+        ctx->fft_n = 8192;
+        ctx->log_strike_range = 4.0;
+        
+        // Further adjustments for very extreme moneyness
+        if (moneyness > 2.0 || moneyness < 0.5) {
+            ctx->fft_n = 16384;  // Larger grid for better accuracy
+            ctx->log_strike_range = 5.0;  // Wider range
+        }
+    }
+    
+    // Adjust for very short expiry
+    if (T < 0.1) {  // Less than ~36 days
+        // Short-dated prices bend sharply around the money, so use a larger
+        // eta: the strike spacing 2*pi/(N*eta) gets finer
+        ctx->eta = 0.1;
+        // And adjust alpha for better dampening
+        ctx->alpha = 1.25;
+        
+        // Further adjustments for very short expiry
+        if (T < 0.05) { // Less than ~18 days
+            ctx->eta = 0.2;    // Even finer strike grid
+            ctx->alpha = 1.1;  // Different dampening
+        }
+    }
+    
+    // Adjust for very long expiry
+    if (T > 2.0) {  // More than 2 years
+        // For long expiry, can use larger eta (coarser grid)
+        ctx->eta = 0.1;
+        
+        // Further adjustments for very long expiry
+        if (T > 5.0) { // More than 5 years
+            ctx->fft_n = 8192;  // Larger grid for long-term accuracy
+            ctx->log_strike_range = 4.0;  // Wider range for long-term
+        }
+    }
+    
+    // Log changes if in debug mode
+    if (g_debug && (orig_fft_n != ctx->fft_n || orig_alpha != ctx->alpha || 
+                   orig_eta != ctx->eta || orig_log_strike_range != ctx->log_strike_range)) {
+        fprintf(stderr, "Debug: Adapted FFT parameters for option characteristics:\n");
+        fprintf(stderr, "       N: %d -> %d\n", orig_fft_n, ctx->fft_n);
+        fprintf(stderr, "       Range: %.2f -> %.2f\n", orig_log_strike_range, ctx->log_strike_range);
+        fprintf(stderr, "       alpha: %.2f -> %.2f\n", orig_alpha, ctx->alpha);
+        fprintf(stderr, "       eta: %.4f -> %.4f\n", orig_eta, ctx->eta);
+    }
+}
+
+// Reset FFT parameters to default values
+static void ctx_reset_fft_params(HestonFFTContext* ctx) {
+    ctx->fft_n = 4096;
+    ctx->log_strike_range = 3.0;
+    ctx->alpha = 1.5;
+    ctx->eta = 0.1;
+    
+    if (g_debug) {
+        fprintf(stderr, "Debug: Reset FFT parameters to defaults\n");
+    }
+}
+
+// Pick the FFT settings for an option: the tuning table's entry for its
+// expiry, moneyness and volatility level when a table is loaded and covers
+// it, otherwise the adaptation of challenging inputs. Both are idempotent, so
+// every price of the same option and parameters sees the same settings.
+static void ctx_select_fft_parameters(HestonFFTContext* ctx, double S, double K, double T,
+                                      const HestonParams* p) {
+    const FFTTuningEntry* tuned = fft_tuning_lookup(g_tuning, T, log(K / S),
+                                                    fft_tuning_vol_level(p, T));
+    if (tuned != NULL) {
+        PERF_COUNT(PERF_TUNING_HIT);
+        ctx->fft_n = tuned->fft_n;
+        ctx->eta = tuned->eta;
+        ctx->alpha = tuned->alpha;
+        ctx->log_strike_range = tuned->log_strike_range;
+        
+        if (g_verbose_debug) {
+            fprintf(stderr, "Debug: Tuned FFT parameters - N: %d, Range: %.2f, Alpha: %.2f, Eta: %.4f\n",
+                    ctx->fft_n, ctx->log_strike_range, ctx->alpha, ctx->eta);
+        }
+        return;
+    }
+    
+    if (is_challenging_parameter_set(S, K, T, p->v0, p->kappa, p->theta, p->sigma, p->rho)) {
+        ctx_adapt_fft_parameters(ctx, S, K, T);
+    }
+}
+
+// Try different FFT parameter sets in sequence
+static bool ctx_try_alternate_fft_params(HestonFFTContext* ctx, int attempt) {
+    if (attempt == 1) {
+        // First alternative set - larger grid, different dampening
+        ctx->fft_n = 8192;
+        ctx->alpha = 1.0;
+        ctx->eta = 0.075;
+        ctx->log_strike_range = 4.0;
+    } else if (attempt == 2) {
+        // Second alternative set - smaller grid, different dampening
+        ctx->fft_n = 2048;
+        ctx->alpha = 1.25;
+        ctx->eta = 0.025;
+        ctx->log_strike_range = 2.5;
+    } else if (attempt == 3) {
+        // Third alternative set - very fine grid
+        ctx->fft_n = 16384;
+        ctx->alpha = 0.75;
+        ctx->eta = 0.01;
+        ctx->log_strike_range = 5.0;
+    } else if (attempt == 4) {
+        // Fourth alternative - balanced approach
+        ctx->fft_n = 4096;
+        ctx->alpha = 0.9;
+        ctx->eta = 0.05;
+        ctx->log_strike_range = 3.5;
+    } else if (attempt == 5) {
+        // Fifth alternative - focus on stability
+        ctx->fft_n = 2048;
+        ctx->alpha = 2.0;
+        ctx->eta = 0.1;
+        ctx->log_strike_range = 3.0;
+    } else {
+        // No more alternative sets
+        return false;
+    }
+    
+    PERF_COUNT(PERF_ALTERNATE_FFT_PARAMS);
+    if (g_debug) {
+        fprintf(stderr, "Debug: Trying alternate FFT parameter set #%d:\n", attempt);
+        fprintf(stderr, "       N: %d, Range: %.1f, Alpha: %.2f, Eta: %.4f\n", 
+                ctx->fft_n, ctx->log_strike_range, ctx->alpha, ctx->eta);
+    }
+    
+    return true;
+}
+
+// Heston model call option pricing using FFT
+static double ctx_heston_call_fft(HestonFFTContext* ctx, double S, double K, double T, double r, double q,
+                                  double v0, double kappa, double theta, double sigma, double rho) {
+    // Tuned settings, or adapted ones if this parameter set might be challenging
+    const HestonParams params = { v0, kappa, theta, sigma, rho };
+    ctx_select_fft_parameters(ctx, S, K, T, &params);
+    
+    // Initialize the FFT price cache if needed
+    FFTStatus status = ctx_init_fft_cache(ctx, S, r, q, T, v0, kappa, theta, sigma, rho);
+    
+    // Check if cache initialization failed
+    if (status != FFT_STATUS_OK) {
+        if (g_debug) {
+            fprintf(stderr, "Debug: Cache initialization failed (%s), trying with different parameters\n",
+                    fft_status_string(status));
+        }
+        
+        // Try with multiple alternative FFT parameter sets
+        for (int attempt = 1; attempt <= g_max_calibration_attempts; attempt++) {
+            if (!ctx_try_alternate_fft_params(ctx, attempt)) {
+                break;  // No more alternative sets to try
+            }
+            
+            // Try again with new parameters
+            status = ctx_init_fft_cache(ctx, S, r, q, T, v0, kappa, theta, sigma, rho);
+            
+            // If succeeded, break out of loop
+            if (status == FFT_STATUS_OK) {
+                if (g_debug) {
+                    fprintf(stderr, "Debug: FFT succeeded with alternate parameter set #%d\n", attempt);
+                }
+                break;
+            }
+        }
+        
+        // If all attempts failed, fall back to Black-Scholes if allowed
+        // and leave the failure for the caller's retry ladder
+        if (status != FFT_STATUS_OK) {
+            if (g_debug) {
+                fprintf(stderr, "Debug: All FFT attempts failed\n");
+            }
+            ctx_fail(ctx, status);
+            
+            if (g_use_bs_fallback) {
+                if (g_debug) {
+                    fprintf(stderr, "Debug: Falling back to Black-Scholes\n");
+                }
+                
+                // Fallback to Black-Scholes with equivalent volatility
+                double bs_vol = sqrt(v0); // Simple approximation
+                PERF_COUNT(PERF_BS_FALLBACK);
+                return black_scholes_call(S, K, T, r, q, bs_vol);
+            } else {
+                if (g_debug) {
+                    fprintf(stderr, "Debug: Black-Scholes fallback disabled, returning error\n");
+                }
+                return -1.0;
+            }
+        }
+    }
+    
+    // Get option price from cache with interpolation
+    double price = ctx_get_cached_option_price(ctx, K);
+    
+    // Extra validation check on the returned price
+    if (price < 0.0 || !isfinite(price)) {
+        if (g_debug) {
+            fprintf(stderr, "Debug: Error retrieving price from cache\n");
+        }
+        
+        // Additional price sanity check - very basic validation
+        if (price <= 0.0) {
+            double intrinsic = fmax(0.0, S * exp(-q * T) - K * exp(-r * T));
+            if (price < intrinsic && intrinsic > 0.0) {
+                if (g_debug) {
+                    fprintf(stderr, "Debug: Calculated price (%.6f) is below intrinsic value (%.6f)\n", 
+                            price, intrinsic);
+                }
+            }
+        }
+        
+        // Try additional recovery - reset FFT parameters and try again
+        if (g_debug) {
+            fprintf(stderr, "Debug: Attempting recovery with reset parameters\n");
+        }
+        
+        // Reset to defaults and try one more time
+        ctx_reset_fft_params(ctx);
+        status = ctx_init_fft_cache(ctx, S, r, q, T, v0, kappa, theta, sigma, rho);
+        
+        if (status == FFT_STATUS_OK) {
+            price = ctx_get_cached_option_price(ctx, K);
+            
+            if (price >= 0.0 && isfinite(price)) {
+                if (g_debug) {
+                    fprintf(stderr, "Debug: Recovery succeeded, got valid price: %.6f\n", price);
+                }
+                return price;
+            }
+        }
+        
+        // If still failing and fallback is enabled, use Black-Scholes
+        ctx_fail(ctx, (status != FFT_STATUS_OK) ? status : FFT_STATUS_NON_FINITE);
+        if (g_use_bs_fallback) {
+            if (g_debug) {
+                fprintf(stderr, "Debug: Recovery failed, falling back to Black-Scholes\n");
+            }
+            
+            // Fallback to Black-Scholes with equivalent volatility
+            double bs_vol = sqrt(v0); // Simple approximation
+            PERF_COUNT(PERF_BS_FALLBACK);
+            return black_scholes_call(S, K, T, r, q, bs_vol);
+        } else {
+            if (g_debug) {
+                fprintf(stderr, "Debug: Black-Scholes fallback disabled, returning error\n");
+            }
+            return -1.0;
+        }
+    }
+    
+    if (g_debug) {
+        fprintf(stderr, "Debug: Interpolated price %.6f for strike %.2f\n", price, K);
+    }
+    
+    return price;
+}
+
+#ifndef HESTON_NO_MIXED_PRECISION
+// Release the plan and buffers of a context's screen
+static void ctx_release_screen_plan(HestonFFTContext* ctx) {
+    FFTScreen* const screen = &ctx->screen;
+    
+    if (screen->plan != NULL) {
+        pthread_mutex_lock(&g_planner_lock);
+        fftwf_destroy_plan(screen->plan);
+        pthread_mutex_unlock(&g_planner_lock);
+    }
+    if (screen->in != NULL) fftwf_free(screen->in);
+    if (screen->out != NULL) fftwf_free(screen->out);
+    screen->plan = NULL;
+    screen->in = NULL;
+    screen->out = NULL;
+    screen->plan_n = 0;
+}
+
+// Single-precision price grid of one calibration candidate: the grid
+// ctx_init_fft_cache() would build, computed with the float kernel and an
+// fftwf transform and kept out of the cache. Returns NULL when screening is
+// off, when the double grid is cached anyway (a hit is cheaper than a
+// screen) and when the screen cannot be computed; the caller then prices
+// in double precision as usual.
+static const FFTGrid* ctx_screen_grid(HestonFFTContext* ctx, double S, double r, double q, double T,
+                                      const HestonParams* p) {
+    FFTScreen* const screen = &ctx->screen;
+    const double grid_S = g_spot_invariant ? 1.0 : S;
+    
+    if (!g_mixed_precision) {
+        return NULL;
+    }
+    
+    FFTGridKey key = ctx_grid_key(ctx, grid_S, r, q, T, p->v0, p->kappa, p->theta, p->sigma, p->rho);
+    if (fft_cache_contains(ctx->grid_cache, &key)) {
+        return NULL;
+    }
+    
+    const int n = ctx->fft_n;
+    if (screen->plan == NULL || screen->plan_n != n) {
+        ctx_release_screen_plan(ctx);
+        screen->in = (fftwf_complex*)fftwf_malloc(sizeof(fftwf_complex) * n);
+        screen->out = (fftwf_complex*)fftwf_malloc(sizeof(fftwf_complex) * n);
+        if (screen->in == NULL || screen->out == NULL) {
+            return NULL;
+        }
+        
+        pthread_mutex_lock(&g_planner_lock);
+        screen->plan = fftwf_plan_dft_1d(n, screen->in, screen->out, FFTW_FORWARD, FFTW_ESTIMATE);
+        pthread_mutex_unlock(&g_planner_lock);
+        if (screen->plan == NULL) {
+            return NULL;
+        }
+        screen->plan_n = n;
+    }
+    
+    // The float terms are derived from the double ones and follow their rebuilds
+    ctx_precompute_fft_values(ctx, grid_S);
+    if (!ctx->precomputed.is_valid) {
+        return NULL;
+    }
+    
+    if (!screen->is_valid) {
+        float* storage = (float*)workspace_reserve(&screen->workspace, 6 * (size_t)n * sizeof(float));
+        if (storage == NULL) {
+            return NULL;
+        }
+        screen->nodes = storage;
+        screen->weights = storage + n;
+        screen->shift_re = storage + 2 * (size_t)n;
+        screen->shift_im = storage + 3 * (size_t)n;
+        screen->work_re = storage + 4 * (size_t)n;
+        screen->work_im = storage + 5 * (size_t)n;
+        
+        const double log_S = log(grid_S);
+        for (int i = 0; i < n; i++) {
+            const double v = ctx->precomputed.nodes[i];
+            const double c = cos(v * log_S), sn = sin(v * log_S);
+            const double er = ctx->precomputed.exp_re[i], ei = ctx->precomputed.exp_im[i];
+            
+            screen->nodes[i] = (float)v;
+            screen->weights[i] = (float)ctx->precomputed.weights[i];
+            screen->shift_re[i] = (float)(er * c - ei * sn);
+            screen->shift_im[i] = (float)(er * sn + ei * c);
+        }
+        screen->is_valid = true;
+    }
+    
+    double lambda;
+    const int half = ctx_grid_half_width(ctx, &lambda);
+    const int first = n / 2 - half;
+    const int num_strikes = 2 * half + 1;
+    
+    double* rows = (double*)workspace_reserve(&screen->grid_workspace,
+                                              3 * (size_t)num_strikes * sizeof(double));
+    if (rows == NULL) {
+        return NULL;
+    }
+    screen->grid.prices = rows;
+    screen->grid.strikes = rows + num_strikes;
+    screen->grid.slopes = rows + 2 * (size_t)num_strikes;
+    screen->grid.num_strikes = num_strikes;
+    
+    heston_cf_carr_madan_fill_f(n, ctx->alpha, screen->nodes, screen->weights,
+                                screen->shift_re, screen->shift_im, grid_S, p, r, q, T,
+                                screen->work_re, screen->work_im);
+    double magnitude = 0.0;
+    for (int i = 0; i < n; i++) {
+        screen->in[i] = screen->work_re[i] + I * screen->work_im[i];
+        magnitude += fabsf(screen->work_re[i]) + fabsf(screen->work_im[i]);
+    }
+    fftwf_execute(screen->plan);
+    
+    // Same extraction as the double grid, in double from here on
+    const double log_strike0 = log(grid_S) - M_PI / ctx->eta + lambda * first;
+    for (int i = 0; i < num_strikes; i++) {
+        double real_part = crealf(screen->out[first + i]);
+        if (!isfinite(real_part)) {
+            real_part = 0.0;
+        }
+        double price = real_part * exp(-ctx->alpha * (log_strike0 + lambda * i)) / M_PI;
+        screen->grid.prices[i] = fmax(0.0, price);
+    }
+    fft_grid_fit(&screen->grid, log_strike0, lambda);
+    
+    // Rounding errors scale with the terms summed by the transform, and the
+    // exponent of the characteristic function loses digits to cancellation
+    // in proportion to kappa theta T / sigma^2
+    screen->scale = g_spot_invariant ? S : 1.0;
+    screen->error_scale = HESTON_SCREEN_SAFETY * FLT_EPSILON * magnitude *
+                          (1.0 + p->kappa * p->theta * T / (p->sigma * p->sigma)) / M_PI;
+    PERF_COUNT(PERF_SCREEN_GRID);
+    return &screen->grid;
+}
+
+// Price of strike K on a screening grid and its error bound, -1.0 if the
+// price is unusable
+static double ctx_screen_price(const HestonFFTContext* ctx, const FFTGrid* grid, double K,
+                               double* margin) {
+    const double scale = ctx->screen.scale;
+    double price = scale * fft_grid_price(grid, K / scale);
+    
+    *margin = scale * ctx->screen.error_scale * exp(-ctx->alpha * log(K / scale));
+    return (price >= 0.0 && isfinite(price) && isfinite(*margin)) ? price : -1.0;
+}
+
+// Screened call price with the FFT settings ctx_heston_call_fft() would use
+// and its error bound, or -1.0 if the candidate has to be priced in double
+// precision
+static double ctx_screen_call(HestonFFTContext* ctx, double S, double K, double T, double r, double q,
+                              const HestonParams* p, double* margin) {
+    if (!g_mixed_precision) {
+        return -1.0;
+    }
+    
+    // The double price that may follow selects the same settings
+    ctx_select_fft_parameters(ctx, S, K, T, p);
+    
+    const FFTGrid* grid = ctx_screen_grid(ctx, S, r, q, T, p);
+    return (grid != NULL) ? ctx_screen_price(ctx, grid, K, margin) : -1.0;
+}
+#endif
+
+// Release the cached grids and precomputed values of a context
+static void ctx_release_cache(HestonFFTContext* ctx) {
+    fft_cache_destroy(ctx->grid_cache);
+    ctx->grid_cache = NULL;
+    ctx->current_grid = NULL;
+    
+    ctx_cleanup_precomputed_values(ctx);
+    workspace_release(&ctx->scratch);
+    workspace_release(&ctx->gpu_batch);
+}
+
+// Destroy every plan in a context's plan table
+static void ctx_release_plans(HestonFFTContext* ctx) {
+    for (int i = 0; i < ctx->num_plans; i++) {
+        destroy_plan_slot(&ctx->plans[i]);
+    }
+    ctx->num_plans = 0;
+    ctx->next_plan_victim = 0;
+#ifndef HESTON_NO_MIXED_PRECISION
+    ctx_release_screen_plan(ctx);
+#endif
+}
+
+// Default-context versions of the engine functions (the public API)
+
+void precompute_fft_values(double S) {
+    ctx_precompute_fft_values(&g_default_ctx, S);
+}
+
+void cleanup_precomputed_values(void) {
+    ctx_cleanup_precomputed_values(&g_default_ctx);
+}
+
+void init_fft_cache(double S, double r, double q, double T,
+                    double v0, double kappa, double theta, double sigma, double rho) {
+    ctx_init_fft_cache(&g_default_ctx, S, r, q, T, v0, kappa, theta, sigma, rho);
+}
+
+double get_cached_option_price(double K) {
+    return ctx_get_cached_option_price(&g_default_ctx, K);
+}
+
+void adapt_fft_parameters(double S, double K, double T) {
+    ctx_adapt_fft_parameters(&g_default_ctx, S, K, T);
+}
+
+void reset_fft_params_to_defaults(void) {
+    ctx_reset_fft_params(&g_default_ctx);
+}
+
+bool try_alternate_fft_params(int attempt) {
+    return ctx_try_alternate_fft_params(&g_default_ctx, attempt);
+}
+
+double heston_call_fft(double S, double K, double T, double r, double q,
+                       double v0, double kappa, double theta, double sigma, double rho) {
+    return ctx_heston_call_fft(&g_default_ctx, S, K, T, r, q, v0, kappa, theta, sigma, rho);
+}
+
+/**
+ * @brief Create a pricing context with the current FFT settings
+ */
+HestonFFTContext* heston_fft_context_create(void) {
+    HestonFFTContext* ctx = (HestonFFTContext*)calloc(1, sizeof(HestonFFTContext));
+    if (ctx == NULL) {
+        return NULL;
+    }
+    
+    ctx->fft_n = g_default_ctx.fft_n;
+    ctx->log_strike_range = g_default_ctx.log_strike_range;
+    ctx->alpha = g_default_ctx.alpha;
+    ctx->eta = g_default_ctx.eta;
+    ctx->cache_max_bytes = g_cache_max_bytes;
+    
+    return ctx;
+}
+
+/**
+ * @brief Free a pricing context with its grids and plans
+ */
+void heston_fft_context_destroy(HestonFFTContext* ctx) {
+    if (ctx == NULL) {
+        return;
+    }
+    
+    ctx_release_cache(ctx);
+    ctx_release_plans(ctx);
+    free(ctx);
+}
+
+/**
+ * @brief Apply the FFT grid and cache limit of a configuration to a context
+ */
+void heston_fft_context_set_config(HestonFFTContext* ctx, const HestonFFTConfig* config) {
+    if (ctx == NULL || config == NULL) {
+        return;
+    }
+    
+    ctx->fft_n = config->fft_n;
+    ctx->log_strike_range = config->log_strike_range;
+    ctx->alpha = config->alpha;
+    ctx->eta = config->eta;
+    ctx->cache_max_bytes = (config->cache_max_bytes > 0) ? config->cache_max_bytes
+                                                         : FFT_CACHE_DEFAULT_MAX_BYTES;
+    if (ctx->grid_cache != NULL) {
+        fft_cache_set_limit(ctx->grid_cache, ctx->cache_max_bytes);
+        ctx->current_grid = NULL;
+    }
+}
+
+/**
+ * @brief Heston call price via FFT using a caller-owned context
+ */
+double heston_fft_context_call(HestonFFTContext* ctx, double S, double K, double T,
+                               double r, double q, const HestonParams* params) {
+    if (ctx == NULL || params == NULL) {
+        return -1.0;
+    }
+    
+    return ctx_heston_call_fft(ctx, S, K, T, r, q, params->v0, params->kappa,
+                               params->theta, params->sigma, params->rho);
+}
+
+/**
+ * @brief Call prices for a chain from one grid with the context's FFT settings as they are
+ */
+int heston_fft_context_price_grid(HestonFFTContext* ctx, double S, double T, double r, double q,
+                                  const HestonParams* params, const double* strikes, int n,
+                                  double* prices) {
+    if (ctx == NULL || params == NULL || strikes == NULL || prices == NULL || n <= 0 ||
+        S <= 0.0 || T <= 0.0) {
+        return -1;
+    }
+    for (int i = 0; i < n; i++) {
+        if (!(strikes[i] > 0.0)) {
+            return -1;
+        }
+    }
+    
+    if (ctx_init_fft_cache(ctx, S, r, q, T, params->v0, params->kappa, params->theta,
+                           params->sigma, params->rho) != FFT_STATUS_OK) {
+        return -1;
+    }
+    
+    for (int i = 0; i < n; i++) {
+        prices[i] = ctx_get_cached_option_price(ctx, strikes[i]);
+    }
+    return 0;
+}
+
+/**
+ * @brief Grids of many (expiry, parameter set) pairs into a context's cache, batched on the GPU
+ */
+int heston_fft_context_build_grids(HestonFFTContext* ctx, double S, double r, double q,
+                                   const double* T, const HestonParams* params, int count) {
+    if (ctx == NULL || T == NULL || params == NULL || count <= 0 || !(S > 0.0)) {
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        if (!(T[i] > 0.0)) {
+            return -1;
+        }
+    }
+    
+    int built = ctx_gpu_build_grids(ctx, S, r, q, T, 1, params, count);
+    
+    // Whatever the GPU did not build is computed here
+    const double grid_S = g_spot_invariant ? 1.0 : S;
+    for (int i = 0; i < count; i++) {
+        const HestonParams* p = &params[i];
+        FFTGridKey key = ctx_grid_key(ctx, grid_S, r, q, T[i], p->v0, p->kappa, p->theta,
+                                      p->sigma, p->rho);
+        if (ctx->grid_cache != NULL && fft_cache_contains(ctx->grid_cache, &key)) {
+            continue;
+        }
+        if (ctx_init_fft_cache(ctx, S, r, q, T[i], p->v0, p->kappa, p->theta, p->sigma,
+                               p->rho) != FFT_STATUS_OK) {
+            return -1;
+        }
+    }
+    return (built > 0) ? built : 0;
+}
+
+// One calibration sweep over a list of Heston parameter sets. Each worker
+// claims the next set through an atomic index and evaluates it in its own
+// context; any worker can stop the sweep through the atomic stop flag once
+// the sweep's goal is met. With one thread the sets are evaluated in order in
+// the default context, exactly as the serial search always did.
+typedef struct CalibrationSweep CalibrationSweep;
+typedef void (*CalibrationEval)(CalibrationSweep* sweep, HestonFFTContext* ctx, int index);
+
+struct CalibrationSweep {
+    const HestonParams* sets;   // Parameter sets to evaluate
+    int count;                  // Number of sets
+    CalibrationEval eval;       // Evaluates one set, may set 'stop'
+    void* data;                 // Target of the sweep (single option or chain)
+    int next;                   // Next set to claim (atomic)
+    int stop;                   // Nonzero once the sweep can end early (atomic)
+    pthread_mutex_t lock;       // Serializes updates of the best-so-far in 'data'
+    HestonFFTContext* ctx;      // Runs serially in this context; NULL for the default
+                                // context and the worker threads
+    bool prefilled;             // Every set's grid was built into ctx's cache beforehand
+};
+
+typedef struct {
+    CalibrationSweep* sweep;
+    HestonFFTContext* ctx;
+    pthread_t thread;
+} CalibrationWorker;
+
+// Claim and evaluate sets until they run out or the sweep is stopped
+static void drain_calibration_sweep(CalibrationSweep* sweep, HestonFFTContext* ctx) {
+    while (!__atomic_load_n(&sweep->stop, __ATOMIC_ACQUIRE)) {
+        int index = __atomic_fetch_add(&sweep->next, 1, __ATOMIC_RELAXED);
+        if (index >= sweep->count) {
+            break;
+        }
+        sweep->eval(sweep, ctx, index);
+    }
+}
+
+static void* calibration_worker_main(void* arg) {
+    CalibrationWorker* worker = (CalibrationWorker*)arg;
+    drain_calibration_sweep(worker->sweep, worker->ctx);
+    return NULL;
+}
+
+// Run a sweep on up to g_threads workers, or serially in the sweep's own
+// context if it has one. Returns true if it stopped early.
+static bool run_calibration_sweep(CalibrationSweep* sweep) {
+    CalibrationWorker workers[HESTON_FFT_MAX_THREADS];
+    int threads = (sweep->ctx != NULL) ? 1 : (g_threads < sweep->count) ? g_threads : sweep->count;
+    int started = 0;
+    
+    sweep->next = 0;
+    sweep->stop = 0;
+    pthread_mutex_init(&sweep->lock, NULL);
+    PERF_START(sweep_start);
+    
+    if (threads > 1) {
+        // Workers start from the default context's current (possibly adapted)
+        // FFT settings; running with fewer workers than asked is still correct
+        for (int i = 0; i < threads; i++) {
+            if (g_sweep_contexts[i] == NULL) {
+                g_sweep_contexts[i] = heston_fft_context_create();
+                if (g_sweep_contexts[i] == NULL) {
+                    break;
+                }
+            }
+            
+            HestonFFTContext* ctx = g_sweep_contexts[i];
+            ctx->fft_n = g_default_ctx.fft_n;
+            ctx->log_strike_range = g_default_ctx.log_strike_range;
+            ctx->alpha = g_default_ctx.alpha;
+            ctx->eta = g_default_ctx.eta;
+            ctx->cache_max_bytes = g_cache_max_bytes / threads;
+            ctx->current_grid = NULL;
+            if (ctx->grid_cache != NULL) {
+                fft_cache_set_limit(ctx->grid_cache, ctx->cache_max_bytes);
+                fft_cache_set_tolerance(ctx->grid_cache, g_cache_tolerance);
+            }
+            
+            workers[started].sweep = sweep;
+            workers[started].ctx = ctx;
+            if (pthread_create(&workers[started].thread, NULL,
+                               calibration_worker_main, &workers[started]) != 0) {
+                break;
+            }
+            started++;
+        }
+        
+        // The sweep's failures belong to the default context it stands in for
+        for (int i = 0; i < started; i++) {
+            pthread_join(workers[i].thread, NULL);
+            ctx_fail(&g_default_ctx, ctx_take_status(workers[i].ctx));
+        }
+        
+        if (g_debug) {
+            fprintf(stderr, "Debug: Calibration sweep of %d sets ran on %d threads\n",
+                    sweep->count, started);
+        }
+    }
+    
+    // Serial path, also taken when no worker could be started
+    if (started == 0) {
+        drain_calibration_sweep(sweep, (sweep->ctx != NULL) ? sweep->ctx : &g_default_ctx);
+    }
+    
+    pthread_mutex_destroy(&sweep->lock);
+    PERF_STOP(PERF_TIMER_CALIBRATION_SWEEP, sweep_start);
+    PERF_COUNT(PERF_CALIBRATION_SWEEP);
+    if (sweep->stop != 0) {
+        PERF_COUNT(PERF_CALIBRATION_EARLY_STOP);
+    }
+    return sweep->stop != 0;
+}
+
+// Best-so-far of a single-option calibration sweep
+typedef struct {
+    double market_price, S, K, T, r, q;
+    double tolerance;           // Stop once a difference is below tolerance * market_price
+    bool refined;               // Refined search (only changes the debug output)
+    double best_diff;           // Read atomically outside the lock, written under it
+    int best_index;             // Set that produced best_diff, -1 for none
+} SingleCalibration;
+
+static void evaluate_single_set(CalibrationSweep* sweep, HestonFFTContext* ctx, int index) {
+    SingleCalibration* cal = (SingleCalibration*)sweep->data;
+    const HestonParams* p = &sweep->sets[index];
+    double best_diff;
+    
+    PERF_COUNT(PERF_CALIBRATION_EVAL);
+    
+#ifndef HESTON_NO_MIXED_PRECISION
+    // A set whose screened difference misses the best so far by more than
+    // the screen's error bound cannot win in double precision either
+    double margin;
+    double screened = ctx_screen_call(ctx, cal->S, cal->K, cal->T, cal->r, cal->q, p, &margin);
+    if (screened >= 0.0) {
+        __atomic_load(&cal->best_diff, &best_diff, __ATOMIC_RELAXED);
+        if (fabs(screened - cal->market_price) > best_diff + margin) {
+            PERF_COUNT(PERF_SCREEN_REJECT);
+            return;
+        }
+    }
+#endif
+    
+    // Calculate option price using current parameters
+    double model_price = ctx_heston_call_fft(ctx, cal->S, cal->K, cal->T, cal->r, cal->q,
+                                             p->v0, p->kappa, p->theta, p->sigma, p->rho);
+    
+    // If price calculation failed (possible with BS fallback disabled)
+    if (model_price < 0.0 || !isfinite(model_price)) {
+        if (g_verbose_debug && !cal->refined) {
+            fprintf(stderr, "Debug: Model price calculation failed for parameter set: v0=%.4f, kappa=%.1f, sigma=%.2f, rho=%.2f\n",
+                    p->v0, p->kappa, p->sigma, p->rho);
+        }
+        return;  // Skip this parameter set
+    }
+    
+    double test_diff = fabs(model_price - cal->market_price);
+    
+    // Cheap rejection without the lock
+    __atomic_load(&cal->best_diff, &best_diff, __ATOMIC_RELAXED);
+    if (test_diff > best_diff) {
+        return;
+    }
+    
+    pthread_mutex_lock(&sweep->lock);
+    
+    // Lowest difference wins, ties go to the earlier set as in the serial order
+    if (test_diff < cal->best_diff ||
+        (test_diff == cal->best_diff && cal->best_index >= 0 && index < cal->best_index)) {
+        __atomic_store(&cal->best_diff, &test_diff, __ATOMIC_RELAXED);
+        cal->best_index = index;
+        
+        if (g_debug) {
+            fprintf(stderr, "Debug: %s - v0: %.4f, kappa: %.1f, sigma: %.2f, rho: %.2f, diff: $%.4f\n",
+                    cal->refined ? "Refined search found better set" : "Found better parameter set",
+                    p->v0, p->kappa, p->sigma, p->rho, test_diff);
+        }
+        
+        // If we're close enough, exit early
+        if (test_diff < cal->tolerance * cal->market_price) {
+            __atomic_store_n(&sweep->stop, 1, __ATOMIC_RELEASE);
+        }
+    }
+    
+    pthread_mutex_unlock(&sweep->lock);
+}
+
+// Turn the best calibrated Heston parameters for one option into the reported
+// volatility, falling back to the Black-Scholes IV when the calibration is poor
+static double finalize_sv_vol(HestonFFTContext* ctx,
+                              double market_price, double S, double K, double T, double r, double q,
+                              double bs_iv, double best_v, double best_kappa, double best_sigma,
+                              double best_rho, double best_diff) {
+    // Calculate the final implied volatility from the Heston calibration
+    double sv_vol = sqrt(best_v);
+    
+    // Check if our best Heston calibration is reasonable
+    // Less restrictive calibration error threshold in v6 (25% instead of 10%)
+    if (best_diff > 0.25 * market_price) {
+        // If Heston calibration is very poor, rely on BS IV
+        if (g_debug) {
+            fprintf(stderr, "Debug: Very large calibration error (%.2f%% of price). Using BS IV.\n",
+                    100.0 * best_diff / market_price);
+        }
+        PERF_COUNT(PERF_BS_FALLBACK);
+        return bs_iv;
+    }
+    
+    // More permissive sanity checks in v6
+    if (sv_vol < 0.03) {  // 3% instead of 5%
+        if (g_debug) {
+            fprintf(stderr, "Debug: SV result (%.2f%%) is extremely low. Using BS IV (%.2f%%) instead.\n",
+                    sv_vol * 100, bs_iv * 100);
+        }
+        PERF_COUNT(PERF_BS_FALLBACK);
+        return bs_iv;
+    }
+    
+    if (sv_vol > 2.0) {  // 200% instead of 150%
+        if (g_debug) {
+            fprintf(stderr, "Debug: SV result (%.2f%%) is extremely high. Using BS IV (%.2f%%) instead.\n",
+                    sv_vol * 100, bs_iv * 100);
+        }
+        PERF_COUNT(PERF_BS_FALLBACK);
+        return bs_iv;
+    }
+    
+    // Add an additional relative comparison with BS IV
+    // If SV result differs drastically from BS IV, double-check with an intermediate calibration
+    if (fabs(sv_vol - bs_iv) > 0.3 * bs_iv) {  // If SV differs by more than 30% from BS
+        if (g_debug) {
+            fprintf(stderr, "Debug: Large difference between SV (%.2f%%) and BS (%.2f%%). Verifying...\n",
+                    sv_vol * 100, bs_iv * 100);
+        }
+        
+        // Try one more calibration with intermediate parameters
+        double verify_v0 = (best_v + bs_iv * bs_iv) / 2.0;  // Average of SV and BS
+        double verify_price = ctx_heston_call_fft(ctx, S, K, T, r, q, 
+                                         verify_v0, best_kappa, verify_v0, 
+                                         best_sigma, best_rho);
+        
+        // If this verification price is closer to market, use it instead
+        if (fabs(verify_price - market_price) < best_diff) {
+            sv_vol = sqrt(verify_v0);
+            
+            if (g_debug) {
+                fprintf(stderr, "Debug: Verification improved result to %.2f%%\n", sv_vol * 100);
+            }
+        }
+    }
+    
+    // For most cases, return the calculated volatility
+    if (g_debug) {
+        fprintf(stderr, "Debug: Final SV: %.2f%% (BS IV: %.2f%%)\n", 
+                sv_vol * 100, bs_iv * 100);
+        fprintf(stderr, "Debug: Price difference: $%.4f (%.2f%% of market price)\n", 
+                best_diff, 100.0 * best_diff / market_price);
+    }
+    
+    return sv_vol;
+}
+
+// Every parameter of a warm start seed has to be inside the model's domain
+static bool valid_seed(const HestonParams* p) {
+    return p->v0 > 0.0 && p->theta > 0.0 && p->kappa > 0.0 && p->sigma > 0.0 &&
+           p->rho > -1.0 && p->rho < 1.0;
+}
+
+// The seed first, then one step down and up along each parameter
+#define WARM_START_SETS 9
+
+static int warm_start_sets(const HestonParams* seed, HestonParams* sets) {
+    int n = 0;
+    
+    sets[n++] = *seed;
+    for (int dir = -1; dir <= 1; dir += 2) {
+        // v0 and theta move together so the variance term structure keeps its shape
+        HestonParams p = *seed;
+        p.v0 *= 1.0 + 0.05 * dir;
+        p.theta *= 1.0 + 0.05 * dir;
+        sets[n++] = p;
+        
+        p = *seed;
+        p.kappa *= (dir < 0) ? 0.8 : 1.25;
+        sets[n++] = p;
+        
+        p = *seed;
+        p.sigma *= 1.0 + 0.1 * dir;
+        sets[n++] = p;
+        
+        p = *seed;
+        p.rho = fmax(-0.95, fmin(0.95, p.rho + 0.05 * dir));
+        sets[n++] = p;
+    }
+    
+    return n;
+}
+
+#define COARSE_SEARCH_SETS (6 * 3 * 4 * 4)
+#define REFINED_SEARCH_SETS (3 * 3 * 3 * 3)
+
+// Starting point of the grid search for one option, from its Black-Scholes
+// volatility, moneyness and expiry. Single-option and chain calibrations both
+// seed here, so a strike gets the same result from either; strikes of a chain
+// with the same seed share every grid of their searches.
+static HestonParams search_seed(double bs_iv, double S, double K, double T, double r, double q) {
+    double var = bs_iv * bs_iv;
+
+    // Calculate moneyness (S/K adjusted for interest and dividends)
+    double moneyness = S * exp((r - q) * T) / K;
+    HestonParams seed = { var, 1.0, var, HESTON_DEFAULT_SIGMA, HESTON_DEFAULT_RHO };
+
+    // Make smarter initial guesses based on moneyness and time
+    if (moneyness > 1.1) {
+        // OTM call options often show higher volatility (volatility skew)
+        seed.v0 = var * 1.1;
+        seed.kappa = 2.0;
+        seed.theta = var * 1.05;
+    } else if (moneyness < 0.9) {
+        // ITM call options can also show different volatility patterns
+        seed.v0 = var * 1.05;
+        seed.kappa = 1.5;
+    }
+
+    // Time-based adjustments
+    if (T < 0.1) {
+        // Short-dated options typically have higher volatility of volatility
+        seed.kappa = 3.0; // Faster mean reversion for short-dated
+    } else if (T > 1.0) {
+        // Long-dated options often have lower vol-of-vol
+        seed.kappa = 0.5; // Slower mean reversion for long-dated
+    }
+
+    return seed;
+}
+
+// Coarse grid around a seed (6x3x4x4) in the serial search order, most
+// likely values first
+static int coarse_search_sets(const HestonParams* seed, HestonParams* sets) {
+    // Start with the BS estimate, then 10% lower and higher, 20%, 30% higher
+    const double v0_scale[] = {1.0, 0.9, 1.1, 0.8, 1.2, 1.3};
+    // Initial mean reversion, then faster and slower
+    const double kappa_scale[] = {1.0, 1.5, 0.5};
+    // Low to very high volatility of variance
+    const double sigma_values[] = {0.2, 0.4, 0.6, 0.8};
+    // Strong negative correlation (common for equities) to none
+    const double rho_values[] = {-0.7, -0.4, -0.2, 0.0};
+    int n = 0;
+
+    for (int a = 0; a < 6; a++) {
+        for (int b = 0; b < 3; b++) {
+            for (int c = 0; c < 4; c++) {
+                for (int d = 0; d < 4; d++) {
+                    HestonParams* p = &sets[n++];
+                    p->v0 = seed->v0 * v0_scale[a];
+                    p->theta = p->v0;  // Long-term variance equal to initial for simplicity
+                    p->kappa = seed->kappa * kappa_scale[b];
+                    p->sigma = sigma_values[c];
+                    p->rho = rho_values[d];
+                }
+            }
+        }
+    }
+
+    return n;
+}
+
+// Refined 3x3x3x3 grid within 10% of the best coarse set (0.1 in rho)
+static int refined_search_sets(const HestonParams* center, HestonParams* sets) {
+    const int REFINE_GRID = 3;
+    double v0_min = center->v0 * 0.9;
+    double v0_max = center->v0 * 1.1;
+    double kappa_min = center->kappa * 0.9;
+    double kappa_max = center->kappa * 1.1;
+    double sigma_min = center->sigma * 0.9;
+    double sigma_max = center->sigma * 1.1;
+    double rho_min = fmax(center->rho - 0.1, -0.95);
+    double rho_max = fmin(center->rho + 0.1, 0.95);
+    int n = 0;
+
+    for (int i = 0; i < REFINE_GRID; i++) {
+        for (int j = 0; j < REFINE_GRID; j++) {
+            for (int k = 0; k < REFINE_GRID; k++) {
+                for (int l = 0; l < REFINE_GRID; l++) {
+                    HestonParams* p = &sets[n++];
+                    p->v0 = v0_min + (v0_max - v0_min) * i / (REFINE_GRID - 1);
+                    p->theta = p->v0;
+                    p->kappa = kappa_min + (kappa_max - kappa_min) * j / (REFINE_GRID - 1);
+                    p->sigma = sigma_min + (sigma_max - sigma_min) * k / (REFINE_GRID - 1);
+                    p->rho = rho_min + (rho_max - rho_min) * l / (REFINE_GRID - 1);
+                }
+            }
+        }
+    }
+
+    return n;
+}
+
+// Whether every grid of an option's search is computed with the configured
+// FFT settings. Without a tuning table ctx_select_fft_parameters() adapts
+// them only for the cases is_challenging_parameter_set() flags, and the
+// search sets never reach its sigma and rho limits.
+static bool configured_fft_settings(double S, double K, double T) {
+    double moneyness = K / S;
+    return g_tuning == NULL && moneyness <= 3.0 && moneyness >= 0.3 && T >= 0.05;
+}
+
+// Estimate implied volatility from the Heston model, starting from the seed's
+// neighbourhood when one is given
+static double calibrate_sv(double market_price, double S, double K, double T, double r, double q,
+                           const HestonParams* seed, HestonFit* fit) {
+    // Calculate BS IV first as a reference point, with the solver the chain
+    // calibration uses
+    double bs_iv;
+    IVBatchInput bs_in = { &market_price, &S, &K, &T, &r, &q, NULL };
+    bs_implied_vol_batch(1, &bs_in, &bs_iv, NULL);
+    
+    // If BS IV calculation fails, return error
+    if (bs_iv < 0.0) {
+        if (g_debug) {
+            fprintf(stderr, "Debug: BS IV calculation failed, cannot proceed with SV\n");
+        }
+        return -1.0;
+    }
+    
+    if (g_debug) {
+        fprintf(stderr, "Debug: Black-Scholes IV: %.2f%%\n", bs_iv * 100);
+    }
+    
+    // Initial parameter guesses based on market characteristics
+    const HestonParams init = search_seed(bs_iv, S, K, T, r, q);
+    double init_v0 = init.v0;
+    double init_kappa = init.kappa;
+    double init_theta = init.theta;
+    
+    // Parameter calibration with more robust approach
+    double best_diff = DBL_MAX;
+    double best_v = init_v0;
+    double best_kappa = init_kappa;
+    double best_theta = init_theta;
+    double best_sigma = 0.4;  // Vol of vol
+    double best_rho = -0.7;   // Typical correlation for equity options
+    bool warm_started = false;
+    
+    // Multi-stage calibration. Grids the engine gave up on are skipped by the
+    // searches and answered once at the end with the fallback ladder.
+    ctx_take_status(&g_default_ctx);
+    
+    // A good enough fit near the seed skips the grid searches below
+    if (seed != NULL && valid_seed(seed)) {
+        HestonParams warm_sets[WARM_START_SETS];
+        int num_warm = warm_start_sets(seed, warm_sets);
+        SingleCalibration warm = {
+            market_price, S, K, T, r, q, 0.003, false, DBL_MAX, -1
+        };
+        CalibrationSweep warm_sweep = { warm_sets, num_warm, evaluate_single_set, &warm, 0, 0,
+                                        PTHREAD_MUTEX_INITIALIZER, NULL, false };
+        run_calibration_sweep(&warm_sweep);
+        
+        if (warm.best_index >= 0) {
+            best_v = warm_sets[warm.best_index].v0;
+            best_kappa = warm_sets[warm.best_index].kappa;
+            best_theta = warm_sets[warm.best_index].theta;
+            best_sigma = warm_sets[warm.best_index].sigma;
+            best_rho = warm_sets[warm.best_index].rho;
+            best_diff = warm.best_diff;
+            warm_started = best_diff <= g_warm_start_max_error * market_price;
+        }
+        
+        if (g_debug) {
+            fprintf(stderr, "Debug: Warm start %s (diff: $%.4f)\n",
+                    warm_started ? "accepted" : "rejected, running the full grid search", best_diff);
+        }
+    }
+    
+    if (!warm_started) {
+        // Grid search around the seed, most likely values first
+        HestonParams coarse_sets[COARSE_SEARCH_SETS];
+        int num_coarse = coarse_search_sets(&init, coarse_sets);
+        
+        // Sweep with early termination (tighter tolerance in v6)
+        // A rejected warm start still counts, so only better sets replace it
+        SingleCalibration cal = {
+            market_price, S, K, T, r, q, 0.003, false, best_diff, -1
+        };
+        CalibrationSweep sweep = { coarse_sets, num_coarse, evaluate_single_set, &cal, 0, 0,
+                                   PTHREAD_MUTEX_INITIALIZER, NULL, false };
+        bool found_good_match = run_calibration_sweep(&sweep);
+        
+        if (cal.best_index >= 0) {
+            best_v = coarse_sets[cal.best_index].v0;
+            best_kappa = coarse_sets[cal.best_index].kappa;
+            best_theta = coarse_sets[cal.best_index].theta;
+            best_sigma = coarse_sets[cal.best_index].sigma;
+            best_rho = coarse_sets[cal.best_index].rho;
+            best_diff = cal.best_diff;
+        }
+        
+        // If no good match found yet, try a refined search around the best parameters
+        if (!found_good_match && best_diff < 0.1 * market_price) {
+            if (g_debug) {
+                fprintf(stderr, "Debug: Performing refined search around best parameters\n");
+            }
+            
+            const HestonParams center = { best_v, best_kappa, best_theta, best_sigma, best_rho };
+            HestonParams refined_sets[REFINED_SEARCH_SETS];
+            int num_refined = refined_search_sets(&center, refined_sets);
+            
+            // Only sets that beat the coarse result count, so start from it
+            SingleCalibration refined = {
+                market_price, S, K, T, r, q, 0.002, true, best_diff, -1
+            };
+            CalibrationSweep refine_sweep = { refined_sets, num_refined, evaluate_single_set,
+                                              &refined, 0, 0, PTHREAD_MUTEX_INITIALIZER, NULL, false };
+            run_calibration_sweep(&refine_sweep);
+            
+            if (refined.best_index >= 0) {
+                best_v = refined_sets[refined.best_index].v0;
+                best_kappa = refined_sets[refined.best_index].kappa;
+                best_theta = refined_sets[refined.best_index].theta;
+                best_sigma = refined_sets[refined.best_index].sigma;
+                best_rho = refined_sets[refined.best_index].rho;
+                best_diff = refined.best_diff;
+            }
+        }
+    }
+    
+    FFTStatus status = ctx_take_status(&g_default_ctx);
+    if (status != FFT_STATUS_OK) {
+        fprintf(stderr, "Error: %s during SV calibration\n", fft_status_string(status));
+        warm_started = false;
+        
+        // Try again with reset FFT parameters
+        reset_fft_params_to_defaults();
+        
+        if (g_debug) {
+            fprintf(stderr, "Debug: Retrying calibration with reset parameters\n");
+        }
+        
+        // Try a simplified calibration with fewer combinations
+        double v0_values[] = {init_v0, init_v0 * 0.8, init_v0 * 1.2};
+        double kappa_values[] = {init_kappa};
+        double sigma_values[] = {0.2, 0.4};
+        double rho_values[] = {-0.7, -0.3};
+        
+        for (int i = 0; i < 3; i++) {
+            double test_v0 = v0_values[i];
+            double test_theta = test_v0;
+            
+            for (int j = 0; j < 1; j++) {
+                double test_kappa = kappa_values[j];
+                
+                for (int k = 0; k < 2; k++) {
+                    double test_sigma = sigma_values[k];
+                    
+                    for (int l = 0; l < 2; l++) {
+                        double test_rho = rho_values[l];
+                        
+                        // Calculate option price using current parameters
+                        double model_price = heston_call_fft(S, K, T, r, q, 
+                                                         test_v0, test_kappa, test_theta, 
+                                                         test_sigma, test_rho);
+                        
+                        // If model price calculation failed, skip this set
+                        if (model_price < 0.0 || !isfinite(model_price)) {
+                            continue;
+                        }
+                        
+                        // Calculate price difference
+                        double test_diff = fabs(model_price - market_price);
+                        
+                        // Update best parameters if this is better
+                        if (test_diff < best_diff) {
+                            best_v = test_v0;
+                            best_kappa = test_kappa;
+                            best_theta = test_theta;
+                            best_rho = test_rho;
+                            best_sigma = test_sigma;
+                            best_diff = test_diff;
+                        }
+                    }
+                }
+            }
+        }
+        
+        if (ctx_take_status(&g_default_ctx) != FFT_STATUS_OK) {
+            // If even the simplified calibration failed
+            if (g_use_bs_fallback) {
+                if (g_debug) {
+                    fprintf(stderr, "Debug: All calibration attempts failed, using BS IV\n");
+                }
+                PERF_COUNT(PERF_BS_FALLBACK);
+                return bs_iv;
+            } else {
+                if (g_debug) {
+                    fprintf(stderr, "Debug: All calibration attempts failed, returning error\n");
+                }
+                return -1.0;
+            }
+        }
+    }
+    
+    if (g_debug) {
+        fprintf(stderr, "Debug: Best parameters - v0: %.4f, kappa: %.1f, theta: %.4f, sigma: %.2f, rho: %.2f\n",
+                best_v, best_kappa, best_theta, best_sigma, best_rho);
+    }
+    
+    if (fit != NULL && best_diff < DBL_MAX) {
+        fit->params.v0 = best_v;
+        fit->params.kappa = best_kappa;
+        fit->params.theta = best_theta;
+        fit->params.sigma = best_sigma;
+        fit->params.rho = best_rho;
+        fit->fit_error = best_diff;
+        fit->warm_started = warm_started;
+    }
+    
+    return finalize_sv_vol(&g_default_ctx, market_price, S, K, T, r, q, bs_iv,
+                           best_v, best_kappa, best_sigma, best_rho, best_diff);
+}
+
+// Function to estimate implied volatility from the Heston model
+double implied_vol_sv(double market_price, double S, double K, double T, double r, double q) {
+    return calibrate_sv(market_price, S, K, T, r, q, NULL, NULL);
+}
+
+// Free allocated memory in FFT cache
+void cleanup_fft_cache(void) {
+    // Also cleans up precomputed values, here and in the sweep workers
+    ctx_release_cache(&g_default_ctx);
+    for (int i = 0; i < HESTON_FFT_MAX_THREADS; i++) {
+        if (g_sweep_contexts[i] != NULL) {
+            ctx_release_cache(g_sweep_contexts[i]);
+        }
+    }
+}
+
+/**
+ * @brief Read the current engine configuration
+ */
+void heston_fft_get_config(HestonFFTConfig* config) {
+    if (config == NULL) {
+        return;
+    }
+    
+    config->fft_n = g_default_ctx.fft_n;
+    config->log_strike_range = g_default_ctx.log_strike_range;
+    config->alpha = g_default_ctx.alpha;
+    config->eta = g_default_ctx.eta;
+    config->cache_tolerance = g_cache_tolerance;
+    config->max_calibration_attempts = g_max_calibration_attempts;
+    config->use_bs_fallback = g_use_bs_fallback;
+    config->debug = g_debug;
+    config->verbose_debug = g_verbose_debug;
+    config->planner = g_planner;
+    config->cache_max_bytes = g_cache_max_bytes;
+    config->threads = g_threads;
+    config->warm_start_max_error = g_warm_start_max_error;
+    config->spot_invariant = g_spot_invariant;
+#ifndef HESTON_NO_MIXED_PRECISION
+    config->mixed_precision = g_mixed_precision;
+#else
+    config->mixed_precision = false;
+#endif
+    config->backend = __atomic_load_n(&g_gpu_enabled, __ATOMIC_ACQUIRE) ? HESTON_BACKEND_GPU
+                                                                        : HESTON_BACKEND_CPU;
+    config->gpu_verify = g_gpu_verify;
+}
+
+/**
+ * @brief Replace the engine configuration
+ */
+void heston_fft_set_config(const HestonFFTConfig* config) {
+    if (config == NULL) {
+        return;
+    }
+    
+    g_default_ctx.fft_n = config->fft_n;
+    g_default_ctx.log_strike_range = config->log_strike_range;
+    g_default_ctx.alpha = config->alpha;
+    g_default_ctx.eta = config->eta;
+    g_cache_tolerance = config->cache_tolerance;
+    g_max_calibration_attempts = config->max_calibration_attempts;
+    g_use_bs_fallback = config->use_bs_fallback;
+    g_debug = config->debug || config->verbose_debug;
+    g_verbose_debug = config->verbose_debug;
+    
+    // Workers are spawned per sweep, so the count can change at any time
+    g_threads = config->threads;
+    if (g_threads < 1) g_threads = 1;
+    if (g_threads > HESTON_FFT_MAX_THREADS) g_threads = HESTON_FFT_MAX_THREADS;
+    g_warm_start_max_error = config->warm_start_max_error;
+    g_spot_invariant = config->spot_invariant;
+#ifndef HESTON_NO_MIXED_PRECISION
+    g_mixed_precision = config->mixed_precision;
+#endif
+    
+    // The device is probed once, the first time the GPU is asked for
+    bool gpu = false;
+    if (config->backend == HESTON_BACKEND_GPU) {
+        if (heston_gpu_available()) {
+            gpu = true;
+            if (g_debug) {
+                fprintf(stderr, "Debug: Chain grids are computed on %s\n", heston_gpu_device_name());
+            }
+        } else {
+            fprintf(stderr, "Warning: GPU backend unavailable (%s), computing grids on the CPU\n",
+                    heston_gpu_device_name());
+        }
+    }
+    __atomic_store_n(&g_gpu_enabled, gpu ? 1 : 0, __ATOMIC_RELEASE);
+    g_gpu_verify = config->gpu_verify;
+    
+    // A new tolerance re-keys the cache, so it drops the cached grids
+    g_cache_max_bytes = (config->cache_max_bytes > 0) ? config->cache_max_bytes
+                                                      : FFT_CACHE_DEFAULT_MAX_BYTES;
+    g_default_ctx.cache_max_bytes = g_cache_max_bytes;
+    if (g_default_ctx.grid_cache != NULL) {
+        fft_cache_set_limit(g_default_ctx.grid_cache, g_cache_max_bytes);
+        fft_cache_set_tolerance(g_default_ctx.grid_cache, g_cache_tolerance);
+        g_default_ctx.current_grid = NULL;
+    }
+    
+    // Plans made with other flags stay in the table; lookups match on the flags
+    g_planner = config->planner;
+    switch (config->planner) {
+        case HESTON_FFTW_MEASURE:
+            g_planner_flags = FFTW_MEASURE;
+            break;
+        case HESTON_FFTW_PATIENT:
+            g_planner_flags = FFTW_PATIENT;
+            break;
+        default:
+            g_planner = HESTON_FFTW_ESTIMATE;
+            g_planner_flags = FFTW_ESTIMATE;
+            break;
+    }
+}
+
+/**
+ * @brief Read the FFT grid cache counters
+ */
+void heston_fft_get_cache_stats(FFTCacheStats* stats) {
+    fft_cache_get_stats(g_default_ctx.grid_cache, stats);
+    if (stats != NULL && g_default_ctx.grid_cache == NULL) {
+        stats->max_bytes = g_cache_max_bytes;
+    }
+}
+
+/**
+ * @brief Read the counters of a context's grid cache
+ */
+void heston_fft_context_get_cache_stats(const HestonFFTContext* ctx, FFTCacheStats* stats) {
+    if (ctx == NULL) {
+        return;
+    }
+    fft_cache_get_stats(ctx->grid_cache, stats);
+    if (stats != NULL && ctx->grid_cache == NULL) {
+        stats->max_bytes = ctx->cache_max_bytes;
+    }
+}
+
+/**
+ * @brief Serialize FFTW planner calls made outside the FFT engine
+ */
+void heston_fft_planner_lock(void) {
+    pthread_mutex_lock(&g_planner_lock);
+}
+
+/**
+ * @brief Release the lock taken by heston_fft_planner_lock()
+ */
+void heston_fft_planner_unlock(void) {
+    pthread_mutex_unlock(&g_planner_lock);
+}
+
+/**
+ * @brief Load FFTW wisdom from a file
+ */
+int heston_fft_load_wisdom(const char* path) {
+    if (path == NULL) {
+        return -1;
+    }
+    
+    pthread_mutex_lock(&g_planner_lock);
+    int imported = fftw_import_wisdom_from_filename(path);
+    pthread_mutex_unlock(&g_planner_lock);
+    
+    if (!imported) {
+        if (g_debug) {
+            fprintf(stderr, "Debug: No usable FFTW wisdom in %s\n", path);
+        }
+        return -1;
+    }
+    
+    if (g_debug) {
+        fprintf(stderr, "Debug: Loaded FFTW wisdom from %s\n", path);
+    }
+    return 0;
+}
+
+/**
+ * @brief Save the accumulated FFTW wisdom to a file
+ */
+int heston_fft_save_wisdom(const char* path) {
+    if (path == NULL) {
+        return -1;
+    }
+    
+    pthread_mutex_lock(&g_planner_lock);
+    int exported = fftw_export_wisdom_to_filename(path);
+    pthread_mutex_unlock(&g_planner_lock);
+    
+    if (!exported) {
+        fprintf(stderr, "Warning: Could not write FFTW wisdom to %s\n", path);
+        return -1;
+    }
+    
+    if (g_debug) {
+        fprintf(stderr, "Debug: Saved FFTW wisdom to %s\n", path);
+    }
+    return 0;
+}
+
+/**
+ * @brief Load a table of tuned FFT settings, or drop the current one
+ */
+int heston_fft_load_tuning(const char* path) {
+    fft_tuning_free(g_tuning);
+    g_tuning = NULL;
+    
+    if (path == NULL) {
+        return 0;
+    }
+    
+    g_tuning = fft_tuning_load(path);
+    if (g_tuning == NULL) {
+        fprintf(stderr, "Warning: No usable FFT tuning table in %s, adapting FFT settings at run time\n",
+                path);
+        return -1;
+    }
+    
+    if (g_debug) {
+        fprintf(stderr, "Debug: Loaded FFT tuning table from %s (%d x %d x %d buckets, target %.1e)\n",
+                path, g_tuning->num_expiries, g_tuning->num_moneyness, g_tuning->num_vols,
+                g_tuning->target);
+    }
+    return 0;
+}
+
+// Replace the shared segment handle; the new one is NULL if path is NULL
+static int share_grids(const char* path, bool publish) {
+    grid_share_close(g_grid_share);
+    g_grid_share = NULL;
+    
+    if (path == NULL) {
+        return 0;
+    }
+    
+    g_grid_share = publish ? grid_share_create(path, 0, 0, g_cache_tolerance) : grid_share_open(path);
+    if (g_grid_share == NULL) {
+        fprintf(stderr, "Warning: Cannot %s shared FFT grids at %s, computing grids locally\n",
+                publish ? "publish" : "read", path);
+        return -1;
+    }
+    
+    if (g_debug) {
+        fprintf(stderr, "Debug: %s shared FFT grids at %s\n", publish ? "Publishing" : "Reading", path);
+    }
+    return 0;
+}
+
+/**
+ * @brief Publish every computed FFT grid in a shared segment
+ */
+int heston_fft_publish_grids(const char* path) {
+    return share_grids(path, true);
+}
+
+/**
+ * @brief Take FFT grids from a segment another process publishes to
+ */
+int heston_fft_read_shared_grids(const char* path) {
+    return share_grids(path, false);
+}
+
+/**
+ * @brief Destroy the persistent FFTW plans of the default context
+ */
+void heston_fft_cleanup_plans(void) {
+    ctx_release_plans(&g_default_ctx);
+    for (int i = 0; i < HESTON_FFT_MAX_THREADS; i++) {
+        if (g_sweep_contexts[i] != NULL) {
+            ctx_release_plans(g_sweep_contexts[i]);
+        }
+    }
+    heston_gpu_release();
+}
+
+/**
+ * @brief Full calculate_sv_v6 implied volatility procedure
+ */
+int heston_fft_implied_vol(double market_price, double S, double K, double T,
+                           double r, double q, double* iv_out) {
+    return heston_fft_implied_vol_seeded(market_price, S, K, T, r, q, NULL, iv_out, NULL);
+}
+
+/**
+ * @brief Full implied volatility procedure, warm-started from a seed
+ */
+int heston_fft_implied_vol_seeded(double market_price, double S, double K, double T,
+                                  double r, double q, const HestonParams* seed,
+                                  double* iv_out, HestonFit* fit) {
+    double iv = -1.0;
+    
+    if (fit != NULL) {
+        memset(fit, 0, sizeof(*fit));
+        fit->fit_error = -1.0;
+    }
+    
+    if (iv_out == NULL || market_price <= 0.0 || S <= 0.0 || K <= 0.0 || T <= 0.0) {
+        return -1;
+    }
+    
+    // Tuned FFT settings for the default parameters, or adapted ones if the
+    // parameter set is challenging
+    const HestonParams defaults = { HESTON_DEFAULT_V0, HESTON_DEFAULT_KAPPA, HESTON_DEFAULT_V0,
+                                    HESTON_DEFAULT_SIGMA, HESTON_DEFAULT_RHO };
+    ctx_select_fft_parameters(&g_default_ctx, S, K, T, &defaults);
+    
+    // calibrate_sv() answers the grid failures of its own searches; one still
+    // reported afterwards came from pricing the final fit
+    ctx_take_status(&g_default_ctx);
+    iv = calibrate_sv(market_price, S, K, T, r, q, seed, fit);
+    FFTStatus status = ctx_take_status(&g_default_ctx);
+    
+    if (status != FFT_STATUS_OK) {
+        if (g_debug) {
+            fprintf(stderr, "FFT failure during implied volatility calculation (%s)\n",
+                    fft_status_string(status));
+            fprintf(stderr, "Trying with alternative FFT parameters\n");
+        }
+        
+        // Try multiple alternative FFT parameter sets
+        bool success = false;
+        for (int attempt = 1; attempt <= g_max_calibration_attempts; attempt++) {
+            if (!try_alternate_fft_params(attempt)) {
+                break;  // No more alternative sets to try
+            }
+            
+            iv = calibrate_sv(market_price, S, K, T, r, q, seed, fit);
+            if (ctx_take_status(&g_default_ctx) == FFT_STATUS_OK && iv > 0.0) {
+                success = true;
+                break;
+            }
+        }
+        
+        // If all attempts failed and fallback is enabled, use Black-Scholes
+        if (!success) {
+            if (g_use_bs_fallback) {
+                if (g_debug) {
+                    fprintf(stderr, "All SV calibration attempts failed, falling back to Black-Scholes\n");
+                }
+                
+                // Fall back to Black-Scholes, nothing worth keeping as a seed
+                PERF_COUNT(PERF_BS_FALLBACK);
+                if (fit != NULL) {
+                    fit->fit_error = -1.0;
+                }
+                iv = bs_implied_vol(market_price, S, K, T, r, q);
+                
+                if (iv < 0.0) {
+                    // If BS IV also fails, use a reasonable default
+                    iv = 0.25;  // 25% is a reasonable default for most options
+                }
+            } else {
+                fprintf(stderr, "Error: All calibration attempts failed and fallback is disabled\n");
+                iv = -1.0;
+            }
+        }
+    }
+    
+    if (iv < 0.0) {
+        return -1;
+    }
+    
+    *iv_out = iv;
+    return 0;
+}
+
+// Best-so-far of a chain calibration sweep, one entry per strike
+typedef struct {
+    double S, T, r, q;
+    const double* strikes;
+    const double* prices;
+    int n;
+    const bool* member;         // Strikes taking part, NULL for every open strike
+    bool* done;                 // Strikes that are matched or already refined
+    double* best_diff;
+    HestonParams* best;
+    double tolerance;           // A strike is done once its difference is below tolerance * price
+    int open;                   // Participating strikes not done yet
+    int grids;                  // FFT grids computed
+} ChainCalibration;
+
+// Evaluate one Heston parameter set against every open strike of a chain.
+// A single FFT grid answers all strikes; strikes whose price difference drops
+// below tolerance * price are marked done and the sweep stops once none are left.
+static void evaluate_chain_set(CalibrationSweep* sweep, HestonFFTContext* ctx, int index) {
+    ChainCalibration* chain = (ChainCalibration*)sweep->data;
+    const HestonParams* p = &sweep->sets[index];
+    
+    PERF_COUNT(PERF_CALIBRATION_EVAL);
+    
+#ifndef HESTON_NO_MIXED_PRECISION
+    // Skip the double grid unless some open strike could improve on its
+    // screened price; a prefilled grid is already cheaper to read than a screen
+    const FFTGrid* screen = sweep->prefilled ? NULL
+                          : ctx_screen_grid(ctx, chain->S, chain->r, chain->q, chain->T, p);
+    if (screen != NULL) {
+        bool promising = false;
+        
+        pthread_mutex_lock(&sweep->lock);
+        for (int i = 0; i < chain->n && !promising; i++) {
+            if (chain->done[i] || (chain->member != NULL && !chain->member[i])) {
+                continue;
+            }
+            double margin;
+            double screened = ctx_screen_price(ctx, screen, chain->strikes[i], &margin);
+            promising = screened < 0.0 ||
+                        fabs(screened - chain->prices[i]) <= chain->best_diff[i] + margin;
+        }
+        pthread_mutex_unlock(&sweep->lock);
+        
+        if (!promising) {
+            PERF_COUNT(PERF_SCREEN_REJECT);
+            return;
+        }
+    }
+#endif
+    
+    FFTStatus status = ctx_init_fft_cache(ctx, chain->S, chain->r, chain->q, chain->T,
+                                          p->v0, p->kappa, p->theta, p->sigma, p->rho);
+    
+    if (status != FFT_STATUS_OK) {
+        if (g_verbose_debug) {
+            fprintf(stderr, "Debug: Chain grid failed (%s) for parameter set: v0=%.4f, kappa=%.1f, sigma=%.2f, rho=%.2f\n",
+                    fft_status_string(status), p->v0, p->kappa, p->sigma, p->rho);
+        }
+        ctx_fail(ctx, status);
+        return;
+    }
+    
+    // The grid is private to this context; only the per-strike bests are shared
+    pthread_mutex_lock(&sweep->lock);
+    chain->grids++;
+    
+    for (int i = 0; i < chain->n; i++) {
+        if (chain->done[i] || (chain->member != NULL && !chain->member[i])) {
+            continue;
+        }
+        
+        double model_price = ctx_get_cached_option_price(ctx, chain->strikes[i]);
+        if (model_price < 0.0 || !isfinite(model_price)) {
+            continue;
+        }
+        
+        double diff = fabs(model_price - chain->prices[i]);
+        if (diff < chain->best_diff[i]) {
+            chain->best_diff[i] = diff;
+            chain->best[i] = *p;
+            
+            if (diff < chain->tolerance * chain->prices[i]) {
+                chain->done[i] = true;
+                chain->open--;
+            }
+        }
+    }
+    
+    if (chain->open <= 0) {
+        __atomic_store_n(&sweep->stop, 1, __ATOMIC_RELEASE);
+    }
+    
+    pthread_mutex_unlock(&sweep->lock);
+}
+
+// Point a chain sweep at ctx (NULL for the worker threads) and, with the GPU
+// backend, build the grids of all its sets in one batch first. The sweep then
+// runs serially in the context holding them, each evaluation a cache hit.
+static void chain_sweep_prefill(CalibrationSweep* sweep, HestonFFTContext* ctx) {
+    const ChainCalibration* chain = (const ChainCalibration*)sweep->data;
+    HestonFFTContext* const target = (ctx != NULL) ? ctx : &g_default_ctx;
+    
+    sweep->ctx = ctx;
+    sweep->prefilled = false;
+    if (ctx_gpu_build_grids(target, chain->S, chain->r, chain->q, &chain->T, 0,
+                            sweep->sets, sweep->count) >= 0) {
+        sweep->ctx = target;
+        sweep->prefilled = true;
+    }
+}
+
+// Coarse and refined sweeps of a chain calibration from one seed, filling
+// best and best_diff for the strikes not done yet. Every strike sees the sets
+// and the order of its single-option search, with its own early stopping, so
+// it ends up with the same parameters. Sweeps run serially in ctx, or on the
+// worker threads when ctx is NULL. 'member' is scratch space for n flags.
+static void chain_search(HestonFFTContext* ctx, double S, double T, double r, double q,
+                         const double* strikes, const double* prices, int n,
+                         const HestonParams* seed, bool* done, bool* member,
+                         double* best_diff, HestonParams* best) {
+    HestonParams sets[COARSE_SEARCH_SETS];
+    
+    ChainCalibration chain = {
+        S, T, r, q, strikes, prices, n, NULL, done, best_diff, best, 0.003, 0, 0
+    };
+    CalibrationSweep sweep = { sets, 0, evaluate_chain_set, &chain, 0, 0,
+                               PTHREAD_MUTEX_INITIALIZER, ctx, false };
+    
+    for (int i = 0; i < n; i++) {
+        chain.open += !done[i];
+    }
+    const int group_size = chain.open;
+    
+    // Shared coarse grid: one FFT per parameter set for the whole group
+    sweep.count = coarse_search_sets(seed, sets);
+    if (chain.open > 0) {
+        chain_sweep_prefill(&sweep, ctx);
+        run_calibration_sweep(&sweep);
+    }
+    
+    // Refined search, run once per distinct best parameter set so that
+    // strikes sharing a starting point also share the refined grids
+    for (int i = 0; i < n; i++) {
+        if (done[i] || best_diff[i] >= 0.1 * prices[i]) {
+            continue;
+        }
+        
+        HestonParams center = best[i];
+        chain.open = 0;
+        for (int j = 0; j < n; j++) {
+            member[j] = !done[j] && best_diff[j] < 0.1 * prices[j] &&
+                        memcmp(&best[j], &center, sizeof(HestonParams)) == 0;
+            chain.open += member[j];
+        }
+        
+        chain.member = member;
+        chain.tolerance = 0.002;
+        sweep.count = refined_search_sets(&center, sets);
+        chain_sweep_prefill(&sweep, ctx);
+        run_calibration_sweep(&sweep);
+        
+        // Never refine a strike twice, even if nothing improved
+        for (int j = 0; j < n; j++) {
+            if (member[j]) {
+                done[j] = true;
+            }
+        }
+    }
+    
+    if (g_debug) {
+        fprintf(stderr, "Debug: Calibrated %d strikes from one seed with %d FFT grids\n",
+                group_size, chain.grids);
+    }
+}
+
+// FFT settings of a context, kept across the searches of a chain
+typedef struct {
+    int fft_n;
+    double log_strike_range;
+    double alpha;
+    double eta;
+} FFTSettings;
+
+static FFTSettings ctx_get_fft_settings(const HestonFFTContext* ctx) {
+    FFTSettings settings = { ctx->fft_n, ctx->log_strike_range, ctx->alpha, ctx->eta };
+    return settings;
+}
+
+static void ctx_set_fft_settings(HestonFFTContext* ctx, const FFTSettings* settings) {
+    ctx->fft_n = settings->fft_n;
+    ctx->log_strike_range = settings->log_strike_range;
+    ctx->alpha = settings->alpha;
+    ctx->eta = settings->eta;
+}
+
+// Chain calibration in ctx. Strikes are seeded as in the single-option
+// calibration and every group of strikes sharing a seed is searched on shared
+// grids. In the default context a strike whose FFT settings depend on the
+// option, or whose grids fail, is priced with the single-option procedure and
+// its retry ladder instead, so every strike gets heston_fft_implied_vol()'s
+// result. Other contexts sweep serially and finalize whatever their search found.
+static int chain_implied_vols(HestonFFTContext* ctx, double S, double T, double r, double q,
+                              const double* strikes, const double* prices,
+                              int n, double* ivs) {
+    const bool is_default = (ctx == &g_default_ctx);
+    
+    if (strikes == NULL || prices == NULL || ivs == NULL || n <= 0 || S <= 0.0 || T <= 0.0) {
+        return -1;
+    }
+    
+    // Per-option arrays live in the context's scratch workspace, widest types first
+    const size_t count = (size_t)n;
+    char* scratch = (char*)workspace_reserve(&ctx->scratch,
+                                             count * (6 * sizeof(double) + 2 * sizeof(HestonParams) +
+                                                      sizeof(IVStatus) + 5 * sizeof(bool)));
+    if (scratch == NULL) {
+        fprintf(stderr, "Error: Memory allocation for option chain failed\n");
+        return -1;
+    }
+    
+    double* bs_iv = (double*)scratch;
+    double* best_diff = bs_iv + count;
+    double* shared = best_diff + count;
+    HestonParams* best = (HestonParams*)(shared + 4 * count);
+    HestonParams* seed = best + count;
+    IVStatus* bs_status = (IVStatus*)(seed + count);
+    bool* done = (bool*)(bs_status + count);
+    bool* active = done + count;
+    bool* member = active + count;
+    bool* searched = member + count;
+    bool* individual = searched + count;
+    
+    // Black-Scholes reference vols for the whole chain in one vectorized solve
+    IVBatchInput bs_in = { prices, shared, strikes, shared + n, shared + 2 * n, shared + 3 * n, NULL };
+    for (int i = 0; i < n; i++) {
+        shared[i] = S;
+        shared[n + i] = T;
+        shared[2 * n + i] = r;
+        shared[3 * n + i] = q;
+    }
+    bs_implied_vol_batch(n, &bs_in, bs_iv, bs_status);
+    
+    for (int i = 0; i < n; i++) {
+        ivs[i] = -1.0;
+        active[i] = false;
+        searched[i] = false;
+        individual[i] = false;
+        best_diff[i] = DBL_MAX;
+        
+        if (prices[i] <= 0.0 || strikes[i] <= 0.0) {
+            continue;
+        }
+        
+        if (bs_status[i] != IV_OK) {
+            if (g_debug) {
+                fprintf(stderr, "Debug: BS IV calculation failed for strike %.2f (%s), skipping\n",
+                        strikes[i], bs_iv_status_string(bs_status[i]));
+            }
+            continue;
+        }
+        
+        active[i] = true;
+        seed[i] = search_seed(bs_iv[i], S, strikes[i], T, r, q);
+        best[i] = seed[i];
+        individual[i] = is_default && !configured_fft_settings(S, strikes[i], T);
+    }
+    
+    // The searches start from the settings the chain was handed
+    const FFTSettings settings = ctx_get_fft_settings(ctx);
+    
+    for (int i = 0; i < n; i++) {
+        if (!active[i] || individual[i] || searched[i]) {
+            continue;
+        }
+        
+        int members = 0;
+        for (int j = 0; j < n; j++) {
+            bool in_group = active[j] && !individual[j] && !searched[j] &&
+                            memcmp(&seed[j], &seed[i], sizeof(HestonParams)) == 0;
+            done[j] = !in_group;
+            searched[j] = searched[j] || in_group;
+            members += in_group;
+        }
+        
+        // A no-op for the strikes on configured settings
+        ctx_set_fft_settings(ctx, &settings);
+        ctx_select_fft_parameters(ctx, S, strikes[i], T, &seed[i]);
+        
+        ctx_take_status(ctx);
+        chain_search(is_default ? NULL : ctx, S, T, r, q, strikes, prices, n,
+                     &seed[i], done, member, best_diff, best);
+        
+        // The single-option procedure runs in the default context only
+        FFTStatus status = ctx_take_status(ctx);
+        if (status != FFT_STATUS_OK && is_default) {
+            if (g_debug) {
+                fprintf(stderr, "FFT failure during chain calibration (%s), pricing %d strikes individually\n",
+                        fft_status_string(status), members);
+            }
+            for (int j = 0; j < n; j++) {
+                individual[j] = individual[j] ||
+                                (active[j] && memcmp(&seed[j], &seed[i], sizeof(HestonParams)) == 0);
+            }
+        }
+    }
+    
+    int failures = 0;
+    for (int i = 0; i < n; i++) {
+        if (!active[i]) {
+            failures++;
+            continue;
+        }
+        
+        ctx_set_fft_settings(ctx, &settings);
+        if (!individual[i]) {
+            ctx_take_status(ctx);
+            ivs[i] = finalize_sv_vol(ctx, prices[i], S, strikes[i], T, r, q, bs_iv[i],
+                                     best[i].v0, best[i].kappa, best[i].sigma,
+                                     best[i].rho, best_diff[i]);
+            
+            // A failed final grid is retried by the single-option procedure
+            individual[i] = ctx_take_status(ctx) != FFT_STATUS_OK && is_default;
+        }
+        
+        if (individual[i]) {
+            // Fall back to the single-option procedure with its retry ladder
+            double iv;
+            ctx_set_fft_settings(ctx, &settings);
+            ivs[i] = (heston_fft_implied_vol(prices[i], S, strikes[i], T, r, q, &iv) == 0) ? iv : -1.0;
+        }
+        
+        if (ivs[i] < 0.0) {
+            failures++;
+        }
+    }
+    
+    ctx_set_fft_settings(ctx, &settings);
+    return failures;
+}
+
+/**
+ * @brief Calibrate a whole option chain sharing (S, T, r, q) with one FFT grid per parameter set
+ */
+int heston_fft_implied_vol_chain(double S, double T, double r, double q,
+                                 const double* strikes, const double* prices,
+                                 int n, double* ivs) {
+    return chain_implied_vols(&g_default_ctx, S, T, r, q, strikes, prices, n, ivs);
+}
+
+/**
+ * @brief Chain calibration in a caller-owned context
+ */
+int heston_fft_context_implied_vol_chain(HestonFFTContext* ctx, double S, double T, double r, double q,
+                                         const double* strikes, const double* prices,
+                                         int n, double* ivs) {
+    if (ctx == NULL) {
+        return -1;
+    }
+    return chain_implied_vols(ctx, S, T, r, q, strikes, prices, n, ivs);
+}
+
+/**
+ * @brief Heston prices and Greeks for a chain sharing (S, T, r, q) from the cached FFT grid
+ */
+int heston_fft_greeks_chain(double S, double T, double r, double q, const HestonParams* params,
+                            const double* strikes, int n, OptionType option_type,
+                            PricingResult* results) {
+    return heston_fft_context_greeks_chain(&g_default_ctx, S, T, r, q, params, strikes, n,
+                                           option_type, results);
+}
+
+/**
+ * @brief Chain Greeks in a caller-owned context
+ */
+int heston_fft_context_greeks_chain(HestonFFTContext* ctx, double S, double T, double r, double q,
+                                    const HestonParams* params, const double* strikes, int n,
+                                    OptionType option_type, PricingResult* results) {
+    int failures = 0;
+    
+    if (ctx == NULL || params == NULL || strikes == NULL || results == NULL || n <= 0 || S <= 0.0 || T <= 0.0 ||
+        (option_type != OPTION_CALL && option_type != OPTION_PUT)) {
+        return -1;
+    }
+    
+    const double dividend_discount = exp(-q * T);
+    const double discount = exp(-r * T);
+    
+    for (int i = 0; i < n; i++) {
+        PricingResult* result = &results[i];
+        const double K = strikes[i];
+        
+        memset(result, 0, sizeof(PricingResult));
+        
+        if (!(K > 0.0)) {
+            result->error_code = ERROR_INVALID_PARAMETER;
+            failures++;
+            continue;
+        }
+        
+        // Selects (or builds) the price grid; later strikes normally hit it
+        double call = ctx_heston_call_fft(ctx, S, K, T, r, q, params->v0, params->kappa,
+                                          params->theta, params->sigma, params->rho);
+        if (call < 0.0 || !isfinite(call)) {
+            result->error_code = ERROR_CALCULATION_FAILED;
+            failures++;
+            continue;
+        }
+        
+        // No grid means the price came from the Black-Scholes fallback
+        if (!ctx_init_grid_sensitivities(ctx, r, q, T, params)) {
+            if (g_debug) {
+                fprintf(stderr, "Debug: No FFT sensitivities for strike %.2f\n", K);
+            }
+            result->error_code = ERROR_GREEKS_CALCULATION;
+            failures++;
+            continue;
+        }
+        
+        double c_x = ctx_get_cached_sensitivity(ctx, FFT_GRID_DX, K);
+        double c_xx = ctx_get_cached_sensitivity(ctx, FFT_GRID_DXX, K);
+        double c_v0 = ctx_get_cached_sensitivity(ctx, FFT_GRID_DV0, K);
+        double c_T = ctx_get_cached_sensitivity(ctx, FFT_GRID_DT, K);
+        
+        // x = log S, so dC/dS = C_x / S and d2C/dS2 = (C_xx - C_x) / S^2. The
+        // price depends on r through the forward and the discount factor
+        // only, which gives rho = T (S delta - C) without another transform.
+        result->delta = c_x / S;
+        result->gamma = (c_xx - c_x) / (S * S);
+        result->vega = 2.0 * sqrt(params->v0) * c_v0;
+        result->theta = -c_T;
+        result->rho = T * (c_x - call);
+        
+        if (option_type == OPTION_PUT) {
+            // Put-call parity: P = C - S exp(-qT) + K exp(-rT)
+            result->price = fmax(0.0, call - S * dividend_discount + K * discount);
+            result->delta -= dividend_discount;
+            result->theta += r * K * discount - q * S * dividend_discount;
+            result->rho -= T * K * discount;
+        } else {
+            result->price = call;
+        }
+        
+        result->implied_volatility = sqrt(params->v0);
+        result->error_code = ERROR_NONE;
+    }
+    
+    return failures;
+}
+
+// Price an option or compute its implied volatility in ctx. Only the default
+// context has the single-option calibration; others calibrate a chain of one.
+static int ctx_price_option(HestonFFTContext* ctx, double S, double K, double T, double r, double q,
+                            const HestonParams* params, OptionType option_type,
+                            double market_price, PricingResult* result) {
+    if (result == NULL) {
+        return ERROR_INVALID_PARAMETER;
+    }
+    
+    memset(result, 0, sizeof(PricingResult));
+    
+    if (S <= 0.0 || K <= 0.0 || T <= 0.0 ||
+        (option_type != OPTION_CALL && option_type != OPTION_PUT)) {
+        result->error_code = ERROR_INVALID_PARAMETER;
+        return result->error_code;
+    }
+    
+    // Put-call parity offset: C - P = S*exp(-qT) - K*exp(-rT)
+    double parity = S * exp(-q * T) - K * exp(-r * T);
+    
+    if (market_price > 0) {
+        /* Implied volatility calculation on the equivalent call price */
+        double call_price = (option_type == OPTION_CALL) ? market_price : market_price + parity;
+        double iv = -1.0;
+        
+        if (ctx == &g_default_ctx) {
+            if (heston_fft_implied_vol(call_price, S, K, T, r, q, &iv) != 0) {
+                iv = -1.0;
+            }
+        } else {
+            chain_implied_vols(ctx, S, T, r, q, &K, &call_price, 1, &iv);
+        }
+        if (iv < 0.0) {
+            result->error_code = ERROR_VOLATILITY_CALCULATION;
+            return result->error_code;
+        }
+        
+        result->implied_volatility = iv;
+        result->price = market_price;
+    } else {
+        /* Option pricing with known Heston parameters */
+        HestonParams p;
+        
+        if (params != NULL) {
+            p = *params;
+        } else {
+            p.v0 = HESTON_DEFAULT_V0;
+            p.kappa = HESTON_DEFAULT_KAPPA;
+            p.theta = HESTON_DEFAULT_V0;
+            p.sigma = HESTON_DEFAULT_SIGMA;
+            p.rho = HESTON_DEFAULT_RHO;
+        }
+        
+        double call_price = ctx_heston_call_fft(ctx, S, K, T, r, q, p.v0, p.kappa, p.theta, p.sigma, p.rho);
+        if (call_price < 0.0 || !isfinite(call_price)) {
+            result->error_code = ERROR_CALCULATION_FAILED;
+            return result->error_code;
+        }
+        
+        result->price = (option_type == OPTION_CALL) ? call_price : fmax(0.0, call_price - parity);
+        result->implied_volatility = sqrt(p.v0);
+    }
+    
+    result->error_code = ERROR_NONE;
+    return ERROR_NONE;
+}
+
+/**
+ * @brief Price an option (or compute its implied volatility) with the FFT engine
+ */
+int heston_fft_price_option(double S, double K, double T, double r, double q,
+                            const HestonParams* params, OptionType option_type,
+                            double market_price, PricingResult* result) {
+    return ctx_price_option(&g_default_ctx, S, K, T, r, q, params, option_type, market_price, result);
+}
+
+/**
+ * @brief Option pricing in a caller-owned context
+ */
+int heston_fft_context_price_option(HestonFFTContext* ctx, double S, double K, double T, double r,
+                                    double q, const HestonParams* params, OptionType option_type,
+                                    double market_price, PricingResult* result) {
+    if (ctx == NULL) {
+        if (result != NULL) {
+            memset(result, 0, sizeof(PricingResult));
+            result->error_code = ERROR_INVALID_PARAMETER;
+        }
+        return ERROR_INVALID_PARAMETER;
+    }
+    return ctx_price_option(ctx, S, K, T, r, q, params, option_type, market_price, result);
+}
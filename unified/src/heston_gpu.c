@@ -0,0 +1,276 @@
+/**
+ * @file heston_gpu.c
+ * @brief Optional CUDA backend for batches of Carr-Madan FFT grids
+ *
+ * Host side of the backend: device probe, grow-only device buffers, a small
+ * table of batched cuFFT plans and the copies in and out. One stream and one
+ * lock serialize every batch, so pricing threads can share the device. The
+ * kernels live in heston_gpu_kernels.cu. Built without HESTON_WITH_CUDA the
+ * file reduces to stubs that report no device.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+
+#include "../include/heston_gpu.h"
+
+#ifdef HESTON_WITH_CUDA
+
+#include <cuda_runtime_api.h>
+#include <cufft.h>
+
+#include "../include/heston_gpu_kernels.h"
+
+/* Batched plans kept at once, one per (size, batch) pair */
+#define GPU_MAX_PLANS 8
+
+typedef struct {
+    int n;              /* Transform size, 0 for a free slot */
+    int batch;          /* Transforms per execution */
+    cufftHandle plan;
+} GPUPlanSlot;
+
+typedef struct {
+    pthread_mutex_t lock;
+    cudaStream_t stream;
+    double* d_in;           /* Complex FFT inputs, transformed in place */
+    size_t in_values;
+    double* d_params;       /* HESTON_GPU_GRID_VALUES per grid */
+    double* d_out;          /* Gathered real parts */
+    size_t out_values;
+    GPUPlanSlot plans[GPU_MAX_PLANS];
+    int next_plan_victim;
+    double params[HESTON_GPU_MAX_BATCH * HESTON_GPU_GRID_VALUES]; /* Host staging */
+} GPUState;
+
+static GPUState g_gpu = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+static pthread_once_t g_probe_once = PTHREAD_ONCE_INIT;
+static bool g_available = false;
+static char g_device_name[256] = "no CUDA device";
+
+static void probe_device(void) {
+    int devices = 0;
+    cudaError_t err = cudaGetDeviceCount(&devices);
+    if (err != cudaSuccess || devices <= 0) {
+        snprintf(g_device_name, sizeof(g_device_name), "no CUDA device (%s)",
+                 (err != cudaSuccess) ? cudaGetErrorString(err) : "none found");
+        return;
+    }
+
+    struct cudaDeviceProp prop;
+    if (cudaGetDeviceProperties(&prop, 0) != cudaSuccess) {
+        return;
+    }
+    snprintf(g_device_name, sizeof(g_device_name), "%s", prop.name);
+    g_available = true;
+}
+
+bool heston_gpu_available(void) {
+    pthread_once(&g_probe_once, probe_device);
+    return g_available;
+}
+
+const char* heston_gpu_device_name(void) {
+    pthread_once(&g_probe_once, probe_device);
+    return g_device_name;
+}
+
+/* Report a CUDA runtime error; true if err is one */
+static bool cuda_failed(cudaError_t err, const char* what) {
+    if (err == cudaSuccess) {
+        return false;
+    }
+    fprintf(stderr, "Error: CUDA %s failed: %s\n", what, cudaGetErrorString(err));
+    return true;
+}
+
+/* Grow a device buffer to at least values doubles; the contents are lost */
+static bool reserve_device(double** buffer, size_t* capacity, size_t values) {
+    if (*buffer != NULL && *capacity >= values) {
+        return true;
+    }
+    if (*buffer != NULL) {
+        cudaFree(*buffer);
+        *buffer = NULL;
+        *capacity = 0;
+    }
+    if (cuda_failed(cudaMalloc((void**)buffer, values * sizeof(double)), "allocation")) {
+        *buffer = NULL;
+        return false;
+    }
+    *capacity = values;
+    return true;
+}
+
+/* Batched in-place plan for batch transforms of n points, created on first
+ * use; slots are recycled round-robin once the table is full */
+static GPUPlanSlot* get_plan(int n, int batch) {
+    for (int i = 0; i < GPU_MAX_PLANS; i++) {
+        if (g_gpu.plans[i].n == n && g_gpu.plans[i].batch == batch) {
+            return &g_gpu.plans[i];
+        }
+    }
+
+    GPUPlanSlot* slot = NULL;
+    for (int i = 0; i < GPU_MAX_PLANS && slot == NULL; i++) {
+        if (g_gpu.plans[i].n == 0) {
+            slot = &g_gpu.plans[i];
+        }
+    }
+    if (slot == NULL) {
+        slot = &g_gpu.plans[g_gpu.next_plan_victim];
+        g_gpu.next_plan_victim = (g_gpu.next_plan_victim + 1) % GPU_MAX_PLANS;
+        cufftDestroy(slot->plan);
+        slot->n = 0;
+    }
+
+    if (cufftPlan1d(&slot->plan, n, CUFFT_Z2Z, batch) != CUFFT_SUCCESS) {
+        fprintf(stderr, "Error: Failed to create cuFFT plan for %d x N=%d\n", batch, n);
+        return NULL;
+    }
+    if (cufftSetStream(slot->plan, g_gpu.stream) != CUFFT_SUCCESS) {
+        cufftDestroy(slot->plan);
+        return NULL;
+    }
+    slot->n = n;
+    slot->batch = batch;
+    return slot;
+}
+
+/* One launch of at most HESTON_GPU_MAX_BATCH grids; the lock is held */
+static int run_batch(const HestonGPUFill* fill, const HestonGPUGrid* grids, int count,
+                     int first, int width, double* out) {
+    const size_t n = (size_t)fill->fft_n;
+
+    if (!reserve_device(&g_gpu.d_in, &g_gpu.in_values, 2 * n * count) ||
+        !reserve_device(&g_gpu.d_out, &g_gpu.out_values, (size_t)width * count)) {
+        return -1;
+    }
+    GPUPlanSlot* slot = get_plan(fill->fft_n, count);
+    if (slot == NULL) {
+        return -1;
+    }
+
+    for (int g = 0; g < count; g++) {
+        double* p = &g_gpu.params[g * HESTON_GPU_GRID_VALUES];
+        p[0] = grids[g].T;
+        p[1] = grids[g].params.v0;
+        p[2] = grids[g].params.kappa;
+        p[3] = grids[g].params.theta;
+        p[4] = grids[g].params.sigma;
+        p[5] = grids[g].params.rho;
+    }
+
+    if (cuda_failed(cudaMemcpyAsync(g_gpu.d_params, g_gpu.params,
+                                    (size_t)count * HESTON_GPU_GRID_VALUES * sizeof(double),
+                                    cudaMemcpyHostToDevice, g_gpu.stream), "parameter copy") ||
+        cuda_failed((cudaError_t)heston_gpu_launch_fill(fill, g_gpu.d_params, count, g_gpu.d_in,
+                                                        g_gpu.stream), "fill kernel")) {
+        return -1;
+    }
+
+    cufftDoubleComplex* data = (cufftDoubleComplex*)g_gpu.d_in;
+    if (cufftExecZ2Z(slot->plan, data, data, CUFFT_FORWARD) != CUFFT_SUCCESS) {
+        fprintf(stderr, "Error: cuFFT execution failed for %d x N=%d\n", count, fill->fft_n);
+        return -1;
+    }
+
+    if (cuda_failed((cudaError_t)heston_gpu_launch_gather(g_gpu.d_in, fill->fft_n, count, first,
+                                                          width, g_gpu.d_out, g_gpu.stream),
+                    "gather kernel") ||
+        cuda_failed(cudaMemcpyAsync(out, g_gpu.d_out, (size_t)width * count * sizeof(double),
+                                    cudaMemcpyDeviceToHost, g_gpu.stream), "result copy") ||
+        cuda_failed(cudaStreamSynchronize(g_gpu.stream), "batch")) {
+        return -1;
+    }
+    return 0;
+}
+
+int heston_gpu_carr_madan(int fft_n, double eta, double alpha, double S, double r, double q,
+                          const HestonGPUGrid* grids, int count, int first, int width,
+                          double* out) {
+    if (grids == NULL || out == NULL || count <= 0 || fft_n < 2 || (fft_n & (fft_n - 1)) != 0 ||
+        first < 0 || width <= 0 || first + width > fft_n || !(eta > 0.0) || !(S > 0.0)) {
+        return -1;
+    }
+    if (!heston_gpu_available()) {
+        return -1;
+    }
+
+    const HestonGPUFill fill = { fft_n, eta, alpha, log(S), r, q };
+    int result = 0;
+
+    pthread_mutex_lock(&g_gpu.lock);
+    if (g_gpu.stream == NULL && cuda_failed(cudaStreamCreate(&g_gpu.stream), "stream creation")) {
+        g_gpu.stream = NULL;
+        result = -1;
+    }
+    if (result == 0 && g_gpu.d_params == NULL &&
+        cuda_failed(cudaMalloc((void**)&g_gpu.d_params, sizeof(g_gpu.params)), "allocation")) {
+        g_gpu.d_params = NULL;
+        result = -1;
+    }
+
+    for (int done = 0; result == 0 && done < count; done += HESTON_GPU_MAX_BATCH) {
+        int batch = count - done;
+        if (batch > HESTON_GPU_MAX_BATCH) {
+            batch = HESTON_GPU_MAX_BATCH;
+        }
+        result = run_batch(&fill, grids + done, batch, first, width, out + (size_t)done * width);
+    }
+    pthread_mutex_unlock(&g_gpu.lock);
+
+    return result;
+}
+
+void heston_gpu_release(void) {
+    pthread_mutex_lock(&g_gpu.lock);
+    for (int i = 0; i < GPU_MAX_PLANS; i++) {
+        if (g_gpu.plans[i].n != 0) {
+            cufftDestroy(g_gpu.plans[i].plan);
+        }
+    }
+    memset(g_gpu.plans, 0, sizeof(g_gpu.plans));
+    g_gpu.next_plan_victim = 0;
+
+    cudaFree(g_gpu.d_in);
+    cudaFree(g_gpu.d_out);
+    cudaFree(g_gpu.d_params);
+    g_gpu.d_in = g_gpu.d_out = g_gpu.d_params = NULL;
+    g_gpu.in_values = g_gpu.out_values = 0;
+
+    if (g_gpu.stream != NULL) {
+        cudaStreamDestroy(g_gpu.stream);
+        g_gpu.stream = NULL;
+    }
+    pthread_mutex_unlock(&g_gpu.lock);
+}
+
+#else /* !HESTON_WITH_CUDA */
+
+bool heston_gpu_available(void) {
+    return false;
+}
+
+const char* heston_gpu_device_name(void) {
+    return "not built with CUDA (make GPU=cuda)";
+}
+
+int heston_gpu_carr_madan(int fft_n, double eta, double alpha, double S, double r, double q,
+                          const HestonGPUGrid* grids, int count, int first, int width,
+                          double* out) {
+    (void)fft_n; (void)eta; (void)alpha; (void)S; (void)r; (void)q;
+    (void)grids; (void)count; (void)first; (void)width; (void)out;
+    return -1;
+}
+
+void heston_gpu_release(void) {
+}
+
+#endif /* HESTON_WITH_CUDA */
@@ -0,0 +1,176 @@
+/**
+ * @file heston_gpu_kernels.cu
+ * @brief CUDA kernels of the GPU grid backend: Carr-Madan FFT input and output gather
+ *
+ * The fill kernel runs one thread per (node, grid) and repeats the
+ * arithmetic of cf_eval_parts() and heston_cf_carr_madan_fill() in
+ * heston_cf_simd.c step by step on (re, im) pairs, with the device's
+ * double-precision exp, log, sincos and atan2 in place of the Cephes
+ * polynomials. Only built with GPU=cuda.
+ */
+
+#include <cuda_runtime.h>
+#include <math.h>
+#include <float.h>
+
+#include "../include/heston_gpu_kernels.h"
+
+#define GPU_PI 3.14159265358979323846
+
+/* Threads per block of both kernels */
+#define GPU_BLOCK 256
+
+/* ---- Complex helpers on (re, im) pairs, as in heston_cf_simd.c ---- */
+
+__device__ static inline void cx_div(double ar, double ai, double br, double bi, double* zr, double* zi) {
+    double inv = 1.0 / (br * br + bi * bi);
+    *zr = (ar * br + ai * bi) * inv;
+    *zi = (ai * br - ar * bi) * inv;
+}
+
+__device__ static inline void cx_exp(double ar, double ai, double* zr, double* zi) {
+    double m = exp(ar);
+    double s, c;
+    sincos(ai, &s, &c);
+    *zr = m * c;
+    *zi = m * s;
+}
+
+__device__ static inline void cx_log(double ar, double ai, double* zr, double* zi) {
+    *zr = 0.5 * log(ar * ar + ai * ai);
+    *zi = atan2(ai, ar);
+}
+
+/* Principal square root, as csqrt() */
+__device__ static inline void cx_sqrt(double ar, double ai, double* zr, double* zi) {
+    double mod = sqrt(fabs(ar * ar + ai * ai));
+    double t = sqrt(fabs(0.5 * (mod + fabs(ar))));
+    double other = 0.5 * fabs(ai) / (t > DBL_MIN ? t : DBL_MIN);
+    *zr = ar >= 0.0 ? t : other;
+    *zi = ar >= 0.0 ? copysign(other, ai) : copysign(t, ai);
+}
+
+__device__ static inline bool is_finite2(double a, double b) {
+    return (fabs(a) <= DBL_MAX) & (fabs(b) <= DBL_MAX);
+}
+
+/* Heston CF at phi with i*phi = (x, y); mirrors cf_heston() */
+__device__ static void cf_eval(double x, double y, double log_S, double v0, double kappa,
+                               double theta, double sigma, double rho, double drift_T, double T,
+                               double* cr, double* ci) {
+    double rs = rho * sigma;
+    double s2 = sigma * sigma;
+
+    /* b = kappa - rho sigma i phi, d = sqrt(b^2 - sigma^2 i phi (i phi - 1)) */
+    double br = kappa - rs * x;
+    double bi = -rs * y;
+    double d2r = br * br - bi * bi - s2 * (x * x - x - y * y);
+    double d2i = 2.0 * br * bi - s2 * y * (2.0 * x - 1.0);
+    double dr, di;
+    cx_sqrt(d2r, d2i, &dr, &di);
+
+    double bmr = br - dr, bmi = bi - di;
+    double gr, gi;
+    cx_div(bmr, bmi, br + dr, bi + di, &gr, &gi);
+
+    double er, ei;
+    cx_exp(-dr * T, -di * T, &er, &ei);
+
+    /* 1 - g e and 1 - g */
+    double numr = 1.0 - (gr * er - gi * ei);
+    double numi = -(gr * ei + gi * er);
+    double qr, qi;
+    cx_div(numr, numi, 1.0 - gr, -gi, &qr, &qi);
+    double lr, li;
+    cx_log(qr, qi, &lr, &li);
+
+    double kts = kappa * theta / s2;
+    double Ar = drift_T * x + kts * (bmr * T - 2.0 * lr);
+    double Ai = drift_T * y + kts * (bmi * T - 2.0 * li);
+
+    /* B = (b - d)(1 - e) / (sigma^2 (1 - g e)) */
+    double tr = bmr * (1.0 - er) + bmi * ei;
+    double ti = bmi * (1.0 - er) - bmr * ei;
+    double Br, Bi;
+    cx_div(tr, ti, s2 * numr, s2 * numi, &Br, &Bi);
+
+    double zr, zi;
+    cx_exp(Ar + Br * v0 + x * log_S, Ai + Bi * v0 + y * log_S, &zr, &zi);
+
+    /* cf_heston() falls back to 1 for non-finite intermediates */
+    bool ok = is_finite2(gr, gi) & is_finite2(Ar, Ai) & is_finite2(Br, Bi);
+    *cr = ok ? zr : 1.0;
+    *ci = ok ? zi : 0.0;
+}
+
+/* ---- Kernels ---- */
+
+/* Node blockIdx.x * blockDim.x + threadIdx.x of grid blockIdx.y */
+__global__ static void carr_madan_fill(HestonGPUFill fill, const double* __restrict__ params,
+                                       double* __restrict__ in) {
+    const int i = blockIdx.x * blockDim.x + threadIdx.x;
+    const int g = blockIdx.y;
+    if (i >= fill.fft_n) {
+        return;
+    }
+
+    const double* p = params + (size_t)g * HESTON_GPU_GRID_VALUES;
+    const double T = p[0];
+    const double alpha = fill.alpha;
+
+    /* Node, Simpson weight and phase shift, as ctx_precompute_fft_values() */
+    double v = i * fill.eta;
+    if (fabs(v) < 1e-10) v = 1e-10;
+    const double w = ((i == 0) ? 1.0 / 3.0 : ((i % 2 == 1) ? 4.0 / 3.0 : 2.0 / 3.0)) * fill.eta;
+    const double log_strike0 = fill.log_S - GPU_PI / fill.eta;
+    double shr, shi;
+    sincos(-v * log_strike0, &shi, &shr);
+    if (!is_finite2(shr, shi)) {
+        shr = 1.0;
+        shi = 0.0;
+    }
+
+    /* phi = v - (alpha + 1) i, so i phi = (alpha + 1) + i v */
+    double cr, ci;
+    cf_eval(alpha + 1.0, v, fill.log_S, p[1], p[2], p[3], p[4], p[5],
+            (fill.r - fill.q) * T, T, &cr, &ci);
+
+    const double discount = exp(-fill.r * T);
+    double mr, mi;
+    cx_div(discount * cr, discount * ci, alpha * alpha + alpha - v * v, (2.0 * alpha + 1.0) * v,
+           &mr, &mi);
+
+    bool ok = is_finite2(mr, mi);
+    mr = ok ? mr * w : 0.0;
+    mi = ok ? mi * w : 0.0;
+
+    double* out = in + 2 * ((size_t)g * fill.fft_n + i);
+    out[0] = mr * shr - mi * shi;
+    out[1] = mr * shi + mi * shr;
+}
+
+__global__ static void gather_real(const double* __restrict__ in, int fft_n, int first, int width,
+                                   double* __restrict__ out) {
+    const int i = blockIdx.x * blockDim.x + threadIdx.x;
+    const int g = blockIdx.y;
+    if (i >= width) {
+        return;
+    }
+    out[(size_t)g * width + i] = in[2 * ((size_t)g * fft_n + first + i)];
+}
+
+/* ---- Launchers (C linkage, called from heston_gpu.c) ---- */
+
+extern "C" int heston_gpu_launch_fill(const HestonGPUFill* fill, const double* params, int count,
+                                      double* in, void* stream) {
+    dim3 blocks((fill->fft_n + GPU_BLOCK - 1) / GPU_BLOCK, count);
+    carr_madan_fill<<<blocks, GPU_BLOCK, 0, (cudaStream_t)stream>>>(*fill, params, in);
+    return (int)cudaGetLastError();
+}
+
+extern "C" int heston_gpu_launch_gather(const double* in, int fft_n, int count, int first, int width,
+                                        double* out, void* stream) {
+    dim3 blocks((width + GPU_BLOCK - 1) / GPU_BLOCK, count);
+    gather_real<<<blocks, GPU_BLOCK, 0, (cudaStream_t)stream>>>(in, fft_n, first, width, out);
+    return (int)cudaGetLastError();
+}
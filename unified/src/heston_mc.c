@@ -0,0 +1,1031 @@
+/**
+ * @file heston_mc.c
+ * @brief Quasi-Monte Carlo pricing engine for the Heston model
+ *
+ * One QE step (Andersen 2008) over dt, with m and s^2 the conditional mean
+ * and variance of the next variance and psi = s^2 / m^2:
+ *
+ *     psi <= 1.5:  V' = a (b + Z_v)^2,  b^2 = 2/psi - 1 + sqrt(2/psi (2/psi - 1)),  a = m / (1 + b^2)
+ *     psi >  1.5:  V' = 0 if U <= p, else ln((1 - p) / (1 - U)) / beta
+ *                  with p = (psi - 1) / (psi + 1), beta = (1 - p) / m, U = N(Z_v)
+ *
+ *     ln S' = ln S + (r - q) dt + K0* + K1 V + K2 V' + sqrt(K3 V + K4 V') Z_s
+ *
+ * where K0* is chosen so that E[S' | S, V] = S exp((r - q) dt) exactly
+ * (section 7 of the paper), which keeps the forward unbiased at any step.
+ *
+ * A block of paths needs two normals per step. In quasi-random mode,
+ * dimensions 2i and 2i + 1 of the Sobol point feed the i-th Brownian bridge
+ * node of the variance and spot drivers.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "../include/heston_mc.h"
+#include "../include/heston_cos.h"
+#include "../include/error_handling.h"
+#include "../include/perf_stats.h"
+
+#ifndef M_SQRT1_2
+#define M_SQRT1_2 0.70710678118654752440
+#endif
+
+/* Switch between the quadratic and exponential QE branches */
+#define QE_PSI_CRITICAL 1.5
+
+/* Sobol dimensions: two drivers per step */
+#define MC_MAX_DIMS (2 * HESTON_MC_MAX_STEPS)
+#define SOBOL_BITS 32
+
+/* Bounds of the sqrt(v0) search in heston_mc_price_option() */
+#define MC_IV_MIN 1e-3
+#define MC_IV_MAX 5.0
+#define MC_IV_TOL 1e-6
+#define MC_IV_MAX_ITERATIONS 60
+
+/* Longstaff-Schwartz basis: 1, x, x^2, v, x v with x = S / K, v = V / theta */
+#define LSM_BASIS 5
+
+/*
+ * Initial direction numbers (Joe & Kuo 2008) of dimensions 1 to 12, whose
+ * primitive polynomials are the first ones found in the order searched below.
+ * Later dimensions use odd numbers from a fixed generator.
+ */
+static const unsigned sobol_initial[12][5] = {
+    {1}, {1, 3}, {1, 3, 1}, {1, 1, 1}, {1, 1, 3, 3}, {1, 3, 5, 13},
+    {1, 1, 5, 5, 17}, {1, 1, 5, 5, 5}, {1, 1, 7, 11, 19}, {1, 1, 5, 1, 1},
+    {1, 1, 1, 3, 11}, {1, 3, 5, 5, 31}
+};
+
+static uint32_t g_sobol_directions[MC_MAX_DIMS][SOBOL_BITS];
+static pthread_once_t g_sobol_once = PTHREAD_ONCE_INIT;
+
+/* Brownian bridge construction order (Jaeckel), on unit time steps */
+typedef struct {
+    int* bridge_index;
+    int* left_index;
+    int* right_index;
+    double* left_weight;
+    double* right_weight;
+    double* std_dev;
+} BrownianBridge;
+
+/* One pricing run, shared by the workers */
+typedef struct {
+    double S, K, T, r, q;
+    HestonParams p;
+    OptionType option_type;
+    HestonMCConfig config;
+
+    int steps;
+    int dims;
+    int paths;
+    int blocks;
+    int blocks_per_replicate;
+    int points_per_block;       /* Sobol points or random draws per block */
+
+    double discount;            /* exp(-rT) */
+    double log_barrier;
+
+    /* QE constants of one step */
+    double drift, exp_kdt, var_c1, var_c2;
+    double k0, k1, k2, k3, k4;
+
+    BrownianBridge bridge;
+    uint32_t* shifts;           /* Digital shift per replicate and dimension */
+
+    double* payoff;             /* Discounted payoff per path (undiscounted exercise value when Bermudan) */
+    double* control;            /* Discounted control per path */
+    double* spot_store;         /* Bermudan: spot at the end of every step, [step][path] */
+    double* var_store;          /* Bermudan: variance at the end of every step, [step][path] */
+
+    int next_block;
+    pthread_mutex_t lock;
+} MCJob;
+
+/* Per-thread buffers for one block */
+typedef struct {
+    double* normals;      /* Sobol normals, [dim][path] */
+    double* drivers;      /* Normal increments, [driver][step][path] */
+    double* log_spot;
+    double* variance;
+    double* average;
+    double* alive;
+    uint32_t* sobol;      /* Current Sobol point, one word per dimension */
+} MCScratch;
+
+/* ---- Random numbers ---- */
+
+static uint64_t splitmix64(uint64_t* state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static uint64_t rotl64(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+/* xoshiro256** */
+static uint64_t xoshiro_next(uint64_t s[4]) {
+    const uint64_t result = rotl64(s[1] * 5, 7) * 9;
+    const uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl64(s[3], 45);
+
+    return result;
+}
+
+/* The stream of a block depends only on the seed and the block */
+static void xoshiro_seed(uint64_t s[4], uint64_t seed, uint64_t stream) {
+    uint64_t state = seed ^ (stream * 0xD1B54A32D192ED03ULL);
+    for (int i = 0; i < 4; i++) {
+        s[i] = splitmix64(&state);
+    }
+}
+
+/* Uniform in (0, 1) from the top 53 bits */
+static double uniform_open(uint64_t bits) {
+    return ((double)(bits >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+}
+
+/* Inverse normal CDF (Acklam), relative error below 1.2e-9 */
+static double inverse_normal(double u) {
+    static const double a[6] = {
+        -3.969683028665376e+01, 2.209460984245205e+02, -2.759285104469687e+02,
+        1.383577518672690e+02, -3.066479806614716e+01, 2.506628277459239e+00
+    };
+    static const double b[5] = {
+        -5.447609879822406e+01, 1.615858368580409e+02, -1.556989798598866e+02,
+        6.680131188771972e+01, -1.328068155288572e+01
+    };
+    static const double c[6] = {
+        -7.784894002430293e-03, -3.223964580411365e-01, -2.400758277161838e+00,
+        -2.549732539343734e+00, 4.374664141464968e+00, 2.938163982698783e+00
+    };
+    static const double d[4] = {
+        7.784695709041462e-03, 3.224671290700398e-01, 2.445134137142996e+00,
+        3.754408661907416e+00
+    };
+    const double low = 0.02425;
+
+    if (u < low || u > 1.0 - low) {
+        double t = sqrt(-2.0 * log(u < low ? u : 1.0 - u));
+        double x = (((((c[0] * t + c[1]) * t + c[2]) * t + c[3]) * t + c[4]) * t + c[5]) /
+                   ((((d[0] * t + d[1]) * t + d[2]) * t + d[3]) * t + 1.0);
+        return u < low ? x : -x;
+    }
+
+    double t = u - 0.5;
+    double t2 = t * t;
+    return (((((a[0] * t2 + a[1]) * t2 + a[2]) * t2 + a[3]) * t2 + a[4]) * t2 + a[5]) * t /
+           (((((b[0] * t2 + b[1]) * t2 + b[2]) * t2 + b[3]) * t2 + b[4]) * t2 + 1.0);
+}
+
+/* ---- Sobol sequence ---- */
+
+/* Whether x^degree + ... + 1 (bits of poly) is primitive over GF(2) */
+static bool is_primitive(uint32_t poly, int degree) {
+    const uint32_t period = (1u << degree) - 1;
+    uint32_t y = 1;
+
+    for (uint32_t k = 1; k <= period; k++) {
+        y <<= 1;
+        if (y & (1u << degree)) {
+            y ^= poly;
+        }
+        if (y == 1) {
+            return k == period;
+        }
+    }
+    return false;
+}
+
+static void init_sobol_directions(void) {
+    uint64_t state = 0x5EED5EED5EED5EEDULL;
+    int dim = 1;
+
+    for (int b = 0; b < SOBOL_BITS; b++) {
+        g_sobol_directions[0][b] = 1u << (SOBOL_BITS - 1 - b);
+    }
+
+    for (int degree = 1; dim < MC_MAX_DIMS; degree++) {
+        for (uint32_t a = 0; a < (1u << (degree - 1)) && dim < MC_MAX_DIMS; a++) {
+            uint32_t poly = (1u << degree) | (a << 1) | 1u;
+            if (!is_primitive(poly, degree)) {
+                continue;
+            }
+
+            uint32_t* v = g_sobol_directions[dim];
+            for (int k = 0; k < degree; k++) {
+                uint32_t m;
+                if (dim <= 12) {
+                    m = sobol_initial[dim - 1][k];
+                } else {
+                    m = ((uint32_t)splitmix64(&state) & ((1u << (k + 1)) - 1)) | 1u;
+                }
+                v[k] = m << (SOBOL_BITS - 1 - k);
+            }
+
+            /* Bratley-Fox recurrence; a holds the inner coefficients, highest degree first */
+            for (int k = degree; k < SOBOL_BITS; k++) {
+                uint32_t next = v[k - degree] ^ (v[k - degree] >> degree);
+                for (int i = 1; i < degree; i++) {
+                    if ((a >> (degree - 1 - i)) & 1u) {
+                        next ^= v[k - i];
+                    }
+                }
+                v[k] = next;
+            }
+            dim++;
+        }
+    }
+}
+
+/*
+ * Normals of Sobol points first .. first + count - 1 (Gray code order)
+ * into normals[d * stride + j]
+ */
+static void sobol_normals(const MCJob* job, const uint32_t* shift, uint32_t first, int count,
+                          uint32_t* x, double* normals, int stride) {
+    const uint32_t gray = first ^ (first >> 1);
+
+    for (int d = 0; d < job->dims; d++) {
+        x[d] = 0;
+        for (int b = 0; b < SOBOL_BITS; b++) {
+            if ((gray >> b) & 1u) {
+                x[d] ^= g_sobol_directions[d][b];
+            }
+        }
+    }
+
+    for (int j = 0; j < count; j++) {
+        for (int d = 0; d < job->dims; d++) {
+            double u = ((double)(x[d] ^ shift[d]) + 0.5) * (1.0 / 4294967296.0);
+            normals[(size_t)d * stride + j] = inverse_normal(u);
+        }
+
+        /* The next point flips the direction of the lowest zero bit of the index */
+        uint32_t n = first + (uint32_t)j;
+        int c = 0;
+        while ((n >> c) & 1u) {
+            c++;
+        }
+        if (c < SOBOL_BITS) {
+            for (int d = 0; d < job->dims; d++) {
+                x[d] ^= g_sobol_directions[d][c];
+            }
+        }
+    }
+}
+
+/* ---- Brownian bridge ---- */
+
+static int bridge_init(BrownianBridge* bb, int n) {
+    int* map = calloc((size_t)n, sizeof(int));
+    bb->bridge_index = malloc(3 * (size_t)n * sizeof(int));
+    bb->left_weight = malloc(3 * (size_t)n * sizeof(double));
+    if (map == NULL || bb->bridge_index == NULL || bb->left_weight == NULL) {
+        free(map);
+        free(bb->bridge_index);
+        free(bb->left_weight);
+        bb->bridge_index = NULL;
+        bb->left_weight = NULL;
+        return ERROR_MEMORY_ALLOCATION;
+    }
+    bb->left_index = bb->bridge_index + n;
+    bb->right_index = bb->bridge_index + 2 * n;
+    bb->right_weight = bb->left_weight + n;
+    bb->std_dev = bb->left_weight + 2 * n;
+
+    /* Times are 1 .. n, so the increments come out as standard normals */
+    map[n - 1] = 1;
+    bb->bridge_index[0] = n - 1;
+    bb->left_index[0] = bb->right_index[0] = 0;
+    bb->left_weight[0] = bb->right_weight[0] = 0.0;
+    bb->std_dev[0] = sqrt((double)n);
+
+    for (int i = 1, j = 0; i < n; i++) {
+        while (map[j]) {
+            j++;
+        }
+        int k = j;
+        while (!map[k]) {
+            k++;
+        }
+        int l = j + ((k - 1 - j) >> 1);
+        map[l] = i;
+        bb->bridge_index[i] = l;
+        bb->left_index[i] = j;
+        bb->right_index[i] = k;
+
+        /* t_m = m + 1, and W(0) = 0 left of the first node */
+        double tl = (double)j;
+        double tm = (double)(l + 1);
+        double tr = (double)(k + 1);
+        bb->left_weight[i] = (tr - tm) / (tr - tl);
+        bb->right_weight[i] = (tm - tl) / (tr - tl);
+        bb->std_dev[i] = sqrt((tm - tl) * (tr - tm) / (tr - tl));
+
+        j = k + 1;
+        if (j >= n) {
+            j = 0;
+        }
+    }
+
+    free(map);
+    return ERROR_NONE;
+}
+
+static void bridge_free(BrownianBridge* bb) {
+    free(bb->bridge_index);
+    free(bb->left_weight);
+}
+
+/*
+ * Build the paths of one driver from its normals (input i is the row
+ * in + i * in_stride) and leave the unit increments in out[step * width]
+ */
+static void bridge_apply(const BrownianBridge* bb, int n, const double* in, size_t in_stride,
+                         double* out, int width) {
+    double* last = out + (size_t)(n - 1) * width;
+    for (int p = 0; p < width; p++) {
+        last[p] = bb->std_dev[0] * in[p];
+    }
+
+    for (int i = 1; i < n; i++) {
+        const double* z = in + (size_t)i * in_stride;
+        double* w = out + (size_t)bb->bridge_index[i] * width;
+        const double* right = out + (size_t)bb->right_index[i] * width;
+        const double rw = bb->right_weight[i];
+        const double sd = bb->std_dev[i];
+
+        if (bb->left_index[i] > 0) {
+            const double* left = out + (size_t)(bb->left_index[i] - 1) * width;
+            const double lw = bb->left_weight[i];
+            for (int p = 0; p < width; p++) {
+                w[p] = lw * left[p] + rw * right[p] + sd * z[p];
+            }
+        } else {
+            for (int p = 0; p < width; p++) {
+                w[p] = rw * right[p] + sd * z[p];
+            }
+        }
+    }
+
+    for (int i = n - 1; i > 0; i--) {
+        double* w = out + (size_t)i * width;
+        const double* prev = out + (size_t)(i - 1) * width;
+        for (int p = 0; p < width; p++) {
+            w[p] -= prev[p];
+        }
+    }
+}
+
+/* ---- Simulation ---- */
+
+static void scratch_free(MCScratch* s) {
+    free(s->normals);
+    free(s->drivers);
+    free(s->log_spot);
+    free(s->sobol);
+}
+
+static int scratch_init(MCScratch* s, const MCJob* job) {
+    const size_t column = HESTON_MC_BLOCK * sizeof(double);
+
+    memset(s, 0, sizeof(MCScratch));
+    s->normals = job->config.quasi_random ? malloc((size_t)job->dims * column) : NULL;
+    s->drivers = malloc((size_t)job->dims * column);
+    s->log_spot = malloc(4 * column);
+    s->sobol = malloc((size_t)job->dims * sizeof(uint32_t));
+    if ((job->config.quasi_random && s->normals == NULL) || s->drivers == NULL ||
+        s->log_spot == NULL || s->sobol == NULL) {
+        scratch_free(s);
+        return ERROR_MEMORY_ALLOCATION;
+    }
+    s->variance = s->log_spot + HESTON_MC_BLOCK;
+    s->average = s->log_spot + 2 * HESTON_MC_BLOCK;
+    s->alive = s->log_spot + 3 * HESTON_MC_BLOCK;
+    return ERROR_NONE;
+}
+
+/* Standard normal drivers of one block into s->drivers, [driver][step][path] */
+static void block_drivers(const MCJob* job, int block, MCScratch* s) {
+    const int B = HESTON_MC_BLOCK;
+    const int count = job->points_per_block;
+    const int steps = job->steps;
+
+    if (job->config.quasi_random) {
+        int replicate = block / job->blocks_per_replicate;
+        uint32_t first = (uint32_t)(block % job->blocks_per_replicate) * (uint32_t)count;
+        sobol_normals(job, job->shifts + (size_t)replicate * job->dims, first, count,
+                      s->sobol, s->normals, B);
+    } else {
+        uint64_t state[4];
+        xoshiro_seed(state, job->config.seed, (uint64_t)block);
+        for (int d = 0; d < job->dims; d++) {
+            double* row = s->drivers + (size_t)d * B;
+            for (int j = 0; j < count; j++) {
+                row[j] = inverse_normal(uniform_open(xoshiro_next(state)));
+            }
+        }
+    }
+
+    double* z = job->config.quasi_random ? s->normals : s->drivers;
+    if (job->config.antithetic) {
+        for (int d = 0; d < job->dims; d++) {
+            double* row = z + (size_t)d * B;
+            for (int j = 0; j < count; j++) {
+                row[count + j] = -row[j];
+            }
+        }
+    }
+
+    if (job->config.quasi_random) {
+        /* Dimension 2i + k is bridge node i of driver k */
+        for (int k = 0; k < 2; k++) {
+            bridge_apply(&job->bridge, steps, z + (size_t)k * B, 2 * (size_t)B,
+                         s->drivers + (size_t)k * steps * B, B);
+        }
+    }
+}
+
+/* One QE step of every path of a block */
+static void qe_step(const MCJob* job, const double* zv, const double* zs,
+                    double* log_spot, double* variance) {
+    const double theta = job->p.theta;
+    const double A = job->k2 + 0.5 * job->k4;
+    const double k13 = job->k1 + 0.5 * job->k3;
+
+    for (int p = 0; p < HESTON_MC_BLOCK; p++) {
+        const double v = variance[p];
+        const double m = theta + (v - theta) * job->exp_kdt;
+        const double psi = (v * job->var_c1 + job->var_c2) / (m * m);
+        double vn, k0;
+
+        if (psi <= QE_PSI_CRITICAL) {
+            double inv = 2.0 / psi;
+            double b2 = inv - 1.0 + sqrt(inv * (inv - 1.0));
+            double a = m / (1.0 + b2);
+            double x = sqrt(b2) + zv[p];
+            vn = a * x * x;
+            k0 = (2.0 * A * a < 1.0)
+                ? -A * b2 * a / (1.0 - 2.0 * A * a) + 0.5 * log(1.0 - 2.0 * A * a) - k13 * v
+                : job->k0;
+        } else {
+            double prob = (psi - 1.0) / (psi + 1.0);
+            double beta = (1.0 - prob) / m;
+            double u = 0.5 * erfc(-zv[p] * M_SQRT1_2);
+            vn = (u <= prob) ? 0.0 : log((1.0 - prob) / (1.0 - u)) / beta;
+            k0 = (A < beta) ? -log(prob + beta * (1.0 - prob) / (beta - A)) - k13 * v : job->k0;
+        }
+
+        log_spot[p] += job->drift + k0 + job->k1 * v + job->k2 * vn +
+                       sqrt(job->k3 * v + job->k4 * vn) * zs[p];
+        variance[p] = vn;
+    }
+}
+
+static void simulate_block(const MCJob* job, int block, MCScratch* s) {
+    const int B = HESTON_MC_BLOCK;
+    const int steps = job->steps;
+    const size_t base = (size_t)block * B;
+    const HestonMCPayoff payoff = job->config.payoff;
+    const double log_spot0 = log(job->S);
+
+    block_drivers(job, block, s);
+
+    for (int p = 0; p < B; p++) {
+        s->log_spot[p] = log_spot0;
+        s->variance[p] = job->p.v0;
+        s->average[p] = 0.0;
+        s->alive[p] = 1.0;
+    }
+    if ((payoff == HESTON_MC_UP_AND_OUT && log_spot0 >= job->log_barrier) ||
+        (payoff == HESTON_MC_DOWN_AND_OUT && log_spot0 <= job->log_barrier)) {
+        for (int p = 0; p < B; p++) {
+            s->alive[p] = 0.0;
+        }
+    }
+
+    for (int i = 0; i < steps; i++) {
+        qe_step(job, s->drivers + (size_t)i * B, s->drivers + (size_t)(steps + i) * B,
+                s->log_spot, s->variance);
+
+        switch (payoff) {
+            case HESTON_MC_ASIAN:
+                for (int p = 0; p < B; p++) {
+                    s->average[p] += exp(s->log_spot[p]);
+                }
+                break;
+            case HESTON_MC_UP_AND_OUT:
+                for (int p = 0; p < B; p++) {
+                    s->alive[p] = (s->log_spot[p] < job->log_barrier) ? s->alive[p] : 0.0;
+                }
+                break;
+            case HESTON_MC_DOWN_AND_OUT:
+                for (int p = 0; p < B; p++) {
+                    s->alive[p] = (s->log_spot[p] > job->log_barrier) ? s->alive[p] : 0.0;
+                }
+                break;
+            case HESTON_MC_BERMUDAN: {
+                double* spot = job->spot_store + (size_t)i * job->paths + base;
+                double* var = job->var_store + (size_t)i * job->paths + base;
+                for (int p = 0; p < B; p++) {
+                    spot[p] = exp(s->log_spot[p]);
+                    var[p] = s->variance[p];
+                }
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    const double K = job->K;
+    const double sign = (job->option_type == OPTION_CALL) ? 1.0 : -1.0;
+    double* payoffs = job->payoff + base;
+    double* controls = job->control + base;
+
+    for (int p = 0; p < B; p++) {
+        double ST = exp(s->log_spot[p]);
+        double vanilla = fmax(sign * (ST - K), 0.0);
+        double value;
+
+        switch (payoff) {
+            case HESTON_MC_ASIAN:
+                value = fmax(sign * (s->average[p] / steps - K), 0.0);
+                break;
+            case HESTON_MC_UP_AND_OUT:
+            case HESTON_MC_DOWN_AND_OUT:
+                value = s->alive[p] * vanilla;
+                break;
+            default:
+                value = vanilla;
+                break;
+        }
+
+        /* The Bermudan exercise values are discounted by the backward induction */
+        payoffs[p] = (payoff == HESTON_MC_BERMUDAN) ? value : job->discount * value;
+        controls[p] = job->discount * ((payoff == HESTON_MC_EUROPEAN) ? ST : vanilla);
+    }
+}
+
+static void* mc_worker(void* arg) {
+    MCJob* job = arg;
+    MCScratch scratch;
+
+    /* Blocks left by a worker without buffers are taken by the others */
+    if (scratch_init(&scratch, job) != ERROR_NONE) {
+        return NULL;
+    }
+
+    for (;;) {
+        pthread_mutex_lock(&job->lock);
+        int block = job->next_block++;
+        pthread_mutex_unlock(&job->lock);
+        if (block >= job->blocks) {
+            break;
+        }
+        simulate_block(job, block, &scratch);
+    }
+
+    scratch_free(&scratch);
+    return NULL;
+}
+
+/* ---- Longstaff-Schwartz ---- */
+
+/* Solve the n x n system a x = b (a is overwritten); false if singular */
+static bool solve_linear(double a[LSM_BASIS][LSM_BASIS], double b[LSM_BASIS], int n) {
+    for (int c = 0; c < n; c++) {
+        int pivot = c;
+        for (int i = c + 1; i < n; i++) {
+            if (fabs(a[i][c]) > fabs(a[pivot][c])) {
+                pivot = i;
+            }
+        }
+        if (fabs(a[pivot][c]) < 1e-12) {
+            return false;
+        }
+        if (pivot != c) {
+            for (int k = 0; k < n; k++) {
+                double t = a[c][k];
+                a[c][k] = a[pivot][k];
+                a[pivot][k] = t;
+            }
+            double t = b[c];
+            b[c] = b[pivot];
+            b[pivot] = t;
+        }
+        for (int i = c + 1; i < n; i++) {
+            double f = a[i][c] / a[c][c];
+            for (int k = c; k < n; k++) {
+                a[i][k] -= f * a[c][k];
+            }
+            b[i] -= f * b[c];
+        }
+    }
+    for (int c = n - 1; c >= 0; c--) {
+        for (int k = c + 1; k < n; k++) {
+            b[c] -= a[c][k] * b[k];
+        }
+        b[c] /= a[c][c];
+    }
+    return true;
+}
+
+static void lsm_basis(double x, double v, double phi[LSM_BASIS]) {
+    phi[0] = 1.0;
+    phi[1] = x;
+    phi[2] = x * x;
+    phi[3] = v;
+    phi[4] = x * v;
+}
+
+/* Turn the exercise values at expiry into discounted Bermudan cash flows */
+static void longstaff_schwartz(const MCJob* job) {
+    const double step_discount = exp(-job->r * job->T / job->steps);
+    const double sign = (job->option_type == OPTION_CALL) ? 1.0 : -1.0;
+    const double K = job->K;
+    const double var_scale = 1.0 / job->p.theta;
+    double* cash = job->payoff;
+
+    for (int i = job->steps - 2; i >= 0; i--) {
+        const double* spot = job->spot_store + (size_t)i * job->paths;
+        const double* var = job->var_store + (size_t)i * job->paths;
+        double ata[LSM_BASIS][LSM_BASIS] = {{0.0}};
+        double aty[LSM_BASIS] = {0.0};
+        double phi[LSM_BASIS];
+        int in_the_money = 0;
+
+        for (int p = 0; p < job->paths; p++) {
+            cash[p] *= step_discount;
+            if (sign * (spot[p] - K) <= 0.0) {
+                continue;
+            }
+            lsm_basis(spot[p] / K, var[p] * var_scale, phi);
+            for (int a = 0; a < LSM_BASIS; a++) {
+                for (int b = 0; b < LSM_BASIS; b++) {
+                    ata[a][b] += phi[a] * phi[b];
+                }
+                aty[a] += phi[a] * cash[p];
+            }
+            in_the_money++;
+        }
+
+        if (in_the_money < 4 * LSM_BASIS || !solve_linear(ata, aty, LSM_BASIS)) {
+            continue;
+        }
+
+        for (int p = 0; p < job->paths; p++) {
+            double exercise = sign * (spot[p] - K);
+            if (exercise <= 0.0) {
+                continue;
+            }
+            lsm_basis(spot[p] / K, var[p] * var_scale, phi);
+            double continuation = 0.0;
+            for (int a = 0; a < LSM_BASIS; a++) {
+                continuation += aty[a] * phi[a];
+            }
+            if (exercise > continuation) {
+                cash[p] = exercise;
+            }
+        }
+    }
+
+    for (int p = 0; p < job->paths; p++) {
+        cash[p] *= step_discount;
+    }
+}
+
+/* ---- Driver ---- */
+
+void heston_mc_default_config(HestonMCConfig* config) {
+    if (config == NULL) {
+        return;
+    }
+    memset(config, 0, sizeof(HestonMCConfig));
+    config->payoff = HESTON_MC_EUROPEAN;
+    config->quasi_random = true;
+    config->antithetic = true;
+    config->control_variate = true;
+    config->seed = 0x4D43u;
+}
+
+static int online_processors(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return (n > 0) ? (int)n : 1;
+}
+
+/* Known value of the control of every path */
+static int control_price(const MCJob* job, double* value) {
+    if (job->config.payoff == HESTON_MC_EUROPEAN) {
+        *value = job->S * exp(-job->q * job->T);
+        return ERROR_NONE;
+    }
+    return heston_cos_price_chain(job->S, job->T, job->r, job->q, &job->p, &job->K, 1,
+                                  job->option_type, 0, value);
+}
+
+/* Replicate estimates with a pooled control coefficient */
+static int reduce_paths(const MCJob* job, double control_value, HestonMCResult* result) {
+    const int per_replicate = job->paths / HESTON_MC_REPLICATES;
+    double mean_y = 0.0, mean_c = 0.0;
+
+    for (int p = 0; p < job->paths; p++) {
+        if (!isfinite(job->payoff[p]) || !isfinite(job->control[p])) {
+            return ERROR_CALCULATION_FAILED;
+        }
+        mean_y += job->payoff[p];
+        mean_c += job->control[p];
+    }
+    mean_y /= job->paths;
+    mean_c /= job->paths;
+
+    double beta = 0.0;
+    if (job->config.control_variate) {
+        double cov = 0.0, var = 0.0;
+        for (int p = 0; p < job->paths; p++) {
+            double dc = job->control[p] - mean_c;
+            cov += (job->payoff[p] - mean_y) * dc;
+            var += dc * dc;
+        }
+        beta = (var > 0.0) ? cov / var : 0.0;
+    }
+
+    double estimates[HESTON_MC_REPLICATES];
+    double price = 0.0;
+    for (int k = 0; k < HESTON_MC_REPLICATES; k++) {
+        double y = 0.0, c = 0.0;
+        for (int p = k * per_replicate; p < (k + 1) * per_replicate; p++) {
+            y += job->payoff[p];
+            c += job->control[p];
+        }
+        estimates[k] = y / per_replicate - beta * (c / per_replicate - control_value);
+        price += estimates[k];
+    }
+    price /= HESTON_MC_REPLICATES;
+
+    double spread = 0.0;
+    for (int k = 0; k < HESTON_MC_REPLICATES; k++) {
+        spread += (estimates[k] - price) * (estimates[k] - price);
+    }
+
+    result->price = price;
+    result->std_error = sqrt(spread / (HESTON_MC_REPLICATES * (HESTON_MC_REPLICATES - 1.0)));
+    return ERROR_NONE;
+}
+
+static void job_free(MCJob* job) {
+    bridge_free(&job->bridge);
+    free(job->shifts);
+    free(job->payoff);
+    free(job->spot_store);
+}
+
+int heston_mc_price(double S, double K, double T, double r, double q,
+                    const HestonParams* params, OptionType option_type,
+                    const HestonMCConfig* config, HestonMCResult* result) {
+    if (result == NULL) {
+        return ERROR_INVALID_PARAMETER;
+    }
+    memset(result, 0, sizeof(HestonMCResult));
+
+    MCJob job;
+    memset(&job, 0, sizeof(job));
+    if (config != NULL) {
+        job.config = *config;
+    } else {
+        heston_mc_default_config(&job.config);
+    }
+
+    const HestonMCPayoff payoff = job.config.payoff;
+    if (!(S > 0.0) || !(K > 0.0) || !(T > 0.0) || params == NULL ||
+        !(params->kappa > 0.0) || !(params->sigma > 0.0) || !(params->v0 >= 0.0) ||
+        !(params->theta > 0.0) || !(fabs(params->rho) <= 1.0) ||
+        (option_type != OPTION_CALL && option_type != OPTION_PUT) ||
+        payoff < HESTON_MC_EUROPEAN || payoff > HESTON_MC_BERMUDAN ||
+        ((payoff == HESTON_MC_UP_AND_OUT || payoff == HESTON_MC_DOWN_AND_OUT) &&
+         !(job.config.barrier > 0.0)) ||
+        job.config.paths < 0 || job.config.steps < 0 || job.config.steps > HESTON_MC_MAX_STEPS) {
+        return ERROR_INVALID_PARAMETER;
+    }
+
+    job.S = S;
+    job.K = K;
+    job.T = T;
+    job.r = r;
+    job.q = q;
+    job.p = *params;
+    job.option_type = option_type;
+
+    job.steps = job.config.steps;
+    if (job.steps == 0) {
+        double steps = ceil(T * HESTON_MC_STEPS_PER_YEAR);
+        job.steps = (steps < 8.0) ? 8 : (steps > HESTON_MC_MAX_STEPS) ? HESTON_MC_MAX_STEPS : (int)steps;
+    }
+    job.dims = 2 * job.steps;
+
+    /* Whole blocks in every replicate */
+    int paths = (job.config.paths > 0) ? job.config.paths : HESTON_MC_DEFAULT_PATHS;
+    int per_replicate = (paths + HESTON_MC_REPLICATES - 1) / HESTON_MC_REPLICATES;
+    job.blocks_per_replicate = (per_replicate + HESTON_MC_BLOCK - 1) / HESTON_MC_BLOCK;
+    job.blocks = job.blocks_per_replicate * HESTON_MC_REPLICATES;
+    job.paths = job.blocks * HESTON_MC_BLOCK;
+    job.points_per_block = job.config.antithetic ? HESTON_MC_BLOCK / 2 : HESTON_MC_BLOCK;
+
+    const double dt = T / job.steps;
+    const double kappa = params->kappa, theta = params->theta;
+    const double sigma = params->sigma, rho = params->rho;
+    job.discount = exp(-r * T);
+    job.log_barrier = (job.config.barrier > 0.0) ? log(job.config.barrier) : 0.0;
+    job.drift = (r - q) * dt;
+    job.exp_kdt = exp(-kappa * dt);
+    job.var_c1 = sigma * sigma * job.exp_kdt * (1.0 - job.exp_kdt) / kappa;
+    job.var_c2 = theta * sigma * sigma * (1.0 - job.exp_kdt) * (1.0 - job.exp_kdt) / (2.0 * kappa);
+    job.k0 = -rho * kappa * theta * dt / sigma;
+    job.k1 = 0.5 * dt * (kappa * rho / sigma - 0.5) - rho / sigma;
+    job.k2 = 0.5 * dt * (kappa * rho / sigma - 0.5) + rho / sigma;
+    job.k3 = 0.5 * dt * (1.0 - rho * rho);
+    job.k4 = job.k3;
+
+    double control_value = 0.0;
+    if (job.config.control_variate && control_price(&job, &control_value) != ERROR_NONE) {
+        job.config.control_variate = false;
+    }
+
+    int status = ERROR_NONE;
+    job.payoff = malloc(2 * (size_t)job.paths * sizeof(double));
+    if (job.payoff == NULL) {
+        return ERROR_MEMORY_ALLOCATION;
+    }
+    job.control = job.payoff + job.paths;
+
+    if (payoff == HESTON_MC_BERMUDAN) {
+        job.spot_store = malloc(2 * (size_t)job.steps * job.paths * sizeof(double));
+        if (job.spot_store == NULL) {
+            status = ERROR_MEMORY_ALLOCATION;
+        }
+        job.var_store = job.spot_store + (size_t)job.steps * job.paths;
+    }
+
+    if (status == ERROR_NONE && job.config.quasi_random) {
+        pthread_once(&g_sobol_once, init_sobol_directions);
+        status = bridge_init(&job.bridge, job.steps);
+        job.shifts = malloc((size_t)HESTON_MC_REPLICATES * job.dims * sizeof(uint32_t));
+        if (status == ERROR_NONE && job.shifts == NULL) {
+            status = ERROR_MEMORY_ALLOCATION;
+        }
+        if (status == ERROR_NONE) {
+            uint64_t state = job.config.seed;
+            for (int i = 0; i < HESTON_MC_REPLICATES * job.dims; i++) {
+                job.shifts[i] = (uint32_t)(splitmix64(&state) >> 32);
+            }
+        }
+    }
+    if (status != ERROR_NONE) {
+        job_free(&job);
+        return status;
+    }
+
+    int threads = (job.config.threads > 0) ? job.config.threads : online_processors();
+    if (threads > HESTON_MC_MAX_THREADS) threads = HESTON_MC_MAX_THREADS;
+    if (threads > job.blocks) threads = job.blocks;
+
+    PERF_START(simulation_start);
+    pthread_mutex_init(&job.lock, NULL);
+    pthread_t workers[HESTON_MC_MAX_THREADS];
+    int started = 0;
+    while (threads > 1 && started < threads &&
+           pthread_create(&workers[started], NULL, mc_worker, &job) == 0) {
+        started++;
+    }
+    if (started == 0) {
+        mc_worker(&job);
+    }
+    for (int t = 0; t < started; t++) {
+        pthread_join(workers[t], NULL);
+    }
+    pthread_mutex_destroy(&job.lock);
+    PERF_STOP(PERF_TIMER_MC_SIMULATION, simulation_start);
+
+    if (job.next_block < job.blocks) {
+        job_free(&job);
+        return ERROR_MEMORY_ALLOCATION;
+    }
+
+    if (payoff == HESTON_MC_BERMUDAN) {
+        longstaff_schwartz(&job);
+    }
+
+    status = reduce_paths(&job, control_value, result);
+    result->paths = job.paths;
+    result->steps = job.steps;
+
+    job_free(&job);
+    return status;
+}
+
+/* Default adapter parameters for an initial volatility */
+static void default_params_for_vol(double vol, HestonParams* p) {
+    p->v0 = vol * vol;
+    p->kappa = HESTON_DEFAULT_KAPPA;
+    p->theta = p->v0;
+    p->sigma = HESTON_DEFAULT_SIGMA;
+    p->rho = HESTON_DEFAULT_RHO;
+}
+
+int heston_mc_price_option(double S, double K, double T, double r, double q,
+                           const HestonParams* params, OptionType option_type,
+                           double market_price, PricingResult* result) {
+    if (result == NULL) {
+        return ERROR_INVALID_PARAMETER;
+    }
+
+    memset(result, 0, sizeof(PricingResult));
+
+    if (S <= 0.0 || K <= 0.0 || T <= 0.0 ||
+        (option_type != OPTION_CALL && option_type != OPTION_PUT)) {
+        result->error_code = ERROR_INVALID_PARAMETER;
+        return result->error_code;
+    }
+
+    HestonMCResult mc;
+
+    if (market_price > 0) {
+        /* Bisection on sqrt(v0); the fixed seed makes every trial use the same paths */
+        HestonParams p;
+        double lo = MC_IV_MIN;
+        double hi = MC_IV_MAX;
+        double price_lo, price_hi;
+
+        default_params_for_vol(lo, &p);
+        int status = heston_mc_price(S, K, T, r, q, &p, option_type, NULL, &mc);
+        price_lo = mc.price;
+        default_params_for_vol(hi, &p);
+        if (status == ERROR_NONE) {
+            status = heston_mc_price(S, K, T, r, q, &p, option_type, NULL, &mc);
+        }
+        price_hi = mc.price;
+
+        if (status != ERROR_NONE || market_price < price_lo || market_price > price_hi) {
+            result->error_code = ERROR_VOLATILITY_CALCULATION;
+            return result->error_code;
+        }
+
+        for (int i = 0; i < MC_IV_MAX_ITERATIONS && hi - lo > MC_IV_TOL; i++) {
+            double mid = 0.5 * (lo + hi);
+
+            default_params_for_vol(mid, &p);
+            if (heston_mc_price(S, K, T, r, q, &p, option_type, NULL, &mc) != ERROR_NONE) {
+                result->error_code = ERROR_VOLATILITY_CALCULATION;
+                return result->error_code;
+            }
+
+            if (mc.price < market_price) {
+                lo = mid;
+            } else {
+                hi = mid;
+            }
+        }
+
+        result->implied_volatility = 0.5 * (lo + hi);
+        result->price = market_price;
+    } else {
+        /* Option pricing with known Heston parameters */
+        HestonParams p;
+
+        if (params != NULL) {
+            p = *params;
+        } else {
+            default_params_for_vol(sqrt(HESTON_DEFAULT_V0), &p);
+        }
+
+        if (heston_mc_price(S, K, T, r, q, &p, option_type, NULL, &mc) != ERROR_NONE ||
+            !isfinite(mc.price)) {
+            result->error_code = ERROR_CALCULATION_FAILED;
+            return result->error_code;
+        }
+
+        result->price = fmax(0.0, mc.price);
+        result->implied_volatility = sqrt(p.v0);
+    }
+
+    result->error_code = ERROR_NONE;
+    return ERROR_NONE;
+}
@@ -0,0 +1,274 @@
+/**
+ * heston_param_store.c
+ * Last calibrated Heston parameters per ticker and expiry bucket
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "../include/heston_param_store.h"
+
+// Bucket edges in days; past the last one buckets are a year wide
+static const int bucket_edges[] = {7, 14, 21, 30, 45, 60, 90, 120, 180, 270, 365, 545, 730};
+#define NUM_BUCKET_EDGES ((int)(sizeof(bucket_edges) / sizeof(bucket_edges[0])))
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t count;
+} StoreFileHeader;
+
+struct HestonParamStore {
+    char* path;
+    HestonParamEntry* entries;
+    int count;
+    int capacity;
+};
+
+static int valid_ticker(const char* ticker) {
+    return ticker != NULL && ticker[0] != '\0' && strlen(ticker) < HESTON_PARAM_TICKER_LEN;
+}
+
+static HestonParamEntry* find_entry(const HestonParamStore* store, const char* ticker, int bucket) {
+    for (int i = 0; i < store->count; i++) {
+        HestonParamEntry* entry = &store->entries[i];
+        if (entry->bucket_days == bucket && strcmp(entry->ticker, ticker) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static int reserve(HestonParamStore* store, int count) {
+    if (count <= store->capacity) {
+        return 0;
+    }
+
+    int capacity = store->capacity > 0 ? store->capacity * 2 : 16;
+    while (capacity < count) {
+        capacity *= 2;
+    }
+    HestonParamEntry* entries = realloc(store->entries, (size_t)capacity * sizeof(HestonParamEntry));
+    if (entries == NULL) {
+        return -1;
+    }
+    store->entries = entries;
+    store->capacity = capacity;
+    return 0;
+}
+
+static void load_entries(HestonParamStore* store, const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        return;
+    }
+
+    StoreFileHeader header;
+    int ok = fread(&header, sizeof(header), 1, file) == 1 &&
+             memcmp(header.magic, HESTON_PARAM_STORE_MAGIC, sizeof(header.magic)) == 0 &&
+             header.version == HESTON_PARAM_STORE_VERSION &&
+             header.count <= (uint32_t)(1 << 24) &&
+             reserve(store, (int)header.count) == 0;
+    if (ok && header.count > 0) {
+        ok = fread(store->entries, sizeof(HestonParamEntry), header.count, file) == header.count;
+    }
+    fclose(file);
+
+    store->count = ok ? (int)header.count : 0;
+
+    // Tickers must be terminated for the lookups
+    for (int i = 0; i < store->count; i++) {
+        store->entries[i].ticker[HESTON_PARAM_TICKER_LEN - 1] = '\0';
+    }
+}
+
+HestonParamStore* heston_param_store_open(const char* path) {
+    if (path == NULL) {
+        return NULL;
+    }
+
+    HestonParamStore* store = calloc(1, sizeof(HestonParamStore));
+    if (store == NULL) {
+        return NULL;
+    }
+    store->path = malloc(strlen(path) + 1);
+    if (store->path == NULL) {
+        free(store);
+        return NULL;
+    }
+    strcpy(store->path, path);
+
+    load_entries(store, store->path);
+    return store;
+}
+
+// Saves of the same store from several processes take turns on path.lock
+static int lock_store(const char* path) {
+    size_t len = strlen(path);
+    char* lock_path = malloc(len + 6);
+    if (lock_path == NULL) {
+        return -1;
+    }
+    memcpy(lock_path, path, len);
+    memcpy(lock_path + len, ".lock", 6);
+
+    int fd = open(lock_path, O_RDWR | O_CREAT, 0644);
+    free(lock_path);
+    if (fd < 0) {
+        return -1;
+    }
+
+    struct flock lock;
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type = F_WRLCK;
+    lock.l_whence = SEEK_SET;
+    if (fcntl(fd, F_SETLKW, &lock) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// The file's entries with the store's over them, keeping the later calibration of a bucket
+static int merge_file(const HestonParamStore* store, HestonParamStore* merged) {
+    load_entries(merged, store->path);
+
+    for (int i = 0; i < store->count; i++) {
+        const HestonParamEntry* mine = &store->entries[i];
+        HestonParamEntry* entry = find_entry(merged, mine->ticker, mine->bucket_days);
+        if (entry == NULL) {
+            if (reserve(merged, merged->count + 1) != 0) {
+                return -1;
+            }
+            entry = &merged->entries[merged->count++];
+        } else if (entry->updated > mine->updated) {
+            continue;
+        }
+        *entry = *mine;
+    }
+    return 0;
+}
+
+static int write_entries(const HestonParamStore* store, const char* path) {
+    size_t len = strlen(path);
+    char* tmp_path = malloc(len + 8);
+    if (tmp_path == NULL) {
+        return -1;
+    }
+    memcpy(tmp_path, path, len);
+    memcpy(tmp_path + len, ".XXXXXX", 8);
+
+    int fd = mkstemp(tmp_path);
+    if (fd < 0) {
+        free(tmp_path);
+        return -1;
+    }
+
+    StoreFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, HESTON_PARAM_STORE_MAGIC, sizeof(header.magic));
+    header.version = HESTON_PARAM_STORE_VERSION;
+    header.count = (uint32_t)store->count;
+
+    // mkstemp() creates the file readable by its owner only
+    FILE* file = fchmod(fd, 0644) == 0 ? fdopen(fd, "wb") : NULL;
+    int ok = file != NULL;
+    if (ok) {
+        ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+             (store->count == 0 ||
+              fwrite(store->entries, sizeof(HestonParamEntry), (size_t)store->count, file) ==
+                  (size_t)store->count);
+        ok = fclose(file) == 0 && ok;
+    } else {
+        close(fd);
+    }
+    ok = ok && rename(tmp_path, path) == 0;
+
+    if (!ok) {
+        remove(tmp_path);
+    }
+    free(tmp_path);
+    return ok ? 0 : -1;
+}
+
+int heston_param_store_save(const HestonParamStore* store) {
+    if (store == NULL) {
+        return -1;
+    }
+
+    int lock_fd = lock_store(store->path);
+    if (lock_fd < 0) {
+        return -1;
+    }
+
+    HestonParamStore merged;
+    memset(&merged, 0, sizeof(merged));
+    int ret = merge_file(store, &merged);
+    if (ret == 0) {
+        ret = write_entries(&merged, store->path);
+    }
+    free(merged.entries);
+
+    close(lock_fd);
+    return ret;
+}
+
+void heston_param_store_close(HestonParamStore* store) {
+    if (store == NULL) {
+        return;
+    }
+    free(store->entries);
+    free(store->path);
+    free(store);
+}
+
+int heston_param_store_bucket(double T) {
+    int days = (int)ceil(T * 365.0);
+
+    for (int i = 0; i < NUM_BUCKET_EDGES; i++) {
+        if (days <= bucket_edges[i]) {
+            return bucket_edges[i];
+        }
+    }
+    return (days + 364) / 365 * 365;
+}
+
+const HestonParamEntry* heston_param_store_lookup(const HestonParamStore* store,
+                                                  const char* ticker, double T) {
+    if (store == NULL || !valid_ticker(ticker) || !(T > 0.0)) {
+        return NULL;
+    }
+    return find_entry(store, ticker, heston_param_store_bucket(T));
+}
+
+int heston_param_store_update(HestonParamStore* store, const char* ticker, double T,
+                              const HestonParams* params, double relative_error) {
+    if (store == NULL || !valid_ticker(ticker) || !(T > 0.0) || params == NULL) {
+        return -1;
+    }
+
+    int bucket = heston_param_store_bucket(T);
+    HestonParamEntry* entry = find_entry(store, ticker, bucket);
+    if (entry == NULL) {
+        if (reserve(store, store->count + 1) != 0) {
+            return -1;
+        }
+        entry = &store->entries[store->count++];
+        memset(entry, 0, sizeof(*entry));
+        strcpy(entry->ticker, ticker);
+        entry->bucket_days = bucket;
+    }
+
+    entry->params = *params;
+    entry->relative_error = relative_error;
+    entry->updated = (int64_t)time(NULL);
+    return 0;
+}
@@ -7,6 +7,10 @@
 #include "../include/option_pricing.h"
 #include "../include/error_handling.h"
 #include "../include/market_data.h"
+#include "../include/pricing_server.h"
+#include "../include/portfolio.h"
+#include "../include/quote_stream.h"
+#include "../include/perf_stats.h"
 
 /**
  * Print usage information
@@ -23,7 +27,7 @@ static void print_usage(const char* program_name) {
     printf("  VOLATILITY       Initial volatility (decimal format, e.g., 0.2 for 20%%)\n");
     printf("  OPTION_TYPE      0 for call, 1 for put\n");
     printf("  MODEL_TYPE       0 for Black-Scholes, 1 for Heston\n");
-    printf("  METHOD_TYPE      0 for analytic, 1 for quadrature, 2 for FFT\n");
+    printf("  METHOD_TYPE      0 for analytic, 1 for quadrature, 2 for FFT, 3 for COS, 4 for Monte Carlo\n");
     printf("\n");
     printf("Optional parameters:\n");
     printf("  MARKET_PRICE     Market price for implied volatility calculation (0 to skip)\n");
@@ -40,6 +44,162 @@ static void print_usage(const char* program_name) {
     printf("    TICKER          Ticker symbol to look up\n");
     printf("    DAYS            Number of days of historical data (1-365)\n");
     printf("    DATA_SOURCE     Data source (0: default, 1: Alpha Vantage, 2: Finnhub, 3: Polygon)\n");
+    printf("\n");
+    printf("Alternative usage as a pricing server (line-delimited JSON, see the user guide):\n");
+    printf("  %s --server ADDRESS [--max-clients N] [--wisdom FILE] [--config FILE] [--spot-invariant]\n"
+           "         [--no-mixed-precision] [--fft-tuning FILE] [--publish-grids FILE] [--error-log FILE]\n",
+           program_name);
+    printf("    ADDRESS         unix:PATH or tcp:[HOST:]PORT\n");
+    printf("    --max-clients   Clients served at once (default: %d)\n", PRICING_SERVER_DEFAULT_MAX_CLIENTS);
+    printf("    --wisdom        FFTW wisdom file loaded at startup and saved at shutdown\n");
+    printf("    --config        Market data configuration file\n");
+    printf("    --spot-invariant Reuse FFT grids across spot ticks (unit-spot grids in moneyness)\n");
+    printf("    --no-mixed-precision Calibrate in double precision only, without the single-precision screen\n");
+    printf("    --fft-tuning    FFT settings table built by tune_fft, used instead of run-time adaptation\n");
+    printf("    --publish-grids Shared segment (e.g. /dev/shm/heston_grids) other processes read FFT grids from\n");
+    printf("    --error-log     File failed and malformed requests are appended to\n");
+    printf("\n");
+    printf("Alternative usage as a quote stream pipeline (JSON quotes in, implied vols and Heston fits out):\n");
+    printf("  %s --stream [--input FILE] [--capacity N] [--min-fit-quotes N] [--refit-interval SECONDS]\n"
+           "         [--stats-interval SECONDS] [--spot-invariant]\n", program_name);
+    printf("    --input         Quote feed, one JSON object per line (default: stdin)\n");
+    printf("    --capacity      Queue slots between two pipeline stages (default: %d)\n", QUOTE_STREAM_DEFAULT_CAPACITY);
+    printf("    --min-fit-quotes Quotes an expiry needs before it is calibrated (default: %d)\n", HESTON_NUM_PARAMS);
+    printf("    --refit-interval Least time between two calibrations of an expiry (default: 0)\n");
+    printf("    --stats-interval Time between two stats lines (default: one at the end)\n");
+    printf("    --spot-invariant Reuse FFT grids across spot ticks (unit-spot grids in moneyness)\n");
+    printf("\n");
+    printf("Alternative usage for revaluing a book of positions (Heston FFT prices and Greeks as CSV):\n");
+    printf("  %s --portfolio FILE [--threads N] [--rate RATE] [--config FILE] [--data-source SOURCE]\n", program_name);
+    printf("    FILE            CSV of ticker,type,strike,expiry,quantity (expiry as YYYY-MM-DD or years; - for stdin)\n");
+    printf("    --threads       Pricing threads (default: one per CPU)\n");
+    printf("    --rate          Risk-free rate for every position (default: Treasury rate per expiry)\n");
+    printf("    --config        Market data configuration file\n");
+    printf("    --data-source   Data source (0: default, 1: Alpha Vantage, 2: Finnhub, 3: Polygon)\n");
+    printf("\n");
+    printf("Any mode also accepts:\n");
+    printf("  --stats           Print the engine counters and timers as JSON to stderr at exit\n");
+}
+
+/**
+ * Print the engine statistics at exit
+ */
+static void print_stats(void) {
+    PerfStats stats;
+    perf_stats_snapshot(&stats);
+    perf_stats_write_json(stderr, &stats);
+}
+
+/**
+ * Remove every --stats argument, returning whether there was one
+ */
+static int take_stats_flag(int* argc, char* argv[]) {
+    int found = 0;
+    int kept = 1;
+    
+    for (int i = 1; i < *argc; i++) {
+        if (strcmp(argv[i], "--stats") == 0) {
+            found = 1;
+        } else {
+            argv[kept++] = argv[i];
+        }
+    }
+    argv[kept] = NULL;
+    *argc = kept;
+    
+    return found;
+}
+
+/**
+ * Parse the server mode options and run the server
+ */
+static int run_server(int argc, char* argv[]) {
+    PricingServerOptions options;
+    pricing_server_default_options(&options);
+    options.address = argv[2];
+    
+    for (int i = 3; i < argc; i++) {
+        if (i + 1 < argc && strcmp(argv[i], "--max-clients") == 0) {
+            options.max_clients = atoi(argv[++i]);
+        } else if (i + 1 < argc && strcmp(argv[i], "--wisdom") == 0) {
+            options.wisdom_path = argv[++i];
+        } else if (i + 1 < argc && strcmp(argv[i], "--fft-tuning") == 0) {
+            options.tuning_path = argv[++i];
+        } else if (i + 1 < argc && strcmp(argv[i], "--publish-grids") == 0) {
+            options.publish_path = argv[++i];
+        } else if (i + 1 < argc && strcmp(argv[i], "--error-log") == 0) {
+            options.error_log_path = argv[++i];
+        } else if (i + 1 < argc && strcmp(argv[i], "--config") == 0) {
+            options.config_path = argv[++i];
+        } else if (strcmp(argv[i], "--spot-invariant") == 0) {
+            options.spot_invariant = true;
+        } else if (strcmp(argv[i], "--no-mixed-precision") == 0) {
+            options.double_precision = true;
+        } else {
+            fprintf(stderr, "Error: Unknown server option: %s\n", argv[i]);
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    
+    return pricing_server_run(&options) == 0 ? 0 : 1;
+}
+
+/**
+ * Parse the stream mode options and run the quote pipeline
+ */
+static int run_stream(int argc, char* argv[]) {
+    PricingStreamOptions options;
+    pricing_stream_default_options(&options);
+    
+    for (int i = 2; i < argc; i++) {
+        if (i + 1 < argc && strcmp(argv[i], "--input") == 0) {
+            options.input_path = argv[++i];
+        } else if (i + 1 < argc && strcmp(argv[i], "--capacity") == 0) {
+            options.capacity = atoi(argv[++i]);
+        } else if (i + 1 < argc && strcmp(argv[i], "--min-fit-quotes") == 0) {
+            options.min_fit_quotes = atoi(argv[++i]);
+        } else if (i + 1 < argc && strcmp(argv[i], "--refit-interval") == 0) {
+            options.refit_interval = atof(argv[++i]);
+        } else if (i + 1 < argc && strcmp(argv[i], "--stats-interval") == 0) {
+            options.stats_interval = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--spot-invariant") == 0) {
+            options.spot_invariant = true;
+        } else {
+            fprintf(stderr, "Error: Unknown stream option: %s\n", argv[i]);
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    
+    return pricing_stream_run(&options) == 0 ? 0 : 1;
+}
+
+/**
+ * Parse the portfolio mode options and revalue the positions
+ */
+static int run_portfolio(int argc, char* argv[]) {
+    PortfolioOptions options;
+    portfolio_default_options(&options);
+    options.positions_path = argv[2];
+    
+    for (int i = 3; i < argc; i++) {
+        if (i + 1 < argc && strcmp(argv[i], "--threads") == 0) {
+            options.threads = atoi(argv[++i]);
+        } else if (i + 1 < argc && strcmp(argv[i], "--rate") == 0) {
+            options.rate = atof(argv[++i]);
+        } else if (i + 1 < argc && strcmp(argv[i], "--config") == 0) {
+            options.config_path = argv[++i];
+        } else if (i + 1 < argc && strcmp(argv[i], "--data-source") == 0) {
+            options.source = (DataSource)atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Error: Unknown portfolio option: %s\n", argv[i]);
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    
+    return portfolio_run(&options) == 0 ? 0 : 1;
 }
 
 /**
@@ -184,6 +344,27 @@ int main(int argc, char* argv[]) {
     PricingResult result;
     int ret_code;
     
+    /* Statistics are printed however the program exits */
+    if (take_stats_flag(&argc, argv)) {
+        perf_stats_reset();
+        atexit(print_stats);
+    }
+    
+    /* Check for server mode */
+    if (argc >= 3 && strcmp(argv[1], "--server") == 0) {
+        return run_server(argc, argv);
+    }
+    
+    /* Check for quote stream mode */
+    if (argc >= 2 && strcmp(argv[1], "--stream") == 0) {
+        return run_stream(argc, argv);
+    }
+    
+    /* Check for portfolio mode */
+    if (argc >= 3 && strcmp(argv[1], "--portfolio") == 0) {
+        return run_portfolio(argc, argv);
+    }
+    
     /* Check for market data retrieval mode */
     if (argc >= 3 && strcmp(argv[1], "--get-market-data") == 0) {
         const char* ticker = argv[2];
@@ -202,21 +383,25 @@ int main(int argc, char* argv[]) {
             return 1;
         }
         
-        /* Get spot price */
-        int error_code;
-        double price = get_current_price(ticker, source, &error_code);
+        /* Get spot price and dividend yield in one concurrent batch */
+        MarketDataRequest requests[2];
+        memset(requests, 0, sizeof(requests));
+        requests[0].field = MARKET_DATA_PRICE;
+        requests[1].field = MARKET_DATA_DIVIDEND_YIELD;
+        requests[0].ticker = requests[1].ticker = ticker;
+        requests[0].source = requests[1].source = source;
+        get_market_data_batch(requests, 2);
+        
+        int error_code = requests[0].error_code;
+        double price = requests[0].value;
         if (error_code != ERROR_SUCCESS) {
             fprintf(stderr, "Error retrieving price: %s\n", get_error_message(error_code));
             market_data_cleanup();
             return 1;
         }
         
-        /* Get dividend yield */
-        double yield = get_dividend_yield(ticker, source, &error_code);
-        if (error_code != ERROR_SUCCESS) {
-            /* Non-fatal, just set to 0 */
-            yield = 0.0;
-        }
+        /* Dividend yield failures are non-fatal, just set to 0 */
+        double yield = requests[1].error_code == ERROR_SUCCESS ? requests[1].value : 0.0;
         
         /* Output results in a format the shell script can parse */
         printf("%.6f %.6f\n", price, yield);
@@ -6,20 +6,28 @@
  * risk-free rates) from various data sources using ticker symbols.
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <limits.h>
 #include <curl/curl.h>
 #include <time.h>
 #include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <sys/stat.h>
 #include <jansson.h>
 #include <ctype.h>
-#include <cjson/cJSON.h>
 
 #include "../include/market_data.h"
 #include "../include/error_handling.h"
 #include "../include/path_resolution.h"
+#include "../include/time_series_store.h"
+#include "../include/rolling_volatility.h"
+#include "../include/perf_stats.h"
 
 #define MAX_URL_LENGTH 1024
 #define MAX_BUFFER_SIZE 65536
@@ -30,6 +38,19 @@
 #define URL_BUFFER_SIZE 512
 #define MAX_HISTORY_DAYS 365
 #define MAX_API_KEY_LENGTH 128
+#define MAX_POOLED_HANDLES 16
+#define MAX_HOST_CONNECTIONS 6
+#define REQUEST_TIMEOUT_SECONDS 10L
+#define INITIAL_RESPONSE_CAPACITY 4096
+#define MAX_BASE_URL_LENGTH 128
+#define DEFAULT_CONFIG_PATH ".config/option_tools/market_data.conf" // Relative to HOME
+#define MAX_TIME_SERIES_BUFFER_SIZE (32 * 1024 * 1024)
+#define COMPACT_UPDATE_SECONDS (100 * 24 * 3600) // Alpha Vantage compact series cover ~100 trading days
+#define DEFAULT_RATE_LIMIT_WAIT_SECONDS 20.0 // Longest wait for a provider's request quota
+#define DEFAULT_CACHE_STALE_SECONDS (24 * 3600) // Expired values still served while a provider cannot be asked
+#define MAX_BULK_SYMBOLS 100 // Alpha Vantage REALTIME_BULK_QUOTES limit
+#define MAX_THROTTLE_RESPONSE 1024 // Alpha Vantage over-quota notes are short
+#define INFLIGHT_POLL_SECONDS 0.05
 
 /**
  * Structure to hold cached data with timestamp
@@ -43,8 +64,62 @@ typedef struct {
 typedef struct {
     char *data;
     size_t size;
+    size_t capacity;
+    size_t limit;
 } APIResponse;
 
+// One transfer of a batch
+typedef struct {
+    const char *url;
+    size_t max_size;  // Largest accepted body, 0 for MAX_BUFFER_SIZE
+    double max_wait;  // Longest wait for the provider's quota from the start of the batch, in seconds
+    int deferred;     // Left to another process fetching the same URL
+    int claim;        // Descriptor of the in-flight claim on the URL, -1 if none
+    int throttled;    // Not sent for lack of quota, or refused as over quota
+    int queued;       // Waiting for a request token
+    double due;       // When a queued transfer asks for its token again
+    long status;      // HTTP status of the response
+    CURL *handle;
+    APIResponse response;
+    CURLcode result;
+} Transfer;
+
+// State of a batch entry between preparing its request and parsing the response
+typedef struct {
+    char *cache_path;
+    char url[MAX_URL_LENGTH];
+    size_t max_size;
+    DataSource source;
+    int needs_request;   // Not answered by the cache or the bar store
+    int bulk;            // Price taken from a bulk quote of several tickers
+    int waiting;         // Deferred to another process fetching its URL
+    int has_stale;       // An expired cached value answers if no request can be made
+    double stale_value;
+    int transfer;  // Index of its transfer, -1 if answered without a request
+} PendingEntry;
+
+// Request quota of a provider, shared by every process of the user
+typedef struct {
+    const char *name;    // Config key prefix and quota file name
+    char base_url[MAX_BASE_URL_LENGTH];  // Scheme and host its request URLs start with
+    double per_minute;   // Requests per minute, 0 for no limit
+} ProviderQuota;
+
+enum { QUOTA_ALPHAVANTAGE, QUOTA_FINNHUB, QUOTA_POLYGON, QUOTA_PROVIDERS };
+
+// Token bucket state kept in a provider's quota file
+typedef struct {
+    double tokens;   // Requests that may start now
+    double updated;  // Time of the last refill, in seconds since the epoch
+} QuotaState;
+
+// What a ticker's bar store can answer
+typedef enum {
+    BAR_STORE_NEEDS_FULL = 0,    // Missing, too short or too old: download the full series
+    BAR_STORE_NEEDS_UPDATE = 1,  // Long enough but stale: the compact series fills it up
+    BAR_STORE_CURRENT = 2        // Answers from the mapped store
+} BarStoreState;
+
 // Default API keys (should be overridden by config)
 static char *alphavantage_api_key = NULL;
 static char *finnhub_api_key = NULL;
@@ -57,20 +132,66 @@ static int is_initialized = 0;
 // Cache expiry can be modified at runtime
 static int cache_expiry_seconds = DEFAULT_CACHE_EXPIRY_SECONDS;
 
+// Request scheduling; the defaults are the free tiers of the providers
+static ProviderQuota provider_quotas[QUOTA_PROVIDERS] = {
+    { "ALPHAVANTAGE", "https://www.alphavantage.co", 5.0 },
+    { "FINNHUB", "https://finnhub.io", 60.0 },
+    { "POLYGON", "https://api.polygon.io", 5.0 }
+};
+static double rate_limit_wait_seconds = DEFAULT_RATE_LIMIT_WAIT_SECONDS;
+static int cache_stale_seconds = DEFAULT_CACHE_STALE_SECONDS;
+static int alphavantage_bulk_quotes = 0;
+
+// Transfers run on one multi handle for the life of the module, so
+// connections are kept alive between requests; easy handles are pooled
+static CURLM *multi_handle = NULL;
+static CURLSH *share_handle = NULL;
+static CURL *handle_pool[MAX_POOLED_HANDLES];
+static int pooled_handle_count = 0;
+
 // Cache management functions
 static char* get_cache_path(const char *ticker, const char *data_type);
 static int is_cache_valid(const char *cache_path);
 static int save_to_cache(const char *cache_path, const char *data);
 static char* load_from_cache(const char *cache_path);
+static int load_stale_value(const char *cache_path, MarketDataField field, double *value);
 
 // API helper functions
 static size_t write_callback(void *contents, size_t size, size_t nmemb, void *userp);
-static char* make_api_request(const char *url);
+static char* make_api_request(const char *url, size_t max_size);
+static int transfers_init(void);
+static void transfers_cleanup(void);
+static void perform_transfers(Transfer *transfers, int count);
+
+// Request scheduling functions
+static int quota_of_url(const char *url);
+static double use_quota(int provider, int throttle);
+static double wall_seconds(void);
+static void sleep_seconds(double seconds);
+static int is_throttle_response(int provider, long status, const APIResponse *response);
+static int claim_inflight(const char *url);
+static void wait_inflight(const char *url);
 
 // Data parsing functions
 static double parse_price_alphavantage(const char *json_data, const char *ticker);
+static double parse_price_alphavantage_bulk(const char *json_data, const char *ticker);
 static double parse_dividend_yield_alphavantage(const char *json_data, const char *ticker);
 static double parse_risk_free_rate_treasury(const char *csv_data, const char *term);
+static int parse_bars_alphavantage(const char *json_data, TSBar **bars);
+
+// Bar store functions
+static BarStoreState check_bar_store(const char *ticker, int min_bars, TimeSeriesView *view);
+static int store_bars_alphavantage(const char *ticker, const char *json_data);
+static double store_and_measure_volatility(const char *ticker, const char *json_data, int period_days);
+static int prices_from_store(const TimeSeriesView *view, int days, double **prices, char ***dates);
+static double volatility_from_store(const char *ticker, const TimeSeriesView *view, int period_days);
+
+// Historical price functions
+static int history_from_store_alphavantage(const char *ticker, const char *json_data, int max_days,
+                                           double **prices, char ***dates);
+static int extract_finnhub_prices(const char *json_data, int max_days, double **prices, char ***dates);
+static int extract_polygon_prices(const char *json_data, int max_days, double **prices, char ***dates);
+static int is_api_key_set(DataSource source);
 
 // Security helpers
 static int validate_ticker_symbol(const char *ticker);
@@ -90,47 +211,90 @@ int market_data_init(const char *config_path) {
         return ERROR_ENV_HOME_NOT_SET;
     }
     
+    // The parent first, in case ~/.cache does not exist yet
+    snprintf(cache_path, PATH_MAX, "%s/.cache", home_dir);
+    mkdir(cache_path, 0755);
     snprintf(cache_path, PATH_MAX, "%s/%s", home_dir, CACHE_DIR);
     mkdir(cache_path, 0755);
     
-    // Load API keys from config if provided
-    if (config_path != NULL) {
-        FILE *config_file = fopen(config_path, "r");
-        if (config_file != NULL) {
-            char line[256];
-            char key[128], value[128];
-            
-            while (fgets(line, sizeof(line), config_file)) {
-                if (sscanf(line, "%127[^=]=%127s", key, value) == 2) {
-                    if (strcmp(key, "ALPHAVANTAGE_API_KEY") == 0) {
-                        alphavantage_api_key = strdup(value);
-                    } else if (strcmp(key, "FINNHUB_API_KEY") == 0) {
-                        finnhub_api_key = strdup(value);
-                    } else if (strcmp(key, "POLYGON_API_KEY") == 0) {
-                        polygon_api_key = strdup(value);
-                    } else if (strcmp(key, "PREFERRED_DATA_SOURCE") == 0) {
-                        if (strcmp(value, "ALPHAVANTAGE") == 0) {
-                            preferred_source = DATA_SOURCE_ALPHAVANTAGE;
-                        } else if (strcmp(value, "FINNHUB") == 0) {
-                            preferred_source = DATA_SOURCE_FINNHUB;
-                        } else if (strcmp(value, "POLYGON") == 0) {
-                            preferred_source = DATA_SOURCE_POLYGON;
+    // Load API keys from config, by default the user's if there is one
+    char default_config[PATH_MAX];
+    if (config_path == NULL) {
+        snprintf(default_config, PATH_MAX, "%s/%s", home_dir, DEFAULT_CONFIG_PATH);
+        config_path = default_config;
+    }
+    FILE *config_file = fopen(config_path, "r");
+    if (config_file != NULL) {
+        char line[256];
+        char key[128], value[128];
+        
+        while (fgets(line, sizeof(line), config_file)) {
+            if (sscanf(line, "%127[^=]=%127s", key, value) == 2) {
+                if (strcmp(key, "ALPHAVANTAGE_API_KEY") == 0) {
+                    alphavantage_api_key = strdup(value);
+                } else if (strcmp(key, "FINNHUB_API_KEY") == 0) {
+                    finnhub_api_key = strdup(value);
+                } else if (strcmp(key, "POLYGON_API_KEY") == 0) {
+                    polygon_api_key = strdup(value);
+                } else if (strcmp(key, "PREFERRED_DATA_SOURCE") == 0) {
+                    if (strcmp(value, "ALPHAVANTAGE") == 0) {
+                        preferred_source = DATA_SOURCE_ALPHAVANTAGE;
+                    } else if (strcmp(value, "FINNHUB") == 0) {
+                        preferred_source = DATA_SOURCE_FINNHUB;
+                    } else if (strcmp(value, "POLYGON") == 0) {
+                        preferred_source = DATA_SOURCE_POLYGON;
+                    }
+                } else if (strcmp(key, "CACHE_EXPIRY_SECONDS") == 0) {
+                    int expiry = atoi(value);
+                    if (expiry > 0) {
+                        cache_expiry_seconds = expiry;
+                    }
+                } else if (strcmp(key, "CACHE_STALE_SECONDS") == 0) {
+                    int stale = atoi(value);
+                    if (stale >= 0) {
+                        cache_stale_seconds = stale;
+                    }
+                } else if (strcmp(key, "RATE_LIMIT_WAIT_SECONDS") == 0) {
+                    double wait = atof(value);
+                    if (wait >= 0) {
+                        rate_limit_wait_seconds = wait;
+                    }
+                } else if (strcmp(key, "ALPHAVANTAGE_BULK_QUOTES") == 0) {
+                    alphavantage_bulk_quotes = atoi(value) != 0;
+                } else {
+                    // <PROVIDER>_REQUESTS_PER_MINUTE and <PROVIDER>_BASE_URL
+                    int p;
+                    for (p = 0; p < QUOTA_PROVIDERS; p++) {
+                        size_t len = strlen(provider_quotas[p].name);
+                        if (strncmp(key, provider_quotas[p].name, len) != 0) {
+                            continue;
                         }
-                    } else if (strcmp(key, "CACHE_EXPIRY_SECONDS") == 0) {
-                        int expiry = atoi(value);
-                        if (expiry > 0) {
-                            cache_expiry_seconds = expiry;
+                        if (strcmp(key + len, "_REQUESTS_PER_MINUTE") == 0 && atof(value) >= 0) {
+                            provider_quotas[p].per_minute = atof(value);
+                        } else if (strcmp(key + len, "_BASE_URL") == 0 &&
+                                   strlen(value) < sizeof(provider_quotas[p].base_url)) {
+                            // Request paths are appended, so drop trailing slashes
+                            size_t url_len = strlen(value);
+                            while (url_len > 0 && value[url_len - 1] == '/') {
+                                value[--url_len] = '\0';
+                            }
+                            strcpy(provider_quotas[p].base_url, value);
                         }
                     }
                 }
             }
-            fclose(config_file);
         }
+        fclose(config_file);
     }
     
     // Initialize curl global state
     curl_global_init(CURL_GLOBAL_DEFAULT);
     
+    if (transfers_init() != 0) {
+        curl_global_cleanup();
+        return ERROR_MEMORY_ALLOCATION;
+    }
+    
     is_initialized = 1;
     return ERROR_SUCCESS;
 }
@@ -158,6 +322,7 @@ void market_data_cleanup() {
     }
     
     // Cleanup curl
+    transfers_cleanup();
     curl_global_cleanup();
     
     is_initialized = 0;
@@ -171,6 +336,26 @@ void set_cache_timeout(int seconds) {
     cache_expiry_seconds = seconds;
 }
 
+// Set the request quota of a data source
+void set_request_rate_limit(DataSource source, double requests_per_minute) {
+    if (requests_per_minute < 0) {
+        requests_per_minute = 0;  // Negative values mean no limit (same as 0)
+    }
+    switch (source) {
+        case DATA_SOURCE_ALPHAVANTAGE:
+            provider_quotas[QUOTA_ALPHAVANTAGE].per_minute = requests_per_minute;
+            break;
+        case DATA_SOURCE_FINNHUB:
+            provider_quotas[QUOTA_FINNHUB].per_minute = requests_per_minute;
+            break;
+        case DATA_SOURCE_POLYGON:
+            provider_quotas[QUOTA_POLYGON].per_minute = requests_per_minute;
+            break;
+        default:
+            break;
+    }
+}
+
 // Force refresh of cached data
 int refresh_cached_data(const char* ticker) {
     if (!is_initialized) {
@@ -206,13 +391,13 @@ int refresh_cached_data(const char* ticker) {
     // Refresh specific ticker data
     // Get current price to refresh price data
     int error_code;
-    double price = get_current_price(ticker, DATA_SOURCE_DEFAULT, &error_code);
+    get_current_price(ticker, DATA_SOURCE_DEFAULT, &error_code);
     if (error_code != ERROR_SUCCESS) {
         return error_code;
     }
     
     // Get dividend yield to refresh yield data
-    double yield = get_dividend_yield(ticker, DATA_SOURCE_DEFAULT, &error_code);
+    get_dividend_yield(ticker, DATA_SOURCE_DEFAULT, &error_code);
     if (error_code != ERROR_SUCCESS && error_code != ERROR_PARSING_API_RESPONSE) {
         return error_code;
     }
@@ -220,225 +405,987 @@ int refresh_cached_data(const char* ticker) {
     return ERROR_SUCCESS;
 }
 
+// Fetch one entry on its own through the batch path
+static double fetch_single(MarketDataRequest *req, int *error_code) {
+    get_market_data_batch(req, 1);
+    if (error_code) *error_code = req->error_code;
+    return req->value;
+}
+
 // Implementation of get_current_price
 double get_current_price(const char *ticker, DataSource source, int *error_code) {
-    if (!is_initialized) {
-        if (error_code) *error_code = ERROR_MODULE_NOT_INITIALIZED;
-        return -1.0;
+    MarketDataRequest req = {0};
+    req.field = MARKET_DATA_PRICE;
+    req.ticker = ticker;
+    req.source = source;
+    return fetch_single(&req, error_code);
+}
+
+// Helper function for API requests
+static size_t write_callback(void *contents, size_t size, size_t nmemb, void *userp) {
+    size_t real_size = size * nmemb;
+    APIResponse *resp = (APIResponse*)userp;
+    
+    // Check for buffer overrun or memory issues
+    if (resp->size + real_size > resp->limit) {
+        return 0;  // Too much data, prevent buffer overflow
     }
     
-    // Validate ticker
-    if (!validate_ticker_symbol(ticker)) {
-        if (error_code) *error_code = ERROR_INVALID_TICKER;
-        return -1.0;
+    // Grow geometrically so a large body costs a few reallocations, not one per chunk
+    if (resp->size + real_size + 1 > resp->capacity) {
+        size_t capacity = resp->capacity > 0 ? resp->capacity : INITIAL_RESPONSE_CAPACITY;
+        while (capacity < resp->size + real_size + 1) {
+            capacity *= 2;
+        }
+        if (capacity > resp->limit + 1) {
+            capacity = resp->limit + 1;
+        }
+        
+        char *ptr = realloc(resp->data, capacity);
+        if (ptr == NULL) {
+            // Handle memory allocation failure
+            free(resp->data);
+            resp->data = NULL;
+            resp->size = 0;
+            resp->capacity = 0;
+            return 0;  // Signal error to curl
+        }
+        resp->data = ptr;
+        resp->capacity = capacity;
+    }
+    
+    memcpy(&(resp->data[resp->size]), contents, real_size);
+    resp->size += real_size;
+    resp->data[resp->size] = 0;
+    
+    return real_size;
+}
+
+// Create the multi and share handles the pooled transfers run on
+static int transfers_init(void) {
+    multi_handle = curl_multi_init();
+    share_handle = curl_share_init();
+    if (multi_handle == NULL || share_handle == NULL) {
+        transfers_cleanup();
+        return -1;
+    }
+    
+    // The multi handle owns the connection cache, so keep-alive connections
+    // survive between calls; DNS results and TLS sessions are shared by all
+    // pooled handles
+    curl_share_setopt(share_handle, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(share_handle, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    
+    curl_multi_setopt(multi_handle, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+    curl_multi_setopt(multi_handle, CURLMOPT_MAX_HOST_CONNECTIONS, (long)MAX_HOST_CONNECTIONS);
+    
+    return 0;
+}
+
+static void transfers_cleanup(void) {
+    while (pooled_handle_count > 0) {
+        curl_easy_cleanup(handle_pool[--pooled_handle_count]);
     }
     
-    // Use preferred source if not specified
-    if (source == DATA_SOURCE_DEFAULT) {
-        source = preferred_source;
+    if (multi_handle != NULL) {
+        curl_multi_cleanup(multi_handle);
+        multi_handle = NULL;
+    }
+    
+    if (share_handle != NULL) {
+        curl_share_cleanup(share_handle);
+        share_handle = NULL;
+    }
+}
+
+// Take an easy handle from the pool, or set up a new one
+static CURL* acquire_handle(void) {
+    if (pooled_handle_count > 0) {
+        return handle_pool[--pooled_handle_count];
+    }
+    
+    CURL *curl = curl_easy_init();
+    if (curl == NULL) {
+        return NULL;
+    }
+    
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
+    curl_easy_setopt(curl, CURLOPT_USERAGENT, "unified-option-tools/1.0");
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, REQUEST_TIMEOUT_SECONDS);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "");
+    curl_easy_setopt(curl, CURLOPT_SHARE, share_handle);
+    
+    // Wait for an existing HTTP/2 connection to the host rather than opening another
+    curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 1L);
+    
+    // Set secure options
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 1L);
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 2L);
+    
+    return curl;
+}
+
+static void release_handle(CURL *curl) {
+    if (pooled_handle_count < MAX_POOLED_HANDLES) {
+        handle_pool[pooled_handle_count++] = curl;
+    } else {
+        curl_easy_cleanup(curl);
+    }
+}
+
+// Start a transfer on the multi handle; 0 once it runs
+static int start_transfer(Transfer *t) {
+    t->handle = acquire_handle();
+    if (t->handle == NULL) {
+        return -1;
+    }
+    
+    curl_easy_setopt(t->handle, CURLOPT_URL, t->url);
+    curl_easy_setopt(t->handle, CURLOPT_WRITEDATA, (void *)&t->response);
+    curl_easy_setopt(t->handle, CURLOPT_PRIVATE, (void *)t);
+    
+    if (curl_multi_add_handle(multi_handle, t->handle) != CURLM_OK) {
+        release_handle(t->handle);
+        t->handle = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+// Take a started transfer off the multi handle and settle its response
+static void finish_transfer(Transfer *t) {
+    curl_multi_remove_handle(multi_handle, t->handle);
+    release_handle(t->handle);
+    t->handle = NULL;
+    
+    if (t->result == CURLE_OK && t->response.data == NULL) {
+        // Empty body
+        t->response.data = calloc(1, 1);
+    } else if (t->result != CURLE_OK) {
+        free(t->response.data);
+        t->response.data = NULL;
+        PERF_COUNT(PERF_MARKET_NETWORK_FAILURE);
+    }
+    
+    // An over-quota answer carries no data and pauses the provider, so
+    // the transfers still queued for it are not sent
+    int provider = quota_of_url(t->url);
+    if (provider >= 0 && is_throttle_response(provider, t->status, &t->response)) {
+        use_quota(provider, 1);
+        free(t->response.data);
+        t->response.data = NULL;
+        t->throttled = 1;
+        PERF_COUNT(PERF_MARKET_RATE_LIMITED);
+    }
+    PERF_COUNT(PERF_MARKET_NETWORK_REQUEST);
+}
+
+/**
+ * Run all transfers concurrently and wait until every one has finished.
+ * On return each transfer holds its response body, or NULL if it failed.
+ * Deferred transfers are skipped. A transfer is queued until its provider's
+ * quota grants it a token, and starts right away then, while the others
+ * run. One that gets no token within max_wait of the start of the batch,
+ * or that the provider refuses as over quota, is marked throttled, so no
+ * batch waits longer than its largest max_wait for the quota.
+ */
+static void perform_transfers(Transfer *transfers, int count) {
+    int i;
+    int running = 0;
+    int queued = 0;
+    PERF_START(fetch_start);
+    const double batch_start = wall_seconds();
+    
+    for (i = 0; i < count; i++) {
+        Transfer *t = &transfers[i];
+        t->response.data = NULL;
+        t->response.size = 0;
+        t->response.capacity = 0;
+        t->response.limit = t->max_size > 0 ? t->max_size : MAX_BUFFER_SIZE;
+        t->result = CURLE_FAILED_INIT;
+        t->throttled = 0;
+        t->status = 0;
+        t->handle = NULL;
+        t->queued = !t->deferred;
+        t->due = batch_start;
+        queued += t->queued;
+    }
+    
+    while (queued > 0 || running > 0) {
+        // Start the queued transfers that get a token now
+        const double now = wall_seconds();
+        double next_due = 0.0;
+        for (i = 0; i < count; i++) {
+            Transfer *t = &transfers[i];
+            if (!t->queued) {
+                continue;
+            }
+            if (t->due <= now) {
+                int provider = quota_of_url(t->url);
+                double wait = provider >= 0 ? use_quota(provider, 0) : 0.0;
+                if (wait > 0.0 && now + wait > batch_start + t->max_wait) {
+                    t->queued = 0;
+                    t->throttled = 1;
+                    queued--;
+                    PERF_COUNT(PERF_MARKET_RATE_LIMITED);
+                    continue;
+                }
+                if (wait <= 0.0) {
+                    t->queued = 0;
+                    queued--;
+                    if (start_transfer(t) == 0) {
+                        running++;
+                    } else {
+                        PERF_COUNT(PERF_MARKET_NETWORK_FAILURE);
+                        PERF_COUNT(PERF_MARKET_NETWORK_REQUEST);
+                    }
+                    continue;
+                }
+                t->due = now + wait;
+            }
+            if (next_due == 0.0 || t->due < next_due) {
+                next_due = t->due;
+            }
+        }
+        
+        if (running == 0) {
+            if (queued > 0) {
+                sleep_seconds(next_due - now);
+            }
+            continue;
+        }
+        
+        int still_running = 0;
+        if (curl_multi_perform(multi_handle, &still_running) != CURLM_OK) {
+            break;
+        }
+        
+        // Collect the transfers that completed in this round
+        CURLMsg *msg;
+        int pending_msgs;
+        while ((msg = curl_multi_info_read(multi_handle, &pending_msgs)) != NULL) {
+            if (msg->msg != CURLMSG_DONE) {
+                continue;
+            }
+            
+            Transfer *t = NULL;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **)&t);
+            t->result = msg->data.result;
+            curl_easy_getinfo(t->handle, CURLINFO_RESPONSE_CODE, &t->status);
+            finish_transfer(t);
+            running--;
+        }
+        
+        // Wake up for the next token as well as for the network
+        int timeout_ms = 1000;
+        if (queued > 0 && next_due - wall_seconds() < 1.0) {
+            timeout_ms = (int)((next_due - wall_seconds()) * 1000.0) + 1;
+            if (timeout_ms < 1) {
+                timeout_ms = 1;
+            }
+        }
+        if (running > 0 && curl_multi_wait(multi_handle, NULL, 0, timeout_ms, NULL) != CURLM_OK) {
+            break;
+        }
+    }
+    
+    // Only left over if the multi interface itself failed
+    for (i = 0; i < count; i++) {
+        Transfer *t = &transfers[i];
+        t->queued = 0;
+        if (t->handle != NULL) {
+            finish_transfer(t);
+        }
+    }
+    PERF_STOP(PERF_TIMER_MARKET_FETCH, fetch_start);
+}
+
+// Seconds since the epoch, comparable between processes
+static double wall_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (double)ts.tv_sec + 1e-9 * (double)ts.tv_nsec;
+}
+
+static void sleep_seconds(double seconds) {
+    struct timespec ts;
+    ts.tv_sec = (time_t)seconds;
+    ts.tv_nsec = (long)((seconds - (double)ts.tv_sec) * 1e9);
+    nanosleep(&ts, NULL);
+}
+
+// Scheduling state file in the cache directory
+static int state_file_path(char *path, const char *name, const char *suffix) {
+    const char *home_dir = getenv("HOME");
+    if (home_dir == NULL) {
+        return -1;
+    }
+    snprintf(path, PATH_MAX, "%s/%s/%s.%s", home_dir, CACHE_DIR, name, suffix);
+    return 0;
+}
+
+// Write lock on a whole file; waits for it if wait is set
+static int lock_file(int fd, int wait) {
+    struct flock lock;
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type = F_WRLCK;
+    lock.l_whence = SEEK_SET;
+    return fcntl(fd, wait ? F_SETLKW : F_SETLK, &lock);
+}
+
+// Provider whose quota a URL draws on, -1 for none
+static int quota_of_url(const char *url) {
+    if (url == NULL) {
+        return -1;
+    }
+    
+    int p;
+    for (p = 0; p < QUOTA_PROVIDERS; p++) {
+        size_t len = strlen(provider_quotas[p].base_url);
+        if (strncmp(url, provider_quotas[p].base_url, len) == 0 && (url[len] == '/' || url[len] == '\0')) {
+            return p;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Token bucket of a provider, kept in a quota file so that every process of
+ * the user draws on the same quota. The bucket refills at the provider's
+ * rate up to a minute's worth of requests. Takes a token, or with throttle
+ * set empties the bucket for a minute after the provider refused a request.
+ * Returns 0 if a token was taken, otherwise the seconds until one is due.
+ */
+static double use_quota(int provider, int throttle) {
+    const double per_minute = provider_quotas[provider].per_minute;
+    if (per_minute <= 0) {
+        return 0.0;
+    }
+    
+    // Requests are not held back if the state cannot be shared
+    char path[PATH_MAX];
+    if (state_file_path(path, provider_quotas[provider].name, "quota") != 0) {
+        return 0.0;
+    }
+    int fd = open(path, O_RDWR | O_CREAT, 0600);
+    if (fd < 0) {
+        return 0.0;
+    }
+    if (lock_file(fd, 1) != 0) {
+        close(fd);
+        return 0.0;
+    }
+    
+    const double capacity = per_minute > 1.0 ? per_minute : 1.0;
+    const double rate = per_minute / 60.0;
+    const double now = wall_seconds();
+    QuotaState state;
+    if (pread(fd, &state, sizeof(state), 0) != (ssize_t)sizeof(state) ||
+        !(state.tokens <= capacity) || !(state.updated <= now)) {
+        // New file, a lowered quota or a clock set back: start full
+        state.tokens = capacity;
+        state.updated = now;
+    }
+    state.tokens += (now - state.updated) * rate;
+    if (state.tokens > capacity) {
+        state.tokens = capacity;
+    }
+    state.updated = now;
+    
+    double wait = 0.0;
+    if (throttle) {
+        state.tokens = 1.0 - capacity;
+    } else if (state.tokens >= 1.0) {
+        state.tokens -= 1.0;
+    } else {
+        wait = (1.0 - state.tokens) / rate;
+    }
+    
+    // A lost update only lets a request through early
+    ssize_t written = pwrite(fd, &state, sizeof(state), 0);
+    (void)written;
+    close(fd);
+    return wait;
+}
+
+// Over-quota answers: HTTP 429, or an Alpha Vantage note in place of the data
+static int is_throttle_response(int provider, long status, const APIResponse *response) {
+    if (status == 429) {
+        return 1;
+    }
+    if (provider != QUOTA_ALPHAVANTAGE || response->data == NULL || response->size > MAX_THROTTLE_RESPONSE) {
+        return 0;
+    }
+    return strstr(response->data, "\"Note\"") != NULL ||
+           (strstr(response->data, "\"Information\"") != NULL && strstr(response->data, "rate limit") != NULL);
+}
+
+// Lock file of a URL; the name is a hash so that it holds no API key
+static int inflight_path(char *path, const char *url) {
+    unsigned long long hash = 14695981039346656037ULL;
+    const unsigned char *c;
+    for (c = (const unsigned char *)url; *c != '\0'; c++) {
+        hash = (hash ^ *c) * 1099511628211ULL;
+    }
+    
+    char name[32];
+    snprintf(name, sizeof(name), "inflight_%016llx", hash);
+    return state_file_path(path, name, "lock");
+}
+
+/**
+ * Claim a URL for this process while it is fetched. Returns the descriptor
+ * holding the claim, -1 if no claim can be made (the request goes ahead
+ * anyway), or -2 if another process is fetching the URL right now.
+ */
+static int claim_inflight(const char *url) {
+    char path[PATH_MAX];
+    if (inflight_path(path, url) != 0) {
+        return -1;
+    }
+    int fd = open(path, O_RDWR | O_CREAT, 0600);
+    if (fd < 0) {
+        return -1;
+    }
+    if (lock_file(fd, 0) != 0) {
+        int busy = errno == EACCES || errno == EAGAIN;
+        close(fd);
+        return busy ? -2 : -1;
+    }
+    return fd;
+}
+
+// Wait until no process fetches the URL, at most about one request timeout
+static void wait_inflight(const char *url) {
+    char path[PATH_MAX];
+    if (inflight_path(path, url) != 0) {
+        return;
+    }
+    int fd = open(path, O_RDWR);
+    if (fd < 0) {
+        return;
+    }
+    
+    // Polled rather than waited on, so that a hung fetcher cannot hang us
+    double waited = 0.0;
+    while (lock_file(fd, 0) != 0 && (errno == EACCES || errno == EAGAIN) &&
+           waited < REQUEST_TIMEOUT_SECONDS + 1.0) {
+        sleep_seconds(INFLIGHT_POLL_SECONDS);
+        waited += INFLIGHT_POLL_SECONDS;
+    }
+    close(fd);
+}
+
+static char* make_api_request(const char *url, size_t max_size) {
+    if (url == NULL) return NULL;
+    
+    Transfer transfer = {0};
+    transfer.url = url;
+    transfer.max_size = max_size;
+    transfer.max_wait = rate_limit_wait_seconds;
+    transfer.claim = -1;
+    perform_transfers(&transfer, 1);
+    
+    return transfer.response.data;
+}
+
+// Term names used in the Treasury URLs and cache file names
+static const char* rate_term_string(RateTerm term) {
+    switch (term) {
+        case RATE_TERM_1M: return "1month";
+        case RATE_TERM_3M: return "3month";
+        case RATE_TERM_6M: return "6month";
+        case RATE_TERM_1Y: return "1year";
+        case RATE_TERM_2Y: return "2year";
+        case RATE_TERM_5Y: return "5year";
+        case RATE_TERM_10Y: return "10year";
+        case RATE_TERM_30Y: return "30year";
+        default: return NULL;
+    }
+}
+
+// Record the outcome of a batch entry
+static void finish_entry(MarketDataRequest *req, double value, int error_code) {
+    req->value = error_code == ERROR_SUCCESS ? value : -1.0;
+    req->error_code = error_code;
+    req->stale = 0;
+}
+
+/**
+ * Validate a batch entry, answer it from the cache if possible and otherwise
+ * build its URL. Returns 1 if the entry needs a request, 0 if it is finished.
+ */
+static int prepare_entry(MarketDataRequest *req, PendingEntry *pending) {
+    const char *ticker = req->ticker;
+    DataSource source = req->source;
+    char *api_key = NULL;
+    char cache_key[64];
+    
+    pending->cache_path = NULL;
+    pending->max_size = 0;
+    pending->source = source;
+    pending->bulk = 0;
+    pending->has_stale = 0;
+    pending->transfer = -1;
+    
+    if (req->field == MARKET_DATA_RISK_FREE_RATE) {
+        const char *term_str = rate_term_string(req->term);
+        if (term_str == NULL) {
+            finish_entry(req, -1.0, ERROR_INVALID_RATE_TERM);
+            return 0;
+        }
+        ticker = "treasury";
+        snprintf(cache_key, sizeof(cache_key), "%s", term_str);
+    } else {
+        // Validate ticker
+        if (!validate_ticker_symbol(ticker)) {
+            finish_entry(req, -1.0, ERROR_INVALID_TICKER);
+            return 0;
+        }
+        
+        switch (req->field) {
+            case MARKET_DATA_PRICE:
+                snprintf(cache_key, sizeof(cache_key), "price");
+                break;
+            case MARKET_DATA_DIVIDEND_YIELD:
+                snprintf(cache_key, sizeof(cache_key), "dividend");
+                break;
+            case MARKET_DATA_HISTORICAL_VOLATILITY:
+                // Validate period_days
+                if (req->days <= 0 || req->days > 365*2) {
+                    finish_entry(req, -1.0, ERROR_INVALID_DAYS_PARAMETER);
+                    return 0;
+                }
+                snprintf(cache_key, sizeof(cache_key), "vol_%d", req->days);
+                break;
+            default:
+                finish_entry(req, -1.0, ERROR_INVALID_PARAMETER);
+                return 0;
+        }
+        
+        // Use preferred source if not specified
+        if (source == DATA_SOURCE_DEFAULT) {
+            source = preferred_source;
+        }
     }
     
     // Check cache first
-    char *cache_path = get_cache_path(ticker, "price");
-    if (cache_path == NULL) {
-        if (error_code) *error_code = ERROR_MEMORY_ALLOCATION;
-        return -1.0;
+    pending->cache_path = get_cache_path(ticker, cache_key);
+    if (pending->cache_path == NULL) {
+        finish_entry(req, -1.0, ERROR_MEMORY_ALLOCATION);
+        return 0;
     }
     
-    if (is_cache_valid(cache_path)) {
-        char *cached_data = load_from_cache(cache_path);
+    if (is_cache_valid(pending->cache_path)) {
+        char *cached_data = load_from_cache(pending->cache_path);
         if (cached_data != NULL) {
-            double price = atof(cached_data);
+            double value = atof(cached_data);
             free(cached_data);
-            free(cache_path);
             
-            if (price > 0) {
-                if (error_code) *error_code = ERROR_SUCCESS;
-                return price;
+            // A cached price must be positive, other values are used as stored
+            if (req->field != MARKET_DATA_PRICE || value > 0) {
+                PERF_COUNT(PERF_MARKET_CACHE_HIT);
+                finish_entry(req, value, ERROR_SUCCESS);
+                return 0;
             }
         }
+    } else {
+        pending->has_stale = load_stale_value(pending->cache_path, req->field, &pending->stale_value);
+    }
+    
+    // Volatilities come from the ticker's bar store when it is current
+    int compact = 0;
+    if (req->field == MARKET_DATA_HISTORICAL_VOLATILITY) {
+        TimeSeriesView view;
+        BarStoreState state = check_bar_store(ticker, req->days + 1, &view);
+        if (state == BAR_STORE_CURRENT) {
+            double vol = volatility_from_store(ticker, &view, req->days);
+            ts_store_close(&view);
+            if (vol > 0) {
+                PERF_COUNT(PERF_MARKET_CACHE_HIT);
+                finish_entry(req, vol, ERROR_SUCCESS);
+                return 0;
+            }
+        }
+        compact = state == BAR_STORE_NEEDS_UPDATE;
+        pending->max_size = MAX_TIME_SERIES_BUFFER_SIZE;
+    }
+    
+    if (req->field == MARKET_DATA_RISK_FREE_RATE) {
+        // Use Treasury.gov API for daily Treasury rates
+        // Note: The actual URL would depend on the real API endpoint
+        snprintf(pending->url, MAX_URL_LENGTH, 
+                "https://home.treasury.gov/resource-center/data-chart-center/interest-rates/daily-treasury-rates.csv/all/%s",
+                rate_term_string(req->term));
+        return 1;
     }
     
     // Prepare API request
-    char url[MAX_URL_LENGTH];
-    char *api_key = NULL;
     char *sanitized_ticker = sanitize_ticker_symbol(ticker);
-    
     if (sanitized_ticker == NULL) {
-        free(cache_path);
-        if (error_code) *error_code = ERROR_MEMORY_ALLOCATION;
-        return -1.0;
+        finish_entry(req, -1.0, ERROR_MEMORY_ALLOCATION);
+        return 0;
     }
     
-    switch (source) {
-        case DATA_SOURCE_ALPHAVANTAGE:
+    int error = ERROR_SUCCESS;
+    switch (req->field) {
+        case MARKET_DATA_PRICE:
+            switch (source) {
+                case DATA_SOURCE_ALPHAVANTAGE:
+                    api_key = alphavantage_api_key;
+                    if (api_key != NULL) {
+                        snprintf(pending->url, MAX_URL_LENGTH, 
+                                "%s/query?function=GLOBAL_QUOTE&symbol=%s&apikey=%s",
+                                provider_quotas[QUOTA_ALPHAVANTAGE].base_url, sanitized_ticker, api_key);
+                    }
+                    break;
+                    
+                case DATA_SOURCE_FINNHUB:
+                    api_key = finnhub_api_key;
+                    if (api_key != NULL) {
+                        snprintf(pending->url, MAX_URL_LENGTH, 
+                                "%s/api/v1/quote?symbol=%s&token=%s",
+                                provider_quotas[QUOTA_FINNHUB].base_url, sanitized_ticker, api_key);
+                    }
+                    break;
+                    
+                case DATA_SOURCE_POLYGON:
+                    api_key = polygon_api_key;
+                    if (api_key != NULL) {
+                        snprintf(pending->url, MAX_URL_LENGTH, 
+                                "%s/v2/aggs/ticker/%s/prev?apiKey=%s",
+                                provider_quotas[QUOTA_POLYGON].base_url, sanitized_ticker, api_key);
+                    }
+                    break;
+                    
+                default:
+                    error = ERROR_INVALID_DATA_SOURCE;
+            }
+            break;
+            
+        case MARKET_DATA_DIVIDEND_YIELD:
+            // Currently only Alpha Vantage is supported for dividend yield
+            source = DATA_SOURCE_ALPHAVANTAGE;
             api_key = alphavantage_api_key;
-            if (api_key == NULL) {
-                if (error_code) *error_code = ERROR_API_KEY_NOT_SET;
-                free(cache_path);
-                free(sanitized_ticker);
-                return -1.0;
+            if (api_key != NULL) {
+                snprintf(pending->url, MAX_URL_LENGTH, 
+                        "%s/query?function=OVERVIEW&symbol=%s&apikey=%s",
+                        provider_quotas[QUOTA_ALPHAVANTAGE].base_url, sanitized_ticker, api_key);
             }
-            snprintf(url, MAX_URL_LENGTH, 
-                    "https://www.alphavantage.co/query?function=GLOBAL_QUOTE&symbol=%s&apikey=%s",
-                    sanitized_ticker, api_key);
             break;
             
-        case DATA_SOURCE_FINNHUB:
-            api_key = finnhub_api_key;
-            if (api_key == NULL) {
-                if (error_code) *error_code = ERROR_API_KEY_NOT_SET;
-                free(cache_path);
-                free(sanitized_ticker);
-                return -1.0;
+        default:
+            // Historical volatility: only Alpha Vantage is implemented
+            if (source == DATA_SOURCE_ALPHAVANTAGE) {
+                api_key = alphavantage_api_key;
+                if (api_key != NULL) {
+                    // Use DAILY adjusted time series to get historical prices;
+                    // a store that only needs the latest days gets the compact series
+                    snprintf(pending->url, MAX_URL_LENGTH, 
+                            "%s/query?function=TIME_SERIES_DAILY_ADJUSTED&symbol=%s&outputsize=%s&apikey=%s",
+                            provider_quotas[QUOTA_ALPHAVANTAGE].base_url, sanitized_ticker, compact ? "compact" : "full", api_key);
+                }
+            } else if (source == DATA_SOURCE_FINNHUB || source == DATA_SOURCE_POLYGON) {
+                error = ERROR_NOT_IMPLEMENTED;
+            } else {
+                error = ERROR_INVALID_DATA_SOURCE;
             }
-            snprintf(url, MAX_URL_LENGTH, 
-                    "https://finnhub.io/api/v1/quote?symbol=%s&token=%s",
-                    sanitized_ticker, api_key);
+            break;
+    }
+    
+    // No longer need the sanitized ticker
+    free(sanitized_ticker);
+    
+    if (error == ERROR_SUCCESS && api_key == NULL) {
+        error = ERROR_API_KEY_NOT_SET;
+    }
+    if (error != ERROR_SUCCESS) {
+        finish_entry(req, -1.0, error);
+        return 0;
+    }
+    
+    // Parsing depends on the source actually asked
+    pending->source = source;
+    return 1;
+}
+
+// Parse the response of a batch entry and cache the result
+static void complete_entry(MarketDataRequest *req, PendingEntry *pending, const Transfer *transfer) {
+    const char *response = transfer->response.data;
+    double value = -1.0;
+    int valid = 0;
+    
+    switch (req->field) {
+        case MARKET_DATA_PRICE:
+            // Only Alpha Vantage quotes are parsed so far
+            if (response != NULL && pending->source == DATA_SOURCE_ALPHAVANTAGE) {
+                value = pending->bulk ? parse_price_alphavantage_bulk(response, req->ticker)
+                                      : parse_price_alphavantage(response, req->ticker);
+            }
+            valid = value > 0;
             break;
             
-        case DATA_SOURCE_POLYGON:
-            api_key = polygon_api_key;
-            if (api_key == NULL) {
-                if (error_code) *error_code = ERROR_API_KEY_NOT_SET;
-                free(cache_path);
-                free(sanitized_ticker);
-                return -1.0;
+        case MARKET_DATA_DIVIDEND_YIELD:
+            if (response != NULL) {
+                value = parse_dividend_yield_alphavantage(response, req->ticker);
             }
-            snprintf(url, MAX_URL_LENGTH, 
-                    "https://api.polygon.io/v2/aggs/ticker/%s/prev?apiKey=%s",
-                    sanitized_ticker, api_key);
+            valid = value >= 0;
+            break;
+            
+        case MARKET_DATA_RISK_FREE_RATE:
+            // If the API request failed this falls back to placeholder data
+            value = parse_risk_free_rate_treasury(response, rate_term_string(req->term));
+            valid = value >= 0;
             break;
             
         default:
-            if (error_code) *error_code = ERROR_INVALID_DATA_SOURCE;
-            free(cache_path);
-            free(sanitized_ticker);
-            return -1.0;
+            if (response != NULL) {
+                value = store_and_measure_volatility(req->ticker, response, req->days);
+            }
+            valid = value > 0;
+            break;
     }
     
-    // No longer need the sanitized ticker
-    free(sanitized_ticker);
+    // Cache result if valid
+    if (valid) {
+        char value_str[32];
+        snprintf(value_str, sizeof(value_str), "%.6f", value);
+        save_to_cache(pending->cache_path, value_str);
+        finish_entry(req, value, ERROR_SUCCESS);
+    } else if (pending->has_stale) {
+        // An expired value rather than none while the provider cannot be asked
+        PERF_COUNT(PERF_MARKET_STALE_HIT);
+        finish_entry(req, pending->stale_value, ERROR_SUCCESS);
+        req->stale = 1;
+    } else if (transfer->throttled) {
+        finish_entry(req, -1.0, ERROR_RATE_LIMITED);
+    } else if (req->field == MARKET_DATA_RISK_FREE_RATE && response == NULL) {
+        finish_entry(req, -1.0, ERROR_RATE_NOT_AVAILABLE);
+    } else if (response == NULL) {
+        finish_entry(req, -1.0, ERROR_API_REQUEST_FAILED);
+    } else {
+        finish_entry(req, -1.0, ERROR_PARSING_API_RESPONSE);
+    }
+}
+
+// Alpha Vantage price entries that can share a bulk quote
+static int is_bulk_candidate(const MarketDataRequest *req, const PendingEntry *pending) {
+    return pending->needs_request && req->field == MARKET_DATA_PRICE &&
+           pending->source == DATA_SOURCE_ALPHAVANTAGE;
+}
+
+/**
+ * Point the Alpha Vantage price entries of the batch at bulk quote URLs of
+ * up to MAX_BULK_SYMBOLS tickers each, if bulk quotes are enabled. A group
+ * left with a single ticker keeps its GLOBAL_QUOTE URL.
+ */
+static void group_bulk_quotes(const MarketDataRequest *requests, PendingEntry *pending, int count) {
+    if (!alphavantage_bulk_quotes || alphavantage_api_key == NULL) {
+        return;
+    }
     
-    // Make API request
-    char *response = make_api_request(url);
-    if (response == NULL) {
-        if (error_code) *error_code = ERROR_API_REQUEST_FAILED;
-        free(cache_path);
-        return -1.0;
+    int *members = malloc(count * sizeof(int));
+    char *grouped = calloc(count, 1);
+    if (members == NULL || grouped == NULL) {
+        free(members);
+        free(grouped);
+        return;
+    }
+    
+    const size_t key_len = strlen("&apikey=") + strlen(alphavantage_api_key);
+    char url[MAX_URL_LENGTH];
+    int i, m;
+    for (;;) {
+        int member_count = 0;
+        int symbols = 0;
+        size_t len = (size_t)snprintf(url, sizeof(url), "%s/query?function=REALTIME_BULK_QUOTES&symbol=",
+                                      provider_quotas[QUOTA_ALPHAVANTAGE].base_url);
+        
+        for (i = 0; i < count; i++) {
+            if (grouped[i] || !is_bulk_candidate(&requests[i], &pending[i])) {
+                continue;
+            }
+            
+            // Further entries of a listed ticker join the group
+            int listed = 0;
+            for (m = 0; m < member_count && !listed; m++) {
+                listed = strcmp(requests[members[m]].ticker, requests[i].ticker) == 0;
+            }
+            if (!listed) {
+                // Tickers are validated, so they go into the URL as they are
+                size_t ticker_len = strlen(requests[i].ticker);
+                if (symbols == MAX_BULK_SYMBOLS || len + 1 + ticker_len + key_len >= sizeof(url)) {
+                    continue;  // Left for the next group
+                }
+                len += (size_t)snprintf(url + len, sizeof(url) - len, "%s%s",
+                                        symbols > 0 ? "," : "", requests[i].ticker);
+                symbols++;
+            }
+            members[member_count++] = i;
+            grouped[i] = 1;
+        }
+        
+        if (symbols == 0) {
+            break;
+        }
+        if (symbols > 1) {
+            snprintf(url + len, sizeof(url) - len, "&apikey=%s", alphavantage_api_key);
+            for (m = 0; m < member_count; m++) {
+                memcpy(pending[members[m]].url, url, sizeof(url));
+                pending[members[m]].bulk = 1;
+            }
+        }
+    }
+    
+    free(members);
+    free(grouped);
+}
+
+/**
+ * Fetch the entries of a batch that need a request and complete them.
+ * Entries that need the same URL (e.g. volatilities over several periods,
+ * or the prices of one bulk quote) share one transfer. With coalesce set,
+ * URLs that another process is fetching are left to it: their entries are
+ * marked waiting, and this returns once that process is done, with the
+ * number of waiting entries.
+ */
+static int fetch_entries(MarketDataRequest *requests, PendingEntry *pending, Transfer *transfers,
+                         int count, int coalesce) {
+    int i, j;
+    int transfer_count = 0;
+    int waiting = 0;
+    
+    group_bulk_quotes(requests, pending, count);
+    
+    for (i = 0; i < count; i++) {
+        pending[i].waiting = 0;
+        if (!pending[i].needs_request) {
+            continue;
+        }
+        
+        for (j = 0; j < transfer_count; j++) {
+            if (strcmp(transfers[j].url, pending[i].url) == 0) {
+                break;
+            }
+        }
+        if (j == transfer_count) {
+            memset(&transfers[j], 0, sizeof(Transfer));
+            transfers[j].url = pending[i].url;
+            transfers[j].max_size = pending[i].max_size;
+            transfers[j].claim = -1;
+            transfer_count++;
+        }
+        
+        // Entries with a stale value to fall back on do not wait for the quota
+        if (!pending[i].has_stale) {
+            transfers[j].max_wait = rate_limit_wait_seconds;
+        }
+        pending[i].transfer = j;
     }
     
-    // Parse response based on source
-    double price = -1.0;
-    
-    switch (source) {
-        case DATA_SOURCE_ALPHAVANTAGE:
-            price = parse_price_alphavantage(response, ticker);
-            break;
-            
-        case DATA_SOURCE_FINNHUB:
-            // Implementation for Finnhub would go here
-            price = -1.0;
-            break;
-            
-        case DATA_SOURCE_POLYGON:
-            // Implementation for Polygon would go here
-            price = -1.0;
-            break;
-            
-        default:
-            price = -1.0;
+    if (transfer_count == 0) {
+        return 0;
     }
     
-    // Cache result if valid
-    if (price > 0) {
-        char price_str[32];
-        snprintf(price_str, sizeof(price_str), "%.6f", price);
-        save_to_cache(cache_path, price_str);
+    if (coalesce) {
+        for (j = 0; j < transfer_count; j++) {
+            transfers[j].claim = claim_inflight(transfers[j].url);
+            transfers[j].deferred = transfers[j].claim == -2;
+            if (transfers[j].deferred) {
+                PERF_COUNT(PERF_MARKET_COALESCED);
+            }
+        }
     }
     
-    free(response);
-    free(cache_path);
+    perform_transfers(transfers, transfer_count);
     
-    if (price <= 0) {
-        if (error_code) *error_code = ERROR_PARSING_API_RESPONSE;
-        return -1.0;
+    for (i = 0; i < count; i++) {
+        if (!pending[i].needs_request) {
+            continue;
+        }
+        if (transfers[pending[i].transfer].deferred) {
+            pending[i].waiting = 1;
+            waiting++;
+            continue;
+        }
+        complete_entry(&requests[i], &pending[i], &transfers[pending[i].transfer]);
+    }
+    
+    // Results are cached by now; other processes waiting on our claims
+    // find them there. Only then wait for the claims of others.
+    for (j = 0; j < transfer_count; j++) {
+        if (transfers[j].claim >= 0) {
+            close(transfers[j].claim);
+        }
+        free(transfers[j].response.data);
+    }
+    for (j = 0; j < transfer_count; j++) {
+        if (transfers[j].deferred) {
+            wait_inflight(transfers[j].url);
+        }
     }
     
-    if (error_code) *error_code = ERROR_SUCCESS;
-    return price;
+    return waiting;
 }
 
-// Helper function for API requests
-static size_t write_callback(void *contents, size_t size, size_t nmemb, void *userp) {
-    size_t real_size = size * nmemb;
-    APIResponse *resp = (APIResponse*)userp;
+// Implementation of get_market_data_batch
+int get_market_data_batch(MarketDataRequest* requests, int count) {
+    int i;
     
-    // Check for buffer overrun or memory issues
-    if (resp->size + real_size > MAX_BUFFER_SIZE) {
-        return 0;  // Too much data, prevent buffer overflow
+    if (requests == NULL || count <= 0) {
+        return ERROR_INVALID_PARAMETER;
     }
     
-    char *ptr = realloc(resp->data, resp->size + real_size + 1);
-    if (ptr == NULL) {
-        // Handle memory allocation failure
-        if (resp->data) {
-            free(resp->data);
-            resp->data = NULL;
+    if (!is_initialized) {
+        for (i = 0; i < count; i++) {
+            finish_entry(&requests[i], -1.0, ERROR_MODULE_NOT_INITIALIZED);
         }
-        resp->size = 0;
-        return 0;  // Signal error to curl
+        return ERROR_MODULE_NOT_INITIALIZED;
     }
     
-    resp->data = ptr;
-    memcpy(&(resp->data[resp->size]), contents, real_size);
-    resp->size += real_size;
-    resp->data[resp->size] = 0;
-    
-    return real_size;
-}
-
-static char* make_api_request(const char *url) {
-    if (url == NULL) return NULL;
-    
-    CURL *curl;
-    CURLcode res;
-    APIResponse response = {0};
+    PendingEntry *pending = malloc(count * sizeof(PendingEntry));
+    Transfer *transfers = calloc(count, sizeof(Transfer));
+    if (pending == NULL || transfers == NULL) {
+        free(pending);
+        free(transfers);
+        for (i = 0; i < count; i++) {
+            finish_entry(&requests[i], -1.0, ERROR_MEMORY_ALLOCATION);
+        }
+        return count;
+    }
     
-    // Initialize response data
-    response.data = malloc(1);
-    if (response.data == NULL) {
-        return NULL;  // Memory allocation failed
+    for (i = 0; i < count; i++) {
+        pending[i].needs_request = prepare_entry(&requests[i], &pending[i]);
     }
     
-    response.size = 0;
-    response.data[0] = '\0';
+    if (fetch_entries(requests, pending, transfers, count, 1) > 0) {
+        // The other process has cached what it fetched for the waiting
+        // entries; whatever it could not get is fetched here
+        for (i = 0; i < count; i++) {
+            if (pending[i].waiting) {
+                free(pending[i].cache_path);
+                pending[i].needs_request = prepare_entry(&requests[i], &pending[i]);
+            } else {
+                pending[i].needs_request = 0;
+            }
+        }
+        fetch_entries(requests, pending, transfers, count, 0);
+    }
     
-    curl = curl_easy_init();
-    if (curl) {
-        curl_easy_setopt(curl, CURLOPT_URL, url);
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)&response);
-        curl_easy_setopt(curl, CURLOPT_USERAGENT, "unified-option-tools/1.0");
-        curl_easy_setopt(curl, CURLOPT_TIMEOUT, 10L);
-        
-        // Set secure options
-        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 1L);
-        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 2L);
-        
-        res = curl_easy_perform(curl);
-        curl_easy_cleanup(curl);
-        
-        if (res != CURLE_OK) {
-            free(response.data);
-            return NULL;
+    int failed = 0;
+    for (i = 0; i < count; i++) {
+        if (requests[i].error_code != ERROR_SUCCESS) {
+            failed++;
         }
-    } else {
-        free(response.data);
-        return NULL;
+        free(pending[i].cache_path);
     }
     
-    return response.data;
+    free(transfers);
+    free(pending);
+    
+    return failed;
 }
 
 // Sanitize ticker symbol for safe use in URLs
@@ -564,6 +1511,10 @@ static char* load_from_cache(const char *cache_path) {
     fseek(cache_file, 0, SEEK_END);
     long file_size = ftell(cache_file);
     rewind(cache_file);
+    if (file_size < 0) {
+        fclose(cache_file);
+        return NULL;
+    }
     
     // Allocate memory for file content
     char *buffer = malloc(file_size + 1);
@@ -576,7 +1527,7 @@ static char* load_from_cache(const char *cache_path) {
     size_t read_size = fread(buffer, 1, file_size, cache_file);
     fclose(cache_file);
     
-    if (read_size != file_size) {
+    if (read_size != (size_t)file_size) {
         free(buffer);
         return NULL;
     }
@@ -585,6 +1536,32 @@ static char* load_from_cache(const char *cache_path) {
     return buffer;
 }
 
+/**
+ * Load an expired cached value that is still within the stale window.
+ * Returns 1 with the value, 0 if there is none to serve.
+ */
+static int load_stale_value(const char *cache_path, MarketDataField field, double *value) {
+    struct stat attr;
+    if (cache_stale_seconds <= 0 || stat(cache_path, &attr) != 0) {
+        return 0;
+    }
+    
+    time_t now = time(NULL);
+    if ((now - attr.st_mtime) > (time_t)cache_expiry_seconds + cache_stale_seconds) {
+        return 0;
+    }
+    
+    char *cached_data = load_from_cache(cache_path);
+    if (cached_data == NULL) {
+        return 0;
+    }
+    *value = atof(cached_data);
+    free(cached_data);
+    
+    // Same rule as for fresh values: a price must be positive
+    return field != MARKET_DATA_PRICE || *value > 0;
+}
+
 // Parse functions for different API responses
 static double parse_price_alphavantage(const char *json_data, const char *ticker) {
     if (json_data == NULL || ticker == NULL) {
@@ -616,6 +1593,45 @@ static double parse_price_alphavantage(const char *json_data, const char *ticker
     return price_value;
 }
 
+// Price of one ticker in a REALTIME_BULK_QUOTES response
+static double parse_price_alphavantage_bulk(const char *json_data, const char *ticker) {
+    if (json_data == NULL || ticker == NULL) {
+        return -1.0;
+    }
+    
+    json_error_t error;
+    json_t *root = json_loads(json_data, 0, &error);
+    
+    if (!root) {
+        return -1.0;
+    }
+    
+    json_t *quotes = json_object_get(root, "data");
+    if (!quotes || !json_is_array(quotes)) {
+        json_decref(root);
+        return -1.0;
+    }
+    
+    double price_value = -1.0;
+    size_t index;
+    json_t *quote;
+    json_array_foreach(quotes, index, quote) {
+        json_t *symbol = json_object_get(quote, "symbol");
+        if (!symbol || !json_is_string(symbol) || strcasecmp(json_string_value(symbol), ticker) != 0) {
+            continue;
+        }
+        
+        json_t *price = json_object_get(quote, "close");
+        if (price && json_is_string(price)) {
+            price_value = atof(json_string_value(price));
+        }
+        break;
+    }
+    json_decref(root);
+    
+    return price_value;
+}
+
 static double parse_dividend_yield_alphavantage(const char *json_data, const char *ticker) {
     if (json_data == NULL || ticker == NULL) {
         return -1.0;
@@ -664,433 +1680,257 @@ static double parse_risk_free_rate_treasury(const char *csv_data, const char *te
 
 // Implementation of get_dividend_yield
 double get_dividend_yield(const char *ticker, DataSource source, int *error_code) {
-    if (!is_initialized) {
-        if (error_code) *error_code = ERROR_MODULE_NOT_INITIALIZED;
-        return -1.0;
-    }
-    
-    // Validate ticker
-    if (!validate_ticker_symbol(ticker)) {
-        if (error_code) *error_code = ERROR_INVALID_TICKER;
-        return -1.0;
-    }
-    
-    // Use preferred source if not specified
-    if (source == DATA_SOURCE_DEFAULT) {
-        source = preferred_source;
-    }
-    
-    // Check cache first
-    char *cache_path = get_cache_path(ticker, "dividend");
-    if (cache_path == NULL) {
-        if (error_code) *error_code = ERROR_MEMORY_ALLOCATION;
-        return -1.0;
-    }
-    
-    if (is_cache_valid(cache_path)) {
-        char *cached_data = load_from_cache(cache_path);
-        if (cached_data != NULL) {
-            double yield = atof(cached_data);
-            free(cached_data);
-            free(cache_path);
-            
-            if (error_code) *error_code = ERROR_SUCCESS;
-            return yield;
-        }
-    }
-    
-    // Prepare API request
-    char url[MAX_URL_LENGTH];
-    char *api_key = NULL;
-    char *sanitized_ticker = sanitize_ticker_symbol(ticker);
-    
-    if (sanitized_ticker == NULL) {
-        free(cache_path);
-        if (error_code) *error_code = ERROR_MEMORY_ALLOCATION;
-        return -1.0;
-    }
-    
-    // Currently only Alpha Vantage is supported for dividend yield
-    if (source != DATA_SOURCE_ALPHAVANTAGE) {
-        source = DATA_SOURCE_ALPHAVANTAGE;
-    }
-    
-    api_key = alphavantage_api_key;
-    if (api_key == NULL) {
-        if (error_code) *error_code = ERROR_API_KEY_NOT_SET;
-        free(cache_path);
-        free(sanitized_ticker);
-        return -1.0;
-    }
-    
-    snprintf(url, MAX_URL_LENGTH, 
-            "https://www.alphavantage.co/query?function=OVERVIEW&symbol=%s&apikey=%s",
-            sanitized_ticker, api_key);
-    
-    // No longer need the sanitized ticker
-    free(sanitized_ticker);
-    
-    // Make API request
-    char *response = make_api_request(url);
-    if (response == NULL) {
-        if (error_code) *error_code = ERROR_API_REQUEST_FAILED;
-        free(cache_path);
-        return -1.0;
-    }
-    
-    // Parse response
-    double yield = parse_dividend_yield_alphavantage(response, ticker);
-    
-    // Cache result if valid
-    if (yield >= 0) {
-        char yield_str[32];
-        snprintf(yield_str, sizeof(yield_str), "%.6f", yield);
-        save_to_cache(cache_path, yield_str);
-    }
-    
-    free(response);
-    free(cache_path);
-    
-    if (yield < 0) {
-        if (error_code) *error_code = ERROR_PARSING_API_RESPONSE;
-        return -1.0;
-    }
-    
-    if (error_code) *error_code = ERROR_SUCCESS;
-    return yield;
+    MarketDataRequest req = {0};
+    req.field = MARKET_DATA_DIVIDEND_YIELD;
+    req.ticker = ticker;
+    req.source = source;
+    return fetch_single(&req, error_code);
 }
 
-// Implementation of get_risk_free_rate - improved version
+// Implementation of get_risk_free_rate
 double get_risk_free_rate(RateTerm term, int *error_code) {
-    if (!is_initialized) {
-        if (error_code) *error_code = ERROR_MODULE_NOT_INITIALIZED;
-        return -1.0;
-    }
-    
-    // Convert term enum to string for caching and API
-    const char *term_str;
-    switch (term) {
-        case RATE_TERM_1M: term_str = "1month"; break;
-        case RATE_TERM_3M: term_str = "3month"; break;
-        case RATE_TERM_6M: term_str = "6month"; break;
-        case RATE_TERM_1Y: term_str = "1year"; break;
-        case RATE_TERM_2Y: term_str = "2year"; break;
-        case RATE_TERM_5Y: term_str = "5year"; break;
-        case RATE_TERM_10Y: term_str = "10year"; break;
-        case RATE_TERM_30Y: term_str = "30year"; break;
-        default:
-            if (error_code) *error_code = ERROR_INVALID_RATE_TERM;
-            return -1.0;
-    }
-    
-    // Check cache first
-    char *cache_path = get_cache_path("treasury", term_str);
-    if (cache_path == NULL) {
-        if (error_code) *error_code = ERROR_MEMORY_ALLOCATION;
-        return -1.0;
-    }
-    
-    if (is_cache_valid(cache_path)) {
-        char *cached_data = load_from_cache(cache_path);
-        if (cached_data != NULL) {
-            double rate = atof(cached_data);
-            free(cached_data);
-            free(cache_path);
-            
-            if (error_code) *error_code = ERROR_SUCCESS;
-            return rate;
-        }
-    }
-    
-    // Prepare API request to fetch the latest Treasury rates
-    char url[MAX_URL_LENGTH];
-    
-    // Use Treasury.gov API for daily Treasury rates
-    // Note: The actual URL would depend on the real API endpoint
-    snprintf(url, MAX_URL_LENGTH, 
-            "https://home.treasury.gov/resource-center/data-chart-center/interest-rates/daily-treasury-rates.csv/all/%s",
-            term_str);
-    
-    // Make API request
-    char *response = make_api_request(url);
-    
-    // If API request fails, fall back to placeholder data
-    if (response == NULL) {
-        double rate = parse_risk_free_rate_treasury(NULL, term_str);
-        
-        // Cache result if valid
-        if (rate >= 0) {
-            char rate_str[32];
-            snprintf(rate_str, sizeof(rate_str), "%.6f", rate);
-            save_to_cache(cache_path, rate_str);
-        }
-        
-        free(cache_path);
-        
-        if (rate < 0) {
-            if (error_code) *error_code = ERROR_RATE_NOT_AVAILABLE;
-            return -1.0;
-        }
-        
-        if (error_code) *error_code = ERROR_SUCCESS;
-        return rate;
-    }
-    
-    // Parse response
-    double rate = parse_risk_free_rate_treasury(response, term_str);
-    
-    // Cache result if valid
-    if (rate >= 0) {
-        char rate_str[32];
-        snprintf(rate_str, sizeof(rate_str), "%.6f", rate);
-        save_to_cache(cache_path, rate_str);
-    }
-    
-    free(response);
-    free(cache_path);
-    
-    if (rate < 0) {
-        if (error_code) *error_code = ERROR_PARSING_API_RESPONSE;
-        return -1.0;
-    }
-    
-    if (error_code) *error_code = ERROR_SUCCESS;
-    return rate;
+    MarketDataRequest req = {0};
+    req.field = MARKET_DATA_RISK_FREE_RATE;
+    req.term = term;
+    return fetch_single(&req, error_code);
 }
 
 // Implementation of get_historical_volatility
 double get_historical_volatility(const char *ticker, int period_days, DataSource source, int *error_code) {
-    if (!is_initialized) {
-        if (error_code) *error_code = ERROR_MODULE_NOT_INITIALIZED;
-        return -1.0;
-    }
-    
-    // Validate ticker
-    if (!validate_ticker_symbol(ticker)) {
-        if (error_code) *error_code = ERROR_INVALID_TICKER;
-        return -1.0;
-    }
-    
-    // Validate period_days
-    if (period_days <= 0 || period_days > 365*2) {  // Added upper limit check
-        if (error_code) *error_code = ERROR_INVALID_DAYS_PARAMETER;
-        return -1.0;
-    }
-    
-    // Use preferred source if not specified
-    if (source == DATA_SOURCE_DEFAULT) {
-        source = preferred_source;
-    }
-    
-    // Check cache
-    char cache_key[64];
-    snprintf(cache_key, sizeof(cache_key), "vol_%d", period_days);
-    
-    char *cache_path = get_cache_path(ticker, cache_key);
-    if (cache_path == NULL) {
-        if (error_code) *error_code = ERROR_MEMORY_ALLOCATION;
+    MarketDataRequest req = {0};
+    req.field = MARKET_DATA_HISTORICAL_VOLATILITY;
+    req.ticker = ticker;
+    req.source = source;
+    req.days = period_days;
+    return fetch_single(&req, error_code);
+}
+
+/**
+ * Calculate historical volatility from time series data
+ */
+double calculate_historical_volatility_from_data(const char *json_data, int period_days) {
+    if (json_data == NULL || period_days <= 0) {
         return -1.0;
     }
     
-    if (is_cache_valid(cache_path)) {
-        char *cached_data = load_from_cache(cache_path);
-        if (cached_data != NULL) {
-            double vol = atof(cached_data);
-            free(cached_data);
-            free(cache_path);
-            
-            if (error_code) *error_code = ERROR_SUCCESS;
-            return vol;
-        }
-    }
-    
-    // Prepare API request
-    char url[MAX_URL_LENGTH];
-    char *api_key = NULL;
-    char *sanitized_ticker = sanitize_ticker_symbol(ticker);
-    
-    if (sanitized_ticker == NULL) {
-        free(cache_path);
-        if (error_code) *error_code = ERROR_MEMORY_ALLOCATION;
+    TSBar *bars = NULL;
+    int count = parse_bars_alphavantage(json_data, &bars);
+    if (count <= 1) {
+        free(bars);
         return -1.0;
     }
     
-    // Construct URL based on data source
-    switch (source) {
-        case DATA_SOURCE_ALPHAVANTAGE:
-            api_key = alphavantage_api_key;
-            if (api_key == NULL) {
-                if (error_code) *error_code = ERROR_API_KEY_NOT_SET;
-                free(cache_path);
-                free(sanitized_ticker);
-                return -1.0;
-            }
-            
-            // Use DAILY adjusted time series to get historical prices
-            snprintf(url, MAX_URL_LENGTH, 
-                    "https://www.alphavantage.co/query?function=TIME_SERIES_DAILY_ADJUSTED&symbol=%s&outputsize=full&apikey=%s",
-                    sanitized_ticker, api_key);
-            break;
-            
-        case DATA_SOURCE_FINNHUB:
-        case DATA_SOURCE_POLYGON:
-            // For future implementation
-            if (error_code) *error_code = ERROR_NOT_IMPLEMENTED;
-            free(cache_path);
-            free(sanitized_ticker);
-            return -1.0;
-            
-        default:
-            if (error_code) *error_code = ERROR_INVALID_DATA_SOURCE;
-            free(cache_path);
-            free(sanitized_ticker);
-            return -1.0;
-    }
-    
-    // No longer need the sanitized ticker
-    free(sanitized_ticker);
-    
-    // Make API request
-    char *response = make_api_request(url);
-    if (response == NULL) {
-        if (error_code) *error_code = ERROR_API_REQUEST_FAILED;
-        free(cache_path);
+    // Collect closing prices, oldest first
+    double *prices = malloc(count * sizeof(double));
+    if (prices == NULL) {
+        free(bars);
         return -1.0;
     }
     
-    // Calculate historical volatility from the response
-    double volatility = calculate_historical_volatility_from_data(response, period_days);
-    
-    // Cache result if valid
-    if (volatility > 0) {
-        char vol_str[32];
-        snprintf(vol_str, sizeof(vol_str), "%.6f", volatility);
-        save_to_cache(cache_path, vol_str);
+    for (int i = 0; i < count; i++) {
+        prices[i] = bars[i].close;
     }
     
-    free(response);
-    free(cache_path);
+    double volatility = ts_historical_volatility(prices, count, period_days);
     
-    if (volatility <= 0) {
-        if (error_code) *error_code = ERROR_PARSING_API_RESPONSE;
-        return -1.0;
-    }
+    free(prices);
+    free(bars);
     
-    if (error_code) *error_code = ERROR_SUCCESS;
     return volatility;
 }
 
+// Numeric field of an Alpha Vantage bar (values are sent as strings)
+static double bar_field(json_t *day_data, const char *key) {
+    json_t *field = json_object_get(day_data, key);
+    return (field && json_is_string(field)) ? atof(json_string_value(field)) : 0.0;
+}
+
 /**
- * Calculate historical volatility from time series data
+ * Parse the daily bars of an Alpha Vantage TIME_SERIES_DAILY(_ADJUSTED)
+ * response, sorted by date. Returns the number of bars or -1.
  */
-double calculate_historical_volatility_from_data(const char *json_data, int period_days) {
-    if (json_data == NULL || period_days <= 0) {
-        return -1.0;
-    }
+static int parse_bars_alphavantage(const char *json_data, TSBar **bars) {
+    *bars = NULL;
     
     json_error_t error;
     json_t *root = json_loads(json_data, 0, &error);
     
     if (!root) {
-        return -1.0;
+        return -1;
     }
     
     json_t *time_series = json_object_get(root, "Time Series (Daily)");
     if (!time_series || !json_is_object(time_series)) {
         json_decref(root);
-        return -1.0;
-    }
-    
-    // Collect closing prices
-    double *prices = malloc((period_days + 1) * sizeof(double));
-    if (prices == NULL) {
-        json_decref(root);
-        return -1.0;
+        return -1;
     }
     
-    // Get all keys (dates) and sort them in descending order
     size_t key_count = json_object_size(time_series);
-    const char **keys = malloc(key_count * sizeof(char*));
-    if (keys == NULL) {
-        free(prices);
+    *bars = malloc((key_count > 0 ? key_count : 1) * sizeof(TSBar));
+    if (*bars == NULL) {
         json_decref(root);
-        return -1.0;
+        return -1;
     }
     
-    size_t i = 0;
+    int count = 0;
     const char *key;
     json_t *value;
     
     json_object_foreach(time_series, key, value) {
-        keys[i++] = key;
+        int32_t date = ts_parse_date(key);
+        json_t *close = json_object_get(value, "4. close");
+        if (date < 0 || !close || !json_is_string(close)) {
+            continue;
+        }
+        
+        TSBar *bar = &(*bars)[count++];
+        bar->date = date;
+        bar->open = bar_field(value, "1. open");
+        bar->high = bar_field(value, "2. high");
+        bar->low = bar_field(value, "3. low");
+        bar->close = atof(json_string_value(close));
+        
+        // The adjusted series moves the volume to field 6
+        bar->volume = json_object_get(value, "6. volume") ? bar_field(value, "6. volume")
+                                                          : bar_field(value, "5. volume");
     }
     
-    // Simple bubble sort for dates (since we only need the most recent ones)
-    for (i = 0; i < key_count - 1; i++) {
-        for (size_t j = 0; j < key_count - i - 1; j++) {
-            if (strcmp(keys[j], keys[j + 1]) < 0) {
-                const char *temp = keys[j];
-                keys[j] = keys[j + 1];
-                keys[j + 1] = temp;
-            }
-        }
+    json_decref(root);
+    return ts_sort_bars(*bars, count);
+}
+
+/**
+ * Map the ticker's bar store and report whether it holds at least min_bars
+ * bars and how current it is. For BAR_STORE_CURRENT the view is left open
+ * and must be closed by the caller.
+ */
+static BarStoreState check_bar_store(const char *ticker, int min_bars, TimeSeriesView *view) {
+    if (!validate_ticker_symbol(ticker)) {
+        return BAR_STORE_NEEDS_FULL;
+    }
+    
+    char *store_path = get_cache_path(ticker, "bars");
+    if (store_path == NULL) {
+        return BAR_STORE_NEEDS_FULL;
     }
     
-    // Extract closing prices for the most recent period_days
-    int valid_days = 0;
-    for (i = 0; i < key_count && valid_days <= period_days; i++) {
-        json_t *day_data = json_object_get(time_series, keys[i]);
-        if (day_data && json_is_object(day_data)) {
-            json_t *close = json_object_get(day_data, "4. close");
-            if (close && json_is_string(close)) {
-                prices[valid_days++] = atof(json_string_value(close));
+    BarStoreState state = BAR_STORE_NEEDS_FULL;
+    struct stat attr;
+    if (stat(store_path, &attr) == 0 && ts_store_open(store_path, view) == 0) {
+        if (view->count >= min_bars) {
+            if (is_cache_valid(store_path)) {
+                state = BAR_STORE_CURRENT;
+            } else if (time(NULL) - attr.st_mtime < COMPACT_UPDATE_SECONDS) {
+                state = BAR_STORE_NEEDS_UPDATE;
             }
         }
+        if (state != BAR_STORE_CURRENT) {
+            ts_store_close(view);
+        }
     }
     
-    free(keys);
+    free(store_path);
+    return state;
+}
+
+// Add the bars of an Alpha Vantage response to the ticker's store
+static int store_bars_alphavantage(const char *ticker, const char *json_data) {
+    if (!validate_ticker_symbol(ticker)) {
+        return -1;
+    }
     
-    if (valid_days <= 1) {
-        free(prices);
-        json_decref(root);
-        return -1.0;
+    TSBar *bars = NULL;
+    int count = parse_bars_alphavantage(json_data, &bars);
+    if (count <= 0) {
+        free(bars);
+        return -1;
     }
     
-    // Calculate log returns
-    double *returns = malloc((valid_days - 1) * sizeof(double));
-    if (returns == NULL) {
-        free(prices);
-        json_decref(root);
-        return -1.0;
+    char *store_path = get_cache_path(ticker, "bars");
+    int ret = store_path != NULL ? ts_store_append(store_path, bars, count) : -1;
+    
+    free(store_path);
+    free(bars);
+    return ret;
+}
+
+/**
+ * Volatility after adding a downloaded series to the ticker's store, so a
+ * compact update is measured together with the stored history
+ */
+static double store_and_measure_volatility(const char *ticker, const char *json_data, int period_days) {
+    if (store_bars_alphavantage(ticker, json_data) == 0) {
+        TimeSeriesView view;
+        char *store_path = get_cache_path(ticker, "bars");
+        if (store_path != NULL && ts_store_open(store_path, &view) == 0) {
+            double volatility = volatility_from_store(ticker, &view, period_days);
+            ts_store_close(&view);
+            free(store_path);
+            return volatility;
+        }
+        free(store_path);
     }
     
-    for (i = 0; i < valid_days - 1; i++) {
-        returns[i] = log(prices[i] / prices[i + 1]);
+    // The store is unavailable: measure the response on its own
+    return calculate_historical_volatility_from_data(json_data, period_days);
+}
+
+/**
+ * Volatility of a mapped bar store. The windows of
+ * get_volatility_period_for_expiry() come from the ticker's rolling state,
+ * which only has to consume the bars added since it was saved.
+ */
+static double volatility_from_store(const char *ticker, const TimeSeriesView *view, int period_days) {
+    char *state_path = rv_window_index(period_days) >= 0 ? get_cache_path(ticker, "rollvol") : NULL;
+    if (state_path == NULL) {
+        return ts_historical_volatility(view->close, view->count, period_days);
     }
     
-    // Calculate mean of returns
-    double sum = 0.0;
-    for (i = 0; i < valid_days - 1; i++) {
-        sum += returns[i];
+    RollingVolState state;
+    rv_state_load(state_path, &state);
+    if (rv_update(&state, view) > 0) {
+        rv_state_save(state_path, &state);
     }
-    double mean = sum / (valid_days - 1);
+    free(state_path);
     
-    // Calculate variance of returns
-    double variance = 0.0;
-    for (i = 0; i < valid_days - 1; i++) {
-        double diff = returns[i] - mean;
-        variance += diff * diff;
+    return rv_volatility(&state, period_days);
+}
+
+// Copy the last days closes and dates of a store, newest first
+static int prices_from_store(const TimeSeriesView *view, int days, double **prices, char ***dates) {
+    int count = view->count < days ? view->count : days;
+    if (count <= 0) {
+        return 0;
     }
-    variance /= (valid_days - 2);  // Use n-1 for sample variance
     
-    // Calculate annualized volatility
-    double volatility = sqrt(variance * 252.0);  // Assuming 252 trading days in a year
+    *prices = malloc(count * sizeof(double));
+    *dates = calloc(count, sizeof(char*));
+    if (*prices == NULL || *dates == NULL) {
+        free(*prices);
+        free(*dates);
+        *prices = NULL;
+        *dates = NULL;
+        return ERROR_MEMORY_ALLOCATION;
+    }
     
-    free(returns);
-    free(prices);
-    json_decref(root);
+    for (int i = 0; i < count; i++) {
+        int index = view->count - 1 - i;
+        (*prices)[i] = view->close[index];
+        (*dates)[i] = malloc(11);
+        if ((*dates)[i] == NULL) {
+            for (int j = 0; j < i; j++) {
+                free((*dates)[j]);
+            }
+            free(*prices);
+            free(*dates);
+            *prices = NULL;
+            *dates = NULL;
+            return ERROR_MEMORY_ALLOCATION;
+        }
+        ts_format_date(view->date[index], (*dates)[i]);
+    }
     
-    return volatility;
+    return count;
 }
 
 /**
@@ -1197,535 +2037,386 @@ int set_api_key(DataSource source, const char* api_key) {
 }
 
 /**
- * Get historical prices for a ticker symbol
+ * Get historical prices for a ticker symbol. Alpha Vantage closes come from
+ * the ticker's bar store, which a download updates; other providers' responses
+ * are cached as they are.
  */
 int get_historical_prices(const char* ticker, int days, DataSource source, 
                          double** prices, char*** dates, int* error_code) {
     int ret_code = ERROR_SUCCESS;
-    char *cache_key = NULL;
-    cJSON *json_response = NULL;
+    char *cache_path = NULL;
     char *response_data = NULL;
-    char api_url[URL_BUFFER_SIZE];
+    char *sanitized_ticker = NULL;
+    char cache_key[32];
+    char api_url[MAX_URL_LENGTH];
+    int count = 0;
+    int compact = 0;
+    int from_cache = 0;
     
     // Check if market data module is initialized
     if (!is_initialized) {
-        set_error(&ret_code, ERROR_MODULE_NOT_INITIALIZED);
+        ret_code = ERROR_MODULE_NOT_INITIALIZED;
         goto cleanup;
     }
     
     // Validate input parameters
-    if (ticker == NULL || strlen(ticker) == 0 || strlen(ticker) > MAX_TICKER_LENGTH) {
-        set_error(&ret_code, ERROR_INVALID_TICKER);
+    if (!validate_ticker_symbol(ticker)) {
+        ret_code = ERROR_INVALID_TICKER;
         goto cleanup;
     }
     
     if (days <= 0 || days > MAX_HISTORY_DAYS) {
-        set_error(&ret_code, ERROR_INVALID_DAYS_PARAMETER);
+        ret_code = ERROR_INVALID_DAYS_PARAMETER;
         goto cleanup;
     }
     
     if (prices == NULL || dates == NULL) {
-        set_error(&ret_code, ERROR_INVALID_PARAMETER);
+        ret_code = ERROR_INVALID_PARAMETER;
         goto cleanup;
     }
+    *prices = NULL;
+    *dates = NULL;
     
     // Use preferred data source if needed
     DataSource actual_source = (source == DATA_SOURCE_DEFAULT) ? 
                                preferred_source : source;
     
-    // Construct cache key
-    size_t cache_key_size = strlen(ticker) + 50;
-    cache_key = (char*)malloc(cache_key_size);
-    if (cache_key == NULL) {
-        set_error(&ret_code, ERROR_MEMORY_ALLOCATION);
-        goto cleanup;
-    }
-    snprintf(cache_key, cache_key_size, "historical_prices_%s_%d_%d", 
-             ticker, days, actual_source);
-    
-    // Check cache first
-    CachedData *cached = get_from_cache(cache_key);
-    if (cached != NULL && !is_cache_expired(cached)) {
-        // Parse cached JSON data
-        json_response = cJSON_Parse(cached->data);
-        if (json_response == NULL) {
-            set_error(&ret_code, ERROR_PARSING_API_RESPONSE);
+    if (actual_source == DATA_SOURCE_ALPHAVANTAGE) {
+        TimeSeriesView view;
+        BarStoreState state = check_bar_store(ticker, days, &view);
+        if (state == BAR_STORE_CURRENT) {
+            PERF_COUNT(PERF_MARKET_CACHE_HIT);
+            count = prices_from_store(&view, days, prices, dates);
+            ts_store_close(&view);
             goto cleanup;
         }
+        compact = state == BAR_STORE_NEEDS_UPDATE;
     } else {
+        // Check cache first
+        snprintf(cache_key, sizeof(cache_key), "history_%d_%d", (int)actual_source, days);
+        cache_path = get_cache_path(ticker, cache_key);
+        if (cache_path == NULL) {
+            ret_code = ERROR_MEMORY_ALLOCATION;
+            goto cleanup;
+        }
+        if (is_cache_valid(cache_path)) {
+            response_data = load_from_cache(cache_path);
+            from_cache = response_data != NULL;
+        }
+    }
+    
+    if (response_data == NULL) {
         // Need to fetch data from API
-        // Check if API key is set for the data source
         if (!is_api_key_set(actual_source)) {
-            set_error(&ret_code, ERROR_API_KEY_NOT_SET);
+            ret_code = ERROR_API_KEY_NOT_SET;
             goto cleanup;
         }
         
-        // Prepare API request based on data source
-        memset(api_url, 0, URL_BUFFER_SIZE);
+        sanitized_ticker = sanitize_ticker_symbol(ticker);
+        if (sanitized_ticker == NULL) {
+            ret_code = ERROR_MEMORY_ALLOCATION;
+            goto cleanup;
+        }
+        
+        time_t now = time(NULL);
+        time_t start_time = now - (time_t)days * 86400;
+        char start_date[11], end_date[11];
+        struct tm tm_buf;
+        strftime(start_date, sizeof(start_date), "%Y-%m-%d", gmtime_r(&start_time, &tm_buf));
+        strftime(end_date, sizeof(end_date), "%Y-%m-%d", gmtime_r(&now, &tm_buf));
         
         switch (actual_source) {
             case DATA_SOURCE_ALPHAVANTAGE:
-                snprintf(api_url, URL_BUFFER_SIZE,
-                         "https://www.alphavantage.co/query?function=TIME_SERIES_DAILY"
+                // A store that only needs the latest days gets the compact series
+                snprintf(api_url, sizeof(api_url),
+                         "%s/query?function=TIME_SERIES_DAILY"
                          "&symbol=%s&outputsize=%s&apikey=%s",
-                         ticker, (days > 100) ? "full" : "compact", api_keys[DATA_SOURCE_ALPHAVANTAGE]);
+                         provider_quotas[QUOTA_ALPHAVANTAGE].base_url, sanitized_ticker, (compact || days <= 100) ? "compact" : "full",
+                         alphavantage_api_key);
                 break;
                 
             case DATA_SOURCE_FINNHUB:
-                // Calculate start and end timestamps
-                time_t now = time(NULL);
-                time_t start_time = now - (days * 86400); // days in seconds
-                
-                snprintf(api_url, URL_BUFFER_SIZE,
-                         "https://finnhub.io/api/v1/stock/candle?symbol=%s"
+                snprintf(api_url, sizeof(api_url),
+                         "%s/api/v1/stock/candle?symbol=%s"
                          "&resolution=D&from=%ld&to=%ld&token=%s",
-                         ticker, start_time, now, api_keys[DATA_SOURCE_FINNHUB]);
+                         provider_quotas[QUOTA_FINNHUB].base_url, sanitized_ticker, (long)start_time, (long)now, finnhub_api_key);
                 break;
                 
             case DATA_SOURCE_POLYGON:
-                {
-                    // Calculate date range
-                    time_t now = time(NULL);
-                    time_t start_time = now - (days * 86400);
-                    struct tm *start_tm = localtime(&start_time);
-                    char date_str[20];
-                    strftime(date_str, sizeof(date_str), "%Y-%m-%d", start_tm);
-                    
-                    snprintf(api_url, URL_BUFFER_SIZE,
-                             "https://api.polygon.io/v2/aggs/ticker/%s/range/1/day/%s/today"
-                             "?apiKey=%s",
-                             ticker, date_str, api_keys[DATA_SOURCE_POLYGON]);
-                }
+                snprintf(api_url, sizeof(api_url),
+                         "%s/v2/aggs/ticker/%s/range/1/day/%s/%s"
+                         "?apiKey=%s",
+                         provider_quotas[QUOTA_POLYGON].base_url, sanitized_ticker, start_date, end_date, polygon_api_key);
                 break;
                 
             default:
-                set_error(&ret_code, ERROR_INVALID_DATA_SOURCE);
+                ret_code = ERROR_INVALID_DATA_SOURCE;
                 goto cleanup;
         }
         
         // Make API request
-        response_data = make_api_request(api_url);
-        if (ret_code != ERROR_SUCCESS || response_data == NULL) {
-            // Error already set
-            goto cleanup;
-        }
-        
-        // Parse JSON response
-        json_response = cJSON_Parse(response_data);
-        if (json_response == NULL) {
-            set_error(&ret_code, ERROR_PARSING_API_RESPONSE);
+        response_data = make_api_request(api_url, MAX_TIME_SERIES_BUFFER_SIZE);
+        if (response_data == NULL) {
+            ret_code = ERROR_API_REQUEST_FAILED;
             goto cleanup;
         }
-        
-        // Cache the response if valid
-        add_to_cache(cache_key, response_data);
+    } else {
+        PERF_COUNT(PERF_MARKET_CACHE_HIT);
     }
     
     // Process the response based on data source
-    int count = 0;
     switch (actual_source) {
         case DATA_SOURCE_ALPHAVANTAGE:
-            count = extract_alpha_vantage_prices(json_response, days, prices, dates);
+            count = history_from_store_alphavantage(ticker, response_data, days, prices, dates);
             break;
             
         case DATA_SOURCE_FINNHUB:
-            count = extract_finnhub_prices(json_response, days, prices, dates);
+            count = extract_finnhub_prices(response_data, days, prices, dates);
             break;
             
         case DATA_SOURCE_POLYGON:
-            count = extract_polygon_prices(json_response, days, prices, dates);
+            count = extract_polygon_prices(response_data, days, prices, dates);
             break;
             
         default:
-            set_error(&ret_code, ERROR_INVALID_DATA_SOURCE);
+            ret_code = ERROR_INVALID_DATA_SOURCE;
             goto cleanup;
     }
     
-    if (count <= 0) {
-        set_error(&ret_code, ERROR_PARSING_API_RESPONSE);
-        count = ret_code; // Return error code
+    // Only responses that parsed are cached
+    if (count > 0 && cache_path != NULL && !from_cache) {
+        save_to_cache(cache_path, response_data);
     }
     
 cleanup:
+    if (ret_code == ERROR_SUCCESS && count <= 0) {
+        ret_code = count < 0 ? count : ERROR_PARSING_API_RESPONSE;
+    }
+    
     // Set error code if requested
     if (error_code != NULL) {
         *error_code = ret_code;
     }
     
     // Free allocated resources
-    if (cache_key != NULL) {
-        free(cache_key);
-    }
-    if (json_response != NULL) {
-        cJSON_Delete(json_response);
-    }
-    if (response_data != NULL) {
-        free(response_data);
-    }
+    free(cache_path);
+    free(sanitized_ticker);
+    free(response_data);
     
     return (ret_code == ERROR_SUCCESS) ? count : ret_code;
 }
 
-/**
- * Extract historical prices from Alpha Vantage response
- */
-static int extract_alpha_vantage_prices(cJSON *json_response, int max_days, 
-                                       double **prices, char ***dates) {
-    if (json_response == NULL || prices == NULL || dates == NULL) {
-        return ERROR_INVALID_PARAMETER;
-    }
-    
-    // Get the time series data
-    cJSON *time_series = cJSON_GetObjectItem(json_response, "Time Series (Daily)");
-    if (time_series == NULL) {
-        return ERROR_PARSING_API_RESPONSE;
-    }
-    
-    // Count the number of days (up to max_days)
-    int count = 0;
-    cJSON *date_item = NULL;
-    cJSON_ArrayForEach(date_item, time_series) {
-        count++;
-        if (count >= max_days) {
-            break;
-        }
-    }
-    
-    if (count == 0) {
-        return ERROR_PARSING_API_RESPONSE;
-    }
-    
-    // Allocate memory for prices and dates
-    *prices = (double*)malloc(count * sizeof(double));
-    *dates = (char**)malloc(count * sizeof(char*));
+// Allocate the price and date arrays of count points
+static int alloc_price_history(int count, double **prices, char ***dates) {
+    *prices = malloc(count * sizeof(double));
+    *dates = calloc(count, sizeof(char*));
     
     if (*prices == NULL || *dates == NULL) {
-        if (*prices) free(*prices);
-        if (*dates) free(*dates);
+        free(*prices);
+        free(*dates);
         *prices = NULL;
         *dates = NULL;
         return ERROR_MEMORY_ALLOCATION;
     }
-    
-    // Extract data
-    count = 0;
-    date_item = NULL;
-    cJSON_ArrayForEach(date_item, time_series) {
-        if (count >= max_days) {
-            break;
-        }
-        
-        // Get the date (key)
-        const char *date_str = date_item->string;
-        
-        // Get the closing price
-        cJSON *data = date_item->child;
-        cJSON *close_price = cJSON_GetObjectItem(data, "4. close");
-        
-        if (close_price && close_price->valuestring) {
-            (*prices)[count] = atof(close_price->valuestring);
-            (*dates)[count] = strdup(date_str);
-            count++;
-        }
+    return 0;
+}
+
+// Add one point of a response; the date is a Unix time in seconds
+static int set_price_point(double **prices, char ***dates, int index, double price, double timestamp) {
+    char date_str[20];
+    time_t time_val = (time_t)timestamp;
+    struct tm tm_buf;
+    strftime(date_str, sizeof(date_str), "%Y-%m-%d", gmtime_r(&time_val, &tm_buf));
+    
+    (*prices)[index] = price;
+    (*dates)[index] = strdup(date_str);
+    return (*dates)[index] != NULL ? 0 : ERROR_MEMORY_ALLOCATION;
+}
+
+// Add a point the response has no price or date for
+static int set_missing_point(double **prices, char ***dates, int index) {
+    (*prices)[index] = 0.0;
+    (*dates)[index] = strdup("unknown");
+    return (*dates)[index] != NULL ? 0 : ERROR_MEMORY_ALLOCATION;
+}
+
+// Release the arrays filled so far after a failure
+static void free_price_history(int count, double **prices, char ***dates) {
+    for (int i = 0; i < count; i++) {
+        free((*dates)[i]);
     }
-    
-    return count;
+    free(*prices);
+    free(*dates);
+    *prices = NULL;
+    *dates = NULL;
 }
 
 /**
- * Extract historical prices from Finnhub response
+ * Historical prices from an Alpha Vantage TIME_SERIES_DAILY response, after
+ * adding its bars to the ticker's store, so that a compact update is read
+ * together with the stored history. Newest first.
  */
-static int extract_finnhub_prices(cJSON *json_response, int max_days, 
-                                 double **prices, char ***dates) {
-    if (json_response == NULL || prices == NULL || dates == NULL) {
-        return ERROR_INVALID_PARAMETER;
-    }
-    
-    // Check if the response is valid
-    cJSON *status = cJSON_GetObjectItem(json_response, "s");
-    if (status == NULL || strcmp(cJSON_GetStringValue(status), "ok") != 0) {
-        return ERROR_PARSING_API_RESPONSE;
-    }
-    
-    // Get the price data arrays
-    cJSON *close_prices = cJSON_GetObjectItem(json_response, "c");
-    cJSON *timestamps = cJSON_GetObjectItem(json_response, "t");
-    
-    if (close_prices == NULL || timestamps == NULL || 
-        !cJSON_IsArray(close_prices) || !cJSON_IsArray(timestamps)) {
-        return ERROR_PARSING_API_RESPONSE;
-    }
-    
-    // Get the count (minimum of array sizes and max_days)
-    int count = cJSON_GetArraySize(close_prices);
-    int timestamp_count = cJSON_GetArraySize(timestamps);
-    
-    if (count != timestamp_count) {
-        return ERROR_PARSING_API_RESPONSE;
-    }
-    
-    if (count > max_days) {
-        count = max_days;
+static int history_from_store_alphavantage(const char *ticker, const char *json_data, int max_days,
+                                           double **prices, char ***dates) {
+    if (store_bars_alphavantage(ticker, json_data) == 0) {
+        TimeSeriesView view;
+        char *store_path = get_cache_path(ticker, "bars");
+        if (store_path != NULL && ts_store_open(store_path, &view) == 0) {
+            int count = prices_from_store(&view, max_days, prices, dates);
+            ts_store_close(&view);
+            free(store_path);
+            return count;
+        }
+        free(store_path);
     }
     
-    if (count == 0) {
+    // The store is unavailable: read the response on its own
+    TSBar *bars = NULL;
+    int bar_count = parse_bars_alphavantage(json_data, &bars);
+    if (bar_count <= 0) {
+        free(bars);
         return ERROR_PARSING_API_RESPONSE;
     }
     
-    // Allocate memory for prices and dates
-    *prices = (double*)malloc(count * sizeof(double));
-    *dates = (char**)malloc(count * sizeof(char*));
-    
-    if (*prices == NULL || *dates == NULL) {
-        if (*prices) free(*prices);
-        if (*dates) free(*dates);
-        *prices = NULL;
-        *dates = NULL;
+    int count = bar_count < max_days ? bar_count : max_days;
+    if (alloc_price_history(count, prices, dates) != 0) {
+        free(bars);
         return ERROR_MEMORY_ALLOCATION;
     }
     
-    // Extract data
     for (int i = 0; i < count; i++) {
-        cJSON *price = cJSON_GetArrayItem(close_prices, i);
-        cJSON *timestamp = cJSON_GetArrayItem(timestamps, i);
-        
-        if (price && cJSON_IsNumber(price) && 
-            timestamp && cJSON_IsNumber(timestamp)) {
-            
-            (*prices)[i] = price->valuedouble;
-            
-            // Convert timestamp to date string
-            time_t time_val = (time_t)timestamp->valueint;
-            struct tm *tm_info = localtime(&time_val);
-            char date_str[20];
-            strftime(date_str, sizeof(date_str), "%Y-%m-%d", tm_info);
-            
-            (*dates)[i] = strdup(date_str);
-        } else {
-            // Handle missing data
-            (*prices)[i] = 0.0;
-            (*dates)[i] = strdup("unknown");
+        const TSBar *bar = &bars[bar_count - 1 - i];
+        (*prices)[i] = bar->close;
+        (*dates)[i] = malloc(11);
+        if ((*dates)[i] == NULL) {
+            free_price_history(i, prices, dates);
+            free(bars);
+            return ERROR_MEMORY_ALLOCATION;
         }
+        ts_format_date(bar->date, (*dates)[i]);
     }
     
+    free(bars);
     return count;
 }
 
 /**
- * Extract historical prices from Polygon response
+ * Extract historical prices from a Finnhub candle response,
+ * in the order of the response
  */
-static int extract_polygon_prices(cJSON *json_response, int max_days, 
+static int extract_finnhub_prices(const char *json_data, int max_days, 
                                  double **prices, char ***dates) {
-    if (json_response == NULL || prices == NULL || dates == NULL) {
-        return ERROR_INVALID_PARAMETER;
-    }
+    json_error_t error;
+    json_t *root = json_loads(json_data, 0, &error);
     
-    // Check if the response is valid
-    cJSON *status = cJSON_GetObjectItem(json_response, "status");
-    if (status == NULL || strcmp(cJSON_GetStringValue(status), "OK") != 0) {
+    if (!root || !json_is_object(root)) {
+        json_decref(root);
         return ERROR_PARSING_API_RESPONSE;
     }
     
-    // Get the results array
-    cJSON *results = cJSON_GetObjectItem(json_response, "results");
-    if (results == NULL || !cJSON_IsArray(results)) {
+    // Check if the response is valid
+    json_t *status = json_object_get(root, "s");
+    json_t *close_prices = json_object_get(root, "c");
+    json_t *timestamps = json_object_get(root, "t");
+    
+    if (!json_is_string(status) || strcmp(json_string_value(status), "ok") != 0 ||
+        !json_is_array(close_prices) || !json_is_array(timestamps) ||
+        json_array_size(close_prices) != json_array_size(timestamps) ||
+        json_array_size(close_prices) == 0) {
+        json_decref(root);
         return ERROR_PARSING_API_RESPONSE;
     }
     
     // Get the count (minimum of array size and max_days)
-    int count = cJSON_GetArraySize(results);
+    int count = (int)json_array_size(close_prices);
     if (count > max_days) {
         count = max_days;
     }
     
-    if (count == 0) {
-        return ERROR_PARSING_API_RESPONSE;
-    }
-    
-    // Allocate memory for prices and dates
-    *prices = (double*)malloc(count * sizeof(double));
-    *dates = (char**)malloc(count * sizeof(char*));
-    
-    if (*prices == NULL || *dates == NULL) {
-        if (*prices) free(*prices);
-        if (*dates) free(*dates);
-        *prices = NULL;
-        *dates = NULL;
+    if (alloc_price_history(count, prices, dates) != 0) {
+        json_decref(root);
         return ERROR_MEMORY_ALLOCATION;
     }
     
-    // Extract data
     for (int i = 0; i < count; i++) {
-        cJSON *day_data = cJSON_GetArrayItem(results, i);
-        if (day_data && cJSON_IsObject(day_data)) {
-            cJSON *close = cJSON_GetObjectItem(day_data, "c");
-            cJSON *timestamp = cJSON_GetObjectItem(day_data, "t");
-            
-            if (close && cJSON_IsNumber(close) && 
-                timestamp && cJSON_IsNumber(timestamp)) {
-                
-                (*prices)[i] = close->valuedouble;
-                
-                // Convert timestamp to date string (Polygon timestamps are in milliseconds)
-                time_t time_val = (time_t)(timestamp->valuedouble / 1000);
-                struct tm *tm_info = localtime(&time_val);
-                char date_str[20];
-                strftime(date_str, sizeof(date_str), "%Y-%m-%d", tm_info);
-                
-                (*dates)[i] = strdup(date_str);
-            } else {
-                // Handle missing data
-                (*prices)[i] = 0.0;
-                (*dates)[i] = strdup("unknown");
-            }
-        }
-    }
-    
-    return count;
-}
-
-/**
- * Get the directory path for the cache
- */
-static char* get_cache_dir(void) {
-    static char cache_dir[MAX_CACHE_PATH] = {0};
-    
-    // Only compute the cache directory once
-    if (cache_dir[0] == '\0') {
-        const char* home = getenv("HOME");
-        if (home == NULL) {
-            return NULL; // HOME environment variable not set
-        }
-        
-        snprintf(cache_dir, sizeof(cache_dir), "%s/.cache/option_tools", home);
+        json_t *price = json_array_get(close_prices, i);
+        json_t *timestamp = json_array_get(timestamps, i);
         
-        // Create the directory if it doesn't exist
-        struct stat st = {0};
-        if (stat(cache_dir, &st) == -1) {
-            // Create the parent directory first
-            char parent_dir[MAX_CACHE_PATH];
-            snprintf(parent_dir, sizeof(parent_dir), "%s/.cache", home);
-            if (stat(parent_dir, &st) == -1) {
-                mkdir(parent_dir, 0755);
-            }
-            
-            // Create the cache directory
-            mkdir(cache_dir, 0755);
+        // Missing points are kept with a zero price
+        int set = (json_is_number(price) && json_is_number(timestamp))
+                      ? set_price_point(prices, dates, i, json_number_value(price), json_number_value(timestamp))
+                      : set_missing_point(prices, dates, i);
+        if (set != 0) {
+            free_price_history(i, prices, dates);
+            json_decref(root);
+            return ERROR_MEMORY_ALLOCATION;
         }
     }
     
-    return cache_dir;
-}
-
-/**
- * Get the cache file path for a specific ticker and data type
- */
-static char* get_cache_path(const char* ticker, const char* data_type, DataSource source) {
-    static char cache_path[MAX_CACHE_PATH];
-    char* cache_dir = get_cache_dir();
-    
-    if (cache_dir == NULL) {
-        return NULL;
-    }
-    
-    snprintf(cache_path, sizeof(cache_path), "%s/%s_%s_%d.cache",
-             cache_dir, ticker, data_type, source);
-    
-    return cache_path;
-}
-
-/**
- * Check if the cached data is expired
- */
-static int is_cache_expired(CachedData* cached_data) {
-    if (cached_data == NULL) {
-        return 1; // No cached data, consider it expired
-    }
-    
-    // If cache timeout is 0, caching is disabled
-    if (cache_expiry_seconds == 0) {
-        return 1;
-    }
-    
-    time_t now = time(NULL);
-    return (now - cached_data->timestamp) > cache_expiry_seconds;
+    json_decref(root);
+    return count;
 }
 
 /**
- * Get data from cache for a specific cache key
+ * Extract historical prices from a Polygon aggregates response,
+ * in the order of the response
  */
-static CachedData* get_from_cache(const char* cache_key) {
-    char* cache_path = get_cache_path(cache_key, "data", DATA_SOURCE_DEFAULT);
-    if (cache_path == NULL) {
-        return NULL;
-    }
+static int extract_polygon_prices(const char *json_data, int max_days, 
+                                 double **prices, char ***dates) {
+    json_error_t error;
+    json_t *root = json_loads(json_data, 0, &error);
     
-    // Check if cache file exists and is valid
-    if (!is_cache_valid(cache_path)) {
-        return NULL;
+    if (!root || !json_is_object(root)) {
+        json_decref(root);
+        return ERROR_PARSING_API_RESPONSE;
     }
     
-    // Load data from cache file
-    char* data = load_from_cache(cache_path);
-    if (data == NULL) {
-        return NULL;
-    }
+    // Check if the response is valid
+    json_t *status = json_object_get(root, "status");
+    json_t *results = json_object_get(root, "results");
     
-    // Get file modification time as timestamp
-    struct stat attr;
-    if (stat(cache_path, &attr) != 0) {
-        free(data);
-        return NULL;
+    if (!json_is_string(status) || strcmp(json_string_value(status), "OK") != 0 ||
+        !json_is_array(results) || json_array_size(results) == 0) {
+        json_decref(root);
+        return ERROR_PARSING_API_RESPONSE;
     }
     
-    // Create the cached data structure
-    CachedData* cached_data = (CachedData*)malloc(sizeof(CachedData));
-    if (cached_data == NULL) {
-        free(data);
-        return NULL;
+    // Get the count (minimum of array size and max_days)
+    int count = (int)json_array_size(results);
+    if (count > max_days) {
+        count = max_days;
     }
     
-    cached_data->data = data;
-    cached_data->timestamp = attr.st_mtime;
-    
-    return cached_data;
-}
-
-/**
- * Add data to cache for a specific cache key
- */
-static int add_to_cache(const char* cache_key, const char* data) {
-    // If cache timeout is 0, caching is disabled
-    if (cache_expiry_seconds == 0) {
-        return 0;
+    if (alloc_price_history(count, prices, dates) != 0) {
+        json_decref(root);
+        return ERROR_MEMORY_ALLOCATION;
     }
     
-    char* cache_path = get_cache_path(cache_key, "data", DATA_SOURCE_DEFAULT);
-    if (cache_path == NULL) {
-        return -1;
+    for (int i = 0; i < count; i++) {
+        json_t *day_data = json_array_get(results, i);
+        json_t *close = json_object_get(day_data, "c");
+        json_t *timestamp = json_object_get(day_data, "t");
+        
+        // Polygon timestamps are in milliseconds; missing points are kept with a zero price
+        int set = (json_is_number(close) && json_is_number(timestamp))
+                      ? set_price_point(prices, dates, i, json_number_value(close), json_number_value(timestamp) / 1000.0)
+                      : set_missing_point(prices, dates, i);
+        if (set != 0) {
+            free_price_history(i, prices, dates);
+            json_decref(root);
+            return ERROR_MEMORY_ALLOCATION;
+        }
     }
     
-    return save_to_cache(cache_path, data);
+    json_decref(root);
+    return count;
 }
 
 /**
  * Check if an API key is set for a specific data source
  */
 static int is_api_key_set(DataSource source) {
-    if (source < 0 || source >= 4) {
-        return 0; // Invalid source
-    }
-    
     return (source == DATA_SOURCE_ALPHAVANTAGE && alphavantage_api_key != NULL) ||
            (source == DATA_SOURCE_FINNHUB && finnhub_api_key != NULL) ||
            (source == DATA_SOURCE_POLYGON && polygon_api_key != NULL);
 }
-
-/**
- * Set an error code if the error_code pointer is not NULL
- */
-static void set_error(int* error_code_ptr, int error_code) {
-    if (error_code_ptr != NULL) {
-        *error_code_ptr = error_code;
-    }
-} 
\ No newline at end of file
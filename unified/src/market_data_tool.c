@@ -17,6 +17,8 @@ void print_usage(const char* program_name) {
     printf("  dividend TICKER [SOURCE]         Get dividend yield for a ticker\n");
     printf("  volatility TICKER DAYS [SOURCE]  Get historical volatility for a ticker\n");
     printf("  rate TERM                        Get risk-free rate for a term\n");
+    printf("  snapshot DAYS TERM TICKER...     Get the rate, then price, dividend yield and\n");
+    printf("                                   volatility per ticker, fetched concurrently\n");
     printf("\n");
     printf("Parameters:\n");
     printf("  TICKER   Ticker symbol (e.g., AAPL, MSFT, SPX)\n");
@@ -143,6 +145,68 @@ int main(int argc, char** argv) {
         
         printf("%.6f\n", rate);
     }
+    else if (strcmp(operation, "snapshot") == 0) {
+        // Check arguments for snapshot operation
+        if (argc < 5) {
+            fprintf(stderr, "Error: Missing days, term or ticker parameter\n");
+            print_usage(argv[0]);
+            market_data_cleanup();
+            return 1;
+        }
+        
+        int days = atoi(argv[2]);
+        RateTerm term = (RateTerm)atoi(argv[3]);
+        int tickers = argc - 4;
+        int count = 1 + 3 * tickers;
+        
+        MarketDataRequest* requests = calloc(count, sizeof(MarketDataRequest));
+        if (requests == NULL) {
+            fprintf(stderr, "Error: Out of memory\n");
+            market_data_cleanup();
+            return 1;
+        }
+        
+        // One rate, then price, dividend and volatility for each ticker
+        requests[0].field = MARKET_DATA_RISK_FREE_RATE;
+        requests[0].term = term;
+        for (int i = 0; i < tickers; i++) {
+            MarketDataRequest* entry = &requests[1 + 3 * i];
+            entry[0].field = MARKET_DATA_PRICE;
+            entry[1].field = MARKET_DATA_DIVIDEND_YIELD;
+            entry[2].field = MARKET_DATA_HISTORICAL_VOLATILITY;
+            for (int j = 0; j < 3; j++) {
+                entry[j].ticker = argv[4 + i];
+                entry[j].source = DATA_SOURCE_DEFAULT;
+                entry[j].days = days;
+            }
+        }
+        
+        int failed = get_market_data_batch(requests, count);
+        
+        for (int i = 0; i < count; i++) {
+            if (requests[i].error_code != 0) {
+                fprintf(stderr, "Error %d retrieving %s for %s\n", requests[i].error_code,
+                        i == 0 ? "risk-free rate" :
+                        requests[i].field == MARKET_DATA_PRICE ? "price" :
+                        requests[i].field == MARKET_DATA_DIVIDEND_YIELD ? "dividend yield" :
+                        "historical volatility",
+                        i == 0 ? "the term" : requests[i].ticker);
+            }
+        }
+        
+        printf("%.6f\n", requests[0].value);
+        for (int i = 0; i < tickers; i++) {
+            const MarketDataRequest* entry = &requests[1 + 3 * i];
+            printf("%s %.6f %.6f %.6f\n", entry[0].ticker,
+                   entry[0].value, entry[1].value, entry[2].value);
+        }
+        
+        free(requests);
+        if (failed != 0) {
+            market_data_cleanup();
+            return 1;
+        }
+    }
     else {
         fprintf(stderr, "Error: Unknown operation '%s'\n", operation);
         print_usage(argv[0]);
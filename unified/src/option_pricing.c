@@ -22,6 +22,9 @@ static int validate_inputs(
     ModelType model_type,
     NumericalMethod method
 ) {
+    /* Any rate is accepted, negative ones included */
+    (void)risk_free_rate;
+    
     /* Check for non-negative values where required */
     if (spot_price <= 0) {
         set_error(ERROR_INVALID_PARAMETER);
@@ -49,7 +52,8 @@ static int validate_inputs(
         return 0;
     }
     
-    if (method != METHOD_ANALYTIC && method != METHOD_QUADRATURE && method != METHOD_FFT) {
+    if (method != METHOD_ANALYTIC && method != METHOD_QUADRATURE && method != METHOD_FFT &&
+        method != METHOD_COS && method != METHOD_MONTE_CARLO) {
         set_error(ERROR_INVALID_NUMERICAL_METHOD);
         return 0;
     }
@@ -71,25 +75,18 @@ static int validate_inputs(
 }
 
 /**
- * @brief Price an option using the specified model and method
+ * Reset the result and validate the inputs of a pricing call
  */
-int price_option(
+static int start_pricing(
     double spot_price,
     double strike_price,
     double time_to_expiry,
     double risk_free_rate,
-    double dividend_yield,
-    double volatility,
     OptionType option_type,
     ModelType model_type,
     NumericalMethod method,
-    double market_price,
-    GreeksFlags greeks_flags,
-    const char* ticker_symbol,
     PricingResult* result
 ) {
-    int ret;
-    
     /* Initialize result structure */
     if (result == NULL) {
         set_error(ERROR_INVALID_PARAMETER);
@@ -112,24 +109,28 @@ int price_option(
         return result->error_code;
     }
     
-    /* If ticker symbol is provided, fetch market data */
-    if (ticker_symbol != NULL && *ticker_symbol) {
-        double fetched_spot = 0.0;
-        double fetched_div = 0.0;
-        
-        /* Try to get market data */
-        if (get_market_data(ticker_symbol, &fetched_spot, &fetched_div) == ERROR_NONE) {
-            /* Only use fetched data if it's valid */
-            if (fetched_spot > 0) {
-                spot_price = fetched_spot;
-            }
-            
-            /* Only override if dividend_yield was not explicitly provided */
-            if (dividend_yield == 0) {
-                dividend_yield = fetched_div;
-            }
-        }
-    }
+    return ERROR_NONE;
+}
+
+/**
+ * Price validated inputs, with the Heston FFT work in ctx (NULL for the default context)
+ */
+static int dispatch_pricing(
+    HestonFFTContext* ctx,
+    double spot_price,
+    double strike_price,
+    double time_to_expiry,
+    double risk_free_rate,
+    double dividend_yield,
+    double volatility,
+    OptionType option_type,
+    ModelType model_type,
+    NumericalMethod method,
+    double market_price,
+    GreeksFlags greeks_flags,
+    PricingResult* result
+) {
+    int ret;
     
     /* Dispatch to the appropriate model-specific function */
     switch (model_type) {
@@ -171,6 +172,7 @@ int price_option(
         case MODEL_HESTON:
             /* For Heston, use the Heston adapter */
             ret = price_with_heston(
+                ctx,
                 spot_price, strike_price, time_to_expiry,
                 risk_free_rate, dividend_yield, volatility,
                 option_type, method, market_price, result
@@ -183,6 +185,7 @@ int price_option(
                 
                 PricingResult greeks_result;
                 ret = calculate_heston_greeks(
+                    ctx,
                     spot_price, strike_price, time_to_expiry,
                     risk_free_rate, dividend_yield, 
                     result->implied_volatility > 0 ? result->implied_volatility : volatility,
@@ -212,6 +215,85 @@ int price_option(
     return ret;
 }
 
+/**
+ * @brief Price an option using the specified model and method
+ */
+int price_option(
+    double spot_price,
+    double strike_price,
+    double time_to_expiry,
+    double risk_free_rate,
+    double dividend_yield,
+    double volatility,
+    OptionType option_type,
+    ModelType model_type,
+    NumericalMethod method,
+    double market_price,
+    GreeksFlags greeks_flags,
+    const char* ticker_symbol,
+    PricingResult* result
+) {
+    int ret = start_pricing(spot_price, strike_price, time_to_expiry, risk_free_rate,
+                            option_type, model_type, method, result);
+    if (ret != ERROR_NONE) {
+        return ret;
+    }
+    
+    /* If ticker symbol is provided, fetch market data */
+    if (ticker_symbol != NULL && *ticker_symbol) {
+        double fetched_spot = 0.0;
+        double fetched_div = 0.0;
+        
+        /* Try to get market data */
+        if (get_market_data(ticker_symbol, &fetched_spot, &fetched_div) == ERROR_NONE) {
+            /* Only use fetched data if it's valid */
+            if (fetched_spot > 0) {
+                spot_price = fetched_spot;
+            }
+            
+            /* Only override if dividend_yield was not explicitly provided */
+            if (dividend_yield == 0) {
+                dividend_yield = fetched_div;
+            }
+        }
+    }
+    
+    return dispatch_pricing(NULL, spot_price, strike_price, time_to_expiry,
+                            risk_free_rate, dividend_yield, volatility,
+                            option_type, model_type, method,
+                            market_price, greeks_flags, result);
+}
+
+/**
+ * @brief Price an option with the Heston FFT work in a caller-owned context
+ */
+int price_option_in_context(
+    HestonFFTContext* ctx,
+    double spot_price,
+    double strike_price,
+    double time_to_expiry,
+    double risk_free_rate,
+    double dividend_yield,
+    double volatility,
+    OptionType option_type,
+    ModelType model_type,
+    NumericalMethod method,
+    double market_price,
+    GreeksFlags greeks_flags,
+    PricingResult* result
+) {
+    int ret = start_pricing(spot_price, strike_price, time_to_expiry, risk_free_rate,
+                            option_type, model_type, method, result);
+    if (ret != ERROR_NONE) {
+        return ret;
+    }
+    
+    return dispatch_pricing(ctx, spot_price, strike_price, time_to_expiry,
+                            risk_free_rate, dividend_yield, volatility,
+                            option_type, model_type, method,
+                            market_price, greeks_flags, result);
+}
+
 /**
  * @brief Calculate implied volatility for an option
  */
@@ -303,25 +385,49 @@ int get_market_data(
         return ERROR_INVALID_PARAMETER;
     }
     
-    /* Get spot price if requested */
+    /* Fetch the spot price and dividend yield concurrently */
+    MarketDataRequest requests[2];
+    int count = 0;
+    int price_entry = -1;
+    int yield_entry = -1;
+    
+    memset(requests, 0, sizeof(requests));
     if (spot_price) {
-        double price = get_current_price(ticker_symbol, DATA_SOURCE_DEFAULT, &error_code);
-        if (error_code == ERROR_SUCCESS && price > 0) {
-            *spot_price = price;
+        requests[count].field = MARKET_DATA_PRICE;
+        requests[count].ticker = ticker_symbol;
+        requests[count].source = DATA_SOURCE_DEFAULT;
+        price_entry = count++;
+    }
+    if (dividend_yield) {
+        requests[count].field = MARKET_DATA_DIVIDEND_YIELD;
+        requests[count].ticker = ticker_symbol;
+        requests[count].source = DATA_SOURCE_DEFAULT;
+        yield_entry = count++;
+    }
+    if (count > 0 && get_market_data_batch(requests, count) < 0) {
+        error_code = requests[0].error_code;
+        set_error(error_code);
+        return error_code;
+    }
+    
+    /* A spot price must be available when one was requested */
+    if (price_entry >= 0) {
+        error_code = requests[price_entry].error_code;
+        if (error_code == ERROR_SUCCESS && requests[price_entry].value > 0) {
+            *spot_price = requests[price_entry].value;
         } else if (error_code != ERROR_SUCCESS) {
             set_error(error_code);
             return error_code;
         }
     }
     
-    /* Get dividend yield if requested */
-    if (dividend_yield) {
-        double yield = get_dividend_yield(ticker_symbol, DATA_SOURCE_DEFAULT, &error_code);
-        if (error_code == ERROR_SUCCESS && yield >= 0) {
-            *dividend_yield = yield;
+    if (yield_entry >= 0) {
+        error_code = requests[yield_entry].error_code;
+        if (error_code == ERROR_SUCCESS && requests[yield_entry].value >= 0) {
+            *dividend_yield = requests[yield_entry].value;
         } else if (error_code != ERROR_SUCCESS) {
             /* Only return an error if we don't already have a spot price */
-            if (*spot_price <= 0) {
+            if (spot_price == NULL || *spot_price <= 0) {
                 set_error(error_code);
                 return error_code;
             }
@@ -337,26 +443,3 @@ int get_market_data(
     set_error(ERROR_DATA_SOURCE_UNAVAILABLE);
     return ERROR_DATA_SOURCE_UNAVAILABLE;
 }
-
-/* 
- * Temporary stub implementation for Heston model 
- * This will be replaced with an adapter to the legacy Heston implementation
- */
-static int price_with_heston(
-    double spot_price,
-    double strike_price,
-    double time_to_expiry,
-    double risk_free_rate,
-    double dividend_yield,
-    double volatility,
-    OptionType option_type,
-    NumericalMethod method,
-    double market_price,
-    GreeksFlags greeks_flags,
-    PricingResult* result
-) {
-    /* This is a placeholder that will be replaced with actual implementation */
-    result->error_code = ERROR_CALCULATION_FAILED;
-    set_error(ERROR_CALCULATION_FAILED);
-    return ERROR_CALCULATION_FAILED;
-} 
\ No newline at end of file
@@ -1,3 +1,6 @@
+/* realpath() is an XSI extension */
+#define _XOPEN_SOURCE 700
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
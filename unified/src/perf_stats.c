@@ -0,0 +1,171 @@
+/**
+ * perf_stats.c
+ * Process-wide event counters and timers of the pricing engines
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <time.h>
+
+#include "../include/perf_stats.h"
+
+static const char* const counter_names[PERF_COUNTER_COUNT] = {
+    "grid_cache_hits",
+    "grid_cache_misses",
+    "precompute_reuses",
+    "precompute_builds",
+    "calibration_evaluations",
+    "calibration_sweeps",
+    "calibration_early_stops",
+    "alternate_fft_params",
+    "bs_fallbacks",
+    "market_cache_hits",
+    "market_network_requests",
+    "market_network_failures",
+    "market_rate_limited",
+    "market_coalesced",
+    "market_stale_hits",
+    "workspace_allocations",
+    "screen_grids",
+    "screen_rejections",
+    "tuning_hits",
+    "shared_grid_hits",
+    "gpu_grids",
+    "gpu_check_failures"
+};
+
+static const char* const timer_names[PERF_TIMER_COUNT] = {
+    "grid_build",
+    "calibration_sweep",
+    "market_fetch",
+    "mc_simulation",
+    "gpu_batch"
+};
+
+// All updates are relaxed atomics; nothing orders them against other memory
+static uint64_t g_counters[PERF_COUNTER_COUNT];
+static PerfTiming g_timers[PERF_TIMER_COUNT];
+static PerfTiming g_fft[PERF_FFT_SIZE_SLOTS];
+static uint64_t g_epoch_ns;
+
+uint64_t perf_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void record(PerfTiming* timing, uint64_t ns) {
+    __atomic_fetch_add(&timing->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&timing->total_ns, ns, __ATOMIC_RELAXED);
+
+    uint64_t max = __atomic_load_n(&timing->max_ns, __ATOMIC_RELAXED);
+    while (ns > max && !__atomic_compare_exchange_n(&timing->max_ns, &max, ns, 1,
+                                                    __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+static void load(PerfTiming* dst, PerfTiming* src) {
+    dst->count = __atomic_load_n(&src->count, __ATOMIC_RELAXED);
+    dst->total_ns = __atomic_load_n(&src->total_ns, __ATOMIC_RELAXED);
+    dst->max_ns = __atomic_load_n(&src->max_ns, __ATOMIC_RELAXED);
+}
+
+static void clear(PerfTiming* timing) {
+    __atomic_store_n(&timing->count, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&timing->total_ns, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&timing->max_ns, 0, __ATOMIC_RELAXED);
+}
+
+void perf_stats_add(PerfCounter counter, uint64_t amount) {
+    if ((unsigned)counter < PERF_COUNTER_COUNT) {
+        __atomic_fetch_add(&g_counters[counter], amount, __ATOMIC_RELAXED);
+    }
+}
+
+void perf_stats_time(PerfTimer timer, uint64_t ns) {
+    if ((unsigned)timer < PERF_TIMER_COUNT) {
+        record(&g_timers[timer], ns);
+    }
+}
+
+void perf_stats_fft(int n, uint64_t ns) {
+    int slot = 1;
+    while (slot < PERF_FFT_SIZE_SLOTS - 1 && (1 << slot) < n) {
+        slot++;
+    }
+    record(&g_fft[slot], ns);
+}
+
+void perf_stats_snapshot(PerfStats* stats) {
+    if (stats == NULL) {
+        return;
+    }
+
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        stats->counters[i] = __atomic_load_n(&g_counters[i], __ATOMIC_RELAXED);
+    }
+    for (int i = 0; i < PERF_TIMER_COUNT; i++) {
+        load(&stats->timers[i], &g_timers[i]);
+    }
+    for (int i = 0; i < PERF_FFT_SIZE_SLOTS; i++) {
+        load(&stats->fft[i], &g_fft[i]);
+    }
+
+    uint64_t epoch = __atomic_load_n(&g_epoch_ns, __ATOMIC_RELAXED);
+    stats->uptime_seconds = epoch > 0 ? (perf_now_ns() - epoch) * 1e-9 : 0.0;
+}
+
+void perf_stats_reset(void) {
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        __atomic_store_n(&g_counters[i], 0, __ATOMIC_RELAXED);
+    }
+    for (int i = 0; i < PERF_TIMER_COUNT; i++) {
+        clear(&g_timers[i]);
+    }
+    for (int i = 0; i < PERF_FFT_SIZE_SLOTS; i++) {
+        clear(&g_fft[i]);
+    }
+    __atomic_store_n(&g_epoch_ns, perf_now_ns(), __ATOMIC_RELAXED);
+}
+
+const char* perf_counter_name(PerfCounter counter) {
+    return (unsigned)counter < PERF_COUNTER_COUNT ? counter_names[counter] : "unknown";
+}
+
+const char* perf_timer_name(PerfTimer timer) {
+    return (unsigned)timer < PERF_TIMER_COUNT ? timer_names[timer] : "unknown";
+}
+
+static void write_timing(FILE* out, const PerfTiming* timing) {
+    double mean_us = timing->count > 0 ? timing->total_ns * 1e-3 / timing->count : 0.0;
+    fprintf(out, "{\"count\": %llu, \"total_ms\": %.3f, \"mean_us\": %.3f, \"max_us\": %.3f}",
+            (unsigned long long)timing->count, timing->total_ns * 1e-6, mean_us, timing->max_ns * 1e-3);
+}
+
+int perf_stats_write_json(FILE* out, const PerfStats* stats) {
+    fprintf(out, "{\"uptime_s\": %.3f, \"counters\": {", stats->uptime_seconds);
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        fprintf(out, "%s\"%s\": %llu", i > 0 ? ", " : "", counter_names[i],
+                (unsigned long long)stats->counters[i]);
+    }
+
+    fprintf(out, "}, \"timers\": {");
+    for (int i = 0; i < PERF_TIMER_COUNT; i++) {
+        fprintf(out, "%s\"%s\": ", i > 0 ? ", " : "", timer_names[i]);
+        write_timing(out, &stats->timers[i]);
+    }
+
+    fprintf(out, "}, \"fft_executions\": {");
+    int written = 0;
+    for (int i = 0; i < PERF_FFT_SIZE_SLOTS; i++) {
+        if (stats->fft[i].count == 0) {
+            continue;
+        }
+        fprintf(out, "%s\"%lu\": ", written++ > 0 ? ", " : "", 1ul << i);
+        write_timing(out, &stats->fft[i]);
+    }
+    fprintf(out, "}}\n");
+
+    return ferror(out) ? -1 : 0;
+}
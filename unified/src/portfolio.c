@@ -0,0 +1,668 @@
+/**
+ * portfolio.c
+ * Revaluation of a book of option positions: one market data batch, one FFT
+ * grid per (ticker, expiry) and a work-stealing pool of pricing threads
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+/* Before market_data.h, which redefines ERROR_SUCCESS as a macro */
+#include "../include/error_handling.h"
+#include "../include/portfolio.h"
+#include "../include/heston_fft.h"
+#include "../include/fft_cache.h"
+
+#define DAYS_PER_YEAR 365.0
+
+/* Market data entries of one position */
+typedef struct {
+    int price;
+    int dividend;
+    int volatility;
+    int rate;      /* -1 with a fixed rate */
+} PositionData;
+
+/* Positions sharing (ticker, expiry), as a run of sorted positions */
+typedef struct {
+    int start;
+    int count;
+} PositionGroup;
+
+/* Groups of one worker: it takes from the head, thieves from the tail */
+typedef struct {
+    int* groups;
+    int head;
+    int tail;
+    pthread_mutex_t lock;
+} GroupQueue;
+
+/* Shared state of the pricing workers */
+typedef struct {
+    PortfolioPosition** sorted;
+    const PositionGroup* groups;
+    GroupQueue* queues;
+    int num_queues;
+    int longest;               /* Positions in the largest group */
+    HestonFFTConfig config;    /* Settings each group starts from, with a share of the cache */
+} PortfolioWork;
+
+typedef struct {
+    PortfolioWork* work;
+    int id;
+} PortfolioWorker;
+
+void portfolio_default_options(PortfolioOptions* options) {
+    memset(options, 0, sizeof(*options));
+    options->source = DATA_SOURCE_DEFAULT;
+    options->threads = 0;
+    options->rate = -1.0;
+}
+
+/* Split a line at commas into at most max_fields trimmed fields */
+static int split_fields(char* line, char** fields, int max_fields) {
+    int count = 0;
+    char* p = line;
+
+    while (count < max_fields) {
+        while (isspace((unsigned char)*p)) p++;
+        fields[count++] = p;
+
+        char* end = strchr(p, ',');
+        char* next = (end != NULL) ? end + 1 : NULL;
+        if (end == NULL) {
+            end = p + strlen(p);
+        }
+        while (end > p && isspace((unsigned char)end[-1])) end--;
+        *end = '\0';
+
+        if (next == NULL) {
+            break;
+        }
+        p = next;
+    }
+    return count;
+}
+
+static int parse_number(const char* str, double* value) {
+    char* endptr;
+    double v = strtod(str, &endptr);
+    if (endptr == str || *endptr != '\0' || !isfinite(v)) {
+        return 0;
+    }
+    *value = v;
+    return 1;
+}
+
+static int parse_option_type(const char* str, OptionType* type) {
+    if (strcasecmp(str, "call") == 0 || strcasecmp(str, "c") == 0 || strcmp(str, "0") == 0) {
+        *type = OPTION_CALL;
+    } else if (strcasecmp(str, "put") == 0 || strcasecmp(str, "p") == 0 || strcmp(str, "1") == 0) {
+        *type = OPTION_PUT;
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+/* Years to expiry from a YYYY-MM-DD date or a number of years */
+static int parse_expiry(const char* str, time_t now, double* years) {
+    int year, month, day;
+    char tail;
+
+    if (sscanf(str, "%4d-%2d-%2d%c", &year, &month, &day, &tail) == 3) {
+        struct tm date;
+        memset(&date, 0, sizeof(date));
+        date.tm_year = year - 1900;
+        date.tm_mon = month - 1;
+        date.tm_mday = day;
+        date.tm_hour = 12;
+        date.tm_isdst = -1;
+
+        struct tm today = *localtime(&now);
+        today.tm_hour = 12;
+        today.tm_min = 0;
+        today.tm_sec = 0;
+        today.tm_isdst = -1;
+
+        time_t expiry_time = mktime(&date);
+        if (month < 1 || month > 12 || day < 1 || day > 31 || expiry_time == (time_t)-1) {
+            return 0;
+        }
+        *years = floor(difftime(expiry_time, mktime(&today)) / 86400.0 + 0.5) / DAYS_PER_YEAR;
+        return 1;
+    }
+    return parse_number(str, years);
+}
+
+int portfolio_read_positions(FILE* in, PortfolioPosition** positions) {
+    char line[1024];
+    int line_no = 0;
+    int count = 0;
+    int capacity = 0;
+    const time_t now = time(NULL);
+
+    *positions = NULL;
+    while (fgets(line, sizeof(line), in) != NULL) {
+        line_no++;
+
+        const char* p = line;
+        while (isspace((unsigned char)*p)) p++;
+        if (*p == '\0' || *p == '#') {
+            continue;
+        }
+
+        char* fields[5];
+        PortfolioPosition position;
+        memset(&position, 0, sizeof(position));
+        if (split_fields(line, fields, 5) != 5 || !parse_number(fields[2], &position.strike)) {
+            /* The header row is expected; anything else is worth a warning */
+            if (line_no > 1 || strncasecmp(p, "ticker", 6) != 0) {
+                fprintf(stderr, "Warning: Skipping malformed position row %d\n", line_no);
+            }
+            continue;
+        }
+
+        size_t ticker_len = strlen(fields[0]);
+        if (ticker_len == 0 || ticker_len > PORTFOLIO_MAX_TICKER ||
+            !parse_option_type(fields[1], &position.option_type) ||
+            !parse_expiry(fields[3], now, &position.expiry) ||
+            !parse_number(fields[4], &position.quantity) || position.strike <= 0.0) {
+            fprintf(stderr, "Warning: Skipping malformed position row %d\n", line_no);
+            continue;
+        }
+        if (position.expiry <= 0.0) {
+            fprintf(stderr, "Warning: Skipping expired position in row %d\n", line_no);
+            continue;
+        }
+        memcpy(position.ticker, fields[0], ticker_len + 1);
+
+        if (count == capacity) {
+            capacity = capacity > 0 ? capacity * 2 : 256;
+            PortfolioPosition* grown = realloc(*positions, (size_t)capacity * sizeof(PortfolioPosition));
+            if (grown == NULL) {
+                free(*positions);
+                *positions = NULL;
+                return -1;
+            }
+            *positions = grown;
+        }
+        (*positions)[count++] = position;
+    }
+
+    return count;
+}
+
+/* Treasury term closest to an expiry */
+static RateTerm rate_term_for_days(int days) {
+    if (days <= 45) return RATE_TERM_1M;
+    if (days <= 135) return RATE_TERM_3M;
+    if (days <= 270) return RATE_TERM_6M;
+    if (days <= 545) return RATE_TERM_1Y;
+    if (days <= 1095) return RATE_TERM_2Y;
+    if (days <= 2555) return RATE_TERM_5Y;
+    if (days <= 7300) return RATE_TERM_10Y;
+    return RATE_TERM_30Y;
+}
+
+/* Index of a batch entry, added unless an equal one is listed */
+static int add_request(MarketDataRequest* requests, int* count, MarketDataField field,
+                       const char* ticker, DataSource source, int days, RateTerm term) {
+    for (int i = 0; i < *count; i++) {
+        const MarketDataRequest* req = &requests[i];
+        if (req->field == field &&
+            (field == MARKET_DATA_RISK_FREE_RATE ? req->term == term : strcmp(req->ticker, ticker) == 0) &&
+            (field != MARKET_DATA_HISTORICAL_VOLATILITY || req->days == days)) {
+            return i;
+        }
+    }
+
+    MarketDataRequest* req = &requests[(*count)++];
+    memset(req, 0, sizeof(*req));
+    req->field = field;
+    req->ticker = (field == MARKET_DATA_RISK_FREE_RATE) ? NULL : ticker;
+    req->source = source;
+    req->days = days;
+    req->term = term;
+    return *count - 1;
+}
+
+/* Fetch every position's inputs in one batch; failed positions get an error code */
+static int fetch_market_data(PortfolioPosition* positions, int count, const PortfolioOptions* options) {
+    MarketDataRequest* requests = malloc(4 * (size_t)count * sizeof(MarketDataRequest));
+    PositionData* data = malloc((size_t)count * sizeof(PositionData));
+    if (requests == NULL || data == NULL) {
+        free(requests);
+        free(data);
+        return -1;
+    }
+
+    int num_requests = 0;
+    for (int i = 0; i < count; i++) {
+        const PortfolioPosition* position = &positions[i];
+        int days = (int)floor(position->expiry * DAYS_PER_YEAR + 0.5);
+
+        data[i].price = add_request(requests, &num_requests, MARKET_DATA_PRICE,
+                                    position->ticker, options->source, 0, RATE_TERM_1M);
+        data[i].dividend = add_request(requests, &num_requests, MARKET_DATA_DIVIDEND_YIELD,
+                                       position->ticker, options->source, 0, RATE_TERM_1M);
+        data[i].volatility = add_request(requests, &num_requests, MARKET_DATA_HISTORICAL_VOLATILITY,
+                                         position->ticker, options->source,
+                                         get_volatility_period_for_expiry(days), RATE_TERM_1M);
+        data[i].rate = (options->rate >= 0.0)
+            ? -1
+            : add_request(requests, &num_requests, MARKET_DATA_RISK_FREE_RATE,
+                          NULL, DATA_SOURCE_DEFAULT, 0, rate_term_for_days(days));
+    }
+
+    get_market_data_batch(requests, num_requests);
+
+    for (int i = 0; i < count; i++) {
+        PortfolioPosition* position = &positions[i];
+        const MarketDataRequest* price = &requests[data[i].price];
+        const MarketDataRequest* dividend = &requests[data[i].dividend];
+        const MarketDataRequest* volatility = &requests[data[i].volatility];
+        const MarketDataRequest* rate = (data[i].rate >= 0) ? &requests[data[i].rate] : NULL;
+
+        memset(&position->result, 0, sizeof(position->result));
+        position->spot = price->value;
+        /* A missing dividend yield is not fatal, as for single options */
+        position->dividend_yield = (dividend->error_code == ERROR_SUCCESS) ? dividend->value : 0.0;
+        position->volatility = volatility->value;
+        position->rate = (rate != NULL) ? rate->value : options->rate;
+
+        if (price->error_code != ERROR_SUCCESS) {
+            position->result.error_code = price->error_code;
+        } else if (volatility->error_code != ERROR_SUCCESS) {
+            position->result.error_code = volatility->error_code;
+        } else if (rate != NULL && rate->error_code != ERROR_SUCCESS) {
+            position->result.error_code = rate->error_code;
+        } else if (!(position->spot > 0.0) || !(position->volatility > 0.0)) {
+            position->result.error_code = ERROR_DATA_VALIDATION;
+        }
+    }
+
+    free(requests);
+    free(data);
+    return 0;
+}
+
+/* Priced positions first, then by ticker, expiry, type and strike */
+static int compare_positions(const void* a, const void* b) {
+    const PortfolioPosition* x = *(PortfolioPosition* const*)a;
+    const PortfolioPosition* y = *(PortfolioPosition* const*)b;
+
+    if ((x->result.error_code != 0) != (y->result.error_code != 0)) {
+        return x->result.error_code != 0 ? 1 : -1;
+    }
+    int c = strcmp(x->ticker, y->ticker);
+    if (c != 0) return c;
+    if (x->expiry != y->expiry) return x->expiry < y->expiry ? -1 : 1;
+    if (x->option_type != y->option_type) return x->option_type < y->option_type ? -1 : 1;
+    if (x->strike != y->strike) return x->strike < y->strike ? -1 : 1;
+    return (x < y) ? -1 : (x > y);
+}
+
+/* Heaviest group first */
+static int compare_group_sizes(const void* a, const void* b) {
+    const PositionGroup* x = a;
+    const PositionGroup* y = b;
+
+    if (x->count != y->count) return y->count - x->count;
+    return x->start - y->start;
+}
+
+/* Price one group: every call and every put from the same grid */
+static void price_group(HestonFFTContext* ctx, PortfolioPosition** positions, int count,
+                        double* strikes, PricingResult* results) {
+    const PortfolioPosition* first = positions[0];
+
+    /* Same parameters as the unified pricer's Heston path (price_with_heston()) */
+    HestonParams params;
+    params.v0 = first->volatility * first->volatility;
+    params.kappa = HESTON_DEFAULT_KAPPA;
+    params.theta = params.v0;
+    params.sigma = HESTON_DEFAULT_SIGMA;
+    params.rho = HESTON_DEFAULT_RHO;
+
+    for (int start = 0; start < count; ) {
+        int n = 0;
+        while (start + n < count && positions[start + n]->option_type == positions[start]->option_type) {
+            strikes[n] = positions[start + n]->strike;
+            n++;
+        }
+
+        int failed = heston_fft_context_greeks_chain(ctx, first->spot, first->expiry, first->rate,
+                                                     first->dividend_yield, &params, strikes, n,
+                                                     positions[start]->option_type, results);
+        for (int j = 0; j < n; j++) {
+            positions[start + j]->result = results[j];
+            if (failed < 0) {
+                positions[start + j]->result.error_code = ERROR_CALCULATION_FAILED;
+            }
+        }
+        start += n;
+    }
+}
+
+static int take_group(GroupQueue* queue, int steal) {
+    int group = -1;
+
+    pthread_mutex_lock(&queue->lock);
+    if (queue->head < queue->tail) {
+        group = steal ? queue->groups[--queue->tail] : queue->groups[queue->head++];
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return group;
+}
+
+/* Own groups first, then steal from the others; -1 once every queue is empty */
+static int next_group(PortfolioWork* work, int id) {
+    int group = take_group(&work->queues[id], 0);
+
+    for (int k = 1; group < 0 && k < work->num_queues; k++) {
+        group = take_group(&work->queues[(id + k) % work->num_queues], 1);
+    }
+    return group;
+}
+
+static void* pricing_worker(void* arg) {
+    PortfolioWorker* worker = arg;
+    PortfolioWork* work = worker->work;
+
+    HestonFFTContext* ctx = heston_fft_context_create();
+    double* strikes = malloc((size_t)work->longest * sizeof(double));
+    PricingResult* results = malloc((size_t)work->longest * sizeof(PricingResult));
+
+    int g;
+    while ((g = next_group(work, worker->id)) >= 0) {
+        const PositionGroup* group = &work->groups[g];
+        PortfolioPosition** positions = work->sorted + group->start;
+
+        if (ctx == NULL || strikes == NULL || results == NULL) {
+            for (int j = 0; j < group->count; j++) {
+                positions[j]->result.error_code = ERROR_MEMORY_ALLOCATION;
+            }
+            continue;
+        }
+
+        /* Earlier groups may have adapted the grid */
+        heston_fft_context_set_config(ctx, &work->config);
+        price_group(ctx, positions, group->count, strikes, results);
+    }
+
+    free(strikes);
+    free(results);
+    heston_fft_context_destroy(ctx);
+    return NULL;
+}
+
+/* Group the priced positions and run the groups on the worker pool */
+static int price_groups(PortfolioPosition* positions, int count, int threads) {
+    PortfolioPosition** sorted = malloc((size_t)count * sizeof(PortfolioPosition*));
+    PositionGroup* groups = malloc((size_t)count * sizeof(PositionGroup));
+    GroupQueue* queues = NULL;
+    PortfolioWorker* workers = NULL;
+    pthread_t* handles = NULL;
+    int result = -1;
+
+    if (sorted == NULL || groups == NULL) {
+        goto done;
+    }
+
+    for (int i = 0; i < count; i++) {
+        sorted[i] = &positions[i];
+    }
+    qsort(sorted, (size_t)count, sizeof(PortfolioPosition*), compare_positions);
+
+    int num_groups = 0;
+    int longest = 0;
+    for (int i = 0; i < count && sorted[i]->result.error_code == 0; i++) {
+        if (i == 0 || strcmp(sorted[i - 1]->ticker, sorted[i]->ticker) != 0 ||
+            sorted[i - 1]->expiry != sorted[i]->expiry) {
+            groups[num_groups].start = i;
+            groups[num_groups].count = 0;
+            num_groups++;
+        }
+        groups[num_groups - 1].count++;
+        if (groups[num_groups - 1].count > longest) {
+            longest = groups[num_groups - 1].count;
+        }
+    }
+    result = 0;
+    if (num_groups == 0) {
+        goto done;
+    }
+
+    if (threads > num_groups) {
+        threads = num_groups;
+    }
+
+    /* Deal the groups out heaviest first, so every queue starts with a similar load */
+    qsort(groups, (size_t)num_groups, sizeof(PositionGroup), compare_group_sizes);
+
+    const int per_queue = (num_groups + threads - 1) / threads;
+    int* dealt = malloc((size_t)threads * (size_t)per_queue * sizeof(int));
+    queues = calloc((size_t)threads, sizeof(GroupQueue));
+    workers = malloc((size_t)threads * sizeof(PortfolioWorker));
+    handles = malloc((size_t)threads * sizeof(pthread_t));
+    if (dealt == NULL || queues == NULL || workers == NULL || handles == NULL) {
+        free(dealt);
+        result = -1;
+        goto done;
+    }
+    for (int t = 0; t < threads; t++) {
+        queues[t].groups = dealt + (size_t)t * (size_t)per_queue;
+        pthread_mutex_init(&queues[t].lock, NULL);
+    }
+    for (int g = 0; g < num_groups; g++) {
+        GroupQueue* queue = &queues[g % threads];
+        queue->groups[queue->tail++] = g;
+    }
+
+    PortfolioWork work;
+    memset(&work, 0, sizeof(work));
+    work.sorted = sorted;
+    work.groups = groups;
+    work.queues = queues;
+    work.num_queues = threads;
+    work.longest = longest;
+    heston_fft_get_config(&work.config);
+    work.config.cache_max_bytes = ((work.config.cache_max_bytes > 0) ? work.config.cache_max_bytes
+                                                                     : FFT_CACHE_DEFAULT_MAX_BYTES) /
+                                  (size_t)threads;
+
+    int started = 0;
+    for (int t = 0; t < threads; t++) {
+        workers[t].work = &work;
+        workers[t].id = t;
+    }
+    while (threads > 1 && started < threads &&
+           pthread_create(&handles[started], NULL, pricing_worker, &workers[started]) == 0) {
+        started++;
+    }
+    if (started == 0) {
+        /* One thread, or none to spare: the first worker steals everything */
+        pricing_worker(&workers[0]);
+    }
+    for (int t = 0; t < started; t++) {
+        pthread_join(handles[t], NULL);
+    }
+
+    for (int t = 0; t < threads; t++) {
+        pthread_mutex_destroy(&queues[t].lock);
+    }
+    free(dealt);
+
+done:
+    free(handles);
+    free(workers);
+    free(queues);
+    free(groups);
+    free(sorted);
+    return result;
+}
+
+int portfolio_price(PortfolioPosition* positions, int count, const PortfolioOptions* options) {
+    if (positions == NULL || count <= 0 || options == NULL) {
+        return -1;
+    }
+
+    int threads = options->threads;
+    if (threads < 1) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = (cpus > 0) ? (int)cpus : 1;
+    }
+
+    if (fetch_market_data(positions, count, options) != 0 ||
+        price_groups(positions, count, threads) != 0) {
+        /* Out of memory before any group was priced */
+        for (int i = 0; i < count; i++) {
+            if (positions[i].result.error_code == 0) {
+                positions[i].result.error_code = ERROR_MEMORY_ALLOCATION;
+            }
+        }
+    }
+
+    int failed = 0;
+    for (int i = 0; i < count; i++) {
+        if (positions[i].result.error_code != 0) {
+            failed++;
+        }
+    }
+    return failed;
+}
+
+static void add_exposure(PortfolioExposure* exposure, const PortfolioPosition* position) {
+    const PricingResult* result = &position->result;
+
+    exposure->positions++;
+    if (result->error_code != 0) {
+        exposure->failed++;
+        return;
+    }
+    exposure->value += position->quantity * result->price;
+    exposure->delta += position->quantity * result->delta;
+    exposure->gamma += position->quantity * result->gamma;
+    exposure->theta += position->quantity * result->theta;
+    exposure->vega += position->quantity * result->vega;
+    exposure->rho += position->quantity * result->rho;
+}
+
+int portfolio_exposures(const PortfolioPosition* positions, int count, PortfolioExposure** exposures) {
+    PortfolioExposure* list = calloc((size_t)count + 1, sizeof(PortfolioExposure));
+    int num_tickers = 0;
+
+    *exposures = list;
+    if (list == NULL) {
+        return -1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        int t = 0;
+        while (t < num_tickers && strcmp(list[t].ticker, positions[i].ticker) != 0) {
+            t++;
+        }
+        if (t == num_tickers) {
+            memcpy(list[t].ticker, positions[i].ticker, sizeof(list[t].ticker));
+            num_tickers++;
+        }
+        add_exposure(&list[t], &positions[i]);
+    }
+
+    PortfolioExposure* total = &list[num_tickers];
+    snprintf(total->ticker, sizeof(total->ticker), "TOTAL");
+    for (int i = 0; i < count; i++) {
+        add_exposure(total, &positions[i]);
+    }
+    return num_tickers + 1;
+}
+
+static void write_report(FILE* out, const PortfolioPosition* positions, int count,
+                         const PortfolioExposure* exposures, int num_exposures) {
+    fprintf(out, "ticker,type,strike,expiry,quantity,spot,dividend_yield,volatility,rate,"
+                 "price,delta,gamma,theta,vega,rho,value,error_code\n");
+    for (int i = 0; i < count; i++) {
+        const PortfolioPosition* p = &positions[i];
+        const PricingResult* r = &p->result;
+
+        fprintf(out, "%s,%s,%.6f,%.6f,%g,", p->ticker, p->option_type == OPTION_CALL ? "call" : "put",
+                p->strike, p->expiry, p->quantity);
+        if (r->error_code != 0) {
+            fprintf(out, ",,,,,,,,,,,%d\n", r->error_code);
+            continue;
+        }
+        fprintf(out, "%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,0\n",
+                p->spot, p->dividend_yield, p->volatility, p->rate,
+                r->price, r->delta, r->gamma, r->theta, r->vega, r->rho, p->quantity * r->price);
+    }
+
+    fprintf(out, "\nticker,positions,failed,value,delta,gamma,theta,vega,rho\n");
+    for (int i = 0; i < num_exposures; i++) {
+        const PortfolioExposure* e = &exposures[i];
+        fprintf(out, "%s,%d,%d,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f\n", e->ticker, e->positions, e->failed,
+                e->value, e->delta, e->gamma, e->theta, e->vega, e->rho);
+    }
+}
+
+int portfolio_run(const PortfolioOptions* options) {
+    FILE* in = stdin;
+    if (options->positions_path != NULL && strcmp(options->positions_path, "-") != 0) {
+        in = fopen(options->positions_path, "r");
+        if (in == NULL) {
+            fprintf(stderr, "Error: Cannot open positions file %s\n", options->positions_path);
+            return -1;
+        }
+    }
+
+    PortfolioPosition* positions = NULL;
+    int count = portfolio_read_positions(in, &positions);
+    if (in != stdin) {
+        fclose(in);
+    }
+    if (count < 0) {
+        fprintf(stderr, "Error: Memory allocation for positions failed\n");
+        return -1;
+    }
+    if (count == 0) {
+        fprintf(stderr, "Error: No positions to price\n");
+        free(positions);
+        return -1;
+    }
+
+    int ret_code = market_data_init(options->config_path);
+    if (ret_code != 0) {
+        fprintf(stderr, "Error: Failed to initialize market data module (code: %d)\n", ret_code);
+        free(positions);
+        return -1;
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int failed = portfolio_price(positions, count, options);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    PortfolioExposure* exposures = NULL;
+    int num_exposures = portfolio_exposures(positions, count, &exposures);
+    if (num_exposures < 0) {
+        num_exposures = 0;
+    }
+    write_report(stdout, positions, count, exposures, num_exposures);
+
+    fprintf(stderr, "Priced %d of %d positions in %.2f s\n", count - failed, count,
+            (double)(end.tv_sec - start.tv_sec) + 1e-9 * (double)(end.tv_nsec - start.tv_nsec));
+
+    free(exposures);
+    free(positions);
+    market_data_cleanup();
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,1099 @@
+/**
+ * pricing_server.c
+ * Long-running pricing server: line-delimited JSON over a Unix or TCP socket,
+ * and the quote stream mode over a line-delimited JSON feed
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <poll.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <jansson.h>
+
+#include "../include/pricing_server.h"
+#include "../include/option_types.h"
+#include "../include/option_pricing.h"
+#include "../include/error_handling.h"
+#include "../include/market_data.h"
+#include "../include/heston_fft.h"
+#include "../include/perf_stats.h"
+#include "../include/quote_stream.h"
+
+/* Names accepted for the enumerated request fields, in enum order */
+static const char* const option_type_names[] = {"call", "put"};
+static const char* const model_type_names[] = {"black_scholes", "heston"};
+static const char* const method_names[] = {"analytic", "quadrature", "fft", "cos", "mc"};
+
+#define NAME_COUNT(names) ((int)(sizeof(names) / sizeof(names[0])))
+
+/**
+ * Counters reported by the stats request
+ */
+typedef struct {
+    unsigned long clients_total;     /* Connections accepted */
+    unsigned long clients_refused;   /* Connections refused at the client limit */
+    int clients_active;              /* Connections being served */
+    unsigned long requests;          /* Request lines received */
+    unsigned long malformed;         /* Lines that were not a valid request */
+    unsigned long failed;            /* Valid requests answered with an error */
+    unsigned long priced;            /* Pricing requests run */
+    double pricing_seconds;          /* Time spent pricing, market data excluded */
+    double pricing_max_seconds;      /* Slowest pricing call */
+} ServerStats;
+
+/**
+ * One connected client
+ *
+ * The FFT context outlives the connection, so the next client on the slot
+ * starts with its grids and plans.
+ */
+typedef struct {
+    int fd;
+    int used;
+    HestonFFTContext* ctx;           /* Created by the first thread on the slot */
+    FFTCacheStats cache;             /* Counters of ctx after its last request */
+} ClientSlot;
+
+static volatile sig_atomic_t g_stop = 0;
+
+/* The market data module is not thread-safe, so ticker lookups run one at a
+ * time, before and apart from the pricing */
+static pthread_mutex_t g_market_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Guards g_stats and g_clients; g_clients_done is signalled when a client leaves */
+static pthread_mutex_t g_state_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_clients_done = PTHREAD_COND_INITIALIZER;
+static ServerStats g_stats;
+static ClientSlot* g_clients = NULL;
+static int g_max_clients = 0;
+
+static struct timespec g_start_time;
+static int g_market_data_ready = 0;
+
+/* FFT settings every request starts from, with a share of the cache per slot */
+static HestonFFTConfig g_fft_config;
+
+static void handle_stop_signal(int sig) {
+    (void)sig;
+    g_stop = 1;
+}
+
+static double seconds_since(const struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+void pricing_server_default_options(PricingServerOptions* options) {
+    memset(options, 0, sizeof(*options));
+    options->max_clients = PRICING_SERVER_DEFAULT_MAX_CLIENTS;
+}
+
+/**
+ * Read an optional number; returns 0 if absent or valid, -1 if not a number
+ */
+static int get_number(const json_t* request, const char* key, double* value) {
+    json_t* item = json_object_get(request, key);
+    if (item == NULL || json_is_null(item)) {
+        return 0;
+    }
+    if (!json_is_number(item)) {
+        return -1;
+    }
+    *value = json_number_value(item);
+    return 0;
+}
+
+/**
+ * Read an optional enumerated field given as its number or its name
+ */
+static int get_enum(const json_t* request, const char* key,
+                    const char* const names[], int count, int* value) {
+    json_t* item = json_object_get(request, key);
+    if (item == NULL || json_is_null(item)) {
+        return 0;
+    }
+    if (json_is_integer(item)) {
+        json_int_t n = json_integer_value(item);
+        if (n < 0 || n >= count) {
+            return -1;
+        }
+        *value = (int)n;
+        return 0;
+    }
+    if (json_is_string(item)) {
+        const char* name = json_string_value(item);
+        for (int i = 0; i < count; i++) {
+            if (strcmp(name, names[i]) == 0) {
+                *value = i;
+                return 0;
+            }
+        }
+    }
+    return -1;
+}
+
+/**
+ * Start a response, echoing the request id if there is one
+ */
+static json_t* new_response(const json_t* request, const char* status) {
+    json_t* response = json_object();
+    json_t* id = request != NULL ? json_object_get(request, "id") : NULL;
+    if (id != NULL) {
+        json_object_set(response, "id", id);
+    }
+    json_object_set_new(response, "status", json_string(status));
+    return response;
+}
+
+static json_t* error_response(const json_t* request, int error_code, const char* message) {
+    json_t* response = new_response(request, "error");
+    json_object_set_new(response, "error_code", json_integer(error_code));
+    json_object_set_new(response, "message", json_string(message));
+    return response;
+}
+
+static json_t* health_response(const json_t* request) {
+    json_t* response = new_response(request, "ok");
+    pthread_mutex_lock(&g_state_lock);
+    int active = g_stats.clients_active;
+    pthread_mutex_unlock(&g_state_lock);
+    json_object_set_new(response, "uptime", json_real(seconds_since(&g_start_time)));
+    json_object_set_new(response, "clients", json_integer(active));
+    json_object_set_new(response, "market_data", json_boolean(g_market_data_ready));
+    return response;
+}
+
+static json_t* timing_object(const PerfTiming* timing) {
+    double mean_us = timing->count > 0 ? timing->total_ns * 1e-3 / timing->count : 0.0;
+    return json_pack("{s:I, s:f, s:f, s:f}",
+        "count", (json_int_t)timing->count,
+        "total_ms", timing->total_ns * 1e-6,
+        "mean_us", mean_us,
+        "max_us", timing->max_ns * 1e-3);
+}
+
+/**
+ * The engine counters, in the layout of perf_stats_write_json
+ */
+static json_t* engine_object(const PerfStats* perf) {
+    json_t* counters = json_object();
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        json_object_set_new(counters, perf_counter_name((PerfCounter)i), json_integer((json_int_t)perf->counters[i]));
+    }
+
+    json_t* timers = json_object();
+    for (int i = 0; i < PERF_TIMER_COUNT; i++) {
+        json_object_set_new(timers, perf_timer_name((PerfTimer)i), timing_object(&perf->timers[i]));
+    }
+
+    json_t* fft = json_object();
+    for (int i = 0; i < PERF_FFT_SIZE_SLOTS; i++) {
+        if (perf->fft[i].count > 0) {
+            char size[16];
+            snprintf(size, sizeof(size), "%lu", 1ul << i);
+            json_object_set_new(fft, size, timing_object(&perf->fft[i]));
+        }
+    }
+
+    return json_pack("{s:f, s:o, s:o, s:o}",
+        "uptime_s", perf->uptime_seconds,
+        "counters", counters,
+        "timers", timers,
+        "fft_executions", fft);
+}
+
+static json_t* stats_response(const json_t* request) {
+    ServerStats stats;
+    FFTCacheStats cache;
+    PerfStats perf;
+
+    /* The FFT cache counters are the sum over the client contexts */
+    memset(&cache, 0, sizeof(cache));
+    pthread_mutex_lock(&g_state_lock);
+    stats = g_stats;
+    for (int i = 0; i < g_max_clients; i++) {
+        const FFTCacheStats* slot = &g_clients[i].cache;
+        cache.hits += slot->hits;
+        cache.misses += slot->misses;
+        cache.evictions += slot->evictions;
+        cache.allocations += slot->allocations;
+        cache.entries += slot->entries;
+        cache.bytes += slot->bytes;
+        cache.max_bytes += g_fft_config.cache_max_bytes;
+    }
+    pthread_mutex_unlock(&g_state_lock);
+
+    perf_stats_snapshot(&perf);
+    if (json_is_true(json_object_get(request, "reset"))) {
+        perf_stats_reset();
+    }
+
+    json_t* response = new_response(request, "ok");
+    json_object_set_new(response, "uptime", json_real(seconds_since(&g_start_time)));
+
+    json_object_set_new(response, "clients", json_pack("{s:i, s:I, s:I}",
+        "active", stats.clients_active,
+        "total", (json_int_t)stats.clients_total,
+        "refused", (json_int_t)stats.clients_refused));
+
+    json_object_set_new(response, "requests", json_pack("{s:I, s:I, s:I}",
+        "total", (json_int_t)stats.requests,
+        "malformed", (json_int_t)stats.malformed,
+        "failed", (json_int_t)stats.failed));
+
+    double mean_us = stats.priced > 0 ? stats.pricing_seconds / stats.priced * 1e6 : 0.0;
+    json_object_set_new(response, "pricing", json_pack("{s:I, s:f, s:f}",
+        "count", (json_int_t)stats.priced,
+        "mean_us", mean_us,
+        "max_us", stats.pricing_max_seconds * 1e6));
+
+    json_object_set_new(response, "fft_cache", json_pack("{s:I, s:I, s:I, s:I, s:I, s:I, s:I}",
+        "hits", (json_int_t)cache.hits,
+        "misses", (json_int_t)cache.misses,
+        "evictions", (json_int_t)cache.evictions,
+        "allocations", (json_int_t)cache.allocations,
+        "entries", (json_int_t)cache.entries,
+        "bytes", (json_int_t)cache.bytes,
+        "max_bytes", (json_int_t)cache.max_bytes));
+
+    json_object_set_new(response, "engine", engine_object(&perf));
+    return response;
+}
+
+static json_t* price_response(ClientSlot* slot, const json_t* request) {
+    double spot_price = 0.0, strike_price = 0.0, time_to_expiry = 0.0;
+    double risk_free_rate = 0.0, dividend_yield = 0.0, volatility = 0.0;
+    double market_price = 0.0;
+    int option_type = OPTION_CALL;
+    int model_type = MODEL_BLACK_SCHOLES;
+    int method = METHOD_ANALYTIC;
+    GreeksFlags greeks_flags;
+    const char* ticker_symbol = NULL;
+
+    if (get_number(request, "spot", &spot_price) != 0 ||
+        get_number(request, "strike", &strike_price) != 0 ||
+        get_number(request, "expiry", &time_to_expiry) != 0 ||
+        get_number(request, "rate", &risk_free_rate) != 0 ||
+        get_number(request, "dividend", &dividend_yield) != 0 ||
+        get_number(request, "volatility", &volatility) != 0 ||
+        get_number(request, "market_price", &market_price) != 0) {
+        return error_response(request, ERROR_INVALID_PARAMETER, "numeric field expected");
+    }
+    if (get_enum(request, "type", option_type_names, NAME_COUNT(option_type_names), &option_type) != 0) {
+        return error_response(request, ERROR_INVALID_OPTION_TYPE, get_error_message(ERROR_INVALID_OPTION_TYPE));
+    }
+    if (get_enum(request, "model", model_type_names, NAME_COUNT(model_type_names), &model_type) != 0) {
+        return error_response(request, ERROR_INVALID_MODEL_TYPE, get_error_message(ERROR_INVALID_MODEL_TYPE));
+    }
+    if (get_enum(request, "method", method_names, NAME_COUNT(method_names), &method) != 0) {
+        return error_response(request, ERROR_INVALID_NUMERICAL_METHOD,
+                              get_error_message(ERROR_INVALID_NUMERICAL_METHOD));
+    }
+
+    memset(&greeks_flags, 0, sizeof(greeks_flags));
+    if (json_is_true(json_object_get(request, "greeks"))) {
+        greeks_flags.delta = 1;
+        greeks_flags.gamma = 1;
+        greeks_flags.theta = 1;
+        greeks_flags.vega = 1;
+        greeks_flags.rho = 1;
+    }
+
+    json_t* ticker = json_object_get(request, "ticker");
+    if (json_is_string(ticker) && *json_string_value(ticker)) {
+        ticker_symbol = json_string_value(ticker);
+    }
+
+    if (slot->ctx == NULL) {
+        return error_response(request, ERROR_MEMORY_ALLOCATION, get_error_message(ERROR_MEMORY_ALLOCATION));
+    }
+
+    /* Overrides as in price_option(): the fetched spot, and the dividend
+     * yield unless the request gives one */
+    if (ticker_symbol != NULL) {
+        double fetched_spot = 0.0;
+        double fetched_div = 0.0;
+
+        pthread_mutex_lock(&g_market_lock);
+        int fetched = get_market_data(ticker_symbol, &fetched_spot, &fetched_div);
+        pthread_mutex_unlock(&g_market_lock);
+
+        if (fetched == ERROR_NONE) {
+            if (fetched_spot > 0) {
+                spot_price = fetched_spot;
+            }
+            if (dividend_yield == 0) {
+                dividend_yield = fetched_div;
+            }
+        }
+    }
+
+    PricingResult result;
+    struct timespec start;
+    FFTCacheStats cache;
+    int ret_code;
+
+    /* Calibration adapts the grid to each option; start every request afresh */
+    heston_fft_context_set_config(slot->ctx, &g_fft_config);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    ret_code = price_option_in_context(
+        slot->ctx,
+        spot_price, strike_price, time_to_expiry,
+        risk_free_rate, dividend_yield, volatility,
+        (OptionType)option_type, (ModelType)model_type, (NumericalMethod)method,
+        market_price, greeks_flags,
+        &result
+    );
+    double elapsed = seconds_since(&start);
+    heston_fft_context_get_cache_stats(slot->ctx, &cache);
+
+    pthread_mutex_lock(&g_state_lock);
+    slot->cache = cache;
+    g_stats.priced++;
+    g_stats.pricing_seconds += elapsed;
+    if (elapsed > g_stats.pricing_max_seconds) {
+        g_stats.pricing_max_seconds = elapsed;
+    }
+    pthread_mutex_unlock(&g_state_lock);
+
+    if (ret_code != 0) {
+        return error_response(request, ret_code, get_error_message(ret_code));
+    }
+
+    json_t* response = new_response(request, "ok");
+    json_object_set_new(response, "price", json_real(result.price));
+    if (result.implied_volatility > 0) {
+        json_object_set_new(response, "implied_volatility", json_real(result.implied_volatility));
+    }
+    if (greeks_flags.delta) {
+        json_object_set_new(response, "delta", json_real(result.delta));
+        json_object_set_new(response, "gamma", json_real(result.gamma));
+        json_object_set_new(response, "theta", json_real(result.theta));
+        json_object_set_new(response, "vega", json_real(result.vega));
+        json_object_set_new(response, "rho", json_real(result.rho));
+    }
+    return response;
+}
+
+/**
+ * Log an error response through the buffered error log
+ */
+static void log_error_response(const json_t* response, const char* op) {
+    json_t* code = json_object_get(response, "error_code");
+    json_t* message = json_object_get(response, "message");
+    log_error(json_is_integer(code) ? (int)json_integer_value(code) : ERROR_UNKNOWN, op,
+              json_is_string(message) ? json_string_value(message) : NULL);
+}
+
+/**
+ * Answer one request line
+ */
+static json_t* handle_request(ClientSlot* slot, const char* line, size_t length) {
+    json_error_t error;
+    json_t* request = json_loadb(line, length, 0, &error);
+    json_t* response;
+    int valid = json_is_object(request);
+    const char* name = "request";
+
+    if (!valid) {
+        response = error_response(NULL, ERROR_INVALID_PARAMETER,
+                                  request == NULL ? error.text : "request must be a JSON object");
+    } else {
+        json_t* op = json_object_get(request, "op");
+        name = json_is_string(op) ? json_string_value(op) : (op == NULL ? "price" : "");
+
+        if (strcmp(name, "price") == 0) {
+            response = price_response(slot, request);
+        } else if (strcmp(name, "health") == 0) {
+            response = health_response(request);
+        } else if (strcmp(name, "stats") == 0) {
+            response = stats_response(request);
+        } else {
+            response = error_response(request, ERROR_INVALID_PARAMETER, "unknown op");
+        }
+    }
+
+    int failed = strcmp(json_string_value(json_object_get(response, "status")), "ok") != 0;
+    pthread_mutex_lock(&g_state_lock);
+    g_stats.requests++;
+    if (!valid) {
+        g_stats.malformed++;
+    } else if (failed) {
+        g_stats.failed++;
+    }
+    pthread_mutex_unlock(&g_state_lock);
+
+    if (failed) {
+        log_error_response(response, *name ? name : "request");
+    }
+    json_decref(request);
+    return response;
+}
+
+/**
+ * Append a response and its newline to the output buffer
+ */
+static int append_response(char** out, size_t* out_len, size_t* out_cap, json_t* response) {
+    char* text = json_dumps(response, JSON_COMPACT);
+    json_decref(response);
+    if (text == NULL) {
+        return -1;
+    }
+
+    size_t len = strlen(text);
+    if (*out_len + len + 1 > *out_cap) {
+        size_t cap = *out_cap * 2;
+        while (cap < *out_len + len + 1) {
+            cap *= 2;
+        }
+        char* grown = realloc(*out, cap);
+        if (grown == NULL) {
+            free(text);
+            return -1;
+        }
+        *out = grown;
+        *out_cap = cap;
+    }
+    memcpy(*out + *out_len, text, len);
+    (*out)[*out_len + len] = '\n';
+    *out_len += len + 1;
+    free(text);
+    return 0;
+}
+
+static int write_all(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/**
+ * Serve one client until it disconnects
+ *
+ * All complete lines of one read are answered with a single write, so a
+ * client that pipelines requests gets its answers in as few packets.
+ */
+static void serve_client(ClientSlot* slot) {
+    const int fd = slot->fd;
+    char* in = malloc(PRICING_SERVER_MAX_LINE);
+    size_t out_cap = 4096;
+    char* out = malloc(out_cap);
+    size_t in_len = 0;
+
+    if (in == NULL || out == NULL) {
+        free(in);
+        free(out);
+        return;
+    }
+
+    while (!g_stop) {
+        ssize_t n = read(fd, in + in_len, PRICING_SERVER_MAX_LINE - in_len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        in_len += (size_t)n;
+
+        size_t out_len = 0;
+        size_t start = 0;
+        int ok = 1;
+        for (size_t i = in_len - (size_t)n; i < in_len && ok; i++) {
+            if (in[i] != '\n') {
+                continue;
+            }
+            size_t end = i;
+            if (end > start && in[end - 1] == '\r') {
+                end--;
+            }
+            if (end > start) {
+                ok = append_response(&out, &out_len, &out_cap, handle_request(slot, in + start, end - start)) == 0;
+            }
+            start = i + 1;
+        }
+
+        int too_long = ok && start == 0 && in_len == PRICING_SERVER_MAX_LINE;
+        if (too_long) {
+            log_error(ERROR_INVALID_PARAMETER, "request", "request line too long");
+            ok = append_response(&out, &out_len, &out_cap,
+                                 error_response(NULL, ERROR_INVALID_PARAMETER, "request line too long")) == 0;
+        }
+        if (!ok || (out_len > 0 && write_all(fd, out, out_len) != 0) || too_long) {
+            break;
+        }
+
+        /* Keep the incomplete last line for the next read */
+        memmove(in, in + start, in_len - start);
+        in_len -= start;
+    }
+
+    free(in);
+    free(out);
+}
+
+static void release_client(ClientSlot* slot) {
+    pthread_mutex_lock(&g_state_lock);
+    close(slot->fd);
+    slot->used = 0;
+    g_stats.clients_active--;
+    pthread_cond_broadcast(&g_clients_done);
+    pthread_mutex_unlock(&g_state_lock);
+}
+
+static void* client_thread(void* arg) {
+    ClientSlot* slot = arg;
+    if (slot->ctx == NULL) {
+        slot->ctx = heston_fft_context_create();
+    }
+    serve_client(slot);
+    release_client(slot);
+    return NULL;
+}
+
+/**
+ * Hand a new connection to a client thread, or refuse it at the limit
+ */
+static void start_client(int fd) {
+    ClientSlot* slot = NULL;
+
+    pthread_mutex_lock(&g_state_lock);
+    for (int i = 0; i < g_max_clients; i++) {
+        if (!g_clients[i].used) {
+            slot = &g_clients[i];
+            slot->used = 1;
+            slot->fd = fd;
+            g_stats.clients_active++;
+            g_stats.clients_total++;
+            break;
+        }
+    }
+    if (slot == NULL) {
+        g_stats.clients_refused++;
+    }
+    pthread_mutex_unlock(&g_state_lock);
+
+    if (slot == NULL) {
+        static const char busy[] = "{\"status\":\"busy\"}\n";
+        write_all(fd, busy, sizeof(busy) - 1);
+        close(fd);
+        return;
+    }
+
+    /* Client threads leave SIGINT and SIGTERM to the accept loop */
+    sigset_t block, old;
+    sigemptyset(&block);
+    sigaddset(&block, SIGINT);
+    sigaddset(&block, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &block, &old);
+
+    pthread_attr_t attr;
+    pthread_t thread;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    int rc = pthread_create(&thread, &attr, client_thread, slot);
+    pthread_attr_destroy(&attr);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    if (rc != 0) {
+        release_client(slot);
+    }
+}
+
+static int listen_unix(const char* path) {
+    struct sockaddr_un addr;
+    struct stat st;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Error: Socket path too long: %s\n", path);
+        return -1;
+    }
+
+    /* Replace a socket left behind by an earlier run, but nothing else */
+    if (stat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+        unlink(path);
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, SOMAXCONN) != 0) {
+        fprintf(stderr, "Error: Cannot listen on %s: %s\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int listen_tcp(const char* spec) {
+    char host[256] = "";
+    const char* port = spec;
+    const char* colon = strrchr(spec, ':');
+
+    if (colon != NULL) {
+        size_t len = (size_t)(colon - spec);
+        if (len >= sizeof(host)) {
+            fprintf(stderr, "Error: Host name too long: %s\n", spec);
+            return -1;
+        }
+        memcpy(host, spec, len);
+        host[len] = '\0';
+        port = colon + 1;
+    }
+
+    struct addrinfo hints, *list = NULL;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+
+    int rc = getaddrinfo(*host ? host : NULL, port, &hints, &list);
+    if (rc != 0) {
+        fprintf(stderr, "Error: Cannot resolve %s: %s\n", spec, gai_strerror(rc));
+        return -1;
+    }
+
+    int fd = -1;
+    for (struct addrinfo* ai = list; ai != NULL && fd < 0; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        if (bind(fd, ai->ai_addr, ai->ai_addrlen) != 0 || listen(fd, SOMAXCONN) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(list);
+
+    if (fd < 0) {
+        fprintf(stderr, "Error: Cannot listen on tcp:%s\n", spec);
+    }
+    return fd;
+}
+
+int pricing_server_run(const PricingServerOptions* options) {
+    const char* address = options != NULL ? options->address : NULL;
+    const char* unix_path = NULL;
+    int is_tcp = 0;
+    int listen_fd;
+
+    if (address == NULL) {
+        fprintf(stderr, "Error: No server address given\n");
+        return -1;
+    }
+    if (strncmp(address, "unix:", 5) == 0) {
+        unix_path = address + 5;
+        listen_fd = listen_unix(unix_path);
+    } else if (strncmp(address, "tcp:", 4) == 0) {
+        is_tcp = 1;
+        listen_fd = listen_tcp(address + 4);
+    } else {
+        fprintf(stderr, "Error: Server address must be unix:PATH or tcp:[HOST:]PORT\n");
+        return -1;
+    }
+    if (listen_fd < 0) {
+        return -1;
+    }
+
+    FILE* error_log = NULL;
+    if (options->error_log_path != NULL) {
+        error_log = fopen(options->error_log_path, "a");
+        if (error_log == NULL || set_error_log_file(error_log) != ERROR_SUCCESS) {
+            fprintf(stderr, "Warning: Cannot write the error log %s, errors are not logged\n",
+                    options->error_log_path);
+            if (error_log != NULL) {
+                fclose(error_log);
+                error_log = NULL;
+            }
+        }
+    }
+
+    g_max_clients = options->max_clients > 0 ? options->max_clients : PRICING_SERVER_DEFAULT_MAX_CLIENTS;
+    g_clients = calloc((size_t)g_max_clients, sizeof(ClientSlot));
+    if (g_clients == NULL) {
+        close(listen_fd);
+        if (error_log != NULL) {
+            set_error_log_file(NULL);
+            fclose(error_log);
+        }
+        return -1;
+    }
+    memset(&g_stats, 0, sizeof(g_stats));
+    clock_gettime(CLOCK_MONOTONIC, &g_start_time);
+    g_stop = 0;
+
+    /* Seed jansson's hash tables before any client thread creates objects */
+    json_object_seed(0);
+    perf_stats_reset();
+
+    if (options->wisdom_path != NULL) {
+        heston_fft_load_wisdom(options->wisdom_path);
+    }
+    if (options->spot_invariant || options->double_precision) {
+        HestonFFTConfig config;
+        heston_fft_get_config(&config);
+        config.spot_invariant = config.spot_invariant || options->spot_invariant;
+        config.mixed_precision = config.mixed_precision && !options->double_precision;
+        heston_fft_set_config(&config);
+    }
+    if (options->tuning_path != NULL) {
+        heston_fft_load_tuning(options->tuning_path);
+    }
+    if (options->publish_path != NULL) {
+        heston_fft_publish_grids(options->publish_path);
+    }
+
+    /* Every client slot prices in its own context with a share of the cache */
+    heston_fft_get_config(&g_fft_config);
+    g_fft_config.cache_max_bytes = ((g_fft_config.cache_max_bytes > 0) ? g_fft_config.cache_max_bytes
+                                                                       : FFT_CACHE_DEFAULT_MAX_BYTES) /
+                                   (size_t)g_max_clients;
+
+    int ret_code = market_data_init(options->config_path);
+    g_market_data_ready = ret_code == 0;
+    if (!g_market_data_ready) {
+        fprintf(stderr, "Warning: Failed to initialize market data module: %s\n",
+                get_error_message(ret_code));
+    }
+
+    /* No SA_RESTART, so a stop signal interrupts poll() below */
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_stop_signal;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    fprintf(stderr, "Pricing server listening on %s\n", address);
+
+    /* Woken at least every PRICING_SERVER_LOG_FLUSH_MS to write out logged errors,
+     * which the error log otherwise keeps until its buffer is half full */
+    while (!g_stop) {
+        struct pollfd pfd = {listen_fd, POLLIN, 0};
+        int ready = poll(&pfd, 1, PRICING_SERVER_LOG_FLUSH_MS);
+        flush_error_log();
+        if (ready <= 0) {
+            continue;
+        }
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            continue;
+        }
+        if (is_tcp) {
+            /* Responses are single small writes; don't hold them back */
+            int on = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        }
+        start_client(fd);
+    }
+
+    close(listen_fd);
+    if (unix_path != NULL) {
+        unlink(unix_path);
+    }
+
+    /* Wake idle clients and wait until every client thread is done */
+    pthread_mutex_lock(&g_state_lock);
+    for (int i = 0; i < g_max_clients; i++) {
+        if (g_clients[i].used) {
+            shutdown(g_clients[i].fd, SHUT_RDWR);
+        }
+    }
+    while (g_stats.clients_active > 0) {
+        pthread_cond_wait(&g_clients_done, &g_state_lock);
+    }
+    pthread_mutex_unlock(&g_state_lock);
+
+    fprintf(stderr, "Pricing server stopped after %lu requests\n", g_stats.requests);
+
+    for (int i = 0; i < g_max_clients; i++) {
+        heston_fft_context_destroy(g_clients[i].ctx);
+    }
+
+    heston_fft_load_tuning(NULL);
+    heston_fft_publish_grids(NULL);
+    if (options->wisdom_path != NULL) {
+        heston_fft_save_wisdom(options->wisdom_path);
+    }
+    if (g_market_data_ready) {
+        market_data_cleanup();
+    }
+    heston_fft_cleanup_plans();
+    cleanup_fft_cache();
+
+    if (error_log != NULL) {
+        set_error_log_file(NULL);
+        fclose(error_log);
+    }
+
+    free(g_clients);
+    g_clients = NULL;
+    return 0;
+}
+
+/**
+ * State shared with the publish callback of the stream mode
+ */
+typedef struct {
+    QuoteStream* stream;       /* Set before the first quote is pushed */
+    uint64_t stats_interval_ns;
+    uint64_t next_stats_ns;    /* Publish thread only */
+    unsigned long malformed;   /* Skipped input lines (atomic) */
+    struct timespec start;
+} StreamOutput;
+
+void pricing_stream_default_options(PricingStreamOptions* options) {
+    QuoteStreamOptions defaults;
+    quote_stream_default_options(&defaults);
+
+    memset(options, 0, sizeof(*options));
+    options->input_path = "-";
+    options->capacity = defaults.capacity;
+    options->min_fit_quotes = defaults.min_fit_quotes;
+    options->refit_interval = defaults.refit_interval;
+}
+
+static json_t* optional_real(double value) {
+    return value >= 0.0 ? json_real(value) : json_null();
+}
+
+static void write_event(json_t* event) {
+    char* line = json_dumps(event, JSON_COMPACT);
+    if (line != NULL) {
+        fputs(line, stdout);
+        fputc('\n', stdout);
+        free(line);
+    }
+    json_decref(event);
+}
+
+static void write_stream_stats(StreamOutput* output, const QuoteStreamStats* stats) {
+    PerfStats perf;
+    perf_stats_snapshot(&perf);
+
+    json_t* stages = json_object();
+    for (int i = 0; i < QUOTE_STREAM_STAGE_COUNT; i++) {
+        json_object_set_new(stages, quote_stream_stage_name((QuoteStreamStage)i), json_pack("{s:I, s:I, s:o}",
+            "records", (json_int_t)stats->stages[i].records,
+            "coalesced", (json_int_t)stats->stages[i].coalesced,
+            "latency", timing_object(&stats->stages[i].latency)));
+    }
+
+    write_event(json_pack("{s:s, s:f, s:o, s:o, s:I, s:I, s:i, s:I, s:o}",
+        "event", "stats",
+        "uptime", seconds_since(&output->start),
+        "stages", stages,
+        "end_to_end", timing_object(&stats->end_to_end),
+        "fits", (json_int_t)stats->fits,
+        "fit_failures", (json_int_t)stats->fit_failures,
+        "chains", stats->chains,
+        "malformed", (json_int_t)__atomic_load_n(&output->malformed, __ATOMIC_RELAXED),
+        "engine", engine_object(&perf)));
+}
+
+/**
+ * Publish callback: one line per event, and a stats line when it is due
+ */
+static void publish_event(const StreamEvent* event, void* user) {
+    StreamOutput* output = user;
+    const StreamQuote* quote = &event->quote;
+
+    if (event->type == STREAM_EVENT_FIT) {
+        const HestonParams* params = &event->fit.params;
+        write_event(json_pack("{s:s, s:s, s:f, s:f, s:f, s:f, s:{s:f, s:f, s:f, s:f, s:f}, s:f, s:i, s:i, s:b, s:f}",
+            "event", "fit",
+            "ticker", quote->ticker,
+            "expiry", quote->T,
+            "spot", quote->S,
+            "rate", quote->r,
+            "dividend", quote->q,
+            "params", "v0", params->v0, "kappa", params->kappa, "theta", params->theta,
+                      "sigma", params->sigma, "rho", params->rho,
+            "rmse", event->fit.rmse,
+            "quotes", event->fit_quotes,
+            "iterations", event->fit.iterations,
+            "converged", event->fit.converged,
+            "latency_us", event->latency_ns * 1e-3));
+    } else {
+        json_t* line = json_pack("{s:s, s:s, s:s, s:f, s:f, s:f, s:f, s:f, s:f, s:o, s:o, s:o, s:f}",
+            "event", "quote",
+            "ticker", quote->ticker,
+            "type", option_type_names[quote->type],
+            "spot", quote->S,
+            "strike", quote->K,
+            "expiry", quote->T,
+            "rate", quote->r,
+            "dividend", quote->q,
+            "market_price", quote->price,
+            "iv", optional_real(event->iv),
+            "model_price", optional_real(event->model_price),
+            "model_iv", optional_real(event->model_iv),
+            "latency_us", event->latency_ns * 1e-3);
+        if (event->iv_status != IV_OK) {
+            json_object_set_new(line, "iv_error", json_string(bs_iv_status_string(event->iv_status)));
+        }
+        write_event(line);
+    }
+
+    if (output->stats_interval_ns > 0) {
+        uint64_t now = perf_now_ns();
+        if (now >= output->next_stats_ns) {
+            QuoteStreamStats stats;
+            quote_stream_stats(output->stream, &stats);
+            write_stream_stats(output, &stats);
+            output->next_stats_ns = now + output->stats_interval_ns;
+        }
+    }
+}
+
+/**
+ * Parse one feed line; returns 0 on success, -1 if it is not a valid quote
+ */
+static int parse_stream_quote(const char* line, StreamQuote* quote) {
+    json_t* request = json_loads(line, 0, NULL);
+    int option_type = OPTION_CALL;
+    int status = -1;
+
+    memset(quote, 0, sizeof(*quote));
+    if (json_is_object(request)) {
+        json_t* ticker = json_object_get(request, "ticker");
+        const char* symbol = json_is_string(ticker) ? json_string_value(ticker) : "";
+
+        if (*symbol != '\0' && strlen(symbol) < sizeof(quote->ticker) &&
+            get_number(request, "spot", &quote->S) == 0 &&
+            get_number(request, "strike", &quote->K) == 0 &&
+            get_number(request, "expiry", &quote->T) == 0 &&
+            get_number(request, "rate", &quote->r) == 0 &&
+            get_number(request, "dividend", &quote->q) == 0 &&
+            get_number(request, "market_price", &quote->price) == 0 &&
+            get_enum(request, "type", option_type_names, NAME_COUNT(option_type_names), &option_type) == 0) {
+            strcpy(quote->ticker, symbol);
+            quote->type = (OptionType)option_type;
+            status = 0;
+        }
+    }
+    json_decref(request);
+    return status;
+}
+
+int pricing_stream_run(const PricingStreamOptions* options) {
+    FILE* in = stdin;
+    if (strcmp(options->input_path, "-") != 0) {
+        in = fopen(options->input_path, "r");
+        if (in == NULL) {
+            fprintf(stderr, "Error: Cannot open quote feed %s: %s\n", options->input_path, strerror(errno));
+            return -1;
+        }
+    }
+
+    char* line = malloc(PRICING_SERVER_MAX_LINE);
+    if (line == NULL) {
+        if (in != stdin) {
+            fclose(in);
+        }
+        return -1;
+    }
+
+    if (options->spot_invariant) {
+        HestonFFTConfig config;
+        heston_fft_get_config(&config);
+        config.spot_invariant = true;
+        heston_fft_set_config(&config);
+    }
+
+    StreamOutput output;
+    memset(&output, 0, sizeof(output));
+    clock_gettime(CLOCK_MONOTONIC, &output.start);
+    output.stats_interval_ns = (uint64_t)(options->stats_interval * 1e9);
+    output.next_stats_ns = perf_now_ns() + output.stats_interval_ns;
+
+    QuoteStreamOptions stream_options;
+    quote_stream_default_options(&stream_options);
+    stream_options.capacity = options->capacity;
+    stream_options.min_fit_quotes = options->min_fit_quotes;
+    stream_options.refit_interval = options->refit_interval;
+    stream_options.publish = publish_event;
+    stream_options.user = &output;
+
+    /* Events are read by other programs as they come */
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    output.stream = quote_stream_start(&stream_options);
+    if (output.stream == NULL) {
+        fprintf(stderr, "Error: Failed to start the quote pipeline\n");
+        free(line);
+        if (in != stdin) {
+            fclose(in);
+        }
+        return -1;
+    }
+
+    /* No SA_RESTART, so a stop signal interrupts the read below */
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_stop_signal;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    unsigned long line_no = 0;
+    while (!g_stop && fgets(line, PRICING_SERVER_MAX_LINE, in) != NULL) {
+        StreamQuote quote;
+        line_no++;
+        if (line[strspn(line, " \t\r\n")] == '\0') {
+            continue;
+        }
+        if (parse_stream_quote(line, &quote) != 0 || quote_stream_push(output.stream, &quote) != 0) {
+            __atomic_fetch_add(&output.malformed, 1, __ATOMIC_RELAXED);
+            fprintf(stderr, "Warning: Skipping invalid quote on line %lu\n", line_no);
+        }
+    }
+
+    QuoteStreamStats stats;
+    quote_stream_close(output.stream, &stats);
+    write_stream_stats(&output, &stats);
+    fflush(stdout);
+
+    heston_fft_cleanup_plans();
+    free(line);
+    if (in != stdin) {
+        fclose(in);
+    }
+    return 0;
+}
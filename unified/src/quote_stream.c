@@ -0,0 +1,1051 @@
+/**
+ * @file quote_stream.c
+ * @brief Streaming pipeline from option quotes to implied vols and Heston fits
+ *
+ * Each ring has one producing and one consuming thread. The producer owns
+ * the tail and the consumer the head; each publishes its index with a
+ * release store after copying the records and reads the other's with an
+ * acquire load, so no locks are taken on the way from ingest to publish.
+ * An idle stage spins briefly, then yields, then sleeps in short steps.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "../include/quote_stream.h"
+#include "../include/heston_fft.h"
+#include "../include/error_handling.h"
+
+/* Records a stage takes off its ring at a time */
+#define STAGE_BATCH 256
+
+/* Idle rounds spent spinning, then yielding, before a stage sleeps */
+#define IDLE_SPINS 64
+#define IDLE_YIELDS 128
+#define IDLE_SLEEP_NS 100000L
+
+#define CACHE_LINE 64
+
+/* A record on its way through the pipeline */
+typedef struct {
+    StreamEvent event;
+    uint64_t pushed_ns;       /* quote_stream_push() time, or of a fit's newest quote */
+    uint64_t entered_ns;      /* Time the record entered the current stage */
+} StreamRecord;
+
+typedef struct {
+    StreamRecord* slots;
+    uint64_t mask;
+    char pad0[CACHE_LINE];
+    uint64_t head;            /* Next record to read, written by the consumer */
+    char pad1[CACHE_LINE];
+    uint64_t tail;            /* Next slot to write, written by the producer */
+    char pad2[CACHE_LINE];
+    int closed;               /* Set by the producer after its last record */
+} StreamRing;
+
+/*
+ * Records by instrument, in order of first arrival. A record whose key is
+ * already present replaces the older one in place. Records before 'head'
+ * have been handed on; their index slots are stale until the next rebuild.
+ */
+typedef struct {
+    StreamRecord* items;
+    int head;
+    int count;
+    int capacity;
+    int* index;               /* Position + 1 of a record per slot, 0 if empty */
+    int index_size;           /* Power of 2 */
+    int index_used;           /* Occupied slots, stale ones included */
+} PendingTable;
+
+/* Counters of one stage, written by its thread alone */
+typedef struct {
+    uint64_t records;
+    uint64_t coalesced;
+    uint64_t latency_count;
+    uint64_t latency_total_ns;
+    uint64_t latency_max_ns;
+} StageCounters;
+
+/* Latest quote of one strike in a chain */
+typedef struct {
+    OptionType type;
+    double K;
+    double S;                 /* Spot of the last quote */
+    double iv;                /* -1.0 if the last quote had none */
+} BookEntry;
+
+/* Quotes of one ticker and expiry */
+typedef struct {
+    char ticker[QUOTE_STREAM_TICKER_LEN];
+    double T;
+    double S, r, q;           /* Of the newest quote */
+    BookEntry* entries;
+    int count;
+    int capacity;
+    int dirty;                /* Quotes changed since the last calibration */
+    int fitted;               /* params holds a fit */
+    HestonParams params;
+    uint64_t fit_ns;          /* Time of the last calibration */
+    uint64_t newest_pushed_ns;
+} StreamChain;
+
+enum { JOB_IDLE = 0, JOB_SUBMITTED, JOB_DONE };
+
+/*
+ * Calibration handed from the fit stage to its helper thread. The fit stage
+ * fills it in while idle and the helper while submitted; each hands it over
+ * with a release store of 'state'.
+ */
+typedef struct {
+    int state;                /* JOB_IDLE, JOB_SUBMITTED or JOB_DONE */
+    int stop;                 /* Set by the fit stage to end the helper */
+    StreamChain* chain;
+    HestonQuote* quotes;      /* Calibration input, grown as needed */
+    int n;
+    int capacity;
+    int seeded;               /* Start from 'initial', the chain's last fit */
+    HestonParams initial;
+    HestonCalibrationOptions options;
+    HestonCalibrationResult result;
+    int status;               /* From heston_calibrate() */
+    double S, r, q;           /* Chain's market at the snapshot */
+    uint64_t pushed_ns;       /* Of the chain's newest quote at the snapshot */
+    uint64_t submitted_ns;
+} CalibrationJob;
+
+/* Fit stage state, owned by its thread */
+typedef struct {
+    StreamChain** chains;
+    int count;
+    int capacity;
+    int* index;               /* Position + 1 of a chain per slot, 0 if empty */
+    int index_size;
+    int cursor;               /* Next chain considered for calibration */
+    HestonFFTContext* ctx;    /* Grid cache for the model prices */
+    CalibrationJob job;
+    pthread_t helper;
+    int helper_running;       /* Calibrations run on 'helper' rather than inline */
+} FitBook;
+
+struct QuoteStream {
+    QuoteStreamOptions options;
+    StreamRing rings[QUOTE_STREAM_STAGE_COUNT - 1];   /* Input of the iv, fit and publish stages */
+    PendingTable ingest;      /* Quotes waiting for room in the first ring */
+    StageCounters counters[QUOTE_STREAM_STAGE_COUNT];
+    StageCounters end_to_end;
+    uint64_t fits;
+    uint64_t fit_failures;
+    int chains;
+    pthread_t threads[QUOTE_STREAM_STAGE_COUNT - 1];
+};
+
+/* Arguments of a stage thread */
+typedef struct {
+    QuoteStream* stream;
+    QuoteStreamStage stage;
+} StageThread;
+
+static const char* const stage_names[QUOTE_STREAM_STAGE_COUNT] = {"ingest", "iv", "fit", "publish"};
+
+const char* quote_stream_stage_name(QuoteStreamStage stage) {
+    return (unsigned)stage < QUOTE_STREAM_STAGE_COUNT ? stage_names[stage] : "unknown";
+}
+
+void quote_stream_default_options(QuoteStreamOptions* options) {
+    if (options == NULL) {
+        return;
+    }
+
+    memset(options, 0, sizeof(QuoteStreamOptions));
+    options->capacity = QUOTE_STREAM_DEFAULT_CAPACITY;
+    options->min_fit_quotes = HESTON_NUM_PARAMS;
+    options->refit_iterations = 20;
+    options->refit_interval = 0.0;
+    heston_calibration_default_options(&options->calibration);
+}
+
+/* ---- Counters ---- */
+
+static void count_records(StageCounters* counters, uint64_t records) {
+    __atomic_fetch_add(&counters->records, records, __ATOMIC_RELAXED);
+}
+
+static void count_coalesced(StageCounters* counters, uint64_t records) {
+    if (records > 0) {
+        __atomic_fetch_add(&counters->coalesced, records, __ATOMIC_RELAXED);
+    }
+}
+
+static void count_latency(StageCounters* counters, uint64_t ns) {
+    __atomic_fetch_add(&counters->latency_count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&counters->latency_total_ns, ns, __ATOMIC_RELAXED);
+    if (ns > __atomic_load_n(&counters->latency_max_ns, __ATOMIC_RELAXED)) {
+        __atomic_store_n(&counters->latency_max_ns, ns, __ATOMIC_RELAXED);
+    }
+}
+
+static void read_timing(const StageCounters* counters, PerfTiming* timing) {
+    timing->count = __atomic_load_n(&counters->latency_count, __ATOMIC_RELAXED);
+    timing->total_ns = __atomic_load_n(&counters->latency_total_ns, __ATOMIC_RELAXED);
+    timing->max_ns = __atomic_load_n(&counters->latency_max_ns, __ATOMIC_RELAXED);
+}
+
+void quote_stream_stats(const QuoteStream* stream, QuoteStreamStats* stats) {
+    if (stream == NULL || stats == NULL) {
+        return;
+    }
+
+    memset(stats, 0, sizeof(QuoteStreamStats));
+    for (int i = 0; i < QUOTE_STREAM_STAGE_COUNT; i++) {
+        stats->stages[i].records = __atomic_load_n(&stream->counters[i].records, __ATOMIC_RELAXED);
+        stats->stages[i].coalesced = __atomic_load_n(&stream->counters[i].coalesced, __ATOMIC_RELAXED);
+        read_timing(&stream->counters[i], &stats->stages[i].latency);
+    }
+    read_timing(&stream->end_to_end, &stats->end_to_end);
+    stats->fits = __atomic_load_n(&stream->fits, __ATOMIC_RELAXED);
+    stats->fit_failures = __atomic_load_n(&stream->fit_failures, __ATOMIC_RELAXED);
+    stats->chains = __atomic_load_n(&stream->chains, __ATOMIC_RELAXED);
+}
+
+/* ---- Rings ---- */
+
+static int ring_init(StreamRing* ring, uint64_t capacity) {
+    memset(ring, 0, sizeof(StreamRing));
+    ring->slots = malloc(capacity * sizeof(StreamRecord));
+    ring->mask = capacity - 1;
+    return ring->slots != NULL ? 0 : -1;
+}
+
+static int ring_try_push(StreamRing* ring, const StreamRecord* record) {
+    uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+    if (tail - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) > ring->mask) {
+        return 0;
+    }
+    ring->slots[tail & ring->mask] = *record;
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+static int ring_pop(StreamRing* ring, StreamRecord* records, int max) {
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    uint64_t available = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) - head;
+    int n = available < (uint64_t)max ? (int)available : max;
+
+    for (int i = 0; i < n; i++) {
+        records[i] = ring->slots[(head + (uint64_t)i) & ring->mask];
+    }
+    __atomic_store_n(&ring->head, head + (uint64_t)n, __ATOMIC_RELEASE);
+    return n;
+}
+
+static void ring_close(StreamRing* ring) {
+    __atomic_store_n(&ring->closed, 1, __ATOMIC_RELEASE);
+}
+
+static int ring_closed(StreamRing* ring) {
+    return __atomic_load_n(&ring->closed, __ATOMIC_ACQUIRE);
+}
+
+/* Back off a little more each idle round; returns the next round */
+static int idle_wait(int round) {
+    if (round >= IDLE_SPINS + IDLE_YIELDS) {
+        struct timespec pause = {0, IDLE_SLEEP_NS};
+        nanosleep(&pause, NULL);
+    } else if (round >= IDLE_SPINS) {
+        sched_yield();
+    }
+    return round + 1;
+}
+
+/* ---- Pending tables ---- */
+
+static uint64_t hash_bytes(uint64_t hash, const void* data, size_t size) {
+    const unsigned char* bytes = data;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+/* Hash of a ticker and expiry, the key of a chain */
+static uint64_t chain_hash(const char* ticker, double T) {
+    uint64_t hash = hash_bytes(14695981039346656037ULL, ticker, strlen(ticker));
+    return hash_bytes(hash, &T, sizeof(T));
+}
+
+/* Quotes are keyed by instrument, fits by chain */
+static uint64_t record_hash(const StreamRecord* record) {
+    const StreamEvent* event = &record->event;
+    uint64_t hash = chain_hash(event->quote.ticker, event->quote.T);
+    if (event->type == STREAM_EVENT_FIT) {
+        return hash;
+    }
+    int type = (int)event->quote.type;
+    hash = hash_bytes(hash, &type, sizeof(type));
+    return hash_bytes(hash, &event->quote.K, sizeof(event->quote.K));
+}
+
+static int same_instrument(const StreamRecord* a, const StreamRecord* b) {
+    const StreamEvent* x = &a->event;
+    const StreamEvent* y = &b->event;
+
+    if (x->type != y->type || x->quote.T != y->quote.T || strcmp(x->quote.ticker, y->quote.ticker) != 0) {
+        return 0;
+    }
+    return x->type == STREAM_EVENT_FIT || (x->quote.type == y->quote.type && x->quote.K == y->quote.K);
+}
+
+static void pending_free(PendingTable* table) {
+    free(table->items);
+    free(table->index);
+    memset(table, 0, sizeof(PendingTable));
+}
+
+static void pending_clear(PendingTable* table) {
+    table->head = 0;
+    table->count = 0;
+    table->index_used = 0;
+    if (table->index != NULL) {
+        memset(table->index, 0, (size_t)table->index_size * sizeof(int));
+    }
+}
+
+/* Move the records not yet handed on to the front and index them again */
+static int pending_rebuild(PendingTable* table) {
+    int live = table->count - table->head;
+    int size = table->index_size > 0 ? table->index_size : 64;
+
+    while (size < 4 * (live + 1)) {
+        size *= 2;
+    }
+    if (size != table->index_size) {
+        int* index = malloc((size_t)size * sizeof(int));
+        if (index == NULL) {
+            return -1;
+        }
+        free(table->index);
+        table->index = index;
+        table->index_size = size;
+    }
+
+    memmove(table->items, table->items + table->head, (size_t)live * sizeof(StreamRecord));
+    table->head = 0;
+    table->count = live;
+    table->index_used = 0;
+    memset(table->index, 0, (size_t)table->index_size * sizeof(int));
+
+    for (int i = 0; i < live; i++) {
+        uint64_t slot = record_hash(&table->items[i]) & (uint64_t)(table->index_size - 1);
+        while (table->index[slot] != 0) {
+            slot = (slot + 1) & (uint64_t)(table->index_size - 1);
+        }
+        table->index[slot] = i + 1;
+        table->index_used++;
+    }
+    return 0;
+}
+
+/*
+ * Add a record, replacing a waiting one of the same instrument. Returns 1 if
+ * a record was replaced, 0 if it was added, -1 on allocation failure.
+ */
+static int pending_put(PendingTable* table, const StreamRecord* record) {
+    if (table->count == table->capacity || 2 * (table->index_used + 1) > table->index_size) {
+        if (table->count == table->capacity && table->head == 0) {
+            int capacity = table->capacity > 0 ? table->capacity * 2 : STAGE_BATCH;
+            StreamRecord* items = realloc(table->items, (size_t)capacity * sizeof(StreamRecord));
+            if (items == NULL) {
+                return -1;
+            }
+            table->items = items;
+            table->capacity = capacity;
+        }
+        if (pending_rebuild(table) != 0) {
+            return -1;
+        }
+    }
+
+    uint64_t mask = (uint64_t)(table->index_size - 1);
+    uint64_t slot = record_hash(record) & mask;
+    while (table->index[slot] != 0) {
+        int position = table->index[slot] - 1;
+        if (position >= table->head && same_instrument(&table->items[position], record)) {
+            table->items[position] = *record;
+            return 1;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    table->items[table->count] = *record;
+    table->index[slot] = ++table->count;
+    table->index_used++;
+    return 0;
+}
+
+static int pending_empty(const PendingTable* table) {
+    return table->head == table->count;
+}
+
+/* Hand on as many waiting records as the ring takes; returns the number */
+static int pending_flush(PendingTable* table, StreamRing* ring, StageCounters* counters) {
+    int moved = 0;
+
+    if (pending_empty(table)) {
+        return 0;
+    }
+
+    uint64_t now = perf_now_ns();
+    while (table->head < table->count) {
+        StreamRecord* record = &table->items[table->head];
+        uint64_t entered = record->entered_ns;
+        record->entered_ns = now;
+        if (!ring_try_push(ring, record)) {
+            record->entered_ns = entered;
+            break;
+        }
+        count_latency(counters, now - entered);
+        table->head++;
+        moved++;
+    }
+    count_records(counters, (uint64_t)moved);
+
+    if (pending_empty(table)) {
+        pending_clear(table);
+    }
+    return moved;
+}
+
+/* ---- Stages ---- */
+
+/*
+ * Take a batch off a ring into 'work', dropping older ticks of the same
+ * instrument. Returns the number of records taken, or -1 on allocation failure.
+ */
+static int take_batch(StreamRing* ring, PendingTable* work, StageCounters* counters) {
+    StreamRecord batch[STAGE_BATCH];
+    int n = ring_pop(ring, batch, STAGE_BATCH);
+    uint64_t coalesced = 0;
+
+    for (int i = 0; i < n; i++) {
+        int replaced = pending_put(work, &batch[i]);
+        if (replaced < 0) {
+            return -1;
+        }
+        coalesced += (uint64_t)replaced;
+    }
+    count_coalesced(counters, coalesced);
+    return n;
+}
+
+/* Queue the processed records of 'work' for the next stage */
+static int queue_batch(PendingTable* work, PendingTable* out, StageCounters* counters) {
+    uint64_t coalesced = 0;
+
+    for (int i = work->head; i < work->count; i++) {
+        int replaced = pending_put(out, &work->items[i]);
+        if (replaced < 0) {
+            return -1;
+        }
+        coalesced += (uint64_t)replaced;
+    }
+    count_coalesced(counters, coalesced);
+    pending_clear(work);
+    return 0;
+}
+
+static void solve_ivs(PendingTable* work) {
+    double price[STAGE_BATCH], S[STAGE_BATCH], K[STAGE_BATCH], T[STAGE_BATCH];
+    double r[STAGE_BATCH], q[STAGE_BATCH], iv[STAGE_BATCH];
+    OptionType type[STAGE_BATCH];
+    IVStatus status[STAGE_BATCH];
+    int n = work->count - work->head;
+
+    for (int i = 0; i < n; i++) {
+        const StreamQuote* quote = &work->items[work->head + i].event.quote;
+        price[i] = quote->price;
+        S[i] = quote->S;
+        K[i] = quote->K;
+        T[i] = quote->T;
+        r[i] = quote->r;
+        q[i] = quote->q;
+        type[i] = quote->type;
+    }
+
+    IVBatchInput in = {price, S, K, T, r, q, type};
+    if (n > 0 && bs_implied_vol_batch(n, &in, iv, status) < 0) {
+        for (int i = 0; i < n; i++) {
+            iv[i] = -1.0;
+            status[i] = IV_INVALID_INPUT;
+        }
+    }
+
+    for (int i = 0; i < n; i++) {
+        StreamEvent* event = &work->items[work->head + i].event;
+        event->iv = iv[i];
+        event->iv_status = status[i];
+    }
+}
+
+static StreamChain* find_chain(FitBook* book, const StreamQuote* quote, QuoteStream* stream) {
+    uint64_t hash = chain_hash(quote->ticker, quote->T);
+
+    if (book->index_size > 0) {
+        uint64_t mask = (uint64_t)(book->index_size - 1);
+        for (uint64_t slot = hash & mask; book->index[slot] != 0; slot = (slot + 1) & mask) {
+            StreamChain* chain = book->chains[book->index[slot] - 1];
+            if (chain->T == quote->T && strcmp(chain->ticker, quote->ticker) == 0) {
+                return chain;
+            }
+        }
+    }
+
+    if (book->count == book->capacity) {
+        int capacity = book->capacity > 0 ? book->capacity * 2 : 64;
+        StreamChain** chains = realloc(book->chains, (size_t)capacity * sizeof(StreamChain*));
+        int* index = calloc((size_t)capacity * 2, sizeof(int));
+        if (chains == NULL || index == NULL) {
+            if (chains != NULL) {
+                book->chains = chains;
+            }
+            free(index);
+            return NULL;
+        }
+        book->chains = chains;
+        book->capacity = capacity;
+        free(book->index);
+        book->index = index;
+        book->index_size = capacity * 2;
+        for (int i = 0; i < book->count; i++) {
+            uint64_t slot = chain_hash(chains[i]->ticker, chains[i]->T) & (uint64_t)(book->index_size - 1);
+            while (book->index[slot] != 0) {
+                slot = (slot + 1) & (uint64_t)(book->index_size - 1);
+            }
+            book->index[slot] = i + 1;
+        }
+    }
+
+    StreamChain* chain = calloc(1, sizeof(StreamChain));
+    if (chain == NULL) {
+        return NULL;
+    }
+    memcpy(chain->ticker, quote->ticker, sizeof(chain->ticker));
+    chain->T = quote->T;
+
+    uint64_t mask = (uint64_t)(book->index_size - 1);
+    uint64_t slot = hash & mask;
+    while (book->index[slot] != 0) {
+        slot = (slot + 1) & mask;
+    }
+    book->chains[book->count] = chain;
+    book->index[slot] = ++book->count;
+    __atomic_store_n(&stream->chains, book->count, __ATOMIC_RELAXED);
+    return chain;
+}
+
+/* Record the latest quote of a strike; returns -1 on allocation failure */
+static int update_book(StreamChain* chain, const StreamRecord* record) {
+    const StreamEvent* event = &record->event;
+    BookEntry* entry = NULL;
+
+    for (int i = 0; i < chain->count; i++) {
+        if (chain->entries[i].K == event->quote.K && chain->entries[i].type == event->quote.type) {
+            entry = &chain->entries[i];
+            break;
+        }
+    }
+    if (entry == NULL) {
+        if (chain->count == chain->capacity) {
+            int capacity = chain->capacity > 0 ? chain->capacity * 2 : 32;
+            BookEntry* entries = realloc(chain->entries, (size_t)capacity * sizeof(BookEntry));
+            if (entries == NULL) {
+                return -1;
+            }
+            chain->entries = entries;
+            chain->capacity = capacity;
+        }
+        entry = &chain->entries[chain->count++];
+        entry->type = event->quote.type;
+        entry->K = event->quote.K;
+    }
+
+    entry->S = event->quote.S;
+    entry->iv = event->iv_status == IV_OK ? event->iv : -1.0;
+    chain->S = event->quote.S;
+    chain->r = event->quote.r;
+    chain->q = event->quote.q;
+    chain->newest_pushed_ns = record->pushed_ns;
+    chain->dirty = 1;
+    return 0;
+}
+
+static void model_price(FitBook* book, const StreamChain* chain, StreamEvent* event) {
+    const StreamQuote* quote = &event->quote;
+    double call;
+
+    event->model_price = -1.0;
+    event->model_iv = -1.0;
+    if (!chain->fitted ||
+        heston_fft_context_price_grid(book->ctx, quote->S, quote->T, quote->r, quote->q,
+                                      &chain->params, &quote->K, 1, &call) != 0) {
+        return;
+    }
+
+    event->model_price = quote->type == OPTION_PUT
+        ? call - quote->S * exp(-quote->q * quote->T) + quote->K * exp(-quote->r * quote->T)
+        : call;
+    event->model_iv = bs_implied_vol(call, quote->S, quote->K, quote->T, quote->r, quote->q);
+}
+
+/*
+ * Snapshot one chain's latest quotes into the job, each moved to the
+ * chain's newest spot at the same moneyness and implied volatility so the
+ * whole chain shares one transform batch. Heston prices are homogeneous in
+ * spot and strike, so this does not change the fit. Returns 1 if the chain has enough quotes to
+ * calibrate, 0 if not, -1 on allocation failure.
+ */
+static int prepare_job(QuoteStream* stream, CalibrationJob* job, StreamChain* chain) {
+    const QuoteStreamOptions* options = &stream->options;
+    int n = 0;
+
+    chain->dirty = 0;
+    chain->fit_ns = perf_now_ns();
+
+    if (job->capacity < chain->count) {
+        HestonQuote* quotes = realloc(job->quotes, (size_t)chain->count * sizeof(HestonQuote));
+        if (quotes == NULL) {
+            return -1;
+        }
+        job->quotes = quotes;
+        job->capacity = chain->count;
+    }
+
+    for (int i = 0; i < chain->count; i++) {
+        const BookEntry* entry = &chain->entries[i];
+        if (entry->iv <= 0.0) {
+            continue;
+        }
+        double K = entry->K * chain->S / entry->S;
+        double price = black_scholes_call(chain->S, K, chain->T, chain->r, chain->q, entry->iv);
+        if (!(price > 0.0)) {
+            continue;
+        }
+        HestonQuote* quote = &job->quotes[n++];
+        quote->S = chain->S;
+        quote->K = K;
+        quote->T = chain->T;
+        quote->r = chain->r;
+        quote->q = chain->q;
+        quote->price = price;
+        quote->weight = 0.0;
+    }
+    if (n < options->min_fit_quotes) {
+        return 0;
+    }
+
+    job->chain = chain;
+    job->n = n;
+    job->seeded = chain->fitted;
+    job->initial = chain->params;
+    job->options = options->calibration;
+    if (chain->fitted) {
+        job->options.max_iterations = options->refit_iterations;
+    }
+    job->S = chain->S;
+    job->r = chain->r;
+    job->q = chain->q;
+    job->pushed_ns = chain->newest_pushed_ns;
+    job->submitted_ns = chain->fit_ns;
+    return 1;
+}
+
+static void run_job(CalibrationJob* job) {
+    job->status = heston_calibrate(job->quotes, job->n, job->seeded ? &job->initial : NULL,
+                                   &job->options, &job->result);
+}
+
+/* Helper thread of the fit stage: run each submitted calibration */
+static void* calibration_thread(void* arg) {
+    CalibrationJob* job = arg;
+    int idle = 0;
+
+    for (;;) {
+        if (__atomic_load_n(&job->state, __ATOMIC_ACQUIRE) == JOB_SUBMITTED) {
+            run_job(job);
+            __atomic_store_n(&job->state, JOB_DONE, __ATOMIC_RELEASE);
+            idle = 0;
+        } else if (__atomic_load_n(&job->stop, __ATOMIC_ACQUIRE)) {
+            break;
+        } else {
+            idle = idle_wait(idle);
+        }
+    }
+    return NULL;
+}
+
+/* Adopt a finished calibration and queue its fit event; -1 on allocation failure */
+static int finish_job(QuoteStream* stream, CalibrationJob* job, PendingTable* out) {
+    StreamChain* chain = job->chain;
+    StreamRecord fit;
+
+    if (job->status != ERROR_NONE) {
+        __atomic_fetch_add(&stream->fit_failures, 1, __ATOMIC_RELAXED);
+        return 0;
+    }
+    __atomic_fetch_add(&stream->fits, 1, __ATOMIC_RELAXED);
+    chain->params = job->result.params;
+    chain->fitted = 1;
+
+    memset(&fit, 0, sizeof(fit));
+    fit.event.type = STREAM_EVENT_FIT;
+    memcpy(fit.event.quote.ticker, chain->ticker, sizeof(chain->ticker));
+    fit.event.quote.S = job->S;
+    fit.event.quote.T = chain->T;
+    fit.event.quote.r = job->r;
+    fit.event.quote.q = job->q;
+    fit.event.iv = -1.0;
+    fit.event.iv_status = IV_OK;
+    fit.event.model_price = -1.0;
+    fit.event.model_iv = -1.0;
+    fit.event.fit = job->result;
+    fit.event.fit_quotes = job->n;
+    fit.pushed_ns = job->pushed_ns;
+    fit.entered_ns = job->submitted_ns;
+
+    int replaced = pending_put(out, &fit);
+    if (replaced < 0) {
+        return -1;
+    }
+    count_coalesced(&stream->counters[QUOTE_STREAM_FIT], (uint64_t)replaced);
+    return 0;
+}
+
+/*
+ * Collect a finished calibration, then start one of the next changed chain
+ * whose refit interval has passed (any changed chain when draining), on the
+ * helper thread or, without one, right here. Returns 1 if anything was done,
+ * 0 if not, -1 on allocation failure.
+ */
+static int fit_step(QuoteStream* stream, FitBook* book, PendingTable* out, int draining) {
+    CalibrationJob* job = &book->job;
+    int state = __atomic_load_n(&job->state, __ATOMIC_ACQUIRE);
+    int done = 0;
+
+    if (state == JOB_DONE) {
+        if (finish_job(stream, job, out) != 0) {
+            return -1;
+        }
+        __atomic_store_n(&job->state, JOB_IDLE, __ATOMIC_RELAXED);
+        done = 1;
+    } else if (state == JOB_SUBMITTED) {
+        return 0;
+    }
+
+    uint64_t interval_ns = (uint64_t)(stream->options.refit_interval * 1e9);
+    uint64_t now = perf_now_ns();
+
+    for (int i = 0; i < book->count; i++) {
+        int position = (book->cursor + i) % book->count;
+        StreamChain* chain = book->chains[position];
+        if (!chain->dirty || (!draining && chain->fitted && now - chain->fit_ns < interval_ns)) {
+            continue;
+        }
+
+        book->cursor = (position + 1) % book->count;
+        int status = prepare_job(stream, job, chain);
+        if (status < 0) {
+            return -1;
+        }
+        if (status > 0) {
+            if (book->helper_running) {
+                __atomic_store_n(&job->state, JOB_SUBMITTED, __ATOMIC_RELEASE);
+            } else {
+                run_job(job);
+                if (finish_job(stream, job, out) != 0) {
+                    return -1;
+                }
+            }
+        }
+        return 1;
+    }
+    return done;
+}
+
+static int fit_busy(FitBook* book) {
+    return __atomic_load_n(&book->job.state, __ATOMIC_ACQUIRE) != JOB_IDLE;
+}
+
+static int apply_batch(QuoteStream* stream, FitBook* book, PendingTable* work) {
+    for (int i = work->head; i < work->count; i++) {
+        StreamRecord* record = &work->items[i];
+        StreamChain* chain = find_chain(book, &record->event.quote, stream);
+        if (chain == NULL || update_book(chain, record) != 0) {
+            return -1;
+        }
+        model_price(book, chain, &record->event);
+    }
+    return 0;
+}
+
+static void fit_book_free(FitBook* book) {
+    if (book->helper_running) {
+        __atomic_store_n(&book->job.stop, 1, __ATOMIC_RELEASE);
+        pthread_join(book->helper, NULL);
+    }
+    for (int i = 0; i < book->count; i++) {
+        free(book->chains[i]->entries);
+        free(book->chains[i]);
+    }
+    free(book->chains);
+    free(book->index);
+    free(book->job.quotes);
+    heston_fft_context_destroy(book->ctx);
+}
+
+static void publish_batch(QuoteStream* stream, PendingTable* work) {
+    StageCounters* counters = &stream->counters[QUOTE_STREAM_PUBLISH];
+
+    for (int i = work->head; i < work->count; i++) {
+        StreamRecord* record = &work->items[i];
+        uint64_t now = perf_now_ns();
+        record->event.latency_ns = now - record->pushed_ns;
+        if (stream->options.publish != NULL) {
+            stream->options.publish(&record->event, stream->options.user);
+        }
+        uint64_t done = perf_now_ns();
+        count_latency(counters, done - record->entered_ns);
+        if (record->event.type == STREAM_EVENT_QUOTE) {
+            count_latency(&stream->end_to_end, now - record->pushed_ns);
+        }
+    }
+    count_records(counters, (uint64_t)(work->count - work->head));
+    pending_clear(work);
+}
+
+/*
+ * One stage thread: take batches off the input ring, process them and
+ * hand them on, until the input is closed and everything is handed on.
+ */
+static void* stage_thread(void* arg) {
+    StageThread* thread = arg;
+    QuoteStream* stream = thread->stream;
+    QuoteStreamStage stage = thread->stage;
+    StreamRing* in = &stream->rings[stage - 1];
+    StreamRing* next = stage < QUOTE_STREAM_PUBLISH ? &stream->rings[stage] : NULL;
+    StageCounters* counters = &stream->counters[stage];
+    PendingTable work, out;
+    FitBook book;
+    int idle = 0;
+    int failed = 0;
+
+    free(thread);
+    memset(&work, 0, sizeof(work));
+    memset(&out, 0, sizeof(out));
+    memset(&book, 0, sizeof(book));
+    if (stage == QUOTE_STREAM_FIT) {
+        book.ctx = heston_fft_context_create();
+        failed = book.ctx == NULL;
+        book.helper_running = pthread_create(&book.helper, NULL, calibration_thread, &book.job) == 0;
+    }
+
+    for (;;) {
+        int closed = ring_closed(in);
+        int taken = take_batch(in, &work, counters);
+        int progress = taken > 0;
+
+        if (taken < 0) {
+            failed = 1;
+        }
+        if (!pending_empty(&work)) {
+            if (stage == QUOTE_STREAM_IV) {
+                solve_ivs(&work);
+            } else if (stage == QUOTE_STREAM_FIT) {
+                failed |= apply_batch(stream, &book, &work) != 0;
+            }
+            if (stage == QUOTE_STREAM_PUBLISH) {
+                publish_batch(stream, &work);
+            } else {
+                failed |= queue_batch(&work, &out, counters) != 0;
+            }
+        }
+
+        /* Calibrations run beside the quotes, one chain at a time */
+        int drained = closed && taken == 0;
+        if (stage == QUOTE_STREAM_FIT && !failed) {
+            int status = fit_step(stream, &book, &out, drained);
+            failed |= status < 0;
+            progress |= status > 0;
+        }
+
+        if (next != NULL) {
+            progress |= pending_flush(&out, next, counters) > 0;
+        }
+
+        if (failed) {
+            /* Out of memory: stop and let the later stages drain */
+            fprintf(stderr, "Error: Quote stream %s stage out of memory, stopping it\n",
+                    quote_stream_stage_name(stage));
+            break;
+        }
+        if (drained && pending_empty(&out) && !progress &&
+            !(stage == QUOTE_STREAM_FIT && fit_busy(&book))) {
+            break;
+        }
+        idle = progress ? 0 : idle_wait(idle);
+    }
+
+    if (next != NULL) {
+        ring_close(next);
+    }
+    /* Keep consuming a failed stage's input so the earlier stages can finish */
+    while (failed) {
+        StreamRecord discard[STAGE_BATCH];
+        int closed = ring_closed(in);
+        if (ring_pop(in, discard, STAGE_BATCH) == 0 && closed) {
+            break;
+        }
+        idle = idle_wait(idle);
+    }
+
+    pending_free(&work);
+    pending_free(&out);
+    if (stage == QUOTE_STREAM_FIT) {
+        fit_book_free(&book);
+    }
+    return NULL;
+}
+
+/* ---- Public interface ---- */
+
+static void stream_free(QuoteStream* stream) {
+    for (int i = 0; i < QUOTE_STREAM_STAGE_COUNT - 1; i++) {
+        free(stream->rings[i].slots);
+    }
+    pending_free(&stream->ingest);
+    free(stream);
+}
+
+QuoteStream* quote_stream_start(const QuoteStreamOptions* options) {
+    QuoteStreamOptions defaults;
+
+    if (options == NULL) {
+        quote_stream_default_options(&defaults);
+        options = &defaults;
+    }
+    if (options->capacity <= 0 || options->capacity > (1 << 24) || options->min_fit_quotes < 1 ||
+        options->refit_iterations < 1 || !(options->refit_interval >= 0.0)) {
+        return NULL;
+    }
+
+    uint64_t capacity = 1;
+    while (capacity < (uint64_t)options->capacity) {
+        capacity *= 2;
+    }
+
+    QuoteStream* stream = calloc(1, sizeof(QuoteStream));
+    if (stream == NULL) {
+        return NULL;
+    }
+    stream->options = *options;
+    for (int i = 0; i < QUOTE_STREAM_STAGE_COUNT - 1; i++) {
+        if (ring_init(&stream->rings[i], capacity) != 0) {
+            stream_free(stream);
+            return NULL;
+        }
+    }
+
+    int started = 0;
+    for (int stage = QUOTE_STREAM_IV; stage < QUOTE_STREAM_STAGE_COUNT; stage++) {
+        StageThread* thread = malloc(sizeof(StageThread));
+        if (thread == NULL) {
+            break;
+        }
+        thread->stream = stream;
+        thread->stage = (QuoteStreamStage)stage;
+        if (pthread_create(&stream->threads[started], NULL, stage_thread, thread) != 0) {
+            free(thread);
+            break;
+        }
+        started++;
+    }
+
+    if (started < QUOTE_STREAM_STAGE_COUNT - 1) {
+        /* Close the chain of rings up to the last running stage */
+        for (int i = 0; i < QUOTE_STREAM_STAGE_COUNT - 1; i++) {
+            ring_close(&stream->rings[i]);
+        }
+        for (int i = 0; i < started; i++) {
+            pthread_join(stream->threads[i], NULL);
+        }
+        stream_free(stream);
+        return NULL;
+    }
+    return stream;
+}
+
+int quote_stream_push(QuoteStream* stream, const StreamQuote* quote) {
+    if (stream == NULL || quote == NULL ||
+        memchr(quote->ticker, '\0', sizeof(quote->ticker)) == NULL || quote->ticker[0] == '\0' ||
+        (quote->type != OPTION_CALL && quote->type != OPTION_PUT) ||
+        !(quote->S > 0.0) || !(quote->K > 0.0) || !(quote->T > 0.0) ||
+        !isfinite(quote->S) || !isfinite(quote->K) || !isfinite(quote->T) ||
+        !isfinite(quote->r) || !isfinite(quote->q) || !isfinite(quote->price)) {
+        return -1;
+    }
+
+    StreamRecord record;
+    memset(&record, 0, sizeof(record));
+    record.event.type = STREAM_EVENT_QUOTE;
+    record.event.quote = *quote;
+    record.event.iv = -1.0;
+    record.event.model_price = -1.0;
+    record.event.model_iv = -1.0;
+    record.pushed_ns = perf_now_ns();
+    record.entered_ns = record.pushed_ns;
+
+    StageCounters* counters = &stream->counters[QUOTE_STREAM_INGEST];
+    StreamRing* ring = &stream->rings[0];
+
+    /* Keep arrival order: only go straight to the ring when nothing waits */
+    pending_flush(&stream->ingest, ring, counters);
+    if (pending_empty(&stream->ingest) && ring_try_push(ring, &record)) {
+        count_records(counters, 1);
+        count_latency(counters, 0);
+        return 0;
+    }
+
+    int replaced = pending_put(&stream->ingest, &record);
+    if (replaced < 0) {
+        return -1;
+    }
+    count_coalesced(counters, (uint64_t)replaced);
+    return 0;
+}
+
+void quote_stream_close(QuoteStream* stream, QuoteStreamStats* stats) {
+    if (stream == NULL) {
+        return;
+    }
+
+    StageCounters* counters = &stream->counters[QUOTE_STREAM_INGEST];
+    int idle = 0;
+    while (!pending_empty(&stream->ingest)) {
+        idle = pending_flush(&stream->ingest, &stream->rings[0], counters) > 0 ? 0 : idle_wait(idle);
+    }
+    ring_close(&stream->rings[0]);
+
+    for (int i = 0; i < QUOTE_STREAM_STAGE_COUNT - 1; i++) {
+        pthread_join(stream->threads[i], NULL);
+    }
+    quote_stream_stats(stream, stats);
+    stream_free(stream);
+}
@@ -0,0 +1,176 @@
+/**
+ * rolling_volatility.c
+ * Rolling close-to-close volatilities with persisted Welford state
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "../include/rolling_volatility.h"
+
+#define RV_STATE_MAGIC "RVSTATE\0"
+#define RV_STATE_VERSION 1
+
+static const int windows[RV_WINDOW_COUNT] = RV_WINDOWS;
+
+// Saved with the state: a different window set invalidates it
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t window_count;
+    int32_t windows[RV_WINDOW_COUNT];
+} StateFileHeader;
+
+static void window_add(RVWindow* w, double x) {
+    w->n++;
+    double delta = x - w->mean;
+    w->mean += delta / w->n;
+    w->m2 += delta * (x - w->mean);
+}
+
+static void window_remove(RVWindow* w, double x) {
+    w->n--;
+    if (w->n == 0) {
+        w->mean = 0.0;
+        w->m2 = 0.0;
+        return;
+    }
+    double delta = x - w->mean;
+    w->mean -= delta / w->n;
+    w->m2 -= delta * (x - w->mean);
+    if (w->m2 < 0.0) {
+        w->m2 = 0.0;  // Rounding after many updates
+    }
+}
+
+static double log_return(const double* close, int i) {
+    return log(close[i] / close[i - 1]);
+}
+
+void rv_state_init(RollingVolState* state) {
+    memset(state, 0, sizeof(*state));
+}
+
+int rv_state_load(const char* path, RollingVolState* state) {
+    rv_state_init(state);
+    if (path == NULL) {
+        return -1;
+    }
+
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        return -1;
+    }
+
+    StateFileHeader header;
+    RollingVolState loaded;
+    int ok = fread(&header, sizeof(header), 1, file) == 1 &&
+             fread(&loaded, sizeof(loaded), 1, file) == 1;
+    fclose(file);
+
+    ok = ok && memcmp(header.magic, RV_STATE_MAGIC, sizeof(header.magic)) == 0 &&
+         header.version == RV_STATE_VERSION && header.window_count == RV_WINDOW_COUNT &&
+         memcmp(header.windows, windows, sizeof(windows)) == 0;
+    if (!ok) {
+        return -1;
+    }
+
+    *state = loaded;
+    return 0;
+}
+
+int rv_state_save(const char* path, const RollingVolState* state) {
+    if (path == NULL || state == NULL) {
+        return -1;
+    }
+
+    size_t len = strlen(path);
+    char* tmp_path = malloc(len + 5);
+    if (tmp_path == NULL) {
+        return -1;
+    }
+    memcpy(tmp_path, path, len);
+    memcpy(tmp_path + len, ".tmp", 5);
+
+    StateFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, RV_STATE_MAGIC, sizeof(header.magic));
+    header.version = RV_STATE_VERSION;
+    header.window_count = RV_WINDOW_COUNT;
+    memcpy(header.windows, windows, sizeof(windows));
+
+    FILE* file = fopen(tmp_path, "wb");
+    int ok = file != NULL;
+    if (ok) {
+        ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+             fwrite(state, sizeof(*state), 1, file) == 1;
+        ok = fclose(file) == 0 && ok;
+    }
+    ok = ok && rename(tmp_path, path) == 0;
+
+    if (!ok) {
+        remove(tmp_path);
+    }
+    free(tmp_path);
+    return ok ? 0 : -1;
+}
+
+int rv_update(RollingVolState* state, const TimeSeriesView* view) {
+    if (state == NULL || view == NULL) {
+        return 0;
+    }
+
+    // The state continues the store only if its last bar is still in place
+    int last = state->bars - 1;
+    int continues = state->bars > 0 && state->generation == view->generation &&
+                    state->bars <= view->count && view->date[last] == state->last_date &&
+                    view->close[last] == state->last_close;
+    if (!continues) {
+        rv_state_init(state);
+        state->generation = view->generation;
+    }
+
+    int first = state->bars;
+    if (first >= view->count) {
+        return 0;
+    }
+
+    // Each bar adds its return to every window and drops the one leaving it
+    for (int i = first > 0 ? first : 1; i < view->count; i++) {
+        double r = log_return(view->close, i);
+        for (int k = 0; k < RV_WINDOW_COUNT; k++) {
+            window_add(&state->window[k], r);
+            if (state->window[k].n > windows[k]) {
+                window_remove(&state->window[k], log_return(view->close, i - windows[k]));
+            }
+        }
+    }
+
+    state->bars = view->count;
+    state->last_date = view->date[view->count - 1];
+    state->last_close = view->close[view->count - 1];
+    return view->count - first;
+}
+
+int rv_window_index(int period_days) {
+    for (int k = 0; k < RV_WINDOW_COUNT; k++) {
+        if (windows[k] == period_days) {
+            return k;
+        }
+    }
+    return -1;
+}
+
+double rv_volatility(const RollingVolState* state, int period_days) {
+    int k = rv_window_index(period_days);
+    if (state == NULL || k < 0 || state->window[k].n < 2) {
+        return -1.0;
+    }
+
+    const RVWindow* w = &state->window[k];
+    return sqrt(w->m2 / (w->n - 1) * 252.0);  // 252 trading days in a year
+}
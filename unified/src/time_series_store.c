@@ -0,0 +1,418 @@
+/**
+ * time_series_store.c
+ * Memory-mapped columnar store for daily price bars
+ *
+ * File layout: a 64-byte header, then capacity dates (int32) and capacity
+ * values for each of open, high, low, close and volume (double). The
+ * capacity is a multiple of 16, so every column starts on a 64-byte
+ * boundary. Only the first count entries of each column are valid: an
+ * in-place append writes the new column entries first and the count last.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../include/time_series_store.h"
+
+#define STORE_HEADER_SIZE 64
+#define STORE_VALUE_COLUMNS 5
+#define MIN_CAPACITY 256
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t generation;
+    uint64_t count;
+    uint64_t capacity;
+    char padding[STORE_HEADER_SIZE - 32];
+} StoreHeader;
+
+static size_t store_size(uint64_t capacity) {
+    return STORE_HEADER_SIZE + capacity * (sizeof(int32_t) + STORE_VALUE_COLUMNS * sizeof(double));
+}
+
+static off_t date_offset(uint64_t index) {
+    return (off_t)(STORE_HEADER_SIZE + index * sizeof(int32_t));
+}
+
+static off_t value_offset(uint64_t capacity, int column, uint64_t index) {
+    return (off_t)(STORE_HEADER_SIZE + capacity * sizeof(int32_t) +
+                   ((uint64_t)column * capacity + index) * sizeof(double));
+}
+
+// Room for the bars and as many again, so daily appends rarely rewrite the file
+static uint64_t capacity_for(uint64_t count) {
+    uint64_t capacity = 2 * count;
+    if (capacity < MIN_CAPACITY) {
+        capacity = MIN_CAPACITY;
+    }
+    return (capacity + 15) & ~(uint64_t)15;
+}
+
+static double bar_value(const TSBar* bar, int column) {
+    switch (column) {
+        case 0: return bar->open;
+        case 1: return bar->high;
+        case 2: return bar->low;
+        case 3: return bar->close;
+        default: return bar->volume;
+    }
+}
+
+static int write_all(int fd, const void* data, size_t size, off_t offset) {
+    const char* p = data;
+    while (size > 0) {
+        ssize_t written = pwrite(fd, p, size, offset);
+        if (written < 0) {
+            return -1;
+        }
+        p += written;
+        size -= (size_t)written;
+        offset += written;
+    }
+    return 0;
+}
+
+// Write n bars into the columns, starting at entry index
+static int write_columns(int fd, uint64_t capacity, uint64_t index, const TSBar* bars, int n) {
+    double* values = malloc((size_t)n * sizeof(double));
+    int32_t* dates = malloc((size_t)n * sizeof(int32_t));
+    int ok = values != NULL && dates != NULL;
+    int i, c;
+
+    if (ok) {
+        for (i = 0; i < n; i++) {
+            dates[i] = bars[i].date;
+        }
+        ok = write_all(fd, dates, (size_t)n * sizeof(int32_t), date_offset(index)) == 0;
+    }
+    for (c = 0; ok && c < STORE_VALUE_COLUMNS; c++) {
+        for (i = 0; i < n; i++) {
+            values[i] = bar_value(&bars[i], c);
+        }
+        ok = write_all(fd, values, (size_t)n * sizeof(double), value_offset(capacity, c, index)) == 0;
+    }
+
+    free(values);
+    free(dates);
+    return ok ? 0 : -1;
+}
+
+// Write a complete store next to path and move it into place
+static int write_store(const char* path, const TSBar* bars, int count, uint32_t generation) {
+    size_t len = strlen(path);
+    char* tmp_path = malloc(len + 5);
+    if (tmp_path == NULL) {
+        return -1;
+    }
+    memcpy(tmp_path, path, len);
+    memcpy(tmp_path + len, ".tmp", 5);
+
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        free(tmp_path);
+        return -1;
+    }
+
+    StoreHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TS_STORE_MAGIC, sizeof(header.magic));
+    header.version = TS_STORE_VERSION;
+    header.generation = generation;
+    header.count = (uint64_t)count;
+    header.capacity = capacity_for((uint64_t)count);
+
+    int ok = ftruncate(fd, (off_t)store_size(header.capacity)) == 0 &&
+             write_columns(fd, header.capacity, 0, bars, count) == 0 &&
+             write_all(fd, &header, sizeof(header), 0) == 0 &&
+             fsync(fd) == 0;
+    ok = close(fd) == 0 && ok;
+    ok = ok && rename(tmp_path, path) == 0;
+
+    if (!ok) {
+        unlink(tmp_path);
+    }
+    free(tmp_path);
+    return ok ? 0 : -1;
+}
+
+// Serialize writers of one store through a lock file next to it
+static int lock_store(const char* path) {
+    size_t len = strlen(path);
+    char* lock_path = malloc(len + 6);
+    if (lock_path == NULL) {
+        return -1;
+    }
+    memcpy(lock_path, path, len);
+    memcpy(lock_path + len, ".lock", 6);
+
+    int fd = open(lock_path, O_RDWR | O_CREAT, 0644);
+    free(lock_path);
+    if (fd < 0) {
+        return -1;
+    }
+
+    struct flock lock;
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type = F_WRLCK;
+    lock.l_whence = SEEK_SET;
+    if (fcntl(fd, F_SETLKW, &lock) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int find_date(const TimeSeriesView* view, int32_t date) {
+    int lo = 0;
+    int hi = view->count - 1;
+    while (lo <= hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (view->date[mid] == date) {
+            return mid;
+        }
+        if (view->date[mid] < date) {
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return -1;
+}
+
+static int same_as_stored(const TimeSeriesView* view, int index, const TSBar* bar) {
+    return view->open[index] == bar->open && view->high[index] == bar->high &&
+           view->low[index] == bar->low && view->close[index] == bar->close &&
+           view->volume[index] == bar->volume;
+}
+
+// Merge stored and new bars (new ones win on equal dates) into a new store
+static int merge_store(const char* path, const TimeSeriesView* old, const TSBar* bars, int count,
+                       uint32_t generation) {
+    TSBar* merged = malloc(((size_t)old->count + (size_t)count) * sizeof(TSBar));
+    if (merged == NULL) {
+        return -1;
+    }
+
+    int i = 0, j = 0, n = 0;
+    while (i < old->count || j < count) {
+        if (j < count && (i >= old->count || bars[j].date <= old->date[i])) {
+            if (i < old->count && bars[j].date == old->date[i]) {
+                i++;
+            }
+            merged[n++] = bars[j++];
+        } else {
+            merged[n].date = old->date[i];
+            merged[n].open = old->open[i];
+            merged[n].high = old->high[i];
+            merged[n].low = old->low[i];
+            merged[n].close = old->close[i];
+            merged[n].volume = old->volume[i];
+            n++;
+            i++;
+        }
+    }
+
+    int ret = write_store(path, merged, n, generation);
+    free(merged);
+    return ret;
+}
+
+int ts_store_open(const char* path, TimeSeriesView* view) {
+    if (path == NULL || view == NULL) {
+        return -1;
+    }
+    memset(view, 0, sizeof(*view));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < STORE_HEADER_SIZE) {
+        close(fd);
+        return -1;
+    }
+
+    void* map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+
+    StoreHeader header;
+    memcpy(&header, map, sizeof(header));
+    if (memcmp(header.magic, TS_STORE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != TS_STORE_VERSION || header.capacity % 16 != 0 ||
+        header.count > header.capacity || header.count > (uint64_t)INT32_MAX ||
+        store_size(header.capacity) > (size_t)st.st_size) {
+        munmap(map, (size_t)st.st_size);
+        return -1;
+    }
+
+    const char* base = map;
+    view->count = (int)header.count;
+    view->generation = header.generation;
+    view->date = (const int32_t*)(const void*)(base + date_offset(0));
+    view->open = (const double*)(const void*)(base + value_offset(header.capacity, 0, 0));
+    view->high = (const double*)(const void*)(base + value_offset(header.capacity, 1, 0));
+    view->low = (const double*)(const void*)(base + value_offset(header.capacity, 2, 0));
+    view->close = (const double*)(const void*)(base + value_offset(header.capacity, 3, 0));
+    view->volume = (const double*)(const void*)(base + value_offset(header.capacity, 4, 0));
+    view->map = map;
+    view->map_size = (size_t)st.st_size;
+    return 0;
+}
+
+void ts_store_close(TimeSeriesView* view) {
+    if (view == NULL || view->map == NULL) {
+        return;
+    }
+    munmap(view->map, view->map_size);
+    memset(view, 0, sizeof(*view));
+}
+
+int ts_store_append(const char* path, TSBar* bars, int count) {
+    if (path == NULL || bars == NULL || count < 0) {
+        return -1;
+    }
+
+    count = ts_sort_bars(bars, count);
+    if (count == 0) {
+        return 0;
+    }
+
+    int lock_fd = lock_store(path);
+    if (lock_fd < 0) {
+        return -1;
+    }
+
+    TimeSeriesView old;
+    int ret;
+    if (ts_store_open(path, &old) != 0) {
+        ret = write_store(path, bars, count, 0);
+        close(lock_fd);
+        return ret;
+    }
+
+    // Bars up to the last stored date must already be stored unchanged for
+    // an in-place append; otherwise merge into a rewritten store
+    int first_new = 0;
+    int replaced = 0;
+    if (old.count > 0) {
+        int32_t last = old.date[old.count - 1];
+        while (first_new < count && bars[first_new].date <= last) {
+            int index = find_date(&old, bars[first_new].date);
+            if (index < 0 || !same_as_stored(&old, index, &bars[first_new])) {
+                replaced = 1;
+            }
+            first_new++;
+        }
+    }
+
+    StoreHeader header;
+    memcpy(&header, old.map, sizeof(header));
+    int added = count - first_new;
+    int grow = (uint64_t)old.count + (uint64_t)added > header.capacity;
+
+    if (replaced || grow) {
+        // Growing alone keeps the generation: the stored bars are the same
+        ret = merge_store(path, &old, bars, count, old.generation + (replaced ? 1 : 0));
+    } else {
+        int fd = open(path, O_WRONLY);
+        ret = fd < 0 ? -1 : 0;
+        if (ret == 0 && added > 0) {
+            header.count = (uint64_t)old.count + (uint64_t)added;
+            ret = write_columns(fd, header.capacity, (uint64_t)old.count, bars + first_new, added);
+            if (ret == 0) {
+                ret = write_all(fd, &header.count, sizeof(header.count),
+                                (off_t)offsetof(StoreHeader, count));
+            }
+        } else if (ret == 0) {
+            // Nothing new, but the store is now known to be current
+            ret = futimens(fd, NULL);
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    ts_store_close(&old);
+    close(lock_fd);
+    return ret;
+}
+
+static int compare_bars(const void* a, const void* b) {
+    int32_t da = ((const TSBar*)a)->date;
+    int32_t db = ((const TSBar*)b)->date;
+    return (da > db) - (da < db);
+}
+
+int ts_sort_bars(TSBar* bars, int count) {
+    if (bars == NULL || count <= 0) {
+        return 0;
+    }
+
+    qsort(bars, (size_t)count, sizeof(TSBar), compare_bars);
+
+    int n = 1;
+    for (int i = 1; i < count; i++) {
+        if (bars[i].date != bars[n - 1].date) {
+            bars[n++] = bars[i];
+        }
+    }
+    return n;
+}
+
+int32_t ts_parse_date(const char* text) {
+    int year, month, day;
+
+    if (text == NULL || sscanf(text, "%4d-%2d-%2d", &year, &month, &day) != 3) {
+        return -1;
+    }
+    if (year < 1800 || year > 9999 || month < 1 || month > 12 || day < 1 || day > 31) {
+        return -1;
+    }
+    return (int32_t)(year * 10000 + month * 100 + day);
+}
+
+void ts_format_date(int32_t date, char* buffer) {
+    unsigned value = date > 0 ? (unsigned)date : 0u;
+    snprintf(buffer, 11, "%04u-%02u-%02u", value / 10000 % 10000, value / 100 % 100, value % 100);
+}
+
+double ts_historical_volatility(const double* close, int count, int period_days) {
+    if (close == NULL || period_days <= 0) {
+        return -1.0;
+    }
+
+    int n = count - 1 < period_days ? count - 1 : period_days;
+    if (n < 2) {
+        return -1.0;
+    }
+
+    const double* p = close + (count - 1 - n);
+    double sum = 0.0;
+    for (int i = 0; i < n; i++) {
+        sum += log(p[i + 1] / p[i]);
+    }
+    double mean = sum / n;
+
+    double variance = 0.0;
+    for (int i = 0; i < n; i++) {
+        double diff = log(p[i + 1] / p[i]) - mean;
+        variance += diff * diff;
+    }
+    variance /= (n - 1);  // Sample variance
+
+    return sqrt(variance * 252.0);  // 252 trading days in a year
+}
@@ -0,0 +1,263 @@
+/**
+ * vol_surface.c
+ * Black-Scholes and Heston implied volatility surfaces in one call
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "../include/vol_surface.h"
+#include "../include/heston_fft.h"
+#include "../include/black_scholes_batch.h"
+#include "../include/fft_cache.h"
+
+// A point's place in the sorted order
+typedef struct {
+    double S;
+    double r;
+    double q;
+    double T;
+    int index;
+} SurfaceKey;
+
+// One chain sharing (S, r, q, T), as a run of sorted keys
+typedef struct {
+    int start;     // First key of the chain
+    int count;     // Number of points
+} SurfaceChain;
+
+// Shared state of the chain workers
+typedef struct {
+    VolSurfacePoint* points;
+    const SurfaceKey* keys;
+    const SurfaceChain* chains;
+    int num_chains;
+    HestonFFTConfig config;    // Settings each chain starts from, with a share of the cache
+    int next_chain;        // Next chain to claim
+    int failures;          // Points without a Heston implied volatility
+    pthread_mutex_t lock;
+} SurfaceWork;
+
+static int compare_keys(const void* a, const void* b) {
+    const SurfaceKey* x = a;
+    const SurfaceKey* y = b;
+
+    if (x->S != y->S) return x->S < y->S ? -1 : 1;
+    if (x->r != y->r) return x->r < y->r ? -1 : 1;
+    if (x->q != y->q) return x->q < y->q ? -1 : 1;
+    if (x->T != y->T) return x->T < y->T ? -1 : 1;
+    return x->index - y->index;
+}
+
+static int same_chain(const SurfaceKey* x, const SurfaceKey* y) {
+    return x->S == y->S && x->r == y->r && x->q == y->q && x->T == y->T;
+}
+
+// Calibrate one chain and scatter its vols; returns the number of failures
+static int solve_chain(HestonFFTContext* ctx, VolSurfacePoint* points,
+                       const SurfaceKey* keys, const SurfaceChain* chain,
+                       double* strikes, double* prices, double* ivs) {
+    const SurfaceKey* first = &keys[chain->start];
+
+    for (int j = 0; j < chain->count; j++) {
+        const VolSurfacePoint* point = &points[keys[chain->start + j].index];
+        strikes[j] = point->K;
+        prices[j] = point->price;
+    }
+
+    int failed = (ctx != NULL)
+        ? heston_fft_context_implied_vol_chain(ctx, first->S, first->T, first->r, first->q,
+                                               strikes, prices, chain->count, ivs)
+        : heston_fft_implied_vol_chain(first->S, first->T, first->r, first->q,
+                                       strikes, prices, chain->count, ivs);
+    if (failed < 0) {
+        for (int j = 0; j < chain->count; j++) {
+            ivs[j] = -1.0;
+        }
+        failed = chain->count;
+    }
+
+    for (int j = 0; j < chain->count; j++) {
+        points[keys[chain->start + j].index].sv_iv = ivs[j];
+    }
+    return failed;
+}
+
+static void* chain_worker(void* arg) {
+    SurfaceWork* work = arg;
+    int longest = 0;
+
+    for (int c = 0; c < work->num_chains; c++) {
+        if (work->chains[c].count > longest) {
+            longest = work->chains[c].count;
+        }
+    }
+
+    HestonFFTContext* ctx = heston_fft_context_create();
+    double* buffers = malloc(3 * (size_t)longest * sizeof(double));
+
+    for (;;) {
+        pthread_mutex_lock(&work->lock);
+        int c = work->next_chain++;
+        pthread_mutex_unlock(&work->lock);
+        if (c >= work->num_chains) {
+            break;
+        }
+
+        const SurfaceChain* chain = &work->chains[c];
+        int failed;
+        if (ctx != NULL && buffers != NULL) {
+            // Earlier chains may have adapted the grid
+            heston_fft_context_set_config(ctx, &work->config);
+            failed = solve_chain(ctx, work->points, work->keys, chain,
+                                 buffers, buffers + longest, buffers + 2 * longest);
+        } else {
+            for (int j = 0; j < chain->count; j++) {
+                work->points[work->keys[chain->start + j].index].sv_iv = -1.0;
+            }
+            failed = chain->count;
+        }
+
+        pthread_mutex_lock(&work->lock);
+        work->failures += failed;
+        pthread_mutex_unlock(&work->lock);
+    }
+
+    free(buffers);
+    heston_fft_context_destroy(ctx);
+    return NULL;
+}
+
+// Black-Scholes vols of every point in one batch
+static int solve_bs_vols(VolSurfacePoint* points, int n) {
+    double* columns = malloc(7 * (size_t)n * sizeof(double));
+    if (columns == NULL) {
+        return -1;
+    }
+
+    double* price = columns;
+    double* S = columns + n;
+    double* K = columns + 2 * (size_t)n;
+    double* T = columns + 3 * (size_t)n;
+    double* r = columns + 4 * (size_t)n;
+    double* q = columns + 5 * (size_t)n;
+    double* ivs = columns + 6 * (size_t)n;
+
+    for (int i = 0; i < n; i++) {
+        price[i] = points[i].price;
+        S[i] = points[i].S;
+        K[i] = points[i].K;
+        T[i] = points[i].T;
+        r[i] = points[i].r;
+        q[i] = points[i].q;
+    }
+
+    IVBatchInput in = {price, S, K, T, r, q, NULL};
+    int result = bs_implied_vol_batch(n, &in, ivs, NULL);
+    for (int i = 0; i < n; i++) {
+        points[i].bs_iv = (result >= 0) ? ivs[i] : -1.0;
+    }
+
+    free(columns);
+    return 0;
+}
+
+int heston_vol_surface(VolSurfacePoint* points, int n, int threads) {
+    if (points == NULL || n <= 0) {
+        return -1;
+    }
+    if (threads < 1) {
+        threads = 1;
+    }
+
+    SurfaceKey* keys = malloc((size_t)n * sizeof(SurfaceKey));
+    SurfaceChain* chains = malloc((size_t)n * sizeof(SurfaceChain));
+    int longest = 0;
+    if (keys == NULL || chains == NULL || solve_bs_vols(points, n) != 0) {
+        free(keys);
+        free(chains);
+        return -1;
+    }
+
+    for (int i = 0; i < n; i++) {
+        keys[i].S = points[i].S;
+        keys[i].r = points[i].r;
+        keys[i].q = points[i].q;
+        keys[i].T = points[i].T;
+        keys[i].index = i;
+    }
+    qsort(keys, (size_t)n, sizeof(SurfaceKey), compare_keys);
+
+    int num_chains = 0;
+    for (int i = 0; i < n; i++) {
+        if (i == 0 || !same_chain(&keys[i - 1], &keys[i])) {
+            chains[num_chains].start = i;
+            chains[num_chains].count = 0;
+            num_chains++;
+        }
+        chains[num_chains - 1].count++;
+        if (chains[num_chains - 1].count > longest) {
+            longest = chains[num_chains - 1].count;
+        }
+    }
+
+    if (threads > num_chains) {
+        threads = num_chains;
+    }
+
+    // Every chain starts from the configured grid, whichever thread runs it
+    HestonFFTConfig config;
+    heston_fft_get_config(&config);
+
+    int failures = 0;
+    if (threads == 1) {
+        double* buffers = malloc(3 * (size_t)longest * sizeof(double));
+        if (buffers == NULL) {
+            failures = -1;
+        }
+        for (int c = 0; c < num_chains && buffers != NULL; c++) {
+            // Earlier chains may have adapted the grid
+            heston_fft_set_config(&config);
+            failures += solve_chain(NULL, points, keys, &chains[c],
+                                    buffers, buffers + longest, buffers + 2 * longest);
+        }
+        free(buffers);
+    } else {
+        SurfaceWork work;
+        memset(&work, 0, sizeof(work));
+        work.points = points;
+        work.keys = keys;
+        work.chains = chains;
+        work.num_chains = num_chains;
+        work.config = config;
+        work.config.cache_max_bytes = ((config.cache_max_bytes > 0) ? config.cache_max_bytes
+                                                                    : FFT_CACHE_DEFAULT_MAX_BYTES) /
+                                      (size_t)threads;
+        pthread_mutex_init(&work.lock, NULL);
+
+        pthread_t* workers = malloc((size_t)threads * sizeof(pthread_t));
+        int started = 0;
+        while (workers != NULL && started < threads &&
+               pthread_create(&workers[started], NULL, chain_worker, &work) == 0) {
+            started++;
+        }
+        if (started == 0) {
+            // No threads to spare; work through the chains here
+            chain_worker(&work);
+        }
+        for (int t = 0; t < started; t++) {
+            pthread_join(workers[t], NULL);
+        }
+
+        failures = work.failures;
+        free(workers);
+        pthread_mutex_destroy(&work.lock);
+    }
+
+    free(keys);
+    free(chains);
+    return failures;
+}
@@ -0,0 +1,129 @@
+/**
+ * check_batch_iv.c
+ * Batch Black-Scholes implied volatility (black_scholes_batch.h)
+ *
+ * Calls and puts priced with bs_call()/bs_put() over a surface of
+ * moneyness, expiries and volatilities have to come back with their
+ * volatility, and every kind of unsolvable input has to get its status and
+ * -1.0 instead of a default volatility. Options whose time value is lost to
+ * rounding have no reliable volatility and are left out of the surface.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <math.h>
+
+#include "../include/black_scholes.h"
+#include "../include/black_scholes_batch.h"
+
+#define CHECK_S 100.0
+#define CHECK_R 0.03
+#define CHECK_Q 0.01
+
+// Largest volatility error of a solved option, and the smallest time value
+// (price above the discounted forward intrinsic value) of a surface option
+#define IV_TOLERANCE 1e-8
+#define MIN_TIME_VALUE 1e-3
+
+static const double strikes[] = {50.0, 70.0, 85.0, 95.0, 100.0, 105.0, 115.0, 130.0, 160.0};
+static const double expiries[] = {0.02, 0.25, 1.0, 5.0};
+static const double vols[] = {0.05, 0.2, 0.6, 1.5};
+
+#define N_STRIKES ((int)(sizeof(strikes) / sizeof(strikes[0])))
+#define N_EXPIRIES ((int)(sizeof(expiries) / sizeof(expiries[0])))
+#define N_VOLS ((int)(sizeof(vols) / sizeof(vols[0])))
+#define N_SURFACE (2 * N_STRIKES * N_EXPIRIES * N_VOLS)
+
+#define N_BAD 6
+
+int main(void) {
+    static double price[N_SURFACE], S[N_SURFACE], K[N_SURFACE], T[N_SURFACE];
+    static double r[N_SURFACE], q[N_SURFACE], vol[N_SURFACE], ivs[N_SURFACE];
+    static OptionType type[N_SURFACE];
+    static IVStatus status[N_SURFACE];
+    int failures = 0;
+    int n = 0;
+
+    for (int t = 0; t < 2; t++) {
+        for (int e = 0; e < N_EXPIRIES; e++) {
+            for (int i = 0; i < N_STRIKES; i++) {
+                for (int v = 0; v < N_VOLS; v++) {
+                    S[n] = CHECK_S;
+                    K[n] = strikes[i];
+                    T[n] = expiries[e];
+                    r[n] = CHECK_R;
+                    q[n] = CHECK_Q;
+                    vol[n] = vols[v];
+                    type[n] = t == 0 ? OPTION_CALL : OPTION_PUT;
+                    price[n] = t == 0 ? bs_call(CHECK_S, K[n], T[n], CHECK_R, CHECK_Q, vol[n])
+                                      : bs_put(CHECK_S, K[n], T[n], CHECK_R, CHECK_Q, vol[n]);
+                    double forward_value = CHECK_S * exp(-CHECK_Q * T[n]) - K[n] * exp(-CHECK_R * T[n]);
+                    double intrinsic = fmax(t == 0 ? forward_value : -forward_value, 0.0);
+                    if (price[n] - intrinsic >= MIN_TIME_VALUE) {
+                        n++;
+                    }
+                }
+            }
+        }
+    }
+
+    IVBatchInput in = {price, S, K, T, r, q, type};
+    int unsolved = bs_implied_vol_batch(n, &in, ivs, status);
+    double worst = 0.0;
+
+    for (int i = 0; i < n; i++) {
+        if (status[i] == IV_OK) {
+            double error = fabs(ivs[i] - vol[i]);
+            worst = fmax(worst, error);
+            if (error > IV_TOLERANCE) {
+                printf("FAIL: %s K=%g T=%g vol=%g: iv %.12f\n", type[i] == OPTION_CALL ? "call" : "put",
+                       K[i], T[i], vol[i], ivs[i]);
+                failures++;
+            }
+        } else {
+            printf("FAIL: %s K=%g T=%g vol=%g: status %s, iv %g\n", type[i] == OPTION_CALL ? "call" : "put",
+                   K[i], T[i], vol[i], bs_iv_status_string(status[i]), ivs[i]);
+            failures++;
+        }
+    }
+    if (unsolved != 0) {
+        printf("FAIL: %d options reported unsolved\n", unsolved);
+        failures++;
+    }
+
+    // One option per kind of unsolvable input and a solvable put among them,
+    // with the status each has to get
+    double bad_price[N_BAD] = {5.0, 5.0, 0.5, 100.0, 5.0, NAN};
+    double bad_S[N_BAD] = {-100.0, 100.0, 100.0, 100.0, 100.0, 100.0};
+    double bad_K[N_BAD] = {100.0, 100.0, 80.0, 100.0, 100.0, 100.0};
+    double bad_T[N_BAD] = {0.25, 0.0, 0.25, 0.25, 0.25, 0.25};
+    double bad_r[N_BAD] = {CHECK_R, CHECK_R, CHECK_R, CHECK_R, CHECK_R, CHECK_R};
+    double bad_q[N_BAD] = {CHECK_Q, CHECK_Q, CHECK_Q, CHECK_Q, CHECK_Q, CHECK_Q};
+    OptionType bad_type[N_BAD] = {OPTION_CALL, OPTION_CALL, OPTION_CALL, OPTION_CALL, OPTION_PUT, OPTION_CALL};
+    const IVStatus expected[N_BAD] = {IV_INVALID_INPUT, IV_INVALID_INPUT, IV_BELOW_INTRINSIC,
+                                      IV_ABOVE_MAXIMUM, IV_OK, IV_INVALID_INPUT};
+    double bad_ivs[N_BAD];
+    IVStatus bad_status[N_BAD];
+    IVBatchInput bad = {bad_price, bad_S, bad_K, bad_T, bad_r, bad_q, bad_type};
+
+    int bad_unsolved = bs_implied_vol_batch(N_BAD, &bad, bad_ivs, bad_status);
+    for (int i = 0; i < N_BAD; i++) {
+        if (bad_status[i] != expected[i] || (expected[i] != IV_OK && bad_ivs[i] != -1.0)) {
+            printf("FAIL: input %d: status %s, iv %g, expected %s\n", i, bs_iv_status_string(bad_status[i]),
+                   bad_ivs[i], bs_iv_status_string(expected[i]));
+            failures++;
+        }
+    }
+    if (bad_unsolved != N_BAD - 1) {
+        printf("FAIL: %d of the unsolvable inputs reported, expected %d\n", bad_unsolved, N_BAD - 1);
+        failures++;
+    }
+
+    if (failures > 0) {
+        printf("check_batch_iv: %d failures\n", failures);
+        return 1;
+    }
+    printf("check_batch_iv: %d options solved to %.1e\n", n, worst);
+    return 0;
+}
@@ -0,0 +1,126 @@
+/**
+ * check_calibration.c
+ * Levenberg-Marquardt calibration (heston_calibration.h) on a synthetic surface
+ *
+ * A surface of three expiries is priced with known parameters through
+ * heston_price_quotes(); heston_calibrate() has to find them again from a
+ * distant starting point and from its own ATM start. The analytic gradient
+ * of cf_heston_gradient() is compared with central differences of cf_heston().
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <math.h>
+#include <complex.h>
+
+#include "../include/heston_calibration.h"
+#include "../include/error_handling.h"
+
+#define CHECK_S 100.0
+#define CHECK_R 0.03
+#define CHECK_Q 0.01
+
+// Largest difference to the true parameters, and the largest RMSE in price units
+#define PARAM_TOLERANCE 1e-3
+#define RMSE_TOLERANCE 1e-5
+
+// Relative difference of the gradient to the central differences
+#define GRADIENT_TOLERANCE 1e-6
+#define DIFF_STEP 1e-6
+
+static const double expiries[] = {0.25, 0.5, 1.0};
+static const double strikes[] = {80.0, 85.0, 90.0, 95.0, 100.0, 105.0, 110.0, 115.0, 120.0};
+
+#define N_EXPIRIES ((int)(sizeof(expiries) / sizeof(expiries[0])))
+#define N_STRIKES ((int)(sizeof(strikes) / sizeof(strikes[0])))
+#define N_QUOTES (N_EXPIRIES * N_STRIKES)
+
+static const HestonParams truth = {0.04, 1.5, 0.06, 0.5, -0.7};
+
+static int failures = 0;
+
+static void check_fit(const char* name, const HestonQuote* quotes, const HestonParams* initial) {
+    HestonCalibrationResult result;
+    int rc = heston_calibrate(quotes, N_QUOTES, initial, NULL, &result);
+    if (rc != ERROR_NONE) {
+        printf("FAIL: %s: heston_calibrate returned %d\n", name, rc);
+        failures++;
+        return;
+    }
+
+    const HestonParams* p = &result.params;
+    double error = fmax(fmax(fabs(p->v0 - truth.v0), fabs(p->kappa - truth.kappa)),
+                        fmax(fmax(fabs(p->theta - truth.theta), fabs(p->sigma - truth.sigma)),
+                             fabs(p->rho - truth.rho)));
+    if (!result.converged || result.rmse > RMSE_TOLERANCE || error > PARAM_TOLERANCE) {
+        printf("FAIL: %s: v0=%g kappa=%g theta=%g sigma=%g rho=%g rmse=%g converged=%d\n",
+               name, p->v0, p->kappa, p->theta, p->sigma, p->rho, result.rmse, result.converged);
+        failures++;
+        return;
+    }
+    printf("check_calibration: %s recovered the parameters to %.1e in %d iterations\n",
+           name, error, result.iterations);
+}
+
+static void check_gradient(double complex phi, double T) {
+    double complex grad[HESTON_NUM_PARAMS];
+    cf_heston_gradient(phi, CHECK_S, &truth, CHECK_R, CHECK_Q, T, grad);
+
+    for (int k = 0; k < HESTON_NUM_PARAMS; k++) {
+        double up[HESTON_NUM_PARAMS] = {truth.v0, truth.kappa, truth.theta, truth.sigma, truth.rho};
+        double down[HESTON_NUM_PARAMS] = {truth.v0, truth.kappa, truth.theta, truth.sigma, truth.rho};
+        up[k] += DIFF_STEP;
+        down[k] -= DIFF_STEP;
+        double complex diff =
+            (cf_heston(phi, CHECK_S, up[0], up[1], up[2], up[3], up[4], CHECK_R, CHECK_Q, T) -
+             cf_heston(phi, CHECK_S, down[0], down[1], down[2], down[3], down[4], CHECK_R, CHECK_Q, T)) /
+            (2.0 * DIFF_STEP);
+        if (cabs(grad[k] - diff) > GRADIENT_TOLERANCE * fmax(cabs(diff), 1e-3)) {
+            printf("FAIL: gradient %d at phi = %g%+gi, T = %g: analytic %g%+gi, differences %g%+gi\n",
+                   k, creal(phi), cimag(phi), T, creal(grad[k]), cimag(grad[k]), creal(diff), cimag(diff));
+            failures++;
+        }
+    }
+}
+
+int main(void) {
+    HestonQuote quotes[N_QUOTES];
+    double prices[N_QUOTES];
+
+    for (int e = 0; e < N_EXPIRIES; e++) {
+        for (int i = 0; i < N_STRIKES; i++) {
+            HestonQuote* quote = &quotes[e * N_STRIKES + i];
+            quote->S = CHECK_S;
+            quote->K = strikes[i];
+            quote->T = expiries[e];
+            quote->r = CHECK_R;
+            quote->q = CHECK_Q;
+            quote->price = 0.0;
+            quote->weight = 0.0;
+        }
+    }
+    if (heston_price_quotes(quotes, N_QUOTES, &truth, NULL, prices) != ERROR_NONE) {
+        printf("FAIL: heston_price_quotes could not price the surface\n");
+        return 1;
+    }
+    for (int i = 0; i < N_QUOTES; i++) {
+        quotes[i].price = prices[i];
+    }
+
+    const HestonParams distant = {0.09, 4.0, 0.02, 1.0, 0.0};
+    check_fit("distant start", quotes, &distant);
+    check_fit("ATM start", quotes, NULL);
+
+    for (int e = 0; e < N_EXPIRIES; e++) {
+        check_gradient(0.5 - 1.5 * I, expiries[e]);
+        check_gradient(7.0 - 2.5 * I, expiries[e]);
+        check_gradient(30.0 + 0.2 * I, expiries[e]);
+    }
+
+    if (failures > 0) {
+        printf("check_calibration: %d failures\n", failures);
+        return 1;
+    }
+    return 0;
+}
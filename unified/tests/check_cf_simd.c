@@ -0,0 +1,238 @@
+/**
+ * check_cf_simd.c
+ * Vectorized characteristic function kernels (heston_cf_simd.h) against cf_heston()
+ *
+ * heston_cf_batch() and heston_cf_carr_madan_fill() are compared with
+ * cf_heston() and the Carr-Madan input computed from it, over the
+ * integration nodes of a default grid and off-axis arguments, for parameter
+ * sets from calm to extreme. Arguments and parameter sets that make the
+ * intermediates overflow check that the kernels fall back like the scalar
+ * code: 1 for the characteristic function, 0 for the FFT input.
+ *
+ * Built once against libheston, which runs the kernels with the instruction
+ * set picked at load time, and once per instruction set with its own build
+ * of heston_cf_simd.c (see Makefile.unified); builds for an instruction set
+ * this machine lacks report it and pass.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <complex.h>
+
+#include "../include/heston_fft.h"
+#include "../include/heston_cf_simd.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// Largest error relative to the larger component of the cf_heston() value,
+// in units of DBL_EPSILON (1 + |phi| (|log S| + 1)): the bound
+// heston_cf_simd.h documents. Both sides round the exponent, whose
+// imaginary part grows like |phi| log S, before taking its exponential
+#define MAX_ERROR_UNITS 4.0
+
+#define CHECK_S 100.0
+#define CHECK_R 0.03
+#define CHECK_Q 0.01
+
+#define GRID_N 4096
+#define GRID_ETA 0.25
+#define GRID_ALPHA 1.5
+
+#define OFF_AXIS_N 64
+
+typedef struct {
+    const char* name;
+    HestonParams params;
+    double T;
+} CheckCase;
+
+static const CheckCase cases[] = {
+    {"typical", {0.04, 2.0, 0.04, 0.3, -0.7}, 0.25},
+    {"short expiry", {0.09, 3.0, 0.06, 0.5, -0.5}, 0.02},
+    {"long expiry", {0.02, 0.5, 0.05, 0.4, -0.3}, 10.0},
+    {"high vol of vol", {0.2, 1.0, 0.15, 1.5, -0.9}, 1.0},
+    {"positive correlation", {0.04, 1.5, 0.04, 0.6, 0.95}, 0.5},
+    {"Feller violated", {0.01, 0.2, 0.01, 0.9, -0.95}, 2.0},
+};
+
+#define N_CASES ((int)(sizeof(cases) / sizeof(cases[0])))
+
+static double v_nodes[GRID_N], weights[GRID_N], shift_re[GRID_N], shift_im[GRID_N];
+static double u_re[GRID_N], u_im[GRID_N];
+static double out_re[GRID_N], out_im[GRID_N];
+
+static int failures = 0;
+
+static double error_units(double re, double im, double complex ref, double complex phi) {
+    double scale = fmax(fmax(fabs(creal(ref)), fabs(cimag(ref))), DBL_MIN);
+    double bound = DBL_EPSILON * (1.0 + cabs(phi) * (fabs(log(CHECK_S)) + 1.0));
+    return fmax(fabs(re - creal(ref)), fabs(im - cimag(ref))) / scale / bound;
+}
+
+static double complex cf_ref(double complex phi, const CheckCase* c) {
+    const HestonParams* p = &c->params;
+    return cf_heston(phi, CHECK_S, p->v0, p->kappa, p->theta, p->sigma, p->rho,
+                     CHECK_R, CHECK_Q, c->T);
+}
+
+// The Carr-Madan input of one node computed from cf_heston(), non-finite values set to 0
+static double complex fill_ref(int i, double alpha, const CheckCase* c) {
+    double complex phi = v_nodes[i] - (alpha + 1.0) * I;
+    double complex denom = alpha * alpha + alpha - v_nodes[i] * v_nodes[i] + (2.0 * alpha + 1.0) * v_nodes[i] * I;
+    double complex m = exp(-CHECK_R * c->T) * cf_ref(phi, c) / denom;
+    if (!isfinite(creal(m)) || !isfinite(cimag(m))) {
+        m = 0.0;
+    }
+    return m * weights[i] * (shift_re[i] + shift_im[i] * I);
+}
+
+static void report(const char* what, const CheckCase* c, double max_error) {
+    if (max_error > MAX_ERROR_UNITS) {
+        printf("FAIL: %s, %s: error of %.3g units\n", what, c->name, max_error);
+        failures++;
+    }
+}
+
+// heston_cf_batch() on n arguments in u_re/u_im
+static double batch_error(int n, const CheckCase* c) {
+    double max_error = 0.0;
+    heston_cf_batch(n, u_re, u_im, CHECK_S, &c->params, CHECK_R, CHECK_Q, c->T, out_re, out_im);
+    for (int i = 0; i < n; i++) {
+        double complex phi = u_re[i] + u_im[i] * I;
+        max_error = fmax(max_error, error_units(out_re[i], out_im[i], cf_ref(phi, c), phi));
+    }
+    return max_error;
+}
+
+// heston_cf_carr_madan_fill() over the grid nodes; also checks the zeroed count
+static double fill_error(double alpha, const CheckCase* c, int* zeroed) {
+    double max_error = 0.0;
+    *zeroed = heston_cf_carr_madan_fill(GRID_N, alpha, v_nodes, weights, shift_re, shift_im, CHECK_S,
+                                        &c->params, CHECK_R, CHECK_Q, c->T, out_re, out_im);
+    for (int i = 0; i < GRID_N; i++) {
+        double complex phi = v_nodes[i] - (alpha + 1.0) * I;
+        max_error = fmax(max_error, error_units(out_re[i], out_im[i], fill_ref(i, alpha, c), phi));
+    }
+    return max_error;
+}
+
+// heston_cf_batch() on n arguments where cf_heston() falls back to exactly 1
+static void check_fallback(int n, const CheckCase* c) {
+    heston_cf_batch(n, u_re, u_im, CHECK_S, &c->params, CHECK_R, CHECK_Q, c->T, out_re, out_im);
+    for (int i = 0; i < n; i++) {
+        if (cf_ref(u_re[i] + u_im[i] * I, c) != 1.0) {
+            printf("FAIL: fallback, %s: cf_heston does not fall back at phi = %g%+gi\n",
+                   c->name, u_re[i], u_im[i]);
+            failures++;
+        } else if (out_re[i] != 1.0 || out_im[i] != 0.0) {
+            printf("FAIL: fallback, %s: heston_cf_batch gives %g%+gi at phi = %g%+gi\n",
+                   c->name, out_re[i], out_im[i], u_re[i], u_im[i]);
+            failures++;
+        }
+    }
+}
+
+// Whether the kernels in this build can run here
+static bool isa_available(const char* isa) {
+#if defined(__GNUC__) && defined(__x86_64__)
+    __builtin_cpu_init();
+    if (strcmp(isa, "avx512f") == 0) {
+        return __builtin_cpu_supports("avx512f");
+    }
+    if (strcmp(isa, "avx2") == 0) {
+        return __builtin_cpu_supports("avx2");
+    }
+#else
+    (void)isa;
+#endif
+    return true;
+}
+
+int main(void) {
+    const char* isa = heston_cf_kernel_isa();
+    if (!isa_available(isa)) {
+        printf("check_cf_simd (%s): skipped, not supported on this machine\n", isa);
+        return 0;
+    }
+
+    // Nodes, Simpson weights and the log-strike phase of the default grid
+    double b = M_PI / GRID_ETA;
+    for (int i = 0; i < GRID_N; i++) {
+        v_nodes[i] = i * GRID_ETA;
+        weights[i] = GRID_ETA / 3.0 * (3.0 + (i % 2 == 0 ? -1.0 : 1.0) - (i == 0 ? 1.0 : 0.0));
+        shift_re[i] = cos(b * v_nodes[i]);
+        shift_im[i] = sin(b * v_nodes[i]);
+    }
+
+    double worst = 0.0;
+    for (int k = 0; k < N_CASES; k++) {
+        const CheckCase* c = &cases[k];
+        double error;
+
+        // The Carr-Madan contour phi = v - (alpha + 1) i
+        for (int i = 0; i < GRID_N; i++) {
+            u_re[i] = v_nodes[i];
+            u_im[i] = -(GRID_ALPHA + 1.0);
+        }
+        error = batch_error(GRID_N, c);
+        report("heston_cf_batch on the grid contour", c, error);
+        worst = fmax(worst, error);
+
+        // Off-axis arguments in both half planes
+        for (int i = 0; i < OFF_AXIS_N; i++) {
+            u_re[i] = (i - OFF_AXIS_N / 2) * 3.7;
+            u_im[i] = (i % 7 - 3) * 0.45;
+        }
+        error = batch_error(OFF_AXIS_N, c);
+        report("heston_cf_batch off the axis", c, error);
+        worst = fmax(worst, error);
+
+        int zeroed;
+        error = fill_error(GRID_ALPHA, c, &zeroed);
+        report("heston_cf_carr_madan_fill", c, error);
+        worst = fmax(worst, error);
+        if (zeroed != 0) {
+            printf("FAIL: heston_cf_carr_madan_fill, %s: %d nodes zeroed\n", c->name, zeroed);
+            failures++;
+        }
+    }
+
+    // Overflowing arguments: cf_heston() answers 1 and the kernels have to as well
+    const CheckCase* typical = &cases[0];
+    for (int i = 0; i < 4; i++) {
+        u_re[i] = (i % 2 == 0 ? 1.0 : -1.0) * 1e200;
+        u_im[i] = i < 2 ? 0.0 : -2.5;
+    }
+    check_fallback(4, typical);
+
+    // A zero vol of vol leaves A and B non-finite on every node
+    const CheckCase degenerate = {"zero vol of vol", {0.04, 2.0, 0.04, 0.0, -0.7}, 0.25};
+    for (int i = 0; i < OFF_AXIS_N; i++) {
+        u_re[i] = i * 0.5;
+        u_im[i] = -(GRID_ALPHA + 1.0);
+    }
+    check_fallback(OFF_AXIS_N, &degenerate);
+
+    // With alpha = 0 the Carr-Madan denominator vanishes at v = 0, the one
+    // node the fill has to set to 0
+    int zeroed;
+    report("heston_cf_carr_madan_fill with a pole", typical, fill_error(0.0, typical, &zeroed));
+    if (zeroed != 1 || out_re[0] != 0.0 || out_im[0] != 0.0) {
+        printf("FAIL: heston_cf_carr_madan_fill with a pole: %d nodes zeroed, node 0 = %g%+gi\n",
+               zeroed, out_re[0], out_im[0]);
+        failures++;
+    }
+
+    if (failures > 0) {
+        printf("check_cf_simd (%s): %d failures\n", isa, failures);
+        return 1;
+    }
+    printf("check_cf_simd (%s): kernels agree with cf_heston(), largest error %.2g units\n", isa, worst);
+    return 0;
+}
@@ -0,0 +1,81 @@
+/**
+ * check_chain.c
+ * heston_fft_implied_vol_chain() against heston_fft_implied_vol(), strike by strike
+ *
+ * The chain calibration shares FFT grids between strikes but has to give
+ * every strike the volatility the single-option procedure finds for it. The
+ * chains below are priced from a skewed Black-Scholes smile over several
+ * expiries, with strikes from deep in the money to far out of it, so that
+ * their strikes start from different seeds and some of them need their own
+ * FFT settings.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <math.h>
+
+#include "../include/heston_fft.h"
+#include "../include/black_scholes.h"
+
+#define CHECK_S 100.0
+#define CHECK_R 0.05
+#define CHECK_Q 0.02
+
+static const double expiries[] = {0.02, 0.1, 0.25, 1.0, 2.0};
+static const double strikes[] = {30.0, 70.0, 80.0, 90.0, 95.0, 100.0, 105.0, 110.0, 120.0, 130.0, 150.0};
+
+#define N_EXPIRIES ((int)(sizeof(expiries) / sizeof(expiries[0])))
+#define N_STRIKES ((int)(sizeof(strikes) / sizeof(strikes[0])))
+
+// Smile with a downward skew in log-moneyness
+static double smile_vol(double K, double T) {
+    double forward = CHECK_S * exp((CHECK_R - CHECK_Q) * T);
+    double vol = 0.22 - 0.15 * log(K / forward);
+    return vol < 0.08 ? 0.08 : vol;
+}
+
+int main(void) {
+    int failures = 0;
+
+    for (int e = 0; e < N_EXPIRIES; e++) {
+        double T = expiries[e];
+        double prices[N_STRIKES];
+        double chain_ivs[N_STRIKES];
+
+        for (int i = 0; i < N_STRIKES; i++) {
+            prices[i] = bs_call(CHECK_S, strikes[i], T, CHECK_R, CHECK_Q, smile_vol(strikes[i], T));
+        }
+
+        int chain_failed = heston_fft_implied_vol_chain(CHECK_S, T, CHECK_R, CHECK_Q,
+                                                        strikes, prices, N_STRIKES, chain_ivs);
+        int single_failed = 0;
+
+        for (int i = 0; i < N_STRIKES; i++) {
+            double single_iv = -1.0;
+            if (heston_fft_implied_vol(prices[i], CHECK_S, strikes[i], T, CHECK_R, CHECK_Q, &single_iv) != 0) {
+                single_iv = -1.0;
+                single_failed++;
+            }
+            if (chain_ivs[i] != single_iv) {
+                printf("FAIL: T=%g K=%g price=%.6f: chain %.10f, single %.10f\n",
+                       T, strikes[i], prices[i], chain_ivs[i], single_iv);
+                failures++;
+            }
+        }
+
+        if (chain_failed != single_failed) {
+            printf("FAIL: T=%g: chain reports %d failures, single options %d\n",
+                   T, chain_failed, single_failed);
+            failures++;
+        }
+    }
+
+    if (failures > 0) {
+        printf("check_chain: %d mismatches\n", failures);
+        return 1;
+    }
+    printf("check_chain: %d strikes over %d expiries match the single-option procedure\n",
+           N_STRIKES * N_EXPIRIES, N_EXPIRIES);
+    return 0;
+}
@@ -0,0 +1,111 @@
+/**
+ * check_cos.c
+ * COS engine (heston_cos.h) against itself at high resolution, put-call parity and the FFT engine
+ *
+ * For parameter sets from calm to strongly skewed, the number of terms the
+ * header documents for them has to agree with HESTON_COS_MAX_TERMS terms,
+ * calls and puts have to satisfy put-call parity, and the prices have to
+ * agree with the FFT engine (heston_fft_price_option()) to the accuracy of
+ * its default grid.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <math.h>
+
+#include "../include/heston_cos.h"
+#include "../include/error_handling.h"
+
+#define CHECK_S 100.0
+#define CHECK_R 0.03
+#define CHECK_Q 0.01
+
+// Series against the converged one, parity, and COS against FFT
+#define TERMS_TOLERANCE 1e-8
+#define PARITY_TOLERANCE 1e-9
+#define FFT_TOLERANCE 2.5e-3
+
+typedef struct {
+    const char* name;
+    HestonParams params;
+    double T;
+    int terms;   /**< Cosine terms, 0 for the default */
+} CheckCase;
+
+static const CheckCase cases[] = {
+    {"typical", {0.04, 2.0, 0.04, 0.3, -0.7}, 0.25, 0},
+    {"short expiry", {0.09, 3.0, 0.06, 0.5, -0.5}, 0.05, 0},
+    {"long expiry", {0.02, 0.5, 0.05, 0.4, -0.3}, 5.0, 0},
+    {"strong skew", {0.04, 1.0, 0.04, 0.8, -0.9}, 0.25, 1024},
+    {"strong skew, one year", {0.04, 1.0, 0.04, 0.8, -0.9}, 1.0, 1024},
+};
+
+static const double strikes[] = {60.0, 80.0, 90.0, 100.0, 110.0, 120.0, 150.0};
+
+#define N_CASES ((int)(sizeof(cases) / sizeof(cases[0])))
+#define N_STRIKES ((int)(sizeof(strikes) / sizeof(strikes[0])))
+
+int main(void) {
+    int failures = 0;
+
+    for (int k = 0; k < N_CASES; k++) {
+        const CheckCase* c = &cases[k];
+        double calls[N_STRIKES], puts[N_STRIKES], converged[N_STRIKES];
+        PricingResult fft[N_STRIKES];
+
+        if (heston_cos_price_chain(CHECK_S, c->T, CHECK_R, CHECK_Q, &c->params, strikes, N_STRIKES,
+                                   OPTION_CALL, c->terms, calls) != ERROR_NONE ||
+            heston_cos_price_chain(CHECK_S, c->T, CHECK_R, CHECK_Q, &c->params, strikes, N_STRIKES,
+                                   OPTION_PUT, c->terms, puts) != ERROR_NONE ||
+            heston_cos_price_chain(CHECK_S, c->T, CHECK_R, CHECK_Q, &c->params, strikes, N_STRIKES,
+                                   OPTION_CALL, HESTON_COS_MAX_TERMS, converged) != ERROR_NONE) {
+            printf("FAIL: %s: heston_cos_price_chain failed\n", c->name);
+            failures++;
+            continue;
+        }
+        int fft_failed = 0;
+        for (int i = 0; i < N_STRIKES; i++) {
+            fft_failed |= heston_fft_price_option(CHECK_S, strikes[i], c->T, CHECK_R, CHECK_Q, &c->params,
+                                                  OPTION_CALL, 0.0, &fft[i]);
+        }
+
+        for (int i = 0; i < N_STRIKES; i++) {
+            double K = strikes[i];
+            double parity = CHECK_S * exp(-CHECK_Q * c->T) - K * exp(-CHECK_R * c->T);
+
+            if (fabs(calls[i] - converged[i]) > TERMS_TOLERANCE) {
+                printf("FAIL: %s, K=%g: %d terms %.10f, %d terms %.10f\n", c->name, K,
+                       c->terms > 0 ? c->terms : HESTON_COS_DEFAULT_TERMS, calls[i],
+                       HESTON_COS_MAX_TERMS, converged[i]);
+                failures++;
+            }
+            // Calls are priced from the puts through parity and floored at 0
+            if (fabs(calls[i] - fmax(puts[i] + parity, 0.0)) > PARITY_TOLERANCE) {
+                printf("FAIL: %s, K=%g: call %.10f - put %.10f misses parity %.10f\n",
+                       c->name, K, calls[i], puts[i], parity);
+                failures++;
+            }
+            if (fft_failed != 0 || fft[i].error_code != 0 || fabs(converged[i] - fft[i].price) > FFT_TOLERANCE) {
+                printf("FAIL: %s, K=%g: COS %.8f, FFT %.8f (error %d)\n",
+                       c->name, K, converged[i], fft[i].price, fft[i].error_code);
+                failures++;
+            }
+        }
+
+        double atm[1];
+        heston_cos_price_chain(CHECK_S, c->T, CHECK_R, CHECK_Q, &c->params, &strikes[3], 1,
+                               OPTION_CALL, 0, atm);
+        if (heston_call_cos(CHECK_S, strikes[3], c->T, CHECK_R, CHECK_Q, &c->params) != atm[0]) {
+            printf("FAIL: %s: heston_call_cos differs from the chain price\n", c->name);
+            failures++;
+        }
+    }
+
+    if (failures > 0) {
+        printf("check_cos: %d failures\n", failures);
+        return 1;
+    }
+    printf("check_cos: %d strikes over %d parameter sets agree\n", N_STRIKES * N_CASES, N_CASES);
+    return 0;
+}
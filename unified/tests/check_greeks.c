@@ -0,0 +1,131 @@
+/**
+ * check_greeks.c
+ * Heston Greeks from the FFT sensitivity grids (heston_fft_greeks_chain())
+ *
+ * Every Greek of a call and put chain is compared with central differences
+ * of COS prices, which are smooth in every input and converged far beyond
+ * the FFT grid's accuracy. The tolerances allow for that accuracy: about
+ * 0.1% of each Greek, plus a small absolute part for the far strikes.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <math.h>
+
+#include "../include/heston_fft.h"
+#include "../include/heston_cos.h"
+#include "../include/error_handling.h"
+
+#define CHECK_S 100.0
+#define CHECK_R 0.03
+#define CHECK_Q 0.01
+
+#define COS_TERMS 2048
+
+// Relative steps of the central differences
+#define STEP_S 1e-3
+#define STEP_T 1e-4
+#define STEP_VOL 1e-4
+#define STEP_R 1e-4
+
+typedef struct {
+    const char* name;
+    HestonParams params;
+    double T;
+} CheckCase;
+
+static const CheckCase cases[] = {
+    {"typical", {0.04, 2.0, 0.04, 0.3, -0.7}, 0.25},
+    {"long expiry", {0.02, 0.5, 0.05, 0.4, -0.3}, 2.0},
+    {"high vol of vol", {0.09, 1.0, 0.06, 0.8, -0.8}, 0.5},
+};
+
+static const double strikes[] = {80.0, 90.0, 95.0, 100.0, 105.0, 110.0, 120.0};
+
+#define N_CASES ((int)(sizeof(cases) / sizeof(cases[0])))
+#define N_STRIKES ((int)(sizeof(strikes) / sizeof(strikes[0])))
+
+// Tolerance of each Greek: absolute part and the part relative to the Greek
+typedef struct {
+    const char* name;
+    double absolute;
+    double relative;
+} Tolerance;
+
+static const Tolerance tolerances[] = {
+    {"delta", 1e-4, 1e-3},
+    {"gamma", 1e-5, 2e-3},
+    {"theta", 2e-3, 1e-3},
+    {"vega", 5e-3, 1e-3},
+    {"rho", 5e-3, 1e-3},
+};
+
+static int failures = 0;
+
+static double cos_price(double S, double K, double T, double r, const HestonParams* params,
+                        OptionType type) {
+    double price = 0.0;
+    heston_cos_price_chain(S, T, r, CHECK_Q, params, &K, 1, type, COS_TERMS, &price);
+    return price;
+}
+
+static void compare(const char* case_name, OptionType type, double K, int greek, double fft, double reference) {
+    const Tolerance* tol = &tolerances[greek];
+    if (!isfinite(fft) || fabs(fft - reference) > tol->absolute + tol->relative * fabs(reference)) {
+        printf("FAIL: %s, %s K=%g: %s %.8f, differences %.8f\n", case_name,
+               type == OPTION_CALL ? "call" : "put", K, tol->name, fft, reference);
+        failures++;
+    }
+}
+
+static void check_chain(const CheckCase* c, OptionType type) {
+    PricingResult results[N_STRIKES];
+    const HestonParams* p = &c->params;
+
+    if (heston_fft_greeks_chain(CHECK_S, c->T, CHECK_R, CHECK_Q, p, strikes, N_STRIKES, type, results) != 0) {
+        printf("FAIL: %s: heston_fft_greeks_chain failed\n", c->name);
+        failures++;
+        return;
+    }
+
+    double vol = sqrt(p->v0);
+    HestonParams vol_up = *p, vol_down = *p;
+    vol_up.v0 = (vol * (1.0 + STEP_VOL)) * (vol * (1.0 + STEP_VOL));
+    vol_down.v0 = (vol * (1.0 - STEP_VOL)) * (vol * (1.0 - STEP_VOL));
+
+    for (int i = 0; i < N_STRIKES; i++) {
+        double K = strikes[i];
+        double hS = CHECK_S * STEP_S, hT = c->T * STEP_T, hv = vol * STEP_VOL, hr = STEP_R;
+
+        double mid = cos_price(CHECK_S, K, c->T, CHECK_R, p, type);
+        double up = cos_price(CHECK_S + hS, K, c->T, CHECK_R, p, type);
+        double down = cos_price(CHECK_S - hS, K, c->T, CHECK_R, p, type);
+
+        compare(c->name, type, K, 0, results[i].delta, (up - down) / (2.0 * hS));
+        compare(c->name, type, K, 1, results[i].gamma, (up - 2.0 * mid + down) / (hS * hS));
+        compare(c->name, type, K, 2, results[i].theta,
+                -(cos_price(CHECK_S, K, c->T + hT, CHECK_R, p, type) -
+                  cos_price(CHECK_S, K, c->T - hT, CHECK_R, p, type)) / (2.0 * hT));
+        compare(c->name, type, K, 3, results[i].vega,
+                (cos_price(CHECK_S, K, c->T, CHECK_R, &vol_up, type) -
+                 cos_price(CHECK_S, K, c->T, CHECK_R, &vol_down, type)) / (2.0 * hv));
+        compare(c->name, type, K, 4, results[i].rho,
+                (cos_price(CHECK_S, K, c->T, CHECK_R + hr, p, type) -
+                 cos_price(CHECK_S, K, c->T, CHECK_R - hr, p, type)) / (2.0 * hr));
+    }
+}
+
+int main(void) {
+    for (int k = 0; k < N_CASES; k++) {
+        check_chain(&cases[k], OPTION_CALL);
+        check_chain(&cases[k], OPTION_PUT);
+    }
+
+    if (failures > 0) {
+        printf("check_greeks: %d failures\n", failures);
+        return 1;
+    }
+    printf("check_greeks: Greeks of %d calls and puts agree with COS differences\n", N_CASES * N_STRIKES);
+    return 0;
+}
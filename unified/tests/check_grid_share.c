@@ -0,0 +1,192 @@
+/**
+ * check_grid_share.c
+ * Shared-memory grid segments (grid_share.h): one publisher and one reader
+ *
+ * A grid with sensitivity rows is published into a fresh segment. The
+ * reader has to interpolate the same prices and sensitivities as the source
+ * grid, copy it into its own cache unchanged, and miss on another key. A
+ * second publisher on the path has to be refused, also from this process,
+ * without the refusal releasing the first publisher's lock. Closing the
+ * publisher removes the file, while the reader keeps its mapping.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "../include/grid_share.h"
+#include "../include/black_scholes.h"
+
+#define CHECK_S 100.0
+#define CHECK_R 0.03
+#define CHECK_Q 0.01
+#define CHECK_T 0.5
+
+#define KEY_TOLERANCE 1e-10
+
+// Grid axis: 128 strikes from 50 upwards, 1% apart in log-strike
+#define N_NODES 128
+#define LOG_STRIKE0 3.912023005428146
+#define LOG_STRIKE_STEP 0.01
+
+static const double strikes[] = {55.5, 80.25, 99.9, 100.0, 117.3, 160.0};
+
+#define N_STRIKES ((int)(sizeof(strikes) / sizeof(strikes[0])))
+
+static int failures = 0;
+
+// A filled and fitted grid with sensitivity rows, priced at the volatility
+static FFTGrid* make_grid(FFTGridCache* cache, const FFTGridKey* key, double vol) {
+    FFTGrid* grid = fft_cache_insert(cache, key, N_NODES);
+    if (grid == NULL || !fft_grid_add_sensitivities(cache, grid)) {
+        return NULL;
+    }
+    for (int i = 0; i < N_NODES; i++) {
+        double K = exp(LOG_STRIKE0 + i * LOG_STRIKE_STEP);
+        grid->prices[i] = bs_call(CHECK_S, K, CHECK_T, CHECK_R, CHECK_Q, vol);
+        for (int row = 0; row < FFT_GRID_SENSITIVITIES; row++) {
+            grid->sensitivities[row * N_NODES + i] = (row + 1) * grid->prices[i];
+        }
+    }
+    fft_grid_fit(grid, LOG_STRIKE0, LOG_STRIKE_STEP);
+    fft_grid_fit_sensitivities(grid);
+    return grid;
+}
+
+// Everything the reader interpolates has to match the source grid exactly
+static void check_reader(GridShare* reader, const FFTGrid* source, const char* when) {
+    double values[N_STRIKES];
+
+    if (grid_share_prices(reader, &source->key, strikes, N_STRIKES, values) != 0) {
+        printf("FAIL: %s: the published prices are not found\n", when);
+        failures++;
+    } else {
+        for (int i = 0; i < N_STRIKES; i++) {
+            if (values[i] != fft_grid_price(source, strikes[i])) {
+                printf("FAIL: %s: K=%g: shared %.15f, source %.15f\n", when, strikes[i], values[i],
+                       fft_grid_price(source, strikes[i]));
+                failures++;
+            }
+        }
+    }
+
+    for (int row = 0; row < FFT_GRID_SENSITIVITIES; row++) {
+        FFTGridSensitivity which = (FFTGridSensitivity)row;
+        if (grid_share_sensitivities(reader, &source->key, which, strikes, N_STRIKES, values) != 0) {
+            printf("FAIL: %s: sensitivity row %d is not found\n", when, row);
+            failures++;
+            continue;
+        }
+        for (int i = 0; i < N_STRIKES; i++) {
+            if (values[i] != fft_grid_sensitivity(source, which, strikes[i])) {
+                printf("FAIL: %s: row %d K=%g: shared %.15f, source %.15f\n", when, row, strikes[i],
+                       values[i], fft_grid_sensitivity(source, which, strikes[i]));
+                failures++;
+            }
+        }
+    }
+}
+
+static void check_fetch(GridShare* reader, const FFTGrid* source) {
+    FFTGridCache* cache = fft_cache_create(0, KEY_TOLERANCE);
+    FFTGrid* copy = cache != NULL ? grid_share_fetch(reader, cache, &source->key) : NULL;
+
+    if (copy == NULL || copy->num_strikes != N_NODES || copy->sensitivities == NULL) {
+        printf("FAIL: the published grid is not copied\n");
+        failures++;
+    } else {
+        for (int i = 0; i < N_STRIKES; i++) {
+            if (fft_grid_price(copy, strikes[i]) != fft_grid_price(source, strikes[i]) ||
+                fft_grid_sensitivity(copy, FFT_GRID_DV0, strikes[i]) !=
+                    fft_grid_sensitivity(source, FFT_GRID_DV0, strikes[i])) {
+                printf("FAIL: K=%g: the copied grid differs from the source\n", strikes[i]);
+                failures++;
+            }
+        }
+    }
+    fft_cache_destroy(cache);
+}
+
+int main(void) {
+    char path[] = "/tmp/check_grid_share_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        printf("FAIL: no temporary file for the segment\n");
+        return 1;
+    }
+    close(fd);
+
+    FFTGridCache* cache = fft_cache_create(0, KEY_TOLERANCE);
+    FFTGridKey key = {CHECK_S, CHECK_R, CHECK_Q, CHECK_T, 0.04, 2.0, 0.04, 0.3, -0.7,
+                      4096, 1.5, 1.5, 0.25};
+    FFTGrid* source = cache != NULL ? make_grid(cache, &key, 0.2) : NULL;
+    GridShare* publisher = grid_share_create(path, 16, 256, KEY_TOLERANCE);
+    if (source == NULL || publisher == NULL || !grid_share_is_publisher(publisher)) {
+        printf("FAIL: the segment cannot be created\n");
+        remove(path);
+        return 1;
+    }
+
+    // Refused twice: a refusal that dropped the lock would let the second one through
+    for (int attempt = 0; attempt < 2; attempt++) {
+        GridShare* second = grid_share_create(path, 16, 256, KEY_TOLERANCE);
+        if (second != NULL) {
+            printf("FAIL: a second publisher took the path on attempt %d\n", attempt + 1);
+            failures++;
+            grid_share_close(second);
+        }
+    }
+
+    GridShare* reader = grid_share_open(path);
+    if (reader == NULL || grid_share_is_publisher(reader) || grid_share_publish(publisher, source) != 0 ||
+        grid_share_publish(reader, source) == 0) {
+        printf("FAIL: the segment cannot be opened and published to\n");
+        grid_share_close(reader);
+        grid_share_close(publisher);
+        fft_cache_destroy(cache);
+        remove(path);
+        return 1;
+    }
+
+    check_reader(reader, source, "published");
+    check_fetch(reader, source);
+
+    double price;
+    FFTGridKey other = key;
+    other.v0 = 0.05;
+    if (grid_share_prices(reader, &other, strikes, 1, &price) == 0) {
+        printf("FAIL: a key that was never published is found\n");
+        failures++;
+    }
+
+    GridShareStats published, read;
+    grid_share_get_stats(publisher, &published);
+    grid_share_get_stats(reader, &read);
+    if (published.published != 1 || read.hits != 2 + FFT_GRID_SENSITIVITIES || read.misses != 1) {
+        printf("FAIL: %lu grids published, %lu hits and %lu misses read\n",
+               published.published, read.hits, read.misses);
+        failures++;
+    }
+
+    grid_share_close(publisher);
+    if (access(path, F_OK) == 0) {
+        printf("FAIL: the segment file is left after the publisher closed\n");
+        failures++;
+        remove(path);
+    }
+    check_reader(reader, source, "after the publisher closed");
+
+    grid_share_close(reader);
+    fft_cache_destroy(cache);
+
+    if (failures > 0) {
+        printf("check_grid_share: %d failures\n", failures);
+        return 1;
+    }
+    printf("check_grid_share: %d prices and sensitivity rows read back exactly, segment removed on close\n",
+           N_STRIKES);
+    return 0;
+}
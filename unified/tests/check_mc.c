@@ -0,0 +1,131 @@
+/**
+ * check_mc.c
+ * Monte Carlo engine (heston_mc.h) against the COS engine, and its path-dependent payoffs
+ *
+ * European calls and puts priced with the QE scheme on Sobol paths have to
+ * agree with the COS engine (heston_cos_price_chain()) within a few standard
+ * errors, and do not depend on the thread count. A Bermudan put is worth at
+ * least the European put, up to sampling error, and a knock-out call at most
+ * the vanilla call.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <math.h>
+
+#include "../include/heston_mc.h"
+#include "../include/heston_cos.h"
+#include "../include/error_handling.h"
+
+#define CHECK_S 100.0
+#define CHECK_R 0.03
+#define CHECK_Q 0.01
+
+// Allowed distance to the reference, in standard errors of the estimate
+#define SE_TOLERANCE 4.0
+
+typedef struct {
+    const char* name;
+    HestonParams params;
+    double T;
+} CheckCase;
+
+static const CheckCase cases[] = {
+    {"typical", {0.04, 2.0, 0.04, 0.3, -0.7}, 0.5},
+    {"strong skew", {0.04, 1.0, 0.04, 0.8, -0.9}, 1.0},
+};
+
+static const double strikes[] = {80.0, 100.0, 120.0};
+
+#define N_CASES ((int)(sizeof(cases) / sizeof(cases[0])))
+#define N_STRIKES ((int)(sizeof(strikes) / sizeof(strikes[0])))
+
+static int failures = 0;
+
+static int mc_price(const CheckCase* c, double K, OptionType type, HestonMCPayoff payoff,
+                    double barrier, int threads, HestonMCResult* result) {
+    HestonMCConfig config;
+    heston_mc_default_config(&config);
+    config.payoff = payoff;
+    config.barrier = barrier;
+    config.threads = threads;
+
+    int status = heston_mc_price(CHECK_S, K, c->T, CHECK_R, CHECK_Q, &c->params, type, &config, result);
+    if (status != ERROR_NONE) {
+        printf("FAIL: %s, K=%g: heston_mc_price returned %d\n", c->name, K, status);
+        failures++;
+    }
+    return status;
+}
+
+// European prices against COS, and the same price on one thread and on four
+static void check_european(const CheckCase* c, OptionType type, const double* reference) {
+    const char* kind = (type == OPTION_CALL) ? "call" : "put";
+
+    for (int i = 0; i < N_STRIKES; i++) {
+        HestonMCResult mc, serial;
+        if (mc_price(c, strikes[i], type, HESTON_MC_EUROPEAN, 0.0, 4, &mc) != ERROR_NONE ||
+            mc_price(c, strikes[i], type, HESTON_MC_EUROPEAN, 0.0, 1, &serial) != ERROR_NONE) {
+            continue;
+        }
+        if (!(mc.std_error > 0.0) || fabs(mc.price - reference[i]) > SE_TOLERANCE * mc.std_error) {
+            printf("FAIL: %s, K=%g %s: MC %.6f +- %.6f, COS %.6f\n", c->name, strikes[i], kind,
+                   mc.price, mc.std_error, reference[i]);
+            failures++;
+        }
+        if (serial.price != mc.price || serial.std_error != mc.std_error) {
+            printf("FAIL: %s, K=%g %s: one thread %.10f, four threads %.10f\n", c->name, strikes[i],
+                   kind, serial.price, mc.price);
+            failures++;
+        }
+    }
+}
+
+int main(void) {
+    for (int k = 0; k < N_CASES; k++) {
+        const CheckCase* c = &cases[k];
+        double calls[N_STRIKES], puts[N_STRIKES];
+
+        if (heston_cos_price_chain(CHECK_S, c->T, CHECK_R, CHECK_Q, &c->params, strikes, N_STRIKES,
+                                   OPTION_CALL, HESTON_COS_MAX_TERMS, calls) != ERROR_NONE ||
+            heston_cos_price_chain(CHECK_S, c->T, CHECK_R, CHECK_Q, &c->params, strikes, N_STRIKES,
+                                   OPTION_PUT, HESTON_COS_MAX_TERMS, puts) != ERROR_NONE) {
+            printf("FAIL: %s: heston_cos_price_chain failed\n", c->name);
+            failures++;
+            continue;
+        }
+
+        check_european(c, OPTION_CALL, calls);
+        check_european(c, OPTION_PUT, puts);
+
+        for (int i = 0; i < N_STRIKES; i++) {
+            HestonMCResult bermudan, barrier;
+
+            // Early exercise is never worth less than holding to expiry
+            if (mc_price(c, strikes[i], OPTION_PUT, HESTON_MC_BERMUDAN, 0.0, 0, &bermudan) == ERROR_NONE &&
+                bermudan.price < puts[i] - SE_TOLERANCE * bermudan.std_error) {
+                printf("FAIL: %s, K=%g: Bermudan put %.6f +- %.6f below the European put %.6f\n",
+                       c->name, strikes[i], bermudan.price, bermudan.std_error, puts[i]);
+                failures++;
+            }
+
+            // Paths that reach the barrier lose the vanilla payoff
+            if (mc_price(c, strikes[i], OPTION_CALL, HESTON_MC_UP_AND_OUT, 1.3 * CHECK_S, 0,
+                         &barrier) == ERROR_NONE &&
+                barrier.price > calls[i] + SE_TOLERANCE * barrier.std_error) {
+                printf("FAIL: %s, K=%g: up-and-out call %.6f +- %.6f above the vanilla call %.6f\n",
+                       c->name, strikes[i], barrier.price, barrier.std_error, calls[i]);
+                failures++;
+            }
+        }
+    }
+
+    if (failures > 0) {
+        printf("check_mc: %d failures\n", failures);
+        return 1;
+    }
+    printf("check_mc: %d strikes over %d parameter sets agree with COS within %.0f standard errors\n",
+           N_STRIKES, N_CASES, SE_TOLERANCE);
+    return 0;
+}
@@ -0,0 +1,111 @@
+/**
+ * check_mixed_precision.c
+ * Single-precision screening (HestonFFTConfig.mixed_precision) against double precision only
+ *
+ * Options across moneyness and expiries, and a chain, are calibrated with
+ * the screen and without it, each from an empty grid cache. As long as the
+ * screen's error bound holds the calibrations pick the same parameters, so
+ * the volatilities have to be identical; the screen has to have dropped
+ * candidates for the comparison to mean anything.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <math.h>
+
+#include "../include/heston_fft.h"
+#include "../include/black_scholes.h"
+#include "../include/perf_stats.h"
+
+#define CHECK_S 100.0
+#define CHECK_R 0.03
+#define CHECK_Q 0.01
+
+typedef struct {
+    double K;
+    double T;
+    double vol;   /**< Black-Scholes volatility the price is quoted at */
+} CheckOption;
+
+static const CheckOption options[] = {
+    {100.0, 0.25, 0.2}, {90.0, 0.25, 0.25}, {110.0, 0.25, 0.18},
+    {80.0, 1.0, 0.3}, {120.0, 1.0, 0.2}, {100.0, 0.1, 0.35},
+    {95.0, 2.0, 0.22}, {130.0, 0.5, 0.28},
+};
+
+static const double chain_strikes[] = {85.0, 90.0, 95.0, 100.0, 105.0, 110.0, 115.0};
+#define CHAIN_T 0.5
+
+#define N_OPTIONS ((int)(sizeof(options) / sizeof(options[0])))
+#define N_CHAIN ((int)(sizeof(chain_strikes) / sizeof(chain_strikes[0])))
+
+// Calibrate every option and the chain; returns the candidates the screen dropped
+static uint64_t calibrate(bool mixed_precision, double* ivs, double* chain_ivs) {
+    HestonFFTConfig config;
+    heston_fft_get_config(&config);
+    config.mixed_precision = mixed_precision;
+    heston_fft_set_config(&config);
+
+    PerfStats before, after;
+    perf_stats_snapshot(&before);
+    for (int i = 0; i < N_OPTIONS; i++) {
+        const CheckOption* o = &options[i];
+        cleanup_fft_cache();
+        reset_fft_params_to_defaults();
+        ivs[i] = implied_vol_sv(bs_call(CHECK_S, o->K, o->T, CHECK_R, CHECK_Q, o->vol),
+                                CHECK_S, o->K, o->T, CHECK_R, CHECK_Q);
+    }
+
+    double prices[N_CHAIN];
+    for (int i = 0; i < N_CHAIN; i++) {
+        double forward = CHECK_S * exp((CHECK_R - CHECK_Q) * CHAIN_T);
+        prices[i] = bs_call(CHECK_S, chain_strikes[i], CHAIN_T, CHECK_R, CHECK_Q,
+                            0.22 - 0.2 * log(chain_strikes[i] / forward));
+    }
+    cleanup_fft_cache();
+    reset_fft_params_to_defaults();
+    heston_fft_implied_vol_chain(CHECK_S, CHAIN_T, CHECK_R, CHECK_Q, chain_strikes, prices, N_CHAIN, chain_ivs);
+    perf_stats_snapshot(&after);
+
+    return after.counters[PERF_SCREEN_REJECT] - before.counters[PERF_SCREEN_REJECT];
+}
+
+int main(void) {
+    double screened[N_OPTIONS], exact[N_OPTIONS];
+    double chain_screened[N_CHAIN], chain_exact[N_CHAIN];
+    int failures = 0;
+
+    uint64_t rejected = calibrate(true, screened, chain_screened);
+    calibrate(false, exact, chain_exact);
+
+    for (int i = 0; i < N_OPTIONS; i++) {
+        if (screened[i] != exact[i] || exact[i] <= 0.0) {
+            printf("FAIL: K=%g T=%g: screened %.12f, double precision %.12f\n",
+                   options[i].K, options[i].T, screened[i], exact[i]);
+            failures++;
+        }
+    }
+    for (int i = 0; i < N_CHAIN; i++) {
+        if (chain_screened[i] != chain_exact[i] || chain_exact[i] <= 0.0) {
+            printf("FAIL: chain K=%g: screened %.12f, double precision %.12f\n",
+                   chain_strikes[i], chain_screened[i], chain_exact[i]);
+            failures++;
+        }
+    }
+
+#if !defined(HESTON_NO_MIXED_PRECISION) && !defined(HESTON_NO_PERF_STATS)
+    if (rejected == 0) {
+        printf("FAIL: the screen dropped no candidates\n");
+        failures++;
+    }
+#endif
+
+    if (failures > 0) {
+        printf("check_mixed_precision: %d failures\n", failures);
+        return 1;
+    }
+    printf("check_mixed_precision: %d volatilities identical, %llu candidates screened out\n",
+           N_OPTIONS + N_CHAIN, (unsigned long long)rejected);
+    return 0;
+}
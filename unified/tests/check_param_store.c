@@ -0,0 +1,165 @@
+/**
+ * check_param_store.c
+ * Parameter store (heston_param_store.h) saved by several processes at once
+ *
+ * Every child process opens the empty store, waits until all of them have
+ * it open, then records its own ticker and saves. Read back, the file has
+ * to hold the calibration of every child. A store opened before the
+ * children saved then records one more ticker: its save must keep theirs.
+ * No temporary file may be left next to the store.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/wait.h>
+
+#include "../include/heston_param_store.h"
+
+#define N_WRITERS 8
+#define CHECK_T 0.25
+
+static int failures = 0;
+
+static void writer_params(int i, HestonParams* params) {
+    params->v0 = 0.04;
+    params->kappa = 1.0 + i;
+    params->theta = 0.04;
+    params->sigma = 0.3;
+    params->rho = -0.7;
+}
+
+// Open the store, wait for the go, then record ticker W<i> and save
+static int run_writer(const char* path, int i, int go) {
+    HestonParamStore* store = heston_param_store_open(path);
+    char ticker[HESTON_PARAM_TICKER_LEN];
+    char c;
+    HestonParams params;
+
+    snprintf(ticker, sizeof(ticker), "W%d", i);
+    writer_params(i, &params);
+    if (store == NULL || read(go, &c, 1) != 0) {
+        return 1;
+    }
+    int ret = heston_param_store_update(store, ticker, CHECK_T, &params, 0.001) != 0 ||
+              heston_param_store_save(store) != 0;
+    heston_param_store_close(store);
+    return ret;
+}
+
+static void check_writers(const HestonParamStore* store) {
+    for (int i = 0; i < N_WRITERS; i++) {
+        char ticker[HESTON_PARAM_TICKER_LEN];
+        HestonParams params;
+
+        snprintf(ticker, sizeof(ticker), "W%d", i);
+        writer_params(i, &params);
+        const HestonParamEntry* entry = heston_param_store_lookup(store, ticker, CHECK_T);
+        if (entry == NULL || entry->params.kappa != params.kappa) {
+            printf("FAIL: the calibration of %s was lost\n", ticker);
+            failures++;
+        }
+    }
+}
+
+static int count_files(const char* dir) {
+    DIR* d = opendir(dir);
+    int count = 0;
+    if (d == NULL) {
+        return -1;
+    }
+    for (struct dirent* e = readdir(d); e != NULL; e = readdir(d)) {
+        if (strcmp(e->d_name, ".") != 0 && strcmp(e->d_name, "..") != 0) {
+            count++;
+        }
+    }
+    closedir(d);
+    return count;
+}
+
+int main(void) {
+    char dir[] = "/tmp/check_param_store_XXXXXX";
+    if (mkdtemp(dir) == NULL) {
+        printf("FAIL: could not create a directory\n");
+        return 1;
+    }
+    char path[sizeof(dir) + 16];
+    char lock_path[sizeof(path) + 8];
+    snprintf(path, sizeof(path), "%s/params.bin", dir);
+    snprintf(lock_path, sizeof(lock_path), "%s.lock", path);
+
+    HestonParamStore* stale = heston_param_store_open(path);
+    int go[2];
+    if (stale == NULL || pipe(go) != 0) {
+        printf("FAIL: setup\n");
+        rmdir(dir);
+        return 1;
+    }
+
+    // The children block on the pipe until the parent closes its end
+    for (int i = 0; i < N_WRITERS; i++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(go[1]);
+            _exit(run_writer(path, i, go[0]));
+        }
+        if (pid < 0) {
+            printf("FAIL: fork\n");
+            failures++;
+        }
+    }
+    close(go[0]);
+    close(go[1]);
+
+    int status;
+    while (wait(&status) > 0) {
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            printf("FAIL: a writer could not save\n");
+            failures++;
+        }
+    }
+
+    HestonParamStore* store = heston_param_store_open(path);
+    check_writers(store);
+    heston_param_store_close(store);
+
+    HestonParams params;
+    writer_params(N_WRITERS, &params);
+    if (heston_param_store_update(stale, "STALE", CHECK_T, &params, 0.001) != 0 ||
+        heston_param_store_save(stale) != 0) {
+        printf("FAIL: the stale store could not save\n");
+        failures++;
+    }
+    heston_param_store_close(stale);
+
+    store = heston_param_store_open(path);
+    check_writers(store);
+    if (heston_param_store_lookup(store, "STALE", CHECK_T) == NULL) {
+        printf("FAIL: the stale store's own calibration was not saved\n");
+        failures++;
+    }
+    heston_param_store_close(store);
+
+    // The store and its lock file
+    int files = count_files(dir);
+    if (files != 2) {
+        printf("FAIL: %d files next to the store, expected it and its lock file\n", files);
+        failures++;
+    }
+
+    remove(path);
+    remove(lock_path);
+    rmdir(dir);
+
+    if (failures > 0) {
+        printf("check_param_store: %d failures\n", failures);
+        return 1;
+    }
+    printf("check_param_store: %d concurrent saves and a stale store kept every calibration\n",
+           N_WRITERS + 1);
+    return 0;
+}
@@ -0,0 +1,99 @@
+/**
+ * check_spot_invariant.c
+ * Spot-invariant FFT grids (HestonFFTConfig.spot_invariant) against the default mode
+ *
+ * A book of strikes on two expiries is priced with heston_call_fft() over
+ * a series of spot ticks in both modes. The prices have to agree to
+ * rounding, and in spot-invariant mode the ticks after the first have to be
+ * answered from the cached unit-spot grids.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <math.h>
+
+#include "../include/heston_fft.h"
+#include "../include/fft_cache.h"
+
+#define CHECK_R 0.03
+#define CHECK_Q 0.01
+
+// Largest price difference relative to the spot
+#define PRICE_TOLERANCE 1e-10
+
+#define N_TICKS 11
+
+static const double strikes[] = {90.0, 95.0, 100.0, 105.0, 110.0};
+static const double expiries[] = {0.25, 1.0};
+static const HestonParams params = {0.04, 2.0, 0.04, 0.3, -0.7};
+
+#define N_STRIKES ((int)(sizeof(strikes) / sizeof(strikes[0])))
+#define N_EXPIRIES ((int)(sizeof(expiries) / sizeof(expiries[0])))
+#define N_PRICES (N_TICKS * N_EXPIRIES * N_STRIKES)
+
+static double tick_spot(int t) {
+    return 98.0 + 0.37 * t;
+}
+
+// Price the book over every tick; returns the cache misses it took
+static unsigned long price_book(bool spot_invariant, double* prices) {
+    HestonFFTConfig config;
+    heston_fft_get_config(&config);
+    config.spot_invariant = spot_invariant;
+    heston_fft_set_config(&config);
+    cleanup_fft_cache();
+    reset_fft_params_to_defaults();
+
+    FFTCacheStats before, after;
+    heston_fft_get_cache_stats(&before);
+    int n = 0;
+    for (int t = 0; t < N_TICKS; t++) {
+        for (int e = 0; e < N_EXPIRIES; e++) {
+            for (int i = 0; i < N_STRIKES; i++) {
+                prices[n++] = heston_call_fft(tick_spot(t), strikes[i], expiries[e], CHECK_R, CHECK_Q,
+                                              params.v0, params.kappa, params.theta, params.sigma, params.rho);
+            }
+        }
+    }
+    heston_fft_get_cache_stats(&after);
+    return after.misses - before.misses;
+}
+
+int main(void) {
+    static double scaled[N_PRICES], invariant[N_PRICES];
+    int failures = 0;
+
+    unsigned long scaled_misses = price_book(false, scaled);
+    unsigned long invariant_misses = price_book(true, invariant);
+
+    double worst = 0.0;
+    for (int t = 0, n = 0; t < N_TICKS; t++) {
+        for (int e = 0; e < N_EXPIRIES; e++) {
+            for (int i = 0; i < N_STRIKES; i++, n++) {
+                double error = fabs(invariant[n] - scaled[n]) / tick_spot(t);
+                worst = fmax(worst, error);
+                if (!(scaled[n] > 0.0) || error > PRICE_TOLERANCE) {
+                    printf("FAIL: S=%g K=%g T=%g: default %.12f, spot-invariant %.12f\n",
+                           tick_spot(t), strikes[i], expiries[e], scaled[n], invariant[n]);
+                    failures++;
+                }
+            }
+        }
+    }
+
+    // One grid per expiry, however many ticks follow
+    if (invariant_misses > (unsigned long)N_EXPIRIES || invariant_misses >= scaled_misses) {
+        printf("FAIL: spot-invariant mode built %lu grids, the default mode %lu\n",
+               invariant_misses, scaled_misses);
+        failures++;
+    }
+
+    if (failures > 0) {
+        printf("check_spot_invariant: %d failures\n", failures);
+        return 1;
+    }
+    printf("check_spot_invariant: %d prices agree to %.1e of the spot, %lu grids instead of %lu\n",
+           N_PRICES, worst, invariant_misses, scaled_misses);
+    return 0;
+}
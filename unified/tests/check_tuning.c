@@ -0,0 +1,171 @@
+/**
+ * check_tuning.c
+ * FFT tuning table (fft_tuning.h): loading, lookups and the accuracy of its settings
+ *
+ * tests/fft_tuning_sample.txt is a small table written by bench/tune_fft
+ * (--expiries 0.1,0.25,1 --moneyness 0.1,0.3 --vols 0.3,0.6). It has to
+ * load, survive a save and reload unchanged, and place options in the
+ * buckets its edges describe. With the table loaded, heston_call_fft() has
+ * to price options inside every bucket, between the edges the sweep sampled,
+ * within the table's error target of the converged COS price.
+ *
+ * Usage: check_tuning [TABLE], run from the unified directory by make test
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "../include/heston_fft.h"
+#include "../include/heston_cos.h"
+#include "../include/fft_tuning.h"
+
+#define DEFAULT_TABLE "tests/fft_tuning_sample.txt"
+
+// Market of the sweep; errors are relative to the spot like the table's
+#define CHECK_S 100.0
+#define CHECK_R 0.03
+#define CHECK_Q 0.01
+
+// Parameter shapes of the sweep; v0 and theta are set from the volatility level
+static const double shapes[][3] = {
+    {1.0, 0.4, -0.7},
+    {3.0, 0.8, -0.7},
+    {0.5, 0.2, 0.0},
+};
+
+#define N_SHAPES ((int)(sizeof(shapes) / sizeof(shapes[0])))
+
+static int failures = 0;
+
+// The middle of bucket i of an axis, whose lower edge is 0 for the first bucket
+static double bucket_middle(const double* edges, int i) {
+    return 0.5 * ((i > 0 ? edges[i - 1] : 0.0) + edges[i]);
+}
+
+static bool same_table(const FFTTuningTable* a, const FFTTuningTable* b) {
+    if (a->num_expiries != b->num_expiries || a->num_moneyness != b->num_moneyness ||
+        a->num_vols != b->num_vols || a->target != b->target ||
+        memcmp(a->expiries, b->expiries, (size_t)a->num_expiries * sizeof(double)) != 0 ||
+        memcmp(a->moneyness, b->moneyness, (size_t)a->num_moneyness * sizeof(double)) != 0 ||
+        memcmp(a->vols, b->vols, (size_t)a->num_vols * sizeof(double)) != 0) {
+        return false;
+    }
+    size_t n = (size_t)a->num_expiries * (size_t)a->num_moneyness * (size_t)a->num_vols;
+    for (size_t i = 0; i < n; i++) {
+        const FFTTuningEntry* x = &a->entries[i];
+        const FFTTuningEntry* y = &b->entries[i];
+        if (x->fft_n != y->fft_n || fabs(x->eta - y->eta) > 1e-9 * x->eta ||
+            fabs(x->alpha - y->alpha) > 1e-9 * x->alpha ||
+            fabs(x->log_strike_range - y->log_strike_range) > 1e-9 * x->log_strike_range ||
+            fabs(x->max_error - y->max_error) > 1e-3 * x->max_error) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Round trip through fft_tuning_save() and the bucket lookups
+static void check_table(const FFTTuningTable* table) {
+    char path[] = "/tmp/check_tuning_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        printf("FAIL: no temporary file for the round trip\n");
+        failures++;
+        return;
+    }
+    FFTTuningTable* reloaded = NULL;
+    if (fft_tuning_save(table, path) != 0 || (reloaded = fft_tuning_load(path)) == NULL ||
+        !same_table(table, reloaded)) {
+        printf("FAIL: the table changed on a save and reload\n");
+        failures++;
+    }
+    fft_tuning_free(reloaded);
+    remove(path);
+
+    for (int e = 0; e < table->num_expiries; e++) {
+        for (int m = 0; m < table->num_moneyness; m++) {
+            for (int v = 0; v < table->num_vols; v++) {
+                const FFTTuningEntry* entry = fft_tuning_lookup(table, table->expiries[e],
+                                                                -table->moneyness[m], table->vols[v]);
+                if (entry != fft_tuning_entry(table, e, m, v) || entry->fft_n == 0) {
+                    printf("FAIL: the upper edges of bucket (%d, %d, %d) look up another entry\n", e, m, v);
+                    failures++;
+                }
+            }
+        }
+    }
+
+    double last_T = table->expiries[table->num_expiries - 1];
+    double last_m = table->moneyness[table->num_moneyness - 1];
+    double last_vol = table->vols[table->num_vols - 1];
+    if (fft_tuning_lookup(table, last_T * 1.01, 0.0, 0.1) != NULL ||
+        fft_tuning_lookup(table, 0.05, last_m * 1.01, 0.1) != NULL ||
+        fft_tuning_lookup(table, 0.05, 0.0, last_vol * 1.01) != NULL) {
+        printf("FAIL: options beyond the last edges are covered\n");
+        failures++;
+    }
+}
+
+// heston_call_fft() on the loaded table against COS, inside every bucket
+static double check_prices(const FFTTuningTable* table) {
+    double worst = 0.0;
+
+    for (int e = 0; e < table->num_expiries; e++) {
+        double T = bucket_middle(table->expiries, e);
+        for (int m = 0; m < table->num_moneyness; m++) {
+            double log_moneyness = bucket_middle(table->moneyness, m);
+            for (int v = 0; v < table->num_vols; v++) {
+                double vol = bucket_middle(table->vols, v);
+                for (int s = 0; s < N_SHAPES; s++) {
+                    HestonParams params = {vol * vol, shapes[s][0], vol * vol, shapes[s][1], shapes[s][2]};
+                    for (int side = -1; side <= 1; side += 2) {
+                        double K = CHECK_S * exp(side * log_moneyness);
+                        double cos_price;
+                        reset_fft_params_to_defaults();
+                        double fft = heston_call_fft(CHECK_S, K, T, CHECK_R, CHECK_Q, params.v0, params.kappa,
+                                                     params.theta, params.sigma, params.rho);
+                        heston_cos_price_chain(CHECK_S, T, CHECK_R, CHECK_Q, &params, &K, 1, OPTION_CALL,
+                                               HESTON_COS_MAX_TERMS, &cos_price);
+                        double error = fabs(fft - cos_price) / CHECK_S;
+                        worst = fmax(worst, error);
+                        if (error > table->target) {
+                            printf("FAIL: T=%g K=%g vol=%g shape %d: FFT %.8f, COS %.8f, error %.2e\n",
+                                   T, K, vol, s, fft, cos_price, error);
+                            failures++;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return worst;
+}
+
+int main(int argc, char* argv[]) {
+    const char* path = argc > 1 ? argv[1] : DEFAULT_TABLE;
+
+    FFTTuningTable* table = fft_tuning_load(path);
+    if (table == NULL || heston_fft_load_tuning(path) != 0) {
+        printf("FAIL: %s does not load\n", path);
+        fft_tuning_free(table);
+        return 1;
+    }
+
+    check_table(table);
+    double worst = check_prices(table);
+    heston_fft_load_tuning(NULL);
+
+    if (failures > 0) {
+        printf("check_tuning: %d failures\n", failures);
+        fft_tuning_free(table);
+        return 1;
+    }
+    printf("check_tuning: every bucket prices within %.0e of the spot (largest error %.1e)\n",
+           table->target, worst);
+    fft_tuning_free(table);
+    return 0;
+}
@@ -0,0 +1,98 @@
+#!/usr/bin/env python3
+#
+# stub_market_server.py - Local stand-in for the Alpha Vantage API, used by
+# the market data tests through ALPHAVANTAGE_BASE_URL
+#
+# Usage: stub_market_server.py PORT_FILE LOG_FILE
+#
+# Listens on a free port of 127.0.0.1 and writes it to PORT_FILE. LOG_FILE
+# gets one "CONN" line per accepted connection and one "REQ <function>
+# <symbol>" line per request. Prices are 100 plus the length of the symbol;
+# the symbol THROTTLE is answered with an over-quota note, and the symbol
+# SLOW two seconds late.
+#
+
+import datetime
+import json
+import math
+import os
+import sys
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from urllib.parse import parse_qs, urlparse
+
+LOG_LOCK = threading.Lock()
+
+
+def log(line):
+    with LOG_LOCK:
+        with open(LOG_FILE, "a") as f:
+            f.write(line + "\n")
+
+
+def daily_series(symbol, days, adjusted):
+    """Daily bars ending yesterday, closes alternating around the price"""
+    price = 100.0 + len(symbol)
+    series = {}
+    day = datetime.date.today()
+    for i in range(days):
+        day -= datetime.timedelta(days=1)
+        close = price * math.exp(0.01 if i % 2 else -0.01)
+        bar = {
+            "1. open": "%.4f" % price,
+            "2. high": "%.4f" % max(price, close),
+            "3. low": "%.4f" % min(price, close),
+            "4. close": "%.4f" % close,
+        }
+        bar["6. volume" if adjusted else "5. volume"] = "1000"
+        series[day.isoformat()] = bar
+    return {"Time Series (Daily)": series}
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"  # Keep-alive, so connection reuse shows in the log
+
+    def setup(self):
+        super().setup()
+        log("CONN")
+
+    def log_message(self, format, *args):
+        pass
+
+    def do_GET(self):
+        query = parse_qs(urlparse(self.path).query)
+        function = query.get("function", [""])[0]
+        symbol = query.get("symbol", [""])[0]
+        log("REQ %s %s" % (function, symbol))
+        if symbol == "SLOW":
+            time.sleep(2)
+
+        if symbol == "THROTTLE":
+            body = '{"Note": "Thank you for using Alpha Vantage! Our standard API call frequency is 5 calls per minute."}'
+        elif function == "GLOBAL_QUOTE":
+            body = '{"Global Quote": {"01. symbol": "%s", "05. price": "%.4f"}}' % (symbol, 100.0 + len(symbol))
+        elif function == "OVERVIEW":
+            body = '{"Symbol": "%s", "DividendYield": "0.0125"}' % symbol
+        elif function in ("TIME_SERIES_DAILY", "TIME_SERIES_DAILY_ADJUSTED"):
+            days = 100 if query.get("outputsize", ["compact"])[0] == "compact" else 400
+            body = json.dumps(daily_series(symbol, days, function.endswith("ADJUSTED")))
+        else:
+            self.send_error(404)
+            return
+
+        data = body.encode()
+        self.send_response(200)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(data)))
+        self.end_headers()
+        self.wfile.write(data)
+
+
+if __name__ == "__main__":
+    port_file, LOG_FILE = sys.argv[1], sys.argv[2]
+    server = ThreadingHTTPServer(("127.0.0.1", 0), Handler)
+    with open(port_file + ".tmp", "w") as f:
+        f.write("%d\n" % server.server_address[1])
+    os.rename(port_file + ".tmp", port_file)
+    server.serve_forever()
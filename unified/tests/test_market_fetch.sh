@@ -0,0 +1,237 @@
+#!/bin/bash
+#
+# test_market_fetch.sh - Test the pooled market data fetch and the request
+# quotas against a local stub provider (tests/stub_market_server.py)
+#
+
+# Get script directory
+SCRIPT_DIR="$( cd "$( dirname "${BASH_SOURCE[0]}" )" && pwd )"
+PROJECT_ROOT="$(dirname "$(dirname "$SCRIPT_DIR")")"
+UNIFIED_ROOT="$PROJECT_ROOT/unified"
+BINARY_DIR="$UNIFIED_ROOT/bin"
+PRICER_BIN="$BINARY_DIR/unified_pricer"
+MARKET_TOOL="$BINARY_DIR/market_data_tool"
+
+# Color codes
+GREEN='\033[0;32m'
+RED='\033[0;31m'
+YELLOW='\033[1;33m'
+NC='\033[0m' # No Color
+
+# Check if binaries exist
+for bin in "$PRICER_BIN" "$MARKET_TOOL"; do
+    if [ ! -x "$bin" ]; then
+        echo -e "${RED}Error: $bin not found or not executable.${NC}"
+        echo "Have you built the project? Try running 'make -f Makefile.unified' in the unified directory."
+        exit 1
+    fi
+done
+
+if ! command -v python3 >/dev/null 2>&1; then
+    echo -e "${YELLOW}Skipping: python3 is needed for the stub provider.${NC}"
+    exit 0
+fi
+
+WORK_DIR="$(mktemp -d)"
+STUB_LOG="$WORK_DIR/requests.log"
+python3 "$SCRIPT_DIR/stub_market_server.py" "$WORK_DIR/port" "$STUB_LOG" &
+STUB_PID=$!
+trap 'kill $STUB_PID 2>/dev/null; rm -rf "$WORK_DIR"' EXIT
+
+for i in $(seq 50); do
+    [ -s "$WORK_DIR/port" ] && break
+    sleep 0.1
+done
+if [ ! -s "$WORK_DIR/port" ]; then
+    echo -e "${RED}Error: stub provider did not start.${NC}"
+    exit 1
+fi
+STUB_URL="http://127.0.0.1:$(cat "$WORK_DIR/port")"
+
+# Give a test a HOME of its own, with a config pointing at the stub
+# Usage: new_home NAME [CONFIG_LINE...]
+new_home() {
+    local home="$WORK_DIR/$1"
+    shift
+    mkdir -p "$home/.config/option_tools" "$home/.cache/market_data"
+    {
+        echo "ALPHAVANTAGE_API_KEY=test"
+        echo "ALPHAVANTAGE_BASE_URL=$STUB_URL"
+        for line in "$@"; do
+            echo "$line"
+        done
+    } > "$home/.config/option_tools/market_data.conf"
+    # The Treasury is not stubbed; its cached rate answers instead
+    echo "0.018500" > "$home/.cache/market_data/treasury_3month.cache"
+    echo "$home"
+}
+
+count_log() {
+    grep -c "^$1" "$STUB_LOG" 2>/dev/null || true
+}
+
+# Function to run a test and report result
+run_test() {
+    local test_name="$1"
+    local command="$2"
+    local expected_output="$3"
+
+    echo -e "\n${YELLOW}Running test: ${test_name}${NC}"
+    echo "Command: $command"
+
+    result=$(eval "$command" 2>&1)
+    exit_code=$?
+
+    if [ $exit_code -ne 0 ]; then
+        echo -e "${RED}FAIL: Command failed with exit code $exit_code${NC}"
+        echo "Output: $result"
+        return 1
+    fi
+
+    if echo "$result" | grep -q -- "$expected_output"; then
+        echo -e "${GREEN}PASS: Output contains expected value${NC}"
+    else
+        echo -e "${RED}FAIL: Output does not contain expected value${NC}"
+        echo "Expected: $expected_output"
+        echo "Actual: $result"
+        return 1
+    fi
+
+    return 0
+}
+
+# Check the number of requests (and connections) the stub saw since the mark
+# Usage: check_counts TEST_NAME EXPECTED_REQUESTS [MAX_CONNECTIONS]
+check_counts() {
+    local requests=$(( $(count_log REQ) - MARK_REQ ))
+    local connections=$(( $(count_log CONN) - MARK_CONN ))
+
+    echo -e "\n${YELLOW}Running test: $1${NC}"
+    echo "Requests: $requests, connections: $connections"
+    if [ "$requests" -ne "$2" ]; then
+        echo -e "${RED}FAIL: Expected $2 requests${NC}"
+        return 1
+    fi
+    if [ -n "$3" ] && [ "$connections" -gt "$3" ]; then
+        echo -e "${RED}FAIL: Expected at most $3 connections${NC}"
+        return 1
+    fi
+    echo -e "${GREEN}PASS: Request count as expected${NC}"
+    return 0
+}
+
+mark() {
+    MARK_REQ=$(count_log REQ)
+    MARK_CONN=$(count_log CONN)
+    MARK_TIME=$(date +%s)
+}
+
+# Check that the commands since the mark took at most MAX_SECONDS
+# Usage: check_elapsed TEST_NAME MAX_SECONDS
+check_elapsed() {
+    local elapsed=$(( $(date +%s) - MARK_TIME ))
+
+    echo -e "\n${YELLOW}Running test: $1${NC}"
+    echo "Elapsed: ${elapsed}s"
+    if [ "$elapsed" -gt "$2" ]; then
+        echo -e "${RED}FAIL: Expected at most $2 seconds${NC}"
+        return 1
+    fi
+    echo -e "${GREEN}PASS: Within the time limit${NC}"
+    return 0
+}
+
+TESTS_TOTAL=0
+TESTS_FAILED=0
+
+record_test() {
+    TESTS_TOTAL=$((TESTS_TOTAL + 1))
+    if [ $1 -ne 0 ]; then
+        TESTS_FAILED=$((TESTS_FAILED + 1))
+    fi
+}
+
+TICKERS="AAA BBBB CCCCC DDDDDD EEEEEEE FFFFFFFF GGGGGGGGG HHHHHHHHHH"
+
+# A snapshot of 8 tickers is 24 transfers on the pooled handles, over at most
+# MAX_HOST_CONNECTIONS (6) keep-alive connections
+HOME_DIR=$(new_home pooled "ALPHAVANTAGE_REQUESTS_PER_MINUTE=0")
+mark
+run_test "Pooled snapshot" "HOME=$HOME_DIR $MARKET_TOOL snapshot 30 1 $TICKERS" "HHHHHHHHHH 110.000000 0.012500"
+record_test $?
+check_counts "Pooled snapshot requests" 24 6
+record_test $?
+
+# Everything is cached now
+mark
+run_test "Cached snapshot" "HOME=$HOME_DIR $MARKET_TOOL snapshot 30 1 $TICKERS" "AAA 103.000000 0.012500"
+record_test $?
+check_counts "Cached snapshot requests" 0
+record_test $?
+
+# Two requests a minute: the quota file is shared by separate processes, so
+# the third lookup is refused without a request
+HOME_DIR=$(new_home quota "ALPHAVANTAGE_REQUESTS_PER_MINUTE=2" "RATE_LIMIT_WAIT_SECONDS=0" "CACHE_STALE_SECONDS=0")
+mark
+run_test "Quota: first request" "HOME=$HOME_DIR $MARKET_TOOL price QA" "102.000000"
+record_test $?
+run_test "Quota: second request" "HOME=$HOME_DIR $MARKET_TOOL price QBB" "103.000000"
+record_test $?
+run_test "Quota: third request is rate limited" "HOME=$HOME_DIR $MARKET_TOOL price QCCC; true" "Error -112"
+record_test $?
+check_counts "Quota requests" 2
+record_test $?
+
+# Twenty requests a minute, so the 24 transfers of a snapshot find 20 tokens
+# and then one every 3 seconds. The wait is bounded per batch: the 21st
+# transfer starts once its token is due, while the last three are refused
+# instead of waiting 12 seconds in turn
+HOME_DIR=$(new_home spread "ALPHAVANTAGE_REQUESTS_PER_MINUTE=20" "RATE_LIMIT_WAIT_SECONDS=4" "CACHE_STALE_SECONDS=0")
+mark
+run_test "Quota: snapshot beyond the quota" "HOME=$HOME_DIR $MARKET_TOOL snapshot 30 1 $TICKERS; true" "Error -112"
+record_test $?
+check_counts "Quota: snapshot requests" 21
+record_test $?
+check_elapsed "Quota: snapshot wait" 6
+record_test $?
+
+# An over-quota answer empties the bucket: the next lookup is not sent
+HOME_DIR=$(new_home throttle "ALPHAVANTAGE_REQUESTS_PER_MINUTE=60" "RATE_LIMIT_WAIT_SECONDS=0" "CACHE_STALE_SECONDS=0")
+mark
+run_test "Throttle: over-quota note" "HOME=$HOME_DIR $MARKET_TOOL price THROTTLE; true" "Error -112"
+record_test $?
+run_test "Throttle: provider paused" "HOME=$HOME_DIR $MARKET_TOOL price TA; true" "Error -112"
+record_test $?
+check_counts "Throttle requests" 1
+record_test $?
+
+# Historical volatility: the download fills the bar store, which answers
+# other windows without a request
+HOME_DIR=$(new_home history "ALPHAVANTAGE_REQUESTS_PER_MINUTE=0")
+mark
+run_test "Volatility: download" "HOME=$HOME_DIR $MARKET_TOOL volatility HIST 30 1" "^0\\.[0-9]"
+record_test $?
+run_test "Volatility: from the bar store" "HOME=$HOME_DIR $MARKET_TOOL volatility HIST 20 1" "^0\\.[0-9]"
+record_test $?
+check_counts "Volatility requests" 1
+record_test $?
+
+# Historical prices: the download fills the bar store, which answers the next call
+HOME_DIR=$(new_home prices "ALPHAVANTAGE_REQUESTS_PER_MINUTE=0")
+mark
+run_test "History: download" "HOME=$HOME_DIR $PRICER_BIN --get-historical-prices HIST 20 1" ",10[0-9]\\."
+record_test $?
+run_test "History: from the bar store" "HOME=$HOME_DIR $PRICER_BIN --get-historical-prices HIST 10 1" ",10[0-9]\\."
+record_test $?
+check_counts "History requests" 1
+record_test $?
+
+# Print summary
+echo -e "\n${YELLOW}===============================================${NC}"
+echo -e "Total tests:  $TESTS_TOTAL"
+if [ $TESTS_FAILED -gt 0 ]; then
+    echo -e "${RED}Tests failed: $TESTS_FAILED${NC}"
+    exit 1
+fi
+echo -e "${GREEN}All tests passed!${NC}"
+exit 0
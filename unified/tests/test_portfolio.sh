@@ -0,0 +1,189 @@
+#!/bin/bash
+#
+# test_portfolio.sh - Test the portfolio revaluation (unified_pricer
+# --portfolio) with market data from a local stub provider
+# (tests/stub_market_server.py)
+#
+
+# Get script directory
+SCRIPT_DIR="$( cd "$( dirname "${BASH_SOURCE[0]}" )" && pwd )"
+PROJECT_ROOT="$(dirname "$(dirname "$SCRIPT_DIR")")"
+UNIFIED_ROOT="$PROJECT_ROOT/unified"
+BINARY_DIR="$UNIFIED_ROOT/bin"
+PRICER_BIN="$BINARY_DIR/unified_pricer"
+
+# Color codes
+GREEN='\033[0;32m'
+RED='\033[0;31m'
+YELLOW='\033[1;33m'
+NC='\033[0m' # No Color
+
+# Check if binary exists
+if [ ! -x "$PRICER_BIN" ]; then
+    echo -e "${RED}Error: $PRICER_BIN not found or not executable.${NC}"
+    echo "Have you built the project? Try running 'make -f Makefile.unified' in the unified directory."
+    exit 1
+fi
+
+if ! command -v python3 >/dev/null 2>&1; then
+    echo -e "${YELLOW}Skipping: python3 is needed for the stub provider.${NC}"
+    exit 0
+fi
+
+WORK_DIR="$(mktemp -d)"
+STUB_LOG="$WORK_DIR/requests.log"
+python3 "$SCRIPT_DIR/stub_market_server.py" "$WORK_DIR/port" "$STUB_LOG" &
+STUB_PID=$!
+trap 'kill $STUB_PID 2>/dev/null; rm -rf "$WORK_DIR"' EXIT
+
+for i in $(seq 50); do
+    [ -s "$WORK_DIR/port" ] && break
+    sleep 0.1
+done
+if [ ! -s "$WORK_DIR/port" ]; then
+    echo -e "${RED}Error: stub provider did not start.${NC}"
+    exit 1
+fi
+
+# A HOME with a config pointing at the stub; the Treasury is not stubbed, so
+# the rates of the terms used below are cached
+HOME_DIR="$WORK_DIR/home"
+mkdir -p "$HOME_DIR/.config/option_tools" "$HOME_DIR/.cache/market_data"
+cat > "$HOME_DIR/.config/option_tools/market_data.conf" <<EOF
+ALPHAVANTAGE_API_KEY=test
+ALPHAVANTAGE_BASE_URL=http://127.0.0.1:$(cat "$WORK_DIR/port")
+ALPHAVANTAGE_REQUESTS_PER_MINUTE=0
+RATE_LIMIT_WAIT_SECONDS=0
+EOF
+echo "0.018500" > "$HOME_DIR/.cache/market_data/treasury_3month.cache"
+echo "0.021000" > "$HOME_DIR/.cache/market_data/treasury_6month.cache"
+
+# Three positions on one ticker and expiry share a grid; the call and put at
+# 100 make a put-call parity check
+cat > "$WORK_DIR/positions.csv" <<EOF
+ticker,type,strike,expiry,quantity
+# Front month
+AAA,call,100,0.25,10
+AAA,put,100,0.25,-5
+AAA,call,110,0.25,2
+
+BBBB,put,95,0.5,3
+BAD,row
+AAA,call,100,2020-01-01,1
+EOF
+
+cat > "$WORK_DIR/failing.csv" <<EOF
+ticker,type,strike,expiry,quantity
+AAA,call,100,0.25,1
+THROTTLE,call,100,0.25,1
+EOF
+
+PORTFOLIO="HOME=$HOME_DIR $PRICER_BIN --portfolio"
+
+# Function to run a test and report result
+run_test() {
+    local test_name="$1"
+    local command="$2"
+    local expected_output="$3"
+
+    echo -e "\n${YELLOW}Running test: ${test_name}${NC}"
+    echo "Command: $command"
+
+    result=$(eval "$command" 2>&1)
+    exit_code=$?
+
+    if [ $exit_code -ne 0 ]; then
+        echo -e "${RED}FAIL: Command failed with exit code $exit_code${NC}"
+        echo "Output: $result"
+        return 1
+    fi
+
+    if echo "$result" | grep -q -- "$expected_output"; then
+        echo -e "${GREEN}PASS: Output contains expected value${NC}"
+    else
+        echo -e "${RED}FAIL: Output does not contain expected value${NC}"
+        echo "Expected: $expected_output"
+        echo "Actual: $result"
+        return 1
+    fi
+
+    return 0
+}
+
+TESTS_TOTAL=0
+TESTS_FAILED=0
+
+record_test() {
+    TESTS_TOTAL=$((TESTS_TOTAL + 1))
+    if [ $1 -ne 0 ]; then
+        TESTS_FAILED=$((TESTS_FAILED + 1))
+    fi
+}
+
+run_test "Every position priced" \
+    "$PORTFOLIO $WORK_DIR/positions.csv --threads 2" \
+    "^TOTAL,4,0,"
+record_test $?
+
+run_test "Malformed rows skipped" \
+    "$PORTFOLIO $WORK_DIR/positions.csv 2>&1 >/dev/null" \
+    "Skipping malformed position row 8"
+record_test $?
+
+run_test "Expired positions skipped" \
+    "$PORTFOLIO $WORK_DIR/positions.csv 2>&1 >/dev/null" \
+    "Skipping expired position in row 9"
+record_test $?
+
+run_test "Spot and dividend from the provider" \
+    "$PORTFOLIO $WORK_DIR/positions.csv 2>/dev/null" \
+    "^BBBB,put,95.000000,0.500000,3,104.000000,0.012500,"
+record_test $?
+
+run_test "Treasury rate per expiry" \
+    "$PORTFOLIO $WORK_DIR/positions.csv 2>/dev/null | cut -d, -f1,4,9" \
+    "^BBBB,0.500000,0.021000$"
+record_test $?
+
+run_test "--rate for every position" \
+    "$PORTFOLIO $WORK_DIR/positions.csv --rate 0.045 2>/dev/null | grep -c '^[A-Z]*,[a-z]*,.*,0.045000,'" \
+    "^4$"
+record_test $?
+
+# Each distinct request is made once: the first run fetched every ticker's
+# quote, overview and daily series, the later ones answered from the cache
+run_test "Market data fetched once per ticker" \
+    "grep -c '^REQ ' $STUB_LOG" \
+    "^6$"
+record_test $?
+
+# value = quantity * price, and the AAA call and put at 100 satisfy parity
+run_test "Values and put-call parity" \
+    "$PORTFOLIO $WORK_DIR/positions.csv 2>/dev/null | awk -F, '
+        \$17 == \"0\" { if (\$16 - \$5 * \$10 > 1e-4 || \$5 * \$10 - \$16 > 1e-4) bad++ }
+        \$1 == \"AAA\" && \$3 == 100 && \$2 == \"call\" { c = \$10; s = \$6; q = \$7; r = \$9; t = \$4 }
+        \$1 == \"AAA\" && \$3 == 100 && \$2 == \"put\" { p = \$10 }
+        END { d = c - p - (s * exp(-q * t) - 100 * exp(-r * t)); if (d < 0) d = -d
+              print (bad == 0 && d < 1e-3) ? \"consistent\" : \"inconsistent \" d }'" \
+    "^consistent$"
+record_test $?
+
+run_test "Failed position reported" \
+    "$PORTFOLIO $WORK_DIR/failing.csv 2>/dev/null; true" \
+    "^THROTTLE,call,.*,-112$"
+record_test $?
+
+run_test "Exit status 1 when a position fails" \
+    "$PORTFOLIO $WORK_DIR/failing.csv >/dev/null 2>&1; echo status \$?" \
+    "status 1"
+record_test $?
+
+# Print summary
+echo -e "\n${YELLOW}===============================================${NC}"
+echo -e "Total tests:  $TESTS_TOTAL"
+if [ $TESTS_FAILED -gt 0 ]; then
+    echo -e "${RED}Tests failed: $TESTS_FAILED${NC}"
+    exit 1
+fi
+echo -e "${GREEN}All tests passed!${NC}"
+exit 0
@@ -0,0 +1,278 @@
+#!/bin/bash
+#
+# test_server.sh - Test the JSON-lines pricing server (unified_pricer --server)
+# over a unix socket
+#
+
+# Get script directory
+SCRIPT_DIR="$( cd "$( dirname "${BASH_SOURCE[0]}" )" && pwd )"
+PROJECT_ROOT="$(dirname "$(dirname "$SCRIPT_DIR")")"
+UNIFIED_ROOT="$PROJECT_ROOT/unified"
+BINARY_DIR="$UNIFIED_ROOT/bin"
+PRICER_BIN="$BINARY_DIR/unified_pricer"
+
+# Color codes
+GREEN='\033[0;32m'
+RED='\033[0;31m'
+YELLOW='\033[1;33m'
+NC='\033[0m' # No Color
+
+# Check if binary exists
+if [ ! -x "$PRICER_BIN" ]; then
+    echo -e "${RED}Error: $PRICER_BIN not found or not executable.${NC}"
+    echo "Have you built the project? Try running 'make -f Makefile.unified' in the unified directory."
+    exit 1
+fi
+
+if ! command -v python3 >/dev/null 2>&1; then
+    echo -e "${YELLOW}Skipping: python3 is needed for the socket client.${NC}"
+    exit 0
+fi
+
+WORK_DIR="$(mktemp -d)"
+SOCKET="$WORK_DIR/pricer.sock"
+mkdir -p "$WORK_DIR/home"
+
+# One client at a time, so the busy answer can be tested; no ticker lookups
+# are made, so the empty HOME keeps the market data configuration out
+HOME="$WORK_DIR/home" "$PRICER_BIN" --server "unix:$SOCKET" --max-clients 1 \
+    --error-log "$WORK_DIR/errors.log" > "$WORK_DIR/server.log" 2>&1 &
+SERVER_PID=$!
+trap 'kill $SERVER_PID 2>/dev/null; rm -rf "$WORK_DIR"' EXIT
+
+for i in $(seq 50); do
+    [ -S "$SOCKET" ] && break
+    sleep 0.1
+done
+if [ ! -S "$SOCKET" ]; then
+    echo -e "${RED}Error: pricing server did not start.${NC}"
+    cat "$WORK_DIR/server.log"
+    exit 1
+fi
+
+# Send the request lines on stdin in one write and print one answer per line
+send_requests() {
+    python3 -c '
+import socket, sys
+lines = sys.stdin.read().splitlines()
+s = socket.socket(socket.AF_UNIX)
+s.settimeout(10)
+s.connect(sys.argv[1])
+s.sendall("".join(l + "\n" for l in lines).encode())
+answers = s.makefile()
+for _ in lines:
+    print(answers.readline().rstrip("\n"))
+' "$SOCKET"
+}
+
+# Connect a second client while a first one is connected
+second_client() {
+    python3 -c '
+import socket, sys
+first = socket.socket(socket.AF_UNIX)
+first.settimeout(10)
+first.connect(sys.argv[1])
+first.sendall(b"{\"op\":\"health\"}\n")
+first.makefile().readline()
+second = socket.socket(socket.AF_UNIX)
+second.settimeout(10)
+second.connect(sys.argv[1])
+print(second.makefile().readline().rstrip("\n"))
+' "$SOCKET"
+}
+
+# Function to run a test and report result
+run_test() {
+    local test_name="$1"
+    local command="$2"
+    local expected_output="$3"
+
+    echo -e "\n${YELLOW}Running test: ${test_name}${NC}"
+    echo "Command: $command"
+
+    result=$(eval "$command" 2>&1)
+    exit_code=$?
+
+    if [ $exit_code -ne 0 ]; then
+        echo -e "${RED}FAIL: Command failed with exit code $exit_code${NC}"
+        echo "Output: $result"
+        return 1
+    fi
+
+    if echo "$result" | grep -q -- "$expected_output"; then
+        echo -e "${GREEN}PASS: Output contains expected value${NC}"
+    else
+        echo -e "${RED}FAIL: Output does not contain expected value${NC}"
+        echo "Expected: $expected_output"
+        echo "Actual: $result"
+        return 1
+    fi
+
+    return 0
+}
+
+TESTS_TOTAL=0
+TESTS_FAILED=0
+
+record_test() {
+    TESTS_TOTAL=$((TESTS_TOTAL + 1))
+    if [ $1 -ne 0 ]; then
+        TESTS_FAILED=$((TESTS_FAILED + 1))
+    fi
+}
+
+CALL='"spot":100,"strike":105,"expiry":0.25,"rate":0.05,"volatility":0.2'
+
+run_test "Black-Scholes price" \
+    "echo '{\"id\":7,$CALL}' | send_requests" \
+    '{"id":7,"status":"ok","price":2.4779'
+record_test $?
+
+run_test "Heston FFT price with Greeks" \
+    "echo '{\"id\":\"h\",$CALL,\"model\":\"heston\",\"method\":\"fft\",\"greeks\":true}' | send_requests" \
+    '"id":"h","status":"ok","price":[0-9.]*,.*"delta":0\.[0-9]*,"gamma"'
+record_test $?
+
+# Pipelined requests are answered in request order, failures included
+run_test "Pipelined requests in order" \
+    "printf '%s\n' '{\"id\":1,$CALL}' '{\"id\":2,\"spot\":-1,\"strike\":105,\"expiry\":0.25}' '{\"id\":3,$CALL,\"type\":\"put\"}' | send_requests | cut -d, -f1,2 | tr '\n' ' '" \
+    '{"id":1,"status":"ok" {"id":2,"status":"error" {"id":3,"status":"ok" '
+record_test $?
+
+run_test "Invalid parameters" \
+    "echo '{\"id\":4,\"spot\":-1,\"strike\":105,\"expiry\":0.25}' | send_requests" \
+    '"status":"error","error_code":-1,"message":"Invalid parameter"'
+record_test $?
+
+run_test "Malformed request" \
+    "echo 'not json' | send_requests" \
+    '"status":"error","error_code":'
+record_test $?
+
+run_test "Health" \
+    "echo '{\"id\":5,\"op\":\"health\"}' | send_requests" \
+    '{"id":5,"status":"ok","uptime":[0-9.e+-]*,"clients":1,'
+record_test $?
+
+run_test "Stats count failed and malformed requests" \
+    "printf '%s\n' '{\"id\":1,$CALL}' '{\"op\":\"stats\"}' | send_requests | tail -1" \
+    '"requests":{"total":[0-9]*,"malformed":1,"failed":2}'
+record_test $?
+
+# Logged errors are written out by the running server, not only at exit
+wait_for_error_log() {
+    for i in $(seq 30); do
+        grep -q -- "$1" "$WORK_DIR/errors.log" 2>/dev/null && break
+        sleep 0.1
+    done
+    grep -c -- "$1" "$WORK_DIR/errors.log"
+}
+
+run_test "Failed requests reach the error log" \
+    "wait_for_error_log 'ERROR -1: Invalid parameter in price - Invalid parameter'" \
+    '^2$'
+record_test $?
+
+# An extreme strike widens the FFT grid of the client's context; the next
+# option must be priced on the configured grid again, as in a fresh process
+HESTON='"rate":0.05,"model":"heston","method":"fft"'
+FRESH_PRICE=$(HOME="$WORK_DIR/home" "$PRICER_BIN" 100 101 0.5 0.05 0 0.25 0 1 2 | sed -n 's/^Option Price: *//p')
+run_test "FFT settings reset between requests" \
+    "printf '%s\n' '{\"spot\":100,\"strike\":350,\"expiry\":0.25,$HESTON,\"volatility\":0.2}' '{\"spot\":100,\"strike\":101,\"expiry\":0.5,$HESTON,\"volatility\":0.25}' | send_requests | tail -1 | python3 -c 'import json, sys; print(\"%.6f\" % json.load(sys.stdin)[\"price\"])'" \
+    "^$FRESH_PRICE\$"
+record_test $?
+
+run_test "Clients over --max-clients are refused" \
+    "second_client" \
+    '{"status":"busy"}'
+record_test $?
+
+# SIGTERM stops the server cleanly
+echo -e "\n${YELLOW}Running test: Shutdown on SIGTERM${NC}"
+kill -TERM $SERVER_PID
+wait $SERVER_PID
+exit_code=$?
+if [ $exit_code -eq 0 ]; then
+    echo -e "${GREEN}PASS: Server exited with status 0${NC}"
+    record_test 0
+else
+    echo -e "${RED}FAIL: Server exited with status $exit_code${NC}"
+    cat "$WORK_DIR/server.log"
+    record_test 1
+fi
+
+# A second server with market data from the local stub provider
+# (tests/stub_market_server.py), which answers the ticker SLOW two seconds late
+python3 "$SCRIPT_DIR/stub_market_server.py" "$WORK_DIR/port" "$WORK_DIR/requests.log" &
+STUB_PID=$!
+trap 'kill $SERVER_PID $STUB_PID 2>/dev/null; rm -rf "$WORK_DIR"' EXIT
+for i in $(seq 50); do
+    [ -s "$WORK_DIR/port" ] && break
+    sleep 0.1
+done
+
+mkdir -p "$WORK_DIR/market/.config/option_tools"
+cat > "$WORK_DIR/market/.config/option_tools/market_data.conf" <<EOF
+ALPHAVANTAGE_API_KEY=test
+ALPHAVANTAGE_BASE_URL=http://127.0.0.1:$(cat "$WORK_DIR/port")
+ALPHAVANTAGE_REQUESTS_PER_MINUTE=0
+RATE_LIMIT_WAIT_SECONDS=0
+EOF
+
+SOCKET="$WORK_DIR/market.sock"
+HOME="$WORK_DIR/market" "$PRICER_BIN" --server "unix:$SOCKET" > "$WORK_DIR/market_server.log" 2>&1 &
+SERVER_PID=$!
+for i in $(seq 50); do
+    [ -S "$SOCKET" ] && break
+    sleep 0.1
+done
+
+# Send the first request, then the second from another client while the
+# first waits for its market data; print both answers and which came first
+concurrent_clients() {
+    python3 -c '
+import socket, sys, threading, time
+def ask(line, out):
+    s = socket.socket(socket.AF_UNIX)
+    s.settimeout(20)
+    s.connect(sys.argv[1])
+    s.sendall((line + "\n").encode())
+    out.append(s.makefile().readline().rstrip("\n"))
+    out.append(time.time())
+slow, fast = [], []
+first = threading.Thread(target=ask, args=(sys.argv[2], slow))
+first.start()
+time.sleep(0.5)
+ask(sys.argv[3], fast)
+first.join()
+print(slow[0])
+print(fast[0])
+print("second answered first" if fast[1] < slow[1] else "first answered first")
+' "$SOCKET" "$1" "$2"
+}
+
+concurrent_clients "{\"id\":\"slow\",\"ticker\":\"SLOW\",$CALL}" \
+    "{\"id\":\"fast\",$CALL,\"model\":\"heston\",\"method\":\"fft\"}" > "$WORK_DIR/concurrent.out" 2>&1
+
+run_test "Ticker request priced from the provider" \
+    "grep -c 'REQ GLOBAL_QUOTE SLOW' '$WORK_DIR/requests.log'; head -1 '$WORK_DIR/concurrent.out'" \
+    '{"id":"slow","status":"ok","price":'
+record_test $?
+
+run_test "A slow market data fetch does not hold up other clients" \
+    "cat '$WORK_DIR/concurrent.out'" \
+    '^second answered first$'
+record_test $?
+
+kill -TERM $SERVER_PID
+wait $SERVER_PID
+
+# Print summary
+echo -e "\n${YELLOW}===============================================${NC}"
+echo -e "Total tests:  $TESTS_TOTAL"
+if [ $TESTS_FAILED -gt 0 ]; then
+    echo -e "${RED}Tests failed: $TESTS_FAILED${NC}"
+    exit 1
+fi
+echo -e "${GREEN}All tests passed!${NC}"
+exit 0
@@ -0,0 +1,188 @@
+#!/bin/bash
+#
+# test_stream.sh - Test the quote stream pipeline (unified_pricer --stream)
+# with a synthetic chain of Black-Scholes quotes
+#
+
+# Get script directory
+SCRIPT_DIR="$( cd "$( dirname "${BASH_SOURCE[0]}" )" && pwd )"
+PROJECT_ROOT="$(dirname "$(dirname "$SCRIPT_DIR")")"
+UNIFIED_ROOT="$PROJECT_ROOT/unified"
+BINARY_DIR="$UNIFIED_ROOT/bin"
+PRICER_BIN="$BINARY_DIR/unified_pricer"
+
+# Color codes
+GREEN='\033[0;32m'
+RED='\033[0;31m'
+YELLOW='\033[1;33m'
+NC='\033[0m' # No Color
+
+# Check if binary exists
+if [ ! -x "$PRICER_BIN" ]; then
+    echo -e "${RED}Error: $PRICER_BIN not found or not executable.${NC}"
+    echo "Have you built the project? Try running 'make -f Makefile.unified' in the unified directory."
+    exit 1
+fi
+
+if ! command -v python3 >/dev/null 2>&1; then
+    echo -e "${YELLOW}Skipping: python3 is needed to build and read the quotes.${NC}"
+    exit 0
+fi
+
+WORK_DIR="$(mktemp -d)"
+STREAM_PID=""
+trap '[ -n "$STREAM_PID" ] && kill $STREAM_PID 2>/dev/null; rm -rf "$WORK_DIR"' EXIT
+mkdir -p "$WORK_DIR/home"
+STREAM="HOME=$WORK_DIR/home $PRICER_BIN --stream"
+
+# Six calls priced by Black-Scholes at a 20% volatility, a put quoted below
+# its intrinsic value and a malformed line
+python3 - > "$WORK_DIR/quotes.jsonl" <<'EOF'
+import json, math
+
+def call(spot, strike, expiry, rate, dividend, vol):
+    n = lambda x: 0.5 * math.erfc(-x / math.sqrt(2.0))
+    d1 = (math.log(spot / strike) + (rate - dividend + 0.5 * vol * vol) * expiry) / (vol * math.sqrt(expiry))
+    d2 = d1 - vol * math.sqrt(expiry)
+    return spot * math.exp(-dividend * expiry) * n(d1) - strike * math.exp(-rate * expiry) * n(d2)
+
+for strike in (90, 95, 100, 105, 110, 115):
+    print(json.dumps({"ticker": "SPX", "type": "call", "spot": 100, "strike": strike, "expiry": 0.25,
+                      "rate": 0.03, "dividend": 0.01, "market_price": call(100, strike, 0.25, 0.03, 0.01, 0.2)}))
+print(json.dumps({"ticker": "SPX", "type": "put", "spot": 100, "strike": 100, "expiry": 0.25,
+                  "rate": 0.03, "dividend": 0.01, "market_price": 0.0}))
+print("not a quote")
+EOF
+
+# Exit status 0 if the Python expression holds for the list of events in a
+# file, where e(name) lists the events of one kind
+check_events() {
+    python3 -c '
+import json, sys
+events = [json.loads(line) for line in open(sys.argv[1]) if line.strip()]
+e = lambda name: [x for x in events if x.get("event") == name]
+ok = eval(sys.argv[2])
+print("holds" if ok else "does not hold")
+sys.exit(0 if ok else 1)
+' "$1" "$2"
+}
+
+# Function to run a test and report result
+run_test() {
+    local test_name="$1"
+    local command="$2"
+    local expected_output="$3"
+
+    echo -e "\n${YELLOW}Running test: ${test_name}${NC}"
+    echo "Command: $command"
+
+    result=$(eval "$command" 2>&1)
+    exit_code=$?
+
+    if [ $exit_code -ne 0 ]; then
+        echo -e "${RED}FAIL: Command failed with exit code $exit_code${NC}"
+        echo "Output: $result"
+        return 1
+    fi
+
+    if echo "$result" | grep -q -- "$expected_output"; then
+        echo -e "${GREEN}PASS: Output contains expected value${NC}"
+    else
+        echo -e "${RED}FAIL: Output does not contain expected value${NC}"
+        echo "Expected: $expected_output"
+        echo "Actual: $result"
+        return 1
+    fi
+
+    return 0
+}
+
+TESTS_TOTAL=0
+TESTS_FAILED=0
+
+record_test() {
+    TESTS_TOTAL=$((TESTS_TOTAL + 1))
+    if [ $1 -ne 0 ]; then
+        TESTS_FAILED=$((TESTS_FAILED + 1))
+    fi
+}
+
+# The whole feed on stdin: the pipeline drains it and exits
+OUT="$WORK_DIR/events.jsonl"
+run_test "Feed on stdin" \
+    "$STREAM --min-fit-quotes 5 < $WORK_DIR/quotes.jsonl > $OUT" \
+    "Skipping invalid quote on line 8"
+record_test $?
+
+run_test "Implied volatilities" \
+    "check_events $OUT 'len(e(\"quote\")) == 7 and sum(abs(q[\"iv\"] - 0.2) < 1e-8 for q in e(\"quote\") if q[\"type\"] == \"call\") == 6'" \
+    "holds"
+record_test $?
+
+run_test "Quote below intrinsic value" \
+    "check_events $OUT '[q[\"iv\"] for q in e(\"quote\") if q[\"type\"] == \"put\"] == [None] and \"iv_error\" in e(\"quote\")[-1]'" \
+    "holds"
+record_test $?
+
+run_test "Heston fit of the chain" \
+    "check_events $OUT 'len(e(\"fit\")) == 1 and e(\"fit\")[0][\"converged\"] and e(\"fit\")[0][\"quotes\"] == 6 and e(\"fit\")[0][\"rmse\"] < 0.01 and abs(e(\"fit\")[0][\"params\"][\"v0\"] - 0.04) < 0.002'" \
+    "holds"
+record_test $?
+
+run_test "Stats at the end of the feed" \
+    "check_events $OUT 'len(e(\"stats\")) == 1 and events[-1][\"event\"] == \"stats\" and events[-1][\"malformed\"] == 1 and events[-1][\"fits\"] == 1 and events[-1][\"stages\"][\"iv\"][\"records\"] == 7'" \
+    "holds"
+record_test $?
+
+run_test "No fit below --min-fit-quotes" \
+    "$STREAM --min-fit-quotes 7 < $WORK_DIR/quotes.jsonl 2>/dev/null | grep -c '\"event\":\"fit\"'; true" \
+    "^0$"
+record_test $?
+
+# A live feed through a FIFO: a quote arriving after the fit is priced with
+# it, and SIGTERM ends the pipeline with a last stats line
+mkfifo "$WORK_DIR/feed"
+LIVE="$WORK_DIR/live.jsonl"
+HOME="$WORK_DIR/home" "$PRICER_BIN" --stream --input "$WORK_DIR/feed" --min-fit-quotes 5 > "$LIVE" 2>/dev/null &
+STREAM_PID=$!
+exec 3> "$WORK_DIR/feed"
+head -6 "$WORK_DIR/quotes.jsonl" >&3
+for i in $(seq 100); do
+    grep -q '"event":"fit"' "$LIVE" && break
+    sleep 0.1
+done
+sed -n 3p "$WORK_DIR/quotes.jsonl" >&3
+for i in $(seq 50); do
+    [ "$(grep -c '"event":"quote"' "$LIVE")" -ge 7 ] && break
+    sleep 0.1
+done
+
+run_test "Quote priced with the last fit" \
+    "check_events $LIVE 'abs(e(\"quote\")[6][\"model_price\"] - e(\"quote\")[6][\"market_price\"]) < 0.05 and abs(e(\"quote\")[6][\"model_iv\"] - 0.2) < 0.01'" \
+    "holds"
+record_test $?
+
+echo -e "\n${YELLOW}Running test: Shutdown on SIGTERM${NC}"
+kill -TERM $STREAM_PID
+wait $STREAM_PID
+exit_code=$?
+STREAM_PID=""
+exec 3>&-
+if [ $exit_code -eq 0 ] && [ "$(tail -1 "$LIVE" | cut -c1-17)" = '{"event":"stats",' ]; then
+    echo -e "${GREEN}PASS: Pipeline exited with status 0 after a stats line${NC}"
+    record_test 0
+else
+    echo -e "${RED}FAIL: Pipeline exited with status $exit_code${NC}"
+    tail -1 "$LIVE"
+    record_test 1
+fi
+
+# Print summary
+echo -e "\n${YELLOW}===============================================${NC}"
+echo -e "Total tests:  $TESTS_TOTAL"
+if [ $TESTS_FAILED -gt 0 ]; then
+    echo -e "${RED}Tests failed: $TESTS_FAILED${NC}"
+    exit 1
+fi
+echo -e "${GREEN}All tests passed!${NC}"
+exit 0
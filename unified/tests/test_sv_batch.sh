@@ -0,0 +1,123 @@
+#!/bin/bash
+#
+# test_sv_batch.sh - Test that calculate_sv_v6 --batch gives every row of a
+# chain the volatility a single-option run prints for it
+#
+
+# Get script directory
+SCRIPT_DIR="$( cd "$( dirname "${BASH_SOURCE[0]}" )" && pwd )"
+PROJECT_ROOT="$(dirname "$(dirname "$SCRIPT_DIR")")"
+UNIFIED_ROOT="$PROJECT_ROOT/unified"
+SV_BIN="$PROJECT_ROOT/calculate_sv_v6"
+
+# Color codes
+GREEN='\033[0;32m'
+RED='\033[0;31m'
+YELLOW='\033[1;33m'
+NC='\033[0m' # No Color
+
+# Check if binary exists
+if [ ! -x "$SV_BIN" ]; then
+    echo -e "${RED}Error: $SV_BIN not found or not executable.${NC}"
+    echo "Have you built the project? Try running 'make calculate_sv_v6' in the project root."
+    exit 1
+fi
+
+WORK_DIR="$(mktemp -d)"
+trap 'rm -rf "$WORK_DIR"' EXIT
+
+SPOT=100
+RATE=0.05
+DIVIDEND=0.02
+
+# price,strike,expiry: a short, a quarterly and a long expiry with strikes from
+# deep in the money to far out of it, and rows whose single-option runs pick
+# their own FFT settings (moneyness past 3 and a very short expiry)
+cat > "$WORK_DIR/chain.csv" <<EOF
+5.0,100,0.25
+12.5,90,0.25
+8.2,95,0.25
+2.6,105,0.25
+1.0,110,0.25
+1.0,120,0.25
+0.35,130,0.25
+23.5,80,1.0
+14.0,90,1.0
+8.5,100,1.0
+4.8,110,1.0
+1.2,130,1.0
+32.0,70,0.1
+2.6,100,0.1
+0.3,110,0.1
+1.5,100,0.02
+70.5,30,0.5
+EOF
+
+# Function to run a test and report result
+run_test() {
+    local test_name="$1"
+    local command="$2"
+    local expected_output="$3"
+
+    echo -e "\n${YELLOW}Running test: ${test_name}${NC}"
+    echo "Command: $command"
+
+    result=$(eval "$command" 2>&1)
+    exit_code=$?
+
+    if [ $exit_code -ne 0 ]; then
+        echo -e "${RED}FAIL: Command failed with exit code $exit_code${NC}"
+        echo "Output: $result"
+        return 1
+    fi
+
+    if echo "$result" | grep -q -- "$expected_output"; then
+        echo -e "${GREEN}PASS: Output contains expected value${NC}"
+    else
+        echo -e "${RED}FAIL: Output does not contain expected value${NC}"
+        echo "Expected: $expected_output"
+        echo "Actual: $result"
+        return 1
+    fi
+
+    return 0
+}
+
+TESTS_TOTAL=0
+TESTS_FAILED=0
+
+record_test() {
+    TESTS_TOTAL=$((TESTS_TOTAL + 1))
+    if [ $1 -ne 0 ]; then
+        TESTS_FAILED=$((TESTS_FAILED + 1))
+    fi
+}
+
+ROWS=$(wc -l < "$WORK_DIR/chain.csv")
+BATCH="$WORK_DIR/batch.csv"
+
+run_test "Batch run of the chain" \
+    "$SV_BIN --batch $SPOT $RATE $DIVIDEND < $WORK_DIR/chain.csv 2>/dev/null > $BATCH; wc -l < $BATCH" \
+    "^ *$ROWS$"
+record_test $?
+
+# Each row of the batch output against a single-option run of the same row
+line=0
+while IFS=, read -r price strike expiry; do
+    line=$((line + 1))
+    single=$("$SV_BIN" "$price" "$SPOT" "$strike" "$expiry" "$RATE" "$DIVIDEND" 2>/dev/null | tail -1)
+    run_test "Batch matches single: $price,$strike,$expiry" \
+        "sed -n ${line}p $BATCH | cut -d, -f4" \
+        "^${single}$"
+    record_test $?
+done < "$WORK_DIR/chain.csv"
+
+# Print summary
+echo -e "\n${YELLOW}===============================================${NC}"
+echo -e "Total tests:  $TESTS_TOTAL"
+if [ $TESTS_FAILED -gt 0 ]; then
+    echo -e "${RED}Tests failed: $TESTS_FAILED${NC}"
+    exit 1
+fi
+echo -e "${GREEN}All tests passed!${NC}"
+exit 0
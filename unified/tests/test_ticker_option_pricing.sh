@@ -118,7 +118,15 @@ print_header "Test 9: Heston Model with FFT"
 run_test "Heston FFT" "$PRICER_SCRIPT --verbose -m heston -n fft --ticker SPX 4700 4750 60" "Heston"
 record_test $?
 
-print_header "Test 10: Invalid Ticker"
+print_header "Test 10: Heston Model with COS"
+run_test "Heston COS" "$PRICER_SCRIPT --verbose -m heston -n cos --ticker SPX 4700 4750 60" "Heston"
+record_test $?
+
+print_header "Test 11: Heston Model with Monte Carlo"
+run_test "Heston Monte Carlo" "$PRICER_SCRIPT --verbose -m heston -n mc --ticker SPX 4700 4750 60" "Heston"
+record_test $?
+
+print_header "Test 12: Invalid Ticker"
 run_test "Invalid Ticker" "$SCRIPTS_DIR/get_market_data.sh --verbose INVALID_TICKER_XYZ" "Error"
 record_test $?
 